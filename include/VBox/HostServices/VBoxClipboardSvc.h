@@ -602,9 +602,11 @@
 
 
 /** Maximum chunk size for a single data transfer. */
-#define VBOX_SHCL_MAX_CHUNK_SIZE                  VMMDEV_MAX_HGCM_DATA_SIZE - _4K
-/** Default chunk size for a single data transfer. */
-#define VBOX_SHCL_DEFAULT_CHUNK_SIZE              RT_MIN(_64K, VBOX_SHCL_MAX_CHUNK_SIZE);
+#define VBOX_SHCL_MAX_CHUNK_SIZE                  (VMMDEV_MAX_HGCM_DATA_SIZE - _4K)
+/** Default chunk size for a single data transfer.
+ * Every chunk of a transfer object costs a full host <-> guest round trip,
+ * so this should not be too small. */
+#define VBOX_SHCL_DEFAULT_CHUNK_SIZE              RT_MIN(_1M, VBOX_SHCL_MAX_CHUNK_SIZE)
 
 
 /** @name VBOX_SHCL_GF_XXX - Guest features.
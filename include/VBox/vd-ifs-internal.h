@@ -268,10 +268,17 @@ typedef struct VDINTERFACEIOINT
      * @param   uOffset        The offset to start reading from.
      * @param   pIoCtx         I/O context passed in the read/write callback.
      * @param   cbRead         How many bytes to read.
+     * @param   pfnComplete    Completion callback, optional.
+     * @param   pvCompleteUser Opaque user data passed in the completion callback.
+     *
+     * @note    The completion callback is called once when the whole transfer
+     *          completed if VERR_VD_ASYNC_IO_IN_PROGRESS is returned, never otherwise.
      */
     DECLR3CALLBACKMEMBER(int, pfnReadUser, (void *pvUser, PVDIOSTORAGE pStorage,
                                             uint64_t uOffset, PVDIOCTX pIoCtx,
-                                            size_t cbRead));
+                                            size_t cbRead,
+                                            PFNVDXFERCOMPLETED pfnComplete,
+                                            void *pvCompleteUser));
 
     /**
      * Initiate a write request for user data.
@@ -284,6 +291,9 @@ typedef struct VDINTERFACEIOINT
      * @param   cbWrite        How many bytes to write.
      * @param   pfnCompleted   Completion callback.
      * @param   pvCompleteUser Opaque user data passed in the completion callback.
+     *
+     * @note    The completion callback is called once when the whole transfer
+     *          completed if VERR_VD_ASYNC_IO_IN_PROGRESS is returned, never otherwise.
      */
     DECLR3CALLBACKMEMBER(int, pfnWriteUser, (void *pvUser, PVDIOSTORAGE pStorage,
                                              uint64_t uOffset, PVDIOCTX pIoCtx,
@@ -567,7 +577,17 @@ DECLINLINE(int) vdIfIoIntFileReadUser(PVDINTERFACEIOINT pIfIoInt, PVDIOSTORAGE p
                                       uint64_t uOffset, PVDIOCTX pIoCtx, size_t cbRead)
 {
     return pIfIoInt->pfnReadUser(pIfIoInt->Core.pvUser, pStorage,
-                                 uOffset, pIoCtx, cbRead);
+                                 uOffset, pIoCtx, cbRead, NULL, NULL);
+}
+
+DECLINLINE(int) vdIfIoIntFileReadUserEx(PVDINTERFACEIOINT pIfIoInt, PVDIOSTORAGE pStorage,
+                                        uint64_t uOffset, PVDIOCTX pIoCtx, size_t cbRead,
+                                        PFNVDXFERCOMPLETED pfnComplete,
+                                        void *pvCompleteUser)
+{
+    return pIfIoInt->pfnReadUser(pIfIoInt->Core.pvUser, pStorage,
+                                 uOffset, pIoCtx, cbRead, pfnComplete,
+                                 pvCompleteUser);
 }
 
 DECLINLINE(int) vdIfIoIntFileWriteUser(PVDINTERFACEIOINT pIfIoInt, PVDIOSTORAGE pStorage,
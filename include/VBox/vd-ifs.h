@@ -707,10 +707,37 @@ VBOXDDU_DECL(int) VDIfCreateVfsFile(PVDINTERFACEIO pVDIfs, struct VDINTERFACEIOI
  */
 VBOXDDU_DECL(int) VDIfCreateFromVfsStream(RTVFSIOSTREAM hVfsIos, uint32_t fAccessMode, PVDINTERFACEIO *ppIoIf);
 
+/** @name VDIfCreateFromVfsStreamEx flags.
+ * @{ */
+/** Queue writes and do them on a separate thread, so whatever the stream does
+ * (digest calculation, archiving) overlaps with producing the data. Write
+ * errors are returned by a later write or by the close. */
+#define VD_IFFROMVFS_F_WRITE_BEHIND     RT_BIT_32(0)
+/** Mask of valid flags. */
+#define VD_IFFROMVFS_F_VALID_MASK       UINT32_C(0x00000001)
+/** @} */
+
+/**
+ * Creates an VD I/O interface wrapper around an IPRT VFS I/O stream, extended
+ * version.
+ *
+ * @return  VBox status code.
+ * @param   hVfsIos         The IPRT VFS I/O stream handle. The handle will be
+ *                          retained by the returned I/O interface (released on
+ *                          close or destruction).
+ * @param   fAccessMode     The access mode (RTFILE_O_ACCESS_MASK) to accept.
+ * @param   fFlags          Combination of VD_IFFROMVFS_F_XXX.
+ * @param   ppIoIf          Where to return the pointer to the VD I/O interface.
+ *                          This must be passed to VDIfDestroyFromVfsStream().
+ */
+VBOXDDU_DECL(int) VDIfCreateFromVfsStreamEx(RTVFSIOSTREAM hVfsIos, uint32_t fAccessMode, uint32_t fFlags, PVDINTERFACEIO *ppIoIf);
+
 /**
  * Destroys the VD I/O interface returned by VDIfCreateFromVfsStream.
  *
- * @returns VBox status code.
+ * @returns VBox status code.  With VD_IFFROMVFS_F_WRITE_BEHIND this is the
+ *          status of the first failed queued write if the stream was never
+ *          closed (the close returns it otherwise).
  * @param   pIoIf           The I/O interface pointer returned by
  *                          VDIfCreateFromVfsStream.  NULL will be quietly
  *                          ignored.
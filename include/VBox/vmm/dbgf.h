@@ -3357,8 +3357,15 @@ typedef FNDBGFPROGRESS *PFNDBGFPROGRESS;
  * @{ */
 /** The report creates the call stack in reverse order (bottom to top). */
 #define DBGF_SAMPLE_REPORT_F_STACK_REVERSE  RT_BIT(0)
+/** Only sample the current guest PC and skip the (expensive) stack walk,
+ * for low overhead long running sampling. */
+#define DBGF_SAMPLE_REPORT_F_PC_ONLY        RT_BIT(1)
+/** Produce the report in the folded stack format (one "frame;frame;... count"
+ * line per unique stack, outermost frame first) as consumed by flame graph
+ * tools, without the info item dumps. */
+#define DBGF_SAMPLE_REPORT_F_FOLDED         RT_BIT(2)
 /** Mask containing the valid flags. */
-#define DBGF_SAMPLE_REPORT_F_VALID_MASK     UINT32_C(0x00000001)
+#define DBGF_SAMPLE_REPORT_F_VALID_MASK     UINT32_C(0x00000007)
 /** @} */
 
 VMMR3DECL(int)      DBGFR3SampleReportCreate(PUVM pUVM, uint32_t cSampleIntervalMs, uint32_t fFlags, PDBGFSAMPLEREPORT phSample);
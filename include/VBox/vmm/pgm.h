@@ -1269,6 +1269,7 @@ VMMR3DECL(int)      PGMR3Term(PVM pVM);
 
 VMMR3DECL(int)      PGMR3PhysRegisterRam(PVM pVM, RTGCPHYS GCPhys, RTGCPHYS cb, const char *pszDesc);
 VMMR3DECL(int)      PGMR3PhysChangeMemBalloon(PVM pVM, bool fInflate, unsigned cPages, RTGCPHYS *paPhysPage);
+VMMR3DECL(int)      PGMR3PhysReportFreeRanges(PVM pVM, PCPGMPHYSRANGES pRanges);
 VMMR3DECL(int)      PGMR3PhysWriteProtectRAM(PVM pVM);
 VMMR3DECL(uint32_t) PGMR3PhysGetRamRangeCount(PVM pVM);
 VMMR3DECL(int)      PGMR3PhysGetRange(PVM pVM, uint32_t iRange, PRTGCPHYS pGCPhysStart, PRTGCPHYS pGCPhysLast,
@@ -1379,6 +1380,7 @@ VMMR3DECL(int)     PGMR3SharedModuleUnregister(PVM pVM, char *pszModuleName, cha
                                                RTGCPTR GCBaseAddr, uint32_t cbModule);
 VMMR3DECL(int)     PGMR3SharedModuleCheckAll(PVM pVM);
 VMMR3DECL(int)     PGMR3SharedModuleGetPageState(PVM pVM, RTGCPTR GCPtrPage, bool *pfShared, uint64_t *pfPageFlags);
+VMMR3_INT_DECL(int) PGMR3ZeroPageScanInit(PVM pVM);
 #endif /* IN_RING3 */
 /** @} */
 
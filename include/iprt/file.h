@@ -1747,6 +1747,24 @@ RTDECL(uint32_t) RTFileAioCtxGetMaxReqCount(RTFILEAIOCTX hAioCtx);
  */
 RTDECL(int) RTFileAioCtxAssociateWithFile(RTFILEAIOCTX hAioCtx, RTFILE hFile);
 
+/**
+ * Drops the association of a file with an async I/O context again.
+ *
+ * This must be called before closing a file associated with
+ * RTFileAioCtxAssociateWithFile() while the context stays around, as the
+ * context may have cached the file (by handle) for faster request submission.
+ * There must be no requests for the file outstanding on the context.
+ *
+ * @returns IPRT status code.
+ * @param   hAioCtx        The async I/O context handle.
+ * @param   hFile          The file handle.
+ *
+ * @note    This is a no-op on hosts where the association is fixed for the
+ *          lifetime of the file (Windows completion ports) or where the
+ *          context doesn't keep any per file state.
+ */
+RTDECL(int) RTFileAioCtxDisassociateFromFile(RTFILEAIOCTX hAioCtx, RTFILE hFile);
+
 /**
  * Submits a set of requests to an async I/O context for processing.
  *
@@ -975,6 +975,7 @@
 # define RTFileAioCtxAssociateWithFile                  RT_MANGLER(RTFileAioCtxAssociateWithFile)
 # define RTFileAioCtxCreate                             RT_MANGLER(RTFileAioCtxCreate)
 # define RTFileAioCtxDestroy                            RT_MANGLER(RTFileAioCtxDestroy)
+# define RTFileAioCtxDisassociateFromFile               RT_MANGLER(RTFileAioCtxDisassociateFromFile)
 # define RTFileAioCtxGetMaxReqCount                     RT_MANGLER(RTFileAioCtxGetMaxReqCount)
 # define RTFileAioCtxSubmit                             RT_MANGLER(RTFileAioCtxSubmit)
 # define RTFileAioCtxWait                               RT_MANGLER(RTFileAioCtxWait)
@@ -2823,6 +2824,7 @@
 # define RTUdpServerCreateEx                            RT_MANGLER(RTUdpServerCreateEx)
 # define RTUdpServerDestroy                             RT_MANGLER(RTUdpServerDestroy)
 # define RTUdpServerListen                              RT_MANGLER(RTUdpServerListen)
+# define RTUdpServerSetBufferSizes                      RT_MANGLER(RTUdpServerSetBufferSizes)
 # define RTUdpServerShutdown                            RT_MANGLER(RTUdpServerShutdown)
 # define RTUdpWrite                                     RT_MANGLER(RTUdpWrite)
 # define RTUniFree                                      RT_MANGLER(RTUniFree)
@@ -162,6 +162,16 @@ RTR3DECL(int)  RTUdpRead(RTSOCKET Sock, void *pvBuffer, size_t cbBuffer, size_t
 RTR3DECL(int)  RTUdpWrite(PRTUDPSERVER pServer, const void *pvBuffer,
                           size_t cbBuffer, PCRTNETADDR pDstAddr);
 
+/**
+ * Sets the socket receive and send buffer sizes of a server.
+ *
+ * @returns iprt status code.
+ * @param   pServer     Handle to the server.
+ * @param   cbRecv      The receive buffer size, 0 to leave it unchanged.
+ * @param   cbSend      The send buffer size, 0 to leave it unchanged.
+ */
+RTR3DECL(int)  RTUdpServerSetBufferSizes(PRTUDPSERVER pServer, uint32_t cbRecv, uint32_t cbSend);
+
 /**
  * Create and connect a data socket.
  *
@@ -70,6 +70,9 @@
 #endif
 #include <iprt/errcore.h>
 #include <VBox/vmm/pdmaudioinline.h>
+#ifdef RT_ARCH_AMD64
+# include <emmintrin.h> /* SSE2 is part of the AMD64 baseline. */
+#endif
 
 #include "AudioMixBuffer.h"
 
@@ -1879,12 +1882,65 @@ void AudioMixBufAdvance(PAUDIOMIXBUF pMixBuf, uint32_t cFrames)
 }
 
 
+#ifdef RT_ARCH_AMD64
+/**
+ * SSE2 variant of the volume adjustment for channel counts dividing four.
+ *
+ * Gives the same results as the scalar code: the low 32 bits of the signed
+ * product shifted by AUDIOMIXBUF_VOL_SHIFT.  SSE2 only multiplies unsigned
+ * dwords, so the factor shifted into place is subtracted again for negative
+ * samples (two's complement correction of the high half).
+ *
+ * @param   pi32Samples     The samples to adjust.
+ * @param   cQuads          Number of sample quadruples.
+ * @param   pauFactors      Four volume factors, one per sample position.
+ */
+static void audioMixAdjustVolumeSse2(int32_t *pi32Samples, size_t cQuads, uint32_t const *pauFactors)
+{
+    __m128i const Factors      = _mm_setr_epi32((int)pauFactors[0], (int)pauFactors[1], (int)pauFactors[2], (int)pauFactors[3]);
+    __m128i const FactorsOdd   = _mm_srli_epi64(Factors, 32);
+    __m128i const FactorsCorr  = _mm_slli_epi32(Factors, 32 - AUDIOMIXBUF_VOL_SHIFT);
+    __m128i const MaskLow      = _mm_setr_epi32(-1, 0, -1, 0);
+    while (cQuads-- > 0)
+    {
+        __m128i const Samples = _mm_loadu_si128((__m128i const *)pi32Samples);
+        __m128i const Even    = _mm_srli_epi64(_mm_mul_epu32(Samples, Factors), AUDIOMIXBUF_VOL_SHIFT);
+        __m128i const Odd     = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(Samples, 32), FactorsOdd), AUDIOMIXBUF_VOL_SHIFT);
+        __m128i       Result  = _mm_or_si128(_mm_and_si128(Even, MaskLow), _mm_slli_epi64(Odd, 32));
+        Result = _mm_sub_epi32(Result, _mm_and_si128(_mm_srai_epi32(Samples, 31), FactorsCorr));
+        _mm_storeu_si128((__m128i *)pi32Samples, Result);
+        pi32Samples += 4;
+    }
+}
+#endif /* RT_ARCH_AMD64 */
+
+
 /**
  * Worker for audioMixAdjustVolume that adjust one contiguous chunk.
  */
 static void audioMixAdjustVolumeWorker(PAUDIOMIXBUF pMixBuf, uint32_t off, uint32_t cFrames)
 {
     int32_t       *pi32Samples = &pMixBuf->pi32Samples[off * pMixBuf->cChannels];
+#ifdef RT_ARCH_AMD64
+    /* Do the bulk of the common mono, stereo and quad cases four samples at a time. */
+    if (   pMixBuf->cChannels == 1
+        || pMixBuf->cChannels == 2
+        || pMixBuf->cChannels == 4)
+    {
+        uint32_t const cChannels = pMixBuf->cChannels;
+        uint32_t const auFactors[4] =
+        {
+            pMixBuf->Volume.auChannels[0],
+            pMixBuf->Volume.auChannels[1 % cChannels],
+            pMixBuf->Volume.auChannels[2 % cChannels],
+            pMixBuf->Volume.auChannels[3 % cChannels],
+        };
+        uint32_t const cFramesVec = cFrames & ~(4 / cChannels - 1);
+        audioMixAdjustVolumeSse2(pi32Samples, (size_t)cFramesVec * cChannels / 4, auFactors);
+        pi32Samples += (size_t)cFramesVec * cChannels;
+        cFrames     -= cFramesVec;
+    }
+#endif
     switch (pMixBuf->cChannels)
     {
         case 1:
@@ -4849,6 +4849,7 @@ static DECLCALLBACK(int) hdaR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFGM
     PDMDEV_VALIDATE_CONFIG_RETURN(pDevIns,
                                   "BufSizeInMs"
                                   "|BufSizeOutMs"
+                                  "|DmaMaxPeriodMs"
                                   "|DebugEnabled"
                                   "|DebugPathOut"
                                   "|DeviceName",
@@ -4874,6 +4875,18 @@ static DECLCALLBACK(int) hdaR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFGM
         return PDMDEV_SET_ERROR(pDevIns, VERR_OUT_OF_RANGE,
                                 N_("HDA configuration error: 'BufSizeOutMs' is out of bound, max 2000 ms"));
 
+    /** @devcfgm{hda,DmaMaxPeriodMs,uint16_t,10,1000,100,ms}
+     * The longest DMA timer period, i.e. how much of a large buffer between
+     * interrupt-on-completion points is transferred per timer callout.  Raising
+     * it reduces the timer rate for guests which use few, large buffers. */
+    rc = pHlp->pfnCFGMQueryU16Def(pCfg, "DmaMaxPeriodMs", &pThis->cMsDmaMaxPeriod, 100);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc,
+                                N_("HDA configuration error: failed to read 'DmaMaxPeriodMs' as 16-bit unsigned integer"));
+    if (pThis->cMsDmaMaxPeriod < 10 || pThis->cMsDmaMaxPeriod > 1000)
+        return PDMDEV_SET_ERROR(pDevIns, VERR_OUT_OF_RANGE,
+                                N_("HDA configuration error: 'DmaMaxPeriodMs' is out of bound, 10 to 1000 ms"));
+
     rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "DebugEnabled", &pThisCC->Dbg.fEnabled, false);
     if (RT_FAILURE(rc))
         return PDMDEV_SET_ERROR(pDevIns, rc,
@@ -679,6 +679,9 @@ typedef struct HDASTATE
      * Zero means default size according to buffer and stream config.
      * @sa BufSizeOutMs config value.  */
     uint16_t                cMsCircBufOut;
+    /** Config: The max DMA timer period in milliseconds.
+     * @sa DmaMaxPeriodMs config value.  */
+    uint16_t                cMsDmaMaxPeriod;
     /** The start time of the wall clock (WALCLK), measured on the virtual sync clock. */
     uint64_t                tsWalClkStart;
     /** CORB DMA task handle.
@@ -718,7 +718,7 @@ int hdaR3StreamSetUp(PPDMDEVINS pDevIns, PHDASTATE pThis, PHDASTREAM pStreamShar
      * Create a DMA timer schedule.
      */
     rc = hdaR3StreamCreateSchedule(pStreamShared, cTransferFragments, cBufferIrqs, (uint32_t)cbTotal,
-                                   PDMAudioPropsMilliToBytes(&pCfg->Props, 100 /** @todo make configurable */),
+                                   PDMAudioPropsMilliToBytes(&pCfg->Props, pThis->cMsDmaMaxPeriod),
                                    PDMDevHlpTimerGetFreq(pDevIns, pStreamShared->hTimer), &pCfg->Props);
     if (RT_FAILURE(rc))
         return rc;
@@ -236,6 +236,9 @@ typedef struct DRVAUDIOSTREAM
     /** Timestamp (in ns) since last read (input streams) or
      *  write (output streams). */
     uint64_t                nsLastReadWritten;
+    /** The achieved backend buffer size (in ms), i.e. the worst case latency
+     *  added by the host buffer.  For statistics. */
+    uint32_t                cMsBackendBufferSize;
 
 
     /** Union for input/output specifics depending on enmDir. */
@@ -328,6 +331,9 @@ typedef struct DRVAUDIOCFG
      *  Needed in order to know whether there is a custom value set in CFGM or not.
      *  By default set to UINT8_MAX if not set to a custom value. */
     uint8_t              uSwapEndian;
+    /** Whether to use the low-latency buffer defaults (smaller buffer, period and
+     *  pre-buffering) for values not explicitly configured. */
+    uint8_t              fLowLatency;
     /** Configures the period size (in ms).
      *  This value reflects the time in between each hardware interrupt on the
      *  backend (host) side. */
@@ -1160,8 +1166,8 @@ static int drvAudioStreamAdjustConfig(PCDRVAUDIO pThis, PPDMAUDIOSTREAMCFG pCfg,
 
     if (!pCfg->Backend.cFramesBufferSize) /* Set default buffer size if nothing explicitly is set. */
     {
-        pCfg->Backend.cFramesBufferSize = PDMAudioPropsMilliToFrames(&pCfg->Props, 300 /*ms*/);
-        pszWhat = "default";
+        pCfg->Backend.cFramesBufferSize = PDMAudioPropsMilliToFrames(&pCfg->Props, pDrvCfg->fLowLatency ? 60 : 300 /*ms*/);
+        pszWhat = pDrvCfg->fLowLatency ? "low-latency default" : "default";
     }
 
     LogRel2(("Audio: Using %s buffer size %RU64 ms / %RU32 frames for stream '%s'\n",
@@ -1212,11 +1218,21 @@ static int drvAudioStreamAdjustConfig(PCDRVAUDIO pThis, PPDMAUDIOSTREAMCFG pCfg,
             /* Pre-buffer 50% for both output & input. Capping both at 200ms.
                The 50% reasoning being that we need to have sufficient slack space
                in both directions as the guest DMA timer might be delayed by host
-               scheduling as well as sped up afterwards because of TM catch-up. */
+               scheduling as well as sped up afterwards because of TM catch-up.
+               In low-latency mode a single period is all we keep in reserve, as
+               the host server does its own buffering on top of ours anyway. */
             uint32_t const cFramesMax = PDMAudioPropsMilliToFrames(&pCfg->Props, 200);
-            pCfg->Backend.cFramesPreBuffering = pCfg->Backend.cFramesBufferSize / 2;
+            if (!pDrvCfg->fLowLatency)
+            {
+                pCfg->Backend.cFramesPreBuffering = pCfg->Backend.cFramesBufferSize / 2;
+                pszWhat = "default";
+            }
+            else
+            {
+                pCfg->Backend.cFramesPreBuffering = pCfg->Backend.cFramesPeriod;
+                pszWhat = "low-latency default";
+            }
             pCfg->Backend.cFramesPreBuffering = RT_MIN(pCfg->Backend.cFramesPreBuffering, cFramesMax);
-            pszWhat = "default";
         }
     }
 
@@ -1743,6 +1759,10 @@ static int drvAudioStreamInitInternal(PDRVAUDIO pThis, PDRVAUDIOSTREAM pStreamEx
                            "The size of the backend period (in frames)",     "%s/0-HostBackendPeriodSize", pStreamEx->Core.Cfg.szName);
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pStreamEx->Core.Cfg.Backend.cFramesPreBuffering, STAMTYPE_U32, STAMVISIBILITY_USED, STAMUNIT_NONE,
                            "Pre-buffer size (in frames)",                    "%s/0-HostBackendPreBufferSize", pStreamEx->Core.Cfg.szName);
+    pStreamEx->cMsBackendBufferSize = PDMAudioPropsFramesToMilli(&pStreamEx->Core.Cfg.Props,
+                                                                 pStreamEx->Core.Cfg.Backend.cFramesBufferSize);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, &pStreamEx->cMsBackendBufferSize, STAMTYPE_U32, STAMVISIBILITY_USED, STAMUNIT_NONE,
+                           "Achieved backend buffer size (in milliseconds)", "%s/0-HostBackendBufSizeMs", pStreamEx->Core.Cfg.szName);
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pStreamEx->Core.Cfg.Device.cMsSchedulingHint, STAMTYPE_U32, STAMVISIBILITY_USED, STAMUNIT_NONE,
                            "Device DMA scheduling hint (in milliseconds)",   "%s/0-DeviceSchedulingHint", pStreamEx->Core.Cfg.szName);
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pStreamEx->Core.Cfg.Props.uHz, STAMTYPE_U32, STAMVISIBILITY_USED, STAMUNIT_HZ,
@@ -4871,6 +4891,7 @@ static DECLCALLBACK(int) drvAudioConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, u
                                          "PCMSampleSigned|"
                                          "PCMSampleSwapEndian|"
                                          "PCMSampleChannels|"
+                                         "LowLatency|"
                                          "PeriodSizeMs|"
                                          "BufferSizeMs|"
                                          "PreBufferSizeMs",
@@ -4905,6 +4926,9 @@ static DECLCALLBACK(int) drvAudioConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, u
                       pAudioCfg->uSwapEndian == 0 || pAudioCfg->uSwapEndian == 1 || pAudioCfg->uSwapEndian == UINT8_MAX,
                       "Must be either 0, 1, or 255");
 
+        QUERY_VAL_RET(8,  "LowLatency",          &pAudioCfg->fLowLatency,       0,
+                      pAudioCfg->fLowLatency <= 1, "Must be either 0 or 1");
+
         QUERY_VAL_RET(32, "PeriodSizeMs",        &pAudioCfg->uPeriodSizeMs,     0,
                       pAudioCfg->uPeriodSizeMs <= RT_MS_1SEC, "Max 1000");
 
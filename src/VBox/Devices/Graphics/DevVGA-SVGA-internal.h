@@ -248,6 +248,7 @@ typedef struct VMSVGAR3STATE
     STAMCOUNTER             StatFifoCursorPosition;
     STAMCOUNTER             StatFifoCursorVisiblity;
     STAMCOUNTER             StatFifoWatchdogWakeUps;
+    STAMCOUNTER             StatCmdBufPreempted;
 } VMSVGAR3STATE, *PVMSVGAR3STATE;
 
 
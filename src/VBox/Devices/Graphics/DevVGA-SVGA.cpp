@@ -445,6 +445,7 @@ static int vmsvgaR3LoadExecFifo(PCPDMDEVHLPR3 pHlp, PVGASTATE pThis, PVGASTATECC
 static int vmsvgaR3SaveExecFifo(PCPDMDEVHLPR3 pHlp, PVGASTATECC pThisCC, PSSMHANDLE pSSM);
 static void vmsvgaR3CmdBufSubmit(PPDMDEVINS pDevIns, PVGASTATE pThis, PVGASTATECC pThisCC, RTGCPHYS GCPhysCB, SVGACBContext CBCtx);
 static void vmsvgaR3PowerOnDevice(PPDMDEVINS pDevIns, PVGASTATE pThis, PVGASTATECC pThisCC, bool fLoadState);
+static void vmsvgaR3FifoPendingActions(PPDMDEVINS pDevIns, PVGASTATE pThis, PVGASTATECC pThisCC);
 #endif /* IN_RING3 */
 
 
@@ -4143,6 +4144,11 @@ static SVGACBStatus vmsvgaR3CmdBufProcessCommands(PPDMDEVINS pDevIns, PVGASTATE
 
 
 /** Process command buffers.
+ *
+ * Returns early, leaving the remaining buffers queued, when an external
+ * command is pending so that resets, saved state and surface heap updates do
+ * not have to wait for a long queue to drain.  Pending mode changes are
+ * applied between buffers for the same reason.
  *
  * @param pDevIns     The device instance.
  * @param pThis       The shared VGA/VMSVGA state.
@@ -4159,6 +4165,16 @@ static void vmsvgaR3CmdBufProcessBuffers(PPDMDEVINS pDevIns, PVGASTATE pThis, PV
         if (pThread->enmState != PDMTHREADSTATE_RUNNING)
             break;
 
+        /* Let the caller handle external commands first; fCmdBuf stays set. */
+        if (pThis->svga.u8FIFOExtCommand != VMSVGA_FIFO_EXTCMD_NONE)
+        {
+            STAM_REL_COUNTER_INC(&pSvgaR3State->StatCmdBufPreempted);
+            break;
+        }
+
+        /* Apply mode (screen) changes between buffers rather than after the whole queue. */
+        vmsvgaR3FifoPendingActions(pDevIns, pThis, pThisCC);
+
         /* See if there is a submitted buffer. */
         PVMSVGACMDBUF pCmdBuf = NULL;
 
@@ -7608,6 +7624,7 @@ int vmsvgaR3Init(PPDMDEVINS pDevIns)
     REG_CNT(&pSVGAState->StatFifoCursorPosition,          "VMSVGA/FifoCursorPosition",             "Cursor position and visibility changes.");
     REG_CNT(&pSVGAState->StatFifoCursorVisiblity,         "VMSVGA/FifoCursorVisiblity",            "Cursor visibility changes.");
     REG_CNT(&pSVGAState->StatFifoWatchdogWakeUps,         "VMSVGA/FifoWatchdogWakeUps",            "Number of times the FIFO refresh poller/watchdog woke up the FIFO thread.");
+    REG_CNT(&pSVGAState->StatCmdBufPreempted,             "VMSVGA/CmdBufPreempted",                "Times command buffer processing yielded to a pending external command.");
 
 # undef REG_CNT
 # undef REG_PRF
@@ -81,6 +81,8 @@
 
 /* A single staging ID3D11Buffer is used for uploading data to other buffers. */
 #define DX_COMMON_STAGING_BUFFER
+/* Number of common staging buffers which uploads rotate through while the GPU still reads from the current one. */
+#define DX_STAGING_BUFFER_COUNT 4
 /* Always flush after submitting a draw call for debugging. */
 //#define DX_FLUSH_AFTER_DRAW
 
@@ -113,9 +115,15 @@ typedef struct DXDEVICE
     ID3D11VideoDevice          *pVideoDevice;
     ID3D11VideoContext         *pVideoContext;
 #ifdef DX_COMMON_STAGING_BUFFER
-    /* Staging buffer for transfer to surface buffers. */
-    ID3D11Buffer              *pStagingBuffer;         /* The staging buffer resource. */
-    uint32_t                   cbStagingBuffer;        /* Current size of the staging buffer resource. */
+    /* Staging buffers for transfer to surface buffers. */
+    struct
+    {
+        ID3D11Buffer          *pBuffer;                /* The staging buffer resource. */
+        uint32_t               cbBuffer;               /* Current size of the staging buffer resource. */
+    } aStagingBuffers[DX_STAGING_BUFFER_COUNT];
+    uint32_t                   iStagingBuffer;         /* Index of the current staging buffer in aStagingBuffers. */
+    ID3D11Buffer              *pStagingBuffer;         /* The current staging buffer resource. */
+    uint32_t                   cbStagingBuffer;        /* Current size of the current staging buffer resource. */
 #endif
 
     D3D11BLITTER               Blitter;                /* Blits one texture to another. */
@@ -1465,7 +1473,13 @@ static void dxDeviceDestroy(PVMSVGA3DBACKEND pBackend, DXDEVICE *pDevice)
     BlitRelease(&pDevice->Blitter);
 
 #ifdef DX_COMMON_STAGING_BUFFER
-    D3D_RELEASE(pDevice->pStagingBuffer);
+    for (uint32_t i = 0; i < RT_ELEMENTS(pDevice->aStagingBuffers); ++i)
+    {
+        D3D_RELEASE(pDevice->aStagingBuffers[i].pBuffer);
+        pDevice->aStagingBuffers[i].cbBuffer = 0;
+    }
+    pDevice->pStagingBuffer = NULL;
+    pDevice->cbStagingBuffer = 0;
 #endif
 
     D3D_RELEASE(pDevice->pVideoDevice);
@@ -3320,6 +3334,14 @@ static int dxEnsureResource(PVGASTATECC pThisCC, uint32_t sid,
 
 
 #ifdef DX_COMMON_STAGING_BUFFER
+static void dxStagingBufferSelect(DXDEVICE *pDXDevice, uint32_t iStagingBuffer)
+{
+    pDXDevice->iStagingBuffer  = iStagingBuffer;
+    pDXDevice->pStagingBuffer  = pDXDevice->aStagingBuffers[iStagingBuffer].pBuffer;
+    pDXDevice->cbStagingBuffer = pDXDevice->aStagingBuffers[iStagingBuffer].cbBuffer;
+}
+
+
 static int dxStagingBufferRealloc(DXDEVICE *pDXDevice, uint32_t cbRequiredSize)
 {
     AssertReturn(cbRequiredSize < SVGA3D_MAX_SURFACE_MEM_SIZE, VERR_INVALID_PARAMETER);
@@ -3327,7 +3349,8 @@ static int dxStagingBufferRealloc(DXDEVICE *pDXDevice, uint32_t cbRequiredSize)
     if (RT_LIKELY(cbRequiredSize <= pDXDevice->cbStagingBuffer))
         return VINF_SUCCESS;
 
-    D3D_RELEASE(pDXDevice->pStagingBuffer);
+    D3D_RELEASE(pDXDevice->aStagingBuffers[pDXDevice->iStagingBuffer].pBuffer);
+    pDXDevice->pStagingBuffer = NULL;
 
     uint32_t const cbAlloc = RT_ALIGN_32(cbRequiredSize, _64K);
 
@@ -3344,17 +3367,46 @@ static int dxStagingBufferRealloc(DXDEVICE *pDXDevice, uint32_t cbRequiredSize)
     HRESULT hr = pDXDevice->pDevice->CreateBuffer(&bd, pInitialData, &pBuffer);
     if (SUCCEEDED(hr))
     {
-        pDXDevice->pStagingBuffer = pBuffer;
-        pDXDevice->cbStagingBuffer = cbAlloc;
+        pDXDevice->aStagingBuffers[pDXDevice->iStagingBuffer].pBuffer = pBuffer;
+        pDXDevice->aStagingBuffers[pDXDevice->iStagingBuffer].cbBuffer = cbAlloc;
     }
     else
     {
-        pDXDevice->cbStagingBuffer = 0;
+        pDXDevice->aStagingBuffers[pDXDevice->iStagingBuffer].cbBuffer = 0;
         rc = VERR_NO_MEMORY;
     }
+    dxStagingBufferSelect(pDXDevice, pDXDevice->iStagingBuffer);
 
     return rc;
 }
+
+
+/* Maps a common staging buffer for an upload.
+ * The GPU may still be copying a previous upload out of the current staging buffer. Instead of
+ * waiting for it, move on to the next buffer of the ring. Only the last buffer tried is waited for.
+ * The buffer which was mapped becomes the current one, so the caller unmaps pStagingBuffer.
+ */
+static int dxStagingBufferMapForUpload(DXDEVICE *pDXDevice, uint32_t cbRequiredSize, D3D11_MAP d3d11MapType,
+                                       D3D11_MAPPED_SUBRESOURCE *pMappedResource)
+{
+    for (uint32_t iTry = 0; iTry < RT_ELEMENTS(pDXDevice->aStagingBuffers); ++iTry)
+    {
+        int rc = dxStagingBufferRealloc(pDXDevice, cbRequiredSize);
+        if (RT_FAILURE(rc))
+            return rc;
+
+        UINT const MapFlags = iTry + 1 < RT_ELEMENTS(pDXDevice->aStagingBuffers) ? D3D11_MAP_FLAG_DO_NOT_WAIT : 0;
+        UINT const Subresource = 0; /* Buffers have only one subresource. */
+        HRESULT hr = pDXDevice->pImmediateContext->Map(pDXDevice->pStagingBuffer, Subresource,
+                                                       d3d11MapType, MapFlags, pMappedResource);
+        if (SUCCEEDED(hr))
+            return VINF_SUCCESS;
+        AssertMsgReturn(hr == DXGI_ERROR_WAS_STILL_DRAWING, ("hr = %#x\n", hr), VERR_NOT_SUPPORTED);
+
+        dxStagingBufferSelect(pDXDevice, (pDXDevice->iStagingBuffer + 1) % RT_ELEMENTS(pDXDevice->aStagingBuffers));
+    }
+    AssertFailedReturn(VERR_INTERNAL_ERROR);
+}
 #endif
 
 
@@ -3791,34 +3843,41 @@ static DECLCALLBACK(int) vmsvga3dBackSurfaceMap(PVGASTATECC pThisCC, SVGA3dSurfa
     else if (pBackendSurface->enmResType == VMSVGA3D_RESTYPE_BUFFER)
     {
 #ifdef DX_COMMON_STAGING_BUFFER
-        /* Map the staging buffer. */
-        rc = dxStagingBufferRealloc(pDevice, pMipLevel->cbSurface);
-        if (RT_SUCCESS(rc))
+        /* The staging buffer does not allow D3D11_MAP_WRITE_DISCARD, so replace it.  */
+        if (d3d11MapType == D3D11_MAP_WRITE_DISCARD)
+            d3d11MapType = D3D11_MAP_WRITE;
+
+        if (enmMapType != VMSVGA3D_SURFACE_MAP_READ)
+        {
+            /* Uploads do not depend on the previous content of the staging buffer. */
+            rc = dxStagingBufferMapForUpload(pDevice, pMipLevel->cbSurface, d3d11MapType, &mappedResource);
+            if (RT_SUCCESS(rc))
+                vmsvga3dSurfaceMapInit(pMap, enmMapType, &clipBox, pSurface,
+                                       mappedResource.pData, mappedResource.RowPitch, mappedResource.DepthPitch);
+        }
+        else
         {
-            /* The staging buffer does not allow D3D11_MAP_WRITE_DISCARD, so replace it.  */
-            if (d3d11MapType == D3D11_MAP_WRITE_DISCARD)
-                d3d11MapType = D3D11_MAP_WRITE;
+            rc = dxStagingBufferRealloc(pDevice, pMipLevel->cbSurface);
+            if (RT_FAILURE(rc))
+                return rc;
 
-            if (enmMapType == VMSVGA3D_SURFACE_MAP_READ)
-            {
-                /* Copy from the buffer to the staging buffer. */
-                ID3D11Resource *pDstResource = pDevice->pStagingBuffer;
-                UINT DstSubresource = 0;
-                UINT DstX = clipBox.x;
-                UINT DstY = clipBox.y;
-                UINT DstZ = clipBox.z;
-                ID3D11Resource *pSrcResource = pBackendSurface->u.pResource;
-                UINT SrcSubresource = 0;
-                D3D11_BOX SrcBox;
-                SrcBox.left   = clipBox.x;
-                SrcBox.top    = clipBox.y;
-                SrcBox.front  = clipBox.z;
-                SrcBox.right  = clipBox.w;
-                SrcBox.bottom = clipBox.h;
-                SrcBox.back   = clipBox.d;
-                pDevice->pImmediateContext->CopySubresourceRegion(pDstResource, DstSubresource, DstX, DstY, DstZ,
-                                                                  pSrcResource, SrcSubresource, &SrcBox);
-            }
+            /* Copy from the buffer to the staging buffer. */
+            ID3D11Resource *pDstResource = pDevice->pStagingBuffer;
+            UINT DstSubresource = 0;
+            UINT DstX = clipBox.x;
+            UINT DstY = clipBox.y;
+            UINT DstZ = clipBox.z;
+            ID3D11Resource *pSrcResource = pBackendSurface->u.pResource;
+            UINT SrcSubresource = 0;
+            D3D11_BOX SrcBox;
+            SrcBox.left   = clipBox.x;
+            SrcBox.top    = clipBox.y;
+            SrcBox.front  = clipBox.z;
+            SrcBox.right  = clipBox.w;
+            SrcBox.bottom = clipBox.h;
+            SrcBox.back   = clipBox.d;
+            pDevice->pImmediateContext->CopySubresourceRegion(pDstResource, DstSubresource, DstX, DstY, DstZ,
+                                                              pSrcResource, SrcSubresource, &SrcBox);
 
             UINT const Subresource = 0; /* Buffers have only one subresource. */
             HRESULT hr = pDevice->pImmediateContext->Map(pDevice->pStagingBuffer, Subresource,
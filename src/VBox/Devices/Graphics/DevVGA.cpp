@@ -2416,6 +2416,48 @@ static int vmsvgaR3DrawGraphic(PVGASTATE pThis, PVGASTATER3 pThisCC, bool fFullU
 
 # endif /* VBOX_WITH_VMSVGA */
 
+/**
+ * Compares a freshly rendered scanline with the one in the framebuffer and
+ * copies over the part that changed.
+ *
+ * @returns true if anything changed, false if the scanline is identical.
+ * @param   pbDst       The framebuffer scanline (previous frame contents).
+ * @param   pbSrc       The freshly rendered scanline.
+ * @param   cx          The scanline width in pixels.
+ * @param   cbPixel     The framebuffer bytes per pixel.
+ * @param   pxLeft      Where to return the first changed pixel.
+ * @param   pxRight     Where to return the pixel after the last changed one.
+ */
+static bool vgaR3DiffScanline(uint8_t *pbDst, uint8_t const *pbSrc, uint32_t cx, uint32_t cbPixel,
+                              uint32_t *pxLeft, uint32_t *pxRight)
+{
+    uint32_t const cb = cx * cbPixel;
+    uint32_t offFirst = 0;
+    uint32_t offEnd   = cb;
+
+    /* Skip the identical head and tail a qword at a time, then byte-wise. */
+    while (   offFirst + sizeof(uint64_t) <= cb
+           && *(uint64_t const *)&pbDst[offFirst] == *(uint64_t const *)&pbSrc[offFirst])
+        offFirst += sizeof(uint64_t);
+    while (offFirst < cb && pbDst[offFirst] == pbSrc[offFirst])
+        offFirst++;
+    if (offFirst >= cb)
+        return false;
+
+    while (   offEnd - offFirst >= sizeof(uint64_t)
+           && *(uint64_t const *)&pbDst[offEnd - sizeof(uint64_t)] == *(uint64_t const *)&pbSrc[offEnd - sizeof(uint64_t)])
+        offEnd -= sizeof(uint64_t);
+    while (pbDst[offEnd - 1] == pbSrc[offEnd - 1])
+        offEnd--;
+
+    uint32_t const xLeft  = offFirst / cbPixel;
+    uint32_t const xRight = (offEnd + cbPixel - 1) / cbPixel;
+    memcpy(&pbDst[xLeft * cbPixel], &pbSrc[xLeft * cbPixel], (xRight - xLeft) * cbPixel);
+    *pxLeft  = xLeft;
+    *pxRight = xRight;
+    return true;
+}
+
 /**
  * graphic modes
  */
@@ -2545,6 +2587,28 @@ static int vgaR3DrawGraphic(PVGASTATE pThis, PVGASTATER3 pThisCC, bool full_upda
     d = pDrv->pbData;
     linesize = pDrv->cbScanline;
 
+    /*
+     * For partial updates of a framebuffer we render into, the framebuffer
+     * itself holds the previous frame.  Render each dirty scanline to a
+     * scratch line and only take over (and report) the columns that changed,
+     * since a dirty page usually covers far more than the guest touched.
+     */
+    uint8_t *pbDiffLine = NULL;
+    uint32_t const cbPixel = (pDrv->cBits + 7) / 8;
+    if (pThisCC->fScanlineDiff && pThis->fRenderVRAM && !full_update && cbPixel)
+    {
+        uint32_t const cbLine = (uint32_t)disp_width * cbPixel;
+        if (pThisCC->cbDiffLine < cbLine)
+        {
+            RTMemFree(pThisCC->pbDiffLine);
+            pThisCC->pbDiffLine = (uint8_t *)RTMemAlloc(cbLine);
+            pThisCC->cbDiffLine = pThisCC->pbDiffLine ? cbLine : 0;
+        }
+        pbDiffLine = pThisCC->pbDiffLine;
+    }
+    uint32_t xUpdLeft  = UINT32_MAX;
+    uint32_t xUpdRight = 0;
+
     if (!(pThis->vbe_regs[VBE_DISPI_INDEX_ENABLE] & VBE_DISPI_ENABLED))
         pThis->vga_addr_mask = 0x3ffff;
     else
@@ -2578,21 +2642,37 @@ static int vgaR3DrawGraphic(PVGASTATE pThis, PVGASTATER3 pThisCC, bool full_upda
         /* explicit invalidation for the hardware cursor */
         update |= (pThis->invalidated_y_table[y >> 5] >> (y & 0x1f)) & 1;
         if (update) {
-            if (y_start < 0)
-                y_start = y;
+            uint32_t xLeft  = 0;
+            uint32_t xRight = (uint32_t)disp_width;
             if (page0 < page_min)
                 page_min = page0;
             if (page1 > page_max)
                 page_max = page1;
-            if (pThis->fRenderVRAM)
+            if (pbDiffLine) {
+                pfnVgaDrawLine(pThis, pThisCC, pbDiffLine, pThisCC->pbVRam + addr, width);
+                update = vgaR3DiffScanline(d, pbDiffLine, (uint32_t)disp_width, cbPixel, &xLeft, &xRight);
+            } else if (pThis->fRenderVRAM)
                 pfnVgaDrawLine(pThis, pThisCC, d, pThisCC->pbVRam + addr, width);
-            if (pThisCC->cursor_draw_line)
+            if (pThisCC->cursor_draw_line) {
                 pThisCC->cursor_draw_line(pThis, d, y);
-        } else {
+                xLeft  = 0;
+                xRight = (uint32_t)disp_width;
+                update = true;
+            }
+            if (update) {
+                if (y_start < 0)
+                    y_start = y;
+                xUpdLeft  = RT_MIN(xUpdLeft, xLeft);
+                xUpdRight = RT_MAX(xUpdRight, xRight);
+            }
+        }
+        if (!update) {
             if (y_start >= 0) {
                 /* flush to display */
-                pDrv->pfnUpdateRect(pDrv, 0, y_start, disp_width, y - y_start);
+                pDrv->pfnUpdateRect(pDrv, xUpdLeft, y_start, xUpdRight - xUpdLeft, y - y_start);
                 y_start = -1;
+                xUpdLeft  = UINT32_MAX;
+                xUpdRight = 0;
             }
         }
         if (!multi_run) {
@@ -2615,7 +2695,7 @@ static int vgaR3DrawGraphic(PVGASTATE pThis, PVGASTATER3 pThisCC, bool full_upda
     }
     if (y_start >= 0) {
         /* flush to display */
-        pDrv->pfnUpdateRect(pDrv, 0, y_start, disp_width, y - y_start);
+        pDrv->pfnUpdateRect(pDrv, xUpdLeft, y_start, xUpdRight - xUpdLeft, y - y_start);
     }
     /* reset modified pages */
     if (page_max != -1 && reset_dirty) {
@@ -6374,6 +6454,10 @@ static DECLCALLBACK(int) vgaR3Destruct(PPDMDEVINS pDevIns)
         pThisCC->pbLogo = NULL;
     }
 
+    RTMemFree(pThisCC->pbDiffLine);
+    pThisCC->pbDiffLine = NULL;
+    pThisCC->cbDiffLine = 0;
+
 # if defined(VBOX_WITH_VIDEOHWACCEL) || defined(VBOX_WITH_VDMA) || defined(VBOX_WITH_WDDM)
     PDMDevHlpCritSectDelete(pDevIns, &pThis->CritSectIRQ);
 # endif
@@ -6446,6 +6530,7 @@ static DECLCALLBACK(int)   vgaR3Construct(PPDMDEVINS pDevIns, int iInstance, PCF
                                             "|ShowBootMenu"
                                             "|BiosRom"
                                             "|RealRetrace"
+                                            "|ScanlineDiff"
                                             "|CustomVideoModes"
                                             "|HeightReduction"
                                             "|CustomVideoMode1"
@@ -6937,6 +7022,12 @@ static DECLCALLBACK(int)   vgaR3Construct(PPDMDEVINS pDevIns, int iInstance, PCF
     rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "RealRetrace", &pThis->fRealRetrace, false);
     AssertLogRelRCReturn(rc, rc);
 
+    /*
+     * Diffing of dirty scanlines for narrower update rectangles.
+     */
+    rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "ScanlineDiff", &pThisCC->fScanlineDiff, true);
+    AssertLogRelRCReturn(rc, rc);
+
     uint16_t maxBiosXRes;
     rc = pHlp->pfnCFGMQueryU16Def(pCfg, "MaxBiosXRes", &maxBiosXRes, UINT16_MAX);
     AssertLogRelRCReturn(rc, rc);
@@ -591,6 +591,15 @@ typedef struct VGASTATER3
     /** Status LUN: Partner of ILeds. */
     R3PTRTYPE(PPDMILEDCONNECTORS) pLedsConnector;
 
+    /** Scratch scanline for diffing partial updates against the framebuffer
+     * (fRenderVRAM only), allocated on demand. */
+    R3PTRTYPE(uint8_t *)        pbDiffLine;
+    /** The size of the pbDiffLine allocation. */
+    uint32_t                    cbDiffLine;
+    /** Whether to diff dirty scanlines to narrow the update rectangles. */
+    bool                        fScanlineDiff;
+    bool                        afPadding9[3];
+
 #ifdef VBOX_WITH_VMSVGA
     /** The VMSVGA ring-3 state. */
     VMSVGASTATER3               svga;
@@ -111,6 +111,15 @@
 /** Maximum number of times we report a link down to the guest (failure to send frame) */
 #define PCNET_MAX_LINKDOWN_REPORTED     3
 
+/** Poll timer interval while the rings are busy, in milliseconds.
+ * This is the default polling interval of the PCnet card (65536/33MHz). */
+#define PCNET_POLL_INTERVAL_MS          2
+/** Number of consecutive idle polls after which the poll interval is doubled. */
+#define PCNET_POLL_IDLE_STEP            16
+/** Maximum number of times the idle poll interval is doubled (2ms -> 8ms).
+ * Guests relying on polling instead of TDMD see this as added TX latency. */
+#define PCNET_POLL_IDLE_MAX_SHIFT       2
+
 /** Maximum frame size we handle */
 #define MAX_FRAME                       1536
 
@@ -353,6 +362,12 @@ typedef struct PCNETSTATE
 
     /** Last time we polled the queues */
     uint64_t                            u64LastPoll;
+    /** Number of consecutive polls which found no transmit work. */
+    uint32_t                            cPollIdle;
+    /** Whether to stretch the poll interval while the rings are idle. */
+    bool                                fPollIdleBackoff;
+    /** Alignment padding. */
+    uint8_t                             abAlignment6[3];
 
     /** Size of a RX/TX descriptor (8 or 16 bytes according to SWSTYLE */
     int32_t                             iLog2DescSize;
@@ -1508,6 +1523,7 @@ static void pcnetStart(PPDMDEVINS pDevIns, PPCNETSTATE pThis)
     pThis->aCSR[0] &= ~0x0004;       /* clear STOP bit */
     pThis->aCSR[0] |=  0x0002;       /* STRT */
 
+    pThis->cPollIdle = 0;
     pcnetPollTimerStart(pDevIns, pThis); /* start timer if it was stopped */
 }
 
@@ -2261,9 +2277,10 @@ static void pcnetTransmit(PPDMDEVINS pDevIns, PPCNETSTATE pThis, PPCNETSTATECC p
         return;
 
     /*
-     * Clear TDMD.
+     * Clear TDMD and tell the poller that the ring is busy.
      */
     pThis->aCSR[0] &= ~0x0008;
+    pThis->cPollIdle = 0;
 
     /*
      * Transmit pending packets if possible, defer it if we cannot do it
@@ -2635,12 +2652,16 @@ static void pcnetPollRxTx(PPDMDEVINS pDevIns, PPCNETSTATE pThis, PPCNETSTATECC p
 
 /**
  * Start the poller timer.
- * Poll timer interval is fixed to 500Hz. Don't stop it.
+ * Poll timer interval is 500Hz while the transmit ring is busy. After every
+ * PCNET_POLL_IDLE_STEP polls that found nothing to transmit the interval is
+ * doubled, up to PCNET_POLL_IDLE_MAX_SHIFT times. Guests setting TDMD are
+ * served immediately regardless. Don't stop it.
  * @thread EMT, TAP.
  */
 static void pcnetPollTimerStart(PPDMDEVINS pDevIns, PPCNETSTATE pThis)
 {
-    PDMDevHlpTimerSetMillies(pDevIns, pThis->hTimerPoll, 2);
+    unsigned const cShift = RT_MIN(pThis->cPollIdle / PCNET_POLL_IDLE_STEP, PCNET_POLL_IDLE_MAX_SHIFT);
+    PDMDevHlpTimerSetMillies(pDevIns, pThis->hTimerPoll, PCNET_POLL_INTERVAL_MS << cShift);
 }
 
 
@@ -2696,6 +2717,15 @@ static void pcnetPollTimer(PPDMDEVINS pDevIns, PPCNETSTATE pThis, PPCNETSTATECC
         if (RT_UNLIKELY(u64Now - pThis->u64LastPoll > 200000))
         {
             pThis->u64LastPoll = u64Now;
+
+            /* Count this poll as idle unless pcnetTransmit() finds a descriptor
+             * (resetting the counter) or the receive thread waits for buffers. */
+            if (pThis->fMaybeOutOfSpace)
+                pThis->cPollIdle = 0;
+            else if (   pThis->fPollIdleBackoff
+                     && pThis->cPollIdle < PCNET_POLL_IDLE_STEP * PCNET_POLL_IDLE_MAX_SHIFT)
+                pThis->cPollIdle++;
+
             pcnetPollRxTx(pDevIns, pThis, pThisCC);
         }
         if (!PDMDevHlpTimerIsActive(pDevIns, pThis->hTimerPoll))
@@ -4594,6 +4624,7 @@ static DECLCALLBACK(int) pcnetR3NetworkDown_WaitReceiveAvail(PPDMINETWORKDOWN pI
          * is true -- even if (transmit) polling is disabled (CSR_DPOLL). */
         rc2 = PDMDevHlpCritSectEnter(pDevIns, &pThis->CritSect, VERR_SEM_BUSY);
         PDM_CRITSECT_RELEASE_ASSERT_RC_DEV(pDevIns, &pThis->CritSect, rc2);
+        pThis->cPollIdle = 0;
         pcnetPollTimerStart(pDevIns, pThis);
         PDMDevHlpCritSectLeave(pDevIns, &pThis->CritSect);
         PDMDevHlpSUPSemEventWaitNoResume(pDevIns, pThis->hEventOutOfRxSpace, cMillies);
@@ -4986,7 +5017,7 @@ static DECLCALLBACK(int) pcnetR3Construct(PPDMDEVINS pDevIns, int iInstance, PCF
      * Validate configuration.
      */
     PDMDEV_VALIDATE_CONFIG_RETURN(pDevIns,
-                                  "MAC|CableConnected|Am79C973|ChipType|Port|IRQ|LineSpeed|PrivIfEnabled|LinkUpDelay|StatNo",
+                                  "MAC|CableConnected|Am79C973|ChipType|Port|IRQ|LineSpeed|PrivIfEnabled|LinkUpDelay|StatNo|PollIdleBackoff",
                                   "");
     /*
      * Read the configuration.
@@ -5060,6 +5091,14 @@ static DECLCALLBACK(int) pcnetR3Construct(PPDMDEVINS pDevIns, int iInstance, PCF
         LogRel(("PCnet#%d WARNING! Link up delay is set to %u seconds!\n", iInstance, pThis->cMsLinkUpDelay / 1000));
     Log(("#%d Link up delay is set to %u seconds\n", iInstance, pThis->cMsLinkUpDelay / 1000));
 
+    /** @cfgm{PollIdleBackoff, bool, false}
+     * Whether to stretch the poll timer interval (up to 8ms) while the transmit
+     * ring is idle. Saves host CPU, but adds TX latency for guests which don't
+     * set TDMD. */
+    rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "PollIdleBackoff", &pThis->fPollIdleBackoff, false);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("Configuration error: Failed to get the \"PollIdleBackoff\" value"));
+
     uint32_t uStatNo = iInstance;
     rc = pHlp->pfnCFGMQueryU32Def(pCfg, "StatNo", &uStatNo, iInstance);
     if (RT_FAILURE(rc))
@@ -2082,6 +2082,71 @@ static int virtioNetR3CopyRxPktToGuest(PPDMDEVINS pDevIns, PVIRTIONET pThis, PVI
     return VINF_SUCCESS;
 }
 
+/**
+ * Calculates a flow hash for an incoming frame for picking the Rx virtq in
+ * multiqueue mode.
+ *
+ * The hash covers the IPv4/IPv6 source and destination addresses and, for
+ * unfragmented TCP and UDP, the ports, so all frames of a connection end up on
+ * the same Rx queue (and thus the same guest CPU).  Anything else hashes to 0.
+ *
+ * @returns Flow hash.
+ * @param   pbFrame     The ethernet frame.
+ * @param   cbFrame     The size of the frame.
+ * @thread  RX
+ */
+static uint32_t virtioNetR3RxFlowHash(uint8_t const *pbFrame, size_t cbFrame)
+{
+    size_t off = RT_UOFFSETOF(RTNETETHERHDR, EtherType);
+    if (cbFrame < off + sizeof(uint16_t))
+        return 0;
+    uint16_t uEtherType = RT_MAKE_U16(pbFrame[off + 1], pbFrame[off]);
+    off += sizeof(uint16_t);
+    if (uEtherType == RTNET_ETHERTYPE_VLAN)
+    {
+        if (cbFrame < off + 4)
+            return 0;
+        uEtherType = RT_MAKE_U16(pbFrame[off + 3], pbFrame[off + 2]);
+        off += 4;
+    }
+
+    size_t  offAddrs;
+    size_t  cbAddrs;
+    size_t  offPorts;
+    uint8_t bProto;
+    if (uEtherType == RTNET_ETHERTYPE_IPV4)
+    {
+        if (cbFrame < off + 20)
+            return 0;
+        bProto   = pbFrame[off + 9];
+        offAddrs = off + 12;
+        cbAddrs  = 8;
+        offPorts = off + (size_t)(pbFrame[off] & 0xf) * 4;
+        if (RT_MAKE_U16(pbFrame[off + 7], pbFrame[off + 6]) & UINT16_C(0x3fff)) /* MF or fragment offset */
+            bProto = 0;
+    }
+    else if (uEtherType == RTNET_ETHERTYPE_IPV6)
+    {
+        if (cbFrame < off + 40)
+            return 0;
+        bProto   = pbFrame[off + 6];
+        offAddrs = off + 8;
+        cbAddrs  = 32;
+        offPorts = off + 40;
+    }
+    else
+        return 0;
+
+    uint32_t uHash = UINT32_C(0x811c9dc5); /* FNV-1a */
+    for (size_t i = 0; i < cbAddrs; i++)
+        uHash = (uHash ^ pbFrame[offAddrs + i]) * UINT32_C(0x01000193);
+    if (   (bProto == RTNETIPV4_PROT_TCP || bProto == RTNETIPV4_PROT_UDP)
+        && cbFrame >= offPorts + 4)
+        for (size_t i = 0; i < 4; i++)
+            uHash = (uHash ^ pbFrame[offPorts + i]) * UINT32_C(0x01000193);
+    return uHash;
+}
+
 /**
  * @interface_method_impl{PDMINETWORKDOWN,pfnReceiveGso}
  */
@@ -2114,15 +2179,22 @@ static DECLCALLBACK(int) virtioNetR3NetworkDown_ReceiveGso(PPDMINETWORKDOWN pInt
 
         switch (pGso->u8Type)
         {
+            /* Refuse anything the guest didn't negotiate so the caller segments it for us. */
             case PDMNETWORKGSOTYPE_IPV4_TCP:
+                if (!FEATURE_ENABLED(GUEST_TSO4))
+                    return VERR_NOT_SUPPORTED;
                 rxPktHdr.uGsoType = VIRTIONET_HDR_GSO_TCPV4;
                 rxPktHdr.uChksumOffset = RT_OFFSETOF(RTNETTCP, th_sum);
                 break;
             case PDMNETWORKGSOTYPE_IPV6_TCP:
+                if (!FEATURE_ENABLED(GUEST_TSO6))
+                    return VERR_NOT_SUPPORTED;
                 rxPktHdr.uGsoType = VIRTIONET_HDR_GSO_TCPV6;
                 rxPktHdr.uChksumOffset = RT_OFFSETOF(RTNETTCP, th_sum);
                 break;
             case PDMNETWORKGSOTYPE_IPV4_UDP:
+                if (!FEATURE_ENABLED(GUEST_UFO))
+                    return VERR_NOT_SUPPORTED;
                 rxPktHdr.uGsoType = VIRTIONET_HDR_GSO_UDP;
                 rxPktHdr.uChksumOffset = RT_OFFSETOF(RTNETUDP, uh_sum);
                 break;
@@ -2138,11 +2210,15 @@ static DECLCALLBACK(int) virtioNetR3NetworkDown_ReceiveGso(PPDMINETWORKDOWN pInt
 
     /*
      * Find a virtq with Rx bufs on avail ring, if any, and copy the packet to the guest's Rx buffer.
-     * @todo pk: PROBABLY NOT A SOPHISTICATED ENOUGH QUEUE SELECTION ALGORTITH FOR OPTIMAL MQ (FEATURE) SUPPORT
+     * With more than one queue pair in use, start with the queue the flow hashes to so a connection
+     * sticks to one queue, and only fall back on the others if that one is out of buffers.
      */
-    for (int uVirtqPair = 0; uVirtqPair < pThis->cVirtqPairs; uVirtqPair++)
+    uint16_t const cVirtqPairs = pThis->cVirtqPairs;
+    uint16_t const uFirstPair  = cVirtqPairs > 1 ? (uint16_t)(virtioNetR3RxFlowHash((uint8_t const *)pvBuf, cb) % cVirtqPairs) : 0;
+    for (uint16_t iPair = 0; iPair < cVirtqPairs; iPair++)
     {
-        PVIRTIONETVIRTQ pRxVirtq = &pThis->aVirtqs[RXQIDX(uVirtqPair)];
+        uint16_t const  uVirtqPair = (uint16_t)((uFirstPair + iPair) % cVirtqPairs);
+        PVIRTIONETVIRTQ pRxVirtq   = &pThis->aVirtqs[RXQIDX(uVirtqPair)];
         if (RT_SUCCESS(virtioNetR3CheckRxBufsAvail(pDevIns, pThis, pRxVirtq)))
         {
             int rc = VINF_SUCCESS;
@@ -2380,8 +2456,13 @@ static uint8_t virtioNetR3CtrlMultiQueue(PVIRTIONET pThis, PVIRTIONETCC pThisCC,
             /* Fetch number of virtq pairs from guest buffer */
             virtioCoreR3VirtqBufDrain(&pThis->Virtio, pVirtqBuf, &cVirtqPairs, sizeof(cVirtqPairs));
 
-            AssertMsgReturn(cVirtqPairs <= VIRTIONET_MAX_QPAIRS,
-                ("[%s] Guest CTRL MQ virtq pair count out of range [%d])\n", pThis->szInst, cVirtqPairs), VIRTIONET_ERROR);
+            /* VirtIO 1.0, 5.1.6.5.5: The device MUST NOT accept a pair count outside [1, max_virtqueue_pairs]. */
+            if (   cVirtqPairs < VIRTIONET_CTRL_MQ_VQ_PAIRS_MIN
+                || cVirtqPairs > RT_MIN(pThis->virtioNetConfig.uMaxVirtqPairs, VIRTIONET_MAX_QPAIRS))
+            {
+                LogRelMax(16, ("[%s] Guest CTRL MQ virtq pair count out of range [%d]\n", pThis->szInst, cVirtqPairs));
+                return VIRTIONET_ERROR;
+            }
 
             LogFunc(("[%s] Guest specifies %d VQ pairs in use\n", pThis->szInst, cVirtqPairs));
             pThis->cVirtqPairs = cVirtqPairs;
@@ -50,6 +50,7 @@
 #include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/ctype.h>
+#include <iprt/mem.h>
 #include <iprt/memcache.h>
 #include <iprt/net.h>
 #include <iprt/semaphore.h>
@@ -72,6 +73,14 @@
 #define VBOX_WITH_DRVINTNET_IN_R0
 #endif
 
+/** Size of the receive coalescing buffer, i.e. the max coalesced frame size. */
+#define DRVINTNET_RECV_COALESCE_MAX         _64K
+/** Upper limit of the receive busy-poll window, in microseconds. */
+#define DRVINTNET_RECV_BUSY_POLL_MAX_US     1000
+/** Number of frames passed up as-is before trying to coalesce again after the
+ * device above refused a coalesced frame. */
+#define DRVINTNET_RECV_COALESCE_BACKOFF     4096
+
 
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
@@ -173,6 +182,23 @@ typedef struct DRVINTNET
     /** The network name. */
     char                            szNetwork[INTNET_MAX_NETWORK_NAME];
 
+    /** Receive coalescing buffer holding the pending frame, NULL if disabled.
+     * Only accessed by the receive thread. */
+    uint8_t                        *pbRecvCoalesce;
+    /** The GSO context describing the pending coalesced frame. */
+    PDMNETWORKGSO                   RecvCoalesceGso;
+    /** Size of the pending coalesced frame, 0 if none. */
+    uint32_t                        cbRecvCoalesce;
+    /** Number of TCP segments in the pending coalesced frame. */
+    uint32_t                        cRecvCoalesceSegs;
+    /** The TCP sequence number the next segment must have to be appended. */
+    uint32_t                        uRecvCoalesceNextSeq;
+    /** Number of frames left to pass up unchanged before coalescing again. */
+    uint32_t                        cRecvCoalesceBackoff;
+    /** How long the receive thread spins on the ring before blocking in
+     * ring-0, in nanoseconds.  0 if busy-polling is disabled. */
+    uint64_t                        cNsRecvBusyPoll;
+
     /** Number of GSO packets sent. */
     STAMCOUNTER                     StatSentGso;
     /** Number of GSO packets received. */
@@ -187,6 +213,14 @@ typedef struct DRVINTNET
     STAMCOUNTER                     StatXmitWakeupR3;
     /** The times the xmit thread has been told to process the ring. */
     STAMCOUNTER                     StatXmitProcessRing;
+    /** Number of coalesced GSO frames passed up. */
+    STAMCOUNTER                     StatReceivedCoalesced;
+    /** Number of received frames merged into coalesced GSO frames. */
+    STAMCOUNTER                     StatReceivedCoalescedSegs;
+    /** Number of times busy-polling found new frames without blocking. */
+    STAMCOUNTER                     StatRecvBusyPollHits;
+    /** Number of busy-poll windows that expired, making the thread block. */
+    STAMCOUNTER                     StatRecvBusyPollMisses;
 #ifdef VBOX_WITH_STATISTICS
     /** Profiling packet transmit runs. */
     STAMPROFILE                     StatTransmit;
@@ -289,6 +323,7 @@ static int drvR3IntNetCallSvcAsync(PDRVINTNET pThis, uint32_t uOperation, void *
         xpc_dictionary_set_uint64(hObj, "req-id", uOperation);
         xpc_dictionary_set_data(hObj, "req", pvArg, cbArg);
         xpc_connection_send_message(pThis->hXpcCon, hObj);
+        xpc_release(hObj);
         return VINF_SUCCESS;
     }
     else
@@ -457,7 +492,14 @@ DECLINLINE(int) drvIntNetProcessXmit(PDRVINTNET pThis)
     SendReq.Hdr.cbReq = sizeof(SendReq);
     SendReq.pSession = NIL_RTR0PTR;
     SendReq.hIf = pThis->hIf;
+# if defined(RT_OS_DARWIN) && defined(VBOX_WITH_INTNET_SERVICE_IN_R3)
+    /* The frames are already in the shared send ring, so the service only needs
+       a doorbell.  XPC keeps the message order, so there is no need to wait for a
+       reply here, same as the ring-0 path deferring VERR_TRY_AGAIN work. */
+    int rc = drvR3IntNetCallSvcAsync(pThis, VMMR0_DO_INTNET_IF_SEND, &SendReq, sizeof(SendReq));
+# else
     int rc = drvR3IntNetCallSvc(pThis, VMMR0_DO_INTNET_IF_SEND, &SendReq, sizeof(SendReq));
+# endif
 #else
     int rc = IntNetR0IfSend(pThis->hIf, pThis->pSupDrvSession);
     if (rc == VERR_TRY_AGAIN)
@@ -826,6 +868,263 @@ static int drvR3IntNetRecvWaitForSpace(PDRVINTNET pThis)
 }
 
 
+/**
+ * Checks whether a received frame is a TCP segment that may be coalesced with
+ * its neighbours and describes its headers.
+ *
+ * Only plain, unfragmented IPv4 (no options) and IPv6 (no extension headers)
+ * TCP segments with payload, a correct checksum and no flags besides ACK and
+ * PSH qualify.  Anything else terminates coalescing for the flow.
+ *
+ * @returns true if the frame qualifies, false if it must be passed up as-is.
+ * @param   pbFrame     The frame.
+ * @param   cbFrame     The frame size.
+ * @param   pGso        Where to return the GSO context for the frame, with
+ *                      cbMaxSeg set to the payload size.
+ * @param   puSeq       Where to return the TCP sequence number (host order).
+ */
+static bool drvR3IntNetRecvCoalesceCheckFrame(uint8_t const *pbFrame, uint32_t cbFrame, PPDMNETWORKGSO pGso, uint32_t *puSeq)
+{
+    uint32_t const offIp = sizeof(RTNETETHERHDR);
+    uint32_t       offTcp;
+    uint32_t       u32Sum;
+    if (cbFrame < offIp + RTNETIPV4_MIN_LEN + RTNETTCP_MIN_LEN || cbFrame > DRVINTNET_RECV_COALESCE_MAX)
+        return false;
+
+    uint16_t const uEtherType = ((PCRTNETETHERHDR)pbFrame)->EtherType;
+    if (uEtherType == RT_H2N_U16_C(RTNET_ETHERTYPE_IPV4))
+    {
+        PCRTNETIPV4 pIpHdr = (PCRTNETIPV4)&pbFrame[offIp];
+        if (   pIpHdr->ip_v  != 4
+            || pIpHdr->ip_hl != RTNETIPV4_MIN_LEN / 4
+            || pIpHdr->ip_p  != RTNETIPV4_PROT_TCP
+            || (RT_N2H_U16(pIpHdr->ip_off) & (RTNETIPV4_FLAGS_MF | 0x1fff /* fragment offset */))
+            || RT_N2H_U16(pIpHdr->ip_len) != cbFrame - offIp
+            || RTNetIPv4HdrChecksum(pIpHdr) != pIpHdr->ip_sum)
+            return false;
+        offTcp         = offIp + RTNETIPV4_MIN_LEN;
+        u32Sum         = RTNetIPv4PseudoChecksum(pIpHdr);
+        pGso->u8Type   = PDMNETWORKGSOTYPE_IPV4_TCP;
+    }
+    else if (uEtherType == RT_H2N_U16_C(RTNET_ETHERTYPE_IPV6))
+    {
+        PCRTNETIPV6 pIpHdr = (PCRTNETIPV6)&pbFrame[offIp];
+        if (   cbFrame < offIp + RTNETIPV6_MIN_LEN + RTNETTCP_MIN_LEN
+            || (pbFrame[offIp] >> 4) != 6
+            || pIpHdr->ip6_nxt != RTNETIPV4_PROT_TCP
+            || RT_N2H_U16(pIpHdr->ip6_plen) != cbFrame - offIp - RTNETIPV6_MIN_LEN)
+            return false;
+        offTcp         = offIp + RTNETIPV6_MIN_LEN;
+        u32Sum         = RTNetIPv6PseudoChecksum(pIpHdr);
+        pGso->u8Type   = PDMNETWORKGSOTYPE_IPV6_TCP;
+    }
+    else
+        return false;
+
+    PCRTNETTCP     pTcpHdr  = (PCRTNETTCP)&pbFrame[offTcp];
+    uint32_t const cbTcpHdr = pTcpHdr->th_off * 4;
+    if (   cbTcpHdr < RTNETTCP_MIN_LEN
+        || offTcp + cbTcpHdr >= cbFrame /* no payload */
+        || (pTcpHdr->th_flags & ~RTNETTCP_F_PSH) != RTNETTCP_F_ACK)
+        return false;
+
+    uint32_t const cbPayload = cbFrame - offTcp - cbTcpHdr;
+    if (RTNetTCPChecksum(u32Sum, pTcpHdr, &pbFrame[offTcp + cbTcpHdr], cbPayload) != pTcpHdr->th_sum)
+        return false;
+
+    pGso->cbHdrsTotal = (uint8_t)(offTcp + cbTcpHdr);
+    pGso->cbHdrsSeg   = pGso->cbHdrsTotal;
+    pGso->offHdr1     = (uint8_t)offIp;
+    pGso->offHdr2     = (uint8_t)offTcp;
+    pGso->cbMaxSeg    = (uint16_t)cbPayload;
+    pGso->u8Unused    = 0;
+    *puSeq = RT_N2H_U32(pTcpHdr->th_seq);
+    return true;
+}
+
+
+/**
+ * Checks whether a qualifying segment continues the pending coalesced frame.
+ *
+ * @returns true if it can be appended, false if not.
+ * @param   pThis       The driver instance data.
+ * @param   pbFrame     The segment frame.
+ * @param   pGso        The GSO context of the segment as returned by
+ *                      drvR3IntNetRecvCoalesceCheckFrame().
+ * @param   uSeq        The TCP sequence number of the segment.
+ */
+static bool drvR3IntNetRecvCoalesceMatch(PDRVINTNET pThis, uint8_t const *pbFrame, PCPDMNETWORKGSO pGso, uint32_t uSeq)
+{
+    PCPDMNETWORKGSO const pPendGso = &pThis->RecvCoalesceGso;
+    if (   pGso->u8Type      != pPendGso->u8Type
+        || pGso->cbHdrsTotal != pPendGso->cbHdrsTotal
+        || pGso->cbMaxSeg     > pPendGso->cbMaxSeg
+        || uSeq              != pThis->uRecvCoalesceNextSeq
+        || pThis->cbRecvCoalesce + pGso->cbMaxSeg > DRVINTNET_RECV_COALESCE_MAX)
+        return false;
+
+    /*
+     * All the headers must be identical except for the fields that change
+     * from segment to segment.  Copy those over from the pending frame and
+     * compare the lot.
+     */
+    uint8_t const * const pbPend = pThis->pbRecvCoalesce;
+    uint8_t               abHdrs[256];
+    memcpy(abHdrs, pbFrame, pGso->cbHdrsTotal);
+    if (pGso->u8Type == PDMNETWORKGSOTYPE_IPV4_TCP)
+    {
+        PRTNETIPV4  pIpHdr     = (PRTNETIPV4)&abHdrs[pGso->offHdr1];
+        PCRTNETIPV4 pPendIpHdr = (PCRTNETIPV4)&pbPend[pGso->offHdr1];
+        pIpHdr->ip_len = pPendIpHdr->ip_len;
+        pIpHdr->ip_id  = pPendIpHdr->ip_id;
+        pIpHdr->ip_sum = pPendIpHdr->ip_sum;
+    }
+    else
+        ((PRTNETIPV6)&abHdrs[pGso->offHdr1])->ip6_plen = ((PCRTNETIPV6)&pbPend[pGso->offHdr1])->ip6_plen;
+
+    PRTNETTCP  pTcpHdr     = (PRTNETTCP)&abHdrs[pGso->offHdr2];
+    PCRTNETTCP pPendTcpHdr = (PCRTNETTCP)&pbPend[pGso->offHdr2];
+    pTcpHdr->th_seq   = pPendTcpHdr->th_seq;
+    pTcpHdr->th_sum   = pPendTcpHdr->th_sum;
+    pTcpHdr->th_flags = (pTcpHdr->th_flags & ~RTNETTCP_F_PSH) | (pPendTcpHdr->th_flags & RTNETTCP_F_PSH);
+
+    return memcmp(abHdrs, pbPend, pGso->cbHdrsTotal) == 0;
+}
+
+
+/**
+ * Passes the pending coalesced frame up the chain, if any.
+ *
+ * A frame holding a single segment is passed up unchanged.  Otherwise it's
+ * passed up as a GSO frame, and if the device above refuses it (no receive
+ * GSO support in it or the guest), it's split up again and coalescing is
+ * paused for a while.
+ *
+ * @param   pThis       The driver instance data.
+ */
+static void drvR3IntNetRecvCoalesceFlush(PDRVINTNET pThis)
+{
+    uint32_t const cbFrame = pThis->cbRecvCoalesce;
+    if (!cbFrame)
+        return;
+    pThis->cbRecvCoalesce = 0;
+    if (pThis->fLinkDown)
+        return;
+
+    int rc = pThis->pIAboveNet->pfnWaitReceiveAvail(pThis->pIAboveNet, 0);
+    if (rc != VINF_SUCCESS)
+    {
+        rc = drvR3IntNetRecvWaitForSpace(pThis);
+        if (RT_FAILURE(rc))
+        {
+            Log(("drvR3IntNetRecvCoalesceFlush: drvR3IntNetRecvWaitForSpace -> %Rrc; dropping %u segments\n",
+                 rc, pThis->cRecvCoalesceSegs));
+            return;
+        }
+    }
+
+    uint8_t * const pbFrame = pThis->pbRecvCoalesce;
+    if (pThis->cRecvCoalesceSegs == 1)
+    {
+        rc = pThis->pIAboveNet->pfnReceive(pThis->pIAboveNet, pbFrame, cbFrame);
+        AssertRC(rc);
+        return;
+    }
+
+    PCPDMNETWORKGSO const pGso = &pThis->RecvCoalesceGso;
+    PDMNetGsoPrepForDirectUse(pGso, pbFrame, cbFrame, PDMNETCSUMTYPE_PSEUDO);
+    rc = pThis->pIAboveNet->pfnReceiveGso(pThis->pIAboveNet, pbFrame, cbFrame, pGso);
+    if (RT_SUCCESS(rc))
+    {
+        STAM_REL_COUNTER_INC(&pThis->StatReceivedCoalesced);
+        STAM_REL_COUNTER_ADD(&pThis->StatReceivedCoalescedSegs, pThis->cRecvCoalesceSegs);
+        return;
+    }
+
+    Log(("drvR3IntNetRecvCoalesceFlush: pfnReceiveGso -> %Rrc; pausing coalescing\n", rc));
+    pThis->cRecvCoalesceBackoff = DRVINTNET_RECV_COALESCE_BACKOFF;
+
+    uint8_t         abHdrScratch[256];
+    uint32_t const  cSegs = PDMNetGsoCalcSegmentCount(pGso, cbFrame);
+    for (uint32_t iSeg = 0; iSeg < cSegs; iSeg++)
+    {
+        uint32_t cbSegFrame;
+        void    *pvSegFrame = PDMNetGsoCarveSegmentQD(pGso, pbFrame, cbFrame, abHdrScratch, iSeg, cSegs, &cbSegFrame);
+        if (iSeg > 0)
+        {
+            rc = drvR3IntNetRecvWaitForSpace(pThis);
+            if (RT_FAILURE(rc))
+                break; /* we drop the rest. */
+        }
+        rc = pThis->pIAboveNet->pfnReceive(pThis->pIAboveNet, pvSegFrame, cbSegFrame);
+        AssertRC(rc);
+    }
+}
+
+
+/**
+ * Offers a received frame to the coalescing stage (GRO).
+ *
+ * In-order TCP segments of the same flow arriving back to back in the receive
+ * ring are merged into a single GSO frame, sparing the device and guest the
+ * per-segment overhead.  The run ends with a short or PSH segment, a
+ * segment that doesn't match, or when the ring runs empty.
+ *
+ * @returns true if the frame was consumed, false if the caller must pass it up
+ *          (the pending frame has been flushed to preserve ordering).
+ * @param   pThis       The driver instance data.
+ * @param   pbFrame     The frame.
+ * @param   cbFrame     The frame size.
+ */
+static bool drvR3IntNetRecvCoalesce(PDRVINTNET pThis, uint8_t const *pbFrame, uint32_t cbFrame)
+{
+    PDMNETWORKGSO Gso;
+    uint32_t      uSeq;
+    if (pThis->cRecvCoalesceBackoff)
+        pThis->cRecvCoalesceBackoff--;
+    else if (   pThis->pIAboveNet->pfnReceiveGso
+             && drvR3IntNetRecvCoalesceCheckFrame(pbFrame, cbFrame, &Gso, &uSeq))
+    {
+        uint32_t const cbPayload = Gso.cbMaxSeg;
+        bool const     fPush     = RT_BOOL(((PCRTNETTCP)&pbFrame[Gso.offHdr2])->th_flags & RTNETTCP_F_PSH);
+        if (pThis->cbRecvCoalesce)
+        {
+            if (drvR3IntNetRecvCoalesceMatch(pThis, pbFrame, &Gso, uSeq))
+            {
+                memcpy(&pThis->pbRecvCoalesce[pThis->cbRecvCoalesce], &pbFrame[Gso.cbHdrsTotal], cbPayload);
+                pThis->cbRecvCoalesce       += cbPayload;
+                pThis->cRecvCoalesceSegs    += 1;
+                pThis->uRecvCoalesceNextSeq  = uSeq + cbPayload;
+                if (fPush)
+                    ((PRTNETTCP)&pThis->pbRecvCoalesce[Gso.offHdr2])->th_flags |= RTNETTCP_F_PSH;
+
+                if (   fPush
+                    || cbPayload < pThis->RecvCoalesceGso.cbMaxSeg
+                    || pThis->cbRecvCoalesce + cbPayload > DRVINTNET_RECV_COALESCE_MAX)
+                    drvR3IntNetRecvCoalesceFlush(pThis);
+                return true;
+            }
+            drvR3IntNetRecvCoalesceFlush(pThis);
+        }
+
+        /* Start a new run unless this segment ends it right away. */
+        if (!fPush)
+        {
+            memcpy(pThis->pbRecvCoalesce, pbFrame, cbFrame);
+            pThis->RecvCoalesceGso      = Gso;
+            pThis->cbRecvCoalesce       = cbFrame;
+            pThis->cRecvCoalesceSegs    = 1;
+            pThis->uRecvCoalesceNextSeq = uSeq + cbPayload;
+            return true;
+        }
+        return false;
+    }
+
+    drvR3IntNetRecvCoalesceFlush(pThis);
+    return false;
+}
+
+
 /**
  * Executes async I/O (RUNNING mode).
  *
@@ -856,6 +1155,7 @@ static int drvR3IntNetRecvRun(PDRVINTNET pThis)
              */
             if (pThis->enmRecvState != RECVSTATE_RUNNING)
             {
+                pThis->cbRecvCoalesce = 0;
                 STAM_PROFILE_ADV_STOP(&pThis->StatReceive, a);
                 LogFlow(("drvR3IntNetRecvRun: returns VERR_STATE_CHANGED (state changed - #0)\n"));
                 return VERR_STATE_CHANGED;
@@ -868,9 +1168,24 @@ static int drvR3IntNetRecvRun(PDRVINTNET pThis)
                 &&  !pThis->fLinkDown)
             {
                 /*
-                 * Check if there is room for the frame and pass it up.
+                 * Try coalescing TCP segments first.  Frames that aren't
+                 * coalesced must not overtake the pending coalesced frame.
                  */
                 size_t cbFrame = pHdr->cbFrame;
+                if (pThis->pbRecvCoalesce)
+                {
+                    if (   u8Type == INTNETHDR_TYPE_FRAME
+                        && drvR3IntNetRecvCoalesce(pThis, (uint8_t const *)IntNetHdrGetFramePtr(pHdr, pBuf), (uint32_t)cbFrame))
+                    {
+                        IntNetRingSkipFrame(pRingBuf);
+                        continue;
+                    }
+                    drvR3IntNetRecvCoalesceFlush(pThis);
+                }
+
+                /*
+                 * Check if there is room for the frame and pass it up.
+                 */
                 int rc = pThis->pIAboveNet->pfnWaitReceiveAvail(pThis->pIAboveNet, 0);
                 if (rc == VINF_SUCCESS)
                 {
@@ -995,6 +1310,38 @@ static int drvR3IntNetRecvRun(PDRVINTNET pThis)
             }
         } /* while more received data */
 
+        /*
+         * The ring is drained, pass up whatever we've coalesced.
+         */
+        drvR3IntNetRecvCoalesceFlush(pThis);
+
+        /*
+         * Busy-poll the ring for a little while before paying for the ring-0
+         * wait and the wakeup.  Frames arriving meanwhile still signal the
+         * event, so the next wait may return right away; that's harmless.
+         */
+        if (pThis->cNsRecvBusyPoll)
+        {
+            uint64_t const nsStart = RTTimeNanoTS();
+            bool           fHit    = false;
+            do
+            {
+                if (IntNetRingHasMoreToRead(pRingBuf))
+                {
+                    fHit = true;
+                    break;
+                }
+                ASMNopPause();
+            } while (   pThis->enmRecvState == RECVSTATE_RUNNING
+                     && RTTimeNanoTS() - nsStart < pThis->cNsRecvBusyPoll);
+            if (fHit)
+            {
+                STAM_REL_COUNTER_INC(&pThis->StatRecvBusyPollHits);
+                continue;
+            }
+            STAM_REL_COUNTER_INC(&pThis->StatRecvBusyPollMisses);
+        }
+
         /*
          * Wait for data, checking the state before we block.
          */
@@ -1428,6 +1775,10 @@ static DECLCALLBACK(void) drvR3IntNetDestruct(PPDMDRVINS pDrvIns)
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatXmitWakeupR0);
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatXmitWakeupR3);
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatXmitProcessRing);
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReceivedCoalesced);
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReceivedCoalescedSegs);
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatRecvBusyPollHits);
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatRecvBusyPollMisses);
     }
 
     /*
@@ -1471,6 +1822,9 @@ static DECLCALLBACK(void) drvR3IntNetDestruct(PPDMDRVINS pDrvIns)
     RTMemCacheDestroy(pThis->hSgCache);
     pThis->hSgCache = NIL_RTMEMCACHE;
 
+    RTMemFree(pThis->pbRecvCoalesce);
+    pThis->pbRecvCoalesce = NULL;
+
     if (PDMDrvHlpCritSectIsInitialized(pDrvIns, &pThis->XmitLock))
         PDMDrvHlpCritSectDelete(pDrvIns, &pThis->XmitLock);
 }
@@ -1611,7 +1965,9 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
                                   "|TrunkPolicyWire"
                                   "|IsService"
                                   "|IgnoreConnectFailure"
-                                  "|Workaround1",
+                                  "|Workaround1"
+                                  "|ReceiveCoalescing"
+                                  "|ReceiveBusyPoll",
                                   "");
 
     /*
@@ -1829,6 +2185,9 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
 
     /** @cfgm{ReceiveBufferSize, uint32_t, 318 KB}
      * The size of the receive buffer.
+     * GSO frames from other interfaces on the network are passed on intact, so
+     * like the send buffer this should be able to hold a few maximum sized GSO
+     * frames or the switch will drop them when the guest falls behind.
      */
     rc = pHlp->pfnCFGMQueryU32(pCfg, "ReceiveBufferSize", &OpenReq.cbRecv);
     if (rc == VERR_CFGM_VALUE_NOT_FOUND)
@@ -1836,6 +2195,11 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
     else if (RT_FAILURE(rc))
         return PDMDRV_SET_ERROR(pDrvIns, rc,
                                 N_("Configuration error: Failed to get the \"ReceiveBufferSize\" value"));
+    if (OpenReq.cbRecv < 128)
+        return PDMDRV_SET_ERROR(pDrvIns, VERR_OUT_OF_RANGE,
+                                N_("Configuration error: The \"ReceiveBufferSize\" value is too small"));
+    if (OpenReq.cbRecv < VBOX_MAX_GSO_SIZE * 3)
+        LogRel(("DrvIntNet: Warning! ReceiveBufferSize=%u, Recommended minimum size %u bytes.\n", OpenReq.cbRecv, VBOX_MAX_GSO_SIZE * 3));
 
     /** @cfgm{SendBufferSize, uint32_t, 196 KB}
      * The size of the send (transmit) buffer.
@@ -1855,7 +2219,7 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
         return PDMDRV_SET_ERROR(pDrvIns, rc,
                                 N_("Configuration error: The \"SendBufferSize\" value is too small"));
     if (OpenReq.cbSend < VBOX_MAX_GSO_SIZE * 3)
-        LogRel(("DrvIntNet: Warning! SendBufferSize=%u, Recommended minimum size %u butes.\n", OpenReq.cbSend, VBOX_MAX_GSO_SIZE * 4));
+        LogRel(("DrvIntNet: Warning! SendBufferSize=%u, Recommended minimum size %u bytes.\n", OpenReq.cbSend, VBOX_MAX_GSO_SIZE * 3));
 
     /** @cfgm{IsService, boolean, true}
      * This alterns the way the thread is suspended and resumed. When it's being used by
@@ -1902,6 +2266,36 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
     if (fWorkaround1)
         OpenReq.fFlags |= INTNET_OPEN_FLAGS_WORKAROUND_1;
 
+    /** @cfgm{ReceiveCoalescing, boolean, true}
+     * Merge back-to-back TCP segments of the same flow into GSO frames before
+     * passing them up, provided the device above takes GSO frames. */
+    bool fReceiveCoalescing;
+    rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "ReceiveCoalescing", &fReceiveCoalescing, true);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc,
+                                N_("Configuration error: Failed to get the \"ReceiveCoalescing\" value"));
+    if (fReceiveCoalescing)
+    {
+        pThis->pbRecvCoalesce = (uint8_t *)RTMemAlloc(DRVINTNET_RECV_COALESCE_MAX);
+        AssertReturn(pThis->pbRecvCoalesce, VERR_NO_MEMORY);
+    }
+
+    /** @cfgm{ReceiveBusyPoll, uint32_t, 0, 0, 1000, microseconds}
+     * How long the receive thread keeps polling the ring for new frames before
+     * it blocks.  Trades host CPU for lower latency; 0 disables it. */
+    uint32_t cUsRecvBusyPoll;
+    rc = pHlp->pfnCFGMQueryU32Def(pCfg, "ReceiveBusyPoll", &cUsRecvBusyPoll, 0);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc,
+                                N_("Configuration error: Failed to get the \"ReceiveBusyPoll\" value"));
+    if (cUsRecvBusyPoll > DRVINTNET_RECV_BUSY_POLL_MAX_US)
+        return PDMDrvHlpVMSetError(pDrvIns, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                   N_("Configuration error: \"ReceiveBusyPoll\" must not exceed %u microseconds"),
+                                   DRVINTNET_RECV_BUSY_POLL_MAX_US);
+    pThis->cNsRecvBusyPoll = cUsRecvBusyPoll * RT_NS_1US_64;
+    if (cUsRecvBusyPoll)
+        LogRel(("IntNet#%u: Busy-polling the receive ring for %u us\n", pDrvIns->iInstance, cUsRecvBusyPoll));
+
     LogRel(("IntNet#%u: szNetwork={%s} enmTrunkType=%d szTrunk={%s} fFlags=%#x cbRecv=%u cbSend=%u fIgnoreConnectFailure=%RTbool\n",
             pDrvIns->iInstance, OpenReq.szNetwork, OpenReq.enmTrunkType, OpenReq.szTrunk, OpenReq.fFlags,
             OpenReq.cbRecv, OpenReq.cbSend, fIgnoreConnectFailure));
@@ -2018,6 +2412,10 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
     PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->StatReceivedGso,            "Packets/Received-Gso", "The GSO portion of the received packets.");
     PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->StatSentGso,                "Packets/Sent-Gso",     "The GSO portion of the sent packets.");
     PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->StatSentR0,                 "Packets/Sent-R0",      "The ring-0 portion of the sent packets.");
+    PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->StatReceivedCoalesced,      "Packets/Received-Coalesced",      "GSO frames put together from received segments.");
+    PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->StatReceivedCoalescedSegs,  "Packets/Received-CoalescedSegs",  "Received segments merged into GSO frames.");
+    PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->StatRecvBusyPollHits,       "RecvBusyPoll/Hits",    "Times busy-polling found frames without blocking.");
+    PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->StatRecvBusyPollMisses,     "RecvBusyPoll/Misses",  "Times the busy-poll window expired and the thread blocked.");
 
     PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->pBufR3->cStatLost,          "Packets/Lost",         "Number of lost packets.");
     PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->pBufR3->cStatYieldsNok,     "YieldOk",              "Number of times yielding helped fix an overflow.");
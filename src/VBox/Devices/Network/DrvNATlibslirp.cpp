@@ -343,8 +343,9 @@ static DECLCALLBACK(void) drvNATRecvWorker(PDRVNAT pThis, void *pBuf, size_t cb)
 
     rc = RTCritSectLeave(&pThis->DevAccessLock);
     AssertRC(rc);
-    ASMAtomicDecU32(&pThis->cPkts);
-    drvNATNotifyNATThread(pThis, "drvNATRecvWorker");
+    /* Only kick the NAT thread once the queued burst has been delivered. */
+    if (ASMAtomicDecU32(&pThis->cPkts) == 0)
+        drvNATNotifyNATThread(pThis, "drvNATRecvWorker");
     STAM_PROFILE_STOP(&pThis->StatNATRecv, a);
 }
 
@@ -768,11 +769,12 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
              * deep pipe has been filed before drain.
              *
              */
-            /** @todo XXX: Make it reading exactly we need to drain the
-             * pipe.*/
-            char ch;
+            /* Each notification writes a single byte, so read as many as
+               we can in one go rather than taking a poll() round trip for
+               every one of them. */
+            char   achBuf[64];
             size_t cbRead;
-            RTPipeRead(pThis->hPipeRead, &ch, 1, &cbRead);
+            RTPipeRead(pThis->hPipeRead, achBuf, sizeof(achBuf), &cbRead);
         }
 
         /* process _all_ outstanding requests but don't wait */
@@ -1216,12 +1218,20 @@ static DECLCALLBACK(ssize_t) drvNAT_SendPacketCb(const void *pBuf, size_t cb, vo
     if (pThis->pSlirpThread->enmState != PDMTHREADSTATE_RUNNING)
         return -1;
 
-    ASMAtomicIncU32(&pThis->cPkts);
+    /*
+     * The receive thread only goes to sleep once cPkts drops to zero, so it
+     * only needs waking up for the first packet of a burst.  Likewise there is
+     * no point in kicking the NAT thread's poll() when we're called on it,
+     * which is the normal case as libslirp runs on the NAT thread.
+     */
+    bool const fFirst = ASMAtomicIncU32(&pThis->cPkts) == 1;
     int rc = RTReqQueueCallEx(pThis->hRecvReqQueue, NULL /*ppReq*/, 0 /*cMillies*/, RTREQFLAGS_VOID | RTREQFLAGS_NO_WAIT,
                               (PFNRT)drvNATRecvWorker, 3, pThis, pNewBuf, cb);
     AssertRC(rc);
-    drvNATRecvWakeup(pThis->pDrvIns, pThis->pRecvThread);
-    drvNATNotifyNATThread(pThis, "drvNAT_SendPacketCb");
+    if (fFirst)
+        drvNATRecvWakeup(pThis->pDrvIns, pThis->pRecvThread);
+    if (RTThreadSelf() != pThis->pSlirpThread->Thread)
+        drvNATNotifyNATThread(pThis, "drvNAT_SendPacketCb");
     STAM_COUNTER_INC(&pThis->StatQueuePktSent);
     LogFlowFuncLeave();
     return cb;
@@ -37,7 +37,9 @@
 #include <iprt/assert.h>
 #include <iprt/critsect.h>
 #include <iprt/file.h>
+#include <iprt/mem.h>
 #include <iprt/process.h>
+#include <iprt/semaphore.h>
 #include <iprt/string.h>
 #include <iprt/time.h>
 #include <iprt/uuid.h>
@@ -48,6 +50,15 @@
 #include "VBoxDD.h"
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Default size of each of the two capture buffers. */
+#define DRVNETSNIFFER_BUFFER_SIZE_DEF       _512K
+/** How often the writer thread flushes a partially filled buffer. */
+#define DRVNETSNIFFER_FLUSH_INTERVAL_MS     250
+
+
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
@@ -77,8 +88,25 @@ typedef struct DRVNETSNIFFER
     char                    szFilename[RTPATH_MAX];
     /** The filehandle. */
     RTFILE                  hFile;
-    /** The lock serializing the file access. */
+    /** The lock serializing access to the capture buffers. */
     RTCRITSECT              Lock;
+    /** The capture buffers, one is being filled while the other one is written
+     * to the file by the writer thread. */
+    uint8_t                *apbBuf[2];
+    /** Number of bytes used in each capture buffer. */
+    size_t                  acbBuf[2];
+    /** The size of each capture buffer. */
+    size_t                  cbBuf;
+    /** Index of the buffer frames are currently added to (Lock). */
+    uint32_t                iBufActive;
+    /** Number of frames dropped because the writer couldn't keep up (Lock). */
+    uint32_t                cFramesDropped;
+    /** Max number of bytes of each frame (or GSO segment) to capture. */
+    uint32_t                cbSnapLen;
+    /** Event the writer thread waits on. */
+    RTSEMEVENT              hEvtFlush;
+    /** The writer thread. */
+    PPDMTHREAD              pWriterThread;
     /** The NanoTS delta we pass to the pcap writers. */
     uint64_t                StartNanoTS;
     /** Pointer to the driver instance. */
@@ -90,6 +118,108 @@ typedef struct DRVNETSNIFFER
 
 
 
+/**
+ * Adds a frame record to the active capture buffer.
+ *
+ * The frame is dropped rather than waiting for the writer thread when the
+ * buffer is full, so that capturing never stalls the network path.
+ *
+ * @param   pThis       The sniffer instance data.
+ * @param   pGso        The GSO context if a GSO frame, NULL if not.
+ * @param   pvFrame     The frame.
+ * @param   cbFrame     The size of the frame.
+ * @param   cbMax       The max number of bytes available at @a pvFrame.
+ */
+static void drvNetSnifferQueueFrame(PDRVNETSNIFFER pThis, PCPDMNETWORKGSO pGso, const void *pvFrame, size_t cbFrame, size_t cbMax)
+{
+    cbMax = RT_MIN(cbMax, pThis->cbSnapLen);
+
+    RTCritSectEnter(&pThis->Lock);
+    uint32_t const iBuf   = pThis->iBufActive;
+    size_t const   offBuf = pThis->acbBuf[iBuf];
+    size_t const   cbRec  = !pGso
+                          ? PcapBufFrame(&pThis->apbBuf[iBuf][offBuf], pThis->cbBuf - offBuf, pThis->StartNanoTS,
+                                         pvFrame, cbFrame, cbMax)
+                          : PcapBufGsoFrame(&pThis->apbBuf[iBuf][offBuf], pThis->cbBuf - offBuf, pThis->StartNanoTS,
+                                            pGso, pvFrame, cbFrame, cbMax);
+    bool fKick;
+    if (cbRec)
+    {
+        pThis->acbBuf[iBuf] = offBuf + cbRec;
+        fKick = offBuf < pThis->cbBuf / 2 && offBuf + cbRec >= pThis->cbBuf / 2;
+    }
+    else
+    {
+        if (pThis->cFramesDropped++ == 0)
+            LogRel(("NetSniffer: Capture buffer full, dropping frames\n"));
+        fKick = true;
+    }
+    RTCritSectLeave(&pThis->Lock);
+
+    if (fKick)
+        RTSemEventSignal(pThis->hEvtFlush);
+}
+
+
+/**
+ * Writes the active capture buffer to the file and empties it.
+ *
+ * @param   pThis       The sniffer instance data.
+ * @thread  Writer thread, or the destructor once that has terminated.
+ */
+static void drvNetSnifferFlush(PDRVNETSNIFFER pThis)
+{
+    /* Swap buffers so the network path can go on while we write. */
+    RTCritSectEnter(&pThis->Lock);
+    uint32_t const iBuf = pThis->iBufActive;
+    size_t const   cb   = pThis->acbBuf[iBuf];
+    if (cb)
+        pThis->iBufActive = iBuf ^ 1;
+    RTCritSectLeave(&pThis->Lock);
+
+    if (cb)
+    {
+        int rc = RTFileWrite(pThis->hFile, pThis->apbBuf[iBuf], cb, NULL);
+        if (RT_FAILURE(rc))
+            LogRelMax(16, ("NetSniffer: Writing %zu bytes to '%s' failed: %Rrc\n", cb, pThis->szFilename, rc));
+        pThis->acbBuf[iBuf] = 0;
+    }
+}
+
+
+/**
+ * @callback_method_impl{FNPDMTHREADDRV, Writes the captured frames to the file.}
+ */
+static DECLCALLBACK(int) drvNetSnifferWriterThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThread)
+{
+    PDRVNETSNIFFER pThis = PDMINS_2_DATA(pDrvIns, PDRVNETSNIFFER);
+
+    if (pThread->enmState == PDMTHREADSTATE_INITIALIZING)
+        return VINF_SUCCESS;
+
+    while (pThread->enmState == PDMTHREADSTATE_RUNNING)
+    {
+        RTSemEventWait(pThis->hEvtFlush, DRVNETSNIFFER_FLUSH_INTERVAL_MS);
+        drvNetSnifferFlush(pThis);
+    }
+
+    /* Get everything onto the disk when the VM is suspended or powered off. */
+    drvNetSnifferFlush(pThis);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * @callback_method_impl{FNPDMTHREADWAKEUPDRV}
+ */
+static DECLCALLBACK(int) drvNetSnifferWriterWakeUp(PPDMDRVINS pDrvIns, PPDMTHREAD pThread)
+{
+    RT_NOREF(pThread);
+    PDRVNETSNIFFER pThis = PDMINS_2_DATA(pDrvIns, PDRVNETSNIFFER);
+    return RTSemEventSignal(pThis->hEvtFlush);
+}
+
+
 /**
  * @interface_method_impl{PDMINETWORKUP,pfnBeginXmit}
  */
@@ -142,18 +272,10 @@ static DECLCALLBACK(int) drvNetSnifferUp_SendBuf(PPDMINETWORKUP pInterface, PPDM
         return VERR_NET_DOWN;
 
     /* output to sniffer */
-    RTCritSectEnter(&pThis->Lock);
-    if (!pSgBuf->pvUser)
-        PcapFileFrame(pThis->hFile, pThis->StartNanoTS,
-                      pSgBuf->aSegs[0].pvSeg,
-                      pSgBuf->cbUsed,
-                      RT_MIN(pSgBuf->cbUsed, pSgBuf->aSegs[0].cbSeg));
-    else
-        PcapFileGsoFrame(pThis->hFile, pThis->StartNanoTS, (PCPDMNETWORKGSO)pSgBuf->pvUser,
-                         pSgBuf->aSegs[0].pvSeg,
-                         pSgBuf->cbUsed,
-                         RT_MIN(pSgBuf->cbUsed, pSgBuf->aSegs[0].cbSeg));
-    RTCritSectLeave(&pThis->Lock);
+    drvNetSnifferQueueFrame(pThis, (PCPDMNETWORKGSO)pSgBuf->pvUser,
+                            pSgBuf->aSegs[0].pvSeg,
+                            pSgBuf->cbUsed,
+                            RT_MIN(pSgBuf->cbUsed, pSgBuf->aSegs[0].cbSeg));
 
     return pThis->pIBelowNet->pfnSendBuf(pThis->pIBelowNet, pSgBuf, fOnWorkerThread);
 }
@@ -215,9 +337,7 @@ static DECLCALLBACK(int) drvNetSnifferDown_Receive(PPDMINETWORKDOWN pInterface,
     PDRVNETSNIFFER pThis = RT_FROM_MEMBER(pInterface, DRVNETSNIFFER, INetworkDown);
 
     /* output to sniffer */
-    RTCritSectEnter(&pThis->Lock);
-    PcapFileFrame(pThis->hFile, pThis->StartNanoTS, pvBuf, cb, cb);
-    RTCritSectLeave(&pThis->Lock);
+    drvNetSnifferQueueFrame(pThis, NULL, pvBuf, cb, cb);
 
     /* pass up */
     int rc = pThis->pIAboveNet->pfnReceive(pThis->pIAboveNet, pvBuf, cb);
@@ -363,17 +483,40 @@ static DECLCALLBACK(void) drvNetSnifferDestruct(PPDMDRVINS pDrvIns)
     PDRVNETSNIFFER pThis = PDMINS_2_DATA(pDrvIns, PDRVNETSNIFFER);
     PDMDRV_CHECK_VERSIONS_RETURN_VOID(pDrvIns);
 
-    if (RTCritSectIsInitialized(&pThis->Lock))
-        RTCritSectDelete(&pThis->Lock);
-
-    if (RTCritSectIsInitialized(&pThis->XmitLock))
-        RTCritSectDelete(&pThis->XmitLock);
+    if (pThis->pWriterThread)
+    {
+        int rc = PDMDrvHlpThreadDestroy(pDrvIns, pThis->pWriterThread, NULL);
+        AssertRC(rc);
+        pThis->pWriterThread = NULL;
+    }
 
     if (pThis->hFile != NIL_RTFILE)
     {
+        /* Whatever the writer thread didn't get to. */
+        drvNetSnifferFlush(pThis);
+        if (pThis->cFramesDropped)
+            LogRel(("NetSniffer: %u frames were dropped from '%s'\n", pThis->cFramesDropped, pThis->szFilename));
         RTFileClose(pThis->hFile);
         pThis->hFile = NIL_RTFILE;
     }
+
+    if (pThis->hEvtFlush != NIL_RTSEMEVENT)
+    {
+        RTSemEventDestroy(pThis->hEvtFlush);
+        pThis->hEvtFlush = NIL_RTSEMEVENT;
+    }
+
+    for (unsigned i = 0; i < RT_ELEMENTS(pThis->apbBuf); i++)
+    {
+        RTMemFree(pThis->apbBuf[i]);
+        pThis->apbBuf[i] = NULL;
+    }
+
+    if (RTCritSectIsInitialized(&pThis->Lock))
+        RTCritSectDelete(&pThis->Lock);
+
+    if (RTCritSectIsInitialized(&pThis->XmitLock))
+        RTCritSectDelete(&pThis->XmitLock);
 }
 
 
@@ -394,6 +537,7 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
      */
     pThis->pDrvIns                                  = pDrvIns;
     pThis->hFile                                    = NIL_RTFILE;
+    pThis->hEvtFlush                                = NIL_RTSEMEVENT;
     /* The pcap file *must* start at time offset 0,0. */
     pThis->StartNanoTS                              = RTTimeNanoTS() - RTTimeProgramNanoTS();
     /* IBase */
@@ -426,7 +570,7 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
     /*
      * Validate the config.
      */
-    PDMDRV_VALIDATE_CONFIG_RETURN(pDrvIns, "File", "");
+    PDMDRV_VALIDATE_CONFIG_RETURN(pDrvIns, "File|SnapLen|BufferSize", "");
 
     if (pHlp->pfnCFGMGetFirstChild(pCfg))
         LogRel(("NetSniffer: Found child config entries -- are you trying to redirect ports?\n"));
@@ -449,6 +593,36 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
         return rc;
     }
 
+    /*
+     * Max bytes to capture of each frame, 0 means everything.
+     */
+    rc = pHlp->pfnCFGMQueryU32Def(pCfg, "SnapLen", &pThis->cbSnapLen, 0);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc, N_("Configuration error: Failed to get the \"SnapLen\" value"));
+    if (!pThis->cbSnapLen)
+        pThis->cbSnapLen = UINT32_MAX;
+
+    /*
+     * Size of each of the two capture buffers.
+     */
+    uint32_t cbBuf;
+    rc = pHlp->pfnCFGMQueryU32Def(pCfg, "BufferSize", &cbBuf, DRVNETSNIFFER_BUFFER_SIZE_DEF);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc, N_("Configuration error: Failed to get the \"BufferSize\" value"));
+    if (cbBuf < _256K || cbBuf > _64M)
+        return PDMDrvHlpVMSetError(pDrvIns, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                   N_("Configuration error: \"BufferSize\" must be between 256KB and 64MB, not %u bytes"), cbBuf);
+    pThis->cbBuf = cbBuf;
+    for (unsigned i = 0; i < RT_ELEMENTS(pThis->apbBuf); i++)
+    {
+        pThis->apbBuf[i] = (uint8_t *)RTMemAlloc(cbBuf);
+        if (!pThis->apbBuf[i])
+            return VERR_NO_MEMORY;
+    }
+
+    rc = RTSemEventCreate(&pThis->hEvtFlush);
+    AssertRCReturn(rc, rc);
+
     /*
      * Query the network port interface.
      */
@@ -517,6 +691,14 @@ static DECLCALLBACK(int) drvNetSnifferConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pC
      */
     PcapFileHdr(pThis->hFile, RTTimeNanoTS());
 
+    /*
+     * Start the thread writing the capture buffers to the file.
+     */
+    rc = PDMDrvHlpThreadCreate(pDrvIns, &pThis->pWriterThread, pThis, drvNetSnifferWriterThread,
+                               drvNetSnifferWriterWakeUp, 0 /*cbStack*/, RTTHREADTYPE_IO, "NetSniff");
+    if (RT_FAILURE(rc))
+        return PDMDrvHlpVMSetError(pDrvIns, rc, RT_SRC_POS, N_("Netsniffer failed to create the writer thread"));
+
     return VINF_SUCCESS;
 }
 
@@ -77,6 +77,22 @@
 #include "VBoxDD.h"
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Max number of frames the receive thread reads per poll() wakeup. */
+#define DRVTAP_MAX_RECV_FRAMES_PER_POLL     64
+/** Payload size of the recycled transmit buffers, large enough for any
+ * non-GSO frame (incl. VLAN tag). */
+#define DRVTAP_SGBUF_SMALL_CB               2048
+/** Allocation size of the recycled transmit buffers, see
+ * drvTAPNetworkUp_AllocBuf for the layout. */
+#define DRVTAP_SGBUF_SMALL_ALLOC_CB         (  RT_ALIGN_Z(sizeof(PDMSCATTERGATHER), 16) + DRVTAP_SGBUF_SMALL_CB \
+                                             + RT_ALIGN_Z(sizeof(PDMNETWORKGSO), 16))
+/** Max number of free transmit buffers kept for recycling. */
+#define DRVTAP_SGBUF_CACHE_MAX              32
+
+
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
@@ -117,6 +133,11 @@ typedef struct DRVTAP
     /** @todo The transmit thread. */
     /** Transmit lock used by drvTAPNetworkUp_BeginXmit. */
     RTCRITSECT              XmitLock;
+    /** Number of entries in apSgBufFree. Protected by XmitLock. */
+    uint32_t                cSgBufFree;
+    /** Free small transmit buffers for recycling, saves a heap round trip
+     * per frame. Protected by XmitLock. */
+    PPDMSCATTERGATHER       apSgBufFree[DRVTAP_SGBUF_CACHE_MAX];
 
 #ifdef VBOX_WITH_STATISTICS
     /** Number of sent packets. */
@@ -154,6 +175,23 @@ static int              SolarisTAPAttach(PDRVTAP pThis);
 #endif
 
 
+/**
+ * Frees a transmit buffer, returning small ones to the recycling cache.
+ *
+ * @param   pThis           The TAP driver instance data.
+ * @param   pSgBuf          The buffer to free.
+ */
+static void drvTAPFreeSgBuf(PDRVTAP pThis, PPDMSCATTERGATHER pSgBuf)
+{
+    Assert(RTCritSectIsOwner(&pThis->XmitLock));
+    pSgBuf->fFlags = 0;
+    if (   pSgBuf->pvAllocator == pThis
+        && pThis->cSgBufFree < RT_ELEMENTS(pThis->apSgBufFree))
+        pThis->apSgBufFree[pThis->cSgBufFree++] = pSgBuf;
+    else
+        RTMemFree(pSgBuf);
+}
+
 
 /**
  * @interface_method_impl{PDMINETWORKUP,pfnBeginXmit}
@@ -178,20 +216,29 @@ static DECLCALLBACK(int) drvTAPNetworkUp_BeginXmit(PPDMINETWORKUP pInterface, bo
 static DECLCALLBACK(int) drvTAPNetworkUp_AllocBuf(PPDMINETWORKUP pInterface, size_t cbMin,
                                                   PCPDMNETWORKGSO pGso, PPPDMSCATTERGATHER ppSgBuf)
 {
-    RT_NOREF(pInterface);
-#ifdef VBOX_STRICT
     PDRVTAP pThis = PDMINETWORKUP_2_DRVTAP(pInterface);
     Assert(RTCritSectIsOwner(&pThis->XmitLock));
-#endif
 
     /*
      * Allocate a scatter / gather buffer descriptor that is immediately
      * followed by the buffer space of its single segment.  The GSO context
-     * comes after that again.
+     * comes after that again.  Small buffers all have the same size (with
+     * room for a GSO context) and get recycled via apSgBufFree.
      */
-    PPDMSCATTERGATHER pSgBuf = (PPDMSCATTERGATHER)RTMemAlloc(  RT_ALIGN_Z(sizeof(*pSgBuf), 16)
-                                                             + RT_ALIGN_Z(cbMin, 16)
-                                                             + (pGso ? RT_ALIGN_Z(sizeof(*pGso), 16) : 0));
+    PPDMSCATTERGATHER pSgBuf;
+    void             *pvAllocator = NULL;
+    if (cbMin <= DRVTAP_SGBUF_SMALL_CB)
+    {
+        if (pThis->cSgBufFree)
+            pSgBuf = pThis->apSgBufFree[--pThis->cSgBufFree];
+        else
+            pSgBuf = (PPDMSCATTERGATHER)RTMemAlloc(DRVTAP_SGBUF_SMALL_ALLOC_CB);
+        pvAllocator = pThis;
+    }
+    else
+        pSgBuf = (PPDMSCATTERGATHER)RTMemAlloc(  RT_ALIGN_Z(sizeof(*pSgBuf), 16)
+                                               + RT_ALIGN_Z(cbMin, 16)
+                                               + (pGso ? RT_ALIGN_Z(sizeof(*pGso), 16) : 0));
     if (!pSgBuf)
         return VERR_NO_MEMORY;
 
@@ -201,7 +248,7 @@ static DECLCALLBACK(int) drvTAPNetworkUp_AllocBuf(PPDMINETWORKUP pInterface, siz
     pSgBuf->fFlags         = PDMSCATTERGATHER_FLAGS_MAGIC | PDMSCATTERGATHER_FLAGS_OWNER_1;
     pSgBuf->cbUsed         = 0;
     pSgBuf->cbAvailable    = RT_ALIGN_Z(cbMin, 16);
-    pSgBuf->pvAllocator    = NULL;
+    pSgBuf->pvAllocator    = pvAllocator;
     if (!pGso)
         pSgBuf->pvUser     = NULL;
     else
@@ -226,17 +273,13 @@ static DECLCALLBACK(int) drvTAPNetworkUp_AllocBuf(PPDMINETWORKUP pInterface, siz
  */
 static DECLCALLBACK(int) drvTAPNetworkUp_FreeBuf(PPDMINETWORKUP pInterface, PPDMSCATTERGATHER pSgBuf)
 {
-    RT_NOREF(pInterface);
-#ifdef VBOX_STRICT
     PDRVTAP pThis = PDMINETWORKUP_2_DRVTAP(pInterface);
     Assert(RTCritSectIsOwner(&pThis->XmitLock));
-#endif
 
     if (pSgBuf)
     {
         Assert((pSgBuf->fFlags & PDMSCATTERGATHER_FLAGS_MAGIC_MASK) == PDMSCATTERGATHER_FLAGS_MAGIC);
-        pSgBuf->fFlags = 0;
-        RTMemFree(pSgBuf);
+        drvTAPFreeSgBuf(pThis, pSgBuf);
     }
     return VINF_SUCCESS;
 }
@@ -290,8 +333,7 @@ static DECLCALLBACK(int) drvTAPNetworkUp_SendBuf(PPDMINETWORKUP pInterface, PPDM
         }
     }
 
-    pSgBuf->fFlags = 0;
-    RTMemFree(pSgBuf);
+    drvTAPFreeSgBuf(pThis, pSgBuf);
 
     STAM_PROFILE_STOP(&pThis->StatTransmit, a);
     AssertRC(rc);
@@ -383,16 +425,24 @@ static DECLCALLBACK(int) drvTAPAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
             &&  !aFDs[1].revents)
         {
             /*
-             * Read the frame.
+             * Read frames until the device runs dry (the handle is non-blocking),
+             * so that a burst of incoming traffic doesn't cost one poll() round
+             * trip per frame.  The number of frames per wakeup is capped so we
+             * get to check the control pipe and thread state now and then.
              */
-            char achBuf[16384];
-            size_t cbRead = 0;
-            /** @note At least on Linux we will never receive more than one network packet
-             *        after poll() returned successfully. I don't know why but a second
-             *        RTFileRead() operation will return with VERR_TRY_AGAIN in any case. */
-            rc = RTFileRead(pThis->hFileDevice, achBuf, sizeof(achBuf), &cbRead);
-            if (RT_SUCCESS(rc))
+            for (uint32_t cFrames = 0; cFrames < DRVTAP_MAX_RECV_FRAMES_PER_POLL; cFrames++)
             {
+                char achBuf[16384];
+                size_t cbRead = 0;
+                rc = RTFileRead(pThis->hFileDevice, achBuf, sizeof(achBuf), &cbRead);
+                if (RT_FAILURE(rc))
+                {
+                    LogFlow(("drvTAPAsyncIoThread: RTFileRead -> %Rrc (cFrames=%u)\n", rc, cFrames));
+                    if (rc != VERR_TRY_AGAIN && cFrames == 0)
+                        RTThreadYield();
+                    break;
+                }
+
                 /*
                  * Wait for the device to have space for this frame.
                  * Most guests use frame-sized receive buffers, hence non-zero cbMax
@@ -412,10 +462,10 @@ static DECLCALLBACK(int) drvTAPAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
 
                 /*
                  * A return code != VINF_SUCCESS means that we were woken up during a VM
-                 * state transition. Drop the packet and wait for the next one.
+                 * state transition. Drop the packet and go back to waiting.
                  */
                 if (RT_FAILURE(rc1))
-                    continue;
+                    break;
 
                 /*
                  * Pass the data up.
@@ -431,14 +481,12 @@ static DECLCALLBACK(int) drvTAPAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
                 STAM_COUNTER_ADD(&pThis->StatPktRecvBytes, cbRead);
                 rc1 = pThis->pIAboveNet->pfnReceive(pThis->pIAboveNet, achBuf, cbRead);
                 AssertRC(rc1);
-            }
-            else
-            {
-                LogFlow(("drvTAPAsyncIoThread: RTFileRead -> %Rrc\n", rc));
-                if (rc == VERR_INVALID_HANDLE)
+
+                if (pThread->enmState != PDMTHREADSTATE_RUNNING)
                     break;
-                RTThreadYield();
             }
+            if (rc == VERR_INVALID_HANDLE)
+                break;
         }
         else if (   rc > 0
                  && aFDs[1].revents)
@@ -840,6 +888,12 @@ static DECLCALLBACK(void) drvTAPDestruct(PPDMDRVINS pDrvIns)
     if (RTCritSectIsInitialized(&pThis->XmitLock))
         RTCritSectDelete(&pThis->XmitLock);
 
+    /*
+     * Free the recycled transmit buffers.
+     */
+    while (pThis->cSgBufFree)
+        RTMemFree(pThis->apSgBufFree[--pThis->cSgBufFree]);
+
 #ifdef VBOX_WITH_STATISTICS
     /*
      * Deregister statistics.
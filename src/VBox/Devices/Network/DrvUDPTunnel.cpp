@@ -50,6 +50,13 @@
 #include "VBoxDD.h"
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Max number of datagrams drvUDPTunnelReceive passes up per server loop wakeup. */
+#define DRVUDPTUNNEL_MAX_RECV_FRAMES_PER_WAKEUP     64
+
+
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
@@ -81,6 +88,8 @@ typedef struct DRVUDPTUNNEL
     RTCRITSECT              XmitLock;
     /** Server data structure for UDP communication. */
     PRTUDPSERVER            pServer;
+    /** Socket send and receive buffer size, 0 for the OS default. */
+    uint32_t                cbSocketBuf;
 
     /** Flag whether the link is down. */
     bool volatile           fLinkDown;
@@ -316,13 +325,26 @@ static DECLCALLBACK(int) drvUDPTunnelReceive(RTSOCKET Sock, void *pvUser)
     STAM_PROFILE_ADV_START(&pThis->StatReceive, a);
 
     /*
-     * Read the frame.
+     * Read the frames.  The server loop wakes us up for each datagram, so drain
+     * whatever else has queued up on the socket meanwhile before returning to it.
      */
     char achBuf[16384];
-    size_t cbRead = 0;
-    int rc = RTUdpRead(Sock, achBuf, sizeof(achBuf), &cbRead, NULL);
-    if (RT_SUCCESS(rc))
+    for (unsigned cFrames = 0; cFrames < DRVUDPTUNNEL_MAX_RECV_FRAMES_PER_WAKEUP; cFrames++)
     {
+        if (cFrames > 0 && RTSocketSelectOne(Sock, 0) != VINF_SUCCESS)
+            break;
+
+        size_t cbRead = 0;
+        int rc = RTUdpRead(Sock, achBuf, sizeof(achBuf), &cbRead, NULL);
+        if (RT_FAILURE(rc))
+        {
+            STAM_PROFILE_ADV_STOP(&pThis->StatReceive, a);
+            LogFunc(("RTUdpRead -> %Rrc\n", rc));
+            if (rc == VERR_INVALID_HANDLE)
+                return VERR_UDP_SERVER_STOP;
+            return VINF_SUCCESS;
+        }
+
         if (!pThis->fLinkDown)
         {
             /*
@@ -368,19 +390,34 @@ static DECLCALLBACK(int) drvUDPTunnelReceive(RTSOCKET Sock, void *pvUser)
             AssertRC(rc);
         }
     }
-    else
-    {
-        STAM_PROFILE_ADV_STOP(&pThis->StatReceive, a);
-        LogFunc(("RTUdpRead -> %Rrc\n", rc));
-        if (rc == VERR_INVALID_HANDLE)
-            return VERR_UDP_SERVER_STOP;
-    }
 
     STAM_PROFILE_ADV_STOP(&pThis->StatReceive, a);
     return VINF_SUCCESS;
 }
 
 
+/**
+ * Creates the UDP server and applies the configured socket buffer size.
+ *
+ * @returns VBox status code.
+ * @param   pThis       The UDP tunnel instance data.
+ */
+static int drvUDPTunnelStartServer(PDRVUDPTUNNEL pThis)
+{
+    int rc = RTUdpServerCreate("", pThis->uSrcPort, RTTHREADTYPE_IO, pThis->pszInstance,
+                               drvUDPTunnelReceive, pThis->pDrvIns, &pThis->pServer);
+    if (RT_SUCCESS(rc) && pThis->cbSocketBuf)
+    {
+        /* Not fatal, the OS may clamp or refuse the size. */
+        int rc2 = RTUdpServerSetBufferSizes(pThis->pServer, pThis->cbSocketBuf, pThis->cbSocketBuf);
+        if (RT_FAILURE(rc2))
+            LogRel(("UDPTunnel#%d: Failed to set the socket buffer size to %u bytes: %Rrc\n",
+                    pThis->pDrvIns->iInstance, pThis->cbSocketBuf, rc2));
+    }
+    return rc;
+}
+
+
 /* -=-=-=-=- PDMIBASE -=-=-=-=- */
 
 /**
@@ -500,7 +537,8 @@ static DECLCALLBACK(int) drvUDPTunnelConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCf
      */
     PDMDRV_VALIDATE_CONFIG_RETURN(pDrvIns,  "sport"
                                             "|dest"
-                                            "|dport",
+                                            "|dport"
+                                            "|SocketBufferSize",
                                             "");
 
     /*
@@ -550,6 +588,11 @@ static DECLCALLBACK(int) drvUDPTunnelConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCf
         rc = PDMDRV_SET_ERROR(pDrvIns, rc,
                               N_("DrvUDPTunnel: Configuration error: Querying \"dest\" as string failed"));
 
+    rc = pHlp->pfnCFGMQueryU32Def(pCfg, "SocketBufferSize", &pThis->cbSocketBuf, 0);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc,
+                                N_("DrvUDPTunnel: Configuration error: Querying \"SocketBufferSize\" as integer failed"));
+
     LogRel(("UDPTunnel#%d: sport=%d;dest=%s;dport=%d\n", pDrvIns->iInstance, pThis->uSrcPort, pThis->pszDestIP, pThis->uDestPort));
 
     /*
@@ -567,8 +610,7 @@ static DECLCALLBACK(int) drvUDPTunnelConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCf
     /*
      * Start the UDP receiving thread.
      */
-    rc = RTUdpServerCreate("", pThis->uSrcPort, RTTHREADTYPE_IO, pThis->pszInstance,
-                           drvUDPTunnelReceive, pDrvIns, &pThis->pServer);
+    rc = drvUDPTunnelStartServer(pThis);
     if (RT_FAILURE(rc))
         return PDMDrvHlpVMSetError(pThis->pDrvIns, VERR_PDM_HIF_OPEN_FAILED, RT_SRC_POS,
                                    N_("UDPTunnel: Failed to start the UDP tunnel server"));
@@ -611,8 +653,7 @@ static DECLCALLBACK(void) drvUDPTunnelResume(PPDMDRVINS pDrvIns)
     LogFlowFunc(("\n"));
     PDRVUDPTUNNEL pThis = PDMINS_2_DATA(pDrvIns, PDRVUDPTUNNEL);
 
-    int rc = RTUdpServerCreate("", pThis->uSrcPort, RTTHREADTYPE_IO, pThis->pszInstance,
-                               drvUDPTunnelReceive, pDrvIns, &pThis->pServer);
+    int rc = drvUDPTunnelStartServer(pThis);
     if (RT_FAILURE(rc))
         PDMDrvHlpVMSetError(pThis->pDrvIns, VERR_PDM_HIF_OPEN_FAILED, RT_SRC_POS,
                             N_("UDPTunnel: Failed to start the UDP tunnel server"));
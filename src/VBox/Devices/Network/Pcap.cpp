@@ -33,6 +33,7 @@
 
 #include <iprt/file.h>
 #include <iprt/stream.h>
+#include <iprt/string.h>
 #include <iprt/time.h>
 #include <iprt/errcore.h>
 #include <VBox/vmm/pdmnetinline.h>
@@ -265,3 +266,78 @@ int PcapFileGsoFrame(RTFILE File, uint64_t StartNanoTS, PCPDMNETWORKGSO pGso,
     return VINF_SUCCESS;
 }
 
+
+/**
+ * Formats a frame record into a memory buffer.
+ *
+ * @returns Number of bytes stored, 0 if the record doesn't fit.
+ *
+ * @param   pvDst           Where to store the record.
+ * @param   cbDst           The amount of space available at @a pvDst.
+ * @param   StartNanoTS     What to subtract from the RTTimeNanoTS output.
+ * @param   pvFrame         The start of the frame.
+ * @param   cbFrame         The size of the frame.
+ * @param   cbMax           The max number of bytes to include in the record.
+ */
+size_t PcapBufFrame(void *pvDst, size_t cbDst, uint64_t StartNanoTS, const void *pvFrame, size_t cbFrame, size_t cbMax)
+{
+    struct pcaprec_hdr Hdr;
+    pcapCalcHeader(&Hdr, StartNanoTS, cbFrame, cbMax);
+    size_t const cbRec = sizeof(Hdr) + Hdr.incl_len;
+    if (cbRec > cbDst)
+        return 0;
+    memcpy(pvDst, &Hdr, sizeof(Hdr));
+    memcpy((uint8_t *)pvDst + sizeof(Hdr), pvFrame, Hdr.incl_len);
+    return cbRec;
+}
+
+
+/**
+ * Formats the segment records of a GSO frame into a memory buffer.
+ *
+ * @returns Number of bytes stored, 0 if the records don't all fit.
+ *
+ * @param   pvDst           Where to store the records.
+ * @param   cbDst           The amount of space available at @a pvDst.
+ * @param   StartNanoTS     What to subtract from the RTTimeNanoTS output.
+ * @param   pGso            Pointer to the GSO context.
+ * @param   pvFrame         The start of the GSO frame.
+ * @param   cbFrame         The size of the GSO frame.
+ * @param   cbSegMax        The max number of bytes to include in the record
+ *                          for each segment.
+ */
+size_t PcapBufGsoFrame(void *pvDst, size_t cbDst, uint64_t StartNanoTS, PCPDMNETWORKGSO pGso,
+                       const void *pvFrame, size_t cbFrame, size_t cbSegMax)
+{
+    struct pcaprec_hdr Hdr;
+    pcapCalcHeader(&Hdr, StartNanoTS, 0, 0);
+
+    uint8_t        *pbDst   = (uint8_t *)pvDst;
+    size_t          offDst  = 0;
+    uint8_t const  *pbFrame = (uint8_t const *)pvFrame;
+    uint8_t         abHdrs[256];
+    uint32_t const  cSegs   = PDMNetGsoCalcSegmentCount(pGso, cbFrame);
+    for (uint32_t iSeg = 0; iSeg < cSegs; iSeg++)
+    {
+        uint32_t cbSegPayload, cbHdrs;
+        uint32_t offSegPayload = PDMNetGsoCarveSegment(pGso, pbFrame, cbFrame, iSeg, cSegs, abHdrs, &cbHdrs, &cbSegPayload);
+
+        pcapUpdateHeader(&Hdr, cbHdrs + cbSegPayload, cbSegMax);
+        if (sizeof(Hdr) + Hdr.incl_len > cbDst - offDst)
+            return 0;
+
+        memcpy(&pbDst[offDst], &Hdr, sizeof(Hdr));
+        offDst += sizeof(Hdr);
+        uint32_t const cbHdrsCopy = RT_MIN(Hdr.incl_len, cbHdrs);
+        memcpy(&pbDst[offDst], abHdrs, cbHdrsCopy);
+        offDst += cbHdrsCopy;
+        if (Hdr.incl_len > cbHdrs)
+        {
+            memcpy(&pbDst[offDst], pbFrame + offSegPayload, Hdr.incl_len - cbHdrs);
+            offDst += Hdr.incl_len - cbHdrs;
+        }
+    }
+
+    return offDst;
+}
+
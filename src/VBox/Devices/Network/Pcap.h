@@ -46,6 +46,10 @@ int PcapFileFrame(RTFILE File, uint64_t StartNanoTS, const void *pvFrame, size_t
 int PcapFileGsoFrame(RTFILE File, uint64_t StartNanoTS, PCPDMNETWORKGSO pGso,
                      const void *pvFrame, size_t cbFrame, size_t cbSegMax);
 
+size_t PcapBufFrame(void *pvDst, size_t cbDst, uint64_t StartNanoTS, const void *pvFrame, size_t cbFrame, size_t cbMax);
+size_t PcapBufGsoFrame(void *pvDst, size_t cbDst, uint64_t StartNanoTS, PCPDMNETWORKGSO pGso,
+                       const void *pvFrame, size_t cbFrame, size_t cbSegMax);
+
 RT_C_DECLS_END
 
 #endif /* !VBOX_INCLUDED_SRC_Network_Pcap_h */
@@ -335,6 +335,10 @@ typedef struct ACPISTATE
     uint16_t            cCpus;
 
     uint64_t            u64PmTimerInitial;
+    /** PM Timer ticks since u64PmTimerInitial (not wrapped to TMR_VAL) last
+     *  returned to the guest, for keeping lockless reads monotonic (see
+     *  acpiPMTmrRead).  Not saved, cleared on reset and state load. */
+    uint64_t volatile   cPmTimerTicksLastRead;
     /** The PM timer. */
     TMTIMERHANDLE       hPmTimer;
     /* PM Timer last calculated value */
@@ -406,8 +410,10 @@ typedef struct ACPISTATE
     bool                fUseIommuAmd;
     /** If the IOMMU (Intel) device should be enabled */
     bool                fUseIommuIntel;
+    /** Number of guest NUMA nodes described by SRAT/SLIT, 0 if not shown to the guest. */
+    uint8_t             cNumaNodes;
     /** Padding. */
-    bool                afPadding0[3];
+    bool                afPadding0[2];
     /** Primary NIC PCI address. */
     uint32_t            u32NicPciAddress;
     /** HD Audio PCI address. */
@@ -925,6 +931,61 @@ typedef struct ACPITBLMCFGENTRY
 } ACPITBLMCFGENTRY;
 AssertCompileSize(ACPITBLMCFGENTRY, 16);
 
+/** System Resource Affinity Table (SRAT) header */
+typedef struct ACPITBLSRAT
+{
+    ACPITBLHEADER aHeader;
+    uint32_t      u32Reserved1;                 /**< must be 1 for backward compatibility */
+    uint64_t      u64Reserved2;
+} ACPITBLSRAT;
+AssertCompileSize(ACPITBLSRAT, 48);
+
+/** SRAT Processor Local APIC Affinity Structure */
+typedef struct ACPITBLSRATLAPIC
+{
+    uint8_t       u8Type;                       /**< 0 = Processor Local APIC Affinity */
+    uint8_t       u8Length;                     /**< 16 */
+    uint8_t       u8ProximityDomainLo;          /**< bits [7:0] of the proximity domain */
+    uint8_t       u8ApicId;                     /**< local APIC ID */
+    uint32_t      u32Flags;                     /**< bit 0: enabled */
+    uint8_t       u8LocalSapicEid;              /**< local SAPIC EID, 0 */
+    uint8_t       au8ProximityDomainHi[3];      /**< bits [31:8] of the proximity domain */
+    uint32_t      u32ClockDomain;               /**< clock domain the processor belongs to */
+} ACPITBLSRATLAPIC;
+AssertCompileSize(ACPITBLSRATLAPIC, 16);
+#define SRAT_LAPIC_ENABLED      0x1
+
+/** SRAT Memory Affinity Structure */
+typedef struct ACPITBLSRATMEM
+{
+    uint8_t       u8Type;                       /**< 1 = Memory Affinity */
+    uint8_t       u8Length;                     /**< 40 */
+    uint32_t      u32ProximityDomain;           /**< proximity domain */
+    uint16_t      u16Reserved1;
+    uint64_t      u64BaseAddress;               /**< base address of the memory range */
+    uint64_t      u64Length;                    /**< length of the memory range */
+    uint32_t      u32Reserved2;
+    uint32_t      u32Flags;                     /**< bit 0: enabled, bit 1: hot pluggable, bit 2: non-volatile */
+    uint64_t      u64Reserved3;
+} ACPITBLSRATMEM;
+AssertCompileSize(ACPITBLSRATMEM, 40);
+#define SRAT_MEM_ENABLED        0x1
+
+/** System Locality Information Table (SLIT) header, followed by the
+ *  cLocalities x cLocalities distance matrix. */
+typedef struct ACPITBLSLIT
+{
+    ACPITBLHEADER aHeader;
+    uint64_t      u64Localities;                /**< number of system localities */
+} ACPITBLSLIT;
+AssertCompileSize(ACPITBLSLIT, 44);
+/** Maximum number of NUMA nodes which can be shown to the guest. */
+#define ACPI_NUMA_NODES_MAX     16
+/** SLIT distance of a node to itself. */
+#define SLIT_DISTANCE_LOCAL     10
+/** SLIT distance between two different nodes. */
+#define SLIT_DISTANCE_REMOTE    20
+
 #define PCAT_COMPAT   0x1                       /**< system has also a dual-8259 setup */
 
 /** Custom Description Table */
@@ -2033,6 +2094,32 @@ static DECLCALLBACK(VBOXSTRICTRC) acpiR3PM1aCtlWrite(PPDMDEVINS pDevIns, void *p
 
 #endif /* IN_RING3 */
 
+/**
+ * Makes sure the PM timer value returned to the guest doesn't go backwards
+ * between concurrent lockless readers.
+ *
+ * This works on the unwrapped tick count, as comparing TMR_VAL values would
+ * mistake a read coming just short of a full wrap-around after the previous
+ * one for a step back.  Only small steps back are suppressed, should the clock
+ * origin have moved (reset, state load) the new value is taken as is.
+ *
+ * @returns The TMR_VAL value to return to the guest.
+ * @param   pThis       The ACPI instance.
+ * @param   cTicks      The freshly calculated PM timer ticks since
+ *                      u64PmTimerInitial.
+ */
+DECLINLINE(uint32_t) acpiPmTimerMakeMonotonic(PACPISTATE pThis, uint64_t cTicks)
+{
+    for (;;)
+    {
+        uint64_t const cTicksPrev = ASMAtomicReadU64(&pThis->cPmTimerTicksLastRead);
+        if (cTicks < cTicksPrev && cTicksPrev - cTicks < PM_TMR_FREQ / 10 /* 100ms */)
+            return (uint32_t)cTicksPrev & TMR_VAL_MASK;
+        if (ASMAtomicCmpXchgU64(&pThis->cPmTimerTicksLastRead, cTicks, cTicksPrev))
+            return (uint32_t)cTicks & TMR_VAL_MASK;
+    }
+}
+
 /**
  * @callback_method_impl{FNIOMIOPORTNEWIN, PMTMR}
  *
@@ -2044,18 +2131,40 @@ static DECLCALLBACK(VBOXSTRICTRC) acpiPMTmrRead(PPDMDEVINS pDevIns, void *pvUser
     if (cb != 4)
         return VERR_IOM_IOPORT_UNUSED;
 
+    PACPISTATE pThis = PDMDEVINS_2_DATA(pDevIns, PACPISTATE);
+
+    /*
+     * Reading TMR_VAL only has side effects when its MSB toggles (TMR_STS is
+     * raised then).  So, as long as the MSB stays the same as in the last
+     * calculated value, compute the value straight from the clock without
+     * taking any locks.  u64PmTimerInitial only changes on construction,
+     * reset and state load; none of which runs concurrently with the guest
+     * reading the timer.  uPmTimerVal is updated by the timer callback right
+     * after each MSB toggle.
+     */
+    uint32_t const uPmTimerValPrev = ASMAtomicReadU32(&pThis->uPmTimerVal);
+    uint64_t const u64NowLockless  = PDMDevHlpTimerGet(pDevIns, pThis->hPmTimer);
+    uint64_t const cTicks          = ASMMultU64ByU32DivByU32(u64NowLockless - pThis->u64PmTimerInitial, PM_TMR_FREQ,
+                                                             PDMDevHlpTimerGetFreq(pDevIns, pThis->hPmTimer));
+    if (!(((uint32_t)cTicks ^ uPmTimerValPrev) & TMR_VAL_MSB))
+    {
+        *pu32 = acpiPmTimerMakeMonotonic(pThis, cTicks);
+        Log(("acpi: acpiPMTmrRead -> %#x (lockless)\n", *pu32));
+        return VINF_SUCCESS;
+    }
+
     /*
      * We use the clock lock to serialize access to u64PmTimerInitial and to
      * make sure we get a reliable time from the clock
      * as well as and to prevent uPmTimerVal from being updated during read.
      */
-    PACPISTATE pThis = PDMDEVINS_2_DATA(pDevIns, PACPISTATE);
     VBOXSTRICTRC rc = PDMDevHlpTimerLockClock2(pDevIns, pThis->hPmTimer, &pThis->CritSect, VINF_IOM_R3_IOPORT_READ);
     if (rc == VINF_SUCCESS)
     {
         uint64_t u64Now = PDMDevHlpTimerGet(pDevIns, pThis->hPmTimer);
         acpiPmTimerUpdate(pDevIns, pThis, u64Now);
-        *pu32 = pThis->uPmTimerVal;
+        *pu32 = acpiPmTimerMakeMonotonic(pThis, ASMMultU64ByU32DivByU32(u64Now - pThis->u64PmTimerInitial, PM_TMR_FREQ,
+                                                                        PDMDevHlpTimerGetFreq(pDevIns, pThis->hPmTimer)));
 
         PDMDevHlpTimerUnlockClock2(pDevIns, pThis->hPmTimer, &pThis->CritSect);
 
@@ -2852,6 +2961,8 @@ static DECLCALLBACK(int) acpiR3LoadState(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, ui
         PDMDevHlpTimerLockClock(pDevIns, pThis->hPmTimer, VERR_IGNORED);
         DEVACPI_LOCK_R3(pDevIns, pThis);
         uint64_t u64Now = PDMDevHlpTimerGet(pDevIns, pThis->hPmTimer);
+        /* u64PmTimerInitial was restored, so the last read value is meaningless now. */
+        ASMAtomicWriteU64(&pThis->cPmTimerTicksLastRead, 0);
         /* The interrupt may be incorrectly re-generated if the state is restored from versions < 7. */
         acpiPmTimerUpdate(pDevIns, pThis, u64Now);
         acpiR3PmTimerReset(pDevIns, pThis, u64Now);
@@ -3647,6 +3758,143 @@ static void acpiR3SetupMcfg(PPDMDEVINS pDevIns, PACPISTATE pThis, RTGCPHYS32 GCP
     acpiR3PhysCopy(pDevIns, GCPhysDst, (const uint8_t *)&tbl, sizeof(tbl));
 }
 
+/**
+ * Returns the size of the SRAT for the given configuration.
+ *
+ * @returns Size of the table in bytes.
+ * @param   pThis       The ACPI shared instance data.
+ */
+static uint32_t acpiR3SratSize(PACPISTATE pThis)
+{
+    /* The memory range of one node can be split by the PCI hole below 4GB, hence one extra memory entry. */
+    return sizeof(ACPITBLSRAT)
+         + pThis->cCpus * sizeof(ACPITBLSRATLAPIC)
+         + (pThis->cNumaNodes + 1) * sizeof(ACPITBLSRATMEM);
+}
+
+/**
+ * Returns the proximity domain a CPU belongs to.
+ *
+ * The CPUs are distributed evenly and contiguously over the nodes.
+ *
+ * @returns Proximity domain of the CPU.
+ * @param   pThis       The ACPI shared instance data.
+ * @param   idCpu       The CPU ID.
+ */
+DECLINLINE(uint32_t) acpiR3NumaNodeFromCpu(PACPISTATE pThis, uint32_t idCpu)
+{
+    return idCpu * pThis->cNumaNodes / pThis->cCpus;
+}
+
+/**
+ * Used by acpiR3PlantTables to plant the System Resource Affinity Table (SRAT).
+ *
+ * The guest RAM (below and above 4GB) is split into equally sized, contiguous
+ * ranges, one per node, which are assigned to the proximity domains in order.
+ *
+ * @param   pDevIns     The device instance.
+ * @param   pThis       The ACPI shared instance data.
+ * @param   GCPhysDst   Where to plant it.
+ * @param   cbAbove4GB  Amount of RAM above 4GB.
+ */
+static void acpiR3SetupSrat(PPDMDEVINS pDevIns, PACPISTATE pThis, RTGCPHYS32 GCPhysDst, uint64_t cbAbove4GB)
+{
+    uint32_t const cbSrat = acpiR3SratSize(pThis);
+    uint8_t *pbSrat = (uint8_t *)PDMDevHlpMMHeapAllocZ(pDevIns, cbSrat);
+    AssertReturnVoid(pbSrat);
+
+    ACPITBLSRAT *pHdr = (ACPITBLSRAT *)pbSrat;
+    pHdr->u32Reserved1 = RT_H2LE_U32(1);
+
+    uint32_t off = sizeof(ACPITBLSRAT);
+    for (uint32_t idCpu = 0; idCpu < pThis->cCpus; idCpu++)
+    {
+        ACPITBLSRATLAPIC *pLApic = (ACPITBLSRATLAPIC *)&pbSrat[off];
+        pLApic->u8Type              = 0;
+        pLApic->u8Length            = sizeof(ACPITBLSRATLAPIC);
+        pLApic->u8ProximityDomainLo = (uint8_t)acpiR3NumaNodeFromCpu(pThis, idCpu);
+        /** Must match the numbering convention in the MADT. */
+        pLApic->u8ApicId            = (uint8_t)idCpu;
+        pLApic->u32Flags            = RT_H2LE_U32(SRAT_LAPIC_ENABLED);
+        off += sizeof(ACPITBLSRATLAPIC);
+    }
+
+    uint64_t const cbRamLow   = pThis->cbRamLow;
+    uint64_t const cbRamTotal = cbRamLow + cbAbove4GB;
+    uint64_t const cbPerNode  = RT_ALIGN_64(cbRamTotal / pThis->cNumaNodes, _1M);
+    uint64_t       offRam     = 0;
+    for (uint32_t iNode = 0; iNode < pThis->cNumaNodes && offRam < cbRamTotal; iNode++)
+    {
+        uint64_t offRamEnd = iNode == pThis->cNumaNodes - 1U ? cbRamTotal : RT_MIN(offRam + cbPerNode, cbRamTotal);
+        while (offRam < offRamEnd)
+        {
+            /* Translate the linear RAM offset into a guest physical range, skipping the hole below 4GB. */
+            RTGCPHYS GCPhysStart;
+            uint64_t cbRange;
+            if (offRam < cbRamLow)
+            {
+                GCPhysStart = offRam;
+                cbRange     = RT_MIN(offRamEnd, cbRamLow) - offRam;
+            }
+            else
+            {
+                GCPhysStart = _4G + (offRam - cbRamLow);
+                cbRange     = offRamEnd - offRam;
+            }
+
+            AssertBreak(off + sizeof(ACPITBLSRATMEM) <= cbSrat);
+            ACPITBLSRATMEM *pMem = (ACPITBLSRATMEM *)&pbSrat[off];
+            pMem->u8Type             = 1;
+            pMem->u8Length           = sizeof(ACPITBLSRATMEM);
+            pMem->u32ProximityDomain = RT_H2LE_U32(iNode);
+            pMem->u64BaseAddress     = RT_H2LE_U64(GCPhysStart);
+            pMem->u64Length          = RT_H2LE_U64(cbRange);
+            pMem->u32Flags           = RT_H2LE_U32(SRAT_MEM_ENABLED);
+            off    += sizeof(ACPITBLSRATMEM);
+            offRam += cbRange;
+
+            LogRel(("ACPI: NUMA node %u: memory %#018RX64..%#018RX64\n", iNode, GCPhysStart, GCPhysStart + cbRange - 1));
+        }
+    }
+
+    /* Unused trailing memory entries are left zeroed and the table is trimmed to what was filled in. */
+    acpiR3PrepareHeader(pThis, &pHdr->aHeader, "SRAT", off, 3);
+    pHdr->aHeader.u8Checksum = acpiR3Checksum(pbSrat, off);
+
+    acpiR3PhysCopy(pDevIns, GCPhysDst, pbSrat, off);
+    PDMDevHlpMMHeapFree(pDevIns, pbSrat);
+}
+
+/**
+ * Used by acpiR3PlantTables to plant the System Locality Information Table (SLIT).
+ *
+ * @param   pDevIns     The device instance.
+ * @param   pThis       The ACPI shared instance data.
+ * @param   GCPhysDst   Where to plant it.
+ */
+static void acpiR3SetupSlit(PPDMDEVINS pDevIns, PACPISTATE pThis, RTGCPHYS32 GCPhysDst)
+{
+    struct
+    {
+        ACPITBLSLIT hdr;
+        uint8_t     abDistances[ACPI_NUMA_NODES_MAX * ACPI_NUMA_NODES_MAX];
+    }              tbl;
+    uint32_t const cNodes = pThis->cNumaNodes;
+    uint32_t const cbTbl  = sizeof(ACPITBLSLIT) + cNodes * cNodes;
+
+    RT_ZERO(tbl);
+
+    acpiR3PrepareHeader(pThis, &tbl.hdr.aHeader, "SLIT", cbTbl, 1);
+    tbl.hdr.u64Localities = RT_H2LE_U64(cNodes);
+    for (uint32_t i = 0; i < cNodes; i++)
+        for (uint32_t j = 0; j < cNodes; j++)
+            tbl.abDistances[i * cNodes + j] = i == j ? SLIT_DISTANCE_LOCAL : SLIT_DISTANCE_REMOTE;
+
+    tbl.hdr.aHeader.u8Checksum = acpiR3Checksum(&tbl, cbTbl);
+
+    acpiR3PhysCopy(pDevIns, GCPhysDst, (const uint8_t *)&tbl, cbTbl);
+}
+
 /**
  * Used by acpiR3PlantTables and acpiConstruct.
  *
@@ -3725,23 +3973,25 @@ static int acpiR3PlantTables(PPDMDEVINS pDevIns, PACPISTATE pThis, PACPISTATER3
     RTGCPHYS32 GCPhysApic = 0;
     RTGCPHYS32 GCPhysSsdt = 0;
     RTGCPHYS32 GCPhysMcfg = 0;
+    RTGCPHYS32 GCPhysSrat = 0;
+    RTGCPHYS32 GCPhysSlit = 0;
     RTGCPHYS32 aGCPhysCust[MAX_CUST_TABLES] = {0};
     uint32_t   addend = 0;
 #if defined(VBOX_WITH_IOMMU_AMD) || defined(VBOX_WITH_IOMMU_INTEL)
 # ifdef VBOX_WITH_TPM
+    RTGCPHYS32 aGCPhysRsdt[12 + MAX_CUST_TABLES];
+    RTGCPHYS32 aGCPhysXsdt[12 + MAX_CUST_TABLES];
+# else
     RTGCPHYS32 aGCPhysRsdt[10 + MAX_CUST_TABLES];
     RTGCPHYS32 aGCPhysXsdt[10 + MAX_CUST_TABLES];
-# else
-    RTGCPHYS32 aGCPhysRsdt[8 + MAX_CUST_TABLES];
-    RTGCPHYS32 aGCPhysXsdt[8 + MAX_CUST_TABLES];
 # endif
 #else
 # ifdef VBOX_WITH_TPM
+    RTGCPHYS32 aGCPhysRsdt[11 + MAX_CUST_TABLES];
+    RTGCPHYS32 aGCPhysXsdt[11 + MAX_CUST_TABLES];
+# else
     RTGCPHYS32 aGCPhysRsdt[9 + MAX_CUST_TABLES];
     RTGCPHYS32 aGCPhysXsdt[9 + MAX_CUST_TABLES];
-# else
-    RTGCPHYS32 aGCPhysRsdt[7 + MAX_CUST_TABLES];
-    RTGCPHYS32 aGCPhysXsdt[7 + MAX_CUST_TABLES];
 # endif
 #endif
     uint32_t   cAddr;
@@ -3756,6 +4006,8 @@ static int acpiR3PlantTables(PPDMDEVINS pDevIns, PACPISTATE pThis, PACPISTATER3
 #endif
     uint32_t   iSsdt  = 0;
     uint32_t   iMcfg  = 0;
+    uint32_t   iSrat  = 0;
+    uint32_t   iSlit  = 0;
     uint32_t   iCust  = 0;
     size_t     cbRsdt = sizeof(ACPITBLHEADER);
     size_t     cbXsdt = sizeof(ACPITBLHEADER);
@@ -3788,6 +4040,12 @@ static int acpiR3PlantTables(PPDMDEVINS pDevIns, PACPISTATE pThis, PACPISTATER3
     if (pThis->fUseMcfg)
         iMcfg = cAddr++;        /* MCFG */
 
+    if (pThis->cNumaNodes)
+    {
+        iSrat = cAddr++;        /* SRAT */
+        iSlit = cAddr++;        /* SLIT */
+    }
+
     if (pThis->cCustTbls > 0)
     {
         iCust = cAddr;          /* CUST */
@@ -3901,6 +4159,14 @@ static int acpiR3PlantTables(PPDMDEVINS pDevIns, PACPISTATE pThis, PACPISTATER3
         GCPhysCur = RT_ALIGN_32(GCPhysCur + sizeof(ACPITBLMCFG) + sizeof(ACPITBLMCFGENTRY), 16);
     }
 
+    if (pThis->cNumaNodes)
+    {
+        GCPhysSrat = GCPhysCur;
+        GCPhysCur = RT_ALIGN_32(GCPhysCur + acpiR3SratSize(pThis), 16);
+        GCPhysSlit = GCPhysCur;
+        GCPhysCur = RT_ALIGN_32(GCPhysCur + sizeof(ACPITBLSLIT) + pThis->cNumaNodes * pThis->cNumaNodes, 16);
+    }
+
     for (uint8_t i = 0; i < pThis->cCustTbls; i++)
     {
         aGCPhysCust[i] = GCPhysCur;
@@ -3941,6 +4207,8 @@ static int acpiR3PlantTables(PPDMDEVINS pDevIns, PACPISTATE pThis, PACPISTATER3
         Log((" HPET 0x%08X", GCPhysHpet + addend));
     if (pThis->fUseMcfg)
         Log((" MCFG 0x%08X", GCPhysMcfg + addend));
+    if (pThis->cNumaNodes)
+        Log((" SRAT 0x%08X SLIT 0x%08X", GCPhysSrat + addend, GCPhysSlit + addend));
     for (uint8_t i = 0; i < pThis->cCustTbls; i++)
         Log((" CUST(%d) 0x%08X", i, aGCPhysCust[i] + addend));
     Log((" SSDT 0x%08X", GCPhysSsdt + addend));
@@ -4002,6 +4270,16 @@ static int acpiR3PlantTables(PPDMDEVINS pDevIns, PACPISTATE pThis, PACPISTATER3
         aGCPhysRsdt[iMcfg] = GCPhysMcfg + addend;
         aGCPhysXsdt[iMcfg] = GCPhysMcfg + addend;
     }
+    if (pThis->cNumaNodes)
+    {
+        acpiR3SetupSrat(pDevIns, pThis, GCPhysSrat + addend, cbAbove4GB);
+        aGCPhysRsdt[iSrat] = GCPhysSrat + addend;
+        aGCPhysXsdt[iSrat] = GCPhysSrat + addend;
+
+        acpiR3SetupSlit(pDevIns, pThis, GCPhysSlit + addend);
+        aGCPhysRsdt[iSlit] = GCPhysSlit + addend;
+        aGCPhysXsdt[iSlit] = GCPhysSlit + addend;
+    }
     for (uint8_t i = 0; i < pThis->cCustTbls; i++)
     {
         AssertBreak(i < MAX_CUST_TABLES);
@@ -4218,6 +4496,7 @@ static DECLCALLBACK(void) acpiR3Reset(PPDMDEVINS pDevIns)
     pThis->pm1a_ctl          = 0;
     pThis->u64PmTimerInitial = PDMDevHlpTimerGet(pDevIns, pThis->hPmTimer);
     pThis->uPmTimerVal       = 0;
+    ASMAtomicWriteU64(&pThis->cPmTimerTicksLastRead, 0);
     acpiR3PmTimerReset(pDevIns, pThis, pThis->u64PmTimerInitial);
     pThis->uPmTimeOld        = pThis->uPmTimerVal;
     pThis->uBatteryIndex     = 0;
@@ -4318,6 +4597,7 @@ static DECLCALLBACK(int) acpiR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFG
                                   "|McfgEnabled"
                                   "|McfgBase"
                                   "|McfgLength"
+                                  "|NumaNodes"
                                   "|PciPref64Enabled"
                                   "|PciPref64LimitGB"
                                   "|SmcEnabled"
@@ -4390,6 +4670,18 @@ static DECLCALLBACK(int) acpiR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFG
         return PDMDEV_SET_ERROR(pDevIns, rc, N_("Configuration error: Failed to read \"McfgLength\""));
     pThis->fUseMcfg = (pThis->u64PciConfigMMioAddress != 0) && (pThis->u64PciConfigMMioLength != 0);
 
+    /* query the number of NUMA nodes to describe to the guest (SRAT/SLIT) */
+    rc = pHlp->pfnCFGMQueryU8Def(pCfg, "NumaNodes", &pThis->cNumaNodes, 0);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("Configuration error: Failed to read \"NumaNodes\""));
+    if (pThis->cNumaNodes == 1)
+        pThis->cNumaNodes = 0; /* A single node is the same as no NUMA information at all. */
+    if (   pThis->cNumaNodes > ACPI_NUMA_NODES_MAX
+        || pThis->cNumaNodes > pThis->cCpus)
+        return PDMDevHlpVMSetError(pDevIns, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                                   N_("Configuration error: \"NumaNodes\"=%u is invalid, it must not exceed %u nor the number of CPUs (%u)"),
+                                   pThis->cNumaNodes, ACPI_NUMA_NODES_MAX, pThis->cCpus);
+
     /* query whether we are supposed to set up the 64-bit prefetchable memory window */
     rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "PciPref64Enabled", &pThis->fPciPref64Enabled, false);
     if (RT_FAILURE(rc))
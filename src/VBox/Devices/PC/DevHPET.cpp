@@ -17,8 +17,9 @@
  *  -# counter register read.
  *
  * Typical linux will configure the timer at Hz but not necessarily enable
- * interrupts (HPET_TN_ENABLE not set).  It would be nice to emulate this
- * mode without using timers.
+ * interrupts (HPET_TN_ENABLE not set).  Periodic timers in this mode are not
+ * re-armed, the comparator is instead caught up when read and the timer is
+ * programmed again once the interrupt gets enabled.
  *
  */
 
@@ -303,7 +304,13 @@ typedef struct HPET
     /** Whether we emulate ICH9 HPET (different frequency & timer count). */
     bool                        fIch9;
     /** Size alignment padding. */
-    uint8_t                     abPadding0[7+8];
+    uint8_t                     abPadding0[3];
+    /** Main counter generation, odd while u64HpetOffset, u64HpetCounter or the
+     * enable bit is being changed.  Lets hpetReadCounterLockless() get along
+     * without taking any locks. */
+    uint32_t volatile           uCounterGen;
+    /** Size alignment padding. */
+    uint8_t                     abPadding1[8];
 
     /** The handle of the MMIO region. */
     IOMMMIOHANDLE               hMmio;
@@ -406,6 +413,42 @@ DECLINLINE(uint64_t) hpetGetTicksEx(PCHPET pThis, uint64_t tsNow)
     return nsToHpetTicks(pThis, tsNow + pThis->u64HpetOffset);
 }
 
+
+/**
+ * Tries to read the main counter without taking the HPET and clock locks.
+ *
+ * The guest reads the main counter a lot more often than it changes the
+ * configuration, so we use HPET::uCounterGen as a sequence counter and simply
+ * retry if we raced a writer.
+ *
+ * @returns true on success, false if the caller should take the locks.
+ * @param   pDevIns     The device instance.
+ * @param   pThis       The shared HPET state.
+ * @param   pu64Ticks   Where to return the counter value.
+ */
+DECLINLINE(bool) hpetReadCounterLockless(PPDMDEVINS pDevIns, PHPET pThis, uint64_t *pu64Ticks)
+{
+    for (unsigned cTries = 0; cTries < 4; cTries++)
+    {
+        uint32_t const uGen = ASMAtomicReadU32(&pThis->uCounterGen);
+        if (!(uGen & 1))
+        {
+            uint64_t u64Ticks;
+            if (ASMAtomicReadU64(&pThis->u64HpetConfig) & HPET_CFG_ENABLE)
+                u64Ticks = hpetGetTicksEx(pThis, PDMDevHlpTimerGet(pDevIns, pThis->aTimers[0].hTimer));
+            else
+                u64Ticks = ASMAtomicReadU64(&pThis->u64HpetCounter);
+            if (ASMAtomicReadU32(&pThis->uCounterGen) == uGen)
+            {
+                *pu64Ticks = u64Ticks;
+                return true;
+            }
+        }
+        ASMNopPause();
+    }
+    return false;
+}
+
 DECLINLINE(uint64_t) hpetUpdateMasked(uint64_t u64NewValue, uint64_t u64OldValue, uint64_t u64Mask)
 {
     u64NewValue &= u64Mask;
@@ -459,6 +502,36 @@ DECLINLINE(uint64_t) hpetAdjustComparator(PHPETTIMER pHpetTimer, uint64_t fConfi
 }
 
 
+/**
+ * Gets the comparator value for a register read.
+ *
+ * Periodic timers with masked interrupts are not kept armed, so the stored
+ * comparator lags behind and we have to calculate where it would be now.
+ *
+ * @returns The comparator value.
+ * @param   pDevIns     The device instance.
+ * @param   pThis       The shared HPET state.
+ * @param   pHpetTimer  The timer.
+ */
+DECLINLINE(uint64_t) hpetTimerGetComparator(PPDMDEVINS pDevIns, PHPET pThis, PHPETTIMER pHpetTimer)
+{
+    uint64_t       uCmp    = ASMAtomicReadU64(&pHpetTimer->u64Cmp);
+    uint64_t const fConfig = ASMAtomicReadU64(&pHpetTimer->u64Config);
+    if (   (fConfig & (HPET_TN_PERIODIC | HPET_TN_ENABLE)) == HPET_TN_PERIODIC
+        && (ASMAtomicReadU64(&pThis->u64HpetConfig) & HPET_CFG_ENABLE))
+    {
+        uint64_t const uPeriod = ASMAtomicReadU64(&pHpetTimer->u64Period);
+        if (uPeriod)
+        {
+            uint64_t const uHpetNow = hpetGetTicksEx(pThis, PDMDevHlpTimerGet(pDevIns, pHpetTimer->hTimer));
+            if (!hpetComputeDiff(fConfig, uCmp, uHpetNow))
+                uCmp += ((uHpetNow - uCmp) / uPeriod + 1) * uPeriod;
+        }
+    }
+    return uCmp;
+}
+
+
 /**
  * Sets the frequency hint if it's a periodic timer.
  *
@@ -539,8 +612,15 @@ static void hpetProgramTimer(PPDMDEVINS pDevIns, PHPET pThis, PHPETTIMER pHpetTi
 #endif
 
     /*
-     * Arm the timer.
+     * Arm the timer, unless it is a periodic one with the interrupt masked.
      */
+    if ((fConfig & (HPET_TN_PERIODIC | HPET_TN_ENABLE)) == HPET_TN_PERIODIC)
+    {
+        Log4(("HPET[%u]: periodic timer with masked interrupt, not arming\n", pHpetTimer->idxTimer));
+        PDMDevHlpTimerStop(pDevIns, pHpetTimer->hTimer);
+        return;
+    }
+
     uint64_t u64TickLimit = pThis->fIch9 ? HPET_TICKS_IN_100YR_ICH9 : HPET_TICKS_IN_100YR_PIIX;
     if (uHpetDelta <= u64TickLimit)
     {
@@ -570,7 +650,7 @@ static void hpetProgramTimer(PPDMDEVINS pDevIns, PHPET pThis, PHPETTIMER pHpetTi
  *
  * @note    No locking required.
  */
-static uint32_t hpetTimerRegRead32(PHPET pThis, uint32_t iTimerNo, uint32_t iTimerReg)
+static uint32_t hpetTimerRegRead32(PPDMDEVINS pDevIns, PHPET pThis, uint32_t iTimerNo, uint32_t iTimerReg)
 {
     uint32_t u32Value;
     if (   iTimerNo < HPET_CAP_GET_TIMERS(pThis->u32Capabilities)
@@ -591,7 +671,7 @@ static uint32_t hpetTimerRegRead32(PHPET pThis, uint32_t iTimerNo, uint32_t iTim
 
             case HPET_TN_CMP:
             {
-                uint64_t uCmp = ASMAtomicReadU64(&pHpetTimer->u64Cmp);
+                uint64_t uCmp = hpetTimerGetComparator(pDevIns, pThis, pHpetTimer);
                 u32Value = (uint32_t)uCmp;
                 Log(("HPET[%u]: read32 HPET_TN_CMP: %#x (%#RX64)\n", pHpetTimer->idxTimer, u32Value, uCmp));
                 break;
@@ -599,7 +679,7 @@ static uint32_t hpetTimerRegRead32(PHPET pThis, uint32_t iTimerNo, uint32_t iTim
 
             case HPET_TN_CMP + 4:
             {
-                uint64_t uCmp = ASMAtomicReadU64(&pHpetTimer->u64Cmp);
+                uint64_t uCmp = hpetTimerGetComparator(pDevIns, pThis, pHpetTimer);
                 u32Value = (uint32_t)(uCmp >> 32);
                 Log(("HPET[%u]: read32 HPET_TN_CMP+4: %#x (%#RX64)\n", pHpetTimer->idxTimer, u32Value, uCmp));
                 break;
@@ -633,7 +713,7 @@ static uint32_t hpetTimerRegRead32(PHPET pThis, uint32_t iTimerNo, uint32_t iTim
  * @param   iTimerNo            The timer index.
  * @param   iTimerReg           The index of the timer register to read.
  */
-static uint64_t hpetTimerRegRead64(PHPET pThis, uint32_t iTimerNo, uint32_t iTimerReg)
+static uint64_t hpetTimerRegRead64(PPDMDEVINS pDevIns, PHPET pThis, uint32_t iTimerNo, uint32_t iTimerReg)
 {
     uint64_t u64Value;
     if (   iTimerNo < HPET_CAP_GET_TIMERS(pThis->u32Capabilities)
@@ -648,7 +728,7 @@ static uint64_t hpetTimerRegRead64(PHPET pThis, uint32_t iTimerNo, uint32_t iTim
                 break;
 
             case HPET_TN_CMP:
-                u64Value = ASMAtomicReadU64(&pHpetTimer->u64Cmp);
+                u64Value = hpetTimerGetComparator(pDevIns, pThis, pHpetTimer);
                 Log(("HPET[%u]: read64 HPET_TN_CMP: %#RX64\n", iTimerNo, u64Value));
                 break;
 
@@ -718,7 +798,7 @@ static VBOXSTRICTRC hpetTimerRegWrite32(PPDMDEVINS pDevIns, PHPET pThis, uint32_
                     if ((u32NewValue & HPET_TN_INT_TYPE) == HPET_TIMER_TYPE_LEVEL)
                         return VINF_IOM_R3_MMIO_WRITE;
 #endif
-                    DEVHPET_LOCK_RETURN(pDevIns, pThis, VINF_IOM_R3_MMIO_WRITE);
+                    DEVHPET_LOCK_BOTH_RETURN(pDevIns, pThis, VINF_IOM_R3_MMIO_WRITE);
 
                     fConfig = ASMAtomicUoReadU64(&pHpetTimer->u64Config);
                     uint64_t const fConfigNew = hpetUpdateMasked(u32NewValue, fConfig, fMask);
@@ -737,7 +817,13 @@ static VBOXSTRICTRC hpetTimerRegWrite32(PPDMDEVINS pDevIns, PHPET pThis, uint32_
                         Log(("HPET[%u]: Changing timer to 64-bit mode.\n", iTimerNo));
                     ASMAtomicWriteU64(&pHpetTimer->u64Config, fConfigNew);
 
-                    DEVHPET_UNLOCK(pDevIns, pThis);
+                    /* Periodic timers aren't armed while masked, so program it when unmasked. */
+                    if (   (fConfig    & (HPET_TN_PERIODIC | HPET_TN_ENABLE)) == HPET_TN_PERIODIC
+                        && (fConfigNew & (HPET_TN_PERIODIC | HPET_TN_ENABLE)) == (HPET_TN_PERIODIC | HPET_TN_ENABLE)
+                        && (pThis->u64HpetConfig & HPET_CFG_ENABLE))
+                        hpetProgramTimer(pDevIns, pThis, pHpetTimer, PDMDevHlpTimerGet(pDevIns, pHpetTimer->hTimer));
+
+                    DEVHPET_UNLOCK_BOTH(pDevIns, pThis);
 
                     if (RT_LIKELY((fConfigNew & HPET_TN_INT_TYPE) != HPET_TIMER_TYPE_LEVEL))
                     { /* likely */ }
@@ -945,25 +1031,24 @@ static VBOXSTRICTRC hpetConfigRegRead32(PPDMDEVINS pDevIns, PHPET pThis, uint32_
         case HPET_COUNTER:
         case HPET_COUNTER + 4:
         {
-            /** @todo We don't technically need to sit on the virtualsync lock here to
-             *        read it, but it helps wrt quality... */
-            DEVHPET_LOCK_BOTH_RETURN(pDevIns, pThis, VINF_IOM_R3_MMIO_READ);
-
             uint64_t u64Ticks;
-            if (pThis->u64HpetConfig & HPET_CFG_ENABLE)
-            {
-                uint64_t const tsNow = PDMDevHlpTimerGet(pDevIns, pThis->aTimers[0].hTimer);
-                PDMDevHlpTimerUnlockClock(pDevIns, pThis->aTimers[0].hTimer);
-                u64Ticks = hpetGetTicksEx(pThis, tsNow);
-            }
-            else
+            if (!hpetReadCounterLockless(pDevIns, pThis, &u64Ticks))
             {
-                PDMDevHlpTimerUnlockClock(pDevIns, pThis->aTimers[0].hTimer);
-                u64Ticks = pThis->u64HpetCounter;
+                DEVHPET_LOCK_BOTH_RETURN(pDevIns, pThis, VINF_IOM_R3_MMIO_READ);
+                if (pThis->u64HpetConfig & HPET_CFG_ENABLE)
+                {
+                    uint64_t const tsNow = PDMDevHlpTimerGet(pDevIns, pThis->aTimers[0].hTimer);
+                    PDMDevHlpTimerUnlockClock(pDevIns, pThis->aTimers[0].hTimer);
+                    u64Ticks = hpetGetTicksEx(pThis, tsNow);
+                }
+                else
+                {
+                    PDMDevHlpTimerUnlockClock(pDevIns, pThis->aTimers[0].hTimer);
+                    u64Ticks = pThis->u64HpetCounter;
+                }
+                DEVHPET_UNLOCK(pDevIns, pThis);
             }
-
             STAM_REL_COUNTER_INC(&pThis->StatCounterRead4Byte);
-            DEVHPET_UNLOCK(pDevIns, pThis);
 
             /** @todo is it correct? */
             u32Value = idxReg == HPET_COUNTER ? (uint32_t)u64Ticks : (uint32_t)(u64Ticks >> 32);
@@ -1046,6 +1131,11 @@ static VBOXSTRICTRC hpetConfigRegWrite32(PPDMDEVINS pDevIns, PHPET pThis, uint32
 #endif
             }
 
+            /* Lockless counter readers must not see the enable bit and offset out of sync. */
+            bool const fEnableChanged = RT_BOOL((iOldValue ^ u32NewValue) & HPET_CFG_ENABLE);
+            if (fEnableChanged)
+                ASMAtomicIncU32(&pThis->uCounterGen);
+
             /* Updating it using an atomic write just to be on the safe side. */
             ASMAtomicWriteU64(&pThis->u64HpetConfig, hpetUpdateMasked(u32NewValue, iOldValue, HPET_CFG_WRITE_MASK));
 
@@ -1081,6 +1171,8 @@ static VBOXSTRICTRC hpetConfigRegWrite32(PPDMDEVINS pDevIns, PHPET pThis, uint32
                     PDMDevHlpTimerStop(pDevIns, pThis->aTimers[i].hTimer);
             }
 
+            if (fEnableChanged)
+                ASMAtomicIncU32(&pThis->uCounterGen);
             DEVHPET_UNLOCK_BOTH(pDevIns, pThis);
             break;
         }
@@ -1120,7 +1212,9 @@ static VBOXSTRICTRC hpetConfigRegWrite32(PPDMDEVINS pDevIns, PHPET pThis, uint32
         {
             STAM_REL_COUNTER_INC(&pThis->StatCounterWriteLow);
             DEVHPET_LOCK_RETURN(pDevIns, pThis, VINF_IOM_R3_MMIO_WRITE);
+            ASMAtomicIncU32(&pThis->uCounterGen);
             pThis->u64HpetCounter = RT_MAKE_U64(u32NewValue, RT_HI_U32(pThis->u64HpetCounter));
+            ASMAtomicIncU32(&pThis->uCounterGen);
 /** @todo how is this supposed to work if the HPET is enabled? */
             Log(("write HPET_COUNTER: %#x -> %llx\n", u32NewValue, pThis->u64HpetCounter));
             DEVHPET_UNLOCK(pDevIns, pThis);
@@ -1131,7 +1225,9 @@ static VBOXSTRICTRC hpetConfigRegWrite32(PPDMDEVINS pDevIns, PHPET pThis, uint32
         {
             STAM_REL_COUNTER_INC(&pThis->StatCounterWriteHigh);
             DEVHPET_LOCK_RETURN(pDevIns, pThis, VINF_IOM_R3_MMIO_WRITE);
+            ASMAtomicIncU32(&pThis->uCounterGen);
             pThis->u64HpetCounter = RT_MAKE_U64(RT_LO_U32(pThis->u64HpetCounter), u32NewValue);
+            ASMAtomicIncU32(&pThis->uCounterGen);
             Log(("write HPET_COUNTER + 4: %#x -> %llx\n", u32NewValue, pThis->u64HpetCounter));
             DEVHPET_UNLOCK(pDevIns, pThis);
             break;
@@ -1169,7 +1265,7 @@ static DECLCALLBACK(VBOXSTRICTRC) hpetMMIORead(PPDMDEVINS pDevIns, void *pvUser,
          */
         if (off >= 0x100 && off < 0x400)
         {
-            *(uint32_t *)pv = hpetTimerRegRead32(pThis,
+            *(uint32_t *)pv = hpetTimerRegRead32(pDevIns, pThis,
                                                  (uint32_t)(off - 0x100) / 0x20,
                                                  (uint32_t)(off - 0x100) % 0x20);
             rc = VINF_SUCCESS;
@@ -1186,26 +1282,25 @@ static DECLCALLBACK(VBOXSTRICTRC) hpetMMIORead(PPDMDEVINS pDevIns, void *pvUser,
         PRTUINT64U pValue = (PRTUINT64U)pv;
         if (off == HPET_COUNTER)
         {
-            /** @todo We don't technically need to sit on the virtualsync lock here to
-             *        read it, but it helps wrt quality... */
             /* When reading HPET counter we must read it in a single read,
                to avoid unexpected time jumps on 32-bit overflow. */
-            DEVHPET_LOCK_BOTH_RETURN(pDevIns, pThis, VINF_IOM_R3_MMIO_READ);
-
-            if (pThis->u64HpetConfig & HPET_CFG_ENABLE)
+            if (!hpetReadCounterLockless(pDevIns, pThis, &pValue->u))
             {
-                uint64_t const tsNow = PDMDevHlpTimerGet(pDevIns, pThis->aTimers[0].hTimer);
-                PDMDevHlpTimerUnlockClock(pDevIns, pThis->aTimers[0].hTimer);
-                pValue->u = hpetGetTicksEx(pThis, tsNow);
-            }
-            else
-            {
-                PDMDevHlpTimerUnlockClock(pDevIns, pThis->aTimers[0].hTimer);
-                pValue->u = pThis->u64HpetCounter;
+                DEVHPET_LOCK_BOTH_RETURN(pDevIns, pThis, VINF_IOM_R3_MMIO_READ);
+                if (pThis->u64HpetConfig & HPET_CFG_ENABLE)
+                {
+                    uint64_t const tsNow = PDMDevHlpTimerGet(pDevIns, pThis->aTimers[0].hTimer);
+                    PDMDevHlpTimerUnlockClock(pDevIns, pThis->aTimers[0].hTimer);
+                    pValue->u = hpetGetTicksEx(pThis, tsNow);
+                }
+                else
+                {
+                    PDMDevHlpTimerUnlockClock(pDevIns, pThis->aTimers[0].hTimer);
+                    pValue->u = pThis->u64HpetCounter;
+                }
+                DEVHPET_UNLOCK(pDevIns, pThis);
             }
-
             STAM_REL_COUNTER_INC(&pThis->StatCounterRead8Byte);
-            DEVHPET_UNLOCK(pDevIns, pThis);
             rc = VINF_SUCCESS;
         }
         else
@@ -1215,7 +1310,7 @@ static DECLCALLBACK(VBOXSTRICTRC) hpetMMIORead(PPDMDEVINS pDevIns, void *pvUser,
                 uint32_t iTimer    = (uint32_t)(off - 0x100) / 0x20;
                 uint32_t iTimerReg = (uint32_t)(off - 0x100) % 0x20;
                 Assert(!(iTimerReg & 7));
-                pValue->u = hpetTimerRegRead64(pThis, iTimer, iTimerReg);
+                pValue->u = hpetTimerRegRead64(pDevIns, pThis, iTimer, iTimerReg);
                 rc = VINF_SUCCESS;
             }
             else
@@ -1336,7 +1431,9 @@ static DECLCALLBACK(void) hpetR3Timer(PPDMDEVINS pDevIns, TMTIMERHANDLE hTimer,
 
     if (fConfig & HPET_TN_PERIODIC)
     {
-        if (uPeriod)
+        if (!(fConfig & HPET_TN_ENABLE))
+            Log4(("HPET[%u]: periodic: interrupt masked, not re-arming\n", pHpetTimer->idxTimer));
+        else if (uPeriod)
         {
             uint64_t const tsNow        = PDMDevHlpTimerGet(pDevIns, pHpetTimer->hTimer);
             uint64_t const uHpetNow     = hpetGetTicksEx(pThis, tsNow);
@@ -930,19 +930,37 @@ static void qemuFwCfgDmaXfer(PDEVQEMUFWCFG pThis, RTGCPHYS GCPhysDma)
             }
             else
             {
+                /*
+                 * Kernel and initrd images are several MB in size and get transferred in one go,
+                 * so use a bigger bounce buffer to cut down the number of file reads and guest
+                 * memory writes.  Fall back to the small stack buffer if the allocation fails.
+                 */
+                uint8_t  abTmp[_1K];
+                uint8_t *pbBuf = &abTmp[0];
+                uint32_t cbBuf = sizeof(abTmp);
+                if (cbLeft > sizeof(abTmp))
+                {
+                    uint32_t const cbAlloc = RT_MIN(RT_ALIGN_32(cbLeft, _4K), _128K);
+                    uint8_t *pbAlloc = (uint8_t *)RTMemTmpAlloc(cbAlloc);
+                    if (pbAlloc)
+                    {
+                        pbBuf = pbAlloc;
+                        cbBuf = cbAlloc;
+                    }
+                }
+
                 while (   RT_SUCCESS(rc)
                        && cbLeft)
                 {
-                    uint8_t abTmp[_1K];
-                    uint32_t cbThisRead = RT_MIN(sizeof(abTmp), cbLeft);
+                    uint32_t cbThisRead = RT_MIN(cbBuf, cbLeft);
                     uint32_t cbRead;
 
-                    rc = pThis->pCfgItem->pfnRead(pThis, pThis->pCfgItem, pThis->offCfgItemNext, &abTmp[0],
+                    rc = pThis->pCfgItem->pfnRead(pThis, pThis->pCfgItem, pThis->offCfgItemNext, pbBuf,
                                                    cbThisRead, &cbRead);
                     if (RT_SUCCESS(rc))
                     {
                         if (DmaDesc.u32Ctrl & QEMU_FW_CFG_DMA_READ)
-                            PDMDevHlpPhysWriteMeta(pThis->pDevIns, GCPhysCur, &abTmp[0], cbRead);
+                            PDMDevHlpPhysWriteMeta(pThis->pDevIns, GCPhysCur, pbBuf, cbRead);
                         /* else: Assume Skip */
 
                         cbLeft    -= cbRead;
@@ -952,6 +970,9 @@ static void qemuFwCfgDmaXfer(PDEVQEMUFWCFG pThis, RTGCPHYS GCPhysDma)
                         pThis->cbCfgItemLeft  -= cbRead;
                     }
                 }
+
+                if (pbBuf != &abTmp[0])
+                    RTMemTmpFree(pbBuf);
             }
         }
     }
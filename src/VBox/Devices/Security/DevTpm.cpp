@@ -524,6 +524,9 @@ typedef struct DEVTPM
     uint32_t                        cbCmdResp;
     /** Offset into the Command/Response buffer. */
     uint32_t                        offCmdResp;
+    /** Sequence number of the last command handed to the worker, used to detect
+     * responses for commands which got canceled or reset while executing. */
+    uint32_t                        uCmdSeqNo;
     /** Command/Response buffer. */
     uint8_t                         abCmdResp[TPM_DATA_BUFFER_SIZE_MAX];
 } DEVTPM;
@@ -547,6 +550,9 @@ typedef struct DEVTPMR3
     R3PTRTYPE(PPDMIBASE)            pDrvBase;
     /** The TPM connector interface below. */
     R3PTRTYPE(PPDMITPMCONNECTOR)    pDrvTpm;
+    /** Private command/response buffer of the worker executing the command
+     * outside of the device critical section. */
+    uint8_t                         abCmdRespWrk[TPM_DATA_BUFFER_SIZE_MAX];
 } DEVTPMR3;
 /** Pointer to the TPM device state for ring-3. */
 typedef DEVTPMR3 *PDEVTPMR3;
@@ -949,6 +955,7 @@ static VBOXSTRICTRC tpmMmioFifoWrite(PPDMDEVINS pDevIns, PDEVTPM pThis, PDEVTPML
                 && pThis->enmState == DEVTPMSTATE_CMD_RECEPTION)
             {
                 pThis->enmState = DEVTPMSTATE_CMD_EXEC;
+                pThis->uCmdSeqNo++;
                 rc = PDMDevHlpTaskTrigger(pDevIns, pThis->hTpmCmdTask);
             }
 
@@ -1305,6 +1312,7 @@ static VBOXSTRICTRC tpmMmioCrbWrite(PPDMDEVINS pDevIns, PDEVTPM pThis, PDEVTPMLO
                 && u32 == 0x1)
             {
                 pThis->enmState = DEVTPMSTATE_CMD_EXEC;
+                pThis->uCmdSeqNo++;
                 rc = PDMDevHlpTaskTrigger(pDevIns, pThis->hTpmCmdTask);
             }
             break;
@@ -1428,13 +1436,44 @@ static DECLCALLBACK(void) tpmR3CmdExecWorker(PPDMDEVINS pDevIns, void *pvUser)
     int const rcLock = PDMDevHlpCritSectEnter(pDevIns, pDevIns->pCritSectRoR3, VERR_IGNORED);
     PDM_CRITSECT_RELEASE_ASSERT_RC_DEV(pDevIns, pDevIns->pCritSectRoR3, rcLock);
 
-    if (pThisCC->pDrvTpm)
+    if (   pThisCC->pDrvTpm
+        && (   pThis->enmState == DEVTPMSTATE_CMD_EXEC
+            || pThis->enmState == DEVTPMSTATE_CMD_CANCEL))
     {
-        size_t cbCmd = RTTpmReqGetSz((PCTPMREQHDR)&pThis->abCmdResp[0]);
-        int rc = pThisCC->pDrvTpm->pfnCmdExec(pThisCC->pDrvTpm, pThis->bLoc, &pThis->abCmdResp[0], cbCmd,
-                                              &pThis->abCmdResp[0], sizeof(pThis->abCmdResp));
-        if (RT_SUCCESS(rc))
+        uint32_t const uCmdSeqNo = pThis->uCmdSeqNo;
+        uint8_t const  bLoc      = pThis->bLoc;
+        size_t const   cbCmd     = RT_MIN(RTTpmReqGetSz((PCTPMREQHDR)&pThis->abCmdResp[0]), sizeof(pThis->abCmdResp));
+        memcpy(&pThisCC->abCmdRespWrk[0], &pThis->abCmdResp[0], cbCmd);
+
+        /*
+         * Some commands (key generation for instance) can take seconds, don't hold up
+         * the EMTs polling the status registers meanwhile.
+         */
+        PDMDevHlpCritSectLeave(pDevIns, pDevIns->pCritSectRoR3);
+        int rc = pThisCC->pDrvTpm->pfnCmdExec(pThisCC->pDrvTpm, bLoc, &pThisCC->abCmdRespWrk[0], cbCmd,
+                                              &pThisCC->abCmdRespWrk[0], sizeof(pThisCC->abCmdRespWrk));
+        int const rcLock2 = PDMDevHlpCritSectEnter(pDevIns, pDevIns->pCritSectRoR3, VERR_IGNORED);
+        PDM_CRITSECT_RELEASE_ASSERT_RC_DEV(pDevIns, pDevIns->pCritSectRoR3, rcLock2);
+
+        if (   uCmdSeqNo != pThis->uCmdSeqNo
+            || (   pThis->enmState != DEVTPMSTATE_CMD_EXEC
+                && pThis->enmState != DEVTPMSTATE_CMD_CANCEL))
+            LogFlowFunc(("Dropping response for command %u (state %d)\n", uCmdSeqNo, pThis->enmState));
+        else if (bLoc != pThis->bLoc)
+        {
+            /*
+             * The locality was seized or relinquished while the command was executing,
+             * the response doesn't belong to the new owner.  The locality paths don't
+             * touch the state, so abort the command here or we'd be stuck in the
+             * execution state until the next reset.
+             */
+            LogFlowFunc(("Dropping response for command %u, locality changed %u -> %u\n", uCmdSeqNo, bLoc, pThis->bLoc));
+            pThis->enmState   = DEVTPMSTATE_IDLE;
+            pThis->offCmdResp = 0;
+        }
+        else if (RT_SUCCESS(rc))
         {
+            memcpy(&pThis->abCmdResp[0], &pThisCC->abCmdRespWrk[0], sizeof(pThis->abCmdResp));
             pThis->enmState   = DEVTPMSTATE_CMD_COMPLETION;
             pThis->offCmdResp = 0;
             if (pThis->fCrb)
@@ -75,8 +75,9 @@ typedef struct DRVCHAR
     /** I/O thread. */
     PPDMTHREAD                  pThrdIo;
 
-    /** Small send buffer. */
-    uint8_t                     abTxBuf[16];
+    /** Send buffer, big enough to take the whole transmit FIFO of the biggest
+     * UART variant in one go so a burst results in a single write to the stream. */
+    uint8_t                     abTxBuf[256];
     /** Amount of data in the buffer. */
     size_t                      cbTxUsed;
 
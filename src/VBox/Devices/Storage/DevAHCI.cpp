@@ -512,6 +512,20 @@ typedef struct AHCI
     volatile uint32_t               u32PortsInterrupted;
     /** Number of I/O threads currently active - used for async controller reset handling. */
     volatile uint32_t               cThreadsActive;
+    /** Number of interrupt events (mostly command completions) folded into the
+     * interrupt currently pending, i.e. since the guest last read the interrupt
+     * status register.  Protected by the lock. */
+    uint32_t                        cIntrEventsPending;
+    uint32_t                        u32Alignment3;
+
+#ifdef VBOX_WITH_STATISTICS
+    /** Number of interrupts asserted. */
+    STAMCOUNTER                     StatIntrsAsserted;
+    /** Number of interrupt events merged into an already pending interrupt. */
+    STAMCOUNTER                     StatIntrsCoalesced;
+    /** Histogram of the number of interrupt events serviced by one interrupt. */
+    STAMCOUNTER                     aStatEventsPerIntr[16];
+#endif
 
     /** Flag whether the legacy port reset method should be used to make it work with saved states. */
     bool                            fLegacyPortResetMethod;
@@ -916,6 +930,70 @@ static void ahciHbaClearInterrupt(PPDMDEVINS pDevIns)
     PDMDevHlpPCISetIrq(pDevIns, 0, 0);
 }
 
+/**
+ * Marks the given port as interrupting and asserts the interrupt if none is pending yet.
+ *
+ * Nothing needs to be signalled while another port bit is still set in
+ * u32PortsInterrupted: the guest has not read the global interrupt status
+ * register since the previous assertion and will pick up every port which
+ * interrupted in the meantime.  This merges completions arriving in bursts into
+ * a single interrupt (a single MSI) without delaying any of them.
+ *
+ * @param   pDevIns     The device instance.
+ * @param   pThis       The shared AHCI state.
+ * @param   iPort       The port (or CCC interrupt) number to mark.
+ *
+ * @note    Caller must own the lock.
+ */
+static void ahciHbaAssertInterrupt(PPDMDEVINS pDevIns, PAHCI pThis, uint8_t iPort)
+{
+    pThis->cIntrEventsPending++;
+
+    uint32_t fPortsInterruptedOld = ASMAtomicOrExU32((volatile uint32_t *)&pThis->u32PortsInterrupted, RT_BIT_32(iPort));
+    if (!fPortsInterruptedOld)
+    {
+        Log(("P%u: %s: Fire interrupt\n", iPort, __FUNCTION__));
+        STAM_COUNTER_INC(&pThis->StatIntrsAsserted);
+        PDMDevHlpPCISetIrq(pDevIns, 0, 1);
+    }
+    else
+        STAM_COUNTER_INC(&pThis->StatIntrsCoalesced);
+}
+
+/**
+ * Records the interrupt events the guest picked up with the pending interrupt.
+ *
+ * @param   pThis       The shared AHCI state.
+ *
+ * @note    Caller must own the lock.
+ */
+DECLINLINE(void) ahciHbaInterruptConsumed(PAHCI pThis)
+{
+    if (pThis->cIntrEventsPending)
+    {
+        STAM_COUNTER_INC(&pThis->aStatEventsPerIntr[RT_MIN(pThis->cIntrEventsPending, RT_ELEMENTS(pThis->aStatEventsPerIntr)) - 1]);
+        pThis->cIntrEventsPending = 0;
+    }
+}
+
+/**
+ * Asserts the command completion coalescing interrupt and restarts the CCC timeout.
+ *
+ * @param   pDevIns     The device instance.
+ * @param   pThis       The shared AHCI state.
+ *
+ * @note    Caller must own the lock.
+ */
+static void ahciHbaCccAssertInterrupt(PPDMDEVINS pDevIns, PAHCI pThis)
+{
+    /* Reset command completion coalescing state. */
+    if (pThis->uCccTimeout)
+        PDMDevHlpTimerSetMillies(pDevIns, pThis->hHbaCccTimer, pThis->uCccTimeout);
+    pThis->uCccCurrentNr = 0;
+
+    ahciHbaAssertInterrupt(pDevIns, pThis, pThis->uCccPortNr);
+}
+
 /**
  * Updates the IRQ level and sets port bit in the global interrupt status register of the HBA.
  */
@@ -931,35 +1009,13 @@ static int ahciHbaSetInterrupt(PPDMDEVINS pDevIns, PAHCI pThis, uint8_t iPort, i
     {
         if ((pThis->regHbaCccCtl & AHCI_HBA_CCC_CTL_EN) && (pThis->regHbaCccPorts & (1 << iPort)))
         {
+            /* A completion count of 0 means only the timeout generates CCC interrupts. */
             pThis->uCccCurrentNr++;
-            if (pThis->uCccCurrentNr >= pThis->uCccNr)
-            {
-                /* Reset command completion coalescing state. */
-                PDMDevHlpTimerSetMillies(pDevIns, pThis->hHbaCccTimer, pThis->uCccTimeout);
-                pThis->uCccCurrentNr = 0;
-
-                pThis->u32PortsInterrupted |= (1 << pThis->uCccPortNr);
-                if (!(pThis->u32PortsInterrupted & ~(1 << pThis->uCccPortNr)))
-                {
-                    Log(("P%u: %s: Fire interrupt\n", iPort, __FUNCTION__));
-                    PDMDevHlpPCISetIrq(pDevIns, 0, 1);
-                }
-            }
+            if (pThis->uCccNr && pThis->uCccCurrentNr >= pThis->uCccNr)
+                ahciHbaCccAssertInterrupt(pDevIns, pThis);
         }
         else
-        {
-            /* If only the bit of the actual port is set assert an interrupt
-             * because the interrupt status register was already read by the guest
-             * and we need to send a new notification.
-             * Otherwise an interrupt is still pending.
-             */
-            ASMAtomicOrU32((volatile uint32_t *)&pThis->u32PortsInterrupted, (1 << iPort));
-            if (!(pThis->u32PortsInterrupted & ~(1 << iPort)))
-            {
-                Log(("P%u: %s: Fire interrupt\n", iPort, __FUNCTION__));
-                PDMDevHlpPCISetIrq(pDevIns, 0, 1);
-            }
-        }
+            ahciHbaAssertInterrupt(pDevIns, pThis, iPort);
     }
 
     PDMDevHlpCritSectLeave(pDevIns, &pThis->lock);
@@ -973,11 +1029,23 @@ static int ahciHbaSetInterrupt(PPDMDEVINS pDevIns, PAHCI pThis, uint8_t iPort, i
  */
 static DECLCALLBACK(void) ahciCccTimer(PPDMDEVINS pDevIns, TMTIMERHANDLE hTimer, void *pvUser)
 {
-    RT_NOREF(pDevIns, hTimer);
+    RT_NOREF(hTimer);
     PAHCI pThis = (PAHCI)pvUser;
 
-    int rc = ahciHbaSetInterrupt(pDevIns, pThis, pThis->uCccPortNr, VERR_IGNORED);
-    AssertRC(rc);
+    int rc = PDMDevHlpCritSectEnter(pDevIns, &pThis->lock, VERR_IGNORED);
+    AssertRCReturnVoid(rc);
+
+    /* Only signal the guest if commands completed since the last CCC interrupt, keep the timeout running otherwise. */
+    if (pThis->regHbaCccCtl & AHCI_HBA_CCC_CTL_EN)
+    {
+        if (   pThis->uCccCurrentNr
+            && (pThis->regHbaCtrl & AHCI_HBA_CTRL_IE))
+            ahciHbaCccAssertInterrupt(pDevIns, pThis);
+        else if (pThis->uCccTimeout)
+            PDMDevHlpTimerSetMillies(pDevIns, pThis->hHbaCccTimer, pThis->uCccTimeout);
+    }
+
+    PDMDevHlpCritSectLeave(pDevIns, &pThis->lock);
 }
 
 /**
@@ -1658,7 +1726,10 @@ static VBOXSTRICTRC HbaInterruptStatus_w(PPDMDEVINS pDevIns, PAHCI pThis, uint32
      * set the interrupt inbetween.
      */
     bool fClear = true;
-    pThis->regHbaIs |= ASMAtomicXchgU32(&pThis->u32PortsInterrupted, 0);
+    uint32_t u32PortsInterrupted = ASMAtomicXchgU32(&pThis->u32PortsInterrupted, 0);
+    if (u32PortsInterrupted)
+        ahciHbaInterruptConsumed(pThis);
+    pThis->regHbaIs |= u32PortsInterrupted;
     if (!pThis->regHbaIs)
     {
         unsigned i = 0;
@@ -1715,6 +1786,8 @@ static VBOXSTRICTRC HbaInterruptStatus_r(PPDMDEVINS pDevIns, PAHCI pThis, uint32
         return rc;
 
     uint32_t u32PortsInterrupted = ASMAtomicXchgU32(&pThis->u32PortsInterrupted, 0);
+    if (u32PortsInterrupted)
+        ahciHbaInterruptConsumed(pThis);
 
     PDMDevHlpCritSectLeave(pDevIns, &pThis->lock);
     Log(("%s: read regHbaIs=%#010x u32PortsInterrupted=%#010x\n", __FUNCTION__, pThis->regHbaIs, u32PortsInterrupted));
@@ -1826,7 +1899,9 @@ static VBOXSTRICTRC HbaCccCtl_w(PPDMDEVINS pDevIns, PAHCI pThis, uint32_t iReg,
     pThis->uCccPortNr   = AHCI_HBA_CCC_CTL_INT_GET(u32Value);
     pThis->uCccNr       = AHCI_HBA_CCC_CTL_CC_GET(u32Value);
 
-    if (u32Value & AHCI_HBA_CCC_CTL_EN)
+    pThis->uCccCurrentNr = 0;
+
+    if ((u32Value & AHCI_HBA_CCC_CTL_EN) && pThis->uCccTimeout)
         PDMDevHlpTimerSetMillies(pDevIns, pThis->hHbaCccTimer, pThis->uCccTimeout); /* Arm the timer */
     else
         PDMDevHlpTimerStop(pDevIns, pThis->hHbaCccTimer);
@@ -2109,6 +2184,7 @@ static void ahciR3HBAReset(PPDMDEVINS pDevIns, PAHCI pThis, PAHCIR3 pThisCC)
     /* Clear pending interrupts. */
     pThis->regHbaIs            = 0;
     pThis->u32PortsInterrupted = 0;
+    pThis->cIntrEventsPending  = 0;
     ahciHbaClearInterrupt(pDevIns);
 
     pThis->f64BitAddr = false;
@@ -5941,6 +6017,21 @@ static DECLCALLBACK(int) ahciR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFG
                               TMTIMER_FLAGS_NO_CRIT_SECT | TMTIMER_FLAGS_RING0, "AHCI CCC", &pThis->hHbaCccTimer);
     AssertRCReturn(rc, rc);
 
+#ifdef VBOX_WITH_STATISTICS
+    /*
+     * Interrupt statistics.
+     */
+    PDMDevHlpSTAMRegister(pDevIns, &pThis->StatIntrsAsserted,  STAMTYPE_COUNTER, "Intr/Asserted",  STAMUNIT_OCCURENCES,
+                          "Number of interrupts asserted");
+    PDMDevHlpSTAMRegister(pDevIns, &pThis->StatIntrsCoalesced, STAMTYPE_COUNTER, "Intr/Coalesced", STAMUNIT_OCCURENCES,
+                          "Number of interrupt events merged into an already pending interrupt");
+    for (i = 0; i < RT_ELEMENTS(pThis->aStatEventsPerIntr) - 1; i++)
+        PDMDevHlpSTAMRegisterF(pDevIns, &pThis->aStatEventsPerIntr[i], STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                               "", "Intr/EventsPerIntr/%02u", i + 1);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->aStatEventsPerIntr[i], STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                           "", "Intr/EventsPerIntr/%02u-inf", i + 1);
+#endif
+
     /*
      * Initialize ports.
      */
@@ -483,8 +483,13 @@ static void lsilogicUpdateInterrupt(PPDMDEVINS pDevIns, PLSILOGICSCSI pThis)
  */
 DECLINLINE(void) lsilogicSetInterrupt(PPDMDEVINS pDevIns, PLSILOGICSCSI pThis, uint32_t uStatus)
 {
-    ASMAtomicOrU32(&pThis->uInterruptStatus, uStatus);
-    lsilogicUpdateInterrupt(pDevIns, pThis);
+    /*
+     * Skip the interrupt update if the bits were set already, the line was updated when
+     * they got set and every mask change updates it again.  Saves going through the
+     * PDM lock and the PCI bus for every reply posted while the guest didn't ack yet.
+     */
+    if ((ASMAtomicOrExU32(&pThis->uInterruptStatus, uStatus) & uStatus) != uStatus)
+        lsilogicUpdateInterrupt(pDevIns, pThis);
 }
 
 /**
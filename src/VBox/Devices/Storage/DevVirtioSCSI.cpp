@@ -70,7 +70,9 @@
 *   Defined Constants And Macros                                                                                                 *
 *********************************************************************************************************************************/
 /** The current saved state version. */
-#define VIRTIOSCSI_SAVED_STATE_VERSION          UINT32_C(1)
+#define VIRTIOSCSI_SAVED_STATE_VERSION          UINT32_C(2)
+/** The saved state version before the number of request queues became configurable. */
+#define VIRTIOSCSI_SAVED_STATE_VERSION_FIXED_VIRTQS UINT32_C(1)
 
 
 #define LUN0    0
@@ -90,8 +92,10 @@
 
 #define VIRTIOSCSI_HOST_SCSI_FEATURES_OFFERED       VIRTIOSCSI_HOST_SCSI_FEATURES_NONE
 
-#define VIRTIOSCSI_REQ_VIRTQ_CNT                    4           /**< T.B.D. Consider increasing                      */
-#define VIRTIOSCSI_VIRTQ_CNT                        (VIRTIOSCSI_REQ_VIRTQ_CNT + 2)
+#define VIRTIOSCSI_REQ_VIRTQ_CNT_DEFAULT            4           /**< Default # of request queues (NumRequestQueues)  */
+#define VIRTIOSCSI_REQ_VIRTQ_CNT_MAX                16          /**< Max # of request queues, one worker thread each */
+#define VIRTIOSCSI_VIRTQ_CNT_MAX                    (VIRTIOSCSI_REQ_VIRTQ_CNT_MAX + 2)
+AssertCompile(VIRTIOSCSI_VIRTQ_CNT_MAX <= VIRTQ_MAX_COUNT);
 #define VIRTIOSCSI_MAX_TARGETS                      256         /**< T.B.D. Figure out a a good value for this.      */
 #define VIRTIOSCSI_MAX_LUN                          1           /**< VirtIO specification, section 5.6.4             */
 #define VIRTIOSCSI_MAX_COMMANDS_PER_LUN             128         /**< T.B.D. What is a good value for this?           */
@@ -124,7 +128,7 @@
 #define VIRTQNAME(uVirtqNbr) (pThis->aszVirtqNames[uVirtqNbr])  /**< Macro to get queue name from its index          */
 #define CBVIRTQNAME(uVirtqNbr) RTStrNLen(VIRTQNAME(uVirtqNbr), sizeof(VIRTQNAME(uVirtqNbr)))
 
-#define IS_REQ_VIRTQ(uVirtqNbr) (uVirtqNbr >= VIRTQ_REQ_BASE && uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT)
+#define IS_REQ_VIRTQ(uVirtqNbr) (uVirtqNbr >= VIRTQ_REQ_BASE && uVirtqNbr < pThis->cVirtqs)
 
 #define VIRTIO_IS_IN_DIRECTION(pMediaExTxDirEnumValue) \
     ((pMediaExTxDirEnumValue) == PDMMEDIAEXIOREQSCSITXDIR_FROM_DEVICE)
@@ -436,17 +440,20 @@ typedef struct VIRTIOSCSI
     /** Number of targets in paTargetInstances. */
     uint32_t                        cTargets;
 
+    /** Number of virtqs in use (control + event + request queues), at most VIRTIOSCSI_VIRTQ_CNT_MAX. */
+    uint32_t                        cVirtqs;
+
     /** Per device-bound virtq worker-thread contexts (eventq slot unused) */
-    VIRTIOSCSIWORKER                aWorkers[VIRTIOSCSI_VIRTQ_CNT];
+    VIRTIOSCSIWORKER                aWorkers[VIRTIOSCSI_VIRTQ_CNT_MAX];
 
     /** Instance name */
     char                            szInstance[16];
 
     /** Device-specific spec-based VirtIO VIRTQNAMEs */
-    char                            aszVirtqNames[VIRTIOSCSI_VIRTQ_CNT][VIRTIO_MAX_VIRTQ_NAME_SIZE];
+    char                            aszVirtqNames[VIRTIOSCSI_VIRTQ_CNT_MAX][VIRTIO_MAX_VIRTQ_NAME_SIZE];
 
     /** Track which VirtIO queues we've attached to */
-    bool                            afVirtqAttached[VIRTIOSCSI_VIRTQ_CNT];
+    bool                            afVirtqAttached[VIRTIOSCSI_VIRTQ_CNT_MAX];
 
     /** Set if events missed due to lack of bufs avail on eventq */
     bool                            fEventsMissed;
@@ -498,7 +505,7 @@ typedef struct VIRTIOSCSIR3
     R3PTRTYPE(PVIRTIOSCSITARGET)    paTargetInstances;
 
     /** Per device-bound virtq worker-thread contexts (eventq slot unused) */
-    VIRTIOSCSIWORKERR3              aWorkers[VIRTIOSCSI_VIRTQ_CNT];
+    VIRTIOSCSIWORKERR3              aWorkers[VIRTIOSCSI_VIRTQ_CNT_MAX];
 
     /** Device base interface. */
     PDMIBASE                        IBase;
@@ -592,7 +599,7 @@ static DECLCALLBACK(void) virtioScsiNotified(PPDMDEVINS pDevIns, PVIRTIOCORE pVi
     RT_NOREF(pVirtio);
     PVIRTIOSCSI pThis   = PDMDEVINS_2_DATA(pDevIns, PVIRTIOSCSI);
 
-    AssertReturnVoid(uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT);
+    AssertReturnVoid(uVirtqNbr < pThis->cVirtqs);
     PVIRTIOSCSIWORKER pWorker = &pThis->aWorkers[uVirtqNbr];
 
 #if defined (IN_RING3) && defined (LOG_ENABLED)
@@ -631,7 +638,7 @@ DECLINLINE(void) virtioScsiSetVirtqNames(PVIRTIOSCSI pThis)
 {
     RTStrCopy(pThis->aszVirtqNames[CONTROLQ_IDX], VIRTIO_MAX_VIRTQ_NAME_SIZE, "controlq");
     RTStrCopy(pThis->aszVirtqNames[EVENTQ_IDX],   VIRTIO_MAX_VIRTQ_NAME_SIZE, "eventq");
-    for (uint16_t uVirtqNbr = VIRTQ_REQ_BASE; uVirtqNbr < VIRTQ_REQ_BASE + VIRTIOSCSI_REQ_VIRTQ_CNT; uVirtqNbr++)
+    for (uint16_t uVirtqNbr = VIRTQ_REQ_BASE; uVirtqNbr < pThis->cVirtqs; uVirtqNbr++)
         RTStrPrintf(pThis->aszVirtqNames[uVirtqNbr], VIRTIO_MAX_VIRTQ_NAME_SIZE,
                     "requestq<%d>", uVirtqNbr - VIRTQ_REQ_BASE);
 }
@@ -1772,13 +1779,13 @@ static DECLCALLBACK(void) virtioScsiR3StatusChanged(PVIRTIOCORE pVirtio, PVIRTIO
         pThis->fResetting    = false;
         pThisCC->fQuiescing  = false;
 
-        for (unsigned i = 0; i < VIRTIOSCSI_VIRTQ_CNT; i++)
+        for (unsigned i = 0; i < pThis->cVirtqs; i++)
             pThis->afVirtqAttached[i] = true;
     }
     else
     {
         LogFunc(("VirtIO is resetting\n"));
-        for (unsigned i = 0; i < VIRTIOSCSI_VIRTQ_CNT; i++)
+        for (unsigned i = 0; i < pThis->cVirtqs; i++)
             pThis->afVirtqAttached[i] = false;
 
         /*
@@ -1988,11 +1995,24 @@ static DECLCALLBACK(int) virtioScsiR3LoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSS
     LogFunc(("LOAD EXEC!!\n"));
 
     AssertReturn(uPass == SSM_PASS_FINAL, VERR_SSM_UNEXPECTED_PASS);
-    AssertLogRelMsgReturn(uVersion == VIRTIOSCSI_SAVED_STATE_VERSION,
+    AssertLogRelMsgReturn(   uVersion == VIRTIOSCSI_SAVED_STATE_VERSION
+                          || uVersion == VIRTIOSCSI_SAVED_STATE_VERSION_FIXED_VIRTQS,
                           ("uVersion=%u\n", uVersion), VERR_SSM_UNSUPPORTED_DATA_UNIT_VERSION);
 
+    /* The guest driver has sized its queue set by the saved num_queues, so it must match. */
+    uint32_t cVirtqs = VIRTIOSCSI_REQ_VIRTQ_CNT_DEFAULT + VIRTQ_REQ_BASE;
+    if (uVersion > VIRTIOSCSI_SAVED_STATE_VERSION_FIXED_VIRTQS)
+    {
+        int rc = pHlp->pfnSSMGetU32(pSSM, &cVirtqs);
+        AssertRCReturn(rc, rc);
+    }
+    AssertReturn(cVirtqs == pThis->cVirtqs,
+                 pHlp->pfnSSMSetLoadError(pSSM, VERR_SSM_LOAD_CONFIG_MISMATCH, RT_SRC_POS,
+                                          N_("request queue count has changed: %u saved, %u configured now"),
+                                          cVirtqs - VIRTQ_REQ_BASE, pThis->cVirtqs - VIRTQ_REQ_BASE));
+
     virtioScsiSetVirtqNames(pThis);
-    for (int uVirtqNbr = 0; uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT; uVirtqNbr++)
+    for (uint32_t uVirtqNbr = 0; uVirtqNbr < pThis->cVirtqs; uVirtqNbr++)
         pHlp->pfnSSMGetBool(pSSM, &pThis->afVirtqAttached[uVirtqNbr]);
 
     pHlp->pfnSSMGetU32(pSSM,  &pThis->virtioScsiConfig.uNumVirtqs);
@@ -2032,7 +2052,7 @@ static DECLCALLBACK(int) virtioScsiR3LoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSS
                                               N_("Bad count of I/O transactions to re-do in saved state (%#x, max %#x - 1)"),
                                               cReqsRedo, VIRTQ_SIZE));
 
-        for (uint16_t uVirtqNbr = VIRTQ_REQ_BASE; uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT; uVirtqNbr++)
+        for (uint16_t uVirtqNbr = VIRTQ_REQ_BASE; uVirtqNbr < pThis->cVirtqs; uVirtqNbr++)
         {
             PVIRTIOSCSIWORKERR3 pWorkerR3 = &pThisCC->aWorkers[uVirtqNbr];
             pWorkerR3->cRedoDescs = 0;
@@ -2043,10 +2063,10 @@ static DECLCALLBACK(int) virtioScsiR3LoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSS
             uint16_t uVirtqNbr;
             rc = pHlp->pfnSSMGetU16(pSSM, &uVirtqNbr);
             AssertRCReturn(rc, rc);
-            AssertReturn(uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT,
+            AssertReturn(uVirtqNbr < pThis->cVirtqs,
                          pHlp->pfnSSMSetLoadError(pSSM, VERR_SSM_DATA_UNIT_FORMAT_CHANGED, RT_SRC_POS,
                                                   N_("Bad queue index for re-do in saved state (%#x, max %#x)"),
-                                                  uVirtqNbr, VIRTIOSCSI_VIRTQ_CNT - 1));
+                                                  uVirtqNbr, pThis->cVirtqs - 1));
 
             uint16_t idxHead;
             rc = pHlp->pfnSSMGetU16(pSSM, &idxHead);
@@ -2066,12 +2086,12 @@ static DECLCALLBACK(int) virtioScsiR3LoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSS
      * Call the virtio core to let it load its state.
      */
     rc = virtioCoreR3ModernDeviceLoadExec(&pThis->Virtio, pDevIns->pHlpR3, pSSM,
-                                           uVersion, VIRTIOSCSI_SAVED_STATE_VERSION, pThis->virtioScsiConfig.uNumVirtqs);
+                                           uVersion, uVersion, pThis->virtioScsiConfig.uNumVirtqs);
 
     /*
      * Nudge request queue workers
      */
-    for (int uVirtqNbr = VIRTQ_REQ_BASE; uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT; uVirtqNbr++)
+    for (uint32_t uVirtqNbr = VIRTQ_REQ_BASE; uVirtqNbr < pThis->cVirtqs; uVirtqNbr++)
     {
         if (pThis->afVirtqAttached[uVirtqNbr])
         {
@@ -2095,7 +2115,8 @@ static DECLCALLBACK(int) virtioScsiR3SaveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSS
 
     LogFunc(("SAVE EXEC!!\n"));
 
-    for (int uVirtqNbr = 0; uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT; uVirtqNbr++)
+    pHlp->pfnSSMPutU32(pSSM, pThis->cVirtqs);
+    for (uint32_t uVirtqNbr = 0; uVirtqNbr < pThis->cVirtqs; uVirtqNbr++)
         pHlp->pfnSSMPutBool(pSSM, pThis->afVirtqAttached[uVirtqNbr]);
 
     pHlp->pfnSSMPutU32(pSSM,  pThis->virtioScsiConfig.uNumVirtqs);
@@ -2157,7 +2178,7 @@ static DECLCALLBACK(int) virtioScsiR3SaveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSS
     /*
      * Call the virtio core to let it save its state.
      */
-    return virtioCoreR3SaveExec(&pThis->Virtio, pDevIns->pHlpR3, pSSM, VIRTIOSCSI_SAVED_STATE_VERSION, VIRTIOSCSI_VIRTQ_CNT);
+    return virtioCoreR3SaveExec(&pThis->Virtio, pDevIns->pHlpR3, pSSM, VIRTIOSCSI_SAVED_STATE_VERSION, pThis->cVirtqs);
 }
 
 
@@ -2361,7 +2382,7 @@ static DECLCALLBACK(void) virtioScsiR3Resume(PPDMDEVINS pDevIns)
      * to ensure they re-check their queues. Active request queues may already
      * be awake due to new reqs coming in.
      */
-    for (uint16_t uVirtqNbr = 0; uVirtqNbr < VIRTIOSCSI_REQ_VIRTQ_CNT; uVirtqNbr++)
+    for (uint16_t uVirtqNbr = 0; uVirtqNbr < pThis->cVirtqs; uVirtqNbr++)
     {
         if (   virtioCoreIsVirtqEnabled(&pThis->Virtio, uVirtqNbr)
             && ASMAtomicReadBool(&pThis->aWorkers[uVirtqNbr].fSleeping))
@@ -2440,7 +2461,7 @@ static DECLCALLBACK(int) virtioScsiR3Destruct(PPDMDEVINS pDevIns)
     pThisCC->paTargetInstances = NULL;
     pThisCC->pMediaNotify = NULL;
 
-    for (unsigned uVirtqNbr = 0; uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT; uVirtqNbr++)
+    for (unsigned uVirtqNbr = 0; uVirtqNbr < pThis->cVirtqs; uVirtqNbr++)
     {
         PVIRTIOSCSIWORKER pWorker = &pThis->aWorkers[uVirtqNbr];
         if (pWorker->hEvtProcess != NIL_SUPSEMEVENT)
@@ -2493,6 +2514,7 @@ static DECLCALLBACK(int) virtioScsiR3Construct(PPDMDEVINS pDevIns, int iInstance
      * Validate and read configuration.
      */
     PDMDEV_VALIDATE_CONFIG_RETURN(pDevIns, "NumTargets"
+                                           "|NumRequestQueues"
                                            "|Bootable"
                                            "|MmioBase"
                                            "|Irq", "");
@@ -2505,12 +2527,24 @@ static DECLCALLBACK(int) virtioScsiR3Construct(PPDMDEVINS pDevIns, int iInstance
                                    N_("virtio-scsi configuration error: NumTargets=%u is out of range (1..%u)"),
                                    pThis->cTargets, VIRTIOSCSI_MAX_TARGETS);
 
+    /* Each request queue has its own worker thread, so guests with many vCPUs
+       can submit I/O without all of them contending for a single virtq. */
+    uint32_t cReqVirtqs;
+    rc = pHlp->pfnCFGMQueryU32Def(pCfg, "NumRequestQueues", &cReqVirtqs, VIRTIOSCSI_REQ_VIRTQ_CNT_DEFAULT);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("virtio-scsi configuration error: failed to read NumRequestQueues as integer"));
+    if (cReqVirtqs < 1 || cReqVirtqs > VIRTIOSCSI_REQ_VIRTQ_CNT_MAX)
+        return PDMDevHlpVMSetError(pDevIns, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                   N_("virtio-scsi configuration error: NumRequestQueues=%u is out of range (1..%u)"),
+                                   cReqVirtqs, VIRTIOSCSI_REQ_VIRTQ_CNT_MAX);
+    pThis->cVirtqs = cReqVirtqs + VIRTQ_REQ_BASE;
+
     rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "Bootable", &pThis->fBootable, true);
     if (RT_FAILURE(rc))
          return PDMDEV_SET_ERROR(pDevIns, rc, N_("virtio-scsi configuration error: failed to read Bootable as boolean"));
 
-    LogRel(("%s: Targets=%u Bootable=%RTbool (unimplemented) R0Enabled=%RTbool RCEnabled=%RTbool\n",
-            pThis->szInstance, pThis->cTargets, pThis->fBootable, pDevIns->fR0Enabled, pDevIns->fRCEnabled));
+    LogRel(("%s: Targets=%u RequestQueues=%u Bootable=%RTbool (unimplemented) R0Enabled=%RTbool RCEnabled=%RTbool\n",
+            pThis->szInstance, pThis->cTargets, cReqVirtqs, pThis->fBootable, pDevIns->fR0Enabled, pDevIns->fRCEnabled));
 
 
     /*
@@ -2518,7 +2552,7 @@ static DECLCALLBACK(int) virtioScsiR3Construct(PPDMDEVINS pDevIns, int iInstance
      */
 
     /* Configure virtio_scsi_config that transacts via VirtIO implementation's Dev. Specific Cap callbacks */
-    pThis->virtioScsiConfig.uNumVirtqs      = VIRTIOSCSI_REQ_VIRTQ_CNT;
+    pThis->virtioScsiConfig.uNumVirtqs      = pThis->cVirtqs - VIRTQ_REQ_BASE;
     pThis->virtioScsiConfig.uSegMax         = VIRTIOSCSI_MAX_SEG_COUNT;
     pThis->virtioScsiConfig.uMaxSectors     = VIRTIOSCSI_MAX_SECTORS_HINT;
     pThis->virtioScsiConfig.uCmdPerLun      = VIRTIOSCSI_MAX_COMMANDS_PER_LUN;
@@ -2558,7 +2592,7 @@ static DECLCALLBACK(int) virtioScsiR3Construct(PPDMDEVINS pDevIns, int iInstance
     virtioScsiSetVirtqNames(pThis);
 
     /* Attach the queues and create worker threads for them: */
-    for (uint16_t uVirtqNbr = 0; uVirtqNbr < VIRTIOSCSI_VIRTQ_CNT; uVirtqNbr++)
+    for (uint16_t uVirtqNbr = 0; uVirtqNbr < pThis->cVirtqs; uVirtqNbr++)
     {
         rc = virtioCoreR3VirtqAttach(&pThis->Virtio, uVirtqNbr, VIRTQNAME(uVirtqNbr));
         if (RT_FAILURE(rc))
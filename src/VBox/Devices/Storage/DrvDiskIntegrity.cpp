@@ -193,6 +193,9 @@ typedef struct DRVDISKINTEGRITY
     bool                    fCheckConsistency;
     /** Flag whether the RAM disk was prepopulated. */
     bool                    fPrepopulateRamDisk;
+    /** Only check one out of this many chunks of the disk (DRVDISKINT_SAMPLE_CHUNK_SIZE), 0 or 1
+     * checks everything. */
+    uint32_t                cSampleRate;
     /** AVL tree containing the disk blocks to check. */
     PAVLRFOFFTREE           pTreeSegments;
 
@@ -279,6 +282,9 @@ static const RTTRACELOGEVTDESC g_EvtComplete =
     { "Complete", "A previously started I/O request completed", RTTRACELOGEVTSEVERITY_DEBUG,
       RT_ELEMENTS(g_aEvtItemsComplete), &g_aEvtItemsComplete[0]};
 
+/** Size of the disk chunks the sampling decision is made for. */
+#define DRVDISKINT_SAMPLE_CHUNK_SIZE    _1M
+
 #define DISKINTEGRITY_IOREQ_HANDLE_2_DRVDISKAIOREQ(a_pThis, a_hIoReq) ((*(PDRVDISKAIOREQ *)((uintptr_t)(a_hIoReq) + (a_pThis)->cbIoReqOpaque)))
 #define DISKINTEGRITY_IOREQ_HANDLE_2_UPPER_OPAQUE(a_pThis, a_hIoReq) ((void *)((uintptr_t)(a_hIoReq) + (a_pThis)->cbIoReqOpaque + sizeof(PDRVDISKAIOREQ)))
 #define DISKINTEGRITY_IOREQ_ALLOC_2_DRVDISKAIOREQ(a_pvIoReqAlloc) (*(PDRVDISKAIOREQ *)(a_pvIoReqAlloc))
@@ -321,27 +327,24 @@ static void drvdiskintIoLogEntryRelease(PIOLOGENT pIoLogEnt)
 }
 
 /**
- * Record a successful write to the virtual disk.
+ * Record a successful write to the virtual disk, worker for drvdiskintWriteRecord().
  *
  * @returns VBox status code.
  * @param   pThis    Disk integrity driver instance data.
- * @param   paSeg    Segment array of the write to record.
- * @param   cSeg     Number of segments.
+ * @param   pSgBuf   The S/G buffer holding the data to record, advanced by the amount processed.
  * @param   off      Start offset.
  * @param   cbWrite  Number of bytes to record.
  */
-static int drvdiskintWriteRecord(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsigned cSeg,
-                                 uint64_t off, size_t cbWrite)
+static int drvdiskintWriteRecordWorker(PDRVDISKINTEGRITY pThis, PRTSGBUF pSgBuf, uint64_t off, size_t cbWrite)
 {
     int rc = VINF_SUCCESS;
 
-    LogFlowFunc(("pThis=%#p paSeg=%#p cSeg=%u off=%llx cbWrite=%u\n",
-                 pThis, paSeg, cSeg, off, cbWrite));
+    LogFlowFunc(("pThis=%#p pSgBuf=%#p off=%llx cbWrite=%u\n",
+                 pThis, pSgBuf, off, cbWrite));
 
     /* Update the segments */
     size_t cbLeft   = cbWrite;
     RTFOFF offCurr  = (RTFOFF)off;
-    RTSGBUF SgBuf;
     PIOLOGENT pIoLogEnt = (PIOLOGENT)RTMemAllocZ(sizeof(IOLOGENT));
     if (!pIoLogEnt)
         return VERR_NO_MEMORY;
@@ -350,8 +353,6 @@ static int drvdiskintWriteRecord(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsig
     pIoLogEnt->cbWrite = cbWrite;
     pIoLogEnt->cRefs   = 0;
 
-    RTSgBufInit(&SgBuf, paSeg, cSeg);
-
     while (cbLeft)
     {
         PDRVDISKSEGMENT pSeg = (PDRVDISKSEGMENT)RTAvlrFileOffsetRangeGet(pThis->pTreeSegments, offCurr);
@@ -400,7 +401,7 @@ static int drvdiskintWriteRecord(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsig
         if (fSet)
         {
             AssertPtr(pSeg);
-            size_t cbCopied = RTSgBufCopyToBuf(&SgBuf, pSeg->pbSeg + offSeg, cbRange);
+            size_t cbCopied = RTSgBufCopyToBuf(pSgBuf, pSeg->pbSeg + offSeg, cbRange);
             Assert(cbCopied == cbRange); RT_NOREF(cbCopied);
 
             /* Update the I/O log pointers */
@@ -428,7 +429,7 @@ static int drvdiskintWriteRecord(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsig
             }
         }
         else
-            RTSgBufAdvance(&SgBuf, cbRange);
+            RTSgBufAdvance(pSgBuf, cbRange);
 
         offCurr += cbRange;
         cbLeft  -= cbRange;
@@ -438,22 +439,20 @@ static int drvdiskintWriteRecord(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsig
 }
 
 /**
- * Verifies a read request.
+ * Verifies a read request, worker for drvdiskintReadVerify().
  *
  * @returns VBox status code.
  * @param   pThis    Disk integrity driver instance data.
- * @param   paSeg    Segment array of the containing the data buffers to verify.
- * @param   cSeg     Number of segments.
+ * @param   pSgBuf   The S/G buffer holding the data to verify, advanced by the amount processed.
  * @param   off      Start offset.
  * @param   cbRead   Number of bytes to verify.
  */
-static int drvdiskintReadVerify(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsigned cSeg,
-                                uint64_t off, size_t cbRead)
+static int drvdiskintReadVerifyWorker(PDRVDISKINTEGRITY pThis, PRTSGBUF pSgBuf, uint64_t off, size_t cbRead)
 {
     int rc = VINF_SUCCESS;
 
-    LogFlowFunc(("pThis=%#p paSeg=%#p cSeg=%u off=%llx cbRead=%u\n",
-                 pThis, paSeg, cSeg, off, cbRead));
+    LogFlowFunc(("pThis=%#p pSgBuf=%#p off=%llx cbRead=%u\n",
+                 pThis, pSgBuf, off, cbRead));
 
     Assert(off % 512 == 0);
     Assert(cbRead % 512 == 0);
@@ -461,9 +460,6 @@ static int drvdiskintReadVerify(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsign
     /* Compare read data */
     size_t cbLeft   = cbRead;
     RTFOFF offCurr  = (RTFOFF)off;
-    RTSGBUF SgBuf;
-
-    RTSgBufInit(&SgBuf, paSeg, cSeg);
 
     while (cbLeft)
     {
@@ -489,7 +485,7 @@ static int drvdiskintReadVerify(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsign
             if (pThis->fPrepopulateRamDisk)
             {
                 /* No segment means everything should be 0 for this part. */
-                if (!RTSgBufIsZero(&SgBuf, cbRange))
+                if (!RTSgBufIsZero(pSgBuf, cbRange))
                 {
                     RTMsgError("Corrupted disk at offset %llu (expected everything to be 0)!\n",
                                offCurr);
@@ -514,7 +510,7 @@ static int drvdiskintReadVerify(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsign
             Seg.pvSeg = pSeg->pbSeg + offSeg;
 
             RTSgBufInit(&SgBufCmp, &Seg, 1);
-            if (RTSgBufCmpEx(&SgBuf, &SgBufCmp, cbRange, &cbOff, true))
+            if (RTSgBufCmpEx(pSgBuf, &SgBufCmp, cbRange, &cbOff, true))
             {
                 /* Corrupted disk, print I/O log entry of the last write which accessed this range. */
                 uint32_t cSector = (offSeg + (uint32_t)cbOff) / 512;
@@ -530,7 +526,7 @@ static int drvdiskintReadVerify(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsign
             }
         }
         else
-            RTSgBufAdvance(&SgBuf, cbRange);
+            RTSgBufAdvance(pSgBuf, cbRange);
 
         offCurr += cbRange;
         cbLeft  -= cbRange;
@@ -539,6 +535,93 @@ static int drvdiskintReadVerify(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsign
     return rc;
 }
 
+/**
+ * Returns whether the given chunk of the disk is checked when sampling is enabled.
+ *
+ * @returns true if the chunk is checked, false otherwise.
+ * @param   pThis    Disk integrity driver instance data.
+ * @param   idxChunk The chunk index (offset / DRVDISKINT_SAMPLE_CHUNK_SIZE).
+ */
+DECLINLINE(bool) drvdiskintIsChunkSampled(PDRVDISKINTEGRITY pThis, uint64_t idxChunk)
+{
+    if (pThis->cSampleRate <= 1)
+        return true;
+
+    /* Scramble the index so the checked chunks don't line up with any regular on disk layout. */
+    uint64_t const uHash = idxChunk * UINT64_C(0x9e3779b97f4a7c15);
+    return (uHash >> 32) % pThis->cSampleRate == 0;
+}
+
+/**
+ * Runs the given record/verify worker on the parts of a request which fall into
+ * the chunks being sampled.
+ *
+ * @returns VBox status code.
+ * @param   pThis    Disk integrity driver instance data.
+ * @param   paSeg    Segment array of the request.
+ * @param   cSeg     Number of segments.
+ * @param   off      Start offset.
+ * @param   cb       Number of bytes.
+ * @param   pfnWorker The worker to call for sampled parts.
+ */
+static int drvdiskintSampledProcess(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsigned cSeg, uint64_t off, size_t cb,
+                                    int (*pfnWorker)(PDRVDISKINTEGRITY pThis, PRTSGBUF pSgBuf, uint64_t off, size_t cb))
+{
+    RTSGBUF SgBuf;
+    RTSgBufInit(&SgBuf, paSeg, cSeg);
+
+    if (pThis->cSampleRate <= 1)
+        return pfnWorker(pThis, &SgBuf, off, cb);
+
+    int rc = VINF_SUCCESS;
+    while (   cb
+           && RT_SUCCESS(rc))
+    {
+        size_t const cbThis = RT_MIN(cb, DRVDISKINT_SAMPLE_CHUNK_SIZE - (size_t)(off % DRVDISKINT_SAMPLE_CHUNK_SIZE));
+        if (drvdiskintIsChunkSampled(pThis, off / DRVDISKINT_SAMPLE_CHUNK_SIZE))
+            rc = pfnWorker(pThis, &SgBuf, off, cbThis);
+        else
+            RTSgBufAdvance(&SgBuf, cbThis);
+
+        off += cbThis;
+        cb  -= cbThis;
+    }
+
+    return rc;
+}
+
+/**
+ * Record a successful write to the virtual disk.
+ *
+ * @returns VBox status code.
+ * @param   pThis    Disk integrity driver instance data.
+ * @param   paSeg    Segment array of the write to record.
+ * @param   cSeg     Number of segments.
+ * @param   off      Start offset.
+ * @param   cbWrite  Number of bytes to record.
+ */
+static int drvdiskintWriteRecord(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsigned cSeg,
+                                 uint64_t off, size_t cbWrite)
+{
+    return drvdiskintSampledProcess(pThis, paSeg, cSeg, off, cbWrite, drvdiskintWriteRecordWorker);
+}
+
+/**
+ * Verifies a read request.
+ *
+ * @returns VBox status code.
+ * @param   pThis    Disk integrity driver instance data.
+ * @param   paSeg    Segment array of the containing the data buffers to verify.
+ * @param   cSeg     Number of segments.
+ * @param   off      Start offset.
+ * @param   cbRead   Number of bytes to verify.
+ */
+static int drvdiskintReadVerify(PDRVDISKINTEGRITY pThis, PCRTSGSEG paSeg, unsigned cSeg,
+                                uint64_t off, size_t cbRead)
+{
+    return drvdiskintSampledProcess(pThis, paSeg, cSeg, off, cbRead, drvdiskintReadVerifyWorker);
+}
+
 /**
  * Discards the given ranges from the disk.
  *
@@ -1833,7 +1916,8 @@ static DECLCALLBACK(int) drvdiskintConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg,
                                             "|PrepopulateRamDisk"
                                             "|ReadAfterWrite"
                                             "|RecordWriteBeforeCompletion"
-                                            "|ValidateMemoryBuffers",
+                                            "|ValidateMemoryBuffers"
+                                            "|SampleRate",
                                             "");
 
     int rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "CheckConsistency", &pThis->fCheckConsistency, false);
@@ -1856,6 +1940,8 @@ static DECLCALLBACK(int) drvdiskintConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg,
     AssertRC(rc);
     rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "ValidateMemoryBuffers", &pThis->fValidateMemBufs, false);
     AssertRC(rc);
+    rc = pHlp->pfnCFGMQueryU32Def(pCfg, "SampleRate", &pThis->cSampleRate, 1);
+    AssertRC(rc);
 
     bool fIoLogData = false;
     rc = pHlp->pfnCFGMQueryBoolDef(pCfg, "IoLogData", &fIoLogData, false);
@@ -191,6 +191,8 @@ typedef struct DRVRAMDISK
     bool                    fNonRotational;
     /** AVL tree containing the disk blocks to check. */
     PAVLRFOFFTREE           pTreeSegments;
+    /** The flat disk buffer if the RAM disk was preallocated, NULL if the segment tree is used. */
+    uint8_t                *pbDisk;
     /** Size of the disk. */
     uint64_t                cbDisk;
     /** Size of one sector. */
@@ -256,6 +258,14 @@ static int drvramdiskWriteWorker(PDRVRAMDISK pThis, PRTSGBUF pSgBuf,
     LogFlowFunc(("pThis=%#p pSgBuf=%#p off=%llx cbWrite=%u\n",
                  pThis, pSgBuf, off, cbWrite));
 
+    if (pThis->pbDisk)
+    {
+        AssertReturn(off <= pThis->cbDisk && cbWrite <= pThis->cbDisk - off, VERR_INVALID_PARAMETER);
+        size_t cbCopied = RTSgBufCopyToBuf(pSgBuf, pThis->pbDisk + off, cbWrite);
+        Assert(cbCopied == cbWrite); RT_NOREF(cbCopied);
+        return VINF_SUCCESS;
+    }
+
     /* Update the segments */
     size_t cbLeft   = cbWrite;
     RTFOFF offCurr  = (RTFOFF)off;
@@ -340,6 +350,14 @@ static int drvramdiskReadWorker(PDRVRAMDISK pThis, PRTSGBUF pSgBuf,
     Assert(off % 512 == 0);
     Assert(cbRead % 512 == 0);
 
+    if (pThis->pbDisk)
+    {
+        AssertReturn(off <= pThis->cbDisk && cbRead <= pThis->cbDisk - off, VERR_INVALID_PARAMETER);
+        size_t cbCopied = RTSgBufCopyFromBuf(pSgBuf, pThis->pbDisk + off, cbRead);
+        Assert(cbCopied == cbRead); RT_NOREF(cbCopied);
+        return VINF_SUCCESS;
+    }
+
     /* Compare read data */
     size_t cbLeft   = cbRead;
     RTFOFF offCurr  = (RTFOFF)off;
@@ -408,6 +426,14 @@ static int drvramdiskDiscardRecords(PDRVRAMDISK pThis, PCRTRANGE paRanges, unsig
 
         LogFlowFunc(("Discarding off=%llu cbRange=%zu\n", offStart, cbLeft));
 
+        if (pThis->pbDisk)
+        {
+            /* Discarded ranges read back as zeros just like unallocated segments. */
+            AssertReturn(offStart <= pThis->cbDisk && cbLeft <= pThis->cbDisk - offStart, VERR_INVALID_PARAMETER);
+            memset(pThis->pbDisk + offStart, 0, cbLeft);
+            continue;
+        }
+
         while (cbLeft)
         {
             size_t cbRange;
@@ -1711,6 +1737,11 @@ static DECLCALLBACK(void) drvramdiskDestruct(PPDMDRVINS pDrvIns)
         RTAvlrFileOffsetDestroy(pThis->pTreeSegments, drvramdiskTreeDestroy, NULL);
         RTMemFree(pThis->pTreeSegments);
     }
+    if (pThis->pbDisk)
+    {
+        RTMemPageFree(pThis->pbDisk, pThis->cbDisk);
+        pThis->pbDisk = NULL;
+    }
     if (pThis->hIoBufMgr)
         IOBUFMgrDestroy(pThis->hIoBufMgr);
 
@@ -1876,12 +1907,20 @@ static DECLCALLBACK(int) drvramdiskConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg,
     if (pThis->pDrvMediaExPort)
         rc = IOBUFMgrCreate(&pThis->hIoBufMgr, cbIoBufMax, IOBUFMGR_F_DEFAULT);
 
-    /* Read in all data before the start if requested. */
+    /* Preallocate the whole disk if requested. */
     if (   RT_SUCCESS(rc)
         && pThis->fPreallocRamDisk)
     {
         LogRel(("RamDisk: Preallocating RAM disk...\n"));
-        return VERR_NOT_IMPLEMENTED;
+        if (pThis->cbDisk != (size_t)pThis->cbDisk)
+            return PDMDrvHlpVMSetError(pDrvIns, VERR_NO_MEMORY, RT_SRC_POS,
+                                       N_("RamDisk: Size %RU64 is too big to preallocate"), pThis->cbDisk);
+
+        /* One flat buffer so reads and writes are straight copies instead of segment tree walks. */
+        pThis->pbDisk = (uint8_t *)RTMemPageAllocZ((size_t)pThis->cbDisk);
+        if (!pThis->pbDisk)
+            return PDMDrvHlpVMSetError(pDrvIns, VERR_NO_MEMORY, RT_SRC_POS,
+                                       N_("RamDisk: Failed to preallocate %RU64 bytes"), pThis->cbDisk);
     }
 
     return rc;
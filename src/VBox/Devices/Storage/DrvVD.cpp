@@ -48,6 +48,7 @@
 #include <iprt/memsafer.h>
 #include <iprt/memcache.h>
 #include <iprt/list.h>
+#include <iprt/thread.h>
 
 #ifdef VBOX_WITH_INIP
 /* All lwip header files are not C++ safe. So hack around this. */
@@ -108,6 +109,12 @@ extern bool DevINIPConfigured(void);
 #define DRVVD_IOREQ_SAVED_STATE_VERSION UINT32_C(1)
 /** Maximum number of request errors in the release log before muting. */
 #define DRVVD_MAX_LOG_REL_ERRORS        100
+/** Number of back to back sequential reads before read-ahead kicks in. */
+#define DRVVD_READAHEAD_SEQ_READS_MIN   3
+/** Smallest amount of data to read ahead. */
+#define DRVVD_READAHEAD_SIZE_MIN        _64K
+/** Largest configurable read-ahead buffer size. */
+#define DRVVD_READAHEAD_SIZE_MAX        (16 * _1M)
 
 /** Forward declaration for the dis kcontainer. */
 typedef struct VBOXDISK *PVBOXDISK;
@@ -279,6 +286,31 @@ typedef struct VDCFGNODE
 /** Pointer to a VD config node. */
 typedef VDCFGNODE *PVDCFGNODE;
 
+/**
+ * Read-ahead buffer.
+ */
+typedef struct DRVVDREADAHEADBUF
+{
+    /** The buffer memory, VBOXDISK::cbReadAheadMax bytes big. */
+    uint8_t                  *pbBuf;
+    /** Disk offset of the first byte in the buffer. */
+    uint64_t                 offStart;
+    /** Number of valid bytes in the buffer. */
+    size_t                   cbValid;
+    /** Number of bytes currently being read into the buffer, 0 if idle. */
+    size_t                   cbPending;
+    /** End of the data served from the buffer so far, for accounting wasted data. */
+    uint64_t                 offConsumed;
+    /** Flag whether a write overlapped the range while it was being read. */
+    bool                     fStale;
+    /** S/G segment for the read. */
+    RTSGSEG                  Seg;
+    /** S/G buffer for the read. */
+    RTSGBUF                  SgBuf;
+} DRVVDREADAHEADBUF;
+/** Pointer to a read-ahead buffer. */
+typedef DRVVDREADAHEADBUF *PDRVVDREADAHEADBUF;
+
 /**
  * VBox disk container media main structure, private part.
  *
@@ -328,6 +360,9 @@ typedef struct VBOXDISK
     /** Target image index for merging. */
     unsigned                 uMergeTarget;
 
+    /** Flag whether a filter from the configuration was attached to the disk,
+     * which rules out handing guest buffers directly to the VD layer. */
+    bool                     fFiltersAttached;
     /** Flag whether boot acceleration is enabled. */
     bool                     fBootAccelEnabled;
     /** Flag whether boot acceleration is currently active. */
@@ -342,10 +377,37 @@ typedef struct VBOXDISK
     size_t                   cbDataValid;
     /** The disk buffer. */
     uint8_t                 *pbData;
+
+    /** @name Read-ahead for sequential asynchronous readers.
+     * @{ */
+    /** Flag whether read-ahead is enabled. */
+    bool                     fReadAheadEnabled;
+    /** Number of back to back sequential reads seen. */
+    uint32_t                 cReadAheadSeqReads;
+    /** Disk offset the next read of a sequential stream is expected at. */
+    uint64_t                 offReadAheadNext;
+    /** Size of each read-ahead buffer. */
+    size_t                   cbReadAheadMax;
+    /** Amount of data to read ahead, adapted to how much of it gets used. */
+    size_t                   cbReadAheadCur;
+    /** Critical section protecting the read-ahead state. */
+    RTCRITSECT               CritSectReadAhead;
+    /** The read-ahead buffers, one is filled while the stream consumes the other. */
+    DRVVDREADAHEADBUF        aReadAheadBufs[2];
+    /** Number of read-ahead requests in flight (also counted in cIoReqsActive). */
+    volatile uint32_t        cReadAheadActive;
+    /** Flag whether suspend or power off waits for the read-ahead requests to
+     * finish, no new ones are issued and the last completion notifies PDM. */
+    volatile bool            fReadAheadDrain;
+    /** @} */
     /** Bandwidth group the disk is assigned to. */
     char                    *pszBwGroup;
     /** Flag whether async I/O using the host cache is enabled. */
     bool                     fAsyncIoWithHostCache;
+    /** Flag whether images opened read-only (parents of the chain) go through
+     * the host cache even when it is disabled for the disk. Immutable parents
+     * shared by many linked clones are then kept in host memory only once. */
+    bool                     fParentHostCache;
 
     /** I/O interface for a cache image. */
     VDINTERFACEIO            VDIfIoCache;
@@ -474,6 +536,14 @@ typedef struct VBOXDISK
     STAMCOUNTER              StatReqsDiscard;
     /** Release statistics: Number of I/O requests processed per second. */
     STAMCOUNTER              StatReqsPerSec;
+    /** Release statistics: Number of read-ahead requests issued. */
+    STAMCOUNTER              StatReadAheadIssued;
+    /** Release statistics: Number of reads served from the read-ahead buffers. */
+    STAMCOUNTER              StatReadAheadHits;
+    /** Release statistics: Amount of data served from the read-ahead buffers. */
+    STAMCOUNTER              StatReadAheadBytesHit;
+    /** Release statistics: Amount of data read ahead but never used. */
+    STAMCOUNTER              StatReadAheadBytesWasted;
     /** @} */
 } VBOXDISK;
 
@@ -679,7 +749,9 @@ static DECLCALLBACK(int) drvvdAsyncIOOpen(void *pvUser, const char *pszLocation,
 
                     fFlags |= PDMACEP_FILE_FLAGS_DONT_LOCK;
                 }
-                if (pThis->fAsyncIoWithHostCache)
+                if (   pThis->fAsyncIoWithHostCache
+                    || (   pThis->fParentHostCache
+                        && (fOpen & RTFILE_O_ACCESS_MASK) == RTFILE_O_READ))
                     fFlags |= PDMACEP_FILE_FLAGS_HOST_CACHE_ENABLED;
 
                 rc = PDMDrvHlpAsyncCompletionEpCreateForFile(pThis->pDrvIns,
@@ -1450,6 +1522,258 @@ static int drvvdKeyCheckPrereqs(PVBOXDISK pThis, bool fSetError)
 }
 
 
+/*********************************************************************************************************************************
+*   Read-ahead for sequential readers                                                                                            *
+*********************************************************************************************************************************/
+
+/**
+ * Retires the data in the given read-ahead buffer, accounting for the part which was never
+ * used and adapting the read-ahead size accordingly.
+ *
+ * @param   pThis     VBox disk container instance data.
+ * @param   pBuf      The read-ahead buffer, must not have a read pending.
+ *
+ * @note    Caller must own VBOXDISK::CritSectReadAhead.
+ */
+static void drvvdReadAheadBufRetire(PVBOXDISK pThis, PDRVVDREADAHEADBUF pBuf)
+{
+    Assert(!pBuf->cbPending);
+
+    if (pBuf->cbValid)
+    {
+        uint64_t offEnd      = pBuf->offStart + pBuf->cbValid;
+        uint64_t offConsumed = RT_MAX(pBuf->offConsumed, pBuf->offStart);
+        size_t   cbWasted    = offConsumed < offEnd ? (size_t)(offEnd - offConsumed) : 0;
+
+        STAM_REL_COUNTER_ADD(&pThis->StatReadAheadBytesWasted, cbWasted);
+        if (!cbWasted)
+            pThis->cbReadAheadCur = RT_MIN(pThis->cbReadAheadCur * 2, pThis->cbReadAheadMax);
+        else if (cbWasted > pBuf->cbValid / 2)
+            pThis->cbReadAheadCur = RT_MAX(pThis->cbReadAheadCur / 2, DRVVD_READAHEAD_SIZE_MIN);
+
+        pBuf->cbValid = 0;
+    }
+}
+
+/**
+ * Drops all read-ahead data overlapping the given range, called before and after
+ * anything modifies the disk content.
+ *
+ * @param   pThis     VBox disk container instance data.
+ * @param   off       Start offset of the modified range.
+ * @param   cb        Size of the modified range, UINT64_MAX to drop everything.
+ */
+static void drvvdReadAheadInvalidate(PVBOXDISK pThis, uint64_t off, uint64_t cb)
+{
+    if (!pThis->fReadAheadEnabled)
+        return;
+
+    RTCritSectEnter(&pThis->CritSectReadAhead);
+    for (unsigned i = 0; i < RT_ELEMENTS(pThis->aReadAheadBufs); i++)
+    {
+        PDRVVDREADAHEADBUF pBuf = &pThis->aReadAheadBufs[i];
+        size_t cbBuf = RT_MAX(pBuf->cbValid, pBuf->cbPending);
+
+        if (   cbBuf
+            && off < pBuf->offStart + cbBuf
+            && (off >= pBuf->offStart || pBuf->offStart - off < cb))
+        {
+            if (pBuf->cbPending)
+                pBuf->fStale = true; /* The completion callback drops the data. */
+            else
+                drvvdReadAheadBufRetire(pThis, pBuf);
+        }
+    }
+    RTCritSectLeave(&pThis->CritSectReadAhead);
+}
+
+/**
+ * Tries to serve a read completely from the read-ahead buffers.
+ *
+ * @returns Flag whether the read was served.
+ * @param   pThis     VBox disk container instance data.
+ * @param   off       Start offset of the read.
+ * @param   cbRead    Number of bytes to read.
+ * @param   pSgBuf    The S/G buffer to copy the data to, not advanced.
+ */
+static bool drvvdReadAheadRead(PVBOXDISK pThis, uint64_t off, size_t cbRead, PCRTSGBUF pSgBuf)
+{
+    bool fHit = false;
+
+    RTCritSectEnter(&pThis->CritSectReadAhead);
+    for (unsigned i = 0; i < RT_ELEMENTS(pThis->aReadAheadBufs); i++)
+    {
+        PDRVVDREADAHEADBUF pBuf = &pThis->aReadAheadBufs[i];
+
+        if (   pBuf->cbValid
+            && off >= pBuf->offStart
+            && off - pBuf->offStart + cbRead <= pBuf->cbValid)
+        {
+            RTSGBUF SgBuf;
+            RTSgBufClone(&SgBuf, pSgBuf);
+            RTSgBufCopyFromBuf(&SgBuf, pBuf->pbBuf + (off - pBuf->offStart), cbRead);
+
+            pBuf->offConsumed = RT_MAX(pBuf->offConsumed, off + cbRead);
+            STAM_REL_COUNTER_INC(&pThis->StatReadAheadHits);
+            STAM_REL_COUNTER_ADD(&pThis->StatReadAheadBytesHit, cbRead);
+            fHit = true;
+            break;
+        }
+    }
+    RTCritSectLeave(&pThis->CritSectReadAhead);
+
+    return fHit;
+}
+
+/**
+ * @copydoc FNVDASYNCTRANSFERCOMPLETE
+ */
+static DECLCALLBACK(void) drvvdReadAheadComplete(void *pvUser1, void *pvUser2, int rcReq)
+{
+    PVBOXDISK pThis = (PVBOXDISK)pvUser1;
+    PDRVVDREADAHEADBUF pBuf = (PDRVVDREADAHEADBUF)pvUser2;
+
+    RTCritSectEnter(&pThis->CritSectReadAhead);
+    if (   RT_SUCCESS(rcReq)
+        && !pBuf->fStale)
+        pBuf->cbValid = pBuf->cbPending;
+    else
+        pBuf->cbValid = 0;
+    pBuf->cbPending = 0;
+    pBuf->fStale    = false;
+    RTCritSectLeave(&pThis->CritSectReadAhead);
+
+    /* Don't touch the buffers or the critical section after this, teardown may be waiting for us. */
+    uint32_t cNew = ASMAtomicDecU32(&pThis->cIoReqsActive);
+    AssertMsg(cNew != UINT32_MAX, ("Number of active requests underflowed!\n")); RT_NOREF(cNew);
+    cNew = ASMAtomicDecU32(&pThis->cReadAheadActive);
+    AssertMsg(cNew != UINT32_MAX, ("Number of active read-ahead requests underflowed!\n"));
+    if (   !cNew
+        && ASMAtomicReadBool(&pThis->fReadAheadDrain))
+        PDMDrvHlpAsyncNotificationCompleted(pThis->pDrvIns);
+}
+
+/**
+ * Waits for all read-ahead requests in flight to complete.
+ *
+ * This is the last resort for the destruct and unmount paths, suspend and
+ * power off use the asynchronous notification instead of blocking EMT.
+ *
+ * @param   pThis     VBox disk container instance data.
+ */
+static void drvvdReadAheadDrain(PVBOXDISK pThis)
+{
+    bool const fDrainOld = ASMAtomicXchgBool(&pThis->fReadAheadDrain, true);
+    while (ASMAtomicReadU32(&pThis->cReadAheadActive))
+        RTThreadSleep(1);
+    ASMAtomicWriteBool(&pThis->fReadAheadDrain, fDrainOld);
+}
+
+/**
+ * Feeds the sequential stream detection with a read and issues read-ahead
+ * if the stream is about to run out of prefetched data.
+ *
+ * @param   pThis     VBox disk container instance data.
+ * @param   off       Start offset of the read.
+ * @param   cbRead    Number of bytes read.
+ */
+static void drvvdReadAheadKick(PVBOXDISK pThis, uint64_t off, size_t cbRead)
+{
+    PDRVVDREADAHEADBUF pBufIssue = NULL;
+
+    RTCritSectEnter(&pThis->CritSectReadAhead);
+
+    if (off == pThis->offReadAheadNext)
+        pThis->cReadAheadSeqReads++;
+    else
+        pThis->cReadAheadSeqReads = 0;
+    pThis->offReadAheadNext = off + cbRead;
+
+    if (   pThis->cReadAheadSeqReads >= DRVVD_READAHEAD_SEQ_READS_MIN
+        && !ASMAtomicReadBool(&pThis->fSuspending)
+        && !ASMAtomicReadBool(&pThis->fReadAheadDrain))
+    {
+        /* Find out where the data already prefetched for the stream ends and whether a read is in flight. */
+        uint64_t offNext     = pThis->offReadAheadNext;
+        uint64_t offFrontier = offNext;
+        bool     fPending    = false;
+        for (unsigned i = 0; i < RT_ELEMENTS(pThis->aReadAheadBufs); i++)
+        {
+            PDRVVDREADAHEADBUF pBuf = &pThis->aReadAheadBufs[i];
+            size_t cbBuf = RT_MAX(pBuf->cbValid, pBuf->cbPending);
+
+            fPending |= pBuf->cbPending != 0;
+            if (   cbBuf
+                && pBuf->offStart <= offFrontier
+                && pBuf->offStart + cbBuf > offFrontier)
+                offFrontier = pBuf->offStart + cbBuf;
+        }
+
+        if (   !fPending
+            && offFrontier - offNext < pThis->cbReadAheadCur / 2)
+        {
+            /* Refill the buffer the stream doesn't need anymore. */
+            for (unsigned i = 0; i < RT_ELEMENTS(pThis->aReadAheadBufs); i++)
+            {
+                PDRVVDREADAHEADBUF pBuf = &pThis->aReadAheadBufs[i];
+
+                if (   !pBuf->cbValid
+                    || pBuf->offStart + pBuf->cbValid <= offNext
+                    || pBuf->offStart > offFrontier)
+                {
+                    drvvdReadAheadBufRetire(pThis, pBuf);
+
+                    pBuf->offStart    = offFrontier;
+                    pBuf->offConsumed = offFrontier;
+                    pBuf->cbPending   = pThis->cbReadAheadCur;
+                    pBuf->fStale      = false;
+                    pBufIssue = pBuf;
+
+                    /* Account for the request so suspend and teardown wait for it, drvvdReadAheadComplete undoes it. */
+                    ASMAtomicIncU32(&pThis->cReadAheadActive);
+                    ASMAtomicIncU32(&pThis->cIoReqsActive);
+                    break;
+                }
+            }
+        }
+    }
+
+    RTCritSectLeave(&pThis->CritSectReadAhead);
+
+    if (pBufIssue)
+    {
+        /*
+         * Clip the read to the disk size outside of the critical section, both VDGetSize()
+         * and VDAsyncRead() can block on the disk lock which must not be done while holding
+         * a lock the completion callback needs.
+         */
+        uint64_t cbDisk = VDGetSize(pThis->pDisk, VD_LAST_IMAGE);
+        if (pBufIssue->offStart >= cbDisk)
+        {
+            drvvdReadAheadComplete(pThis, pBufIssue, VERR_EOF);
+            return;
+        }
+
+        RTCritSectEnter(&pThis->CritSectReadAhead);
+        pBufIssue->cbPending = (size_t)RT_MIN(pBufIssue->cbPending, cbDisk - pBufIssue->offStart);
+        RTCritSectLeave(&pThis->CritSectReadAhead);
+
+        STAM_REL_COUNTER_INC(&pThis->StatReadAheadIssued);
+
+        pBufIssue->Seg.pvSeg = pBufIssue->pbBuf;
+        pBufIssue->Seg.cbSeg = pBufIssue->cbPending;
+        RTSgBufInit(&pBufIssue->SgBuf, &pBufIssue->Seg, 1);
+
+        int rc = VDAsyncRead(pThis->pDisk, pBufIssue->offStart, pBufIssue->cbPending, &pBufIssue->SgBuf,
+                             drvvdReadAheadComplete, pThis, pBufIssue);
+        if (rc == VINF_VD_ASYNC_IO_FINISHED)
+            drvvdReadAheadComplete(pThis, pBufIssue, VINF_SUCCESS);
+        else if (rc != VERR_VD_ASYNC_IO_IN_PROGRESS)
+            drvvdReadAheadComplete(pThis, pBufIssue, rc);
+    }
+}
+
+
 /*********************************************************************************************************************************
 *   Media interface methods                                                                                                      *
 *********************************************************************************************************************************/
@@ -1624,7 +1948,9 @@ static DECLCALLBACK(int) drvvdWrite(PPDMIMEDIA pInterface,
     STAM_REL_COUNTER_INC(&pThis->StatReqsSubmitted);
     STAM_REL_COUNTER_INC(&pThis->StatReqsWrite);
 
+    drvvdReadAheadInvalidate(pThis, off, cbWrite);
     rc = VDWrite(pThis->pDisk, off, pvBuf, cbWrite);
+    drvvdReadAheadInvalidate(pThis, off, cbWrite);
 #ifdef VBOX_PERIODIC_FLUSH
     if (pThis->cbFlushInterval)
     {
@@ -2022,7 +2348,9 @@ static DECLCALLBACK(int) drvvdDiscard(PPDMIMEDIA pInterface, PCRTRANGE paRanges,
     STAM_REL_COUNTER_INC(&pThis->StatReqsSubmitted);
     STAM_REL_COUNTER_INC(&pThis->StatReqsDiscard);
 
+    drvvdReadAheadInvalidate(pThis, 0, UINT64_MAX);
     int rc = VDDiscardRanges(pThis->pDisk, paRanges, cRanges);
+    drvvdReadAheadInvalidate(pThis, 0, UINT64_MAX);
     if (RT_SUCCESS(rc))
         STAM_REL_COUNTER_INC(&pThis->StatReqsSucceeded);
     else
@@ -2660,9 +2988,13 @@ static int drvvdMediaExIoReqCompleteWorker(PVBOXDISK pThis, PPDMMEDIAEXIOREQINT
             Assert(pIoReq->ReadWrite.cbIoBuf > 0 || rcReq == VERR_PDM_MEDIAEX_IOREQ_CANCELED);
 
             size_t cbReqIo = RT_MIN(pIoReq->ReadWrite.cbReqLeft, pIoReq->ReadWrite.cbIoBuf);
+            if (pIoReq->enmType == PDMMEDIAEXIOREQTYPE_WRITE)
+                drvvdReadAheadInvalidate(pThis, pIoReq->ReadWrite.offStart, cbReqIo);
             pIoReq->ReadWrite.offStart  += cbReqIo;
             pIoReq->ReadWrite.cbReqLeft -= cbReqIo;
         }
+        else if (pIoReq->enmType == PDMMEDIAEXIOREQTYPE_DISCARD)
+            drvvdReadAheadInvalidate(pThis, 0, UINT64_MAX);
 
         if (   RT_FAILURE(rcReq)
             || !pIoReq->ReadWrite.cbReqLeft
@@ -2693,13 +3025,13 @@ DECLINLINE(int) drvvdMediaExIoReqBufAlloc(PVBOXDISK pThis, PPDMMEDIAEXIOREQINT p
     int rc = VERR_NOT_SUPPORTED;
     LogFlowFunc(("pThis=%#p pIoReq=%#p cb=%zu\n", pThis, pIoReq, cb));
 
-/** @todo This does not work at all with encryption enabled because the encryption plugin
- *         encrypts the data in place trashing guest memory and causing data corruption later on!
- *
- * DO NOT ENABLE UNLESS YOU WANT YOUR DATA SHREDDED!!!
- */
-#if 0
-    if (   cb == _4K
+    /*
+     * Filters like the encryption plugin transform the data in place which would trash
+     * guest memory, so direct buffers are only used if the disk has no filter attached
+     * and can't get the crypto filter attached later on.
+     */
+    if (   !pThis->fFiltersAttached
+        && !pThis->CfgCrypto.pCfgNode
         && pThis->pDrvMediaExPort->pfnIoReqQueryBuf)
     {
         /* Try to get a direct pointer to the buffer first. */
@@ -2709,18 +3041,21 @@ DECLINLINE(int) drvvdMediaExIoReqBufAlloc(PVBOXDISK pThis, PPDMMEDIAEXIOREQINT p
         STAM_COUNTER_INC(&pThis->StatQueryBufAttempts);
         rc = pThis->pDrvMediaExPort->pfnIoReqQueryBuf(pThis->pDrvMediaExPort, pIoReq, &pIoReq->abAlloc[0],
                                                       &pvBuf, &cbBuf);
-        if (RT_SUCCESS(rc))
+        /* The direct buffer is never synced, so it must cover the whole request. */
+        if (   RT_SUCCESS(rc)
+            && cbBuf >= cb)
         {
             STAM_COUNTER_INC(&pThis->StatQueryBufSuccess);
-            pIoReq->ReadWrite.cbIoBuf           = cbBuf;
+            pIoReq->ReadWrite.cbIoBuf           = cb;
             pIoReq->ReadWrite.fDirectBuf        = true;
             pIoReq->ReadWrite.Direct.Seg.pvSeg  = pvBuf;
-            pIoReq->ReadWrite.Direct.Seg.cbSeg  = cbBuf;
+            pIoReq->ReadWrite.Direct.Seg.cbSeg  = cb;
             RTSgBufInit(&pIoReq->ReadWrite.Direct.SgBuf, &pIoReq->ReadWrite.Direct.Seg, 1);
             pIoReq->ReadWrite.pSgBuf = &pIoReq->ReadWrite.Direct.SgBuf;
         }
+        else
+            rc = VERR_NOT_SUPPORTED;
     }
-#endif
 
     if (RT_FAILURE(rc))
     {
@@ -2781,8 +3116,17 @@ static int drvvdMediaExIoReqReadWrapper(PVBOXDISK pThis, PPDMMEDIAEXIOREQINT pIo
                 rc = VERR_VD_ASYNC_IO_IN_PROGRESS;
         }
         else
-            rc = VDAsyncRead(pThis->pDisk, pIoReq->ReadWrite.offStart, cbReqIo, pIoReq->ReadWrite.pSgBuf,
-                             drvvdMediaExIoReqComplete, pThis, pIoReq);
+        {
+            if (   pThis->fReadAheadEnabled
+                && drvvdReadAheadRead(pThis, pIoReq->ReadWrite.offStart, cbReqIo, pIoReq->ReadWrite.pSgBuf))
+                rc = VINF_VD_ASYNC_IO_FINISHED;
+            else
+                rc = VDAsyncRead(pThis->pDisk, pIoReq->ReadWrite.offStart, cbReqIo, pIoReq->ReadWrite.pSgBuf,
+                                 drvvdMediaExIoReqComplete, pThis, pIoReq);
+
+            if (pThis->fReadAheadEnabled)
+                drvvdReadAheadKick(pThis, pIoReq->ReadWrite.offStart, cbReqIo);
+        }
     }
     else
     {
@@ -2817,6 +3161,9 @@ static int drvvdMediaExIoReqWriteWrapper(PVBOXDISK pThis, PPDMMEDIAEXIOREQINT pI
 
     LogFlowFunc(("pThis=%#p pIoReq=%#p cbReqIo=%zu pcbReqIo=%#p\n", pThis, pIoReq, cbReqIo, pcbReqIo));
 
+    /* Read-ahead data is dropped here and again when the write completed. */
+    drvvdReadAheadInvalidate(pThis, pIoReq->ReadWrite.offStart, cbReqIo);
+
     if (   pThis->fAsyncIOSupported
         && !(pIoReq->fFlags & PDMIMEDIAEX_F_SYNC))
     {
@@ -2855,6 +3202,9 @@ static int drvvdMediaExIoReqWriteWrapper(PVBOXDISK pThis, PPDMMEDIAEXIOREQINT pI
 #endif /* VBOX_PERIODIC_FLUSH */
     }
 
+    if (rc == VINF_VD_ASYNC_IO_FINISHED)
+        drvvdReadAheadInvalidate(pThis, pIoReq->ReadWrite.offStart, cbReqIo);
+
     *pcbReqIo = cbReqIo;
 
     LogFlowFunc(("returns %Rrc *pcbReqIo=%zu\n", rc, *pcbReqIo));
@@ -2926,6 +3276,8 @@ static int drvvdMediaExIoReqDiscardWrapper(PVBOXDISK pThis, PPDMMEDIAEXIOREQINT
 
     LogFlowFunc(("pThis=%#p pIoReq=%#p\n", pThis, pIoReq));
 
+    drvvdReadAheadInvalidate(pThis, 0, UINT64_MAX);
+
     if (   pThis->fAsyncIOSupported
         && !(pIoReq->fFlags & PDMIMEDIAEX_F_SYNC))
     {
@@ -4041,6 +4393,8 @@ static int drvvdSetupFilters(PVBOXDISK pThis, PCFGMNODE pCfg)
             AssertRC(rc);
 
             rc = VDFilterAdd(pThis->pDisk, pszFilterName, VD_FILTER_FLAGS_DEFAULT, pVDIfsFilter);
+            if (RT_SUCCESS(rc))
+                pThis->fFiltersAttached = true;
 
             PDMDrvHlpMMHeapFree(pThis->pDrvIns, pszFilterName);
         }
@@ -4190,6 +4544,18 @@ static int drvvdStatsRegister(PVBOXDISK pThis)
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReqsPerSec,         STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
                            "Number of processed I/O requests per second.",  "%s/ReqsPerSec", szPrefix);
 
+    if (pThis->fReadAheadEnabled)
+    {
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReadAheadIssued,      STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_COUNT,
+                               "Number of read-ahead requests issued.",         "%s/ReadAhead/Issued", szPrefix);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReadAheadHits,        STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_COUNT,
+                               "Number of reads served from read-ahead.",       "%s/ReadAhead/Hits", szPrefix);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReadAheadBytesHit,    STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_BYTES,
+                               "Amount of data served from read-ahead.",        "%s/ReadAhead/BytesHit", szPrefix);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReadAheadBytesWasted, STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_BYTES,
+                               "Amount of read-ahead data never used.",         "%s/ReadAhead/BytesWasted", szPrefix);
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -4215,6 +4581,14 @@ static void drvvdStatsDeregister(PVBOXDISK pThis)
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqsRead);
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqsDiscard);
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReqsPerSec);
+
+    if (pThis->fReadAheadEnabled)
+    {
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReadAheadIssued);
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReadAheadHits);
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReadAheadBytesHit);
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReadAheadBytesWasted);
+    }
 }
 
 
@@ -4312,6 +4686,9 @@ static void drvvdPowerOffOrDestructOrUnmount(PPDMDRVINS pDrvIns)
         pThis->pRegionList = NULL;
     }
 
+    if (pThis->fReadAheadEnabled)
+        drvvdReadAheadDrain(pThis);
+
     if (RT_VALID_PTR(pThis->pDisk))
     {
         VDDestroy(pThis->pDisk);
@@ -4320,12 +4697,37 @@ static void drvvdPowerOffOrDestructOrUnmount(PPDMDRVINS pDrvIns)
     drvvdFreeImages(pThis);
 }
 
+/**
+ * @callback_method_impl{FNPDMDRVASYNCNOTIFY, Power off once read-ahead is done.}
+ */
+static DECLCALLBACK(bool) drvvdIsAsyncPowerOffDone(PPDMDRVINS pDrvIns)
+{
+    PVBOXDISK pThis = PDMINS_2_DATA(pDrvIns, PVBOXDISK);
+    if (ASMAtomicReadU32(&pThis->cReadAheadActive))
+        return false;
+
+    drvvdPowerOffOrDestructOrUnmount(pDrvIns);
+    return true;
+}
+
 /**
  * @copydoc FNPDMDRVPOWEROFF
  */
 static DECLCALLBACK(void) drvvdPowerOff(PPDMDRVINS pDrvIns)
 {
     PDMDRV_CHECK_VERSIONS_RETURN_VOID(pDrvIns);
+    PVBOXDISK pThis = PDMINS_2_DATA(pDrvIns, PVBOXDISK);
+
+    if (pThis->fReadAheadEnabled)
+    {
+        ASMAtomicWriteBool(&pThis->fReadAheadDrain, true);
+        if (ASMAtomicReadU32(&pThis->cReadAheadActive))
+        {
+            PDMDrvHlpSetAsyncNotification(pDrvIns, drvvdIsAsyncPowerOffDone);
+            return;
+        }
+    }
+
     drvvdPowerOffOrDestructOrUnmount(pDrvIns);
 }
 
@@ -4349,6 +4751,7 @@ static DECLCALLBACK(void) drvvdResume(PPDMDRVINS pDrvIns)
     drvvdSetWritable(pThis);
     pThis->fSuspending      = false;
     pThis->fRedo            = false;
+    ASMAtomicWriteBool(&pThis->fReadAheadDrain, false);
 
     if (pThis->pBlkCache)
     {
@@ -4437,6 +4840,35 @@ static DECLCALLBACK(void) drvvdResume(PPDMDRVINS pDrvIns)
     pThis->fErrorUseRuntime = true;
 }
 
+/**
+ * Worker for drvvdSuspend and drvvdIsAsyncSuspendDone.
+ *
+ * @param   pThis     VBox disk container instance data.
+ */
+static void drvvdSuspendWorker(PVBOXDISK pThis)
+{
+    if (pThis->pBlkCache)
+    {
+        int rc = PDMDrvHlpBlkCacheSuspend(pThis->pDrvIns, pThis->pBlkCache);
+        AssertRC(rc);
+    }
+
+    drvvdSetReadonly(pThis);
+}
+
+/**
+ * @callback_method_impl{FNPDMDRVASYNCNOTIFY, Suspend once read-ahead is done.}
+ */
+static DECLCALLBACK(bool) drvvdIsAsyncSuspendDone(PPDMDRVINS pDrvIns)
+{
+    PVBOXDISK pThis = PDMINS_2_DATA(pDrvIns, PVBOXDISK);
+    if (ASMAtomicReadU32(&pThis->cReadAheadActive))
+        return false;
+
+    drvvdSuspendWorker(pThis);
+    return true;
+}
+
 /**
  * @callback_method_impl{FNPDMDRVSUSPEND}
  *
@@ -4457,13 +4889,18 @@ static DECLCALLBACK(void) drvvdSuspend(PPDMDRVINS pDrvIns)
     LogFlowFunc(("\n"));
     PVBOXDISK pThis = PDMINS_2_DATA(pDrvIns, PVBOXDISK);
 
-    if (pThis->pBlkCache)
+    /* The images must not be reopened underneath a read-ahead request. */
+    if (pThis->fReadAheadEnabled)
     {
-        int rc = PDMDrvHlpBlkCacheSuspend(pThis->pDrvIns, pThis->pBlkCache);
-        AssertRC(rc);
+        ASMAtomicWriteBool(&pThis->fReadAheadDrain, true);
+        if (ASMAtomicReadU32(&pThis->cReadAheadActive))
+        {
+            PDMDrvHlpSetAsyncNotification(pDrvIns, drvvdIsAsyncSuspendDone);
+            return;
+        }
     }
 
-    drvvdSetReadonly(pThis);
+    drvvdSuspendWorker(pThis);
 }
 
 /**
@@ -4497,6 +4934,15 @@ static DECLCALLBACK(void) drvvdReset(PPDMDRVINS pDrvIns)
         pThis->cbDataValid      = 0;
         pThis->offDisk          = 0;
     }
+
+    if (pThis->fReadAheadEnabled)
+    {
+        drvvdReadAheadInvalidate(pThis, 0, UINT64_MAX);
+        RTCritSectEnter(&pThis->CritSectReadAhead);
+        pThis->cReadAheadSeqReads = 0;
+        pThis->offReadAheadNext   = UINT64_MAX;
+        RTCritSectLeave(&pThis->CritSectReadAhead);
+    }
     pThis->fLocked = false;
 }
 
@@ -4526,6 +4972,14 @@ static DECLCALLBACK(void) drvvdDestruct(PPDMDRVINS pDrvIns)
         RTMemFree(pThis->pbData);
         pThis->pbData = NULL;
     }
+    for (unsigned i = 0; i < RT_ELEMENTS(pThis->aReadAheadBufs); i++)
+        if (pThis->aReadAheadBufs[i].pbBuf)
+        {
+            RTMemFree(pThis->aReadAheadBufs[i].pbBuf);
+            pThis->aReadAheadBufs[i].pbBuf = NULL;
+        }
+    if (RTCritSectIsInitialized(&pThis->CritSectReadAhead))
+        RTCritSectDelete(&pThis->CritSectReadAhead);
     if (pThis->pszBwGroup)
     {
         PDMDrvHlpMMHeapFree(pDrvIns, pThis->pszBwGroup);
@@ -4737,6 +5191,7 @@ static DECLCALLBACK(int) drvvdConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uint
                                                  "Format\0Path\0"
                                                  "ReadOnly\0MaybeReadOnly\0TempReadOnly\0Shareable\0HonorZeroWrites\0"
                                                  "HostIPStack\0UseNewIo\0BootAcceleration\0BootAccelerationBuffer\0"
+                                                 "ReadAhead\0ReadAheadBufferSize\0ParentHostCache\0"
                                                  "SetupMerge\0MergeSource\0MergeTarget\0BwGroup\0Type\0BlockCache\0"
                                                  "CachePath\0CacheFormat\0Discard\0InformAboutZeroBlocks\0"
                                                  "SkipConsistencyChecks\0"
@@ -4851,6 +5306,36 @@ static DECLCALLBACK(int) drvvdConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uint
                                       N_("DrvVD: Configuration error: Querying \"BootAccelerationBuffer\" as integer failed"));
                 break;
             }
+            rc = pHlp->pfnCFGMQueryBoolDef(pCurNode, "ReadAhead", &pThis->fReadAheadEnabled, false);
+            if (RT_FAILURE(rc))
+            {
+                rc = PDMDRV_SET_ERROR(pDrvIns, rc,
+                                      N_("DrvVD: Configuration error: Querying \"ReadAhead\" as boolean failed"));
+                break;
+            }
+            rc = pHlp->pfnCFGMQueryBoolDef(pCurNode, "ParentHostCache", &pThis->fParentHostCache, false);
+            if (RT_FAILURE(rc))
+            {
+                rc = PDMDRV_SET_ERROR(pDrvIns, rc,
+                                      N_("DrvVD: Configuration error: Querying \"ParentHostCache\" as boolean failed"));
+                break;
+            }
+            uint32_t cbReadAheadBuf = 0;
+            rc = pHlp->pfnCFGMQueryU32Def(pCurNode, "ReadAheadBufferSize", &cbReadAheadBuf, _1M);
+            if (RT_FAILURE(rc))
+            {
+                rc = PDMDRV_SET_ERROR(pDrvIns, rc,
+                                      N_("DrvVD: Configuration error: Querying \"ReadAheadBufferSize\" as integer failed"));
+                break;
+            }
+            if (   cbReadAheadBuf < DRVVD_READAHEAD_SIZE_MIN
+                || cbReadAheadBuf > DRVVD_READAHEAD_SIZE_MAX)
+            {
+                rc = PDMDRV_SET_ERROR(pDrvIns, VERR_PDM_DRIVER_INVALID_PROPERTIES,
+                                      N_("DrvVD: Configuration error: \"ReadAheadBufferSize\" is out of range"));
+                break;
+            }
+            pThis->cbReadAheadMax = cbReadAheadBuf;
             rc = pHlp->pfnCFGMQueryBoolDef(pCurNode, "BlockCache", &fUseBlockCache, false);
             if (RT_FAILURE(rc))
             {
@@ -5486,6 +5971,44 @@ static DECLCALLBACK(int) drvvdConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uint
                 LogRel(("VD: Boot acceleration, out of memory, disabled\n"));
         }
 
+        /*
+         * Setup read-ahead for sequential readers. It only works for the async
+         * I/O path and is redundant with the block cache, so skip it otherwise.
+         * The flag stays clear until everything is allocated as it is checked
+         * without taking the critical section.
+         */
+        if (RT_SUCCESS(rc) && pThis->fReadAheadEnabled)
+        {
+            pThis->fReadAheadEnabled = false;
+            if (   pThis->fAsyncIOSupported
+                && !pThis->pBlkCache)
+            {
+                rc = RTCritSectInit(&pThis->CritSectReadAhead);
+                if (RT_SUCCESS(rc))
+                {
+                    bool fOk = true;
+                    for (unsigned i = 0; i < RT_ELEMENTS(pThis->aReadAheadBufs) && fOk; i++)
+                    {
+                        pThis->aReadAheadBufs[i].pbBuf = (uint8_t *)RTMemAlloc(pThis->cbReadAheadMax);
+                        fOk = pThis->aReadAheadBufs[i].pbBuf != NULL;
+                    }
+
+                    if (fOk)
+                    {
+                        pThis->cbReadAheadCur     = DRVVD_READAHEAD_SIZE_MIN;
+                        pThis->cReadAheadSeqReads = 0;
+                        pThis->offReadAheadNext   = UINT64_MAX;
+                        pThis->fReadAheadEnabled  = true;
+                        LogRel(("VD#%u: Read-ahead enabled (up to %zu bytes)\n", pDrvIns->iInstance, pThis->cbReadAheadMax));
+                    }
+                    else
+                        LogRel(("VD#%u: Read-ahead, out of memory, disabled\n", pDrvIns->iInstance));
+                }
+            }
+            else
+                LogRel(("VD#%u: Read-ahead requires async I/O without the block cache, disabled\n", pDrvIns->iInstance));
+        }
+
         if (   RTUuidIsNull(&pThis->Uuid)
             && pThis->enmType == PDMMEDIATYPE_HARD_DISK)
             VDGetUuid(pThis->pDisk, 0, &pThis->Uuid);
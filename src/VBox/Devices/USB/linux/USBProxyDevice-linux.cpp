@@ -1512,7 +1512,6 @@ static DECLCALLBACK(PVUSBURB) usbProxyLinuxUrbReap(PUSBPROXYDEV pProxyDev, RTMSI
             if (pUrbLnx->cbSplitRemaining && (pKUrb->actual_length == pKUrb->buffer_length) && !pUrbLnx->pSplitNext)
             {
                 bool fUnplugged = false;
-                bool fSucceeded;
 
                 Assert(pUrbLnx->pSplitHead);
                 Assert((pKUrb->endpoint & 0x80) && !(pKUrb->flags & USBDEVFS_URB_SHORT_NOT_OK));
@@ -1523,10 +1522,10 @@ static DECLCALLBACK(PVUSBURB) usbProxyLinuxUrbReap(PUSBPROXYDEV pProxyDev, RTMSI
                     return NULL;
                 }
                 PVUSBURB pUrb = (PVUSBURB)pUrbLnx->KUrb.usercontext;
-                fSucceeded = usbProxyLinuxSubmitURB(pProxyDev, pNew, pUrb, &fUnplugged);
+                int rc2 = usbProxyLinuxSubmitURB(pProxyDev, pNew, pUrb, &fUnplugged);
                 if (fUnplugged)
                     usbProxLinuxUrbUnplugged(pProxyDev);
-                if (!fSucceeded)
+                if (RT_FAILURE(rc2))
                     return NULL;
                 continue;   /* try reaping another URB */
             }
@@ -47,6 +47,15 @@
 #include <VBox/vmm/pdmdev.h>
 #include "VirtioCore.h"
 
+#if   defined(VBOX_WITH_DTRACE) \
+   && defined(IN_RING3) \
+   && !defined(VBOX_DEVICE_STRUCT_TESTCASE)
+# include "dtrace/VBoxDD.h"
+#else
+# define VBOXDD_VIRTIO_VIRTQ_NOTIFIED(a,b)         do { } while (0)
+# define VBOXDD_VIRTIO_VIRTQ_NOTIFY_GUEST(a,b)     do { } while (0)
+#endif
+
 
 /*********************************************************************************************************************************
 *   Defined Constants And Macros                                                                                                 *
@@ -56,7 +65,7 @@
 #define VIRTQNAME(a_pVirtio, a_uVirtq)      ((a_pVirtio)->aVirtqueues[(a_uVirtq)].szName)
 
 #define IS_VIRTQ_EMPTY(pDevIns, pVirtio, pVirtq) \
-            (virtioCoreVirtqAvailCnt(pDevIns, pVirtio, pVirtq) == 0)
+            virtioCoreVirtqIsEmpty(pDevIns, pVirtio, pVirtq)
 
 #define IS_DRIVER_OK(a_pVirtio)             ((a_pVirtio)->fDeviceStatus & VIRTIO_STATUS_DRIVER_OK)
 #define WAS_DRIVER_OK(a_pVirtio)            ((a_pVirtio)->fPrevDeviceStatus & VIRTIO_STATUS_DRIVER_OK)
@@ -71,6 +80,9 @@
 #define DRIVER_FEATURES_0_AND_1_WRITTEN                  3   /**< Both 32-bit parts of fDriverFeatures[] written  */
 #define DRIVER_FEATURES_COMPLETE_HANDLED                 4   /**< Features negotiation complete handler called    */
 
+/** Number of leading indirect table descriptors virtioCoreR3VirtqAvailBufGet() fetches with a single read. */
+#define VIRTIO_INDIRECT_DESC_CACHE_SIZE                 32
+
 /**
  * This macro returns true if the @a a_offAccess and access length (@a
  * a_cbAccess) are within the range of the mapped capability struct described by
@@ -207,6 +219,7 @@ DECLINLINE(uint16_t) virtioReadAvailDescIdx(PPDMDEVINS pDevIns, PVIRTIOCORE pVir
                          &uDescIdx, sizeof(uDescIdx));
     return uDescIdx;
 }
+#endif
 
 DECLINLINE(uint16_t) virtioReadAvailUsedEvent(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, PVIRTQUEUE pVirtq)
 {
@@ -218,7 +231,6 @@ DECLINLINE(uint16_t) virtioReadAvailUsedEvent(PPDMDEVINS pDevIns, PVIRTIOCORE pV
                          &uUsedEventIdx, sizeof(uUsedEventIdx));
     return uUsedEventIdx;
 }
-#endif
 
 DECLINLINE(uint16_t) virtioReadAvailRingIdx(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, PVIRTQUEUE pVirtq)
 {
@@ -278,7 +290,6 @@ DECLINLINE(void) virtioWriteUsedRingIdx(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio,
                           &uIdx, sizeof(uIdx));
 }
 
-#ifdef IN_RING3
 DECLINLINE(uint16_t) virtioReadUsedRingIdx(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, PVIRTQUEUE pVirtq)
 {
     uint16_t uIdx = 0;
@@ -289,6 +300,7 @@ DECLINLINE(uint16_t) virtioReadUsedRingIdx(PPDMDEVINS pDevIns, PVIRTIOCORE pVirt
     return uIdx;
 }
 
+#ifdef IN_RING3
 DECLINLINE(uint16_t) virtioReadUsedRingFlags(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, PVIRTQUEUE pVirtq)
 {
     uint16_t fFlags = 0;
@@ -299,7 +311,7 @@ DECLINLINE(uint16_t) virtioReadUsedRingFlags(PPDMDEVINS pDevIns, PVIRTIOCORE pVi
     return fFlags;
 }
 
-DECLINLINE(void) virtioWriteUsedAvailEvent(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, PVIRTQUEUE pVirtq, uint32_t uAvailEventIdx)
+DECLINLINE(void) virtioWriteUsedAvailEvent(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, PVIRTQUEUE pVirtq, uint16_t uAvailEventIdx)
 {
     /** VirtIO 1.0 uAvailEventIdx (avail_event) immediately follows ring */
     AssertMsg(pVirtio->fLegacyDriver || IS_DRIVER_OK(pVirtio), ("Called with guest driver not ready\n"));
@@ -314,16 +326,28 @@ DECLINLINE(void) virtioWriteUsedAvailEvent(PPDMDEVINS pDevIns, PVIRTIOCORE pVirt
 
 DECLINLINE(uint16_t) virtioCoreVirtqAvailCnt(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, PVIRTQUEUE pVirtq)
 {
-    uint16_t uIdxActual = virtioReadAvailRingIdx(pDevIns, pVirtio, pVirtq);
-    uint16_t uIdxShadow = pVirtq->uAvailIdxShadow;
-    uint16_t uIdxDelta;
+    uint16_t const uIdxActual = virtioReadAvailRingIdx(pDevIns, pVirtio, pVirtq);
+    pVirtq->uAvailIdxCache = uIdxActual;
 
-    if (uIdxActual < uIdxShadow)
-        uIdxDelta = (uIdxActual + pVirtq->uQueueSize) - uIdxShadow;
-    else
-        uIdxDelta = uIdxActual - uIdxShadow;
+    /* Both indexes are free running and wrap at 64K, not at the queue size. */
+    return (uint16_t)(uIdxActual - pVirtq->uAvailIdxShadow);
+}
 
-    return uIdxDelta;
+/**
+ * Checks whether the avail ring holds no unconsumed entries.
+ *
+ * Entries between our shadow index and the avail index we last read from the
+ * guest are never taken back by the driver, so as long as we are behind that
+ * cached index there is no need to read the ring index from guest memory
+ * again.  A cached value that isn't within a queue size ahead of the shadow
+ * (stale, or from before a reset) is ignored.
+ */
+DECLINLINE(bool) virtioCoreVirtqIsEmpty(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, PVIRTQUEUE pVirtq)
+{
+    uint16_t const cCached = (uint16_t)(pVirtq->uAvailIdxCache - pVirtq->uAvailIdxShadow);
+    if (cCached != 0 && cCached <= pVirtq->uQueueSize)
+        return false;
+    return virtioCoreVirtqAvailCnt(pDevIns, pVirtio, pVirtq) == 0;
 }
 /**
  * Get count of new (e.g. pending) elements in available ring.
@@ -600,6 +624,7 @@ DECLHIDDEN(int) virtioCoreR3VirtqDetach(PVIRTIOCORE pVirtio, uint16_t uVirtqNbr)
     PVIRTQUEUE pVirtq = &pVirtio->aVirtqueues[uVirtqNbr];
     pVirtq->uVirtq          = 0;
     pVirtq->uAvailIdxShadow = 0;
+    pVirtq->uAvailIdxCache  = 0;
     pVirtq->uUsedIdxShadow  = 0;
     pVirtq->fUsedRingEvent  = false;
     pVirtq->fAttached       = false;
@@ -932,6 +957,14 @@ DECLHIDDEN(int) virtioCoreR3VirtqAvailBufGet(PPDMDEVINS pDevIns, PVIRTIOCORE pVi
     PVIRTIOSGSEG paSegsIn  = pVirtqBuf->aSegsIn;
     PVIRTIOSGSEG paSegsOut = pVirtqBuf->aSegsOut;
 
+    /* Indirect descriptor table being walked, if any (VirtIO 1.0, 2.4.5.3).  The head of the
+       table is read in one go into aIndirect, which covers the common case of drivers laying
+       out the table sequentially. */
+    RTGCPHYS     GCPhysIndirect  = NIL_RTGCPHYS;
+    uint32_t     cIndirect       = 0;
+    uint32_t     cIndirectCached = 0;
+    VIRTQ_DESC_T aIndirect[VIRTIO_INDIRECT_DESC_CACHE_SIZE];
+
     do
     {
         PVIRTIOSGSEG pSeg;
@@ -969,7 +1002,49 @@ DECLHIDDEN(int) virtioCoreR3VirtqAvailBufGet(PPDMDEVINS pDevIns, PVIRTIOCORE pVi
         }
         RT_UNTRUSTED_VALIDATED_FENCE();
 
-        virtioReadDesc(pDevIns, pVirtio, pVirtq, uDescIdx, &desc);
+        if (GCPhysIndirect == NIL_RTGCPHYS)
+            virtioReadDesc(pDevIns, pVirtio, pVirtq, uDescIdx, &desc);
+        else
+        {
+            if (uDescIdx >= cIndirect)
+            {
+                LogRelMax(64, ("Indirect descriptor index out of range (uDescIdx=%u cIndirect=%u queue=%s).\n",
+                               uDescIdx, cIndirect, pVirtq->szName));
+                break;
+            }
+            if (uDescIdx < cIndirectCached)
+                desc = aIndirect[uDescIdx];
+            else
+                virtioCoreGCPhysRead(pVirtio, pDevIns, GCPhysIndirect + uDescIdx * sizeof(VIRTQ_DESC_T), &desc, sizeof(desc));
+        }
+
+        if (desc.fFlags & VIRTQ_DESC_F_INDIRECT)
+        {
+            /* The driver must not nest tables nor combine F_INDIRECT with F_NEXT (VirtIO 1.0, 2.4.5.3.1). */
+            if (   GCPhysIndirect != NIL_RTGCPHYS
+                || (desc.fFlags & VIRTQ_DESC_F_NEXT)
+                || desc.cb < sizeof(VIRTQ_DESC_T)
+                || desc.cb % sizeof(VIRTQ_DESC_T)
+                || !(pVirtio->uDriverFeatures & VIRTIO_F_INDIRECT_DESC))
+            {
+                LogRelMax(64, ("Invalid indirect descriptor (fFlags=%#x cb=%u queue=%s).\n",
+                               desc.fFlags, desc.cb, pVirtq->szName));
+                break;
+            }
+            Log6Func(("%s INDIRECT table at %RGp, %u descriptors\n", pVirtq->szName, desc.GCPhysBuf,
+                      desc.cb / (uint32_t)sizeof(VIRTQ_DESC_T)));
+            GCPhysIndirect  = desc.GCPhysBuf;
+            cIndirect       = desc.cb / sizeof(VIRTQ_DESC_T);
+            cIndirectCached = RT_MIN(cIndirect, RT_ELEMENTS(aIndirect));
+            uDescIdx        = 0;
+            virtioCoreGCPhysRead(pVirtio, pDevIns, GCPhysIndirect, &aIndirect[0], cIndirectCached * sizeof(VIRTQ_DESC_T));
+            desc = aIndirect[0];
+            if (desc.fFlags & VIRTQ_DESC_F_INDIRECT)
+            {
+                LogRelMax(64, ("Nested indirect descriptor table (queue=%s).\n", pVirtq->szName));
+                break;
+            }
+        }
 
         if (desc.fFlags & VIRTQ_DESC_F_WRITE)
         {
@@ -1104,11 +1179,6 @@ DECLHIDDEN(int) virtioCoreR3VirtqUsedBufPut(PPDMDEVINS pDevIns, PVIRTIOCORE pVir
         Assert(!(cbCopy >> 32));
     }
 
-    /* Flag if write-ahead crosses threshold where guest driver indicated it wants event notification */
-    if (pVirtio->uDriverFeatures & VIRTIO_F_EVENT_IDX)
-        if (pVirtq->uUsedIdxShadow == virtioReadAvailUsedEvent(pDevIns, pVirtio, pVirtq))
-            pVirtq->fUsedRingEvent = true;
-
     /*
      * Place used buffer's descriptor in used ring but don't update used ring's slot index.
      * That will be done with a subsequent client call to virtioCoreVirtqUsedRingSync()
@@ -1185,10 +1255,6 @@ DECLHIDDEN(int) virtioCoreR3VirtqUsedBufPut(PPDMDEVINS pDevIns, PVIRTIOCORE pVir
             RT_UNTRUSTED_NONVOLATILE_COPY_FENCE(); /* needed? */
             Assert(!(cbCopy >> 32));
         }
-        /* Flag if write-ahead crosses threshold where guest driver indicated it wants event notification */
-        if (pVirtio->uDriverFeatures & VIRTIO_F_EVENT_IDX)
-            if (pVirtq->uUsedIdxShadow == virtioReadAvailUsedEvent(pDevIns, pVirtio, pVirtq))
-                pVirtq->fUsedRingEvent = true;
         /*
          * Place used buffer's descriptor in used ring but don't update used ring's slot index.
          * That will be done with a subsequent client call to virtioCoreVirtqUsedRingSync()
@@ -1230,7 +1296,23 @@ DECLHIDDEN(int) virtioCoreVirtqUsedRingSync(PPDMDEVINS pDevIns, PVIRTIOCORE pVir
     Log6Func(("    Sync %s used ring (%u -> idx)\n",
                         pVirtq->szName, pVirtq->uUsedIdxShadow));
 
-    virtioWriteUsedRingIdx(pDevIns, pVirtio, pVirtq, pVirtq->uUsedIdxShadow);
+    if (pVirtio->uDriverFeatures & VIRTIO_F_EVENT_IDX)
+    {
+        /*
+         * Interrupt if the used index moved past used_event with this update (VirtIO 1.0, 2.4.7.2).
+         * This is evaluated over the whole batch since the last sync, as the driver may move
+         * used_event at any time.  The new index must be visible before used_event is sampled.
+         */
+        uint16_t const uUsedIdxOld = virtioReadUsedRingIdx(pDevIns, pVirtio, pVirtq);
+        uint16_t const uUsedIdxNew = pVirtq->uUsedIdxShadow;
+        virtioWriteUsedRingIdx(pDevIns, pVirtio, pVirtq, uUsedIdxNew);
+        ASMMemoryFence();
+        uint16_t const uUsedEventIdx = virtioReadAvailUsedEvent(pDevIns, pVirtio, pVirtq);
+        if ((uint16_t)(uUsedIdxNew - uUsedEventIdx - 1) < (uint16_t)(uUsedIdxNew - uUsedIdxOld))
+            pVirtq->fUsedRingEvent = true;
+    }
+    else
+        virtioWriteUsedRingIdx(pDevIns, pVirtio, pVirtq, pVirtq->uUsedIdxShadow);
     virtioCoreNotifyGuestDriver(pDevIns, pVirtio, uVirtq);
 
     return VINF_SUCCESS;
@@ -1267,6 +1349,7 @@ static void virtioCoreVirtqNotified(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio, uin
         virtioCoreVirtqAvailCnt(pDevIns, pVirtio, pVirtq)));
 
     /* Inform client */
+    VBOXDD_VIRTIO_VIRTQ_NOTIFIED(pVirtio, uVirtq);
     pVirtioCC->pfnVirtqNotified(pDevIns, pVirtio, uVirtq);
     RT_NOREF2(pVirtio, pVirtq);
 }
@@ -1301,6 +1384,7 @@ static void virtioCoreNotifyGuestDriver(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio,
             Log6Func(("...kicking guest %s, VIRTIO_F_EVENT_IDX set and threshold (%d) reached\n",
                    pVirtq->szName, (uint16_t)virtioReadAvailUsedEvent(pDevIns, pVirtio, pVirtq)));
 #endif
+            VBOXDD_VIRTIO_VIRTQ_NOTIFY_GUEST(pVirtio, uVirtq);
             virtioNudgeGuest(pDevIns, pVirtio, VIRTIO_ISR_VIRTQ_INTERRUPT, pVirtq->uMsixVector);
             pVirtq->fUsedRingEvent = false;
             return;
@@ -1315,6 +1399,7 @@ static void virtioCoreNotifyGuestDriver(PPDMDEVINS pDevIns, PVIRTIOCORE pVirtio,
         /** If guest driver hasn't suppressed interrupts, interrupt  */
         if (!(virtioReadAvailRingFlags(pDevIns, pVirtio, pVirtq) & VIRTQ_AVAIL_F_NO_INTERRUPT))
         {
+            VBOXDD_VIRTIO_VIRTQ_NOTIFY_GUEST(pVirtio, uVirtq);
             virtioNudgeGuest(pDevIns, pVirtio, VIRTIO_ISR_VIRTQ_INTERRUPT, pVirtq->uMsixVector);
             return;
         }
@@ -1380,6 +1465,7 @@ static void virtioResetVirtq(PVIRTIOCORE pVirtio, uint16_t uVirtq)
     pVirtq->uNotifyOffset    = uVirtq;
     pVirtq->fUsedRingEvent   = false;
     pVirtq->uAvailIdxShadow  = 0;
+    pVirtq->uAvailIdxCache   = 0;
     pVirtq->uUsedIdxShadow   = 0;
     pVirtq->uMsixVector      = uVirtq + 2;
 
@@ -2585,6 +2671,7 @@ DECLHIDDEN(int) virtioCoreR3LegacyDeviceLoadExec(PVIRTIOCORE pVirtio, PCPDMDEVHL
 
         rc = pHlp->pfnSSMGetU16(pSSM, &pVirtq->uAvailIdxShadow);
         AssertRCReturn(rc, rc);
+        pVirtq->uAvailIdxCache = pVirtq->uAvailIdxShadow;
 
         rc = pHlp->pfnSSMGetU16(pSSM, &pVirtq->uUsedIdxShadow);
         AssertRCReturn(rc, rc);
@@ -2690,6 +2777,7 @@ DECLHIDDEN(int) virtioCoreR3ModernDeviceLoadExec(PVIRTIOCORE pVirtio, PCPDMDEVHL
         AssertRCReturn(rc, rc);
         rc = pHlp->pfnSSMGetU16(      pSSM, &pVirtq->uAvailIdxShadow);
         AssertRCReturn(rc, rc);
+        pVirtq->uAvailIdxCache = pVirtq->uAvailIdxShadow;
         rc = pHlp->pfnSSMGetU16(      pSSM, &pVirtq->uUsedIdxShadow);
         AssertRCReturn(rc, rc);
         rc = pHlp->pfnSSMGetMem( pSSM, pVirtq->szName,  sizeof(pVirtq->szName));
@@ -243,7 +243,9 @@ static const VIRTIO_FEATURES_LIST s_aCoreFeatures[] =
     { VIRTIO_F_RING_INDIRECT_DESC,      "   RING_INDIRECT_DESC   Driver can use descriptors with VIRTQ_DESC_F_INDIRECT flag set\n" },
 };
 
-#define VIRTIO_DEV_INDEPENDENT_FEATURES_OFFERED ( 0 )            /**< TBD: Add VIRTIO_F_INDIRECT_DESC           */
+/** Device independent features offered to modern drivers, see virtioCoreR3VirtqAvailBufGet()
+ * for indirect descriptors and virtioCoreVirtqUsedRingSync() for used_event handling. */
+#define VIRTIO_DEV_INDEPENDENT_FEATURES_OFFERED ( VIRTIO_F_INDIRECT_DESC | VIRTIO_F_EVENT_IDX )
 #define VIRTIO_DEV_INDEPENDENT_LEGACY_FEATURES_OFFERED ( 0 )     /**< Only offered to legacy drivers            */
 
 #define VIRTIO_ISR_VIRTQ_INTERRUPT           RT_BIT_32(0)        /**< Virtq interrupt bit of ISR register       */
@@ -423,6 +425,7 @@ typedef struct VIRTQUEUE
     uint16_t                    uQueueSize;                       /**< (MMIO) Size of queue           HOST/GUEST */
     uint16_t                    uAvailIdxShadow;                  /**< Consumer's position in avail ring         */
     uint16_t                    uUsedIdxShadow;                   /**< Consumer's position in used ring          */
+    uint16_t                    uAvailIdxCache;                   /**< Avail idx last read from the guest ring   */
     uint16_t                    uVirtq;                           /**< Index of this queue                       */
     char                        szName[32];                       /**< Dev-specific name of queue                */
     bool                        fUsedRingEvent;                   /**< Flags if used idx to notify guest reached */
@@ -48,6 +48,7 @@ struct CLANG11WEIRDNESS { PFNRT pfn; } g_apfnVBoxDDUDeps[] =
     { (PFNRT)VDInit },
     { (PFNRT)VDIfCreateVfsStream },
     { (PFNRT)VDIfCreateFromVfsStream },
+    { (PFNRT)VDIfCreateFromVfsStreamEx },
     { (PFNRT)VDCreateVfsFileFromDisk },
     { (PFNRT)VDIfTcpNetInstDefaultCreate },
 #ifdef VBOX_WITH_USB
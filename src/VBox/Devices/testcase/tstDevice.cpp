@@ -1007,6 +1007,7 @@ int main(int argc, char *argv[])
         tstDevRegisterTestcase(NULL, &g_TestcaseSsmFuzz);
         tstDevRegisterTestcase(NULL, &g_TestcaseSsmLoadDbg);
         tstDevRegisterTestcase(NULL, &g_TestcaseIoFuzz);
+        tstDevRegisterTestcase(NULL, &g_TestcaseIoPerf);
 
         PCTSTDEVCFG pDevTstCfg = NULL;
         rc = tstDevCfgLoad(argv[1], NULL, &pDevTstCfg);
@@ -41,6 +41,7 @@ RT_C_DECLS_BEGIN
 extern const TSTDEVTESTCASEREG g_TestcaseSsmFuzz;
 extern const TSTDEVTESTCASEREG g_TestcaseSsmLoadDbg;
 extern const TSTDEVTESTCASEREG g_TestcaseIoFuzz;
+extern const TSTDEVTESTCASEREG g_TestcaseIoPerf;
 
 RT_C_DECLS_END
 
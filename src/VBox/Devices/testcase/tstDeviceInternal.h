@@ -36,6 +36,7 @@
 #include <iprt/list.h>
 #include <iprt/semaphore.h>
 #include <iprt/critsect.h>
+#include <iprt/time.h>
 
 #include "tstDeviceCfg.h"
 #include "tstDevicePlugin.h"
@@ -127,6 +128,8 @@ typedef struct PDMCRITSECTINT
 {
     /** The actual critical section used for emulation. */
     RTCRITSECT           CritSect;
+    /** Timestamp of the outermost enter, only valid while statistics are collected. */
+    uint64_t             tsEnter;
 } PDMCRITSECTINT;
 AssertCompile(sizeof(PDMCRITSECTINT) <= (HC_ARCH_BITS == 32 ? 0x80 : 0xc0));
 
@@ -469,6 +472,25 @@ typedef TSTDEVDUTPCIREGION *PTSTDEVDUTPCIREGION;
 /** Pointer to a const PCI region descriptor. */
 typedef const TSTDEVDUTPCIREGION *PCTSTDEVDUTPCIREGION;
 
+/**
+ * Statistics collected by the device helpers while enabled.
+ */
+typedef struct TSTDEVDUTSTATS
+{
+    /** Number of times a critical section was entered, recursions not counted. */
+    uint64_t                        cCritSectEnters;
+    /** Total nanoseconds critical sections were held. */
+    uint64_t                        cNsCritSectHeld;
+    /** Longest time a critical section was held in nanoseconds. */
+    uint64_t                        cNsCritSectHeldMax;
+    /** Number of MM heap allocations. */
+    uint64_t                        cMmHeapAllocs;
+    /** Number of bytes allocated from the MM heap. */
+    uint64_t                        cbMmHeapAlloc;
+} TSTDEVDUTSTATS;
+/** Pointer to the device helper statistics. */
+typedef TSTDEVDUTSTATS *PTSTDEVDUTSTATS;
+
 /**
  * Device under test instance data.
  */
@@ -512,6 +534,10 @@ typedef struct TSTDEVDUTINT
     TSTDEVDUTPCIREGION              aPciRegions[VBOX_PCI_NUM_REGIONS];
     /** The status port interface we implement. */
     PDMIBASE                        IBaseSts;
+    /** Flag whether the device helpers collect the statistics below. */
+    bool                            fStats;
+    /** Statistics collected by the device helpers. */
+    TSTDEVDUTSTATS                  Stats;
     /**  */
 } TSTDEVDUTINT;
 
@@ -545,6 +571,57 @@ DECLINLINE(int) tstDevDutUnlockExcl(PTSTDEVDUTINT pThis)
     return RTCritSectRwLeaveExcl(&pThis->CritSectLists);
 }
 
+/**
+ * Records the given critical section as entered for the statistics if enabled.
+ *
+ * @param   pThis               The device under test.
+ * @param   pCritSect           The critical section which was just entered.
+ */
+DECLINLINE(void) tstDevCritSectEntered(PTSTDEVDUTINT pThis, PPDMCRITSECT pCritSect)
+{
+    if (   pThis->fStats
+        && RTCritSectGetRecursion(&pCritSect->s.CritSect) == 1)
+    {
+        pThis->Stats.cCritSectEnters++;
+        pCritSect->s.tsEnter = RTTimeNanoTS();
+    }
+}
+
+/**
+ * Records the hold time of the given critical section for the statistics if enabled.
+ *
+ * @param   pThis               The device under test.
+ * @param   pCritSect           The critical section which is about to be left.
+ */
+DECLINLINE(void) tstDevCritSectLeaving(PTSTDEVDUTINT pThis, PPDMCRITSECT pCritSect)
+{
+    if (   pThis->fStats
+        && pCritSect->s.tsEnter
+        && RTCritSectGetRecursion(&pCritSect->s.CritSect) == 1)
+    {
+        uint64_t cNs = RTTimeNanoTS() - pCritSect->s.tsEnter;
+        pThis->Stats.cNsCritSectHeld += cNs;
+        if (cNs > pThis->Stats.cNsCritSectHeldMax)
+            pThis->Stats.cNsCritSectHeldMax = cNs;
+        pCritSect->s.tsEnter = 0;
+    }
+}
+
+/**
+ * Records an MM heap allocation for the statistics if enabled.
+ *
+ * @param   pThis               The device under test.
+ * @param   cb                  Size of the allocation.
+ */
+DECLINLINE(void) tstDevMmHeapAllocated(PTSTDEVDUTINT pThis, size_t cb)
+{
+    if (pThis->fStats)
+    {
+        pThis->Stats.cMmHeapAllocs++;
+        pThis->Stats.cbMmHeapAlloc += cb;
+    }
+}
+
 DECLHIDDEN(int) tstDevPdmR3ThreadCreateDevice(PTSTDEVDUTINT pDut, PPDMDEVINS pDevIns, PPPDMTHREAD ppThread, void *pvUser, PFNPDMTHREADDEV pfnThread,
                                               PFNPDMTHREADWAKEUPDEV pfnWakeUp, size_t cbStack, RTTHREADTYPE enmType, const char *pszName);
 DECLHIDDEN(int) tstDevPdmR3ThreadCreateUsb(PTSTDEVDUTINT pDut, PPDMUSBINS pUsbIns, PPPDMTHREAD ppThread, void *pvUser, PFNPDMTHREADUSB pfnThread,
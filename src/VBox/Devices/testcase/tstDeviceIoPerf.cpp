@@ -0,0 +1,532 @@
+/* $Id$ */
+/** @file
+ * tstDeviceIoPerf - I/O handler performance testcase replaying access traces.
+ */
+
+/*
+ * Copyright (C) 2021-2024 Oracle and/or its affiliates.
+ *
+ * This file is part of VirtualBox base platform packages, as
+ * available from https://www.virtualbox.org.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, in version 3 of the
+ * License.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#define LOG_GROUP LOG_GROUP_DEFAULT /** @todo */
+#include <VBox/types.h>
+#include <iprt/errcore.h>
+#include <iprt/ctype.h>
+#include <iprt/mem.h>
+#include <iprt/time.h>
+#include <iprt/string.h>
+#include <iprt/stream.h>
+
+#include "tstDeviceBuiltin.h"
+#include "tstDeviceCfg.h"
+#include "tstDeviceInternal.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+
+/** Maximum number of regions of each kind statistics are collected for. */
+#define TSTDEVIOPERF_REGIONS_MAX    32
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+
+/**
+ * A single recorded access from the trace.
+ */
+typedef struct TSTDEVIOPERFACCESS
+{
+    /** Flag whether this is an MMIO (true) or I/O port (false) access. */
+    bool                fMmio;
+    /** Flag whether this is a read. */
+    bool                fRead;
+    /** Access width in bytes. */
+    uint8_t             cbValue;
+    /** Index of the region in the registration order of the DUT. */
+    uint8_t             iRegion;
+    /** Offset into the region. */
+    uint64_t            off;
+    /** Value to write, ignored for reads. */
+    uint64_t            u64Value;
+} TSTDEVIOPERFACCESS;
+/** Pointer to a recorded access. */
+typedef TSTDEVIOPERFACCESS *PTSTDEVIOPERFACCESS;
+
+/**
+ * Timing statistics for one region and access direction.
+ */
+typedef struct TSTDEVIOPERFSTATS
+{
+    /** Number of accesses. */
+    uint64_t            cAccesses;
+    /** Total nanoseconds spent in the handlers. */
+    uint64_t            cNsTotal;
+    /** Fastest access. */
+    uint64_t            cNsMin;
+    /** Slowest access. */
+    uint64_t            cNsMax;
+} TSTDEVIOPERFSTATS;
+/** Pointer to the timing statistics. */
+typedef TSTDEVIOPERFSTATS *PTSTDEVIOPERFSTATS;
+
+
+static PCTSTDEVCFGITEM tstDevIoPerfGetCfgItem(PCTSTDEVCFGITEM paCfg, uint32_t cCfgItems, const char *pszName)
+{
+    for (uint32_t i = 0; i < cCfgItems; i++)
+    {
+        if (!RTStrCmp(paCfg[i].pszKey, pszName))
+            return &paCfg[i];
+    }
+
+    return NULL;
+}
+
+
+static const char *tstDevIoPerfGetCfgString(PCTSTDEVCFGITEM paCfg, uint32_t cCfgItems, const char *pszName)
+{
+    PCTSTDEVCFGITEM pCfgItem = tstDevIoPerfGetCfgItem(paCfg, cCfgItems, pszName);
+    if (   pCfgItem
+        && pCfgItem->enmType == TSTDEVCFGITEMTYPE_STRING)
+        return pCfgItem->u.psz;
+
+    return NULL;
+}
+
+
+static uint64_t tstDevIoPerfGetCfgU64(PCTSTDEVCFGITEM paCfg, uint32_t cCfgItems, const char *pszName)
+{
+    PCTSTDEVCFGITEM pCfgItem = tstDevIoPerfGetCfgItem(paCfg, cCfgItems, pszName);
+    if (   pCfgItem
+        && pCfgItem->enmType == TSTDEVCFGITEMTYPE_INTEGER)
+        return (uint64_t)pCfgItem->u.i64;
+
+    return 0;
+}
+
+
+/**
+ * Parses a single trace line of the form
+ * "<mmio|io> <region index> <r|w> <offset> <width> [value]".
+ *
+ * @returns VBox status code.
+ * @param   pszLine             The line to parse, modified.
+ * @param   pAccess             Where to store the parsed access.
+ */
+static int tstDevIoPerfParseLine(char *pszLine, PTSTDEVIOPERFACCESS pAccess)
+{
+    char *apszArgs[6];
+    unsigned cArgs = 0;
+    char *psz = RTStrStrip(pszLine);
+    while (*psz && cArgs < RT_ELEMENTS(apszArgs))
+    {
+        apszArgs[cArgs++] = psz;
+        while (*psz && !RT_C_IS_SPACE(*psz))
+            psz++;
+        if (*psz)
+        {
+            *psz++ = '\0';
+            psz = RTStrStripL(psz);
+        }
+    }
+
+    if (cArgs < 5)
+        return VERR_INVALID_PARAMETER;
+
+    if (!RTStrICmp(apszArgs[0], "mmio"))
+        pAccess->fMmio = true;
+    else if (!RTStrICmp(apszArgs[0], "io"))
+        pAccess->fMmio = false;
+    else
+        return VERR_INVALID_PARAMETER;
+
+    if (!RTStrICmp(apszArgs[2], "r"))
+        pAccess->fRead = true;
+    else if (!RTStrICmp(apszArgs[2], "w"))
+        pAccess->fRead = false;
+    else
+        return VERR_INVALID_PARAMETER;
+
+    uint8_t uRegion = 0;
+    int rc = RTStrToUInt8Full(apszArgs[1], 0, &uRegion);
+    if (rc != VINF_SUCCESS || uRegion >= TSTDEVIOPERF_REGIONS_MAX)
+        return VERR_INVALID_PARAMETER;
+    pAccess->iRegion = uRegion;
+
+    rc = RTStrToUInt64Full(apszArgs[3], 0, &pAccess->off);
+    if (rc != VINF_SUCCESS)
+        return VERR_INVALID_PARAMETER;
+
+    rc = RTStrToUInt8Full(apszArgs[4], 0, &pAccess->cbValue);
+    if (   rc != VINF_SUCCESS
+        || (   pAccess->cbValue != 1 && pAccess->cbValue != 2
+            && pAccess->cbValue != 4 && pAccess->cbValue != 8)
+        || (!pAccess->fMmio && pAccess->cbValue == 8))
+        return VERR_INVALID_PARAMETER;
+
+    pAccess->u64Value = 0;
+    if (!pAccess->fRead)
+    {
+        if (cArgs < 6)
+            return VERR_INVALID_PARAMETER;
+        rc = RTStrToUInt64Full(apszArgs[5], 0, &pAccess->u64Value);
+        if (rc != VINF_SUCCESS)
+            return VERR_INVALID_PARAMETER;
+    }
+
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Reads the whole trace file into an array of accesses.
+ *
+ * @returns VBox status code.
+ * @param   pszTrace            The trace file to load.
+ * @param   ppaAccesses         Where to store the array of accesses on success, free with RTMemFree().
+ * @param   pcAccesses          Where to store the number of accesses on success.
+ */
+static int tstDevIoPerfTraceLoad(const char *pszTrace, PTSTDEVIOPERFACCESS *ppaAccesses, uint32_t *pcAccesses)
+{
+    PRTSTREAM pStrm = NULL;
+    int rc = RTStrmOpen(pszTrace, "r", &pStrm);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    PTSTDEVIOPERFACCESS paAccesses = NULL;
+    uint32_t cAccesses = 0;
+    uint32_t cAccessesMax = 0;
+    uint32_t iLine = 0;
+    char szLine[256];
+    for (;;)
+    {
+        rc = RTStrmGetLine(pStrm, szLine, sizeof(szLine));
+        if (RT_FAILURE(rc))
+        {
+            if (rc == VERR_EOF)
+                rc = VINF_SUCCESS;
+            break;
+        }
+        iLine++;
+
+        char *pszLine = RTStrStrip(szLine);
+        if (   *pszLine == '\0'
+            || *pszLine == '#')
+            continue;
+
+        if (cAccesses == cAccessesMax)
+        {
+            uint32_t cAccessesNew = cAccessesMax ? cAccessesMax * 2 : _4K;
+            void *pvNew = RTMemRealloc(paAccesses, cAccessesNew * sizeof(TSTDEVIOPERFACCESS));
+            if (!pvNew)
+            {
+                rc = VERR_NO_MEMORY;
+                break;
+            }
+            paAccesses   = (PTSTDEVIOPERFACCESS)pvNew;
+            cAccessesMax = cAccessesNew;
+        }
+
+        rc = tstDevIoPerfParseLine(pszLine, &paAccesses[cAccesses]);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf("%s:%u: Malformed trace line\n", pszTrace, iLine);
+            break;
+        }
+        cAccesses++;
+    }
+
+    RTStrmClose(pStrm);
+
+    if (   RT_SUCCESS(rc)
+        && !cAccesses)
+        rc = VERR_NO_DATA;
+
+    if (RT_SUCCESS(rc))
+    {
+        *ppaAccesses = paAccesses;
+        *pcAccesses  = cAccesses;
+    }
+    else
+        RTMemFree(paAccesses);
+
+    return rc;
+}
+
+
+/**
+ * Adds a single sample to the given statistics.
+ *
+ * @param   pStats              The statistics to update.
+ * @param   cNs                 Duration of the access in nanoseconds.
+ */
+DECLINLINE(void) tstDevIoPerfStatsAdd(PTSTDEVIOPERFSTATS pStats, uint64_t cNs)
+{
+    pStats->cAccesses++;
+    pStats->cNsTotal += cNs;
+    if (cNs < pStats->cNsMin)
+        pStats->cNsMin = cNs;
+    if (cNs > pStats->cNsMax)
+        pStats->cNsMax = cNs;
+}
+
+
+/**
+ * Prints the statistics of one region and access direction if there were any accesses.
+ *
+ * @param   pszType             The region type.
+ * @param   iRegion             The region index.
+ * @param   pszDir              The access direction.
+ * @param   pStats              The statistics to print.
+ */
+static void tstDevIoPerfStatsPrint(const char *pszType, uint32_t iRegion, const char *pszDir, PTSTDEVIOPERFSTATS pStats)
+{
+    if (!pStats->cAccesses)
+        return;
+
+    RTPrintf("%-4s %2u %-5s: %10RU64 accesses, avg %8RU64 ns, min %8RU64 ns, max %10RU64 ns\n",
+             pszType, iRegion, pszDir, pStats->cAccesses, pStats->cNsTotal / pStats->cAccesses,
+             pStats->cNsMin, pStats->cNsMax);
+}
+
+
+/**
+ * Writes the statistics of one region and access direction as a CSV line if there were any accesses.
+ *
+ * @param   pStrm               The stream to write to.
+ * @param   pszType             The region type.
+ * @param   iRegion             The region index.
+ * @param   pszDir              The access direction.
+ * @param   pStats              The statistics to write.
+ */
+static void tstDevIoPerfStatsWrite(PRTSTREAM pStrm, const char *pszType, uint32_t iRegion, const char *pszDir,
+                                   PTSTDEVIOPERFSTATS pStats)
+{
+    if (!pStats->cAccesses)
+        return;
+
+    RTStrmPrintf(pStrm, "%s.%u.%s.ns,%RU64,%RU64,%RU64,%RU64\n",
+                 pszType, iRegion, pszDir, pStats->cAccesses, pStats->cNsTotal, pStats->cNsMin, pStats->cNsMax);
+}
+
+
+/**
+ * Entry point for the I/O performance testcase.
+ *
+ * @returns VBox status code.
+ * @param   hDut                The device under test.
+ * @param   paCfg               The testcase config.
+ * @param   cCfgItems           Number of config items.
+ */
+static DECLCALLBACK(int) tstDevIoPerfEntry(TSTDEVDUT hDut, PCTSTDEVCFGITEM paCfg, uint32_t cCfgItems)
+{
+    const char *pszTrace = tstDevIoPerfGetCfgString(paCfg, cCfgItems, "Trace");
+    if (!pszTrace)
+        return VERR_NOT_FOUND;
+
+    uint64_t cIterations = tstDevIoPerfGetCfgU64(paCfg, cCfgItems, "Iterations");
+    if (!cIterations)
+        cIterations = 1;
+
+    /* Collect the regions in registration order so the trace can refer to them by index. */
+    PRTDEVDUTIOPORT apIoPorts[TSTDEVIOPERF_REGIONS_MAX];
+    uint32_t cIoPortRegs = 0;
+    PRTDEVDUTIOPORT pIoPort;
+    RTListForEach(&hDut->LstIoPorts, pIoPort, RTDEVDUTIOPORT, NdIoPorts)
+    {
+        if (cIoPortRegs < RT_ELEMENTS(apIoPorts))
+            apIoPorts[cIoPortRegs++] = pIoPort;
+    }
+
+    PRTDEVDUTMMIO apMmio[TSTDEVIOPERF_REGIONS_MAX];
+    uint32_t cMmioRegions = 0;
+    PRTDEVDUTMMIO pMmio;
+    RTListForEach(&hDut->LstMmio, pMmio, RTDEVDUTMMIO, NdMmio)
+    {
+        if (cMmioRegions < RT_ELEMENTS(apMmio))
+            apMmio[cMmioRegions++] = pMmio;
+    }
+
+    PTSTDEVIOPERFACCESS paAccesses = NULL;
+    uint32_t cAccesses = 0;
+    int rc = tstDevIoPerfTraceLoad(pszTrace, &paAccesses, &cAccesses);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /* Validate the trace against the DUT up front so the replay loop doesn't have to. */
+    for (uint32_t i = 0; i < cAccesses && RT_SUCCESS(rc); i++)
+    {
+        PTSTDEVIOPERFACCESS pAccess = &paAccesses[i];
+        if (pAccess->fMmio)
+        {
+            if (   pAccess->iRegion >= cMmioRegions
+                || pAccess->off >= apMmio[pAccess->iRegion]->cbRegion
+                || pAccess->cbValue > apMmio[pAccess->iRegion]->cbRegion - pAccess->off
+                || (pAccess->fRead ? !apMmio[pAccess->iRegion]->pfnReadR3 : !apMmio[pAccess->iRegion]->pfnWriteR3))
+                rc = VERR_OUT_OF_RANGE;
+        }
+        else
+        {
+            if (   pAccess->iRegion >= cIoPortRegs
+                || pAccess->off >= apIoPorts[pAccess->iRegion]->cPorts
+                || (pAccess->fRead ? !apIoPorts[pAccess->iRegion]->pfnInR3 : !apIoPorts[pAccess->iRegion]->pfnOutR3))
+                rc = VERR_OUT_OF_RANGE;
+        }
+
+        if (RT_FAILURE(rc))
+            RTPrintf("Access %u doesn't match any handler of the device\n", i);
+    }
+
+    if (RT_SUCCESS(rc))
+    {
+        /* Index 0 collects reads, index 1 writes. */
+        TSTDEVIOPERFSTATS aStatsMmio[TSTDEVIOPERF_REGIONS_MAX][2];
+        TSTDEVIOPERFSTATS aStatsIoPort[TSTDEVIOPERF_REGIONS_MAX][2];
+        for (uint32_t i = 0; i < TSTDEVIOPERF_REGIONS_MAX; i++)
+            for (uint32_t j = 0; j < 2; j++)
+            {
+                aStatsMmio[i][j].cAccesses = 0;
+                aStatsMmio[i][j].cNsTotal  = 0;
+                aStatsMmio[i][j].cNsMin    = UINT64_MAX;
+                aStatsMmio[i][j].cNsMax    = 0;
+                aStatsIoPort[i][j]         = aStatsMmio[i][j];
+            }
+
+        /*
+         * The device lock is taken for every access like IOM does, so the lock statistics
+         * cover it along with any other critical section the handlers enter.
+         */
+        PPDMCRITSECT pCritSect = hDut->pDevIns->pCritSectRoR3;
+        RT_ZERO(hDut->Stats);
+        hDut->fStats = true;
+
+        uint64_t tsStart = RTTimeNanoTS();
+        for (uint64_t iIt = 0; iIt < cIterations; iIt++)
+        {
+            for (uint32_t i = 0; i < cAccesses; i++)
+            {
+                PTSTDEVIOPERFACCESS pAccess = &paAccesses[i];
+                uint64_t u64Value = pAccess->u64Value;
+                uint64_t tsAccess;
+                uint64_t cNs;
+
+                RTCritSectEnter(&pCritSect->s.CritSect);
+                tstDevCritSectEntered(hDut, pCritSect);
+                if (pAccess->fMmio)
+                {
+                    pMmio = apMmio[pAccess->iRegion];
+                    tsAccess = RTTimeNanoTS();
+                    if (pAccess->fRead)
+                        pMmio->pfnReadR3(hDut->pDevIns, pMmio->pvUserR3, pAccess->off, &u64Value, pAccess->cbValue);
+                    else
+                        pMmio->pfnWriteR3(hDut->pDevIns, pMmio->pvUserR3, pAccess->off, &u64Value, pAccess->cbValue);
+                    cNs = RTTimeNanoTS() - tsAccess;
+                    tstDevIoPerfStatsAdd(&aStatsMmio[pAccess->iRegion][pAccess->fRead ? 0 : 1], cNs);
+                }
+                else
+                {
+                    pIoPort = apIoPorts[pAccess->iRegion];
+                    uint32_t u32Value = (uint32_t)u64Value;
+                    tsAccess = RTTimeNanoTS();
+                    if (pAccess->fRead)
+                        pIoPort->pfnInR3(hDut->pDevIns, pIoPort->pvUserR3, (RTIOPORT)pAccess->off, &u32Value, pAccess->cbValue);
+                    else
+                        pIoPort->pfnOutR3(hDut->pDevIns, pIoPort->pvUserR3, (RTIOPORT)pAccess->off, u32Value, pAccess->cbValue);
+                    cNs = RTTimeNanoTS() - tsAccess;
+                    tstDevIoPerfStatsAdd(&aStatsIoPort[pAccess->iRegion][pAccess->fRead ? 0 : 1], cNs);
+                }
+                tstDevCritSectLeaving(hDut, pCritSect);
+                RTCritSectLeave(&pCritSect->s.CritSect);
+            }
+        }
+        uint64_t cNsElapsed = RTTimeNanoTS() - tsStart;
+        hDut->fStats = false;
+
+        RTPrintf("Replayed %u accesses %RU64 times in %RU64 ms\n", cAccesses, cIterations, cNsElapsed / RT_NS_1MS);
+        for (uint32_t i = 0; i < cMmioRegions; i++)
+        {
+            tstDevIoPerfStatsPrint("mmio", i, "read",  &aStatsMmio[i][0]);
+            tstDevIoPerfStatsPrint("mmio", i, "write", &aStatsMmio[i][1]);
+        }
+        for (uint32_t i = 0; i < cIoPortRegs; i++)
+        {
+            tstDevIoPerfStatsPrint("io", i, "in",  &aStatsIoPort[i][0]);
+            tstDevIoPerfStatsPrint("io", i, "out", &aStatsIoPort[i][1]);
+        }
+
+        PTSTDEVDUTSTATS pStats = &hDut->Stats;
+        RTPrintf("Critical sections: %RU64 enters, avg hold %RU64 ns, max hold %RU64 ns\n",
+                 pStats->cCritSectEnters, pStats->cCritSectEnters ? pStats->cNsCritSectHeld / pStats->cCritSectEnters : 0,
+                 pStats->cNsCritSectHeldMax);
+        RTPrintf("MM heap: %RU64 allocations, %RU64 bytes\n", pStats->cMmHeapAllocs, pStats->cbMmHeapAlloc);
+
+        /* Machine readable results, one metric per line. */
+        const char *pszOutput = tstDevIoPerfGetCfgString(paCfg, cCfgItems, "Output");
+        if (pszOutput)
+        {
+            PRTSTREAM pStrm = NULL;
+            rc = RTStrmOpen(pszOutput, "w", &pStrm);
+            if (RT_SUCCESS(rc))
+            {
+                RTStrmPrintf(pStrm, "metric,count,total,min,max\n");
+                RTStrmPrintf(pStrm, "replay.ns,%RU64,%RU64,,\n", cIterations * cAccesses, cNsElapsed);
+                for (uint32_t i = 0; i < cMmioRegions; i++)
+                {
+                    tstDevIoPerfStatsWrite(pStrm, "mmio", i, "read",  &aStatsMmio[i][0]);
+                    tstDevIoPerfStatsWrite(pStrm, "mmio", i, "write", &aStatsMmio[i][1]);
+                }
+                for (uint32_t i = 0; i < cIoPortRegs; i++)
+                {
+                    tstDevIoPerfStatsWrite(pStrm, "io", i, "in",  &aStatsIoPort[i][0]);
+                    tstDevIoPerfStatsWrite(pStrm, "io", i, "out", &aStatsIoPort[i][1]);
+                }
+                RTStrmPrintf(pStrm, "critsect.held.ns,%RU64,%RU64,,%RU64\n",
+                             pStats->cCritSectEnters, pStats->cNsCritSectHeld, pStats->cNsCritSectHeldMax);
+                RTStrmPrintf(pStrm, "mmheap.alloc.bytes,%RU64,%RU64,,\n", pStats->cMmHeapAllocs, pStats->cbMmHeapAlloc);
+                rc = RTStrmClose(pStrm);
+            }
+            if (RT_FAILURE(rc))
+                RTPrintf("Writing the results to %s failed with %Rrc\n", pszOutput, rc);
+        }
+    }
+
+    RTMemFree(paAccesses);
+    return rc;
+}
+
+
+const TSTDEVTESTCASEREG g_TestcaseIoPerf =
+{
+    /** szName */
+    "IoPerf",
+    /** pszDesc */
+    "Replays an MMIO/I/O port access trace and measures the time spent in the device handlers",
+    /** fFlags */
+    0,
+    /** pfnTestEntry */
+    tstDevIoPerfEntry
+};
+
@@ -37,6 +37,7 @@
 #include <iprt/assert.h>
 #include <iprt/mem.h>
 #include <iprt/rand.h>
+#include <iprt/time.h>
 
 #include "tstDeviceInternal.h"
 
@@ -3162,6 +3163,8 @@ static DECLCALLBACK(void *) pdmR3DevHlp_MMHeapAlloc(PPDMDEVINS pDevIns, size_t c
 #else
     void *pv = RTMemAlloc(cb);
 #endif
+    if (pv)
+        tstDevMmHeapAllocated(pDevIns->Internal.s.pDut, cb);
 
     LogFlow(("pdmR3DevHlp_MMHeapAlloc: caller='%s'/%d: returns %p\n", pDevIns->pReg->szName, pDevIns->iInstance, pv));
     return pv;
@@ -3180,6 +3183,8 @@ static DECLCALLBACK(void *) pdmR3DevHlp_MMHeapAllocZ(PPDMDEVINS pDevIns, size_t
 #else
     void *pv = RTMemAllocZ(cb);
 #endif
+    if (pv)
+        tstDevMmHeapAllocated(pDevIns->Internal.s.pDut, cb);
 
     LogFlow(("pdmR3DevHlp_MMHeapAllocZ: caller='%s'/%d: returns %p\n", pDevIns->pReg->szName, pDevIns->iInstance, pv));
     return pv;
@@ -4524,8 +4529,11 @@ static DECLCALLBACK(int)      pdmR3DevHlp_CritSectEnter(PPDMDEVINS pDevIns, PPDM
 {
     PDMDEV_ASSERT_DEVINS(pDevIns);
 
-    RT_NOREF(pDevIns, rcBusy);
-    return RTCritSectEnter(&pCritSect->s.CritSect);
+    RT_NOREF(rcBusy);
+    int rc = RTCritSectEnter(&pCritSect->s.CritSect);
+    if (RT_SUCCESS(rc))
+        tstDevCritSectEntered(pDevIns->Internal.s.pDut, pCritSect);
+    return rc;
 }
 
 
@@ -4534,8 +4542,11 @@ static DECLCALLBACK(int)      pdmR3DevHlp_CritSectEnterDebug(PPDMDEVINS pDevIns,
 {
     PDMDEV_ASSERT_DEVINS(pDevIns);
 
-    RT_NOREF(pDevIns, rcBusy, uId, RT_SRC_POS_ARGS);
-    return RTCritSectEnter(&pCritSect->s.CritSect);
+    RT_NOREF(rcBusy, uId, RT_SRC_POS_ARGS);
+    int rc = RTCritSectEnter(&pCritSect->s.CritSect);
+    if (RT_SUCCESS(rc))
+        tstDevCritSectEntered(pDevIns->Internal.s.pDut, pCritSect);
+    return rc;
 }
 
 
@@ -4568,6 +4579,7 @@ static DECLCALLBACK(int)      pdmR3DevHlp_CritSectLeave(PPDMDEVINS pDevIns, PPDM
 {
     PDMDEV_ASSERT_DEVINS(pDevIns);
 
+    tstDevCritSectLeaving(pDevIns->Internal.s.pDut, pCritSect);
     return RTCritSectLeave(&pCritSect->s.CritSect);
 }
 
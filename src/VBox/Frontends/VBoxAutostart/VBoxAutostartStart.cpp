@@ -58,19 +58,90 @@ typedef struct AUTOSTARTVM
     ULONG uStartupDelay;
 } AUTOSTARTVM;
 
+/**
+ * VM which is being launched.
+ */
+typedef struct AUTOSTARTPENDINGVM
+{
+    /** Session the VM is launched with. */
+    ComPtr<ISession>  session;
+    /** Progress object of the launch, can be NULL. */
+    ComPtr<IProgress> progress;
+    /** Name of the VM (for logging). */
+    Bstr              strName;
+} AUTOSTARTPENDINGVM;
+
 static DECLCALLBACK(bool) autostartVMCmp(const AUTOSTARTVM &vm1, const AUTOSTARTVM &vm2)
 {
     return vm1.uStartupDelay <= vm2.uStartupDelay;
 }
 
+/**
+ * Waits for the launch of the given VM to complete and releases its session.
+ *
+ * @param   PendingVM           The VM being launched.
+ */
+static void autostartStartWaitForVM(AUTOSTARTPENDINGVM &PendingVM)
+{
+    HRESULT hrc = S_OK;
+    ComPtr<IProgress> progress = PendingVM.progress;
+
+    if (!progress.isNull())
+    {
+        autostartSvcLogVerbose(1, "Waiting for machine '%ls' to power on ...\n", PendingVM.strName.raw());
+        CHECK_ERROR(progress, WaitForCompletion(-1));
+        if (SUCCEEDED(hrc))
+        {
+            BOOL completed = true;
+            CHECK_ERROR(progress, COMGETTER(Completed)(&completed));
+            if (SUCCEEDED(hrc))
+            {
+                ASSERT(completed);
+
+                LONG iRc;
+                CHECK_ERROR(progress, COMGETTER(ResultCode)(&iRc));
+                if (SUCCEEDED(hrc))
+                {
+                    if (FAILED(iRc))
+                    {
+                        ProgressErrorInfo info(progress);
+                        com::GluePrintErrorInfo(info);
+                    }
+                    else
+                        autostartSvcLogVerbose(1, "Machine '%ls' has been successfully started.\n", PendingVM.strName.raw());
+                }
+            }
+        }
+    }
+
+    SessionState_T enmSessionState;
+    CHECK_ERROR(PendingVM.session, COMGETTER(State)(&enmSessionState));
+    if (SUCCEEDED(hrc) && enmSessionState == SessionState_Locked)
+        PendingVM.session->UnlockMachine();
+}
+
 DECLHIDDEN(int) autostartStartMain(PCFGAST pCfgAst)
 {
     int vrc = VINF_SUCCESS;
     std::list<AUTOSTARTVM> listVM;
     uint32_t uStartupDelay = 0;
+    uint32_t cMaxParallel = 1;
 
     autostartSvcLogVerbose(1, "Starting machines ...\n");
 
+    /* The number of VMs to launch concurrently, by default one after the other. */
+    PCFGAST pCfgAstParallel = autostartConfigAstGetByName(pCfgAst, "startup_parallel");
+    if (pCfgAstParallel)
+    {
+        if (pCfgAstParallel->enmType == CFGASTNODETYPE_KEYVALUE)
+        {
+            vrc = RTStrToUInt32Full(pCfgAstParallel->u.KeyValue.aszValue, 10, &cMaxParallel);
+            if (RT_FAILURE(vrc) || !cMaxParallel)
+                return autostartSvcLogErrorRc(RT_FAILURE(vrc) ? vrc : VERR_INVALID_PARAMETER,
+                                              "'startup_parallel' must be a positive number");
+        }
+    }
+
     pCfgAst = autostartConfigAstGetByName(pCfgAst, "startup_delay");
     if (pCfgAst)
     {
@@ -163,6 +234,7 @@ DECLHIDDEN(int) autostartStartMain(PCFGAST pCfgAst)
             /* Sort by startup delay and apply base override. */
             listVM.sort(autostartVMCmp);
 
+            std::list<AUTOSTARTPENDINGVM> listPending;
             std::list<AUTOSTARTVM>::iterator it;
             for (it = listVM.begin(); it != listVM.end(); ++it)
             {
@@ -182,39 +254,34 @@ DECLHIDDEN(int) autostartStartMain(PCFGAST pCfgAst)
                     uDelayCur = (*it).uStartupDelay;
                 }
 
-                CHECK_ERROR_BREAK(machine, LaunchVMProcess(g_pSession, Bstr("headless").raw(),
-                                                           ComSafeArrayNullInParam(), progress.asOutParam()));
-                if (SUCCEEDED(hrc) && !progress.isNull())
+                /* Wait for the oldest launch to finish if too many are in flight already. */
+                while (listPending.size() >= cMaxParallel)
                 {
-                    autostartSvcLogVerbose(1, "Waiting for machine '%ls' to power on ...\n", strName.raw());
-                    CHECK_ERROR(progress, WaitForCompletion(-1));
-                    if (SUCCEEDED(hrc))
-                    {
-                        BOOL completed = true;
-                        CHECK_ERROR(progress, COMGETTER(Completed)(&completed));
-                        if (SUCCEEDED(hrc))
-                        {
-                            ASSERT(completed);
-
-                            LONG iRc;
-                            CHECK_ERROR(progress, COMGETTER(ResultCode)(&iRc));
-                            if (SUCCEEDED(hrc))
-                            {
-                                if (FAILED(iRc))
-                                {
-                                    ProgressErrorInfo info(progress);
-                                    com::GluePrintErrorInfo(info);
-                                }
-                                else
-                                    autostartSvcLogVerbose(1, "Machine '%ls' has been successfully started.\n", strName.raw());
-                            }
-                        }
-                    }
+                    autostartStartWaitForVM(listPending.front());
+                    listPending.pop_front();
+                }
+
+                /* Each VM gets its own session so that several can be launched at once. */
+                AUTOSTARTPENDINGVM PendingVM;
+                PendingVM.strName = strName;
+                hrc = PendingVM.session.createInprocObject(CLSID_Session);
+                if (FAILED(hrc))
+                {
+                    autostartSvcLogError("Creating a session for machine '%ls' failed with %Rhrc\n", strName.raw(), hrc);
+                    break;
                 }
-                SessionState_T enmSessionState;
-                CHECK_ERROR(g_pSession, COMGETTER(State)(&enmSessionState));
-                if (SUCCEEDED(hrc) && enmSessionState == SessionState_Locked)
-                    g_pSession->UnlockMachine();
+
+                CHECK_ERROR_BREAK(machine, LaunchVMProcess(PendingVM.session, Bstr("headless").raw(),
+                                                           ComSafeArrayNullInParam(), progress.asOutParam()));
+                PendingVM.progress = progress;
+                listPending.push_back(PendingVM);
+            }
+
+            /* Wait for the remaining launches. */
+            while (!listPending.empty())
+            {
+                autostartStartWaitForVM(listPending.front());
+                listPending.pop_front();
             }
         }
     }
@@ -26,9 +26,11 @@
  */
 
 #include <iprt/assert.h>
+#include <iprt/errcore.h>
 #include <iprt/log.h>
 #include <iprt/message.h>
 #include <iprt/stream.h>
+#include <iprt/string.h>
 #include <iprt/thread.h>
 #include <iprt/time.h>
 
@@ -56,11 +58,40 @@ typedef struct AUTOSTOPVM
     AutostopType_T enmAutostopType;
 } AUTOSTOPVM;
 
-static HRESULT autostartSaveVMState(ComPtr<IConsole> &console)
+/**
+ * VM which is being stopped.
+ */
+typedef struct AUTOSTOPPENDINGVM
+{
+    /** Session holding the shared lock of the VM. */
+    ComPtr<ISession>  session;
+    /** The VM. */
+    ComPtr<IMachine>  machine;
+    /** Progress object of the operation, NULL when waiting for an ACPI shutdown. */
+    ComPtr<IProgress> progress;
+    /** Name of the VM (for logging). */
+    Bstr              strName;
+    /** Whether to resume the VM if the operation fails. */
+    bool              fResumeOnFailure;
+    /** Timestamp (ms) when the power button was pressed. */
+    uint64_t          tsAcpiStartMs;
+} AUTOSTOPPENDINGVM;
+
+/**
+ * Pauses the VM and kicks off saving its state.
+ *
+ * @returns COM status code.
+ * @param   console             The console of the VM.
+ * @param   progress            Where to return the progress object of the save operation.
+ * @param   pfResume            Where to return whether the VM was paused by us
+ *                              and needs resuming if saving the state fails.
+ */
+static HRESULT autostartSaveVMStateBegin(ComPtr<IConsole> &console, ComPtr<IProgress> &progress, bool *pfResume)
 {
     HRESULT hrc = S_OK;
     ComPtr<IMachine> machine;
-    ComPtr<IProgress> progress;
+
+    *pfResume = false;
 
     do
     {
@@ -101,25 +132,79 @@ static HRESULT autostartSaveVMState(ComPtr<IConsole> &console)
             break;
         }
 
+        *pfResume = !fPaused;
+    } while (0);
+
+    return hrc;
+}
+
+/**
+ * Waits for the stop operation of the given VM to complete and releases its session.
+ *
+ * @param   PendingVM           The VM being stopped.
+ */
+static void autostartStopWaitForVM(AUTOSTOPPENDINGVM &PendingVM)
+{
+    HRESULT hrc = S_OK;
+    ComPtr<IProgress> progress = PendingVM.progress;
+
+    if (!progress.isNull())
+    {
         hrc = showProgress(progress);
-        CHECK_PROGRESS_ERROR(progress, ("Failed to save machine state"));
+        CHECK_PROGRESS_ERROR(progress, ("Failed to stop machine '%ls'", PendingVM.strName.raw()));
         if (FAILED(hrc))
         {
-            if (!fPaused)
-                console->Resume();
+            autostartSvcLogError("Stopping machine '%ls' failed with %Rhrc\n", PendingVM.strName.raw(), hrc);
+            if (PendingVM.fResumeOnFailure)
+            {
+                ComPtr<IConsole> console;
+                if (SUCCEEDED(PendingVM.session->COMGETTER(Console)(console.asOutParam())))
+                    console->Resume();
+            }
         }
-    } while (0);
+    }
+    else
+    {
+        autostartSvcLogVerbose(1, "Waiting for machine '%ls' to power off...\n", PendingVM.strName.raw());
 
-    return hrc;
+        RTMSINTERVAL const msTimeout = RT_MS_5MIN; /* Should be enough time, shouldn't it? */
+        MachineState_T enmMachineState = MachineState_Running;
+
+        while (RTTimeMilliTS() - PendingVM.tsAcpiStartMs <= msTimeout)
+        {
+            CHECK_ERROR_BREAK(PendingVM.machine, COMGETTER(State)(&enmMachineState));
+            if (enmMachineState != MachineState_Running)
+                break;
+            RTThreadSleep(RT_MS_1SEC);
+        }
+
+        if (RTTimeMilliTS() - PendingVM.tsAcpiStartMs > msTimeout)
+            autostartSvcLogWarning("Machine '%ls' did not power off via ACPI within time\n", PendingVM.strName.raw());
+    }
+
+    PendingVM.session->UnlockMachine();
 }
 
 DECLHIDDEN(int) autostartStopMain(PCFGAST pCfgAst)
 {
-    RT_NOREF(pCfgAst);
     std::list<AUTOSTOPVM> listVM;
+    uint32_t cMaxParallel = 1;
 
     autostartSvcLogVerbose(1, "Stopping machines ...\n");
 
+    /* The number of VMs to stop concurrently, by default one after the other. */
+    pCfgAst = autostartConfigAstGetByName(pCfgAst, "shutdown_parallel");
+    if (pCfgAst)
+    {
+        if (pCfgAst->enmType == CFGASTNODETYPE_KEYVALUE)
+        {
+            int vrc = RTStrToUInt32Full(pCfgAst->u.KeyValue.aszValue, 10, &cMaxParallel);
+            if (RT_FAILURE(vrc) || !cMaxParallel)
+                return autostartSvcLogErrorRc(RT_FAILURE(vrc) ? vrc : VERR_INVALID_PARAMETER,
+                                              "'shutdown_parallel' must be a positive number");
+        }
+    }
+
     /*
      * Build a list of all VMs we need to autostop first, apply the overrides
      * from the configuration and start the VMs afterwards.
@@ -169,6 +254,7 @@ DECLHIDDEN(int) autostartStopMain(PCFGAST pCfgAst)
         if (   SUCCEEDED(hrc)
             && !listVM.empty())
         {
+            std::list<AUTOSTOPPENDINGVM> listPending;
             std::list<AUTOSTOPVM>::iterator it;
             for (it = listVM.begin(); it != listVM.end(); ++it)
             {
@@ -195,28 +281,47 @@ DECLHIDDEN(int) autostartStopMain(PCFGAST pCfgAst)
                 if (   enmMachineState == MachineState_Running
                     || enmMachineState == MachineState_Paused)
                 {
-                    ComPtr<IConsole> console;
-                    ComPtr<IProgress> progress;
+                    /* Wait for the oldest operation to finish if too many are in flight already. */
+                    while (listPending.size() >= cMaxParallel)
+                    {
+                        autostartStopWaitForVM(listPending.front());
+                        listPending.pop_front();
+                    }
 
-                    /* open a session for the VM */
-                    CHECK_ERROR_BREAK(machine, LockMachine(g_pSession, LockType_Shared));
+                    ComPtr<IConsole> console;
+                    AUTOSTOPPENDINGVM PendingVM;
+                    PendingVM.machine          = machine;
+                    PendingVM.strName          = strName;
+                    PendingVM.fResumeOnFailure = false;
+                    PendingVM.tsAcpiStartMs    = 0;
+
+                    /* open a session for the VM, each VM gets its own so several can be stopped at once */
+                    hrc = PendingVM.session.createInprocObject(CLSID_Session);
+                    if (FAILED(hrc))
+                    {
+                        autostartSvcLogError("Creating a session for machine '%ls' failed with %Rhrc\n", strName.raw(), hrc);
+                        break;
+                    }
+                    CHECK_ERROR_BREAK(machine, LockMachine(PendingVM.session, LockType_Shared));
 
                     /* get the associated console */
-                    CHECK_ERROR_BREAK(g_pSession, COMGETTER(Console)(console.asOutParam()));
+                    CHECK_ERROR(PendingVM.session, COMGETTER(Console)(console.asOutParam()));
+                    if (FAILED(hrc))
+                    {
+                        PendingVM.session->UnlockMachine();
+                        break;
+                    }
 
                     switch ((*it).enmAutostopType)
                     {
                         case AutostopType_SaveState:
                         {
-                            hrc = autostartSaveVMState(console);
+                            hrc = autostartSaveVMStateBegin(console, PendingVM.progress, &PendingVM.fResumeOnFailure);
                             break;
                         }
                         case AutostopType_PowerOff:
                         {
-                            CHECK_ERROR_BREAK(console, PowerDown(progress.asOutParam()));
-
-                            hrc = showProgress(progress);
-                            CHECK_PROGRESS_ERROR(progress, ("Failed to powering off machine '%ls'", strName.raw()));
+                            CHECK_ERROR(console, PowerDown(PendingVM.progress.asOutParam()));
                             if (FAILED(hrc))
                                 autostartSvcLogError("Powering off machine '%ls' failed with %Rhrc\n", strName.raw(), hrc);
                             break;
@@ -229,38 +334,35 @@ DECLHIDDEN(int) autostartStopMain(PCFGAST pCfgAst)
                                 && enmMachineState == MachineState_Running)
                             {
                                 CHECK_ERROR_BREAK(console, PowerButton());
-
-                                autostartSvcLogVerbose(1, "Waiting for machine '%ls' to power off...\n", strName.raw());
-
-                                uint64_t     const tsStartMs = RTTimeMilliTS();
-                                RTMSINTERVAL const msTimeout = RT_MS_5MIN; /* Should be enough time, shouldn't it? */
-
-                                while (RTTimeMilliTS() - tsStartMs <= msTimeout)
-                                {
-                                    CHECK_ERROR_BREAK(machine, COMGETTER(State)(&enmMachineState));
-                                    if (enmMachineState != MachineState_Running)
-                                        break;
-                                    RTThreadSleep(RT_MS_1SEC);
-                                }
-
-                                if (RTTimeMilliTS() - tsStartMs > msTimeout)
-                                    autostartSvcLogWarning("Machine '%ls' did not power off via ACPI within time\n", strName.raw());
+                                PendingVM.tsAcpiStartMs = RTTimeMilliTS();
                             }
                             else
                             {
                                 /* Use save state instead and log this to the console. */
                                 autostartSvcLogWarning("The guest of machine '%ls' does not support ACPI shutdown or is currently paused, saving state...\n",
                                                        strName.raw());
-                                hrc = autostartSaveVMState(console);
+                                hrc = autostartSaveVMStateBegin(console, PendingVM.progress, &PendingVM.fResumeOnFailure);
                             }
                             break;
                         }
                         default:
                             autostartSvcLogWarning("Unknown autostop type for machine '%ls', skipping\n", strName.raw());
+                            hrc = E_FAIL;
                     }
-                    g_pSession->UnlockMachine();
+
+                    if (SUCCEEDED(hrc))
+                        listPending.push_back(PendingVM);
+                    else
+                        PendingVM.session->UnlockMachine();
                 }
             }
+
+            /* Wait for the remaining operations. */
+            while (!listPending.empty())
+            {
+                autostartStopWaitForVM(listPending.front());
+                listPending.pop_front();
+            }
         }
     }
 
@@ -35,6 +35,10 @@
 
 #include "VBoxWatchdogInternal.h"
 #include <iprt/system.h>
+#ifdef RT_OS_LINUX
+# include <iprt/stream.h>
+# include <iprt/string.h>
+#endif
 
 using namespace com;
 
@@ -55,6 +59,7 @@ enum GETOPTDEF_BALLOONCTRL
     GETOPTDEF_BALLOONCTRL_BALLOONLOWERLIMIT,
     GETOPTDEF_BALLOONCTRL_BALLOONMAX,
     GETOPTDEF_BALLOONCTRL_BALLOONSAFETY,
+    GETOPTDEF_BALLOONCTRL_PRESSURELIMIT,
     GETOPTDEF_BALLOONCTRL_TIMEOUTMS,
     GETOPTDEF_BALLOONCTRL_GROUPS
 };
@@ -69,6 +74,7 @@ static const RTGETOPTDEF g_aBalloonOpts[] = {
     { "--balloon-interval",       GETOPTDEF_BALLOONCTRL_TIMEOUTMS,         RTGETOPT_REQ_UINT32 },
     { "--balloon-lower-limit",    GETOPTDEF_BALLOONCTRL_BALLOONLOWERLIMIT, RTGETOPT_REQ_UINT32 },
     { "--balloon-max",            GETOPTDEF_BALLOONCTRL_BALLOONMAX,        RTGETOPT_REQ_UINT32 },
+    { "--balloon-pressure-limit", GETOPTDEF_BALLOONCTRL_PRESSURELIMIT,     RTGETOPT_REQ_UINT32 },
     { "--balloon-safety-margin",  GETOPTDEF_BALLOONCTRL_BALLOONSAFETY,     RTGETOPT_REQ_UINT32 }
 };
 
@@ -94,6 +100,12 @@ static uint32_t g_cMbMemoryBalloonDecrement  = 128;
 static uint32_t g_cMbMemoryBalloonMax        = 0;
 static uint32_t g_cMbMemoryBalloonLowerLimit = 128;
 static uint32_t g_cbMemoryBalloonSafety     = 1024;
+/** Command line: Host memory pressure (percent of time stalled, 10s average) at
+ *  and above which the host is considered to be under pressure. Default is 0,
+ *  which means pressure is not monitored. See balloonQueryHostPressure(). */
+static uint32_t g_uMemoryBalloonPressureLimit = 0;
+/** Set while the host is considered to be under memory pressure. */
+static bool     g_fMemoryBalloonHostPressure  = false;
 
 
 /*********************************************************************************************************************************
@@ -101,6 +113,52 @@ static uint32_t g_cbMemoryBalloonSafety     = 1024;
 *********************************************************************************************************************************/
 static int balloonSetSize(PVBOXWATCHDOG_MACHINE pMachine, uint32_t cMbBalloonCur);
 
+/**
+ * Queries the current host memory pressure.
+ *
+ * On Linux this is the "some" 10 second average of the pressure stall
+ * information (PSI) in /proc/pressure/memory, i.e. the share of time at least
+ * one task was stalled waiting for memory.
+ *
+ * @returns VBox status code. VERR_NOT_SUPPORTED if not available on this host.
+ * @param   puPct               Where to return the pressure in percent (0-100).
+ */
+static int balloonQueryHostPressure(uint32_t *puPct)
+{
+    *puPct = 0;
+#ifdef RT_OS_LINUX
+    PRTSTREAM pStrm;
+    int vrc = RTStrmOpen("/proc/pressure/memory", "r", &pStrm);
+    if (RT_FAILURE(vrc))
+        return VERR_NOT_SUPPORTED;
+
+    vrc = VERR_PARSE_ERROR;
+    char szLine[256];
+    while (RT_SUCCESS(RTStrmGetLine(pStrm, szLine, sizeof(szLine))))
+    {
+        if (!RTStrStartsWith(szLine, "some "))
+            continue;
+        const char *pszAvg = RTStrStr(szLine, "avg10=");
+        if (pszAvg)
+        {
+            uint32_t uPct = 0;
+            int vrc2 = RTStrToUInt32Ex(pszAvg + sizeof("avg10=") - 1, NULL, 10, &uPct);
+            if (RT_SUCCESS(vrc2)) /* Ignores the fraction (VWRN_TRAILING_CHARS). */
+            {
+                *puPct = RT_MIN(uPct, 100);
+                vrc = VINF_SUCCESS;
+            }
+        }
+        break;
+    }
+
+    RTStrmClose(pStrm);
+    return vrc;
+#else
+    return VERR_NOT_SUPPORTED;
+#endif
+}
+
 /**
  * Retrieves the current delta value
  *
@@ -153,6 +211,13 @@ static int32_t balloonGetDelta(PVBOXWATCHDOG_MACHINE pMachine, uint32_t cMbGuest
     }
     else if (cMbBalloonNew < cMbBalloonOld) /* Deflate. */
     {
+        /* Don't hand memory back to a guest which isn't short on it while
+         * the host itself is under memory pressure. */
+        if (g_fMemoryBalloonHostPressure)
+        {
+            serviceLogVerbose(("[%ls] Host under memory pressure, not deflating\n", pMachine->strName.raw()));
+            return 0;
+        }
         cMbBalloonDelta = RT_MIN(g_cMbMemoryBalloonDecrement, cMbBalloonOld - cMbBalloonNew) * -1;
     }
 
@@ -607,6 +672,10 @@ static DECLCALLBACK(int) VBoxModBallooningOption(int argc, char *argv[], int *pi
                 g_cbMemoryBalloonSafety = ValueUnion.u32;
                 break;
 
+            case GETOPTDEF_BALLOONCTRL_PRESSURELIMIT:
+                g_uMemoryBalloonPressureLimit = RT_MIN(ValueUnion.u32, 100);
+                break;
+
             /** @todo This option is a common module option! Put
              *        this into a utility function! */
             case GETOPTDEF_BALLOONCTRL_TIMEOUTMS:
@@ -651,6 +720,21 @@ static DECLCALLBACK(int) VBoxModBallooningInit(void)
                        "VBoxInternal2/Watchdog/BalloonCtrl/BalloonLowerLimitMB", NULL /* Per-machine */,
                        &g_cMbMemoryBalloonLowerLimit, 128);
 
+    if (!g_uMemoryBalloonPressureLimit)
+        cfgGetValueU32(g_pVirtualBox, NULL /* Machine */,
+                       "VBoxInternal2/Watchdog/BalloonCtrl/PressureLimit", NULL /* Per-machine */,
+                       &g_uMemoryBalloonPressureLimit, 0 /* Disabled by default. */);
+    if (g_uMemoryBalloonPressureLimit)
+    {
+        uint32_t uPct;
+        int vrc = balloonQueryHostPressure(&uPct);
+        if (RT_FAILURE(vrc))
+        {
+            serviceLog("Warning: Host memory pressure not available (%Rrc), ignoring pressure limit\n", vrc);
+            g_uMemoryBalloonPressureLimit = 0;
+        }
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -661,11 +745,29 @@ static DECLCALLBACK(int) VBoxModBallooningMain(void)
         s_msLast = RTTimeMilliTS();
     else
     {
+        /* While the host is under memory pressure check four times as often
+         * so that we react to a spike before the regular interval expires. */
+        uint32_t cMsTimeout = g_cMsMemoryBalloonTimeout;
+        if (g_fMemoryBalloonHostPressure)
+            cMsTimeout = RT_MIN(cMsTimeout, RT_MAX(cMsTimeout / 4, 500));
         uint64_t msDelta = RTTimeMilliTS() - s_msLast;
-        if (msDelta <= g_cMsMemoryBalloonTimeout)
+        if (msDelta <= cMsTimeout)
             return VINF_SUCCESS;
     }
 
+    if (g_uMemoryBalloonPressureLimit)
+    {
+        uint32_t uPct = 0;
+        int vrc = balloonQueryHostPressure(&uPct);
+        bool const fPressure = RT_SUCCESS(vrc) && uPct >= g_uMemoryBalloonPressureLimit;
+        if (fPressure != g_fMemoryBalloonHostPressure)
+        {
+            serviceLogVerbose(("Host memory pressure %s (%RU32%%, limit %RU32%%)\n",
+                               fPressure ? "detected" : "relieved", uPct, g_uMemoryBalloonPressureLimit));
+            g_fMemoryBalloonHostPressure = fPressure;
+        }
+    }
+
     int rc = VINF_SUCCESS;
 
     /** @todo Provide API for enumerating/working w/ machines inside a module! */
@@ -760,6 +862,7 @@ VBOXMODULE g_ModBallooning =
     "           [--balloon-dec=<MB>] [--balloon-groups=<string>]\n"
     "           [--balloon-inc=<MB>] [--balloon-interval=<ms>]\n"
     "           [--balloon-lower-limit=<MB>] [--balloon-max=<MB>]\n"
+    "           [--balloon-pressure-limit=<%>]\n"
     "           [--balloon-safety-margin=<MB]\n",
     /* pszOptions. */
     "  --balloon-dec=<MB>\n"
@@ -780,6 +883,9 @@ VBOXMODULE g_ModBallooning =
     "      Set \"VBoxInternal/Guest/BalloonSizeMax\" for a per-VM\n"
     "      maximum ballooning size.\n"
 #endif
+    "  --balloon-pressure-limit=<%>\n"
+    "      Sets the host memory pressure in percent at which balloons\n"
+    "      are no longer deflated and checked more often (0, disabled).\n"
     "  --balloon-safety-margin=<MB>\n"
     "     Free memory when deflating a balloon in MB (1024 MB).\n"
     ,
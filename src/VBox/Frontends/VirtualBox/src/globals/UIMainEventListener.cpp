@@ -184,8 +184,10 @@ void UIMainEventListeningThread::run()
                 LogRel2(("GUI: UIMainEventListener/ThreadRun: EventProcessed set for waitable event\n"));
             }
 
-            /* Check whether we should finish our job on this event: */
-            if (m_escapeEventTypes.contains(comEvent.GetType()))
+            /* Check whether we should finish our job on this event
+             * (don't bother querying the type when there's nothing to check against): */
+            if (   !m_escapeEventTypes.isEmpty()
+                && m_escapeEventTypes.contains(comEvent.GetType()))
                 setShutdown(true);
         }
     }
@@ -630,6 +630,25 @@ int ShClConvUtf16CRLFToUtf8LF(PCRTUTF16 pcwszSrc, size_t cwcSrc,
 
     size_t   cbLen = 0;
 
+    AssertMsgReturn(pcwszSrc[0] != VBOX_SHCL_UTF16BEMARKER,
+                    ("Big endian UTF-16 not supported yet\n"), VERR_NOT_SUPPORTED);
+
+    /* Without any carriage returns there is nothing to normalize, so skip the
+       intermediate UTF-16 copy and convert the source (minus the marker) directly. */
+    size_t const offSrc = pcwszSrc[0] == VBOX_SHCL_UTF16LEMARKER ? 1 : 0;
+    size_t       i      = offSrc;
+    while (   i < cwcSrc
+           && pcwszSrc[i] != 0
+           && pcwszSrc[i] != VBOX_SHCL_CARRIAGERETURN)
+        i++;
+    if (i >= cwcSrc || pcwszSrc[i] == 0)
+    {
+        rc = RTUtf16ToUtf8Ex(pcwszSrc + offSrc, cwcSrc - offSrc, &pszBuf, cbBuf, &cbLen);
+        if (RT_SUCCESS(rc))
+            *pcbLen = cbLen;
+        return rc;
+    }
+
     /* How long will the converted text be? */
     rc = ShClUtf16CRLFLenUtf8(pcwszSrc, cwcSrc, &cchTmp);
     if (RT_SUCCESS(rc))
@@ -705,6 +724,21 @@ int ShClConvUtf8LFToUtf16CRLF(const char *pcszSrc, size_t cbSrc,
     int rc = RTStrToUtf16Ex(pcszSrc, cbSrc, &pwcTmp, 0, &cwcTmp);
     if (RT_SUCCESS(rc))
     {
+        /* If there are no line endings to normalize (which for UTF-8 can be
+           checked bytewise) and no byte order marker to strip, the intermediate
+           string already is the result and we can skip another pass and copy. */
+        if (   !memchr(pcszSrc, VBOX_SHCL_LINEFEED, cbSrc)
+#ifdef RT_OS_DARWIN
+            && !memchr(pcszSrc, VBOX_SHCL_CARRIAGERETURN, cbSrc)
+#endif
+            && pwcTmp[0] != VBOX_SHCL_UTF16LEMARKER
+            && pwcTmp[0] != VBOX_SHCL_UTF16BEMARKER)
+        {
+            *ppwszDst = pwcTmp;
+            *pcwDst   = cwcTmp;
+            return VINF_SUCCESS;
+        }
+
         rc = ShClConvUtf16LFToCRLFA(pwcTmp, cwcTmp, ppwszDst, pcwDst);
         RTUtf16Free(pwcTmp);
     }
@@ -260,17 +260,45 @@ DECLHIDDEN(int) suplibOsPageAlloc(PSUPLIBDATA pThis, size_t cPages, uint32_t fFl
         && (fFlags & (SUP_PAGE_ALLOC_F_FOR_LOCKING | SUP_PAGE_ALLOC_F_LARGE_PAGES)) == SUP_PAGE_ALLOC_F_FOR_LOCKING)
         cbMmap += PAGE_SIZE * 2;
 
-    uint8_t *pbPages = (uint8_t *)mmap(NULL, cbMmap, PROT_READ | PROT_WRITE, fMmap, -1, 0);
+    uint8_t *pbPages = (uint8_t *)MAP_FAILED;
 #ifdef MAP_HUGETLB
-    if (pbPages == MAP_FAILED && (fMmap & MAP_HUGETLB))
+    if (fMmap & MAP_HUGETLB)
     {
-        /* Try again without MAP_HUGETLB if mmap fails: */
-        fMmap &= ~MAP_HUGETLB;
-        if (!pThis->fSysMadviseWorks && (fFlags & SUP_PAGE_ALLOC_F_FOR_LOCKING))
-            cbMmap = (cPages + 2) << PAGE_SHIFT;
         pbPages = (uint8_t *)mmap(NULL, cbMmap, PROT_READ | PROT_WRITE, fMmap, -1, 0);
+        if (pbPages == MAP_FAILED)
+        {
+            /* Try again without MAP_HUGETLB if mmap fails: */
+            fMmap &= ~MAP_HUGETLB;
+            if (!pThis->fSysMadviseWorks && (fFlags & SUP_PAGE_ALLOC_F_FOR_LOCKING))
+                cbMmap = (cPages + 2) << PAGE_SHIFT;
+        }
     }
 #endif
+#ifdef MADV_HUGEPAGE
+    /*
+     * Transparent huge pages can only back the 2MB aligned parts of a mapping,
+     * so over-allocate and trim it to a 2MB aligned start.  The free function
+     * only needs cPages and the address, so this is transparent to the caller.
+     */
+    if (   pbPages == MAP_FAILED
+        && (fFlags & SUP_PAGE_ALLOC_F_LARGE_PAGES)
+        && cbMmap == (cPages << PAGE_SHIFT)
+        && cbMmap >= _2M)
+    {
+        uint8_t *pbRaw = (uint8_t *)mmap(NULL, cbMmap + _2M, PROT_READ | PROT_WRITE, fMmap, -1, 0);
+        if (pbRaw != MAP_FAILED)
+        {
+            pbPages = (uint8_t *)RT_ALIGN_PT(pbRaw, _2M, uint8_t *);
+            if (pbPages != pbRaw)
+                munmap(pbRaw, (size_t)(pbPages - pbRaw));
+            size_t const cbTail = (size_t)(pbRaw + cbMmap + _2M - (pbPages + cbMmap));
+            if (cbTail)
+                munmap(pbPages + cbMmap, cbTail);
+        }
+    }
+#endif
+    if (pbPages == MAP_FAILED)
+        pbPages = (uint8_t *)mmap(NULL, cbMmap, PROT_READ | PROT_WRITE, fMmap, -1, 0);
     if (pbPages != MAP_FAILED)
     {
         if (   !(fFlags & SUP_PAGE_ALLOC_F_FOR_LOCKING)
@@ -301,7 +329,7 @@ DECLHIDDEN(int) suplibOsPageAlloc(PSUPLIBDATA pThis, size_t cPages, uint32_t fFl
              */
             if (   !(fMmap & MAP_HUGETLB)
                 && (fFlags & SUP_PAGE_ALLOC_F_LARGE_PAGES)
-                && !(cPages & 511)) /** @todo PORTME: x86 assumption */
+                && cbMmap >= _2M) /** @todo PORTME: x86 assumption */
                 madvise(pbPages, cbMmap, MADV_HUGEPAGE);
 #endif
         }
@@ -489,6 +489,8 @@ static int vboximgOp_read(const char *pszPath, char *pbBuf, size_t cbBuf,
                 rc = cbRead;
             else if (vrc == VINF_EOF)
                 rc = -RTErrConvertToErrno(VERR_EOF);
+            else if (RT_FAILURE(vrc))
+                rc = -RTErrConvertToErrno(vrc);
             RTVfsFileRelease(hVfsFile);
             break;
         }
@@ -1366,6 +1368,22 @@ int main(int argc, char **argv)
     if (g_vboximgOpts.fAllowRoot)
         fuse_opt_add_arg(&args, "-oallow_root");
 
+#ifdef RT_OS_LINUX
+    /*
+     * A read-only mount never changes, so let the kernel keep its page cache across opens.
+     * Writable mounts only keep the cache while the file modification time and size stay
+     * the same, and ask for large write requests, FUSE 2.x splits writes into 4KB chunks
+     * otherwise.
+     */
+    if (g_vboximgOpts.fRW)
+    {
+        fuse_opt_add_arg(&args, "-oauto_cache");
+        fuse_opt_add_arg(&args, "-obig_writes");
+    }
+    else
+        fuse_opt_add_arg(&args, "-okernel_cache");
+#endif
+
     if (   !g_vboximgOpts.pszImageUuidOrPath
         || !RTVfsChainIsSpec(g_vboximgOpts.pszImageUuidOrPath))
         return vboxImgMntImageSetup(&args);
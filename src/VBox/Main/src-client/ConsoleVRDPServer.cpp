@@ -3754,6 +3754,10 @@ void ConsoleVRDPServer::SendResize(void)
 
 void ConsoleVRDPServer::SendUpdateBitmap(unsigned uScreenId, uint32_t x, uint32_t y, uint32_t w, uint32_t h) const
 {
+    /* Updates clipped away by the caller carry nothing the server could send. */
+    if (w == 0 || h == 0)
+        return;
+
     VRDEORDERHDR update;
     update.x = (uint16_t)x;
     update.y = (uint16_t)y;
@@ -975,18 +975,23 @@ void Display::i_handleDisplayUpdate(unsigned uScreenId, int x, int y, int w, int
                         uint8_t *pu8Dst = image.raw();
                         const uint8_t *pu8Src = pbAddress + ulBytesPerLine * y + x * uBytesPerPixel;
 
-                        for (int i = 0; i < h; ++i)
-                        {
-                            memcpy(pu8Dst, pu8Src, w * uBytesPerPixel);
-                            pu8Dst += w * uBytesPerPixel;
-                            pu8Src += ulBytesPerLine;
-                        }
+                        if (w * uBytesPerPixel == ulBytesPerLine) /* Full scanlines are contiguous. */
+                            memcpy(pu8Dst, pu8Src, cbData);
+                        else
+                            for (int i = 0; i < h; ++i)
+                            {
+                                memcpy(pu8Dst, pu8Src, w * uBytesPerPixel);
+                                pu8Dst += w * uBytesPerPixel;
+                                pu8Src += ulBytesPerLine;
+                            }
 
                         pFramebuffer->NotifyUpdateImage(x, y, w, h, ComSafeArrayAsInParam(image));
 
 #ifdef VBOX_WITH_RECORDING
+                        /* Recording takes the update straight from the source bitmap: the image copy
+                         * above is packed and does not have the bitmap's stride. */
                         i_recordingScreenUpdate(uScreenId,
-                                                image.raw(), ulBytesPerLine * h,
+                                                pbAddress, ulBytesPerLine * ulHeight,
                                                 x, y, w, h, ulBytesPerLine);
 #endif
                     }
@@ -64,6 +64,68 @@
 /** The file handle was inherited. */
 #define VBOX_EBMLWRITER_FLAG_HANDLE_INHERITED   RT_BIT(0)
 
+/** Maximum size of an encoded EBML element header (class ID + data size). */
+#define VBOX_EBMLWRITER_MAX_HDR_SIZE            (8 + 8)
+
+
+/**
+ * Size calculation for variable size UNSIGNED integer, see EBMLWriter::getSizeOfUInt.
+ */
+DECLINLINE(size_t) ebmlGetSizeOfUInt(uint64_t arg)
+{
+    return 8 - ! (arg & (UINT64_MAX << 56)) - ! (arg & (UINT64_MAX << 48)) -
+               ! (arg & (UINT64_MAX << 40)) - ! (arg & (UINT64_MAX << 32)) -
+               ! (arg & (UINT64_MAX << 24)) - ! (arg & (UINT64_MAX << 16)) -
+               ! (arg & (UINT64_MAX << 8));
+}
+
+/**
+ * Encodes the lower @a cb bytes of @a uValue as big-endian into @a pbDst.
+ *
+ * @returns Number of bytes written to @a pbDst (that is, @a cb).
+ */
+DECLINLINE(size_t) ebmlEncodeUInt(uint8_t *pbDst, uint64_t uValue, size_t cb)
+{
+    Assert(cb >= 1 && cb <= sizeof(uint64_t));
+    for (size_t i = cb; i-- > 0; uValue >>= 8)
+        pbDst[i] = (uint8_t)uValue;
+    return cb;
+}
+
+/**
+ * Encodes an EBML data size value into @a pbDst, see EBMLWriter::writeSize.
+ *
+ * @returns Number of bytes written to @a pbDst.
+ */
+static size_t ebmlEncodeSize(uint8_t *pbDst, uint64_t parm)
+{
+    size_t size = 8 - ! (parm & (UINT64_MAX << 49)) - ! (parm & (UINT64_MAX << 42)) -
+                      ! (parm & (UINT64_MAX << 35)) - ! (parm & (UINT64_MAX << 28)) -
+                      ! (parm & (UINT64_MAX << 21)) - ! (parm & (UINT64_MAX << 14)) -
+                      ! (parm & (UINT64_MAX << 7));
+    /* One is subtracted in order to avoid loosing significant bit when size = 8. */
+    uint64_t mask = RT_BIT_64(size * 8 - 1);
+    return ebmlEncodeUInt(pbDst, (parm & (((mask << 1) - 1) >> size)) | (mask >> (size - 1)), size);
+}
+
+/**
+ * Encodes an EBML element header (class ID + data size) into @a pbDst.
+ *
+ * This lets the serializers emit the header with a single write instead of
+ * one write per header field.
+ *
+ * @returns Number of bytes written to @a pbDst.
+ * @param   pbDst       Where to encode the header.  Must be at least
+ *                      VBOX_EBMLWRITER_MAX_HDR_SIZE bytes big.
+ * @param   classId     The element's class ID.
+ * @param   cbData      The element's data size.
+ */
+static size_t ebmlEncodeHdr(uint8_t *pbDst, uint64_t classId, uint64_t cbData)
+{
+    size_t off = ebmlEncodeUInt(pbDst, classId, ebmlGetSizeOfUInt(classId));
+    return off + ebmlEncodeSize(&pbDst[off], cbData);
+}
+
 /** Creates an EBML output file using an existing, open file handle. */
 int EBMLWriter::createEx(const char *a_pszFile, PRTFILE phFile)
 {
@@ -117,13 +179,15 @@ void EBMLWriter::close(void)
 /** Starts an EBML sub-element. */
 EBMLWriter& EBMLWriter::subStart(EbmlClassId classId)
 {
-    writeClassId(classId);
-    /* store the current file offset. */
-    m_Elements.push(EbmlSubElement(RTFileTell(m_hFile), classId));
+    uint8_t abHdr[VBOX_EBMLWRITER_MAX_HDR_SIZE];
+    size_t const cbClassId = ebmlEncodeUInt(abHdr, classId, ebmlGetSizeOfUInt(classId));
+    /* store the (upcoming) file offset of the size field. */
+    m_Elements.push(EbmlSubElement(RTFileTell(m_hFile) + cbClassId, classId));
     /* Indicates that size of the element
      * is unkown (as according to EBML specs).
      */
-    writeUnsignedInteger(UINT64_C(0x01FFFFFFFFFFFFFF));
+    size_t const cbHdr = cbClassId + ebmlEncodeUInt(&abHdr[cbClassId], UINT64_C(0x01FFFFFFFFFFFFFF), sizeof(uint64_t));
+    write(abHdr, cbHdr);
     return *this;
 }
 
@@ -155,9 +219,9 @@ EBMLWriter& EBMLWriter::subEnd(EbmlClassId classId)
 /** Serializes a null-terminated string. */
 EBMLWriter& EBMLWriter::serializeString(EbmlClassId classId, const char *str)
 {
-    writeClassId(classId);
     uint64_t size = strlen(str);
-    writeSize(size);
+    uint8_t  abHdr[VBOX_EBMLWRITER_MAX_HDR_SIZE];
+    write(abHdr, ebmlEncodeHdr(abHdr, classId, size));
     write(str, size);
     return *this;
 }
@@ -166,10 +230,12 @@ EBMLWriter& EBMLWriter::serializeString(EbmlClassId classId, const char *str)
  *  If size is zero then it will be detected automatically. */
 EBMLWriter& EBMLWriter::serializeUnsignedInteger(EbmlClassId classId, uint64_t parm, size_t size /* = 0 */)
 {
-    writeClassId(classId);
     if (!size) size = getSizeOfUInt(parm);
-    writeSize(size);
-    writeUnsignedInteger(parm, size);
+    Assert(size <= sizeof(uint64_t));
+    uint8_t abElement[VBOX_EBMLWRITER_MAX_HDR_SIZE + sizeof(uint64_t)];
+    size_t  off = ebmlEncodeHdr(abElement, classId, size);
+    off += ebmlEncodeUInt(&abElement[off], parm, size);
+    write(abElement, off);
     return *this;
 }
 
@@ -180,20 +246,20 @@ EBMLWriter& EBMLWriter::serializeUnsignedInteger(EbmlClassId classId, uint64_t p
  */
 EBMLWriter& EBMLWriter::serializeFloat(EbmlClassId classId, float value)
 {
-    writeClassId(classId);
     Assert(sizeof(uint32_t) == sizeof(float));
-    writeSize(sizeof(float));
+    uint8_t abElement[VBOX_EBMLWRITER_MAX_HDR_SIZE + sizeof(float)];
+    size_t  off = ebmlEncodeHdr(abElement, classId, sizeof(float));
 
     union
     {
-        float   f;
-        uint8_t u8[4];
+        float    f;
+        uint32_t u32;
     } u;
 
     u.f = value;
 
-    for (int i = 3; i >= 0; i--) /* Converts values to big endian. */
-        write(&u.u8[i], 1);
+    off += ebmlEncodeUInt(&abElement[off], u.u32, sizeof(uint32_t)); /* Converts values to big endian. */
+    write(abElement, off);
 
     return *this;
 }
@@ -201,8 +267,8 @@ EBMLWriter& EBMLWriter::serializeFloat(EbmlClassId classId, float value)
 /** Serializes binary data. */
 EBMLWriter& EBMLWriter::serializeData(EbmlClassId classId, const void *pvData, size_t cbData)
 {
-    writeClassId(classId);
-    writeSize(cbData);
+    uint8_t abHdr[VBOX_EBMLWRITER_MAX_HDR_SIZE];
+    write(abHdr, ebmlEncodeHdr(abHdr, classId, cbData));
     write(pvData, cbData);
     return *this;
 }
@@ -246,13 +312,8 @@ void EBMLWriter::writeSize(uint64_t parm)
       0000 001x  xxxx xxxx  xxxx xxxx  xxxx xxxx  xxxx xxxx  xxxx xxxx  xxxx xxxx            - value 0 to 2^49-2
       0000 0001  xxxx xxxx  xxxx xxxx  xxxx xxxx  xxxx xxxx  xxxx xxxx  xxxx xxxx  xxxx xxxx - value 0 to 2^56-2
      */
-    size_t size = 8 - ! (parm & (UINT64_MAX << 49)) - ! (parm & (UINT64_MAX << 42)) -
-                      ! (parm & (UINT64_MAX << 35)) - ! (parm & (UINT64_MAX << 28)) -
-                      ! (parm & (UINT64_MAX << 21)) - ! (parm & (UINT64_MAX << 14)) -
-                      ! (parm & (UINT64_MAX << 7));
-    /* One is subtracted in order to avoid loosing significant bit when size = 8. */
-    uint64_t mask = RT_BIT_64(size * 8 - 1);
-    writeUnsignedInteger((parm & (((mask << 1) - 1) >> size)) | (mask >> (size - 1)), size);
+    uint8_t abSize[sizeof(uint64_t)];
+    write(abSize, ebmlEncodeSize(abSize, parm));
 }
 
 /** Size calculation for variable size UNSIGNED integer.
@@ -267,9 +328,6 @@ void EBMLWriter::writeSize(uint64_t parm)
  */
 size_t EBMLWriter::getSizeOfUInt(uint64_t arg)
 {
-    return 8 - ! (arg & (UINT64_MAX << 56)) - ! (arg & (UINT64_MAX << 48)) -
-               ! (arg & (UINT64_MAX << 40)) - ! (arg & (UINT64_MAX << 32)) -
-               ! (arg & (UINT64_MAX << 24)) - ! (arg & (UINT64_MAX << 16)) -
-               ! (arg & (UINT64_MAX << 8));
+    return ebmlGetSizeOfUInt(arg);
 }
 
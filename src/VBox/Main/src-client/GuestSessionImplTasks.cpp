@@ -58,6 +58,12 @@
 *   Defines                                                                                                                      *
 *********************************************************************************************************************************/
 
+/** The maximum chunk size (in bytes) used for a single guest file read or write
+ *  when copying files between host and guest.  Each chunk costs a full HGCM
+ *  round trip to the guest, so bigger is better here; the Guest Additions grow
+ *  their scratch buffer on demand (up to VMMDEV_MAX_HGCM_DATA_SIZE). */
+#define GSTCTL_COPY_CHUNK_SIZE_MAX       _1M
+
 /**
  * (Guest Additions) ISO file flags.
  * Needed for handling Guest Additions updates.
@@ -417,12 +423,21 @@ int GuestSessionTask::fileCopyFromGuestInner(const Utf8Str &strSrcFile, ComObjPt
         }
     }
 
-    BYTE byBuf[_64K]; /** @todo Can we do better here? */
+    uint32_t const cbBuf = (uint32_t)RT_MIN(cbSize, GSTCTL_COPY_CHUNK_SIZE_MAX);
+    uint8_t *pbBuf = (uint8_t *)RTMemTmpAlloc(cbBuf);
+    if (!pbBuf)
+    {
+        setProgressErrorMsg(VBOX_E_IPRT_ERROR,
+                            Utf8StrFmt(tr("Allocating a %RU32 bytes copy buffer for guest file \"%s\" failed", "", cbBuf),
+                                       cbBuf, strSrcFile.c_str()));
+        return VERR_NO_TMP_MEMORY;
+    }
+
     while (cbToRead)
     {
         uint32_t cbRead;
-        const uint32_t cbChunk = RT_MIN(cbToRead, sizeof(byBuf));
-        vrc = srcFile->i_readData(cbChunk, GSTCTL_DEFAULT_TIMEOUT_MS, byBuf, sizeof(byBuf), &cbRead);
+        const uint32_t cbChunk = (uint32_t)RT_MIN(cbToRead, cbBuf);
+        vrc = srcFile->i_readData(cbChunk, GSTCTL_DEFAULT_TIMEOUT_MS, pbBuf, cbBuf, &cbRead);
         if (RT_FAILURE(vrc))
         {
             setProgressErrorMsg(VBOX_E_IPRT_ERROR,
@@ -431,7 +446,7 @@ int GuestSessionTask::fileCopyFromGuestInner(const Utf8Str &strSrcFile, ComObjPt
             break;
         }
 
-        vrc = RTFileWrite(*phDstFile, byBuf, cbRead, NULL /* No partial writes */);
+        vrc = RTFileWrite(*phDstFile, pbBuf, cbRead, NULL /* No partial writes */);
         if (RT_FAILURE(vrc))
         {
             setProgressErrorMsg(VBOX_E_IPRT_ERROR,
@@ -458,6 +473,8 @@ int GuestSessionTask::fileCopyFromGuestInner(const Utf8Str &strSrcFile, ComObjPt
             break;
     }
 
+    RTMemTmpFree(pbBuf);
+
     if (   SUCCEEDED(mProgress->COMGETTER(Canceled(&fCanceled)))
         && fCanceled)
         return VINF_SUCCESS;
@@ -748,12 +765,21 @@ int GuestSessionTask::fileCopyToGuestInner(const Utf8Str &strSrcFile, RTVFSFILE
         }
     }
 
-    BYTE byBuf[_64K];
+    uint32_t const cbBuf = (uint32_t)RT_MIN(cbSize, GSTCTL_COPY_CHUNK_SIZE_MAX);
+    uint8_t *pbBuf = (uint8_t *)RTMemTmpAlloc(cbBuf);
+    if (!pbBuf)
+    {
+        setProgressErrorMsg(VBOX_E_IPRT_ERROR,
+                            Utf8StrFmt(tr("Allocating a %RU32 bytes copy buffer for host file \"%s\" failed", "", cbBuf),
+                                       cbBuf, strSrcFile.c_str()));
+        return VERR_NO_TMP_MEMORY;
+    }
+
     while (cbToRead)
     {
         size_t cbRead;
-        const uint32_t cbChunk = RT_MIN(cbToRead, sizeof(byBuf));
-        vrc = RTVfsFileRead(hVfsFile, byBuf, cbChunk, &cbRead);
+        const uint32_t cbChunk = (uint32_t)RT_MIN(cbToRead, cbBuf);
+        vrc = RTVfsFileRead(hVfsFile, pbBuf, cbChunk, &cbRead);
         if (RT_FAILURE(vrc))
         {
             setProgressErrorMsg(VBOX_E_IPRT_ERROR,
@@ -762,7 +788,7 @@ int GuestSessionTask::fileCopyToGuestInner(const Utf8Str &strSrcFile, RTVFSFILE
             break;
         }
 
-        vrc = fileDst->i_writeData(GSTCTL_DEFAULT_TIMEOUT_MS, byBuf, (uint32_t)cbRead, NULL /* No partial writes */);
+        vrc = fileDst->i_writeData(GSTCTL_DEFAULT_TIMEOUT_MS, pbBuf, (uint32_t)cbRead, NULL /* No partial writes */);
         if (RT_FAILURE(vrc))
         {
             setProgressErrorMsg(VBOX_E_IPRT_ERROR,
@@ -789,6 +815,8 @@ int GuestSessionTask::fileCopyToGuestInner(const Utf8Str &strSrcFile, RTVFSFILE
             break;
     }
 
+    RTMemTmpFree(pbBuf);
+
     if (RT_FAILURE(vrc))
         return vrc;
 
@@ -317,15 +317,15 @@ int HGCMThread::Initialize(const char *pszThreadName, PFNHGCMTHREAD pfnThread, v
                                                   "/HGCM/%s/PostMsg1Pending", pszStatsSubDir);
                         pVMM->pfnSTAMR3RegisterFU(pUVM, &m_StatPostMsgTwoPending, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
                                                   STAMUNIT_COUNT,
-                                                  "Times a message was appended to input queue with only one pending message.",
+                                                  "Times a message was appended to input queue with two pending messages.",
                                                   "/HGCM/%s/PostMsg2Pending", pszStatsSubDir);
                         pVMM->pfnSTAMR3RegisterFU(pUVM, &m_StatPostMsgThreePending, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
                                                   STAMUNIT_COUNT,
-                                                  "Times a message was appended to input queue with only one pending message.",
+                                                  "Times a message was appended to input queue with three pending messages.",
                                                   "/HGCM/%s/PostMsg3Pending", pszStatsSubDir);
                         pVMM->pfnSTAMR3RegisterFU(pUVM, &m_StatPostMsgManyPending, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
                                                   STAMUNIT_COUNT,
-                                                  "Times a message was appended to input queue with only one pending message.",
+                                                  "Times a message was appended to input queue with more than three pending messages.",
                                                   "/HGCM/%s/PostMsgManyPending", pszStatsSubDir);
                     }
 
@@ -439,9 +439,9 @@ int HGCMThread::MsgPost(HGCMMsgCore *pMsg, PFNHGCMMSGCALLBACK pfnCallback, bool
             pPrev->m_pNext = pMsg;
             if (!pPrev->m_pPrev)
                 STAM_REL_COUNTER_INC(&m_StatPostMsgOnePending);
-            else if (!pPrev->m_pPrev)
-                STAM_REL_COUNTER_INC(&m_StatPostMsgTwoPending);
             else if (!pPrev->m_pPrev->m_pPrev)
+                STAM_REL_COUNTER_INC(&m_StatPostMsgTwoPending);
+            else if (!pPrev->m_pPrev->m_pPrev->m_pPrev)
                 STAM_REL_COUNTER_INC(&m_StatPostMsgThreePending);
             else
                 STAM_REL_COUNTER_INC(&m_StatPostMsgManyPending);
@@ -456,12 +456,18 @@ int HGCMThread::MsgPost(HGCMMsgCore *pMsg, PFNHGCMMSGCALLBACK pfnCallback, bool
 
         Leave();
 
-        LogFlow(("HGCMThread::MsgPost: going to inform the thread %p about message, fWait = %d\n", this, fWait));
+        /* Inform the worker thread that there is a message.  This is only needed
+           when the queue was empty: otherwise the worker has yet to dequeue the
+           previous message and will find this one in MsgGet without waiting, so
+           we can save ourselves the (expensive) semaphore signalling. */
+        if (!pPrev)
+        {
+            LogFlow(("HGCMThread::MsgPost: going to inform the thread %p about message, fWait = %d\n", this, fWait));
 
-        /* Inform the worker thread that there is a message. */
-        RTSemEventSignal(m_eventThread);
+            RTSemEventSignal(m_eventThread);
 
-        LogFlow(("HGCMThread::MsgPost: event signalled\n"));
+            LogFlow(("HGCMThread::MsgPost: event signalled\n"));
+        }
 
         if (fWait)
         {
@@ -415,6 +415,9 @@ DECLCALLBACK(int) RecordingContext::threadMain(RTTHREAD hThreadSelf, void *pvUse
 
     LogRel2(("Recording: Thread started\n"));
 
+    /* Index of the stream to process first in the next round. */
+    size_t idxStreamFirst = 0;
+
     for (;;)
     {
         int vrcWait = RTSemEventWait(pThis->m_WaitEvent, RT_MS_1SEC);
@@ -439,21 +442,25 @@ DECLCALLBACK(int) RecordingContext::threadMain(RTTHREAD hThreadSelf, void *pvUse
         /** @todo r=andy This is inefficient -- as we already wake up this thread
          *               for every screen from Main, we here go again (on every wake up) through
          *               all screens.  */
-        RecordingStreams::iterator itStream = pThis->m_vecStreams.begin();
-        while (itStream != pThis->m_vecStreams.end())
+        /* Start each round with the next stream, so that a screen with a lot of (slow to encode)
+         * data does not always delay the same screens behind it.  A failing stream does not keep
+         * the remaining ones from being processed either. */
+        size_t const cStreams = pThis->m_vecStreams.size();
+        for (size_t i = 0; i < cStreams; i++)
         {
-            RecordingStream *pStream = (*itStream);
+            RecordingStream *pStream = pThis->m_vecStreams.at((idxStreamFirst + i) % cStreams);
 
             /* Hand-in common encoded blocks. */
-            vrc = pStream->ThreadMain(vrcWait, msTimestamp, pThis->m_mapBlocksEncoded);
-            if (RT_FAILURE(vrc))
+            int const vrc2 = pStream->ThreadMain(vrcWait, msTimestamp, pThis->m_mapBlocksEncoded);
+            if (RT_FAILURE(vrc2))
             {
-                LogRel(("Recording: Processing stream #%RU16 failed (%Rrc)\n", pStream->GetID(), vrc));
-                break;
+                LogRel(("Recording: Processing stream #%RU16 failed (%Rrc)\n", pStream->GetID(), vrc2));
+                if (RT_SUCCESS(vrc))
+                    vrc = vrc2;
             }
-
-            ++itStream;
         }
+        if (cStreams)
+            idxStreamFirst = (idxStreamFirst + 1) % cStreams;
 
         if (RT_FAILURE(vrc))
             LogRel(("Recording: Encoding thread failed (%Rrc)\n", vrc));
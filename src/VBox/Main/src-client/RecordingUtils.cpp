@@ -44,6 +44,10 @@
 #define LOG_GROUP LOG_GROUP_RECORDING
 #include <VBox/log.h>
 
+#if defined(RT_ARCH_AMD64)
+# include <emmintrin.h> /* SSE2 is part of the AMD64 baseline, so no runtime check is needed. */
+#endif
+
 
 /**
  * Convert an image to YUV420p format.
@@ -213,6 +217,53 @@ void RecordingUtilsConvBGRA32ToYUVI420(uint8_t *paDst, uint32_t uDstWidth, uint3
 #undef CALC_V
 }
 
+/**
+ * Computes the luma of a row of BGRA32 pixels, as used by RecordingUtilsConvBGRA32ToYUVI420Ex().
+ *
+ * @param   pbDstY              Where to store the luma values.
+ * @param   pbSrc               The source pixels.
+ * @param   cPixels             Number of pixels to convert.
+ */
+static void recordingUtilsConvBGRA32RowToY(uint8_t *pbDstY, const uint8_t *pbSrc, size_t cPixels)
+{
+    size_t x = 0;
+#if defined(RT_ARCH_AMD64)
+    /* Eight pixels per round: multiply-add B,G resp. R,A pairs to dwords, sum per pixel,
+       shift and pack.  All sums fit into 16 bits, so the result is identical to the C code. */
+    __m128i const Coeffs  = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+    __m128i const Zero    = _mm_setzero_si128();
+    for (; x + 8 <= cPixels; x += 8)
+    {
+        __m128i const Lo = _mm_loadu_si128((const __m128i *)&pbSrc[x * 4]);
+        __m128i const Hi = _mm_loadu_si128((const __m128i *)&pbSrc[x * 4 + 16]);
+
+        __m128i a = _mm_madd_epi16(_mm_unpacklo_epi8(Lo, Zero), Coeffs);  /* px 0,1 */
+        __m128i b = _mm_madd_epi16(_mm_unpackhi_epi8(Lo, Zero), Coeffs);  /* px 2,3 */
+        __m128i c = _mm_madd_epi16(_mm_unpacklo_epi8(Hi, Zero), Coeffs);  /* px 4,5 */
+        __m128i d = _mm_madd_epi16(_mm_unpackhi_epi8(Hi, Zero), Coeffs);  /* px 6,7 */
+
+        /* Sum each pixel's two dwords into the low one of its qword, then gather them. */
+        a = _mm_shuffle_epi32(_mm_add_epi32(a, _mm_srli_epi64(a, 32)), _MM_SHUFFLE(3, 3, 2, 0));
+        b = _mm_shuffle_epi32(_mm_add_epi32(b, _mm_srli_epi64(b, 32)), _MM_SHUFFLE(3, 3, 2, 0));
+        c = _mm_shuffle_epi32(_mm_add_epi32(c, _mm_srli_epi64(c, 32)), _MM_SHUFFLE(3, 3, 2, 0));
+        d = _mm_shuffle_epi32(_mm_add_epi32(d, _mm_srli_epi64(d, 32)), _MM_SHUFFLE(3, 3, 2, 0));
+
+        __m128i const Y0123 = _mm_srli_epi32(_mm_unpacklo_epi64(a, b), 8);
+        __m128i const Y4567 = _mm_srli_epi32(_mm_unpacklo_epi64(c, d), 8);
+        __m128i const Y     = _mm_packus_epi16(_mm_packs_epi32(Y0123, Y4567), Zero);
+        _mm_storel_epi64((__m128i *)&pbDstY[x], Y);
+    }
+#endif
+    for (; x < cPixels; x++)
+    {
+        unsigned const b = pbSrc[x * 4];
+        unsigned const g = pbSrc[x * 4 + 1];
+        unsigned const r = pbSrc[x * 4 + 2];
+
+        pbDstY[x] = (uint8_t)((66 * r + 129 * g + 25 * b) >> 8);
+    }
+}
+
 /**
  * Converts a part of a RGB BGRA32 buffer to a YUV I420 buffer.
  *
@@ -248,35 +299,63 @@ void RecordingUtilsConvBGRA32ToYUVI420Ex(uint8_t *paDst, uint32_t uDstX, uint32_
 #define CALC_V(r, g, b) \
     ((112 * r + -94 * g + -18 * b) >> 8) + 128
 
-    uint32_t uDstXCur = uDstX;
-
     const unsigned uSrcBytesPerPixel = uSrcBPP / 8;
 
-    size_t offSrc = (uSrcY * uSrcStride) + (uSrcX * uSrcBytesPerPixel);
+    /* Each chroma sample covers a 2x2 block.  Only the bottom-right-most pixel of a block
+     * within the source rectangle gets its chroma written, so every U/V byte is stored once
+     * and all other pixels only produce luma. */
+    size_t const cbPlaneY = uDstWidth * uDstHeight;
+    uint8_t     *pbDstU   = paDst + cbPlaneY;
+    uint8_t     *pbDstV   = pbDstU + cbPlaneY / 4;
+
+    const uint8_t *pbSrcRow = paSrc + (uSrcY * uSrcStride) + (uSrcX * uSrcBytesPerPixel);
 
     for (size_t y = 0; y < uSrcHeight; y++)
     {
-        for (size_t x = 0; x < uSrcWidth; x++)
-        {
-            size_t const offBGR = offSrc + (x * uSrcBytesPerPixel);
-
-            uint8_t const b = paSrc[offBGR];
-            uint8_t const g = paSrc[offBGR + 1];
-            uint8_t const r = paSrc[offBGR + 2];
-
-            size_t const offY  = uDstY * uDstWidth + uDstXCur;
-            size_t const offUV = (uDstY / 2) * (uDstWidth / 2) + (uDstXCur / 2) + uDstWidth * uDstHeight;
+        uint8_t *pbDstY = paDst + (size_t)uDstY * uDstWidth + uDstX;
 
-            paDst[offY]                               = CALC_Y(r, g, b);
-            paDst[offUV]                              = CALC_U(r, g, b);
-            paDst[offUV + uDstWidth * uDstHeight / 4] = CALC_V(r, g, b);
+        if (uSrcBytesPerPixel == 4)
+            recordingUtilsConvBGRA32RowToY(pbDstY, pbSrcRow, uSrcWidth);
+        else
+        {
+            const uint8_t *pbSrc = pbSrcRow;
+            for (size_t x = 0; x < uSrcWidth; x++, pbSrc += uSrcBytesPerPixel)
+            {
+                uint8_t const b = pbSrc[0];
+                uint8_t const g = pbSrc[1];
+                uint8_t const r = pbSrc[2];
 
-            uDstXCur++;
+                pbDstY[x] = CALC_Y(r, g, b);
+            }
         }
 
-        offSrc += uSrcStride;
+        /* Even rows leave the chroma to the next row, unless this is the last one. */
+        if (   ((uDstY & 1) || y + 1 == uSrcHeight)
+            && uSrcWidth)
+        {
+            size_t const offUVRow = (uDstY / 2) * (uDstWidth / 2);
+
+#define STORE_UV(a_x) \
+            do { \
+                const uint8_t *pbSrc    = &pbSrcRow[(a_x) * uSrcBytesPerPixel]; \
+                uint8_t const  b        = pbSrc[0]; \
+                uint8_t const  g        = pbSrc[1]; \
+                uint8_t const  r        = pbSrc[2]; \
+                uint32_t const uDstXCur = uDstX + (uint32_t)(a_x); \
+                pbDstU[offUVRow + uDstXCur / 2] = CALC_U(r, g, b); \
+                pbDstV[offUVRow + uDstXCur / 2] = CALC_V(r, g, b); \
+            } while (0)
+
+            /* Odd destination columns, plus the last pixel if it starts a block. */
+            for (size_t x = (uDstX & 1) ? 0 : 1; x < uSrcWidth; x += 2)
+                STORE_UV(x);
+            if (!((uDstX + uSrcWidth - 1) & 1))
+                STORE_UV(uSrcWidth - 1);
+
+#undef STORE_UV
+        }
 
-        uDstXCur = uDstX;
+        pbSrcRow += uSrcStride;
         uDstY++;
     }
 
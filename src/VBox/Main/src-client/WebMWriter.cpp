@@ -447,19 +447,34 @@ int WebMWriter::writeSimpleBlockEBML(WebMTrack *a_pTrack, WebMSimpleBlock *a_pBl
 #endif
     /*
      * Write a "Simple Block".
+     *
+     * This is done for every single audio / video frame, so assemble the block
+     * header in one go and only do two writes (header + frame data) per block.
      */
-    writeClassId(MkvElem_SimpleBlock);
+    AssertCompile(MkvElem_SimpleBlock <= UINT8_MAX);
+    AssertReturn(a_pTrack->uTrack < 0x7f, VERR_INVALID_PARAMETER); /* Track number must fit into a 1 byte EBML size. */
+    AssertReturn(m_cbTimecode >= 1 && m_cbTimecode <= sizeof(uint64_t), VERR_INVALID_PARAMETER);
+
+    uint8_t abHdr[1 /* Class ID */ + 4 /* Block size */ + 1 /* Track number */ + sizeof(uint64_t) /* Timecode */ + 1 /* Flags */];
+    size_t  offHdr = 0;
+    abHdr[offHdr++] = (uint8_t)MkvElem_SimpleBlock;
     /* Block size. */
-    writeUnsignedInteger(0x10000000u | (  1                 /* Track number size. */
-                                        + m_cbTimecode      /* Timecode size .*/
-                                        + 1                 /* Flags size. */
-                                        + a_pBlock->Data.cb /* Actual frame data size. */),  4);
-    /* Track number. */
-    writeSize(a_pTrack->uTrack);
+    uint32_t const cbBlockBE = RT_H2BE_U32(0x10000000u | (  1                 /* Track number size. */
+                                                          + m_cbTimecode      /* Timecode size .*/
+                                                          + 1                 /* Flags size. */
+                                                          + a_pBlock->Data.cb /* Actual frame data size. */));
+    memcpy(&abHdr[offHdr], &cbBlockBE, sizeof(cbBlockBE));
+    offHdr += sizeof(cbBlockBE);
+    /* Track number (as an EBML size). */
+    abHdr[offHdr++] = (uint8_t)(0x80 | a_pTrack->uTrack);
     /* Timecode (relative to cluster opening timecode). */
-    writeUnsignedInteger(a_pBlock->Data.tcRelToClusterMs, m_cbTimecode);
+    uint64_t const tcRelToClusterMsBE = RT_H2BE_U64(a_pBlock->Data.tcRelToClusterMs);
+    memcpy(&abHdr[offHdr], (uint8_t const *)&tcRelToClusterMsBE + sizeof(tcRelToClusterMsBE) - m_cbTimecode, m_cbTimecode);
+    offHdr += m_cbTimecode;
     /* Flags. */
-    writeUnsignedInteger(a_pBlock->Data.fFlags, 1);
+    abHdr[offHdr++] = (uint8_t)a_pBlock->Data.fFlags;
+
+    write(abHdr, offHdr);
     /* Frame data. */
     write(a_pBlock->Data.pv, a_pBlock->Data.cb);
 
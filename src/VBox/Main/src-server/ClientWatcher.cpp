@@ -175,6 +175,12 @@ void VirtualBox::ClientWatcher::addProcess(RTPROCESS pid)
     AssertReturnVoid(mThread != NIL_RTTHREAD);
     AutoWriteLock alock(mLock COMMA_LOCKVAL_SRC_POS);
     mProcesses.push_back(pid);
+#if defined(VBOX_WITH_GENERIC_SESSION_WATCHER)
+    /* The watcher thread may be sleeping without timeout if it had
+       nothing to poll, so make sure it gets to see the new process. */
+    alock.release();
+    RTSemEventSignal(mUpdateReq);
+#endif
 }
 
 /**
@@ -981,6 +987,17 @@ DECLCALLBACK(int) VirtualBox::ClientWatcher::worker(RTTHREAD hThreadSelf, void *
                 cMillies = s_aUpdateTimeoutSteps[uOld];
             }
 
+            /* Polling is only needed for catching spawn failures and reaping
+             * child processes.  Session deaths are reported through the client
+             * tokens, which call update(), and so does addProcess().  So when
+             * there is nothing to poll for there is no point in waking up. */
+            if (!cntSpawned && !updateSpawned)
+            {
+                AutoReadLock alock(that->mLock COMMA_LOCKVAL_SRC_POS);
+                if (that->mProcesses.empty())
+                    cMillies = RT_INDEFINITE_WAIT;
+            }
+
             int vrc = RTSemEventWait(that->mUpdateReq, cMillies);
 
             /*
@@ -6869,7 +6869,9 @@ HRESULT Medium::i_exportFile(const char *aFilename,
          */
         PVDINTERFACE   pVDImageIfaces = m->vdImageIfaces;
         PVDINTERFACEIO pVfsIoIf;
-        int vrc = VDIfCreateFromVfsStream(hVfsIosDst, RTFILE_O_WRITE, &pVfsIoIf);
+        /* Write-behind lets the appliance digest and tar writing run in parallel with
+           reading and compressing the source. */
+        int vrc = VDIfCreateFromVfsStreamEx(hVfsIosDst, RTFILE_O_WRITE, VD_IFFROMVFS_F_WRITE_BEHIND, &pVfsIoIf);
         if (RT_SUCCESS(vrc))
         {
             vrc = VDInterfaceAdd(&pVfsIoIf->Core, "Medium::ExportTaskVfsIos", VDINTERFACETYPE_IO,
@@ -6929,6 +6931,13 @@ HRESULT Medium::i_exportFile(const char *aFilename,
                                          pProgress,
                                          pVDImageIfaces,
                                          NULL);
+                            /* Close the target explicitly rather than leaving it to VDDestroy, which
+                               ignores the status.  With write-behind the last writes (including the
+                               metadata and footer written on close) only report failure when the stream
+                               is closed, and a truncated export must not be reported as a success.  A
+                               VDFlush wouldn't do here as it doesn't cover what the close writes. */
+                            if (RT_SUCCESS(vrc))
+                                vrc = VDClose(pDstHdd, false /*fDelete*/);
                             if (RT_SUCCESS(vrc))
                                 hrc = S_OK;
                             else
@@ -6944,10 +6953,13 @@ HRESULT Medium::i_exportFile(const char *aFilename,
             }
             else
                 hrc = setErrorVrc(vrc, "VDInterfaceAdd -> %Rrc", vrc);
-            VDIfDestroyFromVfsStream(pVfsIoIf);
+            vrc = VDIfDestroyFromVfsStream(pVfsIoIf);
+            if (RT_FAILURE(vrc) && SUCCEEDED(hrc))
+                hrc = setErrorBoth(VBOX_E_FILE_ERROR, vrc, tr("Could not create the exported medium '%s' (%Rrc)"),
+                                   aFilename, vrc);
         }
         else
-            hrc = setErrorVrc(vrc, "VDIfCreateFromVfsStream -> %Rrc", vrc);
+            hrc = setErrorVrc(vrc, "VDIfCreateFromVfsStreamEx -> %Rrc", vrc);
     }
     return hrc;
 }
@@ -1305,16 +1305,13 @@ void Metric::query(ULONG **data, ULONG *count, ULONG *sequenceNumber)
         mSubMetric->query(tmpData);
         if (mAggregate)
         {
-            *count = 1;
-            *data  = (ULONG*)RTMemAlloc(sizeof(**data));
-            **data = mAggregate->compute(tmpData, length);
-            RTMemFree(tmpData);
+            /* Store the aggregate in the first slot instead of allocating another buffer for it. */
+            *count   = 1;
+            *tmpData = mAggregate->compute(tmpData, length);
         }
         else
-        {
             *count = length;
-            *data  = tmpData;
-        }
+        *data = tmpData;
     }
     else
     {
@@ -1339,7 +1336,7 @@ const char * AggregateAvg::getName()
 ULONG AggregateMin::compute(ULONG *data, ULONG length)
 {
     ULONG tmp = *data;
-    for (ULONG i = 0; i < length; ++i)
+    for (ULONG i = 1; i < length; ++i)
         if (data[i] < tmp)
             tmp = data[i];
     return tmp;
@@ -1353,7 +1350,7 @@ const char * AggregateMin::getName()
 ULONG AggregateMax::compute(ULONG *data, ULONG length)
 {
     ULONG tmp = *data;
-    for (ULONG i = 0; i < length; ++i)
+    for (ULONG i = 1; i < length; ++i)
         if (data[i] > tmp)
             tmp = data[i];
     return tmp;
@@ -2512,11 +2512,10 @@ HRESULT VirtualBox::getMachinesByGroups(const std::vector<com::Utf8Str> &aGroups
 HRESULT VirtualBox::getMachineStates(const std::vector<ComPtr<IMachine> > &aMachines,
                                      std::vector<MachineState_T> &aStates)
 {
-    com::SafeIfaceArray<IMachine> saMachines(aMachines);
     aStates.resize(aMachines.size());
-    for (size_t i = 0; i < saMachines.size(); i++)
+    for (size_t i = 0; i < aMachines.size(); i++)
     {
-        ComPtr<IMachine> pMachine = saMachines[i];
+        const ComPtr<IMachine> &pMachine = aMachines[i];
         MachineState_T state = MachineState_Null;
         if (!pMachine.isNull())
         {
@@ -4050,7 +4049,7 @@ HRESULT VirtualBox::i_findMachine(const Guid &aId,
              it != m->allMachines.end();
              ++it)
         {
-            ComObjPtr<Machine> pMachine = *it;
+            ComObjPtr<Machine> &pMachine = *it;
 
             if (!fPermitInaccessible)
             {
@@ -4310,9 +4309,9 @@ HRESULT VirtualBox::i_findHardDiskByLocation(const Utf8Str &strLocation,
 
         AutoCaller autoCaller(pHD);
         if (FAILED(autoCaller.hrc())) return autoCaller.hrc();
-        AutoWriteLock mlock(pHD COMMA_LOCKVAL_SRC_POS);
+        AutoReadLock mlock(pHD COMMA_LOCKVAL_SRC_POS);
 
-        Utf8Str strLocationFull = pHD->i_getLocationFull();
+        const Utf8Str &strLocationFull = pHD->i_getLocationFull();
 
         if (0 == RTPathCompare(strLocationFull.c_str(), strLocation.c_str()))
         {
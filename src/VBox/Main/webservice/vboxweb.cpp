@@ -185,8 +185,9 @@ static util::RWLockHandle       *g_pVirtualBoxLockHandle;
 
 static ComPtr<IVirtualBox>      g_pVirtualBox = NULL;
 
-// this mutex protects all of the below
-util::WriteLockHandle           *g_pWebsessionsLockHandle;
+// this mutex protects all of the below; lookups only need it in read mode,
+// anything adding or removing websessions or references needs write mode
+util::RWLockHandle              *g_pWebsessionsLockHandle;
 
 static WebsessionsMap           g_mapWebsessions;
 static ULONG64                  g_cManagedObjects = 0;
@@ -1309,7 +1310,7 @@ int main(int argc, char *argv[])
     // create the global mutexes
     g_pAuthLibLockHandle = new util::WriteLockHandle(util::LOCKCLASS_WEBSERVICE);
     g_pVirtualBoxLockHandle = new util::RWLockHandle(util::LOCKCLASS_WEBSERVICE);
-    g_pWebsessionsLockHandle = new util::WriteLockHandle(util::LOCKCLASS_WEBSERVICE);
+    g_pWebsessionsLockHandle = new util::RWLockHandle(util::LOCKCLASS_WEBSERVICE);
     g_pThreadsLockHandle = new util::RWLockHandle(util::LOCKCLASS_OBJECTSTATE);
 
     // SOAP queue pumper thread
@@ -2041,7 +2042,8 @@ WebServiceSession *WebServiceSession::findWebsessionFromRef(const WSDLT_ID &id)
  */
 void WebServiceSession::touch()
 {
-    _tLastObjectLookup = RTTimeProgramSecTS();
+    // atomic, as this is called from lookups holding only the read lock
+    ASMAtomicWriteU32(&_tLastObjectLookup, (uint32_t)RTTimeProgramSecTS());
 }
 
 /**
@@ -2186,7 +2188,8 @@ ManagedObjectRef::~ManagedObjectRef()
  * in the given integer ID, in order to prevent the websession from timing
  * out.
  *
- * Preconditions: Caller must have locked g_pWebsessionsLockHandle.
+ * Preconditions: Caller must have locked g_pWebsessionsLockHandle (read mode
+ *                is sufficient).
  *
  * @param   id
  * @param   pRef
@@ -2275,7 +2278,7 @@ int __vbox__IManagedObjectRef_USCOREgetInterfaceName(
     do
     {
         // findRefFromId require the lock
-        util::AutoWriteLock lock(g_pWebsessionsLockHandle COMMA_LOCKVAL_SRC_POS);
+        util::AutoReadLock lock(g_pWebsessionsLockHandle COMMA_LOCKVAL_SRC_POS);
 
         ManagedObjectRef *pRef;
         if (!ManagedObjectRef::findRefFromId(req->_USCOREthis, &pRef, false))
@@ -69,7 +69,7 @@ typedef std::string vbox__uuid;
 
 extern bool g_fVerbose;
 
-extern util::WriteLockHandle  *g_pWebsessionsLockHandle;
+extern util::RWLockHandle     *g_pWebsessionsLockHandle;
 
 extern const WSDLT_ID          g_EmptyWSDLID;
 
@@ -121,7 +121,7 @@ class WebServiceSession
         WebServiceSessionPrivate    *_pp;               // opaque data struct (defined in vboxweb.cpp)
         bool                        _fDestructing;
 
-        uint32_t                    _tLastObjectLookup;
+        uint32_t volatile           _tLastObjectLookup; // updated atomically by touch()
 
         // hide the copy constructor because we're not copyable
         WebServiceSession(const WebServiceSession &copyFrom);
@@ -271,8 +271,8 @@ int findComPtrFromId(struct soap *soap,
                      ComPtr<T> &pComPtr,
                      bool fNullAllowed)
 {
-    // findRefFromId requires thelock
-    util::AutoWriteLock lock(g_pWebsessionsLockHandle COMMA_LOCKVAL_SRC_POS);
+    // findRefFromId requires the lock, but only for reading
+    util::AutoReadLock lock(g_pWebsessionsLockHandle COMMA_LOCKVAL_SRC_POS);
 
     ManagedObjectRef *pRef;
     int vrc = ManagedObjectRef::findRefFromId(id, &pRef, fNullAllowed);
@@ -602,11 +602,15 @@ static void intnetR3RequestProcess(xpc_connection_t hCon, xpc_object_t hObj, PSU
         }
     }
 
+    /* Requests sent as one-way doorbells (VMMR0_DO_INTNET_IF_SEND from the xmit path) don't expect a reply. */
     xpc_object_t hObjReply = xpc_dictionary_create_reply(hObj);
-    xpc_dictionary_set_uint64(hObjReply, "rc", INTNET_R3_SVC_SET_RC(rc));
-    xpc_dictionary_set_data(hObjReply, "reply", &ReqReply, cbReply);
-    xpc_connection_send_message(hCon, hObjReply);
-    xpc_release(hObjReply);
+    if (hObjReply)
+    {
+        xpc_dictionary_set_uint64(hObjReply, "rc", INTNET_R3_SVC_SET_RC(rc));
+        xpc_dictionary_set_data(hObjReply, "reply", &ReqReply, cbReply);
+        xpc_connection_send_message(hCon, hObjReply);
+        xpc_release(hObjReply);
+    }
 }
 
 
@@ -64,8 +64,13 @@
 
 
 
-/** Increase maximum TCP window size. */
-#define TCP_WND 32768
+/**
+ * Increase maximum TCP window size.  This lwIP has no window scaling
+ * (the window fields are u16_t), so use the largest MSS multiple that
+ * still fits into 16 bits to keep bulk port-forwarded transfers from
+ * stalling on the window.
+ */
+#define TCP_WND (44 * TCP_MSS)
 
 /** Increase TCP maximum segment size. */
 #define TCP_MSS 1460
@@ -73,8 +78,8 @@
 /** Enable queueing of out-of-order segments. */
 #define TCP_QUEUE_OOSEQ 1
 
-/** TCP sender buffer space (bytes). */
-#define TCP_SND_BUF (32 * TCP_MSS)
+/** TCP sender buffer space (bytes).  Match TCP_WND, limited by u16_t snd_buf. */
+#define TCP_SND_BUF (44 * TCP_MSS)
 
 /* TCP sender buffer space (pbufs). This must be at least = 2 *
    TCP_SND_BUF/TCP_MSS for things to work. */
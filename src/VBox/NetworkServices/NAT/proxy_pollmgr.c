@@ -51,9 +51,22 @@
 #include "winpoll.h"
 #endif
 
+#include <iprt/assert.h>
 #include <iprt/req.h>
 #include <iprt/errcore.h>
 
+#ifdef RT_OS_LINUX
+/*
+ * Use epoll(7) where available.  The pollfd array stays the
+ * authoritative state that the rest of the code manipulates; the
+ * epoll set is synced with it before each wait, which keeps the
+ * per-iteration kernel cost proportional to the number of ready
+ * sockets instead of the number of managed sockets.
+ */
+# define POLLMGR_WITH_EPOLL
+# include <sys/epoll.h>
+#endif
+
 
 #define POLLMGR_GARBAGE (-1)
 
@@ -72,6 +85,15 @@ struct pollmgr_chan {
     bool arg_valid;
 };
 
+#ifdef POLLMGR_WITH_EPOLL
+/* what is currently registered with epoll for a slot */
+struct pollmgr_epreg {
+    SOCKET fd;                  /* INVALID_SOCKET if nothing */
+    short events;
+    bool dirty;                 /* slot was (re)assigned, re-register */
+};
+#endif
+
 struct pollmgr {
     struct pollfd *fds;
     struct pollmgr_handler **handlers;
@@ -88,6 +110,14 @@ struct pollmgr {
     RTREQQUEUE queue;
     struct pollmgr_handler queue_handler;
     struct pollmgr_chan chan_handlers[POLLMGR_CHAN_COUNT];
+
+#ifdef POLLMGR_WITH_EPOLL
+    int epfd;                   /* -1 if we fall back to poll(2) */
+    struct pollmgr_epreg *epreg;
+    struct epoll_event *epevents;
+    nfds_t epcapacity;          /* allocated size of epreg/epevents */
+    nfds_t epnregs;             /* part of epreg that may be registered */
+#endif
 } pollmgr;
 
 
@@ -99,6 +129,11 @@ static void pollmgr_loop(void);
 static void pollmgr_add_at(int, struct pollmgr_handler *, SOCKET, int);
 static void pollmgr_refptr_delete(struct pollmgr_refptr *);
 
+#ifdef POLLMGR_WITH_EPOLL
+static int pollmgr_epoll_wait(void);
+static void pollmgr_epoll_invalidate(int);
+#endif
+
 
 /*
  * We cannot portably peek at the length of the incoming datagram and
@@ -132,6 +167,17 @@ pollmgr_init(void)
     pollmgr.capacity = 0;
     pollmgr.nfds = 0;
 
+#ifdef POLLMGR_WITH_EPOLL
+    pollmgr.epreg = NULL;
+    pollmgr.epevents = NULL;
+    pollmgr.epcapacity = 0;
+    pollmgr.epnregs = 0;
+    pollmgr.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (pollmgr.epfd < 0) {
+        DPRINTF(("epoll_create1: %R[sockerr], using poll\n", errno));
+    }
+#endif
+
     for (i = 0; i < POLLMGR_SLOT_STATIC_COUNT; ++i) {
         pollmgr.chan[i][POLLMGR_CHFD_RD] = INVALID_SOCKET;
         pollmgr.chan[i][POLLMGR_CHFD_WR] = INVALID_SOCKET;
@@ -459,6 +505,9 @@ pollmgr_add_at(int slot, struct pollmgr_handler *handler, SOCKET fd, int events)
     pollmgr.handlers[slot] = handler;
 
     handler->slot = slot;
+#ifdef POLLMGR_WITH_EPOLL
+    pollmgr_epoll_invalidate(slot);
+#endif
 }
 
 
@@ -502,6 +551,11 @@ pollmgr_loop(void)
 
     for (;;) {
 #ifndef RT_OS_WINDOWS
+# ifdef POLLMGR_WITH_EPOLL
+        if (pollmgr.epfd >= 0)
+            nready = pollmgr_epoll_wait();
+        else
+# endif
         nready = poll(pollmgr.fds, pollmgr.nfds, -1);
 #else
         int rc = RTWinPoll(pollmgr.fds, pollmgr.nfds,RT_INDEFINITE_WAIT, &nready);
@@ -660,6 +714,9 @@ pollmgr_loop(void)
                 pollmgr.fds[delfirst] = pollmgr.fds[last]; /* struct copy */
                 pollmgr.handlers[delfirst] = pollmgr.handlers[last];
                 pollmgr.handlers[delfirst]->slot = (int)delfirst;
+#ifdef POLLMGR_WITH_EPOLL
+                pollmgr_epoll_invalidate((int)delfirst);
+#endif
                 --pollmgr.nfds;
 
                 if ((nfds_t)delnext >= pollmgr.nfds) {
@@ -679,6 +736,150 @@ pollmgr_loop(void)
 }
 
 
+#ifdef POLLMGR_WITH_EPOLL
+/*
+ * Linux defines EPOLL* event bits with the same values as their POLL*
+ * counterparts, so events and revents are passed through as is.
+ */
+AssertCompile(EPOLLIN == POLLIN && EPOLLPRI == POLLPRI && EPOLLOUT == POLLOUT);
+AssertCompile(EPOLLERR == POLLERR && EPOLLHUP == POLLHUP);
+
+
+/**
+ * Forget what is registered for the slot, it has been assigned to a
+ * different handler/socket.
+ */
+static void
+pollmgr_epoll_invalidate(int slot)
+{
+    if ((nfds_t)slot < pollmgr.epcapacity) {
+        pollmgr.epreg[slot].dirty = true;
+    }
+}
+
+
+/**
+ * poll(2) replacement on top of epoll(7).
+ *
+ * Syncs the epoll set with the pollfd array, waits and scatters the
+ * results into pollfd::revents, so the poll loop can stay the same.
+ * Returns the number of slots with non-zero revents, or -1 with errno
+ * set.
+ */
+static int
+pollmgr_epoll_wait(void)
+{
+    struct epoll_event ev;
+    nfds_t i;
+    int nready, npending, j;
+
+    if (pollmgr.epcapacity < pollmgr.capacity) {
+        struct pollmgr_epreg *newreg;
+        struct epoll_event *newevents;
+
+        newreg = (struct pollmgr_epreg *)
+            realloc(pollmgr.epreg, pollmgr.capacity * sizeof(*pollmgr.epreg));
+        if (newreg == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        pollmgr.epreg = newreg;
+
+        newevents = (struct epoll_event *)
+            realloc(pollmgr.epevents, pollmgr.capacity * sizeof(*pollmgr.epevents));
+        if (newevents == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        pollmgr.epevents = newevents;
+
+        for (i = pollmgr.epcapacity; i < pollmgr.capacity; ++i) {
+            pollmgr.epreg[i].fd = INVALID_SOCKET;
+            pollmgr.epreg[i].events = 0;
+            pollmgr.epreg[i].dirty = true;
+        }
+        pollmgr.epcapacity = pollmgr.capacity;
+    }
+
+    /*
+     * Drop stale registrations first, so that a socket that was
+     * moved to another slot by the garbage collector can be added
+     * back under its new slot number below.  The socket may have been
+     * closed already, in which case the kernel has dropped it for us.
+     */
+    for (i = 0; i < pollmgr.epnregs; ++i) {
+        struct pollmgr_epreg *reg = &pollmgr.epreg[i];
+
+        if (reg->fd == INVALID_SOCKET) {
+            continue;
+        }
+
+        if (i >= pollmgr.nfds || reg->dirty || pollmgr.fds[i].fd != reg->fd) {
+            epoll_ctl(pollmgr.epfd, EPOLL_CTL_DEL, reg->fd, NULL);
+            reg->fd = INVALID_SOCKET;
+        }
+    }
+
+    npending = 0;
+    for (i = 0; i < pollmgr.nfds; ++i) {
+        struct pollmgr_epreg *reg = &pollmgr.epreg[i];
+        struct pollfd *pfd = &pollmgr.fds[i];
+
+        pfd->revents = 0;
+        reg->dirty = false;
+
+        if (pfd->fd == INVALID_SOCKET) {
+            continue;
+        }
+
+        if (reg->fd == INVALID_SOCKET || reg->events != pfd->events) {
+            int op = reg->fd == INVALID_SOCKET ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            int status;
+
+            memset(&ev, 0, sizeof(ev));
+            ev.events = (uint32_t)(unsigned short)pfd->events;
+            ev.data.u32 = (uint32_t)i;
+
+            status = epoll_ctl(pollmgr.epfd, op, pfd->fd, &ev);
+            if (status < 0 && op == EPOLL_CTL_ADD && errno == EEXIST) {
+                status = epoll_ctl(pollmgr.epfd, EPOLL_CTL_MOD, pfd->fd, &ev);
+            }
+
+            if (status < 0) {
+                /* what poll(2) would have said about a bad fd */
+                DPRINTF0(("%s: fd %d: epoll_ctl: %R[sockerr]\n",
+                          __func__, pfd->fd, errno));
+                pfd->revents = POLLNVAL;
+                ++npending;
+                continue;
+            }
+
+            reg->fd = pfd->fd;
+            reg->events = pfd->events;
+        }
+    }
+    pollmgr.epnregs = pollmgr.nfds;
+
+    nready = epoll_wait(pollmgr.epfd, pollmgr.epevents, (int)pollmgr.nfds,
+                        npending > 0 ? 0 : -1);
+    if (nready < 0) {
+        return nready;
+    }
+
+    for (j = 0; j < nready; ++j) {
+        const uint32_t slot = pollmgr.epevents[j].data.u32;
+
+        if ((nfds_t)slot < pollmgr.nfds && pollmgr.fds[slot].revents == 0) {
+            pollmgr.fds[slot].revents = (short)pollmgr.epevents[j].events;
+            ++npending;
+        }
+    }
+
+    return npending;
+}
+#endif /* POLLMGR_WITH_EPOLL */
+
+
 /**
  * Create strongly held refptr.
  */
@@ -81,6 +81,7 @@ union sockaddr_inet {
 
 
 struct request;
+struct cache_entry;
 
 
 /**
@@ -111,6 +112,23 @@ struct pxdns {
     size_t late_answers;
     size_t hash_collisions;
 
+    size_t cache_hits;
+    size_t cache_misses;
+    size_t cache_prefetches;
+
+#define CACHE_MAX_ENTRIES 1024
+#define CACHE_MAX_REPLY 4096
+#define CACHE_MAX_TTL (60 * 60)
+#define CACHE_MAX_NEGATIVE_TTL (5 * 60)
+#define CACHE_PREFETCH_HITS 2
+#define CACHE_HASHSIZE 8
+#define CACHE_HASH(h) ((h) & ((1 << CACHE_HASHSIZE) - 1))
+    size_t cache_entries;
+    size_t cache_generation;    /* bumped on flush */
+    struct cache_entry *cache_hash[1 << CACHE_HASHSIZE];
+    struct cache_entry *cache_lru_head; /* most recently used */
+    struct cache_entry *cache_lru_tail; /* least recently used, evicted first */
+
 #define TIMEOUT 5
     size_t timeout_slot;
     u32_t timeout_mask;
@@ -133,6 +151,12 @@ struct request {
      */
     size_t generation;
 
+    /**
+     * pxdns::cache_generation when the request was received, the
+     * reply is not cached if the cache was flushed since.
+     */
+    size_t cache_generation;
+
     /**
      * Current index into pxdns::resolvers
      */
@@ -189,6 +213,53 @@ struct request {
 };
 
 
+/**
+ * Cached reply.  The proxy serves all guests on the NAT network, so
+ * the cache is shared between them.  Entries are keyed by the
+ * question, the client's EDNS parameters and the RD/CD query flags
+ * and carry a complete reply as received from the upstream resolver.  Protected by pxdns::lock
+ * since entries are added on pollmgr thread and looked up on lwIP
+ * thread.
+ */
+struct cache_entry {
+    u32_t hash;
+    u16_t flags;
+
+    /**
+     * sys_now() when the reply was received and its TTL in seconds
+     * (minimum over the records, or the negative caching TTL).
+     */
+    u32_t stored;
+    u32_t ttl;
+
+    /**
+     * Number of times served since stored and whether a refresh is
+     * already in flight.
+     */
+    u32_t hits;
+    int prefetching;
+
+    /**
+     * Chaining for pxdns::cache_hash
+     */
+    struct cache_entry **pprev_hash;
+    struct cache_entry *next_hash;
+
+    /**
+     * Chaining for LRU list pxdns::cache_lru_head/tail
+     */
+    struct cache_entry *prev_lru;
+    struct cache_entry *next_lru;
+
+    /**
+     * Key (see pxdns_cache_key()) followed by the reply.
+     */
+    size_t keylen;
+    size_t size;
+    u8_t data[1];
+};
+
+
 static void pxdns_create_resolver_sockaddrs(struct pxdns *pxdns,
                                             const char **nameservers);
 
@@ -218,6 +289,14 @@ static void pxdns_timeout_del(struct pxdns *pxdns, struct request *req);
 
 static void pxdns_request_free(struct request *req);
 
+static int pxdns_cache_key(const u8_t *msg, size_t size, u8_t *key,
+                           size_t *pkeylen, size_t *pqlen, u16_t *pflags);
+static int pxdns_cache_lookup(struct pxdns *pxdns, const u8_t *query, size_t size,
+                              struct pbuf **preply);
+static void pxdns_cache_insert(struct pxdns *pxdns, struct request *req,
+                               const u8_t *reply, size_t size);
+static void pxdns_cache_flush(struct pxdns *pxdns);
+
 
 err_t
 pxdns_init(struct netif *proxy_netif)
@@ -327,6 +406,9 @@ pxdns_set_nameservers(void *arg)
     g_proxy_options->nameservers = nameservers;
 
     pxdns_create_resolver_sockaddrs(&g_pxdns, nameservers);
+
+    /* answers from the old resolvers may no longer be valid */
+    pxdns_cache_flush(&g_pxdns);
 }
 
 
@@ -625,6 +707,604 @@ pxdns_timer(void *arg)
 }
 
 
+/*
+ * Reply cache.
+ *
+ * Lookups return one of these to pxdns_query().  On PREFETCH the
+ * client has been answered from the cache but the entry is about to
+ * expire, so the query is still relayed to refresh it.
+ */
+#define PXDNS_CACHE_MISS     0
+#define PXDNS_CACHE_HIT      1
+#define PXDNS_CACHE_PREFETCH 2
+
+#define DNS_HDR_LEN 12
+#define DNS_FLAG_QR 0x8000
+#define DNS_FLAG_TC 0x0200
+#define DNS_FLAG_RD 0x0100
+#define DNS_FLAG_CD 0x0010
+#define DNS_OPCODE_MASK 0x7800
+#define DNS_RCODE_MASK 0x000f
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_TYPE_SOA 6
+#define DNS_TYPE_OPT 41
+#define DNS_EDNS_DO 0x8000
+#define DNS_MIN_UDP_PAYLOAD 512
+
+/* question (name, QTYPE, QCLASS) followed by EDNS octet and payload size */
+#define CACHE_KEY_EDNS_LEN 3
+#define CACHE_KEY_MAX (255 + 4 + CACHE_KEY_EDNS_LEN)
+#define CACHE_KEY_EDNS 0x01
+#define CACHE_KEY_EDNS_DO 0x02
+
+#define CACHE_NO_TTL 0xffffffffU
+
+
+static u16_t
+pxdns_get16(const u8_t *p)
+{
+    return (u16_t)((p[0] << 8) | p[1]);
+}
+
+
+static u32_t
+pxdns_get32(const u8_t *p)
+{
+    return ((u32_t)p[0] << 24) | ((u32_t)p[1] << 16)
+         | ((u32_t)p[2] << 8) | (u32_t)p[3];
+}
+
+
+static void
+pxdns_put32(u8_t *p, u32_t v)
+{
+    p[0] = (u8_t)(v >> 24);
+    p[1] = (u8_t)(v >> 16);
+    p[2] = (u8_t)(v >> 8);
+    p[3] = (u8_t)v;
+}
+
+
+/**
+ * Skip (possibly compressed) domain name at msg[off].
+ *
+ * Returns offset past the name or 0 if the name is malformed.
+ */
+static size_t
+pxdns_skip_name(const u8_t *msg, size_t size, size_t off)
+{
+    while (off < size) {
+        u8_t len = msg[off];
+        if ((len & 0xc0) == 0xc0) {
+            return off + 2 <= size ? off + 2 : 0;
+        }
+        if ((len & 0xc0) != 0) {
+            return 0;
+        }
+        if (len == 0) {
+            return off + 1;
+        }
+        off += 1 + len;
+    }
+    return 0;
+}
+
+
+/**
+ * Walk resource records of the reply, subtracting age seconds from
+ * their TTLs if age is not zero.  Reports minimum TTL over all
+ * records (except OPT pseudo-record) and negative caching TTL from
+ * SOA in the authority section (RFC 2308), CACHE_NO_TTL if none.
+ *
+ * Returns 1 on success, 0 if the reply is malformed.
+ */
+static int
+pxdns_walk_rrs(u8_t *msg, size_t size, u32_t age,
+               u32_t *pminttl, u32_t *psoattl)
+{
+    size_t off;
+    unsigned int qdcount, ancount, nscount, nrrs, i;
+    u32_t minttl = CACHE_NO_TTL, soattl = CACHE_NO_TTL;
+
+    if (size < DNS_HDR_LEN) {
+        return 0;
+    }
+
+    qdcount = pxdns_get16(&msg[4]);
+    ancount = pxdns_get16(&msg[6]);
+    nscount = pxdns_get16(&msg[8]);
+    nrrs = ancount + nscount + pxdns_get16(&msg[10]);
+
+    off = DNS_HDR_LEN;
+    for (i = 0; i < qdcount; ++i) {
+        off = pxdns_skip_name(msg, size, off);
+        if (off == 0 || off + 4 > size) {
+            return 0;
+        }
+        off += 4;               /* QTYPE, QCLASS */
+    }
+
+    for (i = 0; i < nrrs; ++i) {
+        u16_t type, rdlen;
+        u32_t ttl;
+
+        off = pxdns_skip_name(msg, size, off);
+        if (off == 0 || off + 10 > size) {
+            return 0;
+        }
+
+        type = pxdns_get16(&msg[off]);
+        ttl = pxdns_get32(&msg[off + 4]);
+        rdlen = pxdns_get16(&msg[off + 8]);
+        if (off + 10 + rdlen > size) {
+            return 0;
+        }
+
+        if (type != DNS_TYPE_OPT) {
+            if (age != 0) {
+                ttl = ttl > age ? ttl - age : 0;
+                pxdns_put32(&msg[off + 4], ttl);
+            }
+            if (ttl < minttl) {
+                minttl = ttl;
+            }
+
+            /* negative TTL is min(SOA TTL, SOA MINIMUM), the last field */
+            if (type == DNS_TYPE_SOA && i >= ancount && i < ancount + nscount
+                && rdlen >= 22)
+            {
+                u32_t soamin = pxdns_get32(&msg[off + 10 + rdlen - 4]);
+                soamin = LWIP_MIN(soamin, ttl);
+                if (soamin < soattl) {
+                    soattl = soamin;
+                }
+            }
+        }
+
+        off += 10 + rdlen;
+    }
+
+    *pminttl = minttl;
+    *psoattl = soattl;
+    return 1;
+}
+
+
+/**
+ * Find OPT pseudo-record (RFC 6891) in the additional section.  The
+ * question ends at msg[off].  Reports the advertised UDP payload size
+ * and the DO bit, or 0 for the size if there's no OPT record.
+ *
+ * Returns 1 on success, 0 if the message is malformed.
+ */
+static int
+pxdns_get_edns(const u8_t *msg, size_t size, size_t off,
+               u16_t *ppayload, int *pdo)
+{
+    unsigned int nrrs, arstart, i;
+
+    *ppayload = 0;
+    *pdo = 0;
+
+    arstart = pxdns_get16(&msg[6]) + pxdns_get16(&msg[8]);
+    nrrs = arstart + pxdns_get16(&msg[10]);
+
+    for (i = 0; i < nrrs; ++i) {
+        u16_t type, rdlen;
+
+        off = pxdns_skip_name(msg, size, off);
+        if (off == 0 || off + 10 > size) {
+            return 0;
+        }
+
+        type = pxdns_get16(&msg[off]);
+        rdlen = pxdns_get16(&msg[off + 8]);
+        if (off + 10 + rdlen > size) {
+            return 0;
+        }
+
+        if (type == DNS_TYPE_OPT && i >= arstart) {
+            u16_t payload = pxdns_get16(&msg[off + 2]); /* CLASS */
+
+            *ppayload = LWIP_MAX(payload, DNS_MIN_UDP_PAYLOAD);
+            *pdo = (pxdns_get16(&msg[off + 6]) & DNS_EDNS_DO) != 0;
+            break;
+        }
+
+        off += 10 + rdlen;
+    }
+
+    return 1;
+}
+
+
+/**
+ * Extract cache key from a query: the single question with the name
+ * lowercased followed by the client's EDNS parameters (presence, DO
+ * bit and UDP payload size, since they decide what the resolver puts
+ * into the reply and how big it may be), and the query flags that
+ * affect the answer.  *pqlen is set to the length of the question
+ * part of the key, which is the same length as the question in the
+ * message.  Only the question part of the key is meaningful for a
+ * reply.
+ *
+ * Returns 1 if the message is cacheable, 0 otherwise.
+ */
+static int
+pxdns_cache_key(const u8_t *msg, size_t size, u8_t *key,
+                size_t *pkeylen, size_t *pqlen, u16_t *pflags)
+{
+    size_t off, qlen, i;
+    u16_t flags, payload;
+    int dnssec_ok;
+
+    if (size < DNS_HDR_LEN) {
+        return 0;
+    }
+
+    flags = pxdns_get16(&msg[2]);
+    if ((flags & DNS_OPCODE_MASK) != 0 || pxdns_get16(&msg[4]) != 1) {
+        return 0;
+    }
+
+    /* names in the question are never compressed */
+    off = DNS_HDR_LEN;
+    while (off < size && msg[off] != 0) {
+        if ((msg[off] & 0xc0) != 0) {
+            return 0;
+        }
+        off += 1 + msg[off];
+    }
+    off += 1 + 4;               /* root label, QTYPE, QCLASS */
+    if (off > size) {
+        return 0;
+    }
+
+    qlen = off - DNS_HDR_LEN;
+    if (qlen > 255 + 4) {
+        return 0;
+    }
+
+    if (!pxdns_get_edns(msg, size, off, &payload, &dnssec_ok)) {
+        return 0;
+    }
+
+    /* length octets are < 64 so they are not affected */
+    for (i = 0; i < qlen; ++i) {
+        u8_t c = msg[DNS_HDR_LEN + i];
+        key[i] = (c >= 'A' && c <= 'Z') ? (u8_t)(c - 'A' + 'a') : c;
+    }
+
+    key[qlen] = (payload != 0 ? CACHE_KEY_EDNS : 0)
+              | (dnssec_ok ? CACHE_KEY_EDNS_DO : 0);
+    key[qlen + 1] = (u8_t)(payload >> 8);
+    key[qlen + 2] = (u8_t)payload;
+
+    *pkeylen = qlen + CACHE_KEY_EDNS_LEN;
+    *pqlen = qlen;
+    *pflags = flags & (DNS_FLAG_RD | DNS_FLAG_CD);
+    return 1;
+}
+
+
+static u32_t
+pxdns_cache_hash(const u8_t *key, size_t keylen, u16_t flags)
+{
+    u32_t h = 2166136261U ^ flags;  /* FNV-1a */
+    size_t i;
+
+    for (i = 0; i < keylen; ++i) {
+        h = (h ^ key[i]) * 16777619U;
+    }
+    return h;
+}
+
+
+static void
+pxdns_cache_lru_unlink(struct pxdns *pxdns, struct cache_entry *ce)
+{
+    if (ce->prev_lru != NULL) {
+        ce->prev_lru->next_lru = ce->next_lru;
+    }
+    else {
+        pxdns->cache_lru_head = ce->next_lru;
+    }
+
+    if (ce->next_lru != NULL) {
+        ce->next_lru->prev_lru = ce->prev_lru;
+    }
+    else {
+        pxdns->cache_lru_tail = ce->prev_lru;
+    }
+
+    ce->prev_lru = NULL;
+    ce->next_lru = NULL;
+}
+
+
+static void
+pxdns_cache_lru_push(struct pxdns *pxdns, struct cache_entry *ce)
+{
+    ce->prev_lru = NULL;
+    if ((ce->next_lru = pxdns->cache_lru_head) != NULL) {
+        ce->next_lru->prev_lru = ce;
+    }
+    else {
+        pxdns->cache_lru_tail = ce;
+    }
+    pxdns->cache_lru_head = ce;
+}
+
+
+/**
+ * Unlink entry from the hash and LRU list and free it.  Called with
+ * pxdns::lock held.
+ */
+static void
+pxdns_cache_remove(struct pxdns *pxdns, struct cache_entry *ce)
+{
+    LWIP_ASSERT1(ce->pprev_hash != NULL);
+
+    if (ce->next_hash != NULL) {
+        ce->next_hash->pprev_hash = ce->pprev_hash;
+    }
+    *ce->pprev_hash = ce->next_hash;
+
+    pxdns_cache_lru_unlink(pxdns, ce);
+    --pxdns->cache_entries;
+    free(ce);
+}
+
+
+/**
+ * Find entry by key.  Called with pxdns::lock held.
+ */
+static struct cache_entry *
+pxdns_cache_find(struct pxdns *pxdns, const u8_t *key, size_t keylen,
+                 u16_t flags, u32_t hash)
+{
+    struct cache_entry *ce;
+
+    for (ce = pxdns->cache_hash[CACHE_HASH(hash)]; ce != NULL; ce = ce->next_hash) {
+        if (ce->hash == hash && ce->flags == flags && ce->keylen == keylen
+            && memcmp(ce->data, key, keylen) == 0)
+        {
+            break;
+        }
+    }
+    return ce;
+}
+
+
+/**
+ * Look up cached reply to the query.  Called on lwIP thread from
+ * pxdns_query().  On a hit *preply is set to a pbuf with the reply
+ * patched with the client's request id and question and TTLs reduced
+ * by the time spent in the cache.  The question is copied since the
+ * reply may come from another client's query that spelled the name
+ * in different case and resolvers that randomize the case (a.k.a.
+ * DNS 0x20) check that the reply matches.
+ */
+static int
+pxdns_cache_lookup(struct pxdns *pxdns, const u8_t *query, size_t size,
+                   struct pbuf **preply)
+{
+    u8_t key[CACHE_KEY_MAX];
+    size_t keylen, qlen, cbreply;
+    u16_t flags;
+    u32_t hash, age, minttl, soattl;
+    struct cache_entry *ce;
+    struct pbuf *reply;
+    int status;
+
+    *preply = NULL;
+    if (!pxdns_cache_key(query, size, key, &keylen, &qlen, &flags)) {
+        return PXDNS_CACHE_MISS;
+    }
+    hash = pxdns_cache_hash(key, keylen, flags);
+
+    sys_mutex_lock(&pxdns->lock);
+
+    ce = pxdns_cache_find(pxdns, key, keylen, flags, hash);
+    if (ce == NULL) {
+        ++pxdns->cache_misses;
+        sys_mutex_unlock(&pxdns->lock);
+        return PXDNS_CACHE_MISS;
+    }
+
+    age = (sys_now() - ce->stored) / 1000;
+    if (age >= ce->ttl) {
+        pxdns_cache_remove(pxdns, ce);
+        ++pxdns->cache_misses;
+        sys_mutex_unlock(&pxdns->lock);
+        return PXDNS_CACHE_MISS;
+    }
+
+    cbreply = ce->size;
+    reply = pbuf_alloc(PBUF_RAW, (u16_t)cbreply, PBUF_RAM);
+    if (reply == NULL) {
+        sys_mutex_unlock(&pxdns->lock);
+        return PXDNS_CACHE_MISS;
+    }
+
+    pbuf_take(reply, &ce->data[ce->keylen], (u16_t)cbreply);
+    ++pxdns->cache_hits;
+    sys_mutex_unlock(&pxdns->lock);
+
+    status = PXDNS_CACHE_HIT;
+
+    /*
+     * pbuf_alloc() of PBUF_RAM is a single contiguous pbuf, so we can
+     * patch in client's request id, question and the aged TTLs
+     * directly.  The cached question only differs in case, so it has
+     * the same length.
+     */
+    memcpy(reply->payload, query, sizeof(u16_t));
+    memcpy((u8_t *)reply->payload + DNS_HDR_LEN, &query[DNS_HDR_LEN], qlen);
+    if (age != 0) {
+        pxdns_walk_rrs((u8_t *)reply->payload, cbreply, age, &minttl, &soattl);
+    }
+
+    /*
+     * Refresh-ahead: requery popular names during the last tenth of
+     * their lifetime so that they don't fall out of the cache.
+     */
+    sys_mutex_lock(&pxdns->lock);
+    ce = pxdns_cache_find(pxdns, key, keylen, flags, hash);
+    if (ce != NULL) {
+        ++ce->hits;
+        if (!ce->prefetching
+            && ce->hits >= CACHE_PREFETCH_HITS
+            && ce->ttl >= 10
+            && ce->ttl - age <= ce->ttl / 10)
+        {
+            ce->prefetching = 1;
+            ++pxdns->cache_prefetches;
+            status = PXDNS_CACHE_PREFETCH;
+        }
+
+        pxdns_cache_lru_unlink(pxdns, ce);
+        pxdns_cache_lru_push(pxdns, ce);
+    }
+    sys_mutex_unlock(&pxdns->lock);
+
+    *preply = reply;
+    return status;
+}
+
+
+/**
+ * Remember the reply to the request if it's cacheable.  Called on
+ * pollmgr thread from pxdns_pmgr_pump() with the reply still
+ * carrying our id.  The key is taken from the request, since the
+ * OPT record of the reply describes the resolver, not the client.
+ * The reply is dropped if the cache was flushed after the request
+ * was received as it may come from a resolver no longer in use.
+ *
+ * Positive answers are cached for the minimum TTL of their records.
+ * NXDOMAIN and NODATA answers are cached for the SOA derived TTL
+ * (RFC 2308) and not at all if there's no SOA.  Truncated replies
+ * and errors are never cached.
+ */
+static void
+pxdns_cache_insert(struct pxdns *pxdns, struct request *req,
+                   const u8_t *reply, size_t size)
+{
+    u8_t key[CACHE_KEY_MAX], rkey[CACHE_KEY_MAX];
+    size_t keylen, qlen, rkeylen, rqlen;
+    u16_t flags, rflags, rcode;
+    u32_t hash, ttl, minttl, soattl;
+    struct cache_entry *ce, *old, **chain;
+
+    if (size > CACHE_MAX_REPLY) {
+        return;
+    }
+
+    if (!pxdns_cache_key(req->data, req->size, key, &keylen, &qlen, &flags)) {
+        return;
+    }
+
+    /* the reply must be for the same question */
+    if (!pxdns_cache_key(reply, size, rkey, &rkeylen, &rqlen, &rflags)
+        || rqlen != qlen || memcmp(rkey, key, qlen) != 0)
+    {
+        return;
+    }
+
+    rflags = pxdns_get16(&reply[2]);
+    rcode = rflags & DNS_RCODE_MASK;
+    if ((rflags & DNS_FLAG_QR) == 0 || (rflags & DNS_FLAG_TC) != 0) {
+        return;
+    }
+    if (rcode != DNS_RCODE_NOERROR && rcode != DNS_RCODE_NXDOMAIN) {
+        return;
+    }
+
+    ce = (struct cache_entry *)malloc(sizeof(*ce) - 1 + keylen + size);
+    if (ce == NULL) {
+        return;
+    }
+    memcpy(ce->data, key, keylen);
+    memcpy(&ce->data[keylen], reply, size);
+
+    if (!pxdns_walk_rrs(&ce->data[keylen], size, 0, &minttl, &soattl)) {
+        free(ce);
+        return;
+    }
+
+    if (rcode == DNS_RCODE_NOERROR && pxdns_get16(&reply[6]) != 0) {
+        ttl = LWIP_MIN(minttl, CACHE_MAX_TTL);
+    }
+    else {
+        ttl = soattl == CACHE_NO_TTL ? 0 : LWIP_MIN(soattl, CACHE_MAX_NEGATIVE_TTL);
+    }
+
+    if (ttl == 0) {
+        free(ce);
+        return;
+    }
+
+    hash = pxdns_cache_hash(key, keylen, flags);
+    ce->hash = hash;
+    ce->flags = flags;
+    ce->stored = sys_now();
+    ce->ttl = ttl;
+    ce->hits = 0;
+    ce->prefetching = 0;
+    ce->keylen = keylen;
+    ce->size = size;
+
+    DPRINTF2(("%s: caching %lu bytes for %lu seconds\n",
+              __func__, (unsigned long)size, (unsigned long)ttl));
+
+    sys_mutex_lock(&pxdns->lock);
+
+    if (req->cache_generation != pxdns->cache_generation) {
+        sys_mutex_unlock(&pxdns->lock);
+        free(ce);
+        return;
+    }
+
+    old = pxdns_cache_find(pxdns, key, keylen, flags, hash);
+    if (old != NULL) {
+        pxdns_cache_remove(pxdns, old);
+    }
+    else if (pxdns->cache_entries >= CACHE_MAX_ENTRIES) {
+        pxdns_cache_remove(pxdns, pxdns->cache_lru_tail);
+    }
+
+    chain = &pxdns->cache_hash[CACHE_HASH(hash)];
+    if ((ce->next_hash = *chain) != NULL) {
+        (*chain)->pprev_hash = &ce->next_hash;
+    }
+    *chain = ce;
+    ce->pprev_hash = chain;
+
+    pxdns_cache_lru_push(pxdns, ce);
+    ++pxdns->cache_entries;
+
+    sys_mutex_unlock(&pxdns->lock);
+}
+
+
+/**
+ * Drop all cached replies.  Called on lwIP thread when the list of
+ * resolvers changes.  Replies to requests still in flight are not
+ * cached when they arrive.
+ */
+static void
+pxdns_cache_flush(struct pxdns *pxdns)
+{
+    sys_mutex_lock(&pxdns->lock);
+    ++pxdns->cache_generation;
+    while (pxdns->cache_lru_head != NULL) {
+        pxdns_cache_remove(pxdns, pxdns->cache_lru_head);
+    }
+    sys_mutex_unlock(&pxdns->lock);
+}
+
+
 static void
 pxdns_recv4(void *arg, struct udp_pcb *pcb, struct pbuf *p,
             ip_addr_t *addr, u16_t port)
@@ -647,6 +1327,9 @@ pxdns_query(struct pxdns *pxdns, struct udp_pcb *pcb, struct pbuf *p,
             ipX_addr_t *addr, u16_t port)
 {
     struct request *req;
+    struct pbuf *reply;
+    err_t error;
+    int cached;
     int sent;
 
     if (pxdns->nresolvers == 0) {
@@ -664,9 +1347,32 @@ pxdns_query(struct pxdns *pxdns, struct udp_pcb *pcb, struct pbuf *p,
     /* copy request data */
     req->size = p->tot_len;
     pbuf_copy_partial(p, req->data, p->tot_len, 0);
+    pbuf_free(p);
+
+    sys_mutex_lock(&pxdns->lock);
+    req->cache_generation = pxdns->cache_generation;
+    sys_mutex_unlock(&pxdns->lock);
+
+    cached = pxdns_cache_lookup(pxdns, req->data, req->size, &reply);
+    if (reply != NULL) {
+        error = udp_sendto(pcb, reply, ipX_2_ip(addr), port);
+        if (error != ERR_OK) {
+            DPRINTF(("%s: udp_sendto err %s\n",
+                     __func__, proxy_lwip_strerr(error)));
+        }
+        pbuf_free(reply);
+    }
+
+    if (cached == PXDNS_CACHE_HIT) {
+        free(req);
+        return;
+    }
 
-    /* save client identity and client's request id */
-    req->pcb = pcb;
+    /*
+     * Save client identity and client's request id.  Refresh of a
+     * cached entry that we have already answered from has no client.
+     */
+    req->pcb = cached == PXDNS_CACHE_PREFETCH ? NULL : pcb;
     ipX_addr_copy(PCB_ISIPV6(pcb), req->client_addr, *addr);
     req->client_port = port;
     memcpy(&req->client_id, req->data, sizeof(req->client_id));
@@ -863,6 +1569,14 @@ pxdns_pmgr_pump(struct pollmgr_handler *handler, SOCKET fd, int revents)
     DPRINTF2(("%s: reply for req=%p: id %d -> client id %d\n",
               __func__, (void *)req, req->id, req->client_id));
 
+    pxdns_cache_insert(pxdns, req, pollmgr_udpbuf, (size_t)nread);
+
+    if (req->pcb == NULL) {
+        /* cache refresh, client was already answered from the cache */
+        pxdns_request_free(req);
+        return POLLIN;
+    }
+
     req->reply = pbuf_alloc(PBUF_RAW, nread, PBUF_RAM);
     if (req->reply == NULL) {
         DPRINTF(("%s: pbuf_alloc(%d) failed\n", __func__, (int)nread));
@@ -57,10 +57,20 @@ RT_NOCRT_BEGINPROC memcmp
  %else
         mov     rcx, rdx
  %endif
+        ; Compare qwords with a plain loop, it is several times faster than
+        ; 'repe cmpsq' which isn't one of the fast string instructions.
         shr     rcx, 3
-        xor     eax, eax
-        repe cmpsq
+        jz      .qwords_done
+.qword_loop:
+        mov     rax, [rdi]
+        cmp     rax, [rsi]
         jne     .not_equal_qword
+        add     rdi, 8
+        add     rsi, 8
+        dec     rcx
+        jnz     .qword_loop
+.qwords_done:
+        xor     eax, eax
 %else
         push    edi
         push    esi
@@ -119,9 +129,8 @@ RT_NOCRT_BEGINPROC memcmp
 ;
 %ifdef RT_ARCH_AMD64
 .not_equal_qword:
+        xor     eax, eax
         mov     ecx, 8
-        sub     rsi, 8
-        sub     rdi, 8
         repe cmpsb
 .not_equal_byte:
         mov     al, [xDI-1]
@@ -299,8 +299,9 @@ typedef struct RTSTRCACHEINT
     uint32_t                cRehashes;
     /** @} */
 
-    /** Critical section protecting the cache structures. */
-    RTCRITSECT              CritSect;
+    /** Read/write critical section protecting the cache structures.
+     * Lookups of existing strings only need shared access. */
+    RTCRITSECTRW            CritSect;
 } RTSTRCACHEINT;
 /** Pointer to a cache instance. */
 typedef RTSTRCACHEINT *PRTSTRCACHEINT;
@@ -340,7 +341,7 @@ RTDECL(int) RTStrCacheCreate(PRTSTRCACHE phStrCache, const char *pszName)
         pThis->papHashTab = (PRTSTRCACHEENTRY*)RTMemAllocZ(sizeof(pThis->papHashTab[0]) * pThis->cHashTab);
         if (pThis->papHashTab)
         {
-            rc = RTCritSectInit(&pThis->CritSect);
+            rc = RTCritSectRwInit(&pThis->CritSect);
             if (RT_SUCCESS(rc))
             {
                 RTListInit(&pThis->BigEntryList);
@@ -378,7 +379,7 @@ RTDECL(int) RTStrCacheDestroy(RTSTRCACHE hStrCache)
      * Invalidate it. Enter the crit sect just to be on the safe side.
      */
     AssertReturn(ASMAtomicCmpXchgU32(&pThis->u32Magic, RTSTRCACHE_MAGIC_DEAD, RTSTRCACHE_MAGIC), VERR_INVALID_HANDLE);
-    RTCritSectEnter(&pThis->CritSect);
+    RTCritSectRwEnterExcl(&pThis->CritSect);
     Assert(pThis->cRefs == 1);
 
     PRTSTRCACHECHUNK pChunk;
@@ -398,8 +399,8 @@ RTDECL(int) RTStrCacheDestroy(RTSTRCACHE hStrCache)
         RTMemFree(pCur);
     }
 
-    RTCritSectLeave(&pThis->CritSect);
-    RTCritSectDelete(&pThis->CritSect);
+    RTCritSectRwLeaveExcl(&pThis->CritSect);
+    RTCritSectRwDelete(&pThis->CritSect);
 
     RTMemFree(pThis);
     return VINF_SUCCESS;
@@ -784,6 +785,11 @@ static PRTSTRCACHEENTRY rtStrCacheAllocFixedEntry(PRTSTRCACHEINT pThis, uint32_t
  *                              is returned (same as what
  *                              rtStrCacheFindEmptyHashTabEntry would return).
  * @param   pcCollisions        Where to return a collision counter.
+ *
+ * @remarks The caller must own the critical section, shared access is
+ *          sufficient.  A reference is added to the returned entry.  Entries
+ *          whose last reference has been dropped are waiting for
+ *          rtStrCacheFreeEntry and are skipped, they must not be revived.
  */
 static PRTSTRCACHEENTRY rtStrCacheLookUp(PRTSTRCACHEINT pThis, uint32_t uHashLen, uint32_t cchString, const char *pchString,
                                          uint32_t *piFreeHashTabEntry, uint32_t *pcCollisions)
@@ -812,18 +818,28 @@ static PRTSTRCACHEENTRY rtStrCacheLookUp(PRTSTRCACHEINT pThis, uint32_t uHashLen
             if (   pEntry->uHash     == (uint16_t)uHashLen
                 && pEntry->cchString == cchStringFirst)
             {
+                bool fMatch;
                 if (pEntry->cchString != RTSTRCACHEENTRY_BIG_LEN)
-                {
-                    if (   !memcmp(pEntry->szString, pchString, cchString)
-                        && pEntry->szString[cchString] == '\0')
-                        return pEntry;
-                }
+                    fMatch = !memcmp(pEntry->szString, pchString, cchString)
+                          && pEntry->szString[cchString] == '\0';
                 else
                 {
                     PRTSTRCACHEBIGENTRY pBigEntry = RT_FROM_MEMBER(pEntry, RTSTRCACHEBIGENTRY, Core);
-                    if (   pBigEntry->cchString == cchString
-                        && !memcmp(pBigEntry->Core.szString, pchString, cchString))
-                        return &pBigEntry->Core;
+                    fMatch = pBigEntry->cchString == cchString
+                          && !memcmp(pBigEntry->Core.szString, pchString, cchString);
+                }
+                if (fMatch)
+                {
+                    /* Retain it, unless it's already on its way out. */
+                    uint32_t cRefs = ASMAtomicReadU32(&pEntry->cRefs);
+                    while (cRefs > 0)
+                    {
+                        if (ASMAtomicCmpXchgExU32(&pEntry->cRefs, cRefs + 1, cRefs, &cRefs))
+                        {
+                            Assert(cRefs < UINT32_MAX / 2);
+                            return pEntry;
+                        }
+                    }
                 }
             }
 
@@ -855,18 +871,23 @@ RTDECL(const char *) RTStrCacheEnterN(RTSTRCACHE hStrCache, const char *pchStrin
     AssertReturn(cchString < _1G, NULL);
     uint32_t const cchString32 = (uint32_t)cchString;
 
-    RTCritSectEnter(&pThis->CritSect);
-    RTSTRCACHE_CHECK(pThis);
-
     uint32_t cCollisions;
     uint32_t iFreeHashTabEntry;
+    RTCritSectRwEnterShared(&pThis->CritSect);
     PRTSTRCACHEENTRY pEntry = rtStrCacheLookUp(pThis, uHashLen, cchString32, pchString, &iFreeHashTabEntry, &cCollisions);
+    RTCritSectRwLeaveShared(&pThis->CritSect);
     if (pEntry)
-    {
-        uint32_t cRefs = ASMAtomicIncU32(&pEntry->cRefs);
-        Assert(cRefs < UINT32_MAX / 2); NOREF(cRefs);
-    }
-    else
+        return pEntry->szString;
+
+    /*
+     * Not found, so take the exclusive lock and check again since another
+     * thread may have entered the string in the meantime.
+     */
+    RTCritSectRwEnterExcl(&pThis->CritSect);
+    RTSTRCACHE_CHECK(pThis);
+
+    pEntry = rtStrCacheLookUp(pThis, uHashLen, cchString32, pchString, &iFreeHashTabEntry, &cCollisions);
+    if (!pEntry)
     {
         /*
          * Allocate a new entry.
@@ -884,7 +905,7 @@ RTDECL(const char *) RTStrCacheEnterN(RTSTRCACHE hStrCache, const char *pchStrin
         if (!pEntry)
         {
             RTSTRCACHE_CHECK(pThis);
-            RTCritSectLeave(&pThis->CritSect);
+            RTCritSectRwLeaveExcl(&pThis->CritSect);
             return NULL;
         }
 
@@ -907,7 +928,7 @@ RTDECL(const char *) RTStrCacheEnterN(RTSTRCACHE hStrCache, const char *pchStrin
                 RTStrCacheRelease(hStrCache, pEntry->szString);
 
                 RTSTRCACHE_CHECK(pThis);
-                RTCritSectLeave(&pThis->CritSect);
+                RTCritSectRwLeaveExcl(&pThis->CritSect);
                 return NULL;
             }
         }
@@ -922,7 +943,7 @@ RTDECL(const char *) RTStrCacheEnterN(RTSTRCACHE hStrCache, const char *pchStrin
     }
 
     RTSTRCACHE_CHECK(pThis);
-    RTCritSectLeave(&pThis->CritSect);
+    RTCritSectRwLeaveExcl(&pThis->CritSect);
     return pEntry->szString;
 }
 RT_EXPORT_SYMBOL(RTStrCacheEnterN);
@@ -1002,7 +1023,7 @@ RT_EXPORT_SYMBOL(RTStrCacheRetain);
 
 static uint32_t rtStrCacheFreeEntry(PRTSTRCACHEINT pThis, PRTSTRCACHEENTRY pStr)
 {
-    RTCritSectEnter(&pThis->CritSect);
+    RTCritSectRwEnterExcl(&pThis->CritSect);
     RTSTRCACHE_CHECK(pThis);
 
     /* Remove it from the hash table. */
@@ -1138,7 +1159,7 @@ static uint32_t rtStrCacheFreeEntry(PRTSTRCACHEINT pThis, PRTSTRCACHEENTRY pStr)
         }
 #endif /* RTSTRCACHE_WITH_MERGED_ALLOCATOR */
         RTSTRCACHE_CHECK(pThis);
-        RTCritSectLeave(&pThis->CritSect);
+        RTCritSectRwLeaveExcl(&pThis->CritSect);
     }
     else
     {
@@ -1149,7 +1170,7 @@ static uint32_t rtStrCacheFreeEntry(PRTSTRCACHEINT pThis, PRTSTRCACHEENTRY pStr)
                                            RTSTRCACHE_HEAP_ENTRY_SIZE_ALIGN);
 
         RTSTRCACHE_CHECK(pThis);
-        RTCritSectLeave(&pThis->CritSect);
+        RTCritSectRwLeaveExcl(&pThis->CritSect);
 
         RTMemFree(pBigStr);
     }
@@ -1214,7 +1235,7 @@ RTDECL(uint32_t) RTStrCacheGetStats(RTSTRCACHE hStrCache, size_t *pcbStrings, si
     PRTSTRCACHEINT pThis = hStrCache;
     RTSTRCACHE_VALID_RETURN_RC(pThis, UINT32_MAX);
 
-    RTCritSectEnter(&pThis->CritSect);
+    RTCritSectRwEnterShared(&pThis->CritSect);
 
     if (pcbStrings)
         *pcbStrings         = pThis->cbStrings;
@@ -1232,7 +1253,7 @@ RTDECL(uint32_t) RTStrCacheGetStats(RTSTRCACHE hStrCache, size_t *pcbStrings, si
         *pcRehashes         = pThis->cRehashes;
     uint32_t cStrings       = pThis->cStrings;
 
-    RTCritSectLeave(&pThis->CritSect);
+    RTCritSectRwLeaveShared(&pThis->CritSect);
     return cStrings;
 }
 RT_EXPORT_SYMBOL(RTStrCacheRelease);
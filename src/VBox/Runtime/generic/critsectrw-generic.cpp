@@ -257,13 +257,19 @@ static int rtCritSectRwEnterShared(PRTCRITSECTRW pThis, PCRTLOCKVALSRCPOS pSrcPo
             Assert(c < RTCSRW_CNT_MASK / 2);
             u64State &= ~RTCSRW_CNT_RD_MASK;
             u64State |= c << RTCSRW_CNT_RD_SHIFT;
-            if (ASMAtomicCmpXchgU64(&pThis->u.s.u64State, u64State, u64OldState))
+            if (ASMAtomicCmpXchgExU64(&pThis->u.s.u64State, u64State, u64OldState, &u64OldState))
             {
 #ifdef RTCRITSECTRW_STRICT
                 RTLockValidatorRecSharedAddOwner(pThis->pValidatorRead, hThreadSelf, pSrcPos);
 #endif
                 break;
             }
+
+            /* Most likely another reader got in first.  Retry right away with the
+               state we got back instead of pausing and re-reading the cache line. */
+            u64State = u64OldState;
+            if ((u64State & RTCSRW_DIR_MASK) == (RTCSRW_DIR_READ << RTCSRW_DIR_SHIFT))
+                continue;
         }
         else if ((u64State & (RTCSRW_CNT_RD_MASK | RTCSRW_CNT_WR_MASK)) == 0)
         {
@@ -507,8 +513,13 @@ RTDECL(int) RTCritSectRwLeaveShared(PRTCRITSECTRW pThis)
                 /* Don't change the direction. */
                 u64State &= ~RTCSRW_CNT_RD_MASK;
                 u64State |= c << RTCSRW_CNT_RD_SHIFT;
-                if (ASMAtomicCmpXchgU64(&pThis->u.s.u64State, u64State, u64OldState))
+                if (ASMAtomicCmpXchgExU64(&pThis->u.s.u64State, u64State, u64OldState, &u64OldState))
                     break;
+
+                /* Raced another reader, retry immediately with the state we got back. */
+                u64State = u64OldState;
+                if ((u64State & RTCSRW_DIR_MASK) == (RTCSRW_DIR_READ << RTCSRW_DIR_SHIFT))
+                    continue;
             }
             else
             {
@@ -2974,6 +2974,15 @@ static int rtHttpApplySettings(PRTHTTPINTERNAL pThis, const char *pszUrl)
             return VERR_HTTP_CURL_ERROR;
     }
 
+    /*
+     * Enable TCP keep-alive probing so idle connections kept in the instance's
+     * connection cache survive NAT and firewall timeouts, letting subsequent
+     * requests skip the TCP and TLS handshakes.  Best effort.
+     */
+#if LIBCURL_VERSION_NUM >= 0x071900 /* 7.25.0 */
+    curl_easy_setopt(pThis->pCurl, CURLOPT_TCP_KEEPALIVE, 1L);
+#endif
+
     /*
      * Progress/abort.
      */
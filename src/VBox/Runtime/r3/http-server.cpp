@@ -736,7 +736,9 @@ static DECLCALLBACK(int) rtHttpServerHandleGET(PRTHTTPSERVERCLIENT pClient, PRTH
     if (RT_SUCCESS(rc)) /* Only call open if querying information above succeeded. */
         RTHTTPSERVER_HANDLE_CALLBACK_VA(pfnOpen, pReq, &pvHandle);
 
-    size_t cbBuf = _64K;
+    /* Size the body buffer according to the object, between 64K and 1M, as
+       each pfnRead call might be an expensive round trip for the provider. */
+    size_t const cbBuf = RT_MAX(RT_MIN(RT_ALIGN_Z((size_t)fsObj.cbObject, _64K), _1M), _64K);
     void  *pvBuf = RTMemAlloc(cbBuf);
     AssertPtrReturn(pvBuf, VERR_NO_MEMORY);
 
@@ -154,8 +154,8 @@ RTDECL(int) RTFileCopyPartEx(RTFILE hFileSrc, RTFOFF offSrc, RTFILE hFileDst, RT
     do
     {
         size_t  cbThisCopy = (size_t)RT_MIN(cbToCopy - cbCopied, _1G);
-        loff_t  offThisDst = offSrc + cbCopied;
-        loff_t  offThisSrc = offDst + cbCopied;
+        loff_t  offThisSrc = offSrc + cbCopied;
+        loff_t  offThisDst = offDst + cbCopied;
         ssize_t cbActual   = MyCopyFileRangeSysCall((int)RTFileToNative(hFileSrc), &offThisSrc,
                                                     (int)RTFileToNative(hFileDst), &offThisDst,
                                                     cbThisCopy, 0);
@@ -164,10 +164,14 @@ RTDECL(int) RTFileCopyPartEx(RTFILE hFileSrc, RTFOFF offSrc, RTFILE hFileDst, RT
             rc = errno;
             Assert(rc != 0);
             rc = rc != 0 ? RTErrConvertFromErrno(rc) : VERR_READ_ERROR;
-            if (rc != VERR_NOT_SAME_DEVICE || cbCopied != 0)
+            if (   (   rc != VERR_NOT_SAME_DEVICE
+                    && rc != VERR_NOT_SUPPORTED
+                    && rc != VERR_NET_OPERATION_NOT_SUPPORTED /* EOPNOTSUPP */)
+                || cbCopied != 0)
                 break;
 
-            /* Fall back to generic implementation if the syscall refuses to handle the case. */
+            /* Fall back to generic implementation if the syscall refuses to handle the case
+               (crossing file systems, or a file system which doesn't implement it). */
             rc = rtFileCopyPartPrepFallback(pBufState, cbToCopy);
             if (RT_SUCCESS(rc))
                 return rtFileCopyPartExFallback(hFileSrc, offSrc, hFileDst, offDst, cbToCopy, fFlags, pBufState, pcbCopied);
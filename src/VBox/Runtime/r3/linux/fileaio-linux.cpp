@@ -50,6 +50,18 @@
  * compensated if the user of this API implements caching itself. The next
  * limitation is that data buffers must be aligned at a 512 byte boundary or the
  * request will fail.
+ *
+ * If the host kernel supports io_uring (5.1+) a context is created on top of an
+ * I/O ring instead.  Requests are placed into the shared submission queue and a
+ * whole batch is handed to the kernel with a single io_uring_enter() call,
+ * completions are reaped directly from the shared completion queue without any
+ * syscall.  Files associated with the context through
+ * RTFileAioCtxAssociateWithFile() are registered as fixed files with the ring,
+ * saving the file table lookup and reference counting for every request, and
+ * RTFileAioCtxDisassociateFromFile() clears the slot again before the file is
+ * closed.  An eventfd registered with the ring is used to wait for completions and to kick
+ * the waiter out of RTFileAioCtxWait().  Setting the IPRT_FILEAIO_NO_IOURING
+ * environment variable forces the old io_* interface.
  */
 /** @todo r=bird: What's this about "must be opened with O_DIRECT"? An
  *        explanation would be nice, esp. seeing what Linus is quoted saying
@@ -66,11 +78,16 @@
 #include <iprt/string.h>
 #include <iprt/err.h>
 #include <iprt/log.h>
+#include <iprt/critsect.h>
+#include <iprt/env.h>
 #include <iprt/thread.h>
 #include "internal/fileaio.h"
 
 #include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
+#include <sys/uio.h>
 #include <errno.h>
 
 #include <iprt/file.h>
@@ -79,6 +96,9 @@
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
+/** Number of fixed file slots registered with an io_uring based context. */
+#define RTFILEAIO_LNX_IOURING_FIXED_FILES   64
+
 /** The async I/O context handle */
 typedef unsigned long LNXKAIOCONTEXT;
 
@@ -177,6 +197,162 @@ typedef struct LNXKAIOIOEVENT
 } LNXKAIOIOEVENT, *PLNXKAIOIOEVENT;
 
 
+/**
+ * Linux io_uring completion event.
+ */
+typedef struct LNXIOURINGCQE
+{
+    /** Opaque user data associated with the completed request. */
+    uint64_t            u64User;
+    /** The status code of the request. */
+    int32_t             rcLnx;
+    /** Some flags which are not used as of now. */
+    uint32_t            fFlags;
+} LNXIOURINGCQE;
+AssertCompileSize(LNXIOURINGCQE, 16);
+
+/**
+ * Linux io_uring submission queue entry.
+ */
+typedef struct LNXIOURINGSQE
+{
+    /** The opcode for the request. */
+    uint8_t             u8Opc;
+    /** Common flags for the request. */
+    uint8_t             u8Flags;
+    /** Assigned I/O priority. */
+    uint16_t            u16IoPrio;
+    /** The file descriptor or fixed file index the request is for. */
+    int32_t             i32Fd;
+    /** The start offset into the file for the request. */
+    uint64_t            u64OffStart;
+    /** Pointer to the io vector array. */
+    uint64_t            u64AddrBufIoVec;
+    /** Number of io vectors. */
+    uint32_t            u32BufIoVecSz;
+    /** Opcode dependent flags. */
+    uint32_t            u32OpcFlags;
+    /** Opaque user data associated with the request and returned during completion. */
+    uint64_t            u64User;
+    /** Padding to align the structure to 64 bytes. */
+    uint64_t            au64Padding[3];
+} LNXIOURINGSQE;
+AssertCompileSize(LNXIOURINGSQE, 64);
+
+/**
+ * Linux io_uring SQ ring offsets returned by io_uring_setup().
+ */
+typedef struct LNXIOURINGSQOFFS
+{
+    uint32_t            u32OffHead;
+    uint32_t            u32OffTail;
+    uint32_t            u32OffRingMask;
+    uint32_t            u32OffRingEntries;
+    uint32_t            u32OffFlags;
+    uint32_t            u32OffDroppedReqs;
+    uint32_t            u32OffArray;
+    uint32_t            u32Rsvd0;
+    uint64_t            u64Rsvd1;
+} LNXIOURINGSQOFFS;
+AssertCompileSize(LNXIOURINGSQOFFS, 40);
+
+/**
+ * Linux io_uring CQ ring offsets returned by io_uring_setup().
+ */
+typedef struct LNXIOURINGCQOFFS
+{
+    uint32_t            u32OffHead;
+    uint32_t            u32OffTail;
+    uint32_t            u32OffRingMask;
+    uint32_t            u32OffRingEntries;
+    uint32_t            u32OffOverflowCnt;
+    uint32_t            u32OffCqes;
+    uint64_t            au64Rsvd0[2];
+} LNXIOURINGCQOFFS;
+AssertCompileSize(LNXIOURINGCQOFFS, 40);
+
+/**
+ * Linux io_uring parameters passed to io_uring_setup().
+ */
+typedef struct LNXIOURINGPARAMS
+{
+    uint32_t            u32SqEntriesCnt;
+    uint32_t            u32CqEntriesCnt;
+    uint32_t            u32Flags;
+    uint32_t            u32SqPollCpu;
+    uint32_t            u32SqPollIdleMs;
+    uint32_t            au32Rsvd0[5];
+    LNXIOURINGSQOFFS    SqOffsets;
+    LNXIOURINGCQOFFS    CqOffsets;
+} LNXIOURINGPARAMS;
+
+/**
+ * Argument for the LNX_IOURING_REGISTER_OPC_FILES_UPDATE operation.
+ */
+typedef struct LNXIOURINGFILESUPDATE
+{
+    /** The first fixed file slot to update. */
+    uint32_t            offStart;
+    /** Reserved. */
+    uint32_t            u32Rsvd0;
+    /** Pointer to the array of file descriptors. */
+    uint64_t            u64PtrFds;
+} LNXIOURINGFILESUPDATE;
+AssertCompileSize(LNXIOURINGFILESUPDATE, 16);
+
+/**
+ * The io_uring related state of an async I/O context.
+ *
+ * @note Some members of this structure point to memory shared with the kernel,
+ *       hence the volatile keyword.
+ */
+typedef struct RTFILEAIOCTXIOURING
+{
+    /** The io_uring file descriptor. */
+    int                 iFdIoCtx;
+    /** The eventfd registered with the ring for completion notifications. */
+    int                 iFdEvt;
+    /** Pointer to the SQ head counter. */
+    volatile uint32_t  *pidxSqHead;
+    /** Pointer to the SQ tail counter. */
+    volatile uint32_t  *pidxSqTail;
+    /** The SQ ring mask. */
+    uint32_t            fSqRingMask;
+    /** Number of SQ entries. */
+    uint32_t            cSqEntries;
+    /** Pointer to the SQ indirection array. */
+    volatile uint32_t  *paidxSqes;
+    /** Pointer to the SQ entries. */
+    LNXIOURINGSQE      *paSqes;
+    /** Pointer to the CQ head counter. */
+    volatile uint32_t  *pidxCqHead;
+    /** Pointer to the CQ tail counter. */
+    volatile uint32_t  *pidxCqTail;
+    /** The CQ ring mask. */
+    uint32_t            fCqRingMask;
+    /** Pointer to the CQ entries. */
+    volatile LNXIOURINGCQE *paCqes;
+    /** The mappings for unmapping on destruction. */
+    void               *pvMMapSqRing;
+    void               *pvMMapCqRing;
+    void               *pvMMapSqes;
+    size_t              cbMMapSqRing;
+    size_t              cbMMapCqRing;
+    size_t              cbMMapSqes;
+    /** Serializes access to the submission queue. */
+    RTCRITSECT          CritSectSq;
+    /** Number of fixed file slots in use or freed again (high water mark), 0 if
+     * fixed files are not supported. */
+    uint32_t            cFdsFixed;
+    /** Flag whether fixed files are supported by the ring. */
+    bool                fFixedFiles;
+    /** The file descriptors registered as fixed files, -1 for an unused slot. */
+    int                 aFdsFixed[RTFILEAIO_LNX_IOURING_FIXED_FILES];
+} RTFILEAIOCTXIOURING;
+/** Pointer to the io_uring state of a context. */
+typedef RTFILEAIOCTXIOURING *PRTFILEAIOCTXIOURING;
+
+
 /**
  * Async I/O completion context state.
  */
@@ -184,6 +360,8 @@ typedef struct RTFILEAIOCTXINTERNAL
 {
     /** Handle to the async I/O context. */
     LNXKAIOCONTEXT      AioContext;
+    /** The io_uring state if the context uses an I/O ring, NULL for the io_* interface. */
+    PRTFILEAIOCTXIOURING pIoURing;
     /** Maximum number of requests this context can handle. */
     int                 cRequestsMax;
     /** Current number of requests active on this context. */
@@ -220,6 +398,8 @@ typedef struct RTFILEAIOREQINTERNAL
     size_t                cbTransfered;
     /** Completion context we are assigned to. */
     PRTFILEAIOCTXINTERNAL pCtxInt;
+    /** The I/O vector for io_uring based contexts, must stay valid until completion. */
+    struct iovec          IoVec;
     /** Magic value  (RTFILEAIOREQ_MAGIC). */
     uint32_t              u32Magic;
 } RTFILEAIOREQINTERNAL;
@@ -233,6 +413,41 @@ typedef RTFILEAIOREQINTERNAL *PRTFILEAIOREQINTERNAL;
 /** The max number of events to get in one call. */
 #define AIO_MAXIMUM_REQUESTS_PER_CONTEXT 64
 
+/** The syscall number of io_uring_setup(). */
+#define LNX_IOURING_SYSCALL_SETUP     425
+/** The syscall number of io_uring_enter(). */
+#define LNX_IOURING_SYSCALL_ENTER     426
+/** The syscall number of io_uring_register(). */
+#define LNX_IOURING_SYSCALL_REGISTER  427
+
+/** @name io_uring opcodes used.
+ * @{ */
+#define LNX_IOURING_OPC_READV           1
+#define LNX_IOURING_OPC_WRITEV          2
+#define LNX_IOURING_OPC_FSYNC           3
+/** @} */
+
+/** The file descriptor is a fixed file index (LNXIOURINGSQE::u8Flags). */
+#define LNX_IOURING_SQE_F_FIXED_FILE    RT_BIT(0)
+/** Retrieve completion events (io_uring_enter() flags). */
+#define LNX_IOURING_ENTER_F_GETEVENTS   RT_BIT_32(0)
+
+/** @name io_uring_register() opcodes used.
+ * @{ */
+#define LNX_IOURING_REGISTER_OPC_FILES_REGISTER     2
+#define LNX_IOURING_REGISTER_OPC_FILES_UNREGISTER   3
+#define LNX_IOURING_REGISTER_OPC_EVENTFD_REGISTER   4
+#define LNX_IOURING_REGISTER_OPC_EVENTFD_UNREGISTER 5
+#define LNX_IOURING_REGISTER_OPC_FILES_UPDATE       6
+/** @} */
+
+/** @name Magic mmap offsets to map submission and completion queues.
+ * @{ */
+#define LNX_IOURING_MMAP_OFF_SQ         UINT64_C(0)
+#define LNX_IOURING_MMAP_OFF_CQ         UINT64_C(0x8000000)
+#define LNX_IOURING_MMAP_OFF_SQES       UINT64_C(0x10000000)
+/** @} */
+
 
 /**
  * Creates a new async I/O context.
@@ -303,6 +518,319 @@ DECLINLINE(int) rtFileAsyncIoLinuxGetEvents(LNXKAIOCONTEXT AioContext, long cReq
     return rc;
 }
 
+/**
+ * mmap() wrapper for the I/O ring regions.
+ */
+DECLINLINE(int) rtFileAioLnxIoURingMmap(int iFdIoCtx, off_t offMmap, size_t cbMmap, void **ppv)
+{
+    void *pv = mmap(0, cbMmap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iFdIoCtx, offMmap);
+    if (pv != MAP_FAILED)
+    {
+        *ppv = pv;
+        return VINF_SUCCESS;
+    }
+
+    return RTErrConvertFromErrno(errno);
+}
+
+/**
+ * io_uring_register() wrapper.
+ */
+DECLINLINE(int) rtFileAioLnxIoURingRegister(int iFdIoCtx, uint32_t uOpc, void *pvArg, uint32_t cArgs)
+{
+    int rcLnx = syscall(LNX_IOURING_SYSCALL_REGISTER, iFdIoCtx, uOpc, pvArg, cArgs);
+    if (RT_UNLIKELY(rcLnx == -1))
+        return RTErrConvertFromErrno(errno);
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * io_uring_enter() wrapper.
+ *
+ * @returns Number of consumed submission entries (natural number w/ 0), IPRT error code (negative).
+ */
+DECLINLINE(int) rtFileAioLnxIoURingEnter(int iFdIoCtx, uint32_t cToSubmit, uint32_t cMinComplete, uint32_t fFlags)
+{
+    int rcLnx = syscall(LNX_IOURING_SYSCALL_ENTER, iFdIoCtx, cToSubmit, cMinComplete, fFlags, NULL, 0);
+    if (RT_UNLIKELY(rcLnx == -1))
+        return RTErrConvertFromErrno(errno);
+
+    return rcLnx;
+}
+
+/**
+ * Destroys the io_uring state of a context.
+ *
+ * @param   pIoURing    The io_uring state to destroy, can be partially initialized.
+ */
+static void rtFileAioLnxIoURingDestroy(PRTFILEAIOCTXIOURING pIoURing)
+{
+    if (pIoURing->pvMMapSqes)
+        munmap(pIoURing->pvMMapSqes, pIoURing->cbMMapSqes);
+    if (pIoURing->pvMMapCqRing)
+        munmap(pIoURing->pvMMapCqRing, pIoURing->cbMMapCqRing);
+    if (pIoURing->pvMMapSqRing)
+        munmap(pIoURing->pvMMapSqRing, pIoURing->cbMMapSqRing);
+    if (RTCritSectIsInitialized(&pIoURing->CritSectSq))
+        RTCritSectDelete(&pIoURing->CritSectSq);
+    /* Closing the ring drops the registered files and the eventfd too. */
+    if (pIoURing->iFdIoCtx != -1)
+        close(pIoURing->iFdIoCtx);
+    if (pIoURing->iFdEvt != -1)
+        close(pIoURing->iFdEvt);
+    RTMemFree(pIoURing);
+}
+
+/**
+ * Tries to create an io_uring for the given context.
+ *
+ * @returns IPRT status code.
+ * @param   cEntries    Number of submission queue entries required.
+ * @param   ppIoURing   Where to store the io_uring state on success.
+ */
+static int rtFileAioLnxIoURingCreate(uint32_t cEntries, PRTFILEAIOCTXIOURING *ppIoURing)
+{
+    if (RTEnvExist("IPRT_FILEAIO_NO_IOURING"))
+        return VERR_NOT_SUPPORTED;
+
+    PRTFILEAIOCTXIOURING pIoURing = (PRTFILEAIOCTXIOURING)RTMemAllocZ(sizeof(*pIoURing));
+    if (RT_UNLIKELY(!pIoURing))
+        return VERR_NO_MEMORY;
+
+    pIoURing->iFdEvt = -1;
+
+    LNXIOURINGPARAMS Params;
+    RT_ZERO(Params);
+    int rc = VINF_SUCCESS;
+    int rcLnx = syscall(LNX_IOURING_SYSCALL_SETUP, RT_MAX(cEntries, 1), &Params);
+    if (rcLnx != -1)
+    {
+        pIoURing->iFdIoCtx = rcLnx;
+
+        pIoURing->cbMMapSqRing = Params.SqOffsets.u32OffArray + Params.u32SqEntriesCnt * sizeof(uint32_t);
+        pIoURing->cbMMapCqRing = Params.CqOffsets.u32OffCqes + Params.u32CqEntriesCnt * sizeof(LNXIOURINGCQE);
+        pIoURing->cbMMapSqes   = Params.u32SqEntriesCnt * sizeof(LNXIOURINGSQE);
+
+        rc = rtFileAioLnxIoURingMmap(pIoURing->iFdIoCtx, LNX_IOURING_MMAP_OFF_SQ,
+                                     pIoURing->cbMMapSqRing, &pIoURing->pvMMapSqRing);
+        if (RT_SUCCESS(rc))
+            rc = rtFileAioLnxIoURingMmap(pIoURing->iFdIoCtx, LNX_IOURING_MMAP_OFF_CQ,
+                                         pIoURing->cbMMapCqRing, &pIoURing->pvMMapCqRing);
+        if (RT_SUCCESS(rc))
+            rc = rtFileAioLnxIoURingMmap(pIoURing->iFdIoCtx, LNX_IOURING_MMAP_OFF_SQES,
+                                         pIoURing->cbMMapSqes, &pIoURing->pvMMapSqes);
+        if (RT_SUCCESS(rc))
+        {
+            rcLnx = syscall(__NR_eventfd2, 0 /*uValInit*/, 0 /*fFlags*/);
+            if (rcLnx != -1)
+            {
+                pIoURing->iFdEvt = rcLnx;
+                rc = rtFileAioLnxIoURingRegister(pIoURing->iFdIoCtx, LNX_IOURING_REGISTER_OPC_EVENTFD_REGISTER,
+                                                 &pIoURing->iFdEvt, 1 /*cArgs*/);
+            }
+            else
+                rc = RTErrConvertFromErrno(errno);
+        }
+        if (RT_SUCCESS(rc))
+            rc = RTCritSectInit(&pIoURing->CritSectSq);
+        if (RT_SUCCESS(rc))
+        {
+            uint8_t *pbTmp = (uint8_t *)pIoURing->pvMMapSqRing;
+            pIoURing->pidxSqHead  = (volatile uint32_t *)(pbTmp + Params.SqOffsets.u32OffHead);
+            pIoURing->pidxSqTail  = (volatile uint32_t *)(pbTmp + Params.SqOffsets.u32OffTail);
+            pIoURing->fSqRingMask = *(uint32_t *)(pbTmp + Params.SqOffsets.u32OffRingMask);
+            pIoURing->cSqEntries  = *(uint32_t *)(pbTmp + Params.SqOffsets.u32OffRingEntries);
+            pIoURing->paidxSqes   = (volatile uint32_t *)(pbTmp + Params.SqOffsets.u32OffArray);
+            pIoURing->paSqes      = (LNXIOURINGSQE *)pIoURing->pvMMapSqes;
+
+            pbTmp = (uint8_t *)pIoURing->pvMMapCqRing;
+            pIoURing->pidxCqHead  = (volatile uint32_t *)(pbTmp + Params.CqOffsets.u32OffHead);
+            pIoURing->pidxCqTail  = (volatile uint32_t *)(pbTmp + Params.CqOffsets.u32OffTail);
+            pIoURing->fCqRingMask = *(uint32_t *)(pbTmp + Params.CqOffsets.u32OffRingMask);
+            pIoURing->paCqes      = (volatile LNXIOURINGCQE *)(pbTmp + Params.CqOffsets.u32OffCqes);
+
+            /*
+             * Register a sparse fixed file table, failing is not fatal and
+             * just means we have to use ordinary file descriptors.
+             */
+            for (unsigned i = 0; i < RT_ELEMENTS(pIoURing->aFdsFixed); i++)
+                pIoURing->aFdsFixed[i] = -1;
+            int rc2 = rtFileAioLnxIoURingRegister(pIoURing->iFdIoCtx, LNX_IOURING_REGISTER_OPC_FILES_REGISTER,
+                                                  &pIoURing->aFdsFixed[0], RT_ELEMENTS(pIoURing->aFdsFixed));
+            pIoURing->fFixedFiles = RT_SUCCESS(rc2);
+
+            *ppIoURing = pIoURing;
+            return VINF_SUCCESS;
+        }
+    }
+    else
+    {
+        rc = RTErrConvertFromErrno(errno);
+        pIoURing->iFdIoCtx = -1;
+    }
+
+    rtFileAioLnxIoURingDestroy(pIoURing);
+    return rc;
+}
+
+/**
+ * Returns the fixed file slot for the given file descriptor.
+ *
+ * @returns Slot index or -1 if the file descriptor is not registered.
+ * @param   pIoURing    The io_uring state.
+ * @param   iFd         The file descriptor to look up.
+ */
+DECLINLINE(int32_t) rtFileAioLnxIoURingFixedFileLookup(PRTFILEAIOCTXIOURING pIoURing, int iFd)
+{
+    for (uint32_t i = 0; i < pIoURing->cFdsFixed; i++)
+        if (pIoURing->aFdsFixed[i] == iFd)
+            return (int32_t)i;
+    return -1;
+}
+
+/**
+ * Submits the given requests to the I/O ring.
+ *
+ * @returns IPRT status code.
+ * @param   pCtxInt     The context.
+ * @param   pahReqs     The requests to submit, validated and in the submitted state.
+ * @param   cReqs       Number of requests.
+ * @param   pcSubmitted Where to store the number of requests the kernel accepted.
+ */
+static int rtFileAioLnxIoURingSubmit(PRTFILEAIOCTXINTERNAL pCtxInt, PRTFILEAIOREQ pahReqs, size_t cReqs,
+                                     uint32_t *pcSubmitted)
+{
+    PRTFILEAIOCTXIOURING pIoURing = pCtxInt->pIoURing;
+
+    RTCritSectEnter(&pIoURing->CritSectSq);
+
+    uint32_t idxSqHead  = ASMAtomicReadU32(pIoURing->pidxSqHead);
+    uint32_t idxSqStart = *pIoURing->pidxSqTail;
+    uint32_t idxSqTail  = idxSqStart;
+    uint32_t cSqFree   = pIoURing->cSqEntries - (idxSqTail - idxSqHead);
+    uint32_t cToSubmit = (uint32_t)RT_MIN(cReqs, cSqFree);
+
+    for (uint32_t i = 0; i < cToSubmit; i++)
+    {
+        PRTFILEAIOREQINTERNAL pReqInt = pahReqs[i];
+        uint32_t       idxSqe = idxSqTail & pIoURing->fSqRingMask;
+        LNXIOURINGSQE *pSqe   = &pIoURing->paSqes[idxSqe];
+
+        RT_ZERO(*pSqe);
+        switch (pReqInt->AioCB.u16IoOpCode)
+        {
+            case LNXKAIO_IOCB_CMD_READ:
+                pSqe->u8Opc = LNX_IOURING_OPC_READV;
+                break;
+            case LNXKAIO_IOCB_CMD_WRITE:
+                pSqe->u8Opc = LNX_IOURING_OPC_WRITEV;
+                break;
+            case LNXKAIO_IOCB_CMD_FSYNC:
+                pSqe->u8Opc = LNX_IOURING_OPC_FSYNC;
+                break;
+            default:
+                AssertFailed();
+        }
+
+        int32_t idxFixed = rtFileAioLnxIoURingFixedFileLookup(pIoURing, (int)pReqInt->AioCB.uFileDesc);
+        if (idxFixed != -1)
+        {
+            pSqe->u8Flags = LNX_IOURING_SQE_F_FIXED_FILE;
+            pSqe->i32Fd   = idxFixed;
+        }
+        else
+            pSqe->i32Fd   = (int32_t)pReqInt->AioCB.uFileDesc;
+
+        if (pSqe->u8Opc != LNX_IOURING_OPC_FSYNC)
+        {
+            pReqInt->IoVec.iov_base = pReqInt->AioCB.pvBuf;
+            pReqInt->IoVec.iov_len  = pReqInt->AioCB.cbTransfer;
+            pSqe->u64OffStart       = (uint64_t)pReqInt->AioCB.off;
+            pSqe->u64AddrBufIoVec   = (uint64_t)(uintptr_t)&pReqInt->IoVec;
+            pSqe->u32BufIoVecSz     = 1;
+        }
+        pSqe->u64User = (uint64_t)(uintptr_t)pReqInt;
+
+        pIoURing->paidxSqes[idxSqe] = idxSqe;
+        idxSqTail++;
+    }
+
+    ASMWriteFence();
+    ASMAtomicWriteU32(pIoURing->pidxSqTail, idxSqTail);
+    ASMWriteFence();
+
+    int rc = VINF_SUCCESS;
+    if (cToSubmit)
+    {
+        int rcLnx = rtFileAioLnxIoURingEnter(pIoURing->iFdIoCtx, cToSubmit, 0 /*cMinComplete*/, 0 /*fFlags*/);
+        if (rcLnx >= 0)
+        {
+            /* Take back entries the kernel didn't consume, the caller resubmits them. */
+            if ((uint32_t)rcLnx < cToSubmit)
+                ASMAtomicWriteU32(pIoURing->pidxSqTail, idxSqStart + (uint32_t)rcLnx);
+            *pcSubmitted = (uint32_t)rcLnx;
+            if (!rcLnx)
+                rc = VERR_TRY_AGAIN;
+        }
+        else
+        {
+            /* Take the entries back, none was consumed by the kernel. */
+            ASMAtomicWriteU32(pIoURing->pidxSqTail, idxSqStart);
+            rc = rcLnx;
+        }
+    }
+    else
+        rc = VERR_TRY_AGAIN;
+
+    RTCritSectLeave(&pIoURing->CritSectSq);
+    return rc;
+}
+
+/**
+ * Reaps completed requests from the I/O ring completion queue.
+ *
+ * @returns Number of requests reaped.
+ * @param   pIoURing    The io_uring state.
+ * @param   pahReqs     Where to store the completed requests.
+ * @param   cReqs       Maximum number of requests to reap.
+ */
+static uint32_t rtFileAioLnxIoURingReap(PRTFILEAIOCTXIOURING pIoURing, PRTFILEAIOREQ pahReqs, size_t cReqs)
+{
+    ASMReadFence();
+    uint32_t idxCqHead = *pIoURing->pidxCqHead;
+    uint32_t idxCqTail = ASMAtomicReadU32(pIoURing->pidxCqTail);
+    ASMReadFence();
+
+    uint32_t cReaped = 0;
+    while (   idxCqHead != idxCqTail
+           && cReaped < cReqs)
+    {
+        volatile LNXIOURINGCQE *pCqe = &pIoURing->paCqes[idxCqHead & pIoURing->fCqRingMask];
+        PRTFILEAIOREQINTERNAL pReqInt = (PRTFILEAIOREQINTERNAL)(uintptr_t)pCqe->u64User;
+        AssertPtr(pReqInt);
+        Assert(pReqInt->u32Magic == RTFILEAIOREQ_MAGIC);
+
+        if (RT_UNLIKELY(pCqe->rcLnx < 0))
+            pReqInt->Rc = RTErrConvertFromErrno(-pCqe->rcLnx);
+        else
+        {
+            pReqInt->Rc = VINF_SUCCESS;
+            pReqInt->cbTransfered = (size_t)pCqe->rcLnx;
+        }
+
+        RTFILEAIOREQ_SET_STATE(pReqInt, COMPLETED);
+        pahReqs[cReaped++] = (RTFILEAIOREQ)pReqInt;
+        idxCqHead++;
+    }
+
+    ASMWriteFence();
+    ASMAtomicWriteU32(pIoURing->pidxCqHead, idxCqHead);
+    ASMWriteFence();
+
+    return cReaped;
+}
+
 RTR3DECL(int) RTFileAioGetLimits(PRTFILEAIOLIMITS pAioLimits)
 {
     int rc = VINF_SUCCESS;
@@ -452,6 +980,10 @@ RTDECL(int) RTFileAioReqCancel(RTFILEAIOREQ hReq)
     RTFILEAIOREQ_VALID_RETURN(pReqInt);
     RTFILEAIOREQ_STATE_RETURN_RC(pReqInt, SUBMITTED, VERR_FILE_AIO_NOT_SUBMITTED);
 
+    /* Requests on an I/O ring can't be canceled synchronously. */
+    if (pReqInt->pCtxInt->pIoURing)
+        return VERR_FILE_AIO_IN_PROGRESS;
+
     LNXKAIOIOEVENT AioEvent;
     int rc = rtFileAsyncIoLinuxCancel(pReqInt->AioContext, &pReqInt->AioCB, &AioEvent);
     if (RT_SUCCESS(rc))
@@ -504,8 +1036,13 @@ RTDECL(int) RTFileAioCtxCreate(PRTFILEAIOCTX phAioCtx, uint32_t cAioReqsMax,
     if (RT_UNLIKELY(!pCtxInt))
         return VERR_NO_MEMORY;
 
-    /* Init the event handle. */
-    int rc = rtFileAsyncIoLinuxCreate(cAioReqsMax, &pCtxInt->AioContext);
+    /* Try an I/O ring first and fall back to the io_* interface. */
+    int rc = rtFileAioLnxIoURingCreate(cAioReqsMax, &pCtxInt->pIoURing);
+    if (RT_FAILURE(rc))
+    {
+        pCtxInt->pIoURing = NULL;
+        rc = rtFileAsyncIoLinuxCreate(cAioReqsMax, &pCtxInt->AioContext);
+    }
     if (RT_SUCCESS(rc))
     {
         pCtxInt->fWokenUp     = false;
@@ -536,9 +1073,14 @@ RTDECL(int) RTFileAioCtxDestroy(RTFILEAIOCTX hAioCtx)
         return VERR_FILE_AIO_BUSY;
 
     /* The native bit first, then mark it as dead and free it. */
-    int rc = rtFileAsyncIoLinuxDestroy(pCtxInt->AioContext);
-    if (RT_FAILURE(rc))
-        return rc;
+    if (pCtxInt->pIoURing)
+        rtFileAioLnxIoURingDestroy(pCtxInt->pIoURing);
+    else
+    {
+        int rc = rtFileAsyncIoLinuxDestroy(pCtxInt->AioContext);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
     ASMAtomicUoWriteU32(&pCtxInt->u32Magic, RTFILEAIOCTX_MAGIC_DEAD);
     RTMemFree(pCtxInt);
 
@@ -562,11 +1104,92 @@ RTDECL(uint32_t) RTFileAioCtxGetMaxReqCount(RTFILEAIOCTX hAioCtx)
 
 RTDECL(int) RTFileAioCtxAssociateWithFile(RTFILEAIOCTX hAioCtx, RTFILE hFile)
 {
-    /* Nothing to do. */
-    NOREF(hAioCtx); NOREF(hFile);
+    PRTFILEAIOCTXINTERNAL pCtxInt = hAioCtx;
+    RTFILEAIOCTX_VALID_RETURN(pCtxInt);
+
+    /* Nothing to do for the io_* interface. */
+    PRTFILEAIOCTXIOURING pIoURing = pCtxInt->pIoURing;
+    if (   !pIoURing
+        || !pIoURing->fFixedFiles)
+        return VINF_SUCCESS;
+
+    /*
+     * Register the file with a free fixed file slot, running out of slots is
+     * not an error, requests for the file just use the descriptor then.
+     *
+     * Should the descriptor already have a slot (closed and reused without
+     * RTFileAioCtxDisassociateFromFile) the slot is updated anyway as the ring
+     * still references the old file.
+     */
+    int iFd = (int)RTFileToNative(hFile);
+    RTCritSectEnter(&pIoURing->CritSectSq);
+    int32_t iSlot = rtFileAioLnxIoURingFixedFileLookup(pIoURing, iFd);
+    if (iSlot == -1)
+    {
+        iSlot = rtFileAioLnxIoURingFixedFileLookup(pIoURing, -1);
+        if (   iSlot == -1
+            && pIoURing->cFdsFixed < RT_ELEMENTS(pIoURing->aFdsFixed))
+            iSlot = (int32_t)pIoURing->cFdsFixed;
+    }
+    if (iSlot != -1)
+    {
+        LNXIOURINGFILESUPDATE Upd;
+        Upd.offStart  = (uint32_t)iSlot;
+        Upd.u32Rsvd0  = 0;
+        Upd.u64PtrFds = (uint64_t)(uintptr_t)&iFd;
+        int rc = rtFileAioLnxIoURingRegister(pIoURing->iFdIoCtx, LNX_IOURING_REGISTER_OPC_FILES_UPDATE, &Upd, 1);
+        if (RT_SUCCESS(rc))
+        {
+            pIoURing->aFdsFixed[iSlot] = iFd;
+            if ((uint32_t)iSlot == pIoURing->cFdsFixed)
+                pIoURing->cFdsFixed++;
+        }
+        else
+            pIoURing->aFdsFixed[iSlot] = -1; /* Don't know what the kernel left in there, stop using the slot for iFd. */
+    }
+    RTCritSectLeave(&pIoURing->CritSectSq);
+
     return VINF_SUCCESS;
 }
 
+RTDECL(int) RTFileAioCtxDisassociateFromFile(RTFILEAIOCTX hAioCtx, RTFILE hFile)
+{
+    PRTFILEAIOCTXINTERNAL pCtxInt = hAioCtx;
+    RTFILEAIOCTX_VALID_RETURN(pCtxInt);
+
+    /* Nothing to do for the io_* interface. */
+    PRTFILEAIOCTXIOURING pIoURing = pCtxInt->pIoURing;
+    if (   !pIoURing
+        || !pIoURing->fFixedFiles)
+        return VINF_SUCCESS;
+
+    /*
+     * Clear the fixed file slot so the ring drops its file reference and a
+     * later file getting the same descriptor doesn't end up in the old file.
+     */
+    int rc = VINF_SUCCESS;
+    int iFd = (int)RTFileToNative(hFile);
+    RTCritSectEnter(&pIoURing->CritSectSq);
+    int32_t iSlot = rtFileAioLnxIoURingFixedFileLookup(pIoURing, iFd);
+    if (iSlot != -1)
+    {
+        int iFdNone = -1;
+        LNXIOURINGFILESUPDATE Upd;
+        Upd.offStart  = (uint32_t)iSlot;
+        Upd.u32Rsvd0  = 0;
+        Upd.u64PtrFds = (uint64_t)(uintptr_t)&iFdNone;
+        rc = rtFileAioLnxIoURingRegister(pIoURing->iFdIoCtx, LNX_IOURING_REGISTER_OPC_FILES_UPDATE, &Upd, 1);
+        /* Never hand out the slot for the descriptor again, even on failure. */
+        pIoURing->aFdsFixed[iSlot] = -1;
+        while (   pIoURing->cFdsFixed > 0
+               && pIoURing->aFdsFixed[pIoURing->cFdsFixed - 1] == -1)
+            pIoURing->cFdsFixed--;
+    }
+    RTCritSectLeave(&pIoURing->CritSectSq);
+
+    return rc;
+}
+
 RTDECL(int) RTFileAioCtxSubmit(RTFILEAIOCTX hAioCtx, PRTFILEAIOREQ pahReqs, size_t cReqs)
 {
     int rc = VINF_SUCCESS;
@@ -605,6 +1228,35 @@ RTDECL(int) RTFileAioCtxSubmit(RTFILEAIOCTX hAioCtx, PRTFILEAIOREQ pahReqs, size
         RTFILEAIOREQ_SET_STATE(pReqInt, SUBMITTED);
     }
 
+    if (pCtxInt->pIoURing)
+    {
+        while (cReqs)
+        {
+            uint32_t cReqsSubmitted = 0;
+            rc = rtFileAioLnxIoURingSubmit(pCtxInt, pahReqs, cReqs, &cReqsSubmitted);
+            if (RT_FAILURE(rc))
+            {
+                /* Revert the remaining requests into the prepared state. */
+                for (i = 0; i < cReqs; i++)
+                {
+                    pReqInt = pahReqs[i];
+                    pReqInt->pCtxInt = NULL;
+                    RTFILEAIOREQ_SET_STATE(pReqInt, PREPARED);
+                }
+
+                if (rc == VERR_TRY_AGAIN)
+                    return VERR_FILE_AIO_INSUFFICIENT_RESSOURCES;
+                return rc;
+            }
+
+            cReqs   -= cReqsSubmitted;
+            pahReqs += cReqsSubmitted;
+            ASMAtomicAddS32(&pCtxInt->cRequests, (int32_t)cReqsSubmitted);
+        }
+
+        return VINF_SUCCESS;
+    }
+
     do
     {
         /*
@@ -710,7 +1362,56 @@ RTDECL(int) RTFileAioCtxWait(RTFILEAIOCTX hAioCtx, size_t cMinReqs, RTMSINTERVAL
      */
     int rc = VINF_SUCCESS;
     int cRequestsCompleted = 0;
-    while (!pCtxInt->fWokenUp)
+    PRTFILEAIOCTXIOURING pIoURing = pCtxInt->pIoURing;
+    while (   pIoURing
+           && !pCtxInt->fWokenUp)
+    {
+        /* Reap whatever is there already, this doesn't require a syscall. */
+        uint32_t cDone = rtFileAioLnxIoURingReap(pIoURing, &pahReqs[cRequestsCompleted], cReqs);
+        cRequestsCompleted += cDone;
+        if (cDone >= cMinReqs)
+            break;
+        cMinReqs -= cDone;
+        cReqs    -= cDone;
+
+        int cMsWait = -1;
+        if (cMillies != RT_INDEFINITE_WAIT)
+        {
+            uint64_t cMilliesElapsed = (RTTimeNanoTS() - StartNanoTS) / RT_NS_1MS;
+            if (cMilliesElapsed >= cMillies)
+            {
+                rc = VERR_TIMEOUT;
+                break;
+            }
+            cMsWait = (int)(cMillies - (RTMSINTERVAL)cMilliesElapsed);
+        }
+
+        /*
+         * The eventfd is signalled for every completion event and by RTFileAioCtxWakeup(),
+         * reset it and check the completion queue again.
+         */
+        struct pollfd PollFd;
+        PollFd.fd      = pIoURing->iFdEvt;
+        PollFd.events  = POLLIN;
+        PollFd.revents = 0;
+        ASMAtomicXchgBool(&pCtxInt->fWaiting, true);
+        int rcLnx = poll(&PollFd, 1, cMsWait);
+        ASMAtomicXchgBool(&pCtxInt->fWaiting, false);
+        if (rcLnx > 0)
+        {
+            uint64_t uCnt = 0;
+            ssize_t cbRead = read(pIoURing->iFdEvt, &uCnt, sizeof(uCnt));
+            Assert(cbRead == sizeof(uCnt)); RT_NOREF(cbRead);
+        }
+        else if (rcLnx == -1 && errno != EINTR)
+        {
+            rc = RTErrConvertFromErrno(errno);
+            break;
+        }
+    }
+
+    while (   !pIoURing
+           && !pCtxInt->fWokenUp)
     {
         LNXKAIOIOEVENT  aPortEvents[AIO_MAXIMUM_REQUESTS_PER_CONTEXT];
         int             cRequestsToWait = RT_MIN(cReqs, AIO_MAXIMUM_REQUESTS_PER_CONTEXT);
@@ -824,7 +1525,19 @@ RTDECL(int) RTFileAioCtxWakeup(RTFILEAIOCTX hAioCtx)
     ASMAtomicReadHandle(&pCtxInt->hThreadWait, &hThread);
     bool fWaiting    = ASMAtomicReadBool(&pCtxInt->fWaiting);
     if (    !fWokenUp
-        &&  fWaiting)
+        &&  pCtxInt->pIoURing)
+    {
+        /*
+         * Kick the waiter out of the poll() on the eventfd.  This is done even if
+         * nobody waits right now because the signal stays pending and
+         * RTFileAioCtxWait() checks fWokenUp after returning from poll().
+         */
+        const uint64_t uValAdd = 1;
+        ssize_t rcLnx = write(pCtxInt->pIoURing->iFdEvt, &uValAdd, sizeof(uValAdd));
+        Assert(rcLnx == sizeof(uValAdd)); RT_NOREF(rcLnx);
+    }
+    else if (    !fWokenUp
+             &&  fWaiting)
     {
         /*
          * If a thread waits the handle must be valid.
@@ -69,12 +69,14 @@
 #include <sys/resource.h>
 
 #include <iprt/thread.h>
+#include <iprt/env.h>
+#include <iprt/file.h>
 #include <iprt/process.h>
 #include <iprt/semaphore.h>
 #include <iprt/string.h>
 #include <iprt/assert.h>
 #include <iprt/log.h>
-#include <iprt/errcore.h>
+#include <iprt/err.h>
 #include "internal/sched.h"
 #include "internal/thread.h"
 
@@ -148,6 +150,26 @@ typedef struct
 /*********************************************************************************************************************************
 *   Global Variables                                                                                                             *
 *********************************************************************************************************************************/
+/**
+ * The cgroup subdirectory names used for the thread types, see
+ * rtSchedLinuxApplyCgroup().
+ */
+static const char * const g_apszCgroupTypeNames[RTTHREADTYPE_END] =
+{
+    /* RTTHREADTYPE_INVALID */              NULL,
+    /* RTTHREADTYPE_INFREQUENT_POLLER */    "infrequent-poller",
+    /* RTTHREADTYPE_MAIN_HEAVY_WORKER */    "main-heavy-worker",
+    /* RTTHREADTYPE_EMULATION */            "emulation",
+    /* RTTHREADTYPE_DEFAULT */              "default",
+    /* RTTHREADTYPE_GUI */                  "gui",
+    /* RTTHREADTYPE_MAIN_WORKER */          "main-worker",
+    /* RTTHREADTYPE_VRDP_IO */              "vrdp-io",
+    /* RTTHREADTYPE_DEBUGGER */             "debugger",
+    /* RTTHREADTYPE_MSG_PUMP */             "msg-pump",
+    /* RTTHREADTYPE_IO */                   "io",
+    /* RTTHREADTYPE_TIMER */                "timer"
+};
+
 /**
  * Deltas for a process in which we are not restricted
  * to only be lowering the priority.
@@ -681,6 +703,45 @@ static DECLCALLBACK(int) rtThreadLinuxSetPriorityCallback(PRTTHREADINT pThread,
 }
 
 
+/**
+ * Moves the thread into the cgroup configured for its type, if any.
+ *
+ * When the IPRT_THREAD_CGROUP_ROOT environment variable points to a cgroup
+ * v2 directory, each thread is written to the cgroup.threads file of the
+ * subdirectory named after its type (see g_apszCgroupTypeNames).  This lets
+ * the host account for and limit EMTs, I/O threads and so on separately.  The
+ * hierarchy (threaded cgroups with the desired weights and limits) must be
+ * set up and delegated by whoever starts the process, missing subdirectories
+ * are silently skipped.
+ *
+ * @param   pThread     The thread.
+ * @param   enmType     The thread type.
+ */
+static void rtSchedLinuxApplyCgroup(PRTTHREADINT pThread, RTTHREADTYPE enmType)
+{
+    const char *pszRoot = RTEnvGet("IPRT_THREAD_CGROUP_ROOT");
+    if (!pszRoot || !*pszRoot)
+        return;
+
+    char szPath[RTPATH_MAX];
+    ssize_t cch = RTStrPrintf2(szPath, sizeof(szPath), "%s/%s/cgroup.threads", pszRoot, g_apszCgroupTypeNames[enmType]);
+    AssertReturnVoid(cch > 0);
+
+    RTFILE hFile;
+    int rc = RTFileOpen(&hFile, szPath, RTFILE_O_WRITE | RTFILE_O_OPEN | RTFILE_O_DENY_NONE);
+    if (RT_SUCCESS(rc))
+    {
+        char szTid[32];
+        cch = RTStrPrintf2(szTid, sizeof(szTid), "%d\n", (int)pThread->tid);
+        rc = RTFileWrite(hFile, szTid, (size_t)cch, NULL);
+        RTFileClose(hFile);
+    }
+    if (RT_FAILURE(rc) && rc != VERR_FILE_NOT_FOUND && rc != VERR_PATH_NOT_FOUND)
+        LogRelMax(32, ("IPRT: Failed to move thread %d (%s) into '%s': %Rrc\n",
+                       (int)pThread->tid, pThread->szName, szPath, rc));
+}
+
+
 DECLHIDDEN(int) rtThreadNativeSetPriority(PRTTHREADINT pThread, RTTHREADTYPE enmType)
 {
     /* sanity */
@@ -694,6 +755,8 @@ DECLHIDDEN(int) rtThreadNativeSetPriority(PRTTHREADINT pThread, RTTHREADTYPE enm
     if (!pThread->tid)
         return VINF_SUCCESS;
 
+    rtSchedLinuxApplyCgroup(pThread, enmType);
+
     /*
      * Calculate the thread priority and apply it, preferrably via the priority proxy thread.
      */
@@ -602,6 +602,12 @@ RTDECL(int) RTFileAioCtxAssociateWithFile(RTFILEAIOCTX hAioCtx, RTFILE hFile)
     return VINF_SUCCESS;
 }
 
+RTDECL(int) RTFileAioCtxDisassociateFromFile(RTFILEAIOCTX hAioCtx, RTFILE hFile)
+{
+    NOREF(hAioCtx); NOREF(hFile);
+    return VINF_SUCCESS;
+}
+
 #ifdef LOG_ENABLED
 /**
  * Dumps the state of a async I/O context.
@@ -639,6 +639,44 @@ RTR3DECL(int)  RTUdpWrite(PRTUDPSERVER pServer, const void *pvBuffer, size_t cbB
 }
 
 
+RTR3DECL(int)  RTUdpServerSetBufferSizes(PRTUDPSERVER pServer, uint32_t cbRecv, uint32_t cbSend)
+{
+    /*
+     * Validate input and retain the instance.
+     */
+    AssertPtrReturn(pServer, VERR_INVALID_HANDLE);
+    AssertReturn(pServer->u32Magic == RTUDPSERVER_MAGIC, VERR_INVALID_HANDLE);
+    AssertReturn(cbRecv <= INT_MAX && cbSend <= INT_MAX, VERR_INVALID_PARAMETER);
+    AssertReturn(RTMemPoolRetain(pServer) != UINT32_MAX, VERR_INVALID_HANDLE);
+
+    RTSOCKET hSocket;
+    ASMAtomicReadHandle(&pServer->hSocket, &hSocket);
+    if (hSocket == NIL_RTSOCKET)
+    {
+        RTMemPoolRelease(RTMEMPOOL_DEFAULT, pServer);
+        return VERR_INVALID_HANDLE;
+    }
+    RTSocketRetain(hSocket);
+
+    int rc = VINF_SUCCESS;
+    if (cbRecv)
+    {
+        int iValue = (int)cbRecv;
+        rc = rtSocketSetOpt(hSocket, SOL_SOCKET, SO_RCVBUF, &iValue, sizeof(iValue));
+    }
+    if (RT_SUCCESS(rc) && cbSend)
+    {
+        int iValue = (int)cbSend;
+        rc = rtSocketSetOpt(hSocket, SOL_SOCKET, SO_SNDBUF, &iValue, sizeof(iValue));
+    }
+
+    RTSocketRelease(hSocket);
+    RTMemPoolRelease(RTMEMPOOL_DEFAULT, pServer);
+
+    return rc;
+}
+
+
 RTR3DECL(int) RTUdpCreateClientSocket(const char *pszAddress, uint32_t uPort, PRTNETADDR pLocalAddr, PRTSOCKET pSock)
 {
     /*
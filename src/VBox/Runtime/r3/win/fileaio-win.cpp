@@ -351,6 +351,15 @@ RTDECL(int) RTFileAioCtxAssociateWithFile(RTFILEAIOCTX hAioCtx, RTFILE hFile)
     return VERR_NOT_SUPPORTED;
 }
 
+RTDECL(int) RTFileAioCtxDisassociateFromFile(RTFILEAIOCTX hAioCtx, RTFILE hFile)
+{
+    /* A handle stays bound to its completion port until it is closed. */
+    PRTFILEAIOCTXINTERNAL pCtxInt = hAioCtx;
+    RTFILEAIOCTX_VALID_RETURN(pCtxInt);
+    RT_NOREF(hFile);
+    return VINF_SUCCESS;
+}
+
 RTDECL(uint32_t) RTFileAioCtxGetMaxReqCount(RTFILEAIOCTX hAioCtx)
 {
     RT_NOREF_PV(hAioCtx);
@@ -40,19 +40,48 @@
 *********************************************************************************************************************************/
 #include <iprt/manifest.h>
 
+#include <iprt/asm.h>
 #include <iprt/buildconfig.h>
 #include <iprt/errcore.h>
 #include <iprt/file.h>
 #include <iprt/getopt.h>
 #include <iprt/initterm.h>
+#include <iprt/mem.h>
 #include <iprt/message.h>
 #include <iprt/path.h>
 #include <iprt/process.h>
+#include <iprt/sha.h>
 #include <iprt/stream.h>
 #include <iprt/string.h>
+#include <iprt/thread.h>
 #include <iprt/vfs.h>
 
 
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * State shared by the worker threads hashing files in parallel.
+ */
+typedef struct RTMANIFESTJOBS
+{
+    /** The files to add. */
+    const char        **papszFiles;
+    /** Private manifest for each file, merged when all are done. */
+    PRTMANIFEST         pahManifests;
+    /** Number of files. */
+    uint32_t            cFiles;
+    /** The manifest attributes to add. */
+    uint32_t            fAttr;
+    /** The index of the next file to process. */
+    uint32_t volatile   iNext;
+    /** The first failure status. */
+    int32_t volatile    rc;
+} RTMANIFESTJOBS;
+/** Pointer to the parallel hashing state. */
+typedef RTMANIFESTJOBS *PRTMANIFESTJOBS;
+
+
 /**
  * Verify a manifest.
  *
@@ -168,6 +197,159 @@ static int rtManifestAddFileToManifest(RTMANIFEST hManifest, const char *pszFile
 }
 
 
+/**
+ * Worker thread for rtManifestAddFilesParallel.
+ *
+ * @returns IPRT status code.
+ * @param   hThreadSelf         The thread handle, unused.
+ * @param   pvUser              Pointer to the RTMANIFESTJOBS state.
+ */
+static DECLCALLBACK(int) rtManifestJobThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PRTMANIFESTJOBS pJobs = (PRTMANIFESTJOBS)pvUser;
+    RT_NOREF(hThreadSelf);
+
+    for (;;)
+    {
+        uint32_t const iFile = ASMAtomicIncU32(&pJobs->iNext) - 1;
+        if (   iFile >= pJobs->cFiles
+            || RT_FAILURE(ASMAtomicReadS32(&pJobs->rc)))
+            break;
+
+        RTMANIFEST hManifest;
+        int rc = RTManifestCreate(0 /*fFlags*/, &hManifest);
+        if (RT_SUCCESS(rc))
+        {
+            pJobs->pahManifests[iFile] = hManifest;
+            rc = rtManifestAddFileToManifest(hManifest, pJobs->papszFiles[iFile], pJobs->fAttr);
+        }
+        else
+            RTMsgError("RTManifestCreate failed: %Rrc", rc);
+        if (RT_FAILURE(rc))
+            ASMAtomicCmpXchgS32(&pJobs->rc, rc, VINF_SUCCESS);
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Adds the remaining file arguments to the manifest, hashing several files at
+ * the same time.
+ *
+ * Each file is hashed into a private manifest by one of the worker threads and
+ * the results are merged into @a hManifest in command line order afterwards.
+ *
+ * @returns IPRT status code, failures with error message.
+ * @param   hManifest           The manifest to add the files to.
+ * @param   fAttr               The manifest attributes to add.
+ * @param   cJobs               The max number of files to hash concurrently.
+ * @param   pGetState           The RTGetOpt state.
+ * @param   pUnion              What the last RTGetOpt() call returned.
+ * @param   pchOpt              What the last RTGetOpt() call returned, updated.
+ */
+static int rtManifestAddFilesParallel(RTMANIFEST hManifest, uint32_t fAttr, uint32_t cJobs,
+                                      PRTGETOPTSTATE pGetState, PRTGETOPTUNION pUnion, int *pchOpt)
+{
+    /*
+     * Gather the file names.  They point into argv, so there is no need to
+     * duplicate them.
+     */
+    uint32_t     cFiles     = 0;
+    uint32_t     cAllocated = 0;
+    const char **papszFiles = NULL;
+    while (*pchOpt == VINF_GETOPT_NOT_OPTION)
+    {
+        if (cFiles >= cAllocated)
+        {
+            uint32_t const cNew = cAllocated ? cAllocated * 2 : 64;
+            void *pvNew = RTMemRealloc(papszFiles, cNew * sizeof(papszFiles[0]));
+            if (!pvNew)
+            {
+                RTMemFree(papszFiles);
+                RTMsgError("Out of memory");
+                return VERR_NO_MEMORY;
+            }
+            papszFiles = (const char **)pvNew;
+            cAllocated = cNew;
+        }
+        papszFiles[cFiles++] = pUnion->psz;
+
+        /* next */
+        *pchOpt = RTGetOpt(pGetState, pUnion);
+    }
+    if (!cFiles)
+        return VINF_SUCCESS;
+
+    RTMANIFESTJOBS Jobs;
+    Jobs.papszFiles   = papszFiles;
+    Jobs.pahManifests = (PRTMANIFEST)RTMemAllocZ(cFiles * sizeof(Jobs.pahManifests[0]));
+    Jobs.cFiles       = cFiles;
+    Jobs.fAttr        = fAttr;
+    Jobs.iNext        = 0;
+    Jobs.rc           = VINF_SUCCESS;
+    if (!Jobs.pahManifests)
+    {
+        RTMemFree(papszFiles);
+        RTMsgError("Out of memory");
+        return VERR_NO_MEMORY;
+    }
+    for (uint32_t i = 0; i < cFiles; i++)
+        Jobs.pahManifests[i] = NIL_RTMANIFEST;
+
+    /*
+     * Start the workers; if we fail to create some we just go on with fewer.
+     */
+    cJobs = RT_MIN(cJobs, cFiles);
+    PRTTHREAD pahThreads = (PRTTHREAD)RTMemAllocZ(cJobs * sizeof(pahThreads[0]));
+    uint32_t  cThreads   = 0;
+    if (pahThreads)
+        for (; cThreads < cJobs; cThreads++)
+        {
+            int rc = RTThreadCreateF(&pahThreads[cThreads], rtManifestJobThread, &Jobs, 0 /*cbStack*/,
+                                     RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "Manifest%u", cThreads);
+            if (RT_FAILURE(rc))
+                break;
+        }
+
+    /* This thread does its share of the work too (or all of it if no threads could be created). */
+    rtManifestJobThread(NIL_RTTHREAD, &Jobs);
+
+    for (uint32_t i = 0; i < cThreads; i++)
+        RTThreadWait(pahThreads[i], RT_INDEFINITE_WAIT, NULL);
+    RTMemFree(pahThreads);
+
+    /*
+     * Merge the results in file order.
+     */
+    int rc = Jobs.rc;
+    for (uint32_t iFile = 0; iFile < cFiles; iFile++)
+    {
+        RTMANIFEST hManifestFile = Jobs.pahManifests[iFile];
+        if (hManifestFile == NIL_RTMANIFEST)
+            continue;
+
+        for (uint32_t fType = RT_BIT_32(0); RT_SUCCESS(rc) && fType < RTMANIFEST_ATTR_END; fType <<= 1)
+            if (fAttr & fType)
+            {
+                char     szValue[RTSHA512_DIGEST_LEN + 32];
+                uint32_t fTypeEntry;
+                rc = RTManifestEntryQueryAttr(hManifestFile, papszFiles[iFile], NULL /*pszAttr*/, fType,
+                                              szValue, sizeof(szValue), &fTypeEntry);
+                if (RT_SUCCESS(rc))
+                    rc = RTManifestEntrySetAttr(hManifest, papszFiles[iFile], NULL /*pszAttr*/, szValue, fTypeEntry);
+                if (RT_FAILURE(rc))
+                    RTMsgError("Failed to merge the manifest entry for '%s': %Rrc", papszFiles[iFile], rc);
+            }
+
+        RTManifestRelease(hManifestFile);
+    }
+
+    RTMemFree(Jobs.pahManifests);
+    RTMemFree(papszFiles);
+    return rc;
+}
+
+
 /**
  * Create a manifest from the specified input files.
  *
@@ -179,12 +361,13 @@ static int rtManifestAddFileToManifest(RTMANIFEST hManifest, const char *pszFile
  * @param   pszChDir            The directory to change into before processing
  *                              the file arguments.
  * @param   fAttr               The file attributes to put in the manifest.
+ * @param   cJobs               The max number of files to hash concurrently.
  * @param   pGetState           The RTGetOpt state.
  * @param   pUnion              What the last RTGetOpt() call returned.
  * @param   chOpt               What the last RTGetOpt() call returned.
  */
 static RTEXITCODE rtManifestDoCreate(const char *pszManifest, bool fStdFormat, const char *pszChDir, uint32_t fAttr,
-                                     PRTGETOPTSTATE pGetState, PRTGETOPTUNION pUnion, int chOpt)
+                                     uint32_t cJobs, PRTGETOPTSTATE pGetState, PRTGETOPTUNION pUnion, int chOpt)
 {
     /*
      * Open the manifest file.
@@ -223,7 +406,9 @@ static RTEXITCODE rtManifestDoCreate(const char *pszManifest, bool fStdFormat, c
             if (RT_FAILURE(rc))
                 RTMsgError("Failed to change directory to '%s': %Rrc", pszChDir, rc);
         }
-        if (RT_SUCCESS(rc))
+        if (RT_SUCCESS(rc) && cJobs > 1)
+            rc = rtManifestAddFilesParallel(hManifest, fAttr, cJobs, pGetState, pUnion, &chOpt);
+        else if (RT_SUCCESS(rc))
         {
             while (chOpt == VINF_GETOPT_NOT_OPTION)
             {
@@ -283,6 +468,7 @@ int main(int argc, char **argv)
         { "--chdir",        'C', RTGETOPT_REQ_STRING  },
         { "--attribute",    'a', RTGETOPT_REQ_STRING  },
         { "--verify",       'v', RTGETOPT_REQ_NOTHING },
+        { "--jobs",         'J', RTGETOPT_REQ_UINT32  },
     };
 
     bool            fVerify     = false;
@@ -290,6 +476,7 @@ int main(int argc, char **argv)
     const char     *pszManifest = NULL;
     const char     *pszChDir    = NULL;
     uint32_t        fAttr       = RTMANIFEST_ATTR_UNKNOWN;
+    uint32_t        cJobs       = 1;
 
     RTGETOPTSTATE GetState;
     rc = RTGetOptInit(&GetState, argc, argv, s_aOptions, RT_ELEMENTS(s_aOptions), 1, RTGETOPTINIT_FLAGS_OPTS_FIRST);
@@ -347,6 +534,12 @@ int main(int argc, char **argv)
                 fVerify = true;
                 break;
 
+            case 'J':
+                if (!ValueUnion.u32 || ValueUnion.u32 > 256)
+                    return RTMsgErrorExit(RTEXITCODE_SYNTAX, "The number of jobs must be between 1 and 256: %u", ValueUnion.u32);
+                cJobs = ValueUnion.u32;
+                break;
+
             case 'C':
                 if (pszChDir)
                     return RTMsgErrorExit(RTEXITCODE_SYNTAX, "Only one directory change can be specified");
@@ -354,7 +547,7 @@ int main(int argc, char **argv)
                 break;
 
             case 'h':
-                RTPrintf("Usage: %s [--manifest <file>] [--chdir <dir>] [--attribute <attrib-name> [..]] <files>\n"
+                RTPrintf("Usage: %s [--manifest <file>] [--chdir <dir>] [--attribute <attrib-name> [..]] [--jobs <n>] <files>\n"
                          "   or  %s --verify [--manifest <file>] [--chdir <dir>]\n"
                          "\n"
                          "attrib-name: size, md5, sha1, sha256 or sha512\n"
@@ -383,7 +576,7 @@ int main(int argc, char **argv)
         if (fAttr == RTMANIFEST_ATTR_UNKNOWN)
             fAttr = RTMANIFEST_ATTR_SIZE | RTMANIFEST_ATTR_MD5
                   | RTMANIFEST_ATTR_SHA1 | RTMANIFEST_ATTR_SHA256 | RTMANIFEST_ATTR_SHA512;
-        rcExit = rtManifestDoCreate(pszManifest, fStdFormat, pszChDir, fAttr, &GetState, &ValueUnion, rc);
+        rcExit = rtManifestDoCreate(pszManifest, fStdFormat, pszChDir, fAttr, cJobs, &GetState, &ValueUnion, rc);
     }
     else
     {
@@ -318,6 +318,28 @@ typedef struct DMGEXTENT
 /** Pointer to an DMG extent. */
 typedef DMGEXTENT *PDMGEXTENT;
 
+/** Number of decompressed extents kept around.
+ * A single buffer gets thrashed by guests interleaving reads of file system
+ * metadata and file data living in different compressed extents. */
+#define DMG_DECOMP_CACHE_ENTRIES    8
+
+/**
+ * Decompressed extent cache entry.
+ */
+typedef struct DMGDECOMPCACHEENTRY
+{
+    /** Extent which owns the data in the buffer, NULL if the entry is unused. */
+    PDMGEXTENT           pExtent;
+    /** Buffer holding the decompressed data for the extent. */
+    void                *pvDecomp;
+    /** Size of the buffer. */
+    size_t               cbDecomp;
+    /** Last time (use counter value) the entry was accessed, for LRU eviction. */
+    uint64_t             uLastUse;
+} DMGDECOMPCACHEENTRY;
+/** Pointer to a decompressed extent cache entry. */
+typedef DMGDECOMPCACHEENTRY *PDMGDECOMPCACHEENTRY;
+
 /**
  * VirtualBox Apple Disk Image (DMG) interpreter instance data.
  */
@@ -375,12 +397,10 @@ typedef struct DMGIMAGE
     /** Index of the last accessed extent. */
     unsigned            idxExtentLast;
 
-    /** Extent which owns the data in the buffer. */
-    PDMGEXTENT          pExtentDecomp;
-    /** Buffer holding the decompressed data for a extent. */
-    void               *pvDecompExtent;
-    /** Size of the buffer. */
-    size_t              cbDecompExtent;
+    /** Cache of decompressed extents. */
+    DMGDECOMPCACHEENTRY aDecompCache[DMG_DECOMP_CACHE_ENTRIES];
+    /** Use counter for the LRU eviction of decompressed extents. */
+    uint64_t            uDecompCacheUse;
     /** The static region list. */
     VDREGIONLIST        RegionList;
 } DMGIMAGE;
@@ -882,12 +902,14 @@ static int dmgFreeImage(PDMGIMAGE pThis, bool fDelete)
         if (fDelete && pThis->pszFilename)
             vdIfIoIntFileDelete(pThis->pIfIoXxx, pThis->pszFilename);
 
-        if (pThis->pvDecompExtent)
-        {
-            RTMemFree(pThis->pvDecompExtent);
-            pThis->pvDecompExtent = NULL;
-            pThis->cbDecompExtent = 0;
-        }
+        for (unsigned i = 0; i < RT_ELEMENTS(pThis->aDecompCache); i++)
+            if (pThis->aDecompCache[i].pvDecomp)
+            {
+                RTMemFree(pThis->aDecompCache[i].pvDecomp);
+                pThis->aDecompCache[i].pvDecomp = NULL;
+                pThis->aDecompCache[i].cbDecomp = 0;
+                pThis->aDecompCache[i].pExtent  = NULL;
+            }
 
         if (pThis->paExtents)
         {
@@ -1944,6 +1966,55 @@ static DECLCALLBACK(int) dmgClose(void *pBackendData, bool fDelete)
     return rc;
 }
 
+/**
+ * Returns the decompressed data of the given extent, decompressing it into
+ * the least recently used cache entry if it isn't cached yet.
+ *
+ * @returns VBox status code.
+ * @param   pThis       The DMG instance data.
+ * @param   pExtent     The compressed extent.
+ * @param   ppEntry     Where to return the cache entry holding the data.
+ */
+static int dmgDecompCacheGet(PDMGIMAGE pThis, PDMGEXTENT pExtent, PDMGDECOMPCACHEENTRY *ppEntry)
+{
+    PDMGDECOMPCACHEENTRY pEntry = &pThis->aDecompCache[0];
+    for (unsigned i = 0; i < RT_ELEMENTS(pThis->aDecompCache); i++)
+    {
+        if (pThis->aDecompCache[i].pExtent == pExtent)
+        {
+            pThis->aDecompCache[i].uLastUse = ++pThis->uDecompCacheUse;
+            *ppEntry = &pThis->aDecompCache[i];
+            return VINF_SUCCESS;
+        }
+        if (pThis->aDecompCache[i].uLastUse < pEntry->uLastUse)
+            pEntry = &pThis->aDecompCache[i];
+    }
+
+    /* Not cached, evict the least recently used entry. */
+    size_t const cbExtent = DMG_BLOCK2BYTE(pExtent->cSectorsExtent);
+    pEntry->pExtent = NULL;
+    if (cbExtent > pEntry->cbDecomp)
+    {
+        if (RT_LIKELY(pEntry->pvDecomp))
+            RTMemFree(pEntry->pvDecomp);
+
+        pEntry->cbDecomp = 0;
+        pEntry->pvDecomp = RTMemAllocZ(cbExtent);
+        if (!pEntry->pvDecomp)
+            return VERR_NO_MEMORY;
+        pEntry->cbDecomp = cbExtent;
+    }
+
+    int rc = dmgFileInflateSync(pThis, pExtent->offFileStart, pExtent->cbFile, pEntry->pvDecomp, cbExtent);
+    if (RT_SUCCESS(rc))
+    {
+        pEntry->pExtent  = pExtent;
+        pEntry->uLastUse = ++pThis->uDecompCacheUse;
+        *ppEntry = pEntry;
+    }
+    return rc;
+}
+
 /** @interface_method_impl{VDIMAGEBACKEND,pfnRead} */
 static DECLCALLBACK(int) dmgRead(void *pBackendData, uint64_t uOffset,  size_t cbToRead,
                                  PVDIOCTX pIoCtx, size_t *pcbActuallyRead)
@@ -1988,33 +2059,11 @@ static DECLCALLBACK(int) dmgRead(void *pBackendData, uint64_t uOffset,  size_t c
             }
             case DMGEXTENTTYPE_COMP_ZLIB:
             {
-                if (pThis->pExtentDecomp != pExtent)
-                {
-                    if (DMG_BLOCK2BYTE(pExtent->cSectorsExtent) > pThis->cbDecompExtent)
-                    {
-                        if (RT_LIKELY(pThis->pvDecompExtent))
-                            RTMemFree(pThis->pvDecompExtent);
-
-                        pThis->pvDecompExtent = RTMemAllocZ(DMG_BLOCK2BYTE(pExtent->cSectorsExtent));
-                        if (!pThis->pvDecompExtent)
-                            rc = VERR_NO_MEMORY;
-                        else
-                            pThis->cbDecompExtent = DMG_BLOCK2BYTE(pExtent->cSectorsExtent);
-                    }
-
-                    if (RT_SUCCESS(rc))
-                    {
-                        rc = dmgFileInflateSync(pThis, pExtent->offFileStart, pExtent->cbFile,
-                                                pThis->pvDecompExtent,
-                                                RT_MIN(pThis->cbDecompExtent, DMG_BLOCK2BYTE(pExtent->cSectorsExtent)));
-                        if (RT_SUCCESS(rc))
-                            pThis->pExtentDecomp = pExtent;
-                    }
-                }
-
+                PDMGDECOMPCACHEENTRY pEntry;
+                rc = dmgDecompCacheGet(pThis, pExtent, &pEntry);
                 if (RT_SUCCESS(rc))
                     vdIfIoIntIoCtxCopyTo(pThis->pIfIoXxx, pIoCtx,
-                                         (uint8_t *)pThis->pvDecompExtent + DMG_BLOCK2BYTE(uExtentRel),
+                                         (uint8_t *)pEntry->pvDecomp + DMG_BLOCK2BYTE(uExtentRel),
                                          cbToRead);
                 break;
             }
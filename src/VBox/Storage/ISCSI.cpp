@@ -119,12 +119,16 @@ typedef enum SCSIDEVTYPE
 /** Mask to extract the CmdQue bit out of the seventh byte of the INQUIRY response. */
 #define SCSI_INQUIRY_CMDQUE_MASK 0x02
 
-/** Maximum PDU payload size we can handle in one piece. Greater or equal than
- * s_iscsiConfigDefaultWriteSplit. */
+/** Default maximum PDU payload size we can handle in one piece. Greater or
+ * equal than s_iscsiConfigDefaultWriteSplit. */
 #define ISCSI_DATA_LENGTH_MAX _256K
 
-/** Maximum PDU size we can handle in one piece. */
-#define ISCSI_RECV_PDU_BUFFER_SIZE (ISCSI_DATA_LENGTH_MAX + ISCSI_BHS_SIZE)
+/** Smallest configurable maximum PDU payload size. */
+#define ISCSI_DATA_LENGTH_MAX_MIN _64K
+
+/** Largest configurable maximum PDU payload size, the DataSegmentLength
+ * field is 24 bits wide. */
+#define ISCSI_DATA_LENGTH_MAX_MAX _8M
 
 
 /** Version of the iSCSI standard which this initiator driver can handle. */
@@ -512,6 +516,9 @@ typedef struct ISCSIIMAGE
      * written in a single write. This is negotiated with the target, so
      * the actual size might be smaller. */
     uint32_t            cbWriteSplit;
+    /** Maximum PDU payload size offered to the target during login, also the
+     * limit for a single read. The receive PDU buffer is sized accordingly. */
+    uint32_t            cbDataLengthMax;
     /** Initiator session identifier. */
     uint64_t            ISID;
     /** SCSI Logical Unit Number. */
@@ -653,6 +660,9 @@ static const char *s_iscsiConfigDefaultTimeout = "10000";
 /** Default write split value, less or equal to ISCSI_DATA_LENGTH_MAX. */
 static const char *s_iscsiConfigDefaultWriteSplit = "262144";
 
+/** Default maximum PDU payload size, ISCSI_DATA_LENGTH_MAX. */
+static const char *s_iscsiConfigDefaultMaxDataLength = "262144";
+
 /** Default host IP stack. */
 static const char *s_iscsiConfigDefaultHostIPStack = "1";
 
@@ -672,6 +682,7 @@ static const VDCONFIGINFO s_iscsiConfigInfo[] =
     { "TargetUsername",       NULL,                                      VDCFGVALUETYPE_STRING,  VD_CFGKEY_EXPERT },
     { "TargetSecret",         NULL,                                      VDCFGVALUETYPE_BYTES,   VD_CFGKEY_EXPERT },
     { "WriteSplit",           s_iscsiConfigDefaultWriteSplit,            VDCFGVALUETYPE_INTEGER, VD_CFGKEY_EXPERT },
+    { "MaxDataLength",        s_iscsiConfigDefaultMaxDataLength,         VDCFGVALUETYPE_INTEGER, VD_CFGKEY_EXPERT },
     { "Timeout",              s_iscsiConfigDefaultTimeout,               VDCFGVALUETYPE_INTEGER, VD_CFGKEY_EXPERT },
     { "HostIPStack",          s_iscsiConfigDefaultHostIPStack,           VDCFGVALUETYPE_INTEGER, VD_CFGKEY_EXPERT },
     { "DumpMalformedPackets", s_iscsiConfigDefaultDumpMalformedPackets,  VDCFGVALUETYPE_INTEGER, VD_CFGKEY_EXPERT },
@@ -1306,10 +1317,10 @@ static int iscsiLogin(PISCSIIMAGE pImage)
     uint32_t aResBHS[12];
     char *pszNext;
     bool fParameterNeg = true;
-    pImage->cbRecvDataLength = ISCSI_DATA_LENGTH_MAX;
-    pImage->cbSendDataLength = RT_MIN(ISCSI_DATA_LENGTH_MAX, pImage->cbWriteSplit);
+    pImage->cbRecvDataLength = pImage->cbDataLengthMax;
+    pImage->cbSendDataLength = RT_MIN(pImage->cbDataLengthMax, pImage->cbWriteSplit);
     char szMaxDataLength[16];
-    RTStrPrintf(szMaxDataLength, sizeof(szMaxDataLength), "%u", ISCSI_DATA_LENGTH_MAX);
+    RTStrPrintf(szMaxDataLength, sizeof(szMaxDataLength), "%u", pImage->cbDataLengthMax);
     ISCSIPARAMETER aParameterNeg[] =
     {
         { "HeaderDigest", "None", 0 },
@@ -3989,13 +4000,11 @@ static int iscsiOpenImageInit(PISCSIIMAGE pImage)
                 memset(pImage->aCmdsWaiting, 0, sizeof(pImage->aCmdsWaiting));
                 pImage->cbRecvPDUResidual = 0;
 
-                pImage->pvRecvPDUBuf    = RTMemAlloc(ISCSI_RECV_PDU_BUFFER_SIZE);
-                pImage->cbRecvPDUBuf    = ISCSI_RECV_PDU_BUFFER_SIZE;
-                if (!pImage->pvRecvPDUBuf)
-                    rc = VERR_NO_MEMORY;
+                /* The receive PDU buffer is allocated once the configured maximum data length is known. */
+                pImage->pvRecvPDUBuf    = NULL;
+                pImage->cbRecvPDUBuf    = 0;
 
-                if (RT_SUCCESS(rc))
-                    rc = RTSemMutexCreate(&pImage->Mutex);
+                rc = RTSemMutexCreate(&pImage->Mutex);
                 if (RT_SUCCESS(rc))
                     rc = RTSemMutexCreate(&pImage->MutexReqQueue);
             }
@@ -4025,6 +4034,7 @@ static int iscsiOpenImageParseCfg(PISCSIIMAGE pImage)
     char *pszLUN = NULL, *pszLUNInitial = NULL;
     bool fLunEncoded = false;
     uint32_t uWriteSplitDef = 0;
+    uint32_t uMaxDataLengthDef = 0;
     uint32_t uTimeoutDef = 0;
     uint64_t uCfgTmp = 0;
     bool fHostIPDef = false;
@@ -4032,6 +4042,8 @@ static int iscsiOpenImageParseCfg(PISCSIIMAGE pImage)
 
     int rc = RTStrToUInt32Full(s_iscsiConfigDefaultWriteSplit, 0, &uWriteSplitDef);
     AssertRC(rc);
+    rc = RTStrToUInt32Full(s_iscsiConfigDefaultMaxDataLength, 0, &uMaxDataLengthDef);
+    AssertRC(rc);
     rc = RTStrToUInt32Full(s_iscsiConfigDefaultTimeout, 0, &uTimeoutDef);
     AssertRC(rc);
     rc = RTStrToUInt64Full(s_iscsiConfigDefaultHostIPStack, 0, &uCfgTmp);
@@ -4053,6 +4065,7 @@ static int iscsiOpenImageParseCfg(PISCSIIMAGE pImage)
                            "TargetUsername\0"
                            "TargetSecret\0"
                            "WriteSplit\0"
+                           "MaxDataLength\0"
                            "Timeout\0"
                            "HostIPStack\0"
                            "DumpMalformedPackets\0"))
@@ -4147,6 +4160,26 @@ static int iscsiOpenImageParseCfg(PISCSIIMAGE pImage)
     if (RT_FAILURE(rc))
         return vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("iSCSI: configuration error: failed to read WriteSplit as U32"));
 
+    rc = VDCFGQueryU32Def(pImage->pIfConfig, "MaxDataLength", &pImage->cbDataLengthMax, uMaxDataLengthDef);
+    if (RT_FAILURE(rc))
+        return vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("iSCSI: configuration error: failed to read MaxDataLength as U32"));
+    if (   pImage->cbDataLengthMax < ISCSI_DATA_LENGTH_MAX_MIN
+        || pImage->cbDataLengthMax > ISCSI_DATA_LENGTH_MAX_MAX)
+        return vdIfError(pImage->pIfError, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                         N_("iSCSI: configuration error: MaxDataLength %u is out of range (%u..%u)"),
+                         pImage->cbDataLengthMax, ISCSI_DATA_LENGTH_MAX_MIN, ISCSI_DATA_LENGTH_MAX_MAX);
+    if (pImage->cbDataLengthMax != ISCSI_DATA_LENGTH_MAX)
+        LogRel(("iSCSI: Maximum data length per PDU set to %u bytes\n", pImage->cbDataLengthMax));
+
+    /* Receive PDUs carry at most cbDataLengthMax bytes of data after the BHS. */
+    pImage->cbRecvPDUBuf = pImage->cbDataLengthMax + ISCSI_BHS_SIZE;
+    pImage->pvRecvPDUBuf = RTMemAlloc(pImage->cbRecvPDUBuf);
+    if (!pImage->pvRecvPDUBuf)
+    {
+        pImage->cbRecvPDUBuf = 0;
+        return VERR_NO_MEMORY;
+    }
+
     /* Query the iSCSI lower level configuration. */
     rc = VDCFGQueryU32Def(pImage->pIfConfig, "Timeout", &pImage->uReadTimeout, uTimeoutDef);
     if (RT_FAILURE(rc))
@@ -36,6 +36,7 @@
 #include <VBox/log.h>
 #include <iprt/asm.h>
 #include <iprt/assert.h>
+#include <iprt/avl.h>
 #include <iprt/string.h>
 #include <iprt/alloc.h>
 #include <iprt/path.h>
@@ -192,8 +193,8 @@ typedef QCowHeader *PQCowHeader;
  */
 typedef struct QCOWL2CACHEENTRY
 {
-    /** List node for the search list. */
-    RTLISTNODE              NodeSearch;
+    /** AVL tree node for the search tree, the key is the L2 table offset. */
+    AVLU64NODECORE          Core;
     /** List node for the LRU list. */
     RTLISTNODE              NodeLru;
     /** Reference counter. */
@@ -204,8 +205,29 @@ typedef struct QCOWL2CACHEENTRY
     uint64_t               *paL2Tbl;
 } QCOWL2CACHEENTRY, *PQCOWL2CACHEENTRY;
 
-/** Maximum amount of memory the cache is allowed to use. */
+/** Default maximum amount of memory the cache is allowed to use,
+ * can be changed with the "L2CacheSize" config key. */
 #define QCOW_L2_CACHE_MEMORY_MAX (2*_1M)
+/** Upper limit for the configurable L2 cache size. */
+#define QCOW_L2_CACHE_MEMORY_LIMIT (512*_1M)
+
+/** Number of host clusters cached for reading compressed clusters. */
+#define QCOW_COMP_CACHE_ENTRIES (8)
+
+/**
+ * Cached host cluster holding compressed cluster data.
+ */
+typedef struct QCOWCOMPCACHEENTRY
+{
+    /** Offset of the host cluster in the image, 0 if the entry is unused. */
+    uint64_t                offHostCluster;
+    /** Number of valid bytes in the buffer. */
+    size_t                  cbValid;
+    /** Value of the use counter when the entry was accessed last, for LRU replacement. */
+    uint64_t                uLastUse;
+    /** Cluster sized data buffer, allocated on first use. */
+    uint8_t                *pbData;
+} QCOWCOMPCACHEENTRY, *PQCOWCOMPCACHEENTRY;
 
 /** QCOW default cluster size for image version 2. */
 #define QCOW2_CLUSTER_SIZE_DEFAULT (64*_1K)
@@ -283,10 +305,16 @@ typedef struct QCOWIMAGE
     uint32_t            cL2TableEntries;
     /** Memory occupied by the L2 table cache. */
     size_t              cbL2Cache;
-    /** The sorted L2 entry list used for searching. */
-    RTLISTNODE          ListSearch;
+    /** Maximum amount of memory the L2 table cache may occupy. */
+    size_t              cbL2CacheMax;
+    /** The L2 entry tree used for searching, keyed by the table offset. */
+    AVLU64TREE          TreeSearch;
     /** The LRU L2 entry list used for eviction. */
     RTLISTNODE          ListLru;
+    /** Number of L2 table lookups satisfied from the cache. */
+    uint64_t            cL2CacheHits;
+    /** Number of L2 table lookups which had to read the table from the image. */
+    uint64_t            cL2CacheMisses;
 
     /** Offset of the refcount table. */
     uint64_t            offRefcountTable;
@@ -312,6 +340,12 @@ typedef struct QCOWIMAGE
     void                *pvCompCluster;
     /** Buffer to hold the uncompressed data. */
     void                *pvCluster;
+    /** Image offset of the compressed cluster currently inflated in pvCluster, 0 if none. */
+    uint64_t            offClusterInflated;
+    /** Use counter for the compressed cluster cache. */
+    uint64_t            uCompCacheUse;
+    /** Host clusters cached for reading compressed clusters. */
+    QCOWCOMPCACHEENTRY  aCompCache[QCOW_COMP_CACHE_ENTRIES];
 
     /** Pointer to the L2 table we are currently allocating
      * (can be only one at a time). */
@@ -536,11 +570,27 @@ static void qcowTableConvertFromHostEndianess(uint64_t *paTblImg, uint64_t const
  */
 static int qcowL2TblCacheCreate(PQCOWIMAGE pImage)
 {
-    pImage->cbL2Cache = 0;
-    RTListInit(&pImage->ListSearch);
+    int rc = VINF_SUCCESS;
+    uint32_t cbL2CacheMax = QCOW_L2_CACHE_MEMORY_MAX;
+
+    PVDINTERFACECONFIG pIfCfg = VDIfConfigGet(pImage->pVDIfsImage);
+    if (pIfCfg)
+    {
+        rc = VDCFGQueryU32Def(pIfCfg, "L2CacheSize", &cbL2CacheMax, QCOW_L2_CACHE_MEMORY_MAX);
+        if (RT_FAILURE(rc))
+            return vdIfError(pImage->pIfError, rc, RT_SRC_POS,
+                             N_("QCow: Failed to query \"L2CacheSize\" for '%s'"), pImage->pszFilename);
+        cbL2CacheMax = RT_MIN(cbL2CacheMax, QCOW_L2_CACHE_MEMORY_LIMIT);
+    }
+
+    pImage->cbL2Cache      = 0;
+    pImage->cbL2CacheMax   = cbL2CacheMax;
+    pImage->TreeSearch     = NULL;
+    pImage->cL2CacheHits   = 0;
+    pImage->cL2CacheMisses = 0;
     RTListInit(&pImage->ListLru);
 
-    return VINF_SUCCESS;
+    return rc;
 }
 
 /**
@@ -550,19 +600,27 @@ static int qcowL2TblCacheCreate(PQCOWIMAGE pImage)
  */
 static void qcowL2TblCacheDestroy(PQCOWIMAGE pImage)
 {
+    if (pImage->cL2CacheHits + pImage->cL2CacheMisses)
+        LogRel(("QCow: L2 table cache of '%s': %llu hits, %llu misses, %zu of %zu bytes used\n",
+                pImage->pszFilename, pImage->cL2CacheHits, pImage->cL2CacheMisses,
+                pImage->cbL2Cache, pImage->cbL2CacheMax));
+
+    /* Every entry in the search tree is linked into the LRU list as well. */
     PQCOWL2CACHEENTRY pL2Entry;
     PQCOWL2CACHEENTRY pL2Next;
-    RTListForEachSafe(&pImage->ListSearch, pL2Entry, pL2Next, QCOWL2CACHEENTRY, NodeSearch)
+    RTListForEachSafe(&pImage->ListLru, pL2Entry, pL2Next, QCOWL2CACHEENTRY, NodeLru)
     {
         Assert(!pL2Entry->cRefs);
 
-        RTListNodeRemove(&pL2Entry->NodeSearch);
+        RTListNodeRemove(&pL2Entry->NodeLru);
         RTMemPageFree(pL2Entry->paL2Tbl, pImage->cbL2Table);
         RTMemFree(pL2Entry);
     }
 
     pImage->cbL2Cache       = 0;
-    RTListInit(&pImage->ListSearch);
+    pImage->TreeSearch      = NULL;
+    pImage->cL2CacheHits    = 0;
+    pImage->cL2CacheMisses  = 0;
     RTListInit(&pImage->ListLru);
 }
 
@@ -582,14 +640,8 @@ static PQCOWL2CACHEENTRY qcowL2TblCacheRetain(PQCOWIMAGE pImage, uint64_t offL2T
         return pImage->pL2TblAlloc;
     }
 
-    PQCOWL2CACHEENTRY pL2Entry;
-    RTListForEach(&pImage->ListSearch, pL2Entry, QCOWL2CACHEENTRY, NodeSearch)
-    {
-        if (pL2Entry->offL2Tbl == offL2Tbl)
-            break;
-    }
-
-    if (!RTListNodeIsDummy(&pImage->ListSearch, pL2Entry, QCOWL2CACHEENTRY, NodeSearch))
+    PQCOWL2CACHEENTRY pL2Entry = (PQCOWL2CACHEENTRY)RTAvlU64Get(&pImage->TreeSearch, offL2Tbl);
+    if (pL2Entry)
     {
         /* Update LRU list. */
         RTListNodeRemove(&pL2Entry->NodeLru);
@@ -622,7 +674,8 @@ static PQCOWL2CACHEENTRY qcowL2TblCacheEntryAlloc(PQCOWIMAGE pImage)
 {
     PQCOWL2CACHEENTRY pL2Entry = NULL;
 
-    if (pImage->cbL2Cache + pImage->cbL2Table <= QCOW_L2_CACHE_MEMORY_MAX)
+    if (   pImage->cbL2Cache + pImage->cbL2Table <= pImage->cbL2CacheMax
+        || RTListIsEmpty(&pImage->ListLru))
     {
         /* Add a new entry. */
         pL2Entry = (PQCOWL2CACHEENTRY)RTMemAllocZ(sizeof(QCOWL2CACHEENTRY));
@@ -652,9 +705,10 @@ static PQCOWL2CACHEENTRY qcowL2TblCacheEntryAlloc(PQCOWIMAGE pImage)
                 break;
         }
 
-        if (!RTListNodeIsDummy(&pImage->ListSearch, pL2Entry, QCOWL2CACHEENTRY, NodeSearch))
+        if (!RTListNodeIsDummy(&pImage->ListLru, pL2Entry, QCOWL2CACHEENTRY, NodeLru))
         {
-            RTListNodeRemove(&pL2Entry->NodeSearch);
+            PAVLU64NODECORE pRemoved = RTAvlU64Remove(&pImage->TreeSearch, pL2Entry->Core.Key);
+            Assert(pRemoved == &pL2Entry->Core); RT_NOREF(pRemoved);
             RTListNodeRemove(&pL2Entry->NodeLru);
             pL2Entry->offL2Tbl = 0;
             pL2Entry->cRefs    = 1;
@@ -694,34 +748,10 @@ static void qcowL2TblCacheEntryInsert(PQCOWIMAGE pImage, PQCOWL2CACHEENTRY pL2En
     /* Insert at the top of the LRU list. */
     RTListPrepend(&pImage->ListLru, &pL2Entry->NodeLru);
 
-    if (RTListIsEmpty(&pImage->ListSearch))
-    {
-        RTListAppend(&pImage->ListSearch, &pL2Entry->NodeSearch);
-    }
-    else
-    {
-        /* Insert into search list. */
-        PQCOWL2CACHEENTRY pIt;
-        pIt = RTListGetFirst(&pImage->ListSearch, QCOWL2CACHEENTRY, NodeSearch);
-        if (pIt->offL2Tbl > pL2Entry->offL2Tbl)
-            RTListPrepend(&pImage->ListSearch, &pL2Entry->NodeSearch);
-        else
-        {
-            bool fInserted = false;
-
-            RTListForEach(&pImage->ListSearch, pIt, QCOWL2CACHEENTRY, NodeSearch)
-            {
-                Assert(pIt->offL2Tbl != pL2Entry->offL2Tbl);
-                if (pIt->offL2Tbl < pL2Entry->offL2Tbl)
-                {
-                    RTListNodeInsertAfter(&pIt->NodeSearch, &pL2Entry->NodeSearch);
-                    fInserted = true;
-                    break;
-                }
-            }
-            Assert(fInserted);
-        }
-    }
+    /* Insert into search tree. */
+    pL2Entry->Core.Key = pL2Entry->offL2Tbl;
+    bool fInserted = RTAvlU64Insert(&pImage->TreeSearch, &pL2Entry->Core);
+    Assert(fInserted); RT_NOREF(fInserted);
 }
 
 /**
@@ -741,8 +771,11 @@ static int qcowL2TblCacheFetch(PQCOWIMAGE pImage, PVDIOCTX pIoCtx, uint64_t offL
 
     /* Try to fetch the L2 table from the cache first. */
     PQCOWL2CACHEENTRY pL2Entry = qcowL2TblCacheRetain(pImage, offL2Tbl);
-    if (!pL2Entry)
+    if (pL2Entry)
+        pImage->cL2CacheHits++;
+    else
     {
+        pImage->cL2CacheMisses++;
         pL2Entry = qcowL2TblCacheEntryAlloc(pImage);
 
         if (pL2Entry)
@@ -1087,6 +1120,16 @@ static int qcowFreeImage(PQCOWIMAGE pImage, bool fDelete)
         {
             RTMemFree(pImage->pvCluster);
             pImage->pvCluster = NULL;
+            pImage->offClusterInflated = 0;
+        }
+
+        for (unsigned i = 0; i < RT_ELEMENTS(pImage->aCompCache); i++)
+        {
+            if (pImage->aCompCache[i].pbData)
+                RTMemFree(pImage->aCompCache[i].pbData);
+            pImage->aCompCache[i].pbData         = NULL;
+            pImage->aCompCache[i].offHostCluster = 0;
+            pImage->aCompCache[i].cbValid        = 0;
         }
 
         qcowL2TblCacheDestroy(pImage);
@@ -1639,6 +1682,154 @@ static DECLCALLBACK(int) qcowAsyncClusterAllocUpdate(void *pBackendData, PVDIOCT
     return rc;
 }
 
+/**
+ * Returns whether a read is in flight for the given compressed cluster cache entry.
+ *
+ * @returns true if the entry is assigned to a host cluster but has no valid data yet.
+ * @param   pEntry          The cache entry.
+ */
+DECLINLINE(bool) qcowCompCacheEntryIsPending(PQCOWCOMPCACHEENTRY pEntry)
+{
+    return pEntry->offHostCluster && !pEntry->cbValid;
+}
+
+/**
+ * Reads the host cluster of the given compressed cluster cache entry from the image.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_VD_NOT_ENOUGH_METADATA if the host cluster is being read
+ *          asynchronously, the request is continued when it completes.
+ * @param   pImage          The image instance data.
+ * @param   pIoCtx          The I/O context.
+ * @param   pEntry          The cache entry, offHostCluster must be set.
+ */
+static int qcowCompCacheEntryRead(PQCOWIMAGE pImage, PVDIOCTX pIoCtx, PQCOWCOMPCACHEENTRY pEntry);
+
+/**
+ * Completion callback for asynchronous host cluster reads of the compressed cluster
+ * cache, fetches the data while the metadata transfer is still around.
+ *
+ * @returns VBox status code.
+ * @param   pBackendData    The opaque backend data.
+ * @param   pIoCtx          I/O context associated with this request.
+ * @param   pvUser          The cache entry the host cluster is read into.
+ * @param   rcReq           Status code for the completed request.
+ */
+static DECLCALLBACK(int) qcowCompCacheReadComplete(void *pBackendData, PVDIOCTX pIoCtx, void *pvUser, int rcReq)
+{
+    PQCOWIMAGE pImage = (PQCOWIMAGE)pBackendData;
+    PQCOWCOMPCACHEENTRY pEntry = (PQCOWCOMPCACHEENTRY)pvUser;
+
+    if (RT_FAILURE(rcReq))
+    {
+        if (!pEntry->cbValid)
+            pEntry->offHostCluster = 0;
+    }
+    else if (qcowCompCacheEntryIsPending(pEntry))
+    {
+        /*
+         * Fetch again, this hits the completed metadata transfer. If the entry was
+         * reused for another host cluster in the meantime the I/O context has to
+         * wait for that one as well.
+         */
+        int rc = qcowCompCacheEntryRead(pImage, pIoCtx, pEntry);
+        if (rc == VERR_VD_NOT_ENOUGH_METADATA)
+            return VERR_VD_ASYNC_IO_IN_PROGRESS;
+    }
+
+    return VINF_SUCCESS;
+}
+
+static int qcowCompCacheEntryRead(PQCOWIMAGE pImage, PVDIOCTX pIoCtx, PQCOWCOMPCACHEENTRY pEntry)
+{
+    /*
+     * The host cluster is read as one metadata transfer. Compressed clusters are not
+     * aligned and can share sectors with their neighbours, reading whole host clusters
+     * makes sure that metadata transfers never overlap while they are in flight.
+     */
+    size_t cbRead = (size_t)RT_MIN((uint64_t)pImage->cbCluster, pImage->offNextCluster - pEntry->offHostCluster);
+    PVDMETAXFER pMetaXfer = NULL;
+
+    int rc = vdIfIoIntFileReadMeta(pImage->pIfIo, pImage->pStorage, pEntry->offHostCluster,
+                                   pEntry->pbData, cbRead, pIoCtx, &pMetaXfer,
+                                   qcowCompCacheReadComplete, pEntry);
+    if (RT_SUCCESS(rc))
+    {
+        vdIfIoIntMetaXferRelease(pImage->pIfIo, pMetaXfer);
+        pEntry->cbValid  = cbRead;
+        pEntry->uLastUse = ++pImage->uCompCacheUse;
+    }
+    else if (rc != VERR_VD_NOT_ENOUGH_METADATA)
+        pEntry->offHostCluster = 0;
+
+    return rc;
+}
+
+/**
+ * Returns the compressed cluster cache entry for the given host cluster,
+ * reading it from the image on a cache miss.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_VD_NOT_ENOUGH_METADATA if the host cluster is being read
+ *          asynchronously, the request is continued when it completes.
+ * @param   pImage          The image instance data.
+ * @param   pIoCtx          The I/O context.
+ * @param   offHostCluster  Offset of the host cluster in the image.
+ * @param   ppEntry         Where to store the cache entry on success.
+ */
+static int qcowCompCacheFetch(PQCOWIMAGE pImage, PVDIOCTX pIoCtx, uint64_t offHostCluster,
+                              PQCOWCOMPCACHEENTRY *ppEntry)
+{
+    PQCOWCOMPCACHEENTRY pEntry = NULL;
+    PQCOWCOMPCACHEENTRY pVictim = NULL;
+
+    for (unsigned i = 0; i < RT_ELEMENTS(pImage->aCompCache); i++)
+    {
+        PQCOWCOMPCACHEENTRY pCur = &pImage->aCompCache[i];
+        if (pCur->offHostCluster == offHostCluster)
+        {
+            pEntry = pCur;
+            break;
+        }
+
+        /* Replace the least recently used entry, preferring ones without a read in flight. */
+        if (   !pVictim
+            || (   qcowCompCacheEntryIsPending(pVictim)
+                && !qcowCompCacheEntryIsPending(pCur))
+            || (   qcowCompCacheEntryIsPending(pVictim) == qcowCompCacheEntryIsPending(pCur)
+                && pCur->uLastUse < pVictim->uLastUse))
+            pVictim = pCur;
+    }
+
+    if (pEntry && pEntry->cbValid)
+    {
+        pEntry->uLastUse = ++pImage->uCompCacheUse;
+        *ppEntry = pEntry;
+        return VINF_SUCCESS;
+    }
+
+    if (!pEntry)
+    {
+        pEntry = pVictim;
+        if (!pEntry->pbData)
+        {
+            pEntry->pbData = (uint8_t *)RTMemAlloc(pImage->cbCluster);
+            if (RT_UNLIKELY(!pEntry->pbData))
+                return VERR_NO_MEMORY;
+        }
+
+        pEntry->offHostCluster = offHostCluster;
+        pEntry->cbValid        = 0;
+        pEntry->uLastUse       = ++pImage->uCompCacheUse;
+    }
+
+    int rc = qcowCompCacheEntryRead(pImage, pIoCtx, pEntry);
+    if (RT_SUCCESS(rc))
+        *ppEntry = pEntry;
+
+    return rc;
+}
+
 /**
  * Reads a compressed cluster, inflates it and copies the amount of data requested
  * into the given I/O context.
@@ -1657,7 +1848,15 @@ static int qcowReadCompressedCluster(PQCOWIMAGE pImage, PVDIOCTX pIoCtx,
 {
     int rc = VINF_SUCCESS;
 
-    AssertReturn(!(pImage->uOpenFlags & VD_OPEN_FLAGS_ASYNC_IO), VERR_NOT_SUPPORTED); /* Only synchronous I/O supported so far. */
+    /* Guests tend to read a cluster in several pieces, so keep the last inflated cluster around. */
+    if (   pImage->pvCluster
+        && pImage->offClusterInflated == offFile)
+    {
+        vdIfIoIntIoCtxCopyTo(pImage->pIfIo, pIoCtx,
+                             (uint8_t *)pImage->pvCluster + offCluster,
+                             cbToRead);
+        return VINF_SUCCESS;
+    }
 
     if (cbCompressedCluster > pImage->cbCompCluster)
     {
@@ -1673,11 +1872,42 @@ static int qcowReadCompressedCluster(PQCOWIMAGE pImage, PVDIOCTX pIoCtx,
 
     if (RT_SUCCESS(rc))
     {
-        rc = vdIfIoIntFileReadMeta(pImage->pIfIo, pImage->pStorage,
-                                   offFile, pImage->pvCompCluster,
-                                   cbCompressedCluster, NULL,
-                                   NULL, NULL, NULL);
-        if (RT_SUCCESS(rc))
+        /*
+         * Gather the compressed data from the host clusters it is stored in. All host
+         * clusters are requested before returning so pending reads are done in parallel.
+         */
+        size_t   cbCompressed   = 0;
+        bool     fPending       = false;
+        uint64_t offHostCluster = offFile & ~pImage->fOffsetMask;
+        while (   offHostCluster < offFile + cbCompressedCluster
+               && RT_SUCCESS(rc))
+        {
+            PQCOWCOMPCACHEENTRY pEntry = NULL;
+            rc = qcowCompCacheFetch(pImage, pIoCtx, offHostCluster, &pEntry);
+            if (RT_SUCCESS(rc))
+            {
+                uint64_t offStart = RT_MAX(offFile, offHostCluster);
+                uint64_t offEnd   = RT_MIN(offFile + cbCompressedCluster, offHostCluster + pEntry->cbValid);
+                if (offEnd > offStart)
+                {
+                    memcpy((uint8_t *)pImage->pvCompCluster + (offStart - offFile),
+                           pEntry->pbData + (offStart - offHostCluster), (size_t)(offEnd - offStart));
+                    cbCompressed = (size_t)(offEnd - offFile);
+                }
+            }
+            else if (rc == VERR_VD_NOT_ENOUGH_METADATA)
+            {
+                fPending = true;
+                rc = VINF_SUCCESS;
+            }
+
+            offHostCluster += pImage->cbCluster;
+        }
+
+        if (   RT_SUCCESS(rc)
+            && fPending)
+            rc = VERR_VD_NOT_ENOUGH_METADATA;
+        else if (RT_SUCCESS(rc))
         {
             if (!pImage->pvCluster)
             {
@@ -1690,12 +1920,14 @@ static int qcowReadCompressedCluster(PQCOWIMAGE pImage, PVDIOCTX pIoCtx,
             {
                 size_t cbDecomp = 0;
 
+                pImage->offClusterInflated = 0;
                 rc = RTZipBlockDecompress(RTZIPTYPE_ZLIB_NO_HEADER, 0 /*fFlags*/,
-                                          pImage->pvCompCluster, cbCompressedCluster, NULL,
+                                          pImage->pvCompCluster, cbCompressed, NULL,
                                           pImage->pvCluster, pImage->cbCluster, &cbDecomp);
                 if (RT_SUCCESS(rc))
                 {
                     Assert(cbDecomp == pImage->cbCluster);
+                    pImage->offClusterInflated = offFile;
                     vdIfIoIntIoCtxCopyTo(pImage->pIfIo, pIoCtx,
                                          (uint8_t *)pImage->pvCluster + offCluster,
                                          cbToRead);
@@ -1928,21 +2160,40 @@ static DECLCALLBACK(int) qcowRead(void *pBackendData, uint64_t uOffset, size_t c
 
     qcowConvertLogicalOffset(pImage, uOffset, &idxL1, &idxL2, &offCluster);
 
-    /* Clip read size to remain in the cluster. */
-    cbToRead = RT_MIN(cbToRead, pImage->cbCluster - offCluster);
-
-    /* Get offset in image. */
-    bool fCompressedCluster = false;
-    size_t cbCompressedCluster = 0;
-    rc = qcowConvertToImageOffset(pImage, pIoCtx, idxL1, idxL2, offCluster,
-                                  &offFile, &fCompressedCluster, &cbCompressedCluster);
-    if (RT_SUCCESS(rc))
+    if (!pImage->paL1Table[idxL1])
     {
-        if (!fCompressedCluster)
-            rc = vdIfIoIntFileReadUser(pImage->pIfIo, pImage->pStorage, offFile,
-                                       pIoCtx, cbToRead);
-        else
-            rc = qcowReadCompressedCluster(pImage, pIoCtx, offCluster, cbToRead, offFile, cbCompressedCluster);
+        /*
+         * No L2 table allocated, the whole range covered by this L1 entry is free.
+         * Report the run of unallocated L1 entries (up to the requested size) at once
+         * so copy and merge operations can skip sparse areas without per cluster lookups.
+         */
+        uint64_t cbL1Span = RT_BIT_64(pImage->cL1Shift);
+        uint64_t cbFree   = cbL1Span - (uOffset & (cbL1Span - 1));
+        while (   cbFree < cbToRead
+               && ++idxL1 < pImage->cL1TableEntries
+               && !pImage->paL1Table[idxL1])
+            cbFree += cbL1Span;
+        cbToRead = (size_t)RT_MIN((uint64_t)cbToRead, cbFree);
+        rc = VERR_VD_BLOCK_FREE;
+    }
+    else
+    {
+        /* Clip read size to remain in the cluster. */
+        cbToRead = RT_MIN(cbToRead, pImage->cbCluster - offCluster);
+
+        /* Get offset in image. */
+        bool fCompressedCluster = false;
+        size_t cbCompressedCluster = 0;
+        rc = qcowConvertToImageOffset(pImage, pIoCtx, idxL1, idxL2, offCluster,
+                                      &offFile, &fCompressedCluster, &cbCompressedCluster);
+        if (RT_SUCCESS(rc))
+        {
+            if (!fCompressedCluster)
+                rc = vdIfIoIntFileReadUser(pImage->pIfIo, pImage->pStorage, offFile,
+                                           pIoCtx, cbToRead);
+            else
+                rc = qcowReadCompressedCluster(pImage, pIoCtx, offCluster, cbToRead, offFile, cbCompressedCluster);
+        }
     }
 
     if (   (   RT_SUCCESS(rc)
@@ -1989,16 +2240,19 @@ static DECLCALLBACK(int) qcowWrite(void *pBackendData, uint64_t uOffset, size_t
         size_t cbCompressedCluster = 0;
         rc = qcowConvertToImageOffset(pImage, pIoCtx, idxL1, idxL2, offCluster,
                                       &offImage, &fCompressedCluster, &cbCompressedCluster);
-        if (RT_SUCCESS(rc))
-        {
-            if (!fCompressedCluster)
-                rc = vdIfIoIntFileWriteUser(pImage->pIfIo, pImage->pStorage,
-                                            offImage, pIoCtx, cbToWrite, NULL, NULL);
-            else
-                rc = VERR_NOT_SUPPORTED; /** @todo Support writing compressed clusters */
-        }
-        else if (rc == VERR_VD_BLOCK_FREE)
+        if (RT_SUCCESS(rc) && !fCompressedCluster)
+            rc = vdIfIoIntFileWriteUser(pImage->pIfIo, pImage->pStorage,
+                                        offImage, pIoCtx, cbToWrite, NULL, NULL);
+        else if (   rc == VERR_VD_BLOCK_FREE
+                 || RT_SUCCESS(rc))
         {
+            /*
+             * Compressed clusters are never modified in place. They are handled like
+             * unallocated clusters, the upper layer assembles the full cluster from the
+             * current content and it gets written to a newly allocated cluster leaving
+             * the compressed data unreferenced.
+             */
+            rc = VERR_VD_BLOCK_FREE;
             if (   cbToWrite == pImage->cbCluster
                 && !(fWrite & VD_WRITE_NO_ALLOC))
             {
@@ -39,6 +39,7 @@
 #include <iprt/asm.h>
 #include <iprt/mem.h>
 #include <iprt/file.h>
+#include <iprt/uuid.h>
 
 #include "VDBackends.h"
 
@@ -59,6 +60,10 @@
 /** Convert byte offset/size to block number/size. */
 #define VCI_BYTE2BLOCK(u)          ((u) >> 9)
 
+/** Number of blocks the bitmap (without the header) for the given number of blocks
+ * takes on the disk. */
+#define VCI_BLKMAP_BITMAP_BLOCKS(cBlocks) VCI_BYTE2BLOCK(RT_ALIGN_64(((cBlocks) + 7) / 8, VCI_BLOCK_SIZE))
+
 /**
  * The VCI header - at the beginning of the file.
  *
@@ -325,6 +330,8 @@ typedef struct VCICACHEEXTENT
     uint32_t    u32Blocks;
     /** First block in the image where the data is stored. */
     uint64_t    u64BlockAddr;
+    /** Flag whether the data is still being written, reads are not served from it then. */
+    bool        fPending;
 } VCICACHEEXTENT, *PVCICACHEEXTENT;
 
 /**
@@ -342,6 +349,46 @@ typedef struct VCITREENODELEAF
     VCICACHEEXTENT          aExtents[VCI_TREE_EXTENTS_PER_NODE];
 } VCITREENODELEAF, *PVCITREENODELEAF;
 
+/**
+ * Range of data blocks waiting to be freed until transfers which might still
+ * access it completed.
+ */
+typedef struct VCIBLKFREEDEFERRED
+{
+    /** Next entry in the list. */
+    struct VCIBLKFREEDEFERRED *pNext;
+    /** Start address of the range. */
+    uint64_t                   offBlockAddr;
+    /** Number of blocks in the range. */
+    uint32_t                   cBlocks;
+    /** I/O epoch the range was freed in. */
+    uint32_t                   uIoEpoch;
+} VCIBLKFREEDEFERRED, *PVCIBLKFREEDEFERRED;
+
+/**
+ * Blocks of a tree node which was removed, reused for new tree nodes only.
+ */
+typedef struct VCITREENODEFREE
+{
+    /** Next entry in the list. */
+    struct VCITREENODEFREE *pNext;
+    /** Block address of the node. */
+    uint64_t                offBlockAddr;
+} VCITREENODEFREE, *PVCITREENODEFREE;
+
+/**
+ * Data write for a new cache extent in progress.
+ */
+typedef struct VCIEXTENTWRITE
+{
+    /** First block of cached data the extent represents. */
+    uint64_t    u64BlockOffset;
+    /** First block in the image where the data is stored. */
+    uint64_t    u64BlockAddr;
+    /** Index of the I/O epoch the write was started in. */
+    uint32_t    idxIoEpoch;
+} VCIEXTENTWRITE, *PVCIEXTENTWRITE;
+
 /**
  * VCI image data structure.
  */
@@ -376,6 +423,35 @@ typedef struct VCICACHE
     uint64_t          offBlksBitmap;
     /** Block map. */
     PVCIBLKMAP        pBlkMap;
+    /** Size of the block map on the disk in blocks. */
+    uint32_t          cBlkMap;
+    /** Flag whether updating the cache failed and it must not be used anymore. */
+    bool              fBroken;
+    /** Block offset where looking for extents to evict continues. */
+    uint64_t          offBlockEvict;
+
+    /** Current I/O epoch, data blocks freed in an epoch are reused only after
+     * all data transfers started in that and earlier epochs completed. */
+    uint32_t          uIoEpoch;
+    /** Number of data transfers pending, indexed by the lowest bit of the epoch
+     * they were started in. */
+    uint32_t          acIoPending[2];
+    /** Head of the list of data blocks waiting to be freed, oldest first. */
+    PVCIBLKFREEDEFERRED pFreeDeferredHead;
+    /** Tail of the list of data blocks waiting to be freed. */
+    PVCIBLKFREEDEFERRED pFreeDeferredTail;
+    /** Number of data blocks waiting to be freed. */
+    uint64_t          cBlocksFreeDeferred;
+    /** List of free tree node blocks. */
+    PVCITREENODEFREE  pNodeFreeHead;
+    /** Number of entries in the list of free tree node blocks. */
+    uint32_t          cNodesFree;
+
+    /** UUID of the cache. */
+    RTUUID            Uuid;
+    /** Modification UUID of the cache, matches the one of the cached image
+     * as long as the cache is up to date. */
+    RTUUID            UuidModification;
 } VCICACHE, *PVCICACHE;
 
 /** No block free in bitmap error code. */
@@ -386,6 +462,14 @@ typedef struct VCICACHE
 #define VCIBLKMAP_ALLOC_META RT_BIT(0)
 #define VCIBLKMAP_ALLOC_MASK 0x1
 
+/** Maximum number of blocks cached by one write, limits the size of an extent. */
+#define VCI_WRITE_BLOCKS_MAX     VCI_BYTE2BLOCK(_256K)
+/** Number of free blocks kept for tree nodes, enough to split a tree deeper
+ * than any which fits into a cache file. */
+#define VCI_BLKMAP_META_RESERVE  (8 * VCI_BYTE2BLOCK(sizeof(VciTreeNode)))
+/** Maximum number of extents evicted to make room for a single write. */
+#define VCI_EVICT_EXTENTS_MAX    16
+
 
 /*********************************************************************************************************************************
 *   Static Variables                                                                                                             *
@@ -403,6 +487,13 @@ static const char *const s_apszVciFileExtensions[] =
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
 
+static int vciBlkMapSave(PVCIBLKMAP pBlkMap, PVCICACHE pStorage, uint64_t offBlkMap, uint32_t cBlkMap);
+static void vciBlkMapDestroy(PVCIBLKMAP pBlkMap);
+static void vciBlkMapFree(PVCIBLKMAP pBlkMap, uint64_t offBlockAddr, uint32_t cBlocks,
+                          uint32_t fFlags);
+static void vciTreeDestroy(PVCITREENODE pNode);
+
+
 /**
  * Internal. Flush image data to disk.
  */
@@ -419,6 +510,215 @@ static int vciFlushImage(PVCICACHE pCache)
     return rc;
 }
 
+/**
+ * Internal. Updates the shutdown state in the header and flushes it to the disk.
+ *
+ * The cache is marked as uncleanly shut down while it is opened for writing,
+ * so the content of a cache which was not closed properly (host crash, power
+ * loss) is never trusted again as the metadata might not match the data.
+ *
+ * @returns VBox status code.
+ * @param   pCache    The cache instance data.
+ * @param   fClean    Flag whether to mark the cache as cleanly shut down.
+ */
+static int vciHdrSetShutdownState(PVCICACHE pCache, bool fClean)
+{
+    uint8_t bState = fClean ? VCI_HDR_CLEAN_SHUTDOWN : VCI_HDR_UNCLEAN_SHUTDOWN;
+
+    /* Clean shutdown must only be recorded once everything else is on the disk. */
+    int rc = VINF_SUCCESS;
+    if (fClean)
+        rc = vciFlushImage(pCache);
+    if (RT_SUCCESS(rc))
+        rc = vdIfIoIntFileWriteSync(pCache->pIfIo, pCache->pStorage, RT_UOFFSETOF(VciHdr, fUncleanShutdown),
+                                    &bState, sizeof(bState));
+    if (RT_SUCCESS(rc))
+        rc = vciFlushImage(pCache);
+
+    return rc;
+}
+
+/**
+ * Internal. Writes the given UUID into the header field at the given offset.
+ *
+ * @returns VBox status code.
+ * @param   pCache    The cache instance data.
+ * @param   offField  Offset of the UUID field in the header.
+ * @param   pUuid     The UUID to write.
+ */
+static int vciHdrWriteUuid(PVCICACHE pCache, uint32_t offField, PCRTUUID pUuid)
+{
+    return vdIfIoIntFileWriteSync(pCache->pIfIo, pCache->pStorage, offField, pUuid, sizeof(*pUuid));
+}
+
+/**
+ * Internal. Stops using the cache after updating it failed.
+ *
+ * Reads are not served from the cache anymore because it might hold stale data
+ * now, and it stays marked as uncleanly shut down so it isn't trusted on the
+ * next open either.
+ *
+ * @param   pCache    The cache instance data.
+ * @param   rc        The status code of the failed update.
+ */
+static void vciSetBroken(PVCICACHE pCache, int rc)
+{
+    if (!pCache->fBroken)
+    {
+        LogRel(("VCI: Updating cache '%s' failed with %Rrc, not using it anymore\n",
+                pCache->pszFilename, rc));
+        pCache->fBroken = true;
+    }
+}
+
+/**
+ * Internal. Frees the data blocks waiting for transfers which might still access
+ * them to complete, starting a new I/O epoch if possible.
+ *
+ * @param   pCache    The cache instance data.
+ * @param   fAll      Flag whether to free everything because no transfer is pending.
+ */
+static void vciIoEpochProcess(PVCICACHE pCache, bool fAll)
+{
+    for (;;)
+    {
+        PVCIBLKFREEDEFERRED pFree;
+
+        /*
+         * Transfers of the last but one epoch completed before the current one
+         * was started, so only the ones of the previous epoch need checking.
+         */
+        while (   (pFree = pCache->pFreeDeferredHead) != NULL
+               && (   fAll
+                   || pCache->uIoEpoch - pFree->uIoEpoch >= 2
+                   || (   pCache->uIoEpoch - pFree->uIoEpoch == 1
+                       && !pCache->acIoPending[pFree->uIoEpoch & 1])))
+        {
+            pCache->pFreeDeferredHead = pFree->pNext;
+            if (!pFree->pNext)
+                pCache->pFreeDeferredTail = NULL;
+            pCache->cBlocksFreeDeferred -= pFree->cBlocks;
+
+            vciBlkMapFree(pCache->pBlkMap, pFree->offBlockAddr, pFree->cBlocks, VCIBLKMAP_ALLOC_DATA);
+            RTMemFree(pFree);
+        }
+
+        /* Start a new epoch for blocks freed in the current one once the slot is unused. */
+        if (   pCache->pFreeDeferredTail
+            && pCache->pFreeDeferredTail->uIoEpoch == pCache->uIoEpoch
+            && !pCache->acIoPending[(pCache->uIoEpoch + 1) & 1])
+            pCache->uIoEpoch++;
+        else
+            break;
+    }
+}
+
+/**
+ * Internal. Frees the given data blocks once no transfer started so far can
+ * access them anymore.
+ *
+ * @param   pCache          The cache instance data.
+ * @param   offBlockAddr    Address of the first block to free.
+ * @param   cBlocks         How many blocks to free.
+ */
+static void vciBlkFreeDeferred(PVCICACHE pCache, uint64_t offBlockAddr, uint32_t cBlocks)
+{
+    PVCIBLKFREEDEFERRED pFree = (PVCIBLKFREEDEFERRED)RTMemAllocZ(sizeof(VCIBLKFREEDEFERRED));
+
+    /* The blocks stay allocated if there is no memory to remember them. */
+    if (pFree)
+    {
+        pFree->offBlockAddr = offBlockAddr;
+        pFree->cBlocks      = cBlocks;
+        pFree->uIoEpoch     = pCache->uIoEpoch;
+        if (pCache->pFreeDeferredTail)
+            pCache->pFreeDeferredTail->pNext = pFree;
+        else
+            pCache->pFreeDeferredHead = pFree;
+        pCache->pFreeDeferredTail = pFree;
+        pCache->cBlocksFreeDeferred += cBlocks;
+
+        vciIoEpochProcess(pCache, false /* fAll */);
+    }
+}
+
+/**
+ * Internal. Returns all blocks waiting to be freed to the block map, no
+ * transfer must be pending.
+ *
+ * @param   pCache    The cache instance data.
+ */
+static void vciBlkFreeAll(PVCICACHE pCache)
+{
+    Assert(!pCache->acIoPending[0] && !pCache->acIoPending[1]);
+
+    vciIoEpochProcess(pCache, true /* fAll */);
+
+    while (pCache->pNodeFreeHead)
+    {
+        PVCITREENODEFREE pFree = pCache->pNodeFreeHead;
+
+        pCache->pNodeFreeHead = pFree->pNext;
+        vciBlkMapFree(pCache->pBlkMap, pFree->offBlockAddr, VCI_BYTE2BLOCK(sizeof(VciTreeNode)),
+                      VCIBLKMAP_ALLOC_META);
+        RTMemFree(pFree);
+    }
+    pCache->cNodesFree = 0;
+}
+
+/**
+ * Internal. Completion callback for data transfers from and to the cache.
+ */
+static DECLCALLBACK(int) vciIoComplete(void *pBackendData, PVDIOCTX pIoCtx, void *pvUser, int rcReq)
+{
+    RT_NOREF1(pIoCtx);
+    PVCICACHE pCache = (PVCICACHE)pBackendData;
+    unsigned idxIoEpoch = (unsigned)(uintptr_t)pvUser;
+
+    Assert(pCache->acIoPending[idxIoEpoch]);
+    pCache->acIoPending[idxIoEpoch]--;
+
+    if (RT_FAILURE(rcReq))
+        vciSetBroken(pCache, rcReq);
+
+    vciIoEpochProcess(pCache, false /* fAll */);
+    return VINF_SUCCESS;
+}
+
+/**
+ * Internal. Completion callback for metadata writes to the cache.
+ */
+static DECLCALLBACK(int) vciMetaXferComplete(void *pBackendData, PVDIOCTX pIoCtx, void *pvUser, int rcReq)
+{
+    RT_NOREF2(pIoCtx, pvUser);
+    PVCICACHE pCache = (PVCICACHE)pBackendData;
+
+    /* The tree on the disk doesn't match the one in memory anymore. */
+    if (RT_FAILURE(rcReq))
+        vciSetBroken(pCache, rcReq);
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * Internal. Writes the offset of the tree root to the header.
+ *
+ * @returns VBox status code.
+ * @param   pCache    The cache instance data.
+ * @param   pIoCtx    The I/O context the write belongs to.
+ */
+static int vciHdrWriteTreeRoot(PVCICACHE pCache, PVDIOCTX pIoCtx)
+{
+    uint64_t offTreeRoot = RT_H2LE_U64(pCache->offTreeRoot);
+
+    int rc = vdIfIoIntFileWriteMeta(pCache->pIfIo, pCache->pStorage, RT_UOFFSETOF(VciHdr, offTreeRoot),
+                                    &offTreeRoot, sizeof(offTreeRoot), pIoCtx,
+                                    vciMetaXferComplete, NULL);
+    if (rc == VERR_VD_ASYNC_IO_IN_PROGRESS)
+        rc = VINF_SUCCESS;
+    return rc;
+}
+
 /**
  * Internal. Free all allocated space for representing an image except pCache,
  * and optionally delete the image from disk.
@@ -433,14 +733,42 @@ static int vciFreeImage(PVCICACHE pCache, bool fDelete)
     {
         if (pCache->pStorage)
         {
-            /* No point updating the file that is deleted anyway. */
+            /* No point updating the file that is deleted anyway. A cache which
+             * wasn't opened completely or is broken stays marked as unclean. */
+            if (pCache->pBlkMap)
+                vciBlkFreeAll(pCache);
+
             if (!fDelete)
-                vciFlushImage(pCache);
+            {
+                if (   !(pCache->uOpenFlags & VD_OPEN_FLAGS_READONLY)
+                    && pCache->pBlkMap
+                    && pCache->pRoot
+                    && !pCache->fBroken)
+                {
+                    rc = vciBlkMapSave(pCache->pBlkMap, pCache, pCache->offBlksBitmap, pCache->cBlkMap);
+                    if (RT_SUCCESS(rc))
+                        rc = vciHdrSetShutdownState(pCache, true /* fClean */);
+                }
+                else
+                    vciFlushImage(pCache);
+            }
 
             vdIfIoIntFileClose(pCache->pIfIo, pCache->pStorage);
             pCache->pStorage = NULL;
         }
 
+        if (pCache->pRoot)
+        {
+            vciTreeDestroy(pCache->pRoot);
+            pCache->pRoot = NULL;
+        }
+
+        if (pCache->pBlkMap)
+        {
+            vciBlkMapDestroy(pCache->pBlkMap);
+            pCache->pBlkMap = NULL;
+        }
+
         if (fDelete && pCache->pszFilename)
             vdIfIoIntFileDelete(pCache->pIfIo, pCache->pszFilename);
     }
@@ -463,7 +791,7 @@ static int vciFreeImage(PVCICACHE pCache, bool fDelete)
 static int vciBlkMapCreate(uint64_t cBlocks, PVCIBLKMAP *ppBlkMap, uint32_t *pcBlkMap)
 {
     int rc = VINF_SUCCESS;
-    uint32_t cbBlkMap = RT_ALIGN_Z(cBlocks / sizeof(VciBlkMapEnt) / 8, VCI_BLOCK_SIZE);
+    uint32_t cbBlkMap = (uint32_t)VCI_BLOCK2BYTE(VCI_BLKMAP_BITMAP_BLOCKS(cBlocks));
     PVCIBLKMAP pBlkMap = (PVCIBLKMAP)RTMemAllocZ(sizeof(VCIBLKMAP));
     PVCIBLKRANGEDESC pFree   = (PVCIBLKRANGEDESC)RTMemAllocZ(sizeof(VCIBLKRANGEDESC));
 
@@ -503,7 +831,6 @@ static int vciBlkMapCreate(uint64_t cBlocks, PVCIBLKMAP *ppBlkMap, uint32_t *pcB
     return rc;
 }
 
-#if 0 /** @todo unsued vciBlkMapDestroy */
 /**
  * Frees a block map.
  *
@@ -519,16 +846,15 @@ static void vciBlkMapDestroy(PVCIBLKMAP pBlkMap)
     {
         PVCIBLKRANGEDESC pTmp = pRangeCur;
 
-        RTMemFree(pTmp);
-
         pRangeCur = pRangeCur->pNext;
+
+        RTMemFree(pTmp);
     }
 
     RTMemFree(pBlkMap);
 
     LogFlowFunc(("returns\n"));
 }
-#endif
 
 /**
  * Loads the block map from the specified medium and creates all necessary
@@ -552,23 +878,23 @@ static int vciBlkMapLoad(PVCICACHE pStorage, uint64_t offBlkMap, uint32_t cBlkMa
     {
         cBlkMap -= VCI_BYTE2BLOCK(sizeof(VciBlkMap));
 
-        rc = vdIfIoIntFileReadSync(pStorage->pIfIo, pStorage->pStorage, offBlkMap,
-                                   &BlkMap, VCI_BYTE2BLOCK(sizeof(VciBlkMap)));
+        rc = vdIfIoIntFileReadSync(pStorage->pIfIo, pStorage->pStorage, VCI_BLOCK2BYTE(offBlkMap),
+                                   &BlkMap, sizeof(VciBlkMap));
         if (RT_SUCCESS(rc))
         {
             offBlkMap += VCI_BYTE2BLOCK(sizeof(VciBlkMap));
 
             BlkMap.u32Magic         = RT_LE2H_U32(BlkMap.u32Magic);
             BlkMap.u32Version       = RT_LE2H_U32(BlkMap.u32Version);
-            BlkMap.cBlocks          = RT_LE2H_U32(BlkMap.cBlocks);
-            BlkMap.cBlocksFree      = RT_LE2H_U32(BlkMap.cBlocksFree);
-            BlkMap.cBlocksAllocMeta = RT_LE2H_U32(BlkMap.cBlocksAllocMeta);
-            BlkMap.cBlocksAllocData = RT_LE2H_U32(BlkMap.cBlocksAllocData);
+            BlkMap.cBlocks          = RT_LE2H_U64(BlkMap.cBlocks);
+            BlkMap.cBlocksFree      = RT_LE2H_U64(BlkMap.cBlocksFree);
+            BlkMap.cBlocksAllocMeta = RT_LE2H_U64(BlkMap.cBlocksAllocMeta);
+            BlkMap.cBlocksAllocData = RT_LE2H_U64(BlkMap.cBlocksAllocData);
 
             if (   BlkMap.u32Magic == VCI_BLKMAP_MAGIC
                 && BlkMap.u32Version == VCI_BLKMAP_VERSION
                 && BlkMap.cBlocks == BlkMap.cBlocksFree + BlkMap.cBlocksAllocMeta + BlkMap.cBlocksAllocData
-                && VCI_BYTE2BLOCK(BlkMap.cBlocks / 8) == cBlkMap)
+                && VCI_BLKMAP_BITMAP_BLOCKS(BlkMap.cBlocks) == cBlkMap)
             {
                 PVCIBLKMAP pBlkMap = (PVCIBLKMAP)RTMemAllocZ(sizeof(VCIBLKMAP));
                 if (pBlkMap)
@@ -584,14 +910,13 @@ static int vciBlkMapLoad(PVCICACHE pStorage, uint64_t offBlkMap, uint32_t cBlkMa
                     if (pRangeCur)
                     {
                         uint8_t abBitmapBuffer[16 * _1K];
-                        uint32_t cBlocksRead = 0;
-                        uint64_t cBlocksLeft = VCI_BYTE2BLOCK(pBlkMap->cBlocks / 8);
+                        uint64_t cBlocksLeft = VCI_BLKMAP_BITMAP_BLOCKS(pBlkMap->cBlocks);
+                        uint64_t cBitsLeft   = pBlkMap->cBlocks; /* The padding at the end is ignored. */
+                        uint32_t cBlocksRead = (uint32_t)RT_MIN(VCI_BYTE2BLOCK(sizeof(abBitmapBuffer)), cBlocksLeft);
 
-                        cBlocksRead = RT_MIN(VCI_BYTE2BLOCK(sizeof(abBitmapBuffer)), cBlocksLeft);
                         rc = vdIfIoIntFileReadSync(pStorage->pIfIo, pStorage->pStorage,
-                                                   offBlkMap, abBitmapBuffer,
-                                                   cBlocksRead);
-
+                                                   VCI_BLOCK2BYTE(offBlkMap), abBitmapBuffer,
+                                                   VCI_BLOCK2BYTE(cBlocksRead));
                         if (RT_SUCCESS(rc))
                         {
                             pRangeCur->fFree        = !(abBitmapBuffer[0] & 0x01);
@@ -608,34 +933,14 @@ static int vciBlkMapLoad(PVCICACHE pStorage, uint64_t offBlkMap, uint32_t cBlkMa
                         while (   RT_SUCCESS(rc)
                                && cBlocksLeft)
                         {
-                            int iBit = 0;
-                            uint32_t cBits = VCI_BLOCK2BYTE(cBlocksRead) * 8;
-                            uint32_t iBitPrev = 0xffffffff;
+                            uint32_t cBits = (uint32_t)RT_MIN(VCI_BLOCK2BYTE(cBlocksRead) * 8, cBitsLeft);
 
-                            while (cBits)
+                            for (uint32_t iBit = 0; iBit < cBits; iBit++)
                             {
-                                if (pRangeCur->fFree)
-                                {
-                                    /* Check for the first set bit. */
-                                    iBit = ASMBitNextSet(abBitmapBuffer, cBits, iBitPrev);
-                                }
-                                else
-                                {
-                                    /* Check for the first free bit. */
-                                    iBit = ASMBitNextClear(abBitmapBuffer, cBits, iBitPrev);
-                                }
+                                bool fFree = !ASMBitTest(abBitmapBuffer, (int32_t)iBit);
 
-                                if (iBit == -1)
+                                if (fFree != pRangeCur->fFree)
                                 {
-                                    /* No change. */
-                                    pRangeCur->cBlocks += cBits;
-                                    cBits = 0;
-                                }
-                                else
-                                {
-                                    Assert((uint32_t)iBit < cBits);
-                                    pRangeCur->cBlocks += iBit;
-
                                     /* Create a new range descriptor. */
                                     PVCIBLKRANGEDESC pRangeNew = (PVCIBLKRANGEDESC)RTMemAllocZ(sizeof(VCIBLKRANGEDESC));
                                     if (!pRangeNew)
@@ -644,18 +949,19 @@ static int vciBlkMapLoad(PVCICACHE pStorage, uint64_t offBlkMap, uint32_t cBlkMa
                                         break;
                                     }
 
-                                    pRangeNew->fFree = !pRangeCur->fFree;
+                                    pRangeNew->fFree = fFree;
                                     pRangeNew->offAddrStart = pRangeCur->offAddrStart + pRangeCur->cBlocks;
                                     pRangeNew->cBlocks = 0;
                                     pRangeNew->pPrev = pRangeCur;
                                     pRangeCur->pNext = pRangeNew;
                                     pBlkMap->pRangesTail = pRangeNew;
                                     pRangeCur = pRangeNew;
-                                    cBits -= iBit;
-                                    iBitPrev = iBit;
                                 }
+
+                                pRangeCur->cBlocks++;
                             }
 
+                            cBitsLeft   -= cBits;
                             cBlocksLeft -= cBlocksRead;
                             offBlkMap   += cBlocksRead;
 
@@ -663,9 +969,10 @@ static int vciBlkMapLoad(PVCICACHE pStorage, uint64_t offBlkMap, uint32_t cBlkMa
                                 && cBlocksLeft)
                             {
                                 /* Read next chunk. */
-                                cBlocksRead = RT_MIN(VCI_BYTE2BLOCK(sizeof(abBitmapBuffer)), cBlocksLeft);
+                                cBlocksRead = (uint32_t)RT_MIN(VCI_BYTE2BLOCK(sizeof(abBitmapBuffer)), cBlocksLeft);
                                 rc = vdIfIoIntFileReadSync(pStorage->pIfIo, pStorage->pStorage,
-                                                           offBlkMap, abBitmapBuffer, cBlocksRead);
+                                                           VCI_BLOCK2BYTE(offBlkMap), abBitmapBuffer,
+                                                           VCI_BLOCK2BYTE(cBlocksRead));
                             }
                         }
                     }
@@ -716,20 +1023,20 @@ static int vciBlkMapSave(PVCIBLKMAP pBlkMap, PVCICACHE pStorage, uint64_t offBlk
                  pBlkMap, pStorage, offBlkMap, cBlkMap));
 
     /* Make sure the number of blocks allocated for us match our expectations. */
-    if (VCI_BYTE2BLOCK(pBlkMap->cBlocks / 8) + VCI_BYTE2BLOCK(sizeof(VciBlkMap)) == cBlkMap)
+    if (VCI_BLKMAP_BITMAP_BLOCKS(pBlkMap->cBlocks) + VCI_BYTE2BLOCK(sizeof(VciBlkMap)) == cBlkMap)
     {
         /* Setup the header */
         memset(&BlkMap, 0, sizeof(VciBlkMap));
 
         BlkMap.u32Magic         = RT_H2LE_U32(VCI_BLKMAP_MAGIC);
         BlkMap.u32Version       = RT_H2LE_U32(VCI_BLKMAP_VERSION);
-        BlkMap.cBlocks          = RT_H2LE_U32(pBlkMap->cBlocks);
-        BlkMap.cBlocksFree      = RT_H2LE_U32(pBlkMap->cBlocksFree);
-        BlkMap.cBlocksAllocMeta = RT_H2LE_U32(pBlkMap->cBlocksAllocMeta);
-        BlkMap.cBlocksAllocData = RT_H2LE_U32(pBlkMap->cBlocksAllocData);
+        BlkMap.cBlocks          = RT_H2LE_U64(pBlkMap->cBlocks);
+        BlkMap.cBlocksFree      = RT_H2LE_U64(pBlkMap->cBlocksFree);
+        BlkMap.cBlocksAllocMeta = RT_H2LE_U64(pBlkMap->cBlocksAllocMeta);
+        BlkMap.cBlocksAllocData = RT_H2LE_U64(pBlkMap->cBlocksAllocData);
 
-        rc = vdIfIoIntFileWriteSync(pStorage->pIfIo, pStorage->pStorage, offBlkMap,
-                                    &BlkMap, VCI_BYTE2BLOCK(sizeof(VciBlkMap)));
+        rc = vdIfIoIntFileWriteSync(pStorage->pIfIo, pStorage->pStorage, VCI_BLOCK2BYTE(offBlkMap),
+                                    &BlkMap, sizeof(VciBlkMap));
         if (RT_SUCCESS(rc))
         {
             uint8_t abBitmapBuffer[16*_1K];
@@ -759,8 +1066,8 @@ static int vciBlkMapSave(PVCIBLKMAP pBlkMap, PVCICACHE pStorage, uint64_t offBlk
                     {
                         /* Buffer is full, write to file and reset. */
                         rc = vdIfIoIntFileWriteSync(pStorage->pIfIo, pStorage->pStorage,
-                                                    offBlkMap, abBitmapBuffer,
-                                                    VCI_BYTE2BLOCK(sizeof(abBitmapBuffer)));
+                                                    VCI_BLOCK2BYTE(offBlkMap), abBitmapBuffer,
+                                                    sizeof(abBitmapBuffer));
                         if (RT_FAILURE(rc))
                             break;
 
@@ -772,11 +1079,15 @@ static int vciBlkMapSave(PVCIBLKMAP pBlkMap, PVCICACHE pStorage, uint64_t offBlk
                 pCur = pCur->pNext;
             }
 
-            Assert(iBit % 8 == 0);
-
             if (RT_SUCCESS(rc) && iBit)
+            {
+                /* Clear the padding up to the next block boundary and write the rest. */
+                uint32_t cbLast = RT_ALIGN_32((iBit + 7) / 8, VCI_BLOCK_SIZE);
+                if (iBit < cbLast * 8)
+                    ASMBitClearRange(abBitmapBuffer, iBit, cbLast * 8);
                 rc = vdIfIoIntFileWriteSync(pStorage->pIfIo, pStorage->pStorage,
-                                            offBlkMap, abBitmapBuffer, VCI_BYTE2BLOCK(iBit / 8));
+                                            VCI_BLOCK2BYTE(offBlkMap), abBitmapBuffer, cbLast);
+            }
         }
     }
     else
@@ -786,7 +1097,6 @@ static int vciBlkMapSave(PVCIBLKMAP pBlkMap, PVCICACHE pStorage, uint64_t offBlk
     return rc;
 }
 
-#if 0 /* unused */
 /**
  * Finds the range block describing the given block address.
  *
@@ -799,12 +1109,45 @@ static PVCIBLKRANGEDESC vciBlkMapFindByBlock(PVCIBLKMAP pBlkMap, uint64_t offBlo
     PVCIBLKRANGEDESC pBlk = pBlkMap->pRangesHead;
 
     while (   pBlk
-           && pBlk->offAddrStart < offBlockAddr)
+           && pBlk->offAddrStart + pBlk->cBlocks <= offBlockAddr)
         pBlk = pBlk->pNext;
 
     return pBlk;
 }
-#endif
+
+/**
+ * Splits the given range block in two.
+ *
+ * @returns Pointer to the new range block describing the upper part, NULL if out of memory.
+ * @param   pBlkMap         The block bitmap.
+ * @param   pBlk            The range block to split.
+ * @param   cBlocks         Number of blocks remaining in the lower part.
+ */
+static PVCIBLKRANGEDESC vciBlkMapRangeSplit(PVCIBLKMAP pBlkMap, PVCIBLKRANGEDESC pBlk, uint64_t cBlocks)
+{
+    PVCIBLKRANGEDESC pBlkNew = (PVCIBLKRANGEDESC)RTMemAllocZ(sizeof(VCIBLKRANGEDESC));
+
+    Assert(cBlocks && cBlocks < pBlk->cBlocks);
+
+    if (pBlkNew)
+    {
+        pBlkNew->fFree        = pBlk->fFree;
+        pBlkNew->offAddrStart = pBlk->offAddrStart + cBlocks;
+        pBlkNew->cBlocks      = pBlk->cBlocks - cBlocks;
+        pBlk->cBlocks         = cBlocks;
+
+        /* Link into the list. */
+        pBlkNew->pNext = pBlk->pNext;
+        pBlkNew->pPrev = pBlk;
+        pBlk->pNext    = pBlkNew;
+        if (pBlkNew->pNext)
+            pBlkNew->pNext->pPrev = pBlkNew;
+        else
+            pBlkMap->pRangesTail = pBlkNew;
+    }
+
+    return pBlkNew;
+}
 
 /**
  * Allocates the given number of blocks in the bitmap and returns the start block address.
@@ -849,6 +1192,7 @@ static int vciBlkMapAllocate(PVCIBLKMAP pBlkMap, uint32_t cBlocks, uint32_t fFla
     if (pBestFit)
     {
         pBestFit->fFree = false;
+        *poffBlockAddr = pBestFit->offAddrStart;
 
         if (pBestFit->cBlocks > cBlocks)
         {
@@ -866,10 +1210,10 @@ static int vciBlkMapAllocate(PVCIBLKMAP pBlkMap, uint32_t cBlocks, uint32_t fFla
                 pFree->pNext = pBestFit->pNext;
                 pBestFit->pNext = pFree;
                 pFree->pPrev    = pBestFit;
-                if (!pFree->pNext)
+                if (pFree->pNext)
+                    pFree->pNext->pPrev = pFree;
+                else
                     pBlkMap->pRangesTail = pFree;
-
-                *poffBlockAddr = pBestFit->offAddrStart;
             }
             else
             {
@@ -884,9 +1228,9 @@ static int vciBlkMapAllocate(PVCIBLKMAP pBlkMap, uint32_t cBlocks, uint32_t fFla
     if (RT_SUCCESS(rc))
     {
         if ((fFlags & VCIBLKMAP_ALLOC_MASK) == VCIBLKMAP_ALLOC_DATA)
-            pBlkMap->cBlocksAllocMeta += cBlocks;
-        else
             pBlkMap->cBlocksAllocData += cBlocks;
+        else
+            pBlkMap->cBlocksAllocMeta += cBlocks;
 
         pBlkMap->cBlocksFree -= cBlocks;
     }
@@ -921,10 +1265,12 @@ static int vciBlkMapRealloc(PVCIBLKMAP pBlkMap, uint32_t cBlocksNew, uint64_t of
 }
 #endif /* unused */
 
-#if 0 /* unused */
 /**
  * Frees a range of blocks.
  *
+ * The range may be part of a larger allocated range, e.g. because adjacent
+ * allocations are merged when the block map is loaded.
+ *
  * @param   pBlkMap          The block bitmap.
  * @param   offBlockAddr     Address of the first block to free.
  * @param   cBlocks          How many blocks to free.
@@ -934,6 +1280,7 @@ static void vciBlkMapFree(PVCIBLKMAP pBlkMap, uint64_t offBlockAddr, uint32_t cB
                           uint32_t fFlags)
 {
     PVCIBLKRANGEDESC pBlk;
+    uint64_t cBlocksFreed = 0;
 
     LogFlowFunc(("pBlkMap=%#p offBlockAddr=%llu cBlocks=%u\n",
                  pBlkMap, offBlockAddr, cBlocks));
@@ -941,68 +1288,71 @@ static void vciBlkMapFree(PVCIBLKMAP pBlkMap, uint64_t offBlockAddr, uint32_t cB
     while (cBlocks)
     {
         pBlk = vciBlkMapFindByBlock(pBlkMap, offBlockAddr);
-        AssertPtr(pBlk);
+        AssertPtrBreak(pBlk);
+        AssertBreak(!pBlk->fFree);
 
-        /* Easy case, the whole block is freed. */
-        if (   pBlk->offAddrStart == offBlockAddr
-            && pBlk->cBlocks <= cBlocks)
+        /* Split off the parts before and after the range which remain allocated. */
+        if (pBlk->offAddrStart < offBlockAddr)
         {
-            pBlk->fFree = true;
-            cBlocks      -= pBlk->cBlocks;
-            offBlockAddr += pBlk->cBlocks;
-
-            /* Check if it is possible to merge free blocks. */
-            if (   pBlk->pPrev
-                && pBlk->pPrev->fFree)
-            {
-                PVCIBLKRANGEDESC pBlkPrev = pBlk->pPrev;
+            pBlk = vciBlkMapRangeSplit(pBlkMap, pBlk, offBlockAddr - pBlk->offAddrStart);
+            if (!pBlk)
+                break; /* The blocks stay allocated. */
+        }
 
-                Assert(pBlkPrev->offAddrStart + pBlkPrev->cBlocks == pBlk->offAddrStart);
-                pBlkPrev->cBlocks += pBlk->cBlocks;
-                pBlkPrev->pNext = pBlk->pNext;
-                if (pBlk->pNext)
-                    pBlk->pNext->pPrev = pBlkPrev;
-                else
-                    pBlkMap->pRangesTail = pBlkPrev;
+        if (   pBlk->cBlocks > cBlocks
+            && !vciBlkMapRangeSplit(pBlkMap, pBlk, cBlocks))
+            break;
 
-                RTMemFree(pBlk);
-                pBlk = pBlkPrev;
-            }
+        pBlk->fFree = true;
+        cBlocks      -= (uint32_t)pBlk->cBlocks;
+        offBlockAddr += pBlk->cBlocks;
+        cBlocksFreed += pBlk->cBlocks;
 
-            /* Now the one to the right. */
-            if (   pBlk->pNext
-                && pBlk->pNext->fFree)
-            {
-                PVCIBLKRANGEDESC pBlkNext = pBlk->pNext;
+        /* Check if it is possible to merge free blocks. */
+        if (   pBlk->pPrev
+            && pBlk->pPrev->fFree)
+        {
+            PVCIBLKRANGEDESC pBlkPrev = pBlk->pPrev;
 
-                Assert(pBlk->offAddrStart + pBlk->cBlocks == pBlkNext->offAddrStart);
-                pBlk->cBlocks += pBlkNext->cBlocks;
-                pBlk->pNext = pBlkNext->pNext;
-                if (pBlkNext->pNext)
-                    pBlkNext->pNext->pPrev = pBlk;
-                else
-                    pBlkMap->pRangesTail = pBlk;
+            Assert(pBlkPrev->offAddrStart + pBlkPrev->cBlocks == pBlk->offAddrStart);
+            pBlkPrev->cBlocks += pBlk->cBlocks;
+            pBlkPrev->pNext = pBlk->pNext;
+            if (pBlk->pNext)
+                pBlk->pNext->pPrev = pBlkPrev;
+            else
+                pBlkMap->pRangesTail = pBlkPrev;
 
-                RTMemFree(pBlkNext);
-            }
+            RTMemFree(pBlk);
+            pBlk = pBlkPrev;
         }
-        else
+
+        /* Now the one to the right. */
+        if (   pBlk->pNext
+            && pBlk->pNext->fFree)
         {
-            /* The block is intersecting. */
-            AssertMsgFailed(("TODO\n"));
+            PVCIBLKRANGEDESC pBlkNext = pBlk->pNext;
+
+            Assert(pBlk->offAddrStart + pBlk->cBlocks == pBlkNext->offAddrStart);
+            pBlk->cBlocks += pBlkNext->cBlocks;
+            pBlk->pNext = pBlkNext->pNext;
+            if (pBlkNext->pNext)
+                pBlkNext->pNext->pPrev = pBlk;
+            else
+                pBlkMap->pRangesTail = pBlk;
+
+            RTMemFree(pBlkNext);
         }
     }
 
     if ((fFlags & VCIBLKMAP_ALLOC_MASK) == VCIBLKMAP_ALLOC_DATA)
-        pBlkMap->cBlocksAllocMeta -= cBlocks;
+        pBlkMap->cBlocksAllocData -= cBlocksFreed;
     else
-        pBlkMap->cBlocksAllocData -= cBlocks;
+        pBlkMap->cBlocksAllocMeta -= cBlocksFreed;
 
-    pBlkMap->cBlocksFree += cBlocks;
+    pBlkMap->cBlocksFree += cBlocksFreed;
 
     LogFlowFunc(("returns\n"));
 }
-#endif /* unused */
 
 /**
  * Converts a tree node from the image to the in memory structure.
@@ -1076,143 +1426,840 @@ static PVCITREENODE vciTreeNodeImage2Host(uint64_t offBlockAddrNode, PVciTreeNod
 }
 
 /**
- * Looks up the cache extent for the given virtual block address.
+ * Converts a tree node from the in memory structure to the image representation.
  *
- * @returns Pointer to the cache extent or NULL if none could be found.
- * @param   pCache         The cache image instance.
- * @param   offBlockOffset The block offset to search for.
- * @param   ppNextBestFit  Where to store the pointer to the next best fit
- *                         cache extent above offBlockOffset if existing. - Optional
- *                         This is always filled if possible even if the function returns NULL.
+ * @param   pNode               The in memory node.
+ * @param   pNodeImage          Where to store the image representation of the node.
  */
-static PVCICACHEEXTENT vciCacheExtentLookup(PVCICACHE pCache, uint64_t offBlockOffset,
-                                            PVCICACHEEXTENT *ppNextBestFit)
+static void vciTreeNodeHost2Image(PVCITREENODE pNode, PVciTreeNode pNodeImage)
 {
-    int rc = VINF_SUCCESS;
-    PVCICACHEEXTENT pExtent = NULL;
-    PVCITREENODE pNodeCur = pCache->pRoot;
+    memset(pNodeImage, 0, sizeof(*pNodeImage));
+    pNodeImage->u8Type = pNode->u8Type;
 
-    while (   RT_SUCCESS(rc)
-           && pNodeCur
-           && pNodeCur->u8Type != VCI_TREE_NODE_TYPE_LEAF)
+    if (pNode->u8Type == VCI_TREE_NODE_TYPE_LEAF)
     {
-        PVCITREENODEINT pNodeInt = (PVCITREENODEINT)pNodeCur;
+        PVCITREENODELEAF pLeaf = (PVCITREENODELEAF)pNode;
+        PVciCacheExtent pExtent = (PVciCacheExtent)&pNodeImage->au8Data[0];
 
-        Assert(pNodeCur->u8Type == VCI_TREE_NODE_TYPE_INTERNAL);
+        for (unsigned idx = 0; idx < pLeaf->cUsedNodes; idx++)
+        {
+            pExtent->u64BlockOffset = RT_H2LE_U64(pLeaf->aExtents[idx].u64BlockOffset);
+            pExtent->u32Blocks      = RT_H2LE_U32(pLeaf->aExtents[idx].u32Blocks);
+            pExtent->u64BlockAddr   = RT_H2LE_U64(pLeaf->aExtents[idx].u64BlockAddr);
+            pExtent++;
+        }
+    }
+    else
+    {
+        PVCITREENODEINT pInt = (PVCITREENODEINT)pNode;
+        PVciTreeNodeInternal pIntImage = (PVciTreeNodeInternal)&pNodeImage->au8Data[0];
 
-        /* Search for the correct internal node. */
-        unsigned idxMin = 0;
-        unsigned idxMax = pNodeInt->cUsedNodes;
-        unsigned idxCur = pNodeInt->cUsedNodes / 2;
+        Assert(pNode->u8Type == VCI_TREE_NODE_TYPE_INTERNAL);
 
-        while (idxMin < idxMax)
+        for (unsigned idx = 0; idx < pInt->cUsedNodes; idx++)
         {
-            PVCINODEINTERNAL pInt = &pNodeInt->aIntNodes[idxCur];
+            PVCINODEINTERNAL pIntNode = &pInt->aIntNodes[idx];
+            uint64_t offChild = pIntNode->PtrChild.fInMemory
+                              ? pIntNode->PtrChild.u.pNode->u64BlockAddr
+                              : pIntNode->PtrChild.u.offAddrBlockNode;
+
+            pIntImage->u64BlockOffset = RT_H2LE_U64(pIntNode->u64BlockOffset);
+            pIntImage->u32Blocks      = RT_H2LE_U32(pIntNode->u32Blocks);
+            pIntImage->u64ChildAddr   = RT_H2LE_U64(offChild);
+            pIntImage++;
+        }
+    }
+}
 
-            /* Determine the search direction. */
-            if (offBlockOffset < pInt->u64BlockOffset)
-            {
-                /* Search left from the current extent. */
-                idxMax = idxCur;
-            }
-            else if (offBlockOffset >= pInt->u64BlockOffset + pInt->u32Blocks)
-            {
-                /* Search right from the current extent. */
-                idxMin = idxCur;
-            }
-            else
-            {
-                /* The block lies in the node, stop searching. */
-                if (pInt->PtrChild.fInMemory)
-                    pNodeCur = pInt->PtrChild.u.pNode;
-                else
-                {
-                    PVCITREENODE pNodeNew;
-                    VciTreeNode NodeTree;
+/**
+ * Writes the given tree node to the image.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   pNode               The node to write.
+ * @param   pIoCtx              The I/O context the write belongs to.
+ */
+static int vciTreeNodeWrite(PVCICACHE pCache, PVCITREENODE pNode, PVDIOCTX pIoCtx)
+{
+    VciTreeNode NodeImage;
 
-                    /* Read from disk and add to the tree. */
-                    rc = vdIfIoIntFileReadSync(pCache->pIfIo, pCache->pStorage,
-                                               VCI_BLOCK2BYTE(pInt->PtrChild.u.offAddrBlockNode),
-                                               &NodeTree, sizeof(NodeTree));
-                    AssertRC(rc);
+    vciTreeNodeHost2Image(pNode, &NodeImage);
 
-                    pNodeNew = vciTreeNodeImage2Host(pInt->PtrChild.u.offAddrBlockNode, &NodeTree);
-                    if (pNodeNew)
-                    {
-                        /* Link to the parent. */
-                        pInt->PtrChild.fInMemory = true;
-                        pInt->PtrChild.u.pNode = pNodeNew;
-                        pNodeNew->pParent = pNodeCur;
-                        pNodeCur = pNodeNew;
-                    }
-                    else
-                        rc = VERR_NO_MEMORY;
-                }
-                break;
-            }
+    /* Writes to the same node are ordered by the metadata transfer handling. */
+    int rc = vdIfIoIntFileWriteMeta(pCache->pIfIo, pCache->pStorage, VCI_BLOCK2BYTE(pNode->u64BlockAddr),
+                                    &NodeImage, sizeof(NodeImage), pIoCtx,
+                                    vciMetaXferComplete, NULL);
+    if (rc == VERR_VD_ASYNC_IO_IN_PROGRESS)
+        rc = VINF_SUCCESS;
+    return rc;
+}
 
-            idxCur = idxMin + (idxMax - idxMin) / 2;
-        }
-    }
+/**
+ * Makes sure there are at least the given number of free tree node blocks.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_VCI_NO_BLOCKS_FREE if there is not enough space left.
+ * @param   pCache              The cache image instance.
+ * @param   cNodes              Number of free tree node blocks required.
+ */
+static int vciTreeNodeReserve(PVCICACHE pCache, uint32_t cNodes)
+{
+    int rc = VINF_SUCCESS;
 
-    if (   RT_SUCCESS(rc)
-        && pNodeCur)
+    while (   RT_SUCCESS(rc)
+           && pCache->cNodesFree < cNodes)
     {
-        PVCITREENODELEAF pLeaf = (PVCITREENODELEAF)pNodeCur;
-        Assert(pNodeCur->u8Type == VCI_TREE_NODE_TYPE_LEAF);
-
-        /* Search the range. */
-        unsigned idxMin = 0;
-        unsigned idxMax = pLeaf->cUsedNodes;
-        unsigned idxCur = pLeaf->cUsedNodes / 2;
+        uint64_t offBlockAddr = 0;
 
-        while (idxMin < idxMax)
+        rc = vciBlkMapAllocate(pCache->pBlkMap, VCI_BYTE2BLOCK(sizeof(VciTreeNode)),
+                               VCIBLKMAP_ALLOC_META, &offBlockAddr);
+        if (RT_SUCCESS(rc))
         {
-            PVCICACHEEXTENT pExtentCur = &pLeaf->aExtents[idxCur];
-
-            /* Determine the search direction. */
-            if (offBlockOffset < pExtentCur->u64BlockOffset)
-            {
-                /* Search left from the current extent. */
-                idxMax = idxCur;
-            }
-            else if (offBlockOffset >= pExtentCur->u64BlockOffset + pExtentCur->u32Blocks)
+            PVCITREENODEFREE pFree = (PVCITREENODEFREE)RTMemAllocZ(sizeof(VCITREENODEFREE));
+            if (pFree)
             {
-                /* Search right from the current extent. */
-                idxMin = idxCur;
+                pFree->offBlockAddr   = offBlockAddr;
+                pFree->pNext          = pCache->pNodeFreeHead;
+                pCache->pNodeFreeHead = pFree;
+                pCache->cNodesFree++;
             }
             else
             {
-                /* We found the extent, stop searching. */
-                pExtent = pExtentCur;
-                break;
+                vciBlkMapFree(pCache->pBlkMap, offBlockAddr, VCI_BYTE2BLOCK(sizeof(VciTreeNode)),
+                              VCIBLKMAP_ALLOC_META);
+                rc = VERR_NO_MEMORY;
             }
-
-            idxCur = idxMin + (idxMax - idxMin) / 2;
         }
+    }
 
-        /* Get the next best fit extent if it exists. */
-        if (ppNextBestFit)
-        {
-            if (idxCur < pLeaf->cUsedNodes - 1)
-                *ppNextBestFit = &pLeaf->aExtents[idxCur + 1];
-            else
+    return rc;
+}
+
+/**
+ * Allocates space in the image and memory for a new, empty tree node.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   u8Type              Type of the node (VCI_TREE_NODE_TYPE_*).
+ * @param   ppNode              Where to store the pointer to the new node on success.
+ */
+static int vciTreeNodeAlloc(PVCICACHE pCache, uint8_t u8Type, PVCITREENODE *ppNode)
+{
+    int rc = vciTreeNodeReserve(pCache, 1);
+    if (RT_SUCCESS(rc))
+    {
+        PVCITREENODE pNode = (PVCITREENODE)RTMemAllocZ(  u8Type == VCI_TREE_NODE_TYPE_LEAF
+                                                       ? sizeof(VCITREENODELEAF)
+                                                       : sizeof(VCITREENODEINT));
+        if (pNode)
+        {
+            PVCITREENODEFREE pFree = pCache->pNodeFreeHead;
+
+            pCache->pNodeFreeHead = pFree->pNext;
+            pCache->cNodesFree--;
+
+            pNode->u8Type       = u8Type;
+            pNode->u64BlockAddr = pFree->offBlockAddr;
+            RTMemFree(pFree);
+            *ppNode = pNode;
+        }
+        else
+            rc = VERR_NO_MEMORY;
+    }
+
+    return rc;
+}
+
+/**
+ * Frees a tree node which was removed from the tree.
+ *
+ * The blocks of the node are only reused for other nodes while the cache is
+ * open because writes to them might still be in progress.
+ *
+ * @param   pCache              The cache image instance.
+ * @param   pNode               The node to free.
+ */
+static void vciTreeNodeFree(PVCICACHE pCache, PVCITREENODE pNode)
+{
+    PVCITREENODEFREE pFree = (PVCITREENODEFREE)RTMemAllocZ(sizeof(VCITREENODEFREE));
+
+    /* The blocks stay allocated if there is no memory to remember them. */
+    if (pFree)
+    {
+        pFree->offBlockAddr   = pNode->u64BlockAddr;
+        pFree->pNext          = pCache->pNodeFreeHead;
+        pCache->pNodeFreeHead = pFree;
+        pCache->cNodesFree++;
+    }
+
+    RTMemFree(pNode);
+}
+
+/**
+ * Returns the given child of an internal node, reading it from the image if
+ * it isn't in memory yet.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   pNodeInt            The internal node.
+ * @param   idx                 Index of the child.
+ * @param   ppNode              Where to store the pointer to the child on success.
+ */
+static int vciTreeNodeGetChild(PVCICACHE pCache, PVCITREENODEINT pNodeInt, unsigned idx,
+                               PVCITREENODE *ppNode)
+{
+    PVCINODEINTERNAL pInt = &pNodeInt->aIntNodes[idx];
+
+    Assert(idx < pNodeInt->cUsedNodes);
+
+    if (!pInt->PtrChild.fInMemory)
+    {
+        VciTreeNode NodeTree;
+
+        int rc = vdIfIoIntFileReadSync(pCache->pIfIo, pCache->pStorage,
+                                       VCI_BLOCK2BYTE(pInt->PtrChild.u.offAddrBlockNode),
+                                       &NodeTree, sizeof(NodeTree));
+        if (RT_FAILURE(rc))
+            return rc;
+
+        PVCITREENODE pNodeNew = vciTreeNodeImage2Host(pInt->PtrChild.u.offAddrBlockNode, &NodeTree);
+        if (!pNodeNew)
+            return VERR_NO_MEMORY;
+
+        /* Link to the parent. */
+        pNodeNew->pParent = &pNodeInt->Core;
+        pInt->PtrChild.fInMemory = true;
+        pInt->PtrChild.u.pNode = pNodeNew;
+    }
+
+    *ppNode = pInt->PtrChild.u.pNode;
+    return VINF_SUCCESS;
+}
+
+/**
+ * Frees the in memory representation of the given (sub)tree.
+ *
+ * @param   pNode               The root of the tree to free.
+ */
+static void vciTreeDestroy(PVCITREENODE pNode)
+{
+    if (pNode->u8Type == VCI_TREE_NODE_TYPE_INTERNAL)
+    {
+        PVCITREENODEINT pNodeInt = (PVCITREENODEINT)pNode;
+
+        for (unsigned idx = 0; idx < pNodeInt->cUsedNodes; idx++)
+            if (pNodeInt->aIntNodes[idx].PtrChild.fInMemory)
+                vciTreeDestroy(pNodeInt->aIntNodes[idx].PtrChild.u.pNode);
+    }
+
+    RTMemFree(pNode);
+}
+
+/**
+ * Returns the index of the child of an internal node which covers the given
+ * block offset, that is the last one starting at or before it, or the first
+ * one if all start after it.
+ *
+ * @returns Index of the child.
+ * @param   pNodeInt            The internal node.
+ * @param   offBlockOffset      The block offset to search for.
+ */
+static unsigned vciTreeNodeIntFind(PVCITREENODEINT pNodeInt, uint64_t offBlockOffset)
+{
+    unsigned idxMin = 0;
+    unsigned idxMax = pNodeInt->cUsedNodes;
+
+    while (idxMin < idxMax)
+    {
+        unsigned idxCur = idxMin + (idxMax - idxMin) / 2;
+
+        if (pNodeInt->aIntNodes[idxCur].u64BlockOffset <= offBlockOffset)
+            idxMin = idxCur + 1;
+        else
+            idxMax = idxCur;
+    }
+
+    return idxMin ? idxMin - 1 : 0;
+}
+
+/**
+ * Returns the index of the first extent in a leaf starting after the given
+ * block offset.
+ *
+ * @returns Index of the extent, equals the number of used extents if there is none.
+ * @param   pLeaf               The leaf node.
+ * @param   offBlockOffset      The block offset to search for.
+ */
+static unsigned vciTreeLeafFind(PVCITREENODELEAF pLeaf, uint64_t offBlockOffset)
+{
+    unsigned idxMin = 0;
+    unsigned idxMax = pLeaf->cUsedNodes;
+
+    while (idxMin < idxMax)
+    {
+        unsigned idxCur = idxMin + (idxMax - idxMin) / 2;
+
+        if (pLeaf->aExtents[idxCur].u64BlockOffset <= offBlockOffset)
+            idxMin = idxCur + 1;
+        else
+            idxMax = idxCur;
+    }
+
+    return idxMin;
+}
+
+/**
+ * Descends the tree to the leaf which covers the given block offset.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   offBlockOffset      The block offset to search for.
+ * @param   ppLeaf              Where to store the pointer to the leaf.
+ * @param   ppIntNext           Where to store the deepest internal node on the path
+ *                              which has a child right of the path, NULL if none.
+ * @param   pidxNext            Where to store the index of that child.
+ */
+static int vciTreeDescend(PVCICACHE pCache, uint64_t offBlockOffset, PVCITREENODELEAF *ppLeaf,
+                          PVCITREENODEINT *ppIntNext, unsigned *pidxNext)
+{
+    int rc = VINF_SUCCESS;
+    PVCITREENODE pNodeCur = pCache->pRoot;
+
+    *ppIntNext = NULL;
+    *pidxNext  = 0;
+
+    while (   RT_SUCCESS(rc)
+           && pNodeCur->u8Type == VCI_TREE_NODE_TYPE_INTERNAL)
+    {
+        PVCITREENODEINT pNodeInt = (PVCITREENODEINT)pNodeCur;
+        unsigned idx = vciTreeNodeIntFind(pNodeInt, offBlockOffset);
+
+        if (idx + 1 < pNodeInt->cUsedNodes)
+        {
+            *ppIntNext = pNodeInt;
+            *pidxNext  = idx + 1;
+        }
+
+        rc = vciTreeNodeGetChild(pCache, pNodeInt, idx, &pNodeCur);
+    }
+
+    if (RT_SUCCESS(rc))
+    {
+        AssertReturn(pNodeCur->u8Type == VCI_TREE_NODE_TYPE_LEAF, VERR_INTERNAL_ERROR);
+        *ppLeaf = (PVCITREENODELEAF)pNodeCur;
+    }
+
+    return rc;
+}
+
+/**
+ * Looks up the cache extent for the given virtual block address.
+ *
+ * @returns VBox status code.
+ * @param   pCache         The cache image instance.
+ * @param   offBlockOffset The block offset to search for.
+ * @param   ppExtent       Where to store the pointer to the cache extent containing
+ *                         offBlockOffset, NULL if the block is not cached.
+ * @param   ppNextBestFit  Where to store the pointer to the next best fit
+ *                         cache extent above offBlockOffset if existing. - Optional
+ *                         This is always filled if possible even if *ppExtent is NULL.
+ */
+static int vciCacheExtentLookup(PVCICACHE pCache, uint64_t offBlockOffset,
+                                PVCICACHEEXTENT *ppExtent, PVCICACHEEXTENT *ppNextBestFit)
+{
+    PVCITREENODELEAF pLeaf = NULL;
+    PVCITREENODEINT pIntNext = NULL;
+    unsigned idxNext = 0;
+
+    *ppExtent = NULL;
+    if (ppNextBestFit)
+        *ppNextBestFit = NULL;
+
+    int rc = vciTreeDescend(pCache, offBlockOffset, &pLeaf, &pIntNext, &idxNext);
+    if (RT_SUCCESS(rc))
+    {
+        unsigned idx = vciTreeLeafFind(pLeaf, offBlockOffset);
+
+        if (   idx > 0
+            && offBlockOffset - pLeaf->aExtents[idx - 1].u64BlockOffset < pLeaf->aExtents[idx - 1].u32Blocks)
+            *ppExtent = &pLeaf->aExtents[idx - 1];
+
+        if (ppNextBestFit)
+        {
+            if (idx < pLeaf->cUsedNodes)
+                *ppNextBestFit = &pLeaf->aExtents[idx];
+            else if (pIntNext)
             {
-                /*
-                 * Go up the tree and find the best extent
-                 * in the leftmost tree of the child subtree to the right.
-                 */
-                PVCITREENODEINT pInt = (PVCITREENODEINT)pLeaf->Core.pParent;
+                /* The leftmost extent of the subtree right of the path. */
+                PVCITREENODE pNodeCur = NULL;
+
+                rc = vciTreeNodeGetChild(pCache, pIntNext, idxNext, &pNodeCur);
+                while (   RT_SUCCESS(rc)
+                       && pNodeCur->u8Type == VCI_TREE_NODE_TYPE_INTERNAL)
+                    rc = vciTreeNodeGetChild(pCache, (PVCITREENODEINT)pNodeCur, 0, &pNodeCur);
 
-                while (pInt)
+                if (RT_SUCCESS(rc))
                 {
+                    PVCITREENODELEAF pLeafNext = (PVCITREENODELEAF)pNodeCur;
 
+                    if (pLeafNext->cUsedNodes)
+                        *ppNextBestFit = &pLeafNext->aExtents[0];
                 }
             }
         }
     }
 
-    return pExtent;
+    return rc;
+}
+
+/**
+ * Updates the entry of an internal node for the given child.
+ *
+ * @param   pIntNode            The entry to update.
+ * @param   pChild              The child the entry points to.
+ */
+static void vciTreeNodeIntSet(PVCINODEINTERNAL pIntNode, PVCITREENODE pChild)
+{
+    uint64_t offStart;
+    uint64_t offEnd;
+
+    if (pChild->u8Type == VCI_TREE_NODE_TYPE_LEAF)
+    {
+        PVCITREENODELEAF pLeaf = (PVCITREENODELEAF)pChild;
+        PVCICACHEEXTENT pLast = &pLeaf->aExtents[pLeaf->cUsedNodes - 1];
+
+        Assert(pLeaf->cUsedNodes);
+        offStart = pLeaf->aExtents[0].u64BlockOffset;
+        offEnd   = pLast->u64BlockOffset + pLast->u32Blocks;
+    }
+    else
+    {
+        PVCITREENODEINT pInt = (PVCITREENODEINT)pChild;
+        PVCINODEINTERNAL pLast = &pInt->aIntNodes[pInt->cUsedNodes - 1];
+
+        Assert(pInt->cUsedNodes);
+        offStart = pInt->aIntNodes[0].u64BlockOffset;
+        offEnd   = pLast->u64BlockOffset + pLast->u32Blocks;
+    }
+
+    /* The size is informational only, the tree is searched by start offsets. */
+    pIntNode->u64BlockOffset     = offStart;
+    pIntNode->u32Blocks          = (uint32_t)RT_MIN(offEnd - offStart, UINT32_MAX);
+    pIntNode->PtrChild.fInMemory = true;
+    pIntNode->PtrChild.u.pNode   = pChild;
+}
+
+/**
+ * Returns the index of the given child in its parent.
+ *
+ * @returns Index of the child.
+ * @param   pParent             The parent node.
+ * @param   pNode               The child node, must be in memory.
+ */
+static unsigned vciTreeNodeIntIdx(PVCITREENODEINT pParent, PVCITREENODE pNode)
+{
+    unsigned idx;
+
+    for (idx = 0; idx < pParent->cUsedNodes; idx++)
+        if (   pParent->aIntNodes[idx].PtrChild.fInMemory
+            && pParent->aIntNodes[idx].PtrChild.u.pNode == pNode)
+            break;
+
+    Assert(idx < pParent->cUsedNodes);
+    return idx;
+}
+
+/**
+ * Updates the entries for the given node in all its ancestors after the range
+ * it covers changed.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   pNode               The node which changed.
+ * @param   pIoCtx              The I/O context the update belongs to.
+ */
+static int vciTreeUpdateParents(PVCICACHE pCache, PVCITREENODE pNode, PVDIOCTX pIoCtx)
+{
+    int rc = VINF_SUCCESS;
+
+    while (   RT_SUCCESS(rc)
+           && pNode->pParent)
+    {
+        PVCITREENODEINT pParent = (PVCITREENODEINT)pNode->pParent;
+        PVCINODEINTERNAL pIntNode = &pParent->aIntNodes[vciTreeNodeIntIdx(pParent, pNode)];
+        uint64_t u64BlockOffsetOld = pIntNode->u64BlockOffset;
+        uint32_t u32BlocksOld = pIntNode->u32Blocks;
+
+        vciTreeNodeIntSet(pIntNode, pNode);
+        if (   pIntNode->u64BlockOffset == u64BlockOffsetOld
+            && pIntNode->u32Blocks == u32BlocksOld)
+            break;
+
+        rc = vciTreeNodeWrite(pCache, &pParent->Core, pIoCtx);
+        pNode = &pParent->Core;
+    }
+
+    return rc;
+}
+
+/**
+ * Inserts the entry for a new node right after the entry of its left sibling
+ * into an internal node which has room for it.
+ *
+ * @param   pNodeInt            The internal node.
+ * @param   idx                 Index of the left sibling.
+ * @param   pNode               The left sibling.
+ * @param   pNodeNew            The new node.
+ */
+static void vciTreeNodeIntInsert(PVCITREENODEINT pNodeInt, unsigned idx, PVCITREENODE pNode,
+                                 PVCITREENODE pNodeNew)
+{
+    Assert(pNodeInt->cUsedNodes < RT_ELEMENTS(pNodeInt->aIntNodes));
+    Assert(idx < pNodeInt->cUsedNodes);
+
+    memmove(&pNodeInt->aIntNodes[idx + 2], &pNodeInt->aIntNodes[idx + 1],
+            (pNodeInt->cUsedNodes - idx - 1) * sizeof(VCINODEINTERNAL));
+    pNodeInt->cUsedNodes++;
+
+    vciTreeNodeIntSet(&pNodeInt->aIntNodes[idx], pNode);
+    vciTreeNodeIntSet(&pNodeInt->aIntNodes[idx + 1], pNodeNew);
+    pNode->pParent    = &pNodeInt->Core;
+    pNodeNew->pParent = &pNodeInt->Core;
+}
+
+/**
+ * Links a new node created by splitting the given one into the tree, splitting
+ * the ancestors as well if they are full.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   pNode               The node which was split.
+ * @param   pNodeNew            The new node holding the upper part of pNode.
+ * @param   pIoCtx              The I/O context the update belongs to.
+ */
+static int vciTreeInsertNode(PVCICACHE pCache, PVCITREENODE pNode, PVCITREENODE pNodeNew, PVDIOCTX pIoCtx)
+{
+    PVCITREENODEINT pParent = (PVCITREENODEINT)pNode->pParent;
+    PVCITREENODE pNodeTmp = NULL;
+    int rc;
+
+    if (!pParent)
+    {
+        /* The root was split, the tree grows by one level. */
+        rc = vciTreeNodeAlloc(pCache, VCI_TREE_NODE_TYPE_INTERNAL, &pNodeTmp);
+        if (RT_SUCCESS(rc))
+        {
+            PVCITREENODEINT pRoot = (PVCITREENODEINT)pNodeTmp;
+
+            pRoot->cUsedNodes = 1;
+            vciTreeNodeIntInsert(pRoot, 0, pNode, pNodeNew);
+
+            /* The in memory tree is consistent either way. */
+            pCache->pRoot       = &pRoot->Core;
+            pCache->offTreeRoot = pRoot->Core.u64BlockAddr;
+
+            rc = vciTreeNodeWrite(pCache, &pRoot->Core, pIoCtx);
+            if (RT_SUCCESS(rc))
+                rc = vciHdrWriteTreeRoot(pCache, pIoCtx);
+        }
+
+        return rc;
+    }
+
+    unsigned idx = vciTreeNodeIntIdx(pParent, pNode);
+
+    if (pParent->cUsedNodes < RT_ELEMENTS(pParent->aIntNodes))
+    {
+        vciTreeNodeIntInsert(pParent, idx, pNode, pNodeNew);
+        rc = vciTreeNodeWrite(pCache, &pParent->Core, pIoCtx);
+        if (RT_SUCCESS(rc))
+            rc = vciTreeUpdateParents(pCache, &pParent->Core, pIoCtx);
+        return rc;
+    }
+
+    /* The parent is full, move the upper half of its entries into a new node. */
+    rc = vciTreeNodeAlloc(pCache, VCI_TREE_NODE_TYPE_INTERNAL, &pNodeTmp);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    PVCITREENODEINT pParentNew = (PVCITREENODEINT)pNodeTmp;
+    unsigned cSplit = pParent->cUsedNodes / 2;
+
+    pParentNew->cUsedNodes = pParent->cUsedNodes - cSplit;
+    memcpy(&pParentNew->aIntNodes[0], &pParent->aIntNodes[cSplit],
+           pParentNew->cUsedNodes * sizeof(VCINODEINTERNAL));
+    pParent->cUsedNodes = cSplit;
+
+    for (unsigned i = 0; i < pParentNew->cUsedNodes; i++)
+        if (pParentNew->aIntNodes[i].PtrChild.fInMemory)
+            pParentNew->aIntNodes[i].PtrChild.u.pNode->pParent = &pParentNew->Core;
+
+    if (idx < cSplit)
+        vciTreeNodeIntInsert(pParent, idx, pNode, pNodeNew);
+    else
+        vciTreeNodeIntInsert(pParentNew, idx - cSplit, pNode, pNodeNew);
+
+    rc = vciTreeNodeWrite(pCache, &pParent->Core, pIoCtx);
+    if (RT_SUCCESS(rc))
+        rc = vciTreeNodeWrite(pCache, &pParentNew->Core, pIoCtx);
+    if (RT_SUCCESS(rc))
+        rc = vciTreeInsertNode(pCache, &pParent->Core, &pParentNew->Core, pIoCtx);
+
+    return rc;
+}
+
+/**
+ * Inserts an extent into a leaf which has room for it.
+ *
+ * @param   pLeaf               The leaf node.
+ * @param   idx                 Where to insert the extent.
+ * @param   pExtent             The extent to insert.
+ */
+static void vciTreeLeafInsert(PVCITREENODELEAF pLeaf, unsigned idx, PVCICACHEEXTENT pExtent)
+{
+    Assert(pLeaf->cUsedNodes < RT_ELEMENTS(pLeaf->aExtents));
+    Assert(idx <= pLeaf->cUsedNodes);
+
+    memmove(&pLeaf->aExtents[idx + 1], &pLeaf->aExtents[idx],
+            (pLeaf->cUsedNodes - idx) * sizeof(VCICACHEEXTENT));
+    pLeaf->aExtents[idx] = *pExtent;
+    pLeaf->cUsedNodes++;
+}
+
+/**
+ * Inserts a new cache extent into the tree and writes the changed nodes to
+ * the image.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_VCI_NO_BLOCKS_FREE if there is no space for the tree nodes
+ *          required, the tree is unchanged then.
+ * @param   pCache              The cache image instance.
+ * @param   pExtent             The extent to insert, must not overlap any
+ *                              existing extent.
+ * @param   pIoCtx              The I/O context the update belongs to.
+ */
+static int vciTreeInsertExtent(PVCICACHE pCache, PVCICACHEEXTENT pExtent, PVDIOCTX pIoCtx)
+{
+    PVCITREENODELEAF pLeaf = NULL;
+    PVCITREENODEINT pIntNext = NULL;
+    unsigned idxNext = 0;
+
+    int rc = vciTreeDescend(pCache, pExtent->u64BlockOffset, &pLeaf, &pIntNext, &idxNext);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    unsigned idx = vciTreeLeafFind(pLeaf, pExtent->u64BlockOffset);
+
+    if (pLeaf->cUsedNodes < RT_ELEMENTS(pLeaf->aExtents))
+    {
+        vciTreeLeafInsert(pLeaf, idx, pExtent);
+        rc = vciTreeNodeWrite(pCache, &pLeaf->Core, pIoCtx);
+        if (RT_SUCCESS(rc))
+            rc = vciTreeUpdateParents(pCache, &pLeaf->Core, pIoCtx);
+        return rc;
+    }
+
+    /*
+     * Splitting the leaf might split all its ancestors and add a new root,
+     * make sure there is space for all the nodes before changing anything.
+     */
+    uint32_t cNodesSplit = 2;
+    for (PVCITREENODE pNodeCur = pLeaf->Core.pParent; pNodeCur; pNodeCur = pNodeCur->pParent)
+        cNodesSplit++;
+
+    rc = vciTreeNodeReserve(pCache, cNodesSplit);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /* The leaf is full, move the upper half of the extents into a new leaf. */
+    PVCITREENODE pNodeNew = NULL;
+    rc = vciTreeNodeAlloc(pCache, VCI_TREE_NODE_TYPE_LEAF, &pNodeNew);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    PVCITREENODELEAF pLeafNew = (PVCITREENODELEAF)pNodeNew;
+    unsigned cSplit = pLeaf->cUsedNodes / 2;
+
+    pLeafNew->cUsedNodes = pLeaf->cUsedNodes - cSplit;
+    memcpy(&pLeafNew->aExtents[0], &pLeaf->aExtents[cSplit],
+           pLeafNew->cUsedNodes * sizeof(VCICACHEEXTENT));
+    pLeaf->cUsedNodes = cSplit;
+
+    if (idx <= cSplit)
+        vciTreeLeafInsert(pLeaf, idx, pExtent);
+    else
+        vciTreeLeafInsert(pLeafNew, idx - cSplit, pExtent);
+
+    rc = vciTreeNodeWrite(pCache, &pLeaf->Core, pIoCtx);
+    if (RT_SUCCESS(rc))
+        rc = vciTreeNodeWrite(pCache, &pLeafNew->Core, pIoCtx);
+    if (RT_SUCCESS(rc))
+        rc = vciTreeInsertNode(pCache, &pLeaf->Core, &pLeafNew->Core, pIoCtx);
+
+    return rc;
+}
+
+/**
+ * Makes the only child of an internal root node the new root, repeatedly.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   pIoCtx              The I/O context the update belongs to.
+ */
+static int vciTreeRootCollapse(PVCICACHE pCache, PVDIOCTX pIoCtx)
+{
+    int rc = VINF_SUCCESS;
+
+    while (   RT_SUCCESS(rc)
+           && pCache->pRoot->u8Type == VCI_TREE_NODE_TYPE_INTERNAL
+           && ((PVCITREENODEINT)pCache->pRoot)->cUsedNodes == 1)
+    {
+        PVCITREENODEINT pRoot = (PVCITREENODEINT)pCache->pRoot;
+        PVCITREENODE pChild = NULL;
+
+        rc = vciTreeNodeGetChild(pCache, pRoot, 0, &pChild);
+        if (RT_SUCCESS(rc))
+        {
+            pChild->pParent     = NULL;
+            pCache->pRoot       = pChild;
+            pCache->offTreeRoot = pChild->u64BlockAddr;
+            vciTreeNodeFree(pCache, &pRoot->Core);
+
+            rc = vciHdrWriteTreeRoot(pCache, pIoCtx);
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * Removes an empty node from the tree, removing its ancestors as well if they
+ * become empty.
+ *
+ * Only the root can be empty (if it is a leaf) and an internal root always
+ * has at least two children.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   pNode               The empty node to remove, must not be the root.
+ * @param   pIoCtx              The I/O context the update belongs to.
+ */
+static int vciTreeRemoveNode(PVCICACHE pCache, PVCITREENODE pNode, PVDIOCTX pIoCtx)
+{
+    PVCITREENODEINT pParent = (PVCITREENODEINT)pNode->pParent;
+    AssertPtr(pParent);
+
+    unsigned idx = vciTreeNodeIntIdx(pParent, pNode);
+    memmove(&pParent->aIntNodes[idx], &pParent->aIntNodes[idx + 1],
+            (pParent->cUsedNodes - idx - 1) * sizeof(VCINODEINTERNAL));
+    pParent->cUsedNodes--;
+    vciTreeNodeFree(pCache, pNode);
+
+    if (!pParent->cUsedNodes)
+    {
+        AssertReturn(pParent->Core.pParent, VERR_INTERNAL_ERROR);
+        return vciTreeRemoveNode(pCache, &pParent->Core, pIoCtx);
+    }
+
+    int rc = vciTreeNodeWrite(pCache, &pParent->Core, pIoCtx);
+    if (RT_SUCCESS(rc))
+        rc = vciTreeUpdateParents(pCache, &pParent->Core, pIoCtx);
+    if (RT_SUCCESS(rc))
+        rc = vciTreeRootCollapse(pCache, pIoCtx);
+
+    return rc;
+}
+
+/**
+ * Removes the cache extent starting at the given block offset from the tree
+ * and frees its data blocks.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   offBlockOffset      First block of the extent to remove.
+ * @param   pIoCtx              The I/O context the update belongs to.
+ */
+static int vciTreeRemoveExtent(PVCICACHE pCache, uint64_t offBlockOffset, PVDIOCTX pIoCtx)
+{
+    PVCITREENODELEAF pLeaf = NULL;
+    PVCITREENODEINT pIntNext = NULL;
+    unsigned idxNext = 0;
+
+    int rc = vciTreeDescend(pCache, offBlockOffset, &pLeaf, &pIntNext, &idxNext);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    unsigned idx = vciTreeLeafFind(pLeaf, offBlockOffset);
+    AssertReturn(idx > 0 && pLeaf->aExtents[idx - 1].u64BlockOffset == offBlockOffset, VERR_INTERNAL_ERROR);
+    idx--;
+
+    /* Reads and writes of the data might still be in progress. */
+    vciBlkFreeDeferred(pCache, pLeaf->aExtents[idx].u64BlockAddr, pLeaf->aExtents[idx].u32Blocks);
+
+    memmove(&pLeaf->aExtents[idx], &pLeaf->aExtents[idx + 1],
+            (pLeaf->cUsedNodes - idx - 1) * sizeof(VCICACHEEXTENT));
+    pLeaf->cUsedNodes--;
+
+    if (   !pLeaf->cUsedNodes
+        && pLeaf->Core.pParent)
+        return vciTreeRemoveNode(pCache, &pLeaf->Core, pIoCtx);
+
+    rc = vciTreeNodeWrite(pCache, &pLeaf->Core, pIoCtx);
+    if (RT_SUCCESS(rc))
+        rc = vciTreeUpdateParents(pCache, &pLeaf->Core, pIoCtx);
+
+    return rc;
+}
+
+/**
+ * Evicts cached extents to make room for new data, continuing where the last
+ * eviction stopped.
+ *
+ * The freed blocks can be used once the transfers which might still access
+ * them completed, so the space might not be available right away.
+ *
+ * @returns VBox status code.
+ * @param   pCache              The cache image instance.
+ * @param   cBlocks             Number of blocks required.
+ * @param   pIoCtx              The I/O context the update belongs to.
+ */
+static int vciCacheEvict(PVCICACHE pCache, uint32_t cBlocks, PVDIOCTX pIoCtx)
+{
+    int rc = VINF_SUCCESS;
+    unsigned cEvicted = 0;
+
+    do
+    {
+        PVCICACHEEXTENT pExtent = NULL;
+        PVCICACHEEXTENT pExtentNext = NULL;
+
+        rc = vciCacheExtentLookup(pCache, pCache->offBlockEvict, &pExtent, &pExtentNext);
+        if (   RT_SUCCESS(rc)
+            && !pExtent
+            && !pExtentNext
+            && pCache->offBlockEvict)
+        {
+            /* Wrap around. */
+            pCache->offBlockEvict = 0;
+            rc = vciCacheExtentLookup(pCache, pCache->offBlockEvict, &pExtent, &pExtentNext);
+        }
+        if (RT_FAILURE(rc))
+            break;
+
+        if (!pExtent)
+            pExtent = pExtentNext;
+        if (!pExtent)
+            break; /* Nothing cached. */
+
+        uint64_t offBlockOffset = pExtent->u64BlockOffset;
+        pCache->offBlockEvict = offBlockOffset + pExtent->u32Blocks;
+        rc = vciTreeRemoveExtent(pCache, offBlockOffset, pIoCtx);
+        cEvicted++;
+    } while (   RT_SUCCESS(rc)
+             && cEvicted < VCI_EVICT_EXTENTS_MAX
+             && pCache->pBlkMap->cBlocksFree + pCache->cBlocksFreeDeferred < cBlocks + VCI_BLKMAP_META_RESERVE);
+
+    return rc;
 }
 
 /**
@@ -1251,8 +2298,7 @@ static int vciOpenImage(PVCICACHE pCache, unsigned uOpenFlags)
         goto out;
     }
 
-    rc = vdIfIoIntFileReadSync(pCache->pIfIo, pCache->pStorage, 0, &Hdr,
-                               VCI_BYTE2BLOCK(sizeof(Hdr)));
+    rc = vdIfIoIntFileReadSync(pCache->pIfIo, pCache->pStorage, 0, &Hdr, sizeof(Hdr));
     if (RT_FAILURE(rc))
     {
         rc = VERR_VD_GEN_INVALID_HEADER;
@@ -1270,8 +2316,24 @@ static int vciOpenImage(PVCICACHE pCache, unsigned uOpenFlags)
     if (   Hdr.u32Signature == VCI_HDR_SIGNATURE
         && Hdr.u32Version == VCI_HDR_VERSION)
     {
+        /*
+         * The metadata of a cache which was not closed cleanly might not describe
+         * the data actually stored, refuse to use it.
+         */
+        if (Hdr.fUncleanShutdown != VCI_HDR_CLEAN_SHUTDOWN)
+        {
+            rc = vdIfError(pCache->pIfError, VERR_VD_CACHE_NOT_UP_TO_DATE, RT_SRC_POS,
+                           N_("VCI: cache '%s' was not closed cleanly, the content can't be trusted"),
+                           pCache->pszFilename);
+            goto out;
+        }
+
         pCache->offTreeRoot   = Hdr.offTreeRoot;
         pCache->offBlksBitmap = Hdr.offBlkMap;
+        pCache->cBlkMap       = Hdr.cBlkMap;
+        pCache->cbSize        = VCI_BLOCK2BYTE(Hdr.cBlocksCache);
+        pCache->Uuid             = Hdr.uuidImage;
+        pCache->UuidModification = Hdr.uuidModification;
 
         /* Load the block map. */
         rc = vciBlkMapLoad(pCache, pCache->offBlksBitmap, Hdr.cBlkMap, &pCache->pBlkMap);
@@ -1281,8 +2343,8 @@ static int vciOpenImage(PVCICACHE pCache, unsigned uOpenFlags)
             VciTreeNode RootNode;
 
             rc = vdIfIoIntFileReadSync(pCache->pIfIo, pCache->pStorage,
-                                       pCache->offTreeRoot, &RootNode,
-                                       VCI_BYTE2BLOCK(sizeof(VciTreeNode)));
+                                       VCI_BLOCK2BYTE(pCache->offTreeRoot), &RootNode,
+                                       sizeof(VciTreeNode));
             if (RT_SUCCESS(rc))
             {
                 pCache->pRoot = vciTreeNodeImage2Host(pCache->offTreeRoot, &RootNode);
@@ -1290,6 +2352,11 @@ static int vciOpenImage(PVCICACHE pCache, unsigned uOpenFlags)
                     rc = VERR_NO_MEMORY;
             }
         }
+
+        /* Mark the cache as in use until it is closed again. */
+        if (   RT_SUCCESS(rc)
+            && !(uOpenFlags & VD_OPEN_FLAGS_READONLY))
+            rc = vciHdrSetShutdownState(pCache, false /* fClean */);
     }
     else
         rc = VERR_VD_GEN_INVALID_HEADER;
@@ -1305,7 +2372,7 @@ out:
  */
 static int vciCreateImage(PVCICACHE pCache, uint64_t cbSize,
                           unsigned uImageFlags, const char *pszComment,
-                          unsigned uOpenFlags, PFNVDPROGRESS pfnProgress,
+                          PCRTUUID pUuid, unsigned uOpenFlags, PFNVDPROGRESS pfnProgress,
                           void *pvUser, unsigned uPercentStart,
                           unsigned uPercentSpan)
 {
@@ -1396,7 +2463,8 @@ static int vciCreateImage(PVCICACHE pCache, uint64_t cbSize,
             break;
         }
 
-        pCache->pRoot->u8Type = VCI_TREE_NODE_TYPE_LEAF;
+        pCache->pRoot->u8Type       = VCI_TREE_NODE_TYPE_LEAF;
+        pCache->pRoot->u64BlockAddr = offTreeRoot;
         /* Rest remains 0 as the tree is still empty. */
 
         /*
@@ -1416,9 +2484,20 @@ static int vciCreateImage(PVCICACHE pCache, uint64_t cbSize,
         Hdr.offTreeRoot      = RT_H2LE_U64(offTreeRoot);
         Hdr.offBlkMap        = RT_H2LE_U64(offBlkMap);
         Hdr.cBlkMap          = RT_H2LE_U32(cBlkMap);
+        if (pUuid)
+            Hdr.uuidImage    = *pUuid;
+        else
+            RTUuidCreate(&Hdr.uuidImage);
+        RTUuidClear(&Hdr.uuidModification);
+
+        pCache->Uuid             = Hdr.uuidImage;
+        pCache->UuidModification = Hdr.uuidModification;
+        pCache->offTreeRoot      = offTreeRoot;
+        pCache->offBlksBitmap    = offBlkMap;
+        pCache->cBlkMap          = cBlkMap;
 
-        rc = vdIfIoIntFileWriteSync(pCache->pIfIo, pCache->pStorage, offHdr, &Hdr,
-                                    VCI_BYTE2BLOCK(sizeof(VciHdr)));
+        rc = vdIfIoIntFileWriteSync(pCache->pIfIo, pCache->pStorage, VCI_BLOCK2BYTE(offHdr), &Hdr,
+                                    sizeof(VciHdr));
         if (RT_FAILURE(rc))
         {
             rc = vdIfError(pCache->pIfError, rc, RT_SRC_POS, N_("VCI: cannot write header '%s'"), pCache->pszFilename);
@@ -1436,8 +2515,8 @@ static int vciCreateImage(PVCICACHE pCache, uint64_t cbSize,
         memset(&NodeRoot, 0, sizeof(VciTreeNode));
         NodeRoot.u8Type = VCI_TREE_NODE_TYPE_LEAF;
 
-        rc = vdIfIoIntFileWriteSync(pCache->pIfIo, pCache->pStorage, offTreeRoot,
-                                    &NodeRoot, VCI_BYTE2BLOCK(sizeof(VciTreeNode)));
+        rc = vdIfIoIntFileWriteSync(pCache->pIfIo, pCache->pStorage, VCI_BLOCK2BYTE(offTreeRoot),
+                                    &NodeRoot, sizeof(VciTreeNode));
         if (RT_FAILURE(rc))
         {
             rc = vdIfError(pCache->pIfError, rc, RT_SRC_POS, N_("VCI: cannot write root node '%s'"), pCache->pszFilename);
@@ -1576,7 +2655,6 @@ static DECLCALLBACK(int) vciCreate(const char *pszFilename, uint64_t cbSize,
                                    PVDINTERFACE pVDIfsDisk, PVDINTERFACE pVDIfsImage,
                                    PVDINTERFACE pVDIfsOperation, void **ppBackendData)
 {
-    RT_NOREF1(pUuid);
     LogFlowFunc(("pszFilename=\"%s\" cbSize=%llu uImageFlags=%#x pszComment=\"%s\" Uuid=%RTuuid uOpenFlags=%#x uPercentStart=%u uPercentSpan=%u pVDIfsDisk=%#p pVDIfsImage=%#p pVDIfsOperation=%#p ppBackendData=%#p",
                  pszFilename, cbSize, uImageFlags, pszComment, pUuid, uOpenFlags, uPercentStart, uPercentSpan, pVDIfsDisk, pVDIfsImage, pVDIfsOperation, ppBackendData));
     int rc;
@@ -1617,7 +2695,7 @@ static DECLCALLBACK(int) vciCreate(const char *pszFilename, uint64_t cbSize,
     pCache->pVDIfsDisk = pVDIfsDisk;
     pCache->pVDIfsImage = pVDIfsImage;
 
-    rc = vciCreateImage(pCache, cbSize, uImageFlags, pszComment, uOpenFlags,
+    rc = vciCreateImage(pCache, cbSize, uImageFlags, pszComment, pUuid, uOpenFlags,
                         pfnProgress, pvUser, uPercentStart, uPercentSpan);
     if (RT_SUCCESS(rc))
     {
@@ -1673,15 +2751,33 @@ static DECLCALLBACK(int) vciRead(void *pBackendData, uint64_t uOffset, size_t cb
     Assert(uOffset % 512 == 0);
     Assert(cbToRead % 512 == 0);
 
-    pExtent = vciCacheExtentLookup(pCache, offBlockAddr, NULL);
-    if (pExtent)
+    pExtent = NULL;
+    if (!pCache->fBroken)
+    {
+        rc = vciCacheExtentLookup(pCache, offBlockAddr, &pExtent, NULL);
+        if (RT_FAILURE(rc))
+        {
+            vciSetBroken(pCache, rc);
+            rc = VINF_SUCCESS;
+        }
+    }
+
+    if (   pExtent
+        && !pExtent->fPending)
     {
         uint64_t offRead = offBlockAddr - pExtent->u64BlockOffset;
+        uint32_t idxIoEpoch = pCache->uIoEpoch & 1;
         cBlocksToRead = RT_MIN(cBlocksToRead, pExtent->u32Blocks - offRead);
 
-        rc = vdIfIoIntFileReadUser(pCache->pIfIo, pCache->pStorage,
-                                   pExtent->u64BlockAddr + offRead,
-                                   pIoCtx, cBlocksToRead);
+        /* The blocks must not be reused until the read completed. */
+        rc = vdIfIoIntFileReadUserEx(pCache->pIfIo, pCache->pStorage,
+                                     VCI_BLOCK2BYTE(pExtent->u64BlockAddr + offRead),
+                                     pIoCtx, VCI_BLOCK2BYTE(cBlocksToRead),
+                                     vciIoComplete, (void *)(uintptr_t)idxIoEpoch);
+        if (rc == VERR_VD_ASYNC_IO_IN_PROGRESS)
+            pCache->acIoPending[idxIoEpoch]++;
+        else if (RT_FAILURE(rc))
+            vciSetBroken(pCache, rc);
     }
     else
     {
@@ -1697,30 +2793,244 @@ static DECLCALLBACK(int) vciRead(void *pBackendData, uint64_t uOffset, size_t cb
     return rc;
 }
 
+/**
+ * Internal. Finishes the data write for a new cache extent.
+ *
+ * @param   pCache              The cache image instance.
+ * @param   pWrite              The write which completed, freed.
+ * @param   rcReq               Status code of the write.
+ */
+static void vciExtentWriteFinish(PVCICACHE pCache, PVCIEXTENTWRITE pWrite, int rcReq)
+{
+    if (RT_SUCCESS(rcReq))
+    {
+        PVCICACHEEXTENT pExtent = NULL;
+
+        /* The extent might have been evicted or discarded in the meantime. */
+        int rc = vciCacheExtentLookup(pCache, pWrite->u64BlockOffset, &pExtent, NULL);
+        if (RT_FAILURE(rc))
+            vciSetBroken(pCache, rc);
+        else if (   pExtent
+                 && pExtent->u64BlockOffset == pWrite->u64BlockOffset
+                 && pExtent->u64BlockAddr == pWrite->u64BlockAddr)
+            pExtent->fPending = false;
+    }
+    else
+        vciSetBroken(pCache, rcReq);
+
+    RTMemFree(pWrite);
+}
+
+/**
+ * Internal. Completion callback for the data write of a new cache extent.
+ */
+static DECLCALLBACK(int) vciExtentWriteComplete(void *pBackendData, PVDIOCTX pIoCtx, void *pvUser, int rcReq)
+{
+    RT_NOREF1(pIoCtx);
+    PVCICACHE pCache = (PVCICACHE)pBackendData;
+    PVCIEXTENTWRITE pWrite = (PVCIEXTENTWRITE)pvUser;
+
+    Assert(pCache->acIoPending[pWrite->idxIoEpoch]);
+    pCache->acIoPending[pWrite->idxIoEpoch]--;
+
+    vciExtentWriteFinish(pCache, pWrite, rcReq);
+    vciIoEpochProcess(pCache, false /* fAll */);
+    return VINF_SUCCESS;
+}
+
+/**
+ * Internal. Caches data for a range which is not cached yet, evicting other
+ * extents if the cache is full.
+ *
+ * The range stays uncached if there is no space, updating the cache failing
+ * otherwise stops using it.
+ *
+ * @param   pCache              The cache image instance.
+ * @param   offBlockOffset      First block of the range.
+ * @param   cBlocks             Number of blocks in the range.
+ * @param   pIoCtx              The I/O context holding the data.
+ */
+static void vciExtentWriteNew(PVCICACHE pCache, uint64_t offBlockOffset, uint32_t cBlocks, PVDIOCTX pIoCtx)
+{
+    PVCIBLKMAP pBlkMap = pCache->pBlkMap;
+    uint64_t offBlockAddr = 0;
+    int rc = VERR_VCI_NO_BLOCKS_FREE;
+
+    if (pBlkMap->cBlocksFree >= cBlocks + VCI_BLKMAP_META_RESERVE)
+        rc = vciBlkMapAllocate(pBlkMap, cBlocks, VCIBLKMAP_ALLOC_DATA, &offBlockAddr);
+    if (rc == VERR_VCI_NO_BLOCKS_FREE)
+    {
+        rc = vciCacheEvict(pCache, cBlocks, pIoCtx);
+        if (RT_FAILURE(rc))
+        {
+            vciSetBroken(pCache, rc);
+            return;
+        }
+
+        rc = VERR_VCI_NO_BLOCKS_FREE;
+        if (pBlkMap->cBlocksFree >= cBlocks + VCI_BLKMAP_META_RESERVE)
+            rc = vciBlkMapAllocate(pBlkMap, cBlocks, VCIBLKMAP_ALLOC_DATA, &offBlockAddr);
+    }
+    if (RT_FAILURE(rc))
+        return; /* Without enough contiguous space left the range stays uncached. */
+
+    PVCIEXTENTWRITE pWrite = (PVCIEXTENTWRITE)RTMemAllocZ(sizeof(VCIEXTENTWRITE));
+    if (!pWrite)
+    {
+        vciBlkMapFree(pBlkMap, offBlockAddr, cBlocks, VCIBLKMAP_ALLOC_DATA);
+        return;
+    }
+
+    /* Reads are not served from the extent until the data is written. */
+    VCICACHEEXTENT ExtentNew;
+
+    ExtentNew.u64BlockOffset = offBlockOffset;
+    ExtentNew.u32Blocks      = cBlocks;
+    ExtentNew.u64BlockAddr   = offBlockAddr;
+    ExtentNew.fPending       = true;
+
+    rc = vciTreeInsertExtent(pCache, &ExtentNew, pIoCtx);
+    if (RT_FAILURE(rc))
+    {
+        /* Nothing changed if there is no space for the tree nodes. */
+        if (rc == VERR_VCI_NO_BLOCKS_FREE)
+            vciBlkMapFree(pBlkMap, offBlockAddr, cBlocks, VCIBLKMAP_ALLOC_DATA);
+        else
+            vciSetBroken(pCache, rc);
+        RTMemFree(pWrite);
+        return;
+    }
+
+    pWrite->u64BlockOffset = offBlockOffset;
+    pWrite->u64BlockAddr   = offBlockAddr;
+    pWrite->idxIoEpoch     = pCache->uIoEpoch & 1;
+
+    rc = vdIfIoIntFileWriteUser(pCache->pIfIo, pCache->pStorage, VCI_BLOCK2BYTE(offBlockAddr),
+                                pIoCtx, VCI_BLOCK2BYTE(cBlocks), vciExtentWriteComplete, pWrite);
+    if (rc == VERR_VD_ASYNC_IO_IN_PROGRESS)
+        pCache->acIoPending[pWrite->idxIoEpoch]++;
+    else
+        vciExtentWriteFinish(pCache, pWrite, rc);
+}
+
 /** @copydoc VDCACHEBACKEND::pfnWrite */
 static DECLCALLBACK(int) vciWrite(void *pBackendData, uint64_t uOffset, size_t cbToWrite,
                                   PVDIOCTX pIoCtx, size_t *pcbWriteProcess)
 {
-    RT_NOREF5(pBackendData, uOffset, cbToWrite, pIoCtx, pcbWriteProcess);
     LogFlowFunc(("pBackendData=%#p uOffset=%llu cbToWrite=%zu pIoCtx=%#p pcbWriteProcess=%#p\n",
                  pBackendData, uOffset, cbToWrite, pIoCtx, pcbWriteProcess));
     PVCICACHE pCache = (PVCICACHE)pBackendData;
     int rc = VINF_SUCCESS;
-    uint64_t cBlocksToWrite = VCI_BYTE2BLOCK(cbToWrite);
-    //uint64_t offBlockAddr  = VCI_BYTE2BLOCK(uOffset);
+    PVCICACHEEXTENT pExtent = NULL;
+    PVCICACHEEXTENT pExtentNext = NULL;
+    uint64_t offBlockAddr = VCI_BYTE2BLOCK(uOffset);
+    uint32_t cBlocksToWrite = (uint32_t)RT_MIN(VCI_BYTE2BLOCK(cbToWrite), VCI_WRITE_BLOCKS_MAX);
 
-    AssertPtr(pCache); NOREF(pCache);
+    AssertPtr(pCache);
     Assert(uOffset % 512 == 0);
     Assert(cbToWrite % 512 == 0);
-    while (cBlocksToWrite)
+
+    if (pCache->uOpenFlags & VD_OPEN_FLAGS_READONLY)
+        return VERR_VD_IMAGE_READ_ONLY;
+
+    /*
+     * Stop at the end of the extent holding the start of the range or
+     * before the next one, so one write deals with a single extent.
+     */
+    if (!pCache->fBroken)
     {
+        rc = vciCacheExtentLookup(pCache, offBlockAddr, &pExtent, &pExtentNext);
+        if (RT_FAILURE(rc))
+            vciSetBroken(pCache, rc);
+        else if (pExtent)
+            cBlocksToWrite = (uint32_t)RT_MIN(cBlocksToWrite,
+                                              pExtent->u64BlockOffset + pExtent->u32Blocks - offBlockAddr);
+        else if (pExtentNext)
+            cBlocksToWrite = (uint32_t)RT_MIN(cBlocksToWrite, pExtentNext->u64BlockOffset - offBlockAddr);
+    }
 
+    /* Data which doesn't end up in the cache is just skipped. */
+    if (!pCache->fBroken)
+    {
+        if (pExtent)
+        {
+            /* Cached already, update the data in place. */
+            uint32_t idxIoEpoch = pCache->uIoEpoch & 1;
+
+            rc = vdIfIoIntFileWriteUser(pCache->pIfIo, pCache->pStorage,
+                                        VCI_BLOCK2BYTE(pExtent->u64BlockAddr + offBlockAddr - pExtent->u64BlockOffset),
+                                        pIoCtx, VCI_BLOCK2BYTE(cBlocksToWrite),
+                                        vciIoComplete, (void *)(uintptr_t)idxIoEpoch);
+            if (rc == VERR_VD_ASYNC_IO_IN_PROGRESS)
+                pCache->acIoPending[idxIoEpoch]++;
+            else if (RT_FAILURE(rc))
+                vciSetBroken(pCache, rc);
+        }
+        else
+            vciExtentWriteNew(pCache, offBlockAddr, cBlocksToWrite, pIoCtx);
     }
 
-    *pcbWriteProcess = cbToWrite; /** @todo Implement. */
+    *pcbWriteProcess = VCI_BLOCK2BYTE(cBlocksToWrite);
 
-    LogFlowFunc(("returns %Rrc\n", rc));
-    return rc;
+    LogFlowFunc(("returns VINF_SUCCESS\n"));
+    return VINF_SUCCESS;
+}
+
+/** @copydoc VDCACHEBACKEND::pfnDiscard */
+static DECLCALLBACK(int) vciDiscard(void *pBackendData, PVDIOCTX pIoCtx,
+                                    uint64_t uOffset, size_t cbDiscard,
+                                    size_t *pcbPreAllocated, size_t *pcbPostAllocated,
+                                    size_t *pcbActuallyDiscarded, void **ppbmAllocationBitmap,
+                                    unsigned fDiscard)
+{
+    RT_NOREF1(fDiscard);
+    LogFlowFunc(("pBackendData=%#p pIoCtx=%#p uOffset=%llu cbDiscard=%zu\n",
+                 pBackendData, pIoCtx, uOffset, cbDiscard));
+    PVCICACHE pCache = (PVCICACHE)pBackendData;
+    uint64_t offBlockAddr = VCI_BYTE2BLOCK(uOffset);
+    uint64_t offBlockAddrEnd = VCI_BYTE2BLOCK(uOffset + cbDiscard);
+
+    AssertPtr(pCache);
+    Assert(uOffset % 512 == 0);
+    Assert(cbDiscard % 512 == 0);
+
+    if (pCache->uOpenFlags & VD_OPEN_FLAGS_READONLY)
+        return VERR_VD_IMAGE_READ_ONLY;
+
+    /*
+     * Drop every extent overlapping the range, including the parts outside
+     * of it. The image has the data for those anyway.
+     */
+    while (   !pCache->fBroken
+           && offBlockAddr < offBlockAddrEnd)
+    {
+        PVCICACHEEXTENT pExtent = NULL;
+        PVCICACHEEXTENT pExtentNext = NULL;
+
+        int rc = vciCacheExtentLookup(pCache, offBlockAddr, &pExtent, &pExtentNext);
+        if (RT_SUCCESS(rc))
+        {
+            if (!pExtent)
+                pExtent = pExtentNext;
+            if (   !pExtent
+                || pExtent->u64BlockOffset >= offBlockAddrEnd)
+                break;
+
+            uint64_t offBlockOffset = pExtent->u64BlockOffset;
+            offBlockAddr = offBlockOffset + pExtent->u32Blocks;
+            rc = vciTreeRemoveExtent(pCache, offBlockOffset, pIoCtx);
+        }
+        if (RT_FAILURE(rc))
+            vciSetBroken(pCache, rc);
+    }
+
+    *pcbPreAllocated      = 0;
+    *pcbPostAllocated     = 0;
+    *pcbActuallyDiscarded = cbDiscard;
+    *ppbmAllocationBitmap = NULL;
+
+    LogFlowFunc(("returns VINF_SUCCESS\n"));
+    return VINF_SUCCESS;
 }
 
 /** @copydoc VDCACHEBACKEND::pfnFlush */
@@ -1898,7 +3208,6 @@ static DECLCALLBACK(int) vciSetComment(void *pBackendData, const char *pszCommen
 /** @copydoc VDCACHEBACKEND::pfnGetUuid */
 static DECLCALLBACK(int) vciGetUuid(void *pBackendData, PRTUUID pUuid)
 {
-    RT_NOREF1(pUuid);
     LogFlowFunc(("pBackendData=%#p pUuid=%#p\n", pBackendData, pUuid));
     PVCICACHE pCache = (PVCICACHE)pBackendData;
     int rc;
@@ -1906,7 +3215,10 @@ static DECLCALLBACK(int) vciGetUuid(void *pBackendData, PRTUUID pUuid)
     AssertPtr(pCache);
 
     if (pCache)
-        rc = VERR_NOT_SUPPORTED;
+    {
+        *pUuid = pCache->Uuid;
+        rc = VINF_SUCCESS;
+    }
     else
         rc = VERR_VD_NOT_OPENED;
 
@@ -1917,7 +3229,6 @@ static DECLCALLBACK(int) vciGetUuid(void *pBackendData, PRTUUID pUuid)
 /** @copydoc VDCACHEBACKEND::pfnSetUuid */
 static DECLCALLBACK(int) vciSetUuid(void *pBackendData, PCRTUUID pUuid)
 {
-    RT_NOREF1(pUuid);
     LogFlowFunc(("pBackendData=%#p Uuid=%RTuuid\n", pBackendData, pUuid));
     PVCICACHE pCache = (PVCICACHE)pBackendData;
     int rc;
@@ -1928,7 +3239,11 @@ static DECLCALLBACK(int) vciSetUuid(void *pBackendData, PCRTUUID pUuid)
     if (pCache)
     {
         if (!(pCache->uOpenFlags & VD_OPEN_FLAGS_READONLY))
-            rc = VERR_NOT_SUPPORTED;
+        {
+            rc = vciHdrWriteUuid(pCache, RT_UOFFSETOF(VciHdr, uuidImage), pUuid);
+            if (RT_SUCCESS(rc))
+                pCache->Uuid = *pUuid;
+        }
         else
             rc = VERR_VD_IMAGE_READ_ONLY;
     }
@@ -1942,7 +3257,6 @@ static DECLCALLBACK(int) vciSetUuid(void *pBackendData, PCRTUUID pUuid)
 /** @copydoc VDCACHEBACKEND::pfnGetModificationUuid */
 static DECLCALLBACK(int) vciGetModificationUuid(void *pBackendData, PRTUUID pUuid)
 {
-    RT_NOREF1(pUuid);
     LogFlowFunc(("pBackendData=%#p pUuid=%#p\n", pBackendData, pUuid));
     PVCICACHE pCache = (PVCICACHE)pBackendData;
     int rc;
@@ -1950,7 +3264,10 @@ static DECLCALLBACK(int) vciGetModificationUuid(void *pBackendData, PRTUUID pUui
     AssertPtr(pCache);
 
     if (pCache)
-        rc = VERR_NOT_SUPPORTED;
+    {
+        *pUuid = pCache->UuidModification;
+        rc = VINF_SUCCESS;
+    }
     else
         rc = VERR_VD_NOT_OPENED;
 
@@ -1961,7 +3278,6 @@ static DECLCALLBACK(int) vciGetModificationUuid(void *pBackendData, PRTUUID pUui
 /** @copydoc VDCACHEBACKEND::pfnSetModificationUuid */
 static DECLCALLBACK(int) vciSetModificationUuid(void *pBackendData, PCRTUUID pUuid)
 {
-    RT_NOREF1(pUuid);
     LogFlowFunc(("pBackendData=%#p Uuid=%RTuuid\n", pBackendData, pUuid));
     PVCICACHE pCache = (PVCICACHE)pBackendData;
     int rc;
@@ -1971,7 +3287,11 @@ static DECLCALLBACK(int) vciSetModificationUuid(void *pBackendData, PCRTUUID pUu
     if (pCache)
     {
         if (!(pCache->uOpenFlags & VD_OPEN_FLAGS_READONLY))
-            rc = VERR_NOT_SUPPORTED;
+        {
+            rc = vciHdrWriteUuid(pCache, RT_UOFFSETOF(VciHdr, uuidModification), pUuid);
+            if (RT_SUCCESS(rc))
+                pCache->UuidModification = *pUuid;
+        }
         else
             rc = VERR_VD_IMAGE_READ_ONLY;
     }
@@ -2016,7 +3336,7 @@ const VDCACHEBACKEND g_VciCacheBackend =
     /* pfnFlush */
     vciFlush,
     /* pfnDiscard */
-    NULL,
+    vciDiscard,
     /* pfnGetVersion */
     vciGetVersion,
     /* pfnGetSize */
@@ -57,6 +57,8 @@
 
 /** Threshold after not recently used blocks are removed from the list. */
 #define VD_DISCARD_REMOVE_THRESHOLD (10 * _1M) /** @todo experiment */
+/** Upper limit for merging adjacent discard ranges into a single one. */
+#define VD_DISCARD_MERGE_MAX        (_1G)
 
 /**
  * VD async I/O interface storage descriptor.
@@ -271,6 +273,8 @@ typedef struct VDIOCTX
  * multiple times.
  */
 #define VDIOCTX_FLAGS_WRITE_FILTER_APPLIED   RT_BIT_32(6)
+/** The data was written to the cache already, same as above. */
+#define VDIOCTX_FLAGS_CACHE_WRITTEN          RT_BIT_32(7)
 
 /** NIL I/O context pointer value. */
 #define NIL_VDIOCTX ((PVDIOCTX)0)
@@ -327,6 +331,24 @@ typedef struct VDIOTASK
     } Type;
 } VDIOTASK;
 
+/**
+ * Completion state of a user data transfer which needs more than one I/O task,
+ * so the completion callback of the caller is called only once.
+ */
+typedef struct VDIOUSERXFER
+{
+    /** Completion callback of the caller, NULL if it must not be called anymore. */
+    PFNVDXFERCOMPLETED           pfnComplete;
+    /** Opaque user data for the callback. */
+    void                        *pvUser;
+    /** Number of references, one for every pending task and one for the submission. */
+    volatile uint32_t            cRefs;
+    /** Status code of the first failed task. */
+    volatile int32_t             rcReq;
+} VDIOUSERXFER;
+/** Pointer to the completion state of a user data transfer. */
+typedef VDIOUSERXFER *PVDIOUSERXFER;
+
 /**
  * Storage handle.
  */
@@ -788,45 +810,113 @@ static int vdCacheReadHelper(PVDCACHE pCache, uint64_t uOffset,
 /**
  * Internal: Writes data for the given block into the cache.
  *
+ * The data is taken from the given position in the I/O context buffer, which
+ * usually is data already transferred for the request, so the position and the
+ * transfer accounting of the I/O context are left as they were.  The cache
+ * backend may skip data it doesn't store, only what it hands to the storage
+ * is accounted as additional transfers of the request.
+ *
  * @returns VBox status code.
  * @param   pCache     The cache to write to.
  * @param   uOffset    Offset of the virtual disk to write to the cache.
  * @param   cbWrite    How much to write.
  * @param   pIoCtx     The I/O context to write from.
- * @param   pcbWritten How much data could be written, optional.
+ * @param   pSgBuf     Position of the data in the I/O context buffer.
  */
 static int vdCacheWriteHelper(PVDCACHE pCache, uint64_t uOffset, size_t cbWrite,
-                              PVDIOCTX pIoCtx, size_t *pcbWritten)
+                              PVDIOCTX pIoCtx, PCRTSGBUF pSgBuf)
 {
     int rc = VINF_SUCCESS;
+    RTSGBUF SgBufSaved;
+    RTSGBUF SgBufCur;
 
-    LogFlowFunc(("pCache=%#p uOffset=%llu pIoCtx=%p cbWrite=%zu pcbWritten=%#p\n",
-                 pCache, uOffset, pIoCtx, cbWrite, pcbWritten));
+    LogFlowFunc(("pCache=%#p uOffset=%llu pIoCtx=%p cbWrite=%zu pSgBuf=%#p\n",
+                 pCache, uOffset, pIoCtx, cbWrite, pSgBuf));
 
     AssertPtr(pCache);
     AssertPtr(pIoCtx);
     Assert(cbWrite > 0);
+    Assert(cbWrite == (uint32_t)cbWrite);
 
-    if (pcbWritten)
-        rc = pCache->Backend->pfnWrite(pCache->pBackendData, uOffset, cbWrite,
-                                       pIoCtx, pcbWritten);
-    else
+    RTSgBufClone(&SgBufSaved, &pIoCtx->Req.Io.SgBuf);
+    RTSgBufClone(&SgBufCur, pSgBuf);
+
+    do
     {
         size_t cbWritten = 0;
+        size_t cbLeft    = RTSgBufCalcLengthLeft(&SgBufCur);
 
-        do
-        {
-            rc = pCache->Backend->pfnWrite(pCache->pBackendData, uOffset, cbWrite,
-                                           pIoCtx, &cbWritten);
-            uOffset += cbWritten;
-            cbWrite -= cbWritten;
-        } while (   cbWrite
-                 && (   RT_SUCCESS(rc)
-                     || rc == VERR_VD_ASYNC_IO_IN_PROGRESS));
+        RTSgBufClone(&pIoCtx->Req.Io.SgBuf, &SgBufCur);
+
+        /*
+         * The cache transfers come on top of the ones for the request, drop
+         * whatever the backend didn't hand to the storage again afterwards
+         * as it would keep the request from completing.
+         */
+        ASMAtomicAddU32(&pIoCtx->Req.Io.cbTransferLeft, (uint32_t)cbWrite);
+        rc = pCache->Backend->pfnWrite(pCache->pBackendData, uOffset, cbWrite,
+                                       pIoCtx, &cbWritten);
+        size_t cbSubmitted = cbLeft - RTSgBufCalcLengthLeft(&pIoCtx->Req.Io.SgBuf);
+        Assert(cbSubmitted <= cbWrite);
+        ASMAtomicSubU32(&pIoCtx->Req.Io.cbTransferLeft, (uint32_t)(cbWrite - cbSubmitted));
+
+        if (   RT_FAILURE(rc)
+            && rc != VERR_VD_ASYNC_IO_IN_PROGRESS)
+            break;
+
+        Assert(cbWritten <= cbWrite);
+        RTSgBufAdvance(&SgBufCur, cbWritten);
+        uOffset += cbWritten;
+        cbWrite -= cbWritten;
+    } while (cbWrite);
+
+    RTSgBufClone(&pIoCtx->Req.Io.SgBuf, &SgBufSaved);
+
+    LogFlowFunc(("returns rc=%Rrc\n", rc));
+    return rc;
+}
+
+/**
+ * Internal: Drops the given range from the cache so the cached data isn't
+ * returned anymore after the range was discarded in the image.
+ *
+ * @returns VBox status code.
+ * @param   pCache      The cache to discard the range in.
+ * @param   pIoCtx      The discard I/O context.
+ * @param   uOffset     Start offset of the range.
+ * @param   cbDiscard   Size of the range.
+ */
+static int vdCacheDiscardHelper(PVDCACHE pCache, PVDIOCTX pIoCtx, uint64_t uOffset, size_t cbDiscard)
+{
+    int rc = VINF_SUCCESS;
+
+    LogFlowFunc(("pCache=%#p pIoCtx=%p uOffset=%llu cbDiscard=%zu\n",
+                 pCache, pIoCtx, uOffset, cbDiscard));
+
+    while (cbDiscard)
+    {
+        size_t cbPreAllocated = 0;
+        size_t cbPostAllocated = 0;
+        size_t cbThisDiscard = 0;
+        void *pbmAllocated = NULL;
+
+        rc = pCache->Backend->pfnDiscard(pCache->pBackendData, pIoCtx, uOffset, cbDiscard,
+                                         &cbPreAllocated, &cbPostAllocated, &cbThisDiscard,
+                                         &pbmAllocated, 0);
+        Assert(!pbmAllocated);
+        if (   RT_FAILURE(rc)
+            && rc != VERR_VD_ASYNC_IO_IN_PROGRESS)
+            break;
+
+        Assert(cbThisDiscard && cbThisDiscard <= cbDiscard);
+        uOffset   += cbThisDiscard;
+        cbDiscard -= cbThisDiscard;
     }
 
-    LogFlowFunc(("returns rc=%Rrc pcbWritten=%zu\n",
-                 rc, pcbWritten ? *pcbWritten : cbWrite));
+    if (rc == VERR_VD_ASYNC_IO_IN_PROGRESS)
+        rc = VINF_SUCCESS;
+
+    LogFlowFunc(("returns rc=%Rrc\n", rc));
     return rc;
 }
 
@@ -1736,15 +1826,23 @@ static DECLCALLBACK(int) vdReadHelperAsync(PVDIOCTX pIoCtx)
                                    pIoCtx, &cbThisRead);
             if (rc == VERR_VD_BLOCK_FREE)
             {
+                RTSGBUF SgBufRead;
+                RTSgBufClone(&SgBufRead, &pIoCtx->Req.Io.SgBuf);
+
                 rc = vdDiskReadHelper(pDisk, pCurrImage, NULL, uOffset, cbThisRead,
                                       pIoCtx, &cbThisRead);
 
-                /* If the read was successful, write the data back into the cache. */
+                /*
+                 * If the read completed, write the data back into the cache.
+                 * Failing to do so doesn't affect the read.
+                 */
                 if (   RT_SUCCESS(rc)
                     && pIoCtx->fFlags & VDIOCTX_FLAGS_READ_UPDATE_CACHE)
                 {
-                    rc = vdCacheWriteHelper(pDisk->pCache, uOffset, cbThisRead,
-                                            pIoCtx, NULL);
+                    int rc2 = vdCacheWriteHelper(pDisk->pCache, uOffset, cbThisRead,
+                                                 pIoCtx, &SgBufRead);
+                    if (RT_FAILURE(rc2) && rc2 != VERR_VD_ASYNC_IO_IN_PROGRESS)
+                        LogFlow(("Updating the cache failed with %Rrc\n", rc2));
                 }
             }
         }
@@ -2665,6 +2763,22 @@ static DECLCALLBACK(int) vdWriteHelperAsync(PVDIOCTX pIoCtx)
     if (RT_FAILURE(rc))
         return rc;
 
+    /*
+     * Write through to the cache, otherwise it would return stale data for the range.
+     * The cache backend disables itself if it fails to update data it holds.
+     */
+    if (   pDisk->pCache
+        && !(pIoCtx->fFlags & VDIOCTX_FLAGS_CACHE_WRITTEN))
+    {
+        RTSGBUF SgBufWrite;
+        RTSgBufClone(&SgBufWrite, &pIoCtx->Req.Io.SgBuf);
+
+        int rc2 = vdCacheWriteHelper(pDisk->pCache, uOffset, cbWrite, pIoCtx, &SgBufWrite);
+        if (RT_FAILURE(rc2) && rc2 != VERR_VD_ASYNC_IO_IN_PROGRESS)
+            LogFlow(("Updating the cache failed with %Rrc\n", rc2));
+        pIoCtx->fFlags |= VDIOCTX_FLAGS_CACHE_WRITTEN;
+    }
+
     /* Loop until all written. */
     do
     {
@@ -3088,6 +3202,21 @@ static DECLCALLBACK(int) vdDiscardHelperAsync(PVDIOCTX pIoCtx)
         return VINF_SUCCESS;
     }
 
+    /*
+     * Give up the disk lock between two parts if other requests are waiting for
+     * it and nothing of the previous part is in flight anymore. This lets
+     * allocating writes and other discards make progress during a large discard
+     * (think fstrim) instead of waiting for all ranges to be processed.
+     */
+    if (   pDisk->pIoCtxLockOwner == pIoCtx
+        && pDisk->pIoCtxBlockedHead
+        && !pIoCtx->cDataTransfersPending
+        && !pIoCtx->cMetaTransfersPending)
+    {
+        LogFlowFunc(("Requests are waiting for the disk lock, releasing it temporarily\n"));
+        vdIoCtxUnlockDisk(pDisk, pIoCtx, true /* fProcessDeferredReqs*/);
+    }
+
     if (pDisk->pIoCtxLockOwner != pIoCtx)
         rc = vdIoCtxLockDisk(pDisk, pIoCtx);
 
@@ -3097,9 +3226,6 @@ static DECLCALLBACK(int) vdDiscardHelperAsync(PVDIOCTX pIoCtx)
         size_t   cbDiscardLeft = pIoCtx->Req.Discard.cbDiscardLeft;
         size_t   cbThisDiscard;
 
-        pDisk->uOffsetStartLocked = offStart;
-        pDisk->uOffsetEndLocked = offStart + cbDiscardLeft;
-
         if (RT_UNLIKELY(!pDiscard))
         {
             pDiscard = vdDiscardStateCreate();
@@ -3116,6 +3242,26 @@ static DECLCALLBACK(int) vdDiscardHelperAsync(PVDIOCTX pIoCtx)
             LogFlowFunc(("New range descriptor loaded (%u) offStart=%llu cbDiscard=%zu\n",
                          pIoCtx->Req.Discard.idxRange, offStart, cbDiscardLeft));
             pIoCtx->Req.Discard.idxRange++;
+
+            /* Merge directly following ranges to save on tree lookups and backend calls. */
+            while (   pIoCtx->Req.Discard.idxRange < cRanges
+                   && paRanges[pIoCtx->Req.Discard.idxRange].offStart == offStart + cbDiscardLeft
+                   && cbDiscardLeft + paRanges[pIoCtx->Req.Discard.idxRange].cbRange <= VD_DISCARD_MERGE_MAX)
+            {
+                cbDiscardLeft += paRanges[pIoCtx->Req.Discard.idxRange].cbRange;
+                LogFlowFunc(("Merged range descriptor (%u) cbDiscard=%zu\n",
+                             pIoCtx->Req.Discard.idxRange, cbDiscardLeft));
+                pIoCtx->Req.Discard.idxRange++;
+            }
+
+            if (   pDisk->pCache
+                && pDisk->pCache->Backend->pfnDiscard)
+            {
+                /* Drop the range from the cache, failing to do so doesn't affect the discard. */
+                int rc2 = vdCacheDiscardHelper(pDisk->pCache, pIoCtx, offStart, cbDiscardLeft);
+                if (RT_FAILURE(rc2))
+                    LogFlow(("Discarding the range in the cache failed with %Rrc\n", rc2));
+            }
         }
 
         /* Look for a matching block in the AVL tree first. */
@@ -3133,6 +3279,10 @@ static DECLCALLBACK(int) vdDiscardHelperAsync(PVDIOCTX pIoCtx)
             Assert(!(cbThisDiscard % 512));
             pIoCtx->Req.Discard.pBlock   = NULL;
             pIoCtx->pfnIoCtxTransferNext = vdDiscardCurrentRangeAsync;
+
+            /* Only the part handed to the backend next needs to be protected from interfering I/O. */
+            pDisk->uOffsetStartLocked = offStart;
+            pDisk->uOffsetEndLocked   = offStart + cbThisDiscard;
         }
         else
         {
@@ -3143,6 +3293,10 @@ static DECLCALLBACK(int) vdDiscardHelperAsync(PVDIOCTX pIoCtx)
 
             AssertPtr(pBlock);
 
+            /* The whole block might get discarded below. */
+            pDisk->uOffsetStartLocked = pBlock->Core.Key;
+            pDisk->uOffsetEndLocked   = pBlock->Core.KeyLast + 1;
+
             Assert(!(cbThisDiscard % 512));
             Assert(!((offStart - pBlock->Core.Key) % 512));
 
@@ -3938,8 +4092,94 @@ static DECLCALLBACK(int) vdIOIntSetAllocationSize(void *pvUser, PVDIOSTORAGE pIo
     return rc;
 }
 
+/**
+ * Internal - Completion callback for the tasks of a user transfer split into several tasks.
+ */
+static DECLCALLBACK(int) vdUserXferTaskCompleted(void *pBackendData, PVDIOCTX pIoCtx, void *pvUser, int rcReq)
+{
+    PVDIOUSERXFER pXfer = (PVDIOUSERXFER)pvUser;
+    int rc = VINF_SUCCESS;
+
+    if (RT_FAILURE(rcReq))
+        ASMAtomicCmpXchgS32(&pXfer->rcReq, rcReq, VINF_SUCCESS);
+
+    if (!ASMAtomicDecU32(&pXfer->cRefs))
+    {
+        if (pXfer->pfnComplete)
+            rc = pXfer->pfnComplete(pBackendData, pIoCtx, pXfer->pvUser, pXfer->rcReq);
+        RTMemFree(pXfer);
+    }
+
+    return rc;
+}
+
+/**
+ * Internal - Sets up the completion state for a user transfer if the caller
+ * wants to be notified and the transfer needs more than one task.
+ *
+ * @returns VBox status code.
+ * @param   pIoCtx          The I/O context, the S/G buffer is at the start of the transfer.
+ * @param   cbTransfer      Number of bytes to transfer.
+ * @param   ppfnComplete    The completion callback, replaced with the one for the
+ *                          tasks if the completion state is required.
+ * @param   ppvUser         The opaque user data for the callback, replaced accordingly.
+ * @param   ppXfer          Where to store the completion state, NULL if not required.
+ */
+static int vdUserXferPrepare(PVDIOCTX pIoCtx, size_t cbTransfer, PFNVDXFERCOMPLETED *ppfnComplete,
+                             void **ppvUser, PVDIOUSERXFER *ppXfer)
+{
+    *ppXfer = NULL;
+
+    if (*ppfnComplete)
+    {
+        RTSGBUF  SgBuf;
+        unsigned cSegments = 0;
+
+        RTSgBufClone(&SgBuf, &pIoCtx->Req.Io.SgBuf);
+        RTSgBufSegArrayCreate(&SgBuf, NULL, &cSegments, cbTransfer);
+        if (cSegments > VD_IO_TASK_SEGMENTS_MAX)
+        {
+            PVDIOUSERXFER pXfer = (PVDIOUSERXFER)RTMemAllocZ(sizeof(VDIOUSERXFER));
+            if (!pXfer)
+                return VERR_NO_MEMORY;
+
+            pXfer->pfnComplete = *ppfnComplete;
+            pXfer->pvUser      = *ppvUser;
+            pXfer->cRefs       = 1;
+            pXfer->rcReq       = VINF_SUCCESS;
+
+            *ppfnComplete = vdUserXferTaskCompleted;
+            *ppvUser      = pXfer;
+            *ppXfer       = pXfer;
+        }
+    }
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * Internal - Drops the submission reference of a user transfer split into several tasks.
+ *
+ * @returns Status code to return to the caller.
+ * @param   pXfer           The completion state of the transfer.
+ * @param   rc              Status code of the last submitted task.
+ */
+static int vdUserXferSubmitted(PVDIOUSERXFER pXfer, int rc)
+{
+    if (!ASMAtomicDecU32(&pXfer->cRefs))
+        RTMemFree(pXfer); /* Everything completed already. */
+    else if (   RT_FAILURE(rc)
+             && rc != VERR_VD_ASYNC_IO_IN_PROGRESS)
+        pXfer->pfnComplete = NULL; /* No callback after returning an error. */
+    else
+        rc = VERR_VD_ASYNC_IO_IN_PROGRESS;
+
+    return rc;
+}
+
 static DECLCALLBACK(int) vdIOIntReadUser(void *pvUser, PVDIOSTORAGE pIoStorage, uint64_t uOffset,
-                                         PVDIOCTX pIoCtx, size_t cbRead)
+                                         PVDIOCTX pIoCtx, size_t cbRead, PFNVDXFERCOMPLETED pfnComplete,
+                                         void *pvCompleteUser)
 {
     int rc = VINF_SUCCESS;
     PVDIO    pVDIo = (PVDIO)pvUser;
@@ -3980,6 +4220,12 @@ static DECLCALLBACK(int) vdIOIntReadUser(void *pvUser, PVDIOSTORAGE pIoStorage,
     }
     else
     {
+        PVDIOUSERXFER pXfer = NULL;
+
+        rc = vdUserXferPrepare(pIoCtx, cbRead, &pfnComplete, &pvCompleteUser, &pXfer);
+        if (RT_FAILURE(rc))
+            return rc;
+
         /* Build the S/G array and spawn a new I/O task */
         while (cbRead)
         {
@@ -4000,12 +4246,17 @@ static DECLCALLBACK(int) vdIOIntReadUser(void *pvUser, PVDIOSTORAGE pIoStorage,
 #endif
 
             Assert(cbTaskRead == (uint32_t)cbTaskRead);
-            PVDIOTASK pIoTask = vdIoTaskUserAlloc(pIoStorage, NULL, NULL, pIoCtx, (uint32_t)cbTaskRead);
+            PVDIOTASK pIoTask = vdIoTaskUserAlloc(pIoStorage, pfnComplete, pvCompleteUser, pIoCtx, (uint32_t)cbTaskRead);
 
             if (!pIoTask)
-                return VERR_NO_MEMORY;
+            {
+                rc = VERR_NO_MEMORY;
+                break;
+            }
 
             ASMAtomicIncU32(&pIoCtx->cDataTransfersPending);
+            if (pXfer)
+                ASMAtomicIncU32(&pXfer->cRefs);
 
             void *pvTask;
             Log(("Spawning pIoTask=%p pIoCtx=%p\n", pIoTask, pIoCtx));
@@ -4018,11 +4269,15 @@ static DECLCALLBACK(int) vdIOIntReadUser(void *pvUser, PVDIOSTORAGE pIoStorage,
                 AssertMsg(cbTaskRead <= pIoCtx->Req.Io.cbTransferLeft, ("Impossible!\n"));
                 ASMAtomicSubU32(&pIoCtx->Req.Io.cbTransferLeft, (uint32_t)cbTaskRead);
                 ASMAtomicDecU32(&pIoCtx->cDataTransfersPending);
+                if (pXfer)
+                    ASMAtomicDecU32(&pXfer->cRefs);
                 vdIoTaskFree(pDisk, pIoTask);
             }
             else if (rc != VERR_VD_ASYNC_IO_IN_PROGRESS)
             {
                 ASMAtomicDecU32(&pIoCtx->cDataTransfersPending);
+                if (pXfer)
+                    ASMAtomicDecU32(&pXfer->cRefs);
                 vdIoTaskFree(pDisk, pIoTask);
                 break;
             }
@@ -4030,6 +4285,9 @@ static DECLCALLBACK(int) vdIOIntReadUser(void *pvUser, PVDIOSTORAGE pIoStorage,
             uOffset += cbTaskRead;
             cbRead  -= cbTaskRead;
         }
+
+        if (pXfer)
+            rc = vdUserXferSubmitted(pXfer, rc);
     }
 
     LogFlowFunc(("returns rc=%Rrc\n", rc));
@@ -4079,6 +4337,12 @@ static DECLCALLBACK(int) vdIOIntWriteUser(void *pvUser, PVDIOSTORAGE pIoStorage,
     }
     else
     {
+        PVDIOUSERXFER pXfer = NULL;
+
+        rc = vdUserXferPrepare(pIoCtx, cbWrite, &pfnComplete, &pvCompleteUser, &pXfer);
+        if (RT_FAILURE(rc))
+            return rc;
+
         /* Build the S/G array and spawn a new I/O task */
         while (cbWrite)
         {
@@ -4104,9 +4368,14 @@ static DECLCALLBACK(int) vdIOIntWriteUser(void *pvUser, PVDIOSTORAGE pIoStorage,
             PVDIOTASK pIoTask = vdIoTaskUserAlloc(pIoStorage, pfnComplete, pvCompleteUser, pIoCtx, (uint32_t)cbTaskWrite);
 
             if (!pIoTask)
-                return VERR_NO_MEMORY;
+            {
+                rc = VERR_NO_MEMORY;
+                break;
+            }
 
             ASMAtomicIncU32(&pIoCtx->cDataTransfersPending);
+            if (pXfer)
+                ASMAtomicIncU32(&pXfer->cRefs);
 
             void *pvTask;
             Log(("Spawning pIoTask=%p pIoCtx=%p\n", pIoTask, pIoCtx));
@@ -4119,11 +4388,15 @@ static DECLCALLBACK(int) vdIOIntWriteUser(void *pvUser, PVDIOSTORAGE pIoStorage,
                 AssertMsg(cbTaskWrite <= pIoCtx->Req.Io.cbTransferLeft, ("Impossible!\n"));
                 ASMAtomicSubU32(&pIoCtx->Req.Io.cbTransferLeft, (uint32_t)cbTaskWrite);
                 ASMAtomicDecU32(&pIoCtx->cDataTransfersPending);
+                if (pXfer)
+                    ASMAtomicDecU32(&pXfer->cRefs);
                 vdIoTaskFree(pDisk, pIoTask);
             }
             else if (rc != VERR_VD_ASYNC_IO_IN_PROGRESS)
             {
                 ASMAtomicDecU32(&pIoCtx->cDataTransfersPending);
+                if (pXfer)
+                    ASMAtomicDecU32(&pXfer->cRefs);
                 vdIoTaskFree(pDisk, pIoTask);
                 break;
             }
@@ -4131,6 +4404,9 @@ static DECLCALLBACK(int) vdIOIntWriteUser(void *pvUser, PVDIOSTORAGE pIoStorage,
             uOffset += cbTaskWrite;
             cbWrite -= cbTaskWrite;
         }
+
+        if (pXfer)
+            rc = vdUserXferSubmitted(pXfer, rc);
     }
 
     LogFlowFunc(("returns rc=%Rrc\n", rc));
@@ -4785,13 +5061,17 @@ static DECLCALLBACK(int) vdIOIntWriteUserLimited(void *pvUser, PVDIOSTORAGE pSto
 
 static DECLCALLBACK(int) vdIOIntReadUserLimited(void *pvUser, PVDIOSTORAGE pStorage,
                                                 uint64_t uOffset, PVDIOCTX pIoCtx,
-                                                size_t cbRead)
+                                                size_t cbRead,
+                                                PFNVDXFERCOMPLETED pfnComplete,
+                                                void *pvCompleteUser)
 {
     NOREF(pvUser);
     NOREF(pStorage);
     NOREF(uOffset);
     NOREF(pIoCtx);
     NOREF(cbRead);
+    NOREF(pfnComplete);
+    NOREF(pvCompleteUser);
     AssertMsgFailedReturn(("This needs to be implemented when called\n"), VERR_NOT_IMPLEMENTED);
 }
 
@@ -6811,6 +7091,7 @@ VBOXDDU_DECL(int) VDMerge(PVDISK pDisk, unsigned nImageFrom,
             /* Merge parent state into child. This means writing all not
              * allocated blocks in the destination image which are allocated in
              * the images to be merged. */
+            unsigned uProgressOld = 0;
             uint64_t uOffset = 0;
             uint64_t cbRemaining = cbSize;
 
@@ -6865,10 +7146,21 @@ VBOXDDU_DECL(int) VDMerge(PVDISK pDisk, unsigned nImageFrom,
                     {
                         if (RT_FAILURE(rc))
                             break;
-                        /* Updating the cache is required because this might be a live merge. */
-                        rc = vdWriteHelperEx(pDisk, pImageTo, pImageFrom->pPrev,
-                                             uOffset, pvBuf, cbThisRead,
-                                             VDIOCTX_FLAGS_READ_UPDATE_CACHE, 0);
+
+                        /*
+                         * Zero blocks don't need to be copied if there is no image left below
+                         * the merged ones, the free block in the destination reads as zero then.
+                         */
+                        if (   !pImageFrom->pPrev
+                            && ASMMemIsZero(pvBuf, cbThisRead))
+                            rc = VINF_SUCCESS;
+                        else
+                        {
+                            /* Updating the cache is required because this might be a live merge. */
+                            rc = vdWriteHelperEx(pDisk, pImageTo, pImageFrom->pPrev,
+                                                 uOffset, pvBuf, cbThisRead,
+                                                 VDIOCTX_FLAGS_READ_UPDATE_CACHE, 0);
+                        }
                         if (RT_FAILURE(rc))
                             break;
                     }
@@ -6885,15 +7177,18 @@ VBOXDDU_DECL(int) VDMerge(PVDISK pDisk, unsigned nImageFrom,
                 uOffset += cbThisRead;
                 cbRemaining -= cbThisRead;
 
-                if (pIfProgress && pIfProgress->pfnProgress)
+                unsigned uProgressNew = uOffset * 99 / cbSize;
+                if (uProgressNew != uProgressOld)
                 {
-                    /** @todo r=klaus: this can update the progress to the same
-                     * percentage over and over again if the image format makes
-                     * relatively small increments. */
-                    rc = pIfProgress->pfnProgress(pIfProgress->Core.pvUser,
-                                                  uOffset * 99 / cbSize);
-                    if (RT_FAILURE(rc))
-                        break;
+                    uProgressOld = uProgressNew;
+
+                    if (pIfProgress && pIfProgress->pfnProgress)
+                    {
+                        rc = pIfProgress->pfnProgress(pIfProgress->Core.pvUser,
+                                                      uProgressOld);
+                        if (RT_FAILURE(rc))
+                            break;
+                    }
                 }
             } while (uOffset < cbSize);
         }
@@ -7003,8 +7298,42 @@ VBOXDDU_DECL(int) VDMerge(PVDISK pDisk, unsigned nImageFrom,
                 {
                     if (RT_FAILURE(rc))
                         break;
-                    rc = vdWriteHelper(pDisk, pImageTo, uOffset, pvBuf,
-                                       cbThisRead, VDIOCTX_FLAGS_READ_UPDATE_CACHE);
+
+                    /*
+                     * A zero block doesn't need to be written if the destination is the
+                     * base image and doesn't have the block allocated, it reads as zero
+                     * already.  Only the range the destination reports as free is skipped.
+                     */
+                    bool fSkip = false;
+                    if (   !pImageTo->pPrev
+                        && ASMMemIsZero(pvBuf, cbThisRead))
+                    {
+                        size_t cbFree = cbThisRead;
+                        vdIoCtxInit(&IoCtx, pDisk, VDIOCTXTXDIR_READ, 0, 0, NULL,
+                                    &SgBuf, NULL, NULL, VDIOCTX_FLAGS_SYNC);
+                        RTSgBufReset(&SgBuf);
+                        int rcFree = pImageTo->Backend->pfnRead(pImageTo->pBackendData,
+                                                                uOffset, cbFree,
+                                                                &IoCtx, &cbFree);
+                        if (rcFree == VERR_VD_BLOCK_FREE)
+                        {
+                            cbThisRead = cbFree;
+                            fSkip = true;
+                        }
+                        else if (RT_FAILURE(rcFree))
+                        {
+                            rc = rcFree;
+                            break;
+                        }
+                        else
+                            memset(pvBuf, 0, cbThisRead); /* The read clobbered the buffer. */
+                    }
+
+                    if (!fSkip)
+                        rc = vdWriteHelper(pDisk, pImageTo, uOffset, pvBuf,
+                                           cbThisRead, VDIOCTX_FLAGS_READ_UPDATE_CACHE);
+                    else
+                        rc = VINF_SUCCESS;
                     if (RT_FAILURE(rc))
                         break;
                 }
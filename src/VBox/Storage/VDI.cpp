@@ -1634,12 +1634,26 @@ static DECLCALLBACK(int) vdiRead(void *pBackendData, uint64_t uOffset, size_t cb
     offRead = (unsigned)uOffset & pImage->uBlockMask;
 
     /* Clip read range to at most the rest of the block. */
+    size_t cbReq = cbToRead;
     size_t cbBlockRem = getImageBlockSize(&pImage->Header) - offRead;
     cbToRead = RT_MIN(cbToRead, cbBlockRem);
     Assert(!(cbToRead % 512));
 
     if (pImage->paBlocks[uBlock] == VDI_IMAGE_BLOCK_FREE)
+    {
+        /*
+         * Report the whole run of consecutive free blocks (up to the requested size)
+         * so callers like VDCopy/VDMerge can skip large unallocated ranges in one go
+         * instead of probing each block separately.
+         */
+        unsigned cBlocks = getImageBlocks(&pImage->Header);
+        size_t   cbBlock = getImageBlockSize(&pImage->Header);
+        while (   cbToRead < cbReq
+               && ++uBlock < cBlocks
+               && pImage->paBlocks[uBlock] == VDI_IMAGE_BLOCK_FREE)
+            cbToRead += RT_MIN(cbReq - cbToRead, cbBlock);
         rc = VERR_VD_BLOCK_FREE;
+    }
     else if (pImage->paBlocks[uBlock] == VDI_IMAGE_BLOCK_ZERO)
     {
         size_t cbSet = vdIfIoIntIoCtxSet(pImage->pIfIo, pIoCtx, 0, cbToRead);
@@ -1707,17 +1721,24 @@ static DECLCALLBACK(int) vdiWrite(void *pBackendData, uint64_t uOffset, size_t c
             if (!IS_VDI_IMAGE_BLOCK_ALLOCATED(pImage->paBlocks[uBlock]))
             {
                 /* Block is either free or zero. */
+                bool fFullBlock = cbToWrite == getImageBlockSize(&pImage->Header);
                 if (   !(pImage->uOpenFlags & VD_OPEN_FLAGS_HONOR_ZEROES)
                     && (   pImage->paBlocks[uBlock] == VDI_IMAGE_BLOCK_ZERO
-                        || cbToWrite == getImageBlockSize(&pImage->Header)))
+                        || fFullBlock
+                        || !(pImage->uImageFlags & VD_IMAGE_FLAGS_DIFF)))
                 {
                     /* If the destination block is unallocated at this point, it's
                      * either a zero block or a block which hasn't been used so far
                      * (which also means that it's a zero block. Don't need to write
-                     * anything to this block  if the data consists of just zeroes. */
+                     * anything to this block  if the data consists of just zeroes.
+                     * A free block of a base image reads as zeroes as well, so partial
+                     * zero writes to it are dropped too instead of letting the upper
+                     * layer assemble and allocate a block consisting of zeroes only. */
                     if (vdIfIoIntIoCtxIsZero(pImage->pIfIo, pIoCtx, cbToWrite, true))
                     {
-                        pImage->paBlocks[uBlock] = VDI_IMAGE_BLOCK_ZERO;
+                        if (   fFullBlock
+                            || pImage->paBlocks[uBlock] == VDI_IMAGE_BLOCK_ZERO)
+                            pImage->paBlocks[uBlock] = VDI_IMAGE_BLOCK_ZERO;
                         *pcbPreRead = 0;
                         *pcbPostRead = 0;
                         break;
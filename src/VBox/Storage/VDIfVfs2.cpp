@@ -34,9 +34,13 @@
 #include <iprt/mem.h>
 #include <iprt/err.h>
 #include <iprt/asm.h>
+#include <iprt/critsect.h>
+#include <iprt/list.h>
+#include <iprt/semaphore.h>
 #include <iprt/string.h>
 #include <iprt/file.h>
 #include <iprt/sg.h>
+#include <iprt/thread.h>
 #include <iprt/vfslowlevel.h>
 #include <iprt/poll.h>
 #include <VBox/vd.h>
@@ -48,6 +52,23 @@
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
+/**
+ * A write queued for the write-behind thread.
+ */
+typedef struct VDIFFROMVFSWRITE
+{
+    /** Node in the list of queued writes. */
+    RTLISTNODE      NdQueue;
+    /** The stream offset to write at. */
+    uint64_t        off;
+    /** Number of bytes to write. */
+    size_t          cb;
+    /** The data. */
+    uint8_t         abData[RT_FLEXIBLE_ARRAY];
+} VDIFFROMVFSWRITE;
+/** Pointer to a queued write. */
+typedef VDIFFROMVFSWRITE *PVDIFFROMVFSWRITE;
+
 /**
  * Extended VD I/O interface structure that vdIfFromVfs_xxx uses.
  *
@@ -69,6 +90,26 @@ typedef struct VDIFFROMVFS
     void           *pvCompletedUser;
     /** Set if hVfsIos has been opened. */
     bool            fOpened;
+
+    /** @name Write-behind state, only used with VD_IFFROMVFS_F_WRITE_BEHIND.
+     * @{ */
+    /** The thread doing the writes, NIL_RTTHREAD if writing synchronously. */
+    RTTHREAD        hThreadWriter;
+    /** Protects the queue. */
+    RTCRITSECT      CritSect;
+    /** Signalled when writes got queued or the thread should terminate. */
+    RTSEMEVENT      hEvtWork;
+    /** Signalled when the thread completed a write. */
+    RTSEMEVENT      hEvtDone;
+    /** Queued writes (VDIFFROMVFSWRITE). */
+    RTLISTANCHOR    LstQueue;
+    /** Number of bytes queued or being written. */
+    size_t          cbQueued;
+    /** Status of the first failed write. */
+    int32_t volatile rcWriteBehind;
+    /** Set to make the writer thread terminate once the queue is empty. */
+    bool volatile   fTerminate;
+    /** @} */
 } VDIFFROMVFS;
 /** Magic value for VDIFFROMVFS::u32Magic. */
 #define VDIFFROMVFS_MAGIC   UINT32_C(0x11223344)
@@ -95,6 +136,9 @@ typedef struct FILESTORAGEINTERNAL
 #define STATUS_READING UINT32_C(4)
 #define STATUS_END     UINT32_C(5)
 
+/** Maximum amount of data queued for the write-behind thread before writers block. */
+#define VDIFFROMVFS_WRITE_BEHIND_MAX    (8 * _1M)
+
 /* Enable for getting some flow history. */
 #if 0
 # define DEBUG_PRINT_FLOW() RTPrintf("%s\n", __FUNCTION__)
@@ -168,16 +212,141 @@ static DECLCALLBACK(int) notImpl_WriteSync(void *pvUser, void *pvStorage, uint64
 }
 #endif
 
-/** @interface_method_impl{VDINTERFACEIO,pfnFlushSync}  */
-static DECLCALLBACK(int) notImpl_FlushSync(void *pvUser, void *pvStorage)
+/** @} */
+
+
+/**
+ * @callback_method_impl{FNRTTHREAD, Does the queued writes in order.}
+ */
+static DECLCALLBACK(int) vdIfFromVfsWriteBehindThread(RTTHREAD hThreadSelf, void *pvUser)
 {
-    NOREF(pvUser); NOREF(pvStorage);
-    Log(("%s\n",  __FUNCTION__));
-    AssertFailed();
-    return VERR_NOT_IMPLEMENTED;
+    RT_NOREF(hThreadSelf);
+    PVDIFFROMVFS pThis = (PVDIFFROMVFS)pvUser;
+
+    for (;;)
+    {
+        RTCritSectEnter(&pThis->CritSect);
+        PVDIFFROMVFSWRITE pWrite = RTListRemoveFirst(&pThis->LstQueue, VDIFFROMVFSWRITE, NdQueue);
+        bool fTerminate = ASMAtomicReadBool(&pThis->fTerminate);
+        RTCritSectLeave(&pThis->CritSect);
+
+        if (!pWrite)
+        {
+            if (fTerminate)
+                break;
+            RTSemEventWait(pThis->hEvtWork, RT_INDEFINITE_WAIT);
+            continue;
+        }
+
+        /* Once a write failed the rest is just dropped, the stream is unusable anyway. */
+        if (RT_SUCCESS(ASMAtomicReadS32(&pThis->rcWriteBehind)))
+        {
+            int rc = RTVfsIoStrmWriteAt(pThis->hVfsIos, pWrite->off, &pWrite->abData[0], pWrite->cb,
+                                        true /*fBlocking*/, NULL /*pcbWritten*/);
+            if (RT_FAILURE(rc))
+                ASMAtomicCmpXchgS32(&pThis->rcWriteBehind, rc, VINF_SUCCESS);
+        }
+
+        RTCritSectEnter(&pThis->CritSect);
+        pThis->cbQueued -= pWrite->cb;
+        RTCritSectLeave(&pThis->CritSect);
+        RTMemFree(pWrite);
+        RTSemEventSignal(pThis->hEvtDone);
+    }
+
+    return VINF_SUCCESS;
 }
 
-/** @} */
+/**
+ * Waits until the write-behind thread has no more than the given amount of
+ * data queued.
+ *
+ * @returns Status of the first failed queued write, VINF_SUCCESS if none failed.
+ * @param   pThis       The instance data.
+ * @param   cbMax       The maximum amount of queued data to wait for, 0 to drain the queue.
+ */
+static int vdIfFromVfsWriteBehindWait(PVDIFFROMVFS pThis, size_t cbMax)
+{
+    RTCritSectEnter(&pThis->CritSect);
+    while (   pThis->cbQueued > cbMax
+           && RT_SUCCESS(ASMAtomicReadS32(&pThis->rcWriteBehind)))
+    {
+        RTCritSectLeave(&pThis->CritSect);
+        RTSemEventWait(pThis->hEvtDone, RT_INDEFINITE_WAIT);
+        RTCritSectEnter(&pThis->CritSect);
+    }
+    RTCritSectLeave(&pThis->CritSect);
+
+    return ASMAtomicReadS32(&pThis->rcWriteBehind);
+}
+
+/**
+ * Terminates the write-behind thread after it did all queued writes and frees
+ * the associated resources.
+ *
+ * @returns Status of the first failed queued write, VINF_SUCCESS if none failed.
+ * @param   pThis       The instance data.
+ */
+static int vdIfFromVfsWriteBehindTerm(PVDIFFROMVFS pThis)
+{
+    if (pThis->hThreadWriter == NIL_RTTHREAD)
+        return VINF_SUCCESS;
+
+    ASMAtomicWriteBool(&pThis->fTerminate, true);
+    RTSemEventSignal(pThis->hEvtWork);
+    int rc = RTThreadWait(pThis->hThreadWriter, RT_INDEFINITE_WAIT, NULL);
+    AssertRC(rc);
+    pThis->hThreadWriter = NIL_RTTHREAD;
+
+    RTSemEventDestroy(pThis->hEvtWork);
+    RTSemEventDestroy(pThis->hEvtDone);
+    RTCritSectDelete(&pThis->CritSect);
+    pThis->hEvtWork = NIL_RTSEMEVENT;
+    pThis->hEvtDone = NIL_RTSEMEVENT;
+    Assert(RTListIsEmpty(&pThis->LstQueue));
+
+    return ASMAtomicReadS32(&pThis->rcWriteBehind);
+}
+
+/**
+ * Sets up the write-behind thread.
+ *
+ * @returns VBox status code.
+ * @param   pThis       The instance data.
+ */
+static int vdIfFromVfsWriteBehindInit(PVDIFFROMVFS pThis)
+{
+    RTListInit(&pThis->LstQueue);
+    pThis->cbQueued      = 0;
+    pThis->rcWriteBehind = VINF_SUCCESS;
+    pThis->fTerminate    = false;
+
+    int rc = RTCritSectInit(&pThis->CritSect);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTSemEventCreate(&pThis->hEvtWork);
+        if (RT_SUCCESS(rc))
+        {
+            rc = RTSemEventCreate(&pThis->hEvtDone);
+            if (RT_SUCCESS(rc))
+            {
+                rc = RTThreadCreate(&pThis->hThreadWriter, vdIfFromVfsWriteBehindThread, pThis, 0 /*cbStack*/,
+                                    RTTHREADTYPE_IO, RTTHREADFLAGS_WAITABLE, "VDIfVfsWr");
+                if (RT_SUCCESS(rc))
+                    return VINF_SUCCESS;
+
+                pThis->hThreadWriter = NIL_RTTHREAD;
+                RTSemEventDestroy(pThis->hEvtDone);
+                pThis->hEvtDone = NIL_RTSEMEVENT;
+            }
+            RTSemEventDestroy(pThis->hEvtWork);
+            pThis->hEvtWork = NIL_RTSEMEVENT;
+        }
+        RTCritSectDelete(&pThis->CritSect);
+    }
+
+    return rc;
+}
 
 
 /** @interface_method_impl{VDINTERFACEIO,pfnOpen}  */
@@ -219,10 +388,30 @@ static DECLCALLBACK(int) vdIfFromVfs_Close(void *pvUser, void *pvStorage)
     AssertReturn(pThis->hVfsIos == (RTVFSIOSTREAM)pvStorage, VERR_INVALID_HANDLE);
     AssertReturn(pThis->fOpened, VERR_INVALID_HANDLE);
 
+    int rc = vdIfFromVfsWriteBehindTerm(pThis);
+
     RTVfsIoStrmRelease(pThis->hVfsIos);
     pThis->hVfsIos = NIL_RTVFSIOSTREAM;
 
-    return VINF_SUCCESS;
+    return rc;
+}
+
+
+/** @interface_method_impl{VDINTERFACEIO,pfnFlushSync}  */
+static DECLCALLBACK(int) vdIfFromVfs_FlushSync(void *pvUser, void *pvStorage)
+{
+    PVDIFFROMVFS pThis = (PVDIFFROMVFS)pvUser;
+    AssertPtrReturn(pThis, VERR_INVALID_POINTER);
+    AssertReturn(pThis->hVfsIos == (RTVFSIOSTREAM)pvStorage, VERR_INVALID_HANDLE);
+    AssertReturn(pThis->fOpened, VERR_INVALID_HANDLE);
+
+    /* Get the queued writes out first so their status is what we return. */
+    int rc = VINF_SUCCESS;
+    if (pThis->hThreadWriter != NIL_RTTHREAD)
+        rc = vdIfFromVfsWriteBehindWait(pThis, 0 /*cbMax*/);
+    if (RT_SUCCESS(rc))
+        rc = RTVfsIoStrmFlush(pThis->hVfsIos);
+    return rc;
 }
 
 
@@ -234,8 +423,16 @@ static DECLCALLBACK(int) vdIfFromVfs_GetSize(void *pvUser, void *pvStorage, uint
     AssertReturn(pThis->hVfsIos == (RTVFSIOSTREAM)pvStorage, VERR_INVALID_HANDLE);
     AssertReturn(pThis->fOpened, VERR_INVALID_HANDLE);
 
+    int rc = VINF_SUCCESS;
+    if (pThis->hThreadWriter != NIL_RTTHREAD)
+    {
+        rc = vdIfFromVfsWriteBehindWait(pThis, 0 /*cbMax*/);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
     RTFSOBJINFO ObjInfo;
-    int rc = RTVfsIoStrmQueryInfo(pThis->hVfsIos, &ObjInfo, RTFSOBJATTRADD_NOTHING);
+    rc = RTVfsIoStrmQueryInfo(pThis->hVfsIos, &ObjInfo, RTFSOBJATTRADD_NOTHING);
     if (RT_SUCCESS(rc))
         *pcb = ObjInfo.cbObject;
     return rc;
@@ -252,6 +449,13 @@ static DECLCALLBACK(int) vdIfFromVfs_ReadSync(void *pvUser, void *pvStorage, uin
     AssertPtrNullReturn(pcbRead, VERR_INVALID_POINTER);
     AssertReturn(pThis->fAccessMode & RTFILE_O_READ, VERR_ACCESS_DENIED);
 
+    if (pThis->hThreadWriter != NIL_RTTHREAD)
+    {
+        int rc = vdIfFromVfsWriteBehindWait(pThis, 0 /*cbMax*/);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
     return RTVfsIoStrmReadAt(pThis->hVfsIos, off, pvBuf, cbToRead, true /*fBlocking*/, pcbRead);
 }
 
@@ -267,11 +471,42 @@ static DECLCALLBACK(int) vdIfFromVfs_WriteSync(void *pvUser, void *pvStorage, ui
     AssertPtrNullReturn(pcbWritten, VERR_INVALID_POINTER);
     AssertReturn(pThis->fAccessMode & RTFILE_O_WRITE, VERR_ACCESS_DENIED);
 
-    return RTVfsIoStrmWriteAt(pThis->hVfsIos, off, pvBuf, cbToWrite, true /*fBlocking*/, pcbWritten);
+    if (pThis->hThreadWriter == NIL_RTTHREAD)
+        return RTVfsIoStrmWriteAt(pThis->hVfsIos, off, pvBuf, cbToWrite, true /*fBlocking*/, pcbWritten);
+
+    /*
+     * Queue a copy of the data for the writer thread, blocking while too much is in flight.
+     */
+    int rc = vdIfFromVfsWriteBehindWait(pThis, VDIFFROMVFS_WRITE_BEHIND_MAX);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    PVDIFFROMVFSWRITE pWrite = (PVDIFFROMVFSWRITE)RTMemAlloc(RT_UOFFSETOF_DYN(VDIFFROMVFSWRITE, abData[cbToWrite]));
+    if (!pWrite)
+        return VERR_NO_MEMORY;
+    pWrite->off = off;
+    pWrite->cb  = cbToWrite;
+    memcpy(&pWrite->abData[0], pvBuf, cbToWrite);
+
+    RTCritSectEnter(&pThis->CritSect);
+    RTListAppend(&pThis->LstQueue, &pWrite->NdQueue);
+    pThis->cbQueued += cbToWrite;
+    RTCritSectLeave(&pThis->CritSect);
+    RTSemEventSignal(pThis->hEvtWork);
+
+    if (pcbWritten)
+        *pcbWritten = cbToWrite;
+    return VINF_SUCCESS;
 }
 
 
 VBOXDDU_DECL(int) VDIfCreateFromVfsStream(RTVFSIOSTREAM hVfsIos, uint32_t fAccessMode, PVDINTERFACEIO *ppIoIf)
+{
+    return VDIfCreateFromVfsStreamEx(hVfsIos, fAccessMode, 0 /*fFlags*/, ppIoIf);
+}
+
+
+VBOXDDU_DECL(int) VDIfCreateFromVfsStreamEx(RTVFSIOSTREAM hVfsIos, uint32_t fAccessMode, uint32_t fFlags, PVDINTERFACEIO *ppIoIf)
 {
     /*
      * Validate input.
@@ -280,6 +515,7 @@ VBOXDDU_DECL(int) VDIfCreateFromVfsStream(RTVFSIOSTREAM hVfsIos, uint32_t fAcces
     *ppIoIf = NULL;
     AssertReturn(hVfsIos != NIL_RTVFSIOSTREAM, VERR_INVALID_HANDLE);
     AssertReturn(fAccessMode & RTFILE_O_ACCESS_MASK, VERR_INVALID_FLAGS);
+    AssertReturn(!(fFlags & ~VD_IFFROMVFS_F_VALID_MASK), VERR_INVALID_FLAGS);
 
     uint32_t cRefs = RTVfsIoStrmRetain(hVfsIos);
     AssertReturn(cRefs != UINT32_MAX, VERR_INVALID_HANDLE);
@@ -301,15 +537,22 @@ VBOXDDU_DECL(int) VDIfCreateFromVfsStream(RTVFSIOSTREAM hVfsIos, uint32_t fAcces
         pThis->CoreIo.pfnSetSize             = notImpl_SetSize;
         pThis->CoreIo.pfnReadSync            = vdIfFromVfs_ReadSync;
         pThis->CoreIo.pfnWriteSync           = vdIfFromVfs_WriteSync;
-        pThis->CoreIo.pfnFlushSync           = notImpl_FlushSync;
+        pThis->CoreIo.pfnFlushSync           = vdIfFromVfs_FlushSync;
 
         pThis->hVfsIos     = hVfsIos;
         pThis->fAccessMode = fAccessMode;
         pThis->fOpened     = false;
         pThis->u32Magic    = VDIFFROMVFS_MAGIC;
+        pThis->hThreadWriter = NIL_RTTHREAD;
+        pThis->hEvtWork      = NIL_RTSEMEVENT;
+        pThis->hEvtDone      = NIL_RTSEMEVENT;
 
         PVDINTERFACE pFakeList = NULL;
         rc = VDInterfaceAdd(&pThis->CoreIo.Core, "FromVfsStream", VDINTERFACETYPE_IO, pThis, sizeof(pThis->CoreIo), &pFakeList);
+        if (   RT_SUCCESS(rc)
+            && (fFlags & VD_IFFROMVFS_F_WRITE_BEHIND)
+            && (fAccessMode & RTFILE_O_WRITE))
+            rc = vdIfFromVfsWriteBehindInit(pThis);
         if (RT_SUCCESS(rc))
         {
             *ppIoIf = &pThis->CoreIo;
@@ -327,12 +570,16 @@ VBOXDDU_DECL(int) VDIfCreateFromVfsStream(RTVFSIOSTREAM hVfsIos, uint32_t fAcces
 
 VBOXDDU_DECL(int) VDIfDestroyFromVfsStream(PVDINTERFACEIO pIoIf)
 {
+    int rc = VINF_SUCCESS;
     if (pIoIf)
     {
         PVDIFFROMVFS            pThis = (PVDIFFROMVFS)pIoIf;
         AssertPtrReturn(pThis, VERR_INVALID_POINTER);
         AssertReturn(pThis->u32Magic == VDIFFROMVFS_MAGIC, VERR_INVALID_MAGIC);
 
+        /* Only reached with the thread still running if the stream was never closed. */
+        rc = vdIfFromVfsWriteBehindTerm(pThis);
+
         if (pThis->hVfsIos != NIL_RTVFSIOSTREAM)
         {
             RTVfsIoStrmRelease(pThis->hVfsIos);
@@ -341,6 +588,6 @@ VBOXDDU_DECL(int) VDIfDestroyFromVfsStream(PVDINTERFACEIO pIoIf)
         pThis->u32Magic = ~VDIFFROMVFS_MAGIC;
         RTMemFree(pThis);
     }
-    return VINF_SUCCESS;
+    return rc;
 }
 
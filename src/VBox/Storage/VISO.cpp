@@ -40,6 +40,7 @@
 #include <iprt/getopt.h>
 #include <iprt/mem.h>
 #include <iprt/path.h>
+#include <iprt/sg.h>
 #include <iprt/string.h>
 #include <iprt/uuid.h>
 
@@ -57,6 +58,9 @@
 # define VISO_MAX_FILE_SIZE     _8M
 #endif
 
+/** Maximum number of I/O context segments handed to the ISO maker per read call. */
+#define VISO_READ_MAX_SEGS      16
+
 
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
@@ -726,19 +730,27 @@ static DECLCALLBACK(int) visoRead(void *pBackendData, uint64_t uOffset, size_t c
         cbToRead = cbLeftInImage; /* ASSUMES the caller can deal with this, given the pcbActuallyRead parameter... */
 
     /*
-     * Work the I/O context using vdIfIoIntIoCtxSegArrayCreate.
+     * Work the I/O context using vdIfIoIntIoCtxSegArrayCreate, passing several
+     * segments at a time so a fragmented guest buffer costs one walk of the
+     * ISO maker's section and file lookups instead of one per segment.
      */
     int    rc = VINF_SUCCESS;
     size_t cbActuallyRead = 0;
     while (cbToRead > 0)
     {
-        RTSGSEG     Seg;
-        unsigned    cSegs = 1;
-        size_t      cbThisRead = vdIfIoIntIoCtxSegArrayCreate(pThis->pIfIo, pIoCtx, &Seg, &cSegs, cbToRead);
-        AssertBreakStmt(cbThisRead != 0, rc = VERR_INTERNAL_ERROR_2);
-        Assert(cbThisRead == Seg.cbSeg);
+        RTSGSEG     aSegs[VISO_READ_MAX_SEGS];
+        unsigned    cSegs = RT_ELEMENTS(aSegs);
+        size_t      cbThisRead = vdIfIoIntIoCtxSegArrayCreate(pThis->pIfIo, pIoCtx, &aSegs[0], &cSegs, cbToRead);
+        AssertBreakStmt(cbThisRead != 0 && cSegs > 0, rc = VERR_INTERNAL_ERROR_2);
 
-        rc = RTVfsFileReadAt(pThis->hIsoFile, off, Seg.pvSeg, cbThisRead, NULL);
+        if (cSegs == 1)
+            rc = RTVfsFileReadAt(pThis->hIsoFile, off, aSegs[0].pvSeg, cbThisRead, NULL);
+        else
+        {
+            RTSGBUF SgBuf;
+            RTSgBufInit(&SgBuf, &aSegs[0], cSegs);
+            rc = RTVfsFileSgRead(pThis->hIsoFile, off, &SgBuf, true /*fBlocking*/, NULL);
+        }
         AssertRCBreak(rc);
 
         /* advance. */
@@ -39,10 +39,12 @@
 #include <iprt/base64.h>
 #include <iprt/ctype.h>
 #include <iprt/crc.h>
+#include <iprt/mp.h>
 #include <iprt/dvm.h>
 #include <iprt/uuid.h>
 #include <iprt/path.h>
 #include <iprt/rand.h>
+#include <iprt/req.h>
 #include <iprt/sg.h>
 #include <iprt/sort.h>
 #include <iprt/string.h>
@@ -364,6 +366,12 @@ typedef struct VMDKEXTENT
     void        *pvCompGrain;
     /** Decompressed grain buffer for streamOptimized extents. */
     void        *pvGrain;
+    /** Grains queued for parallel compression when writing streamOptimized
+     * extents, NULL if grains are compressed one by one. */
+    struct VMDKDEFLATEBATCH *pDeflateBatch;
+    /** Flag whether setting up parallel compression failed or is pointless,
+     * don't retry. */
+    bool        fDeflateSerial;
     /** Reference to the image in which this extent is used. Do not use this
      * on a regular basis to avoid passing pImage references to functions
      * explicitly. */
@@ -530,6 +538,52 @@ typedef struct VMDKCOMPRESSIO
 } VMDKCOMPRESSIO;
 
 
+/** Maximum number of worker threads compressing grains of streamOptimized images. */
+#define VMDK_DEFLATE_THREADS_MAX        8
+/** Number of grains queued per worker thread before the queue is compressed. */
+#define VMDK_DEFLATE_GRAINS_PER_THREAD  4
+
+/** A grain queued for compression when writing a streamOptimized extent. */
+typedef struct VMDKDEFLATEGRAIN
+{
+    /** The grain number. */
+    uint32_t    uGrain;
+    /** The LBA of the grain stored in the marker. */
+    uint64_t    uLBA;
+    /** The uncompressed grain data. */
+    void        *pvGrain;
+    /** The compressed grain buffer, including the marker. */
+    void        *pvCompGrain;
+    /** Size of the compressed data including marker and padding, valid after compression. */
+    uint32_t    cbMarkerData;
+    /** The request compressing the grain on a worker thread. */
+    PRTREQ      hReq;
+} VMDKDEFLATEGRAIN;
+/** Pointer to a queued grain. */
+typedef VMDKDEFLATEGRAIN *PVMDKDEFLATEGRAIN;
+
+/**
+ * Queue of grains to compress in parallel before appending them in order to a
+ * streamOptimized extent.
+ *
+ * The compressed size of a grain determines where the next one goes, so only
+ * the compression runs in parallel while the writes stay sequential.
+ */
+typedef struct VMDKDEFLATEBATCH
+{
+    /** The worker thread pool. */
+    RTREQPOOL           hReqPool;
+    /** Maximum number of grains in the queue. */
+    uint32_t            cGrainsMax;
+    /** Number of grains currently queued. */
+    uint32_t            cGrains;
+    /** The queued grains. */
+    PVMDKDEFLATEGRAIN   paGrains;
+} VMDKDEFLATEBATCH;
+/** Pointer to a parallel compression queue. */
+typedef VMDKDEFLATEBATCH *PVMDKDEFLATEBATCH;
+
+
 /** Tracks async grain allocation. */
 typedef struct VMDKGRAINALLOCASYNC
 {
@@ -628,6 +682,7 @@ static int vmdkCreateExtents(PVMDKIMAGE pImage, unsigned cExtents);
 static int vmdkFlushImage(PVMDKIMAGE pImage, PVDIOCTX pIoCtx);
 static int vmdkSetImageComment(PVMDKIMAGE pImage, const char *pszComment);
 static int vmdkFreeImage(PVMDKIMAGE pImage, bool fDelete, bool fFlush);
+static int vmdkStreamDeflateBatchFlush(PVMDKIMAGE pImage, PVMDKEXTENT pExtent);
 
 static DECLCALLBACK(int) vmdkAllocGrainComplete(void *pBackendData, PVDIOCTX pIoCtx,
                                                 void *pvUser, int rcReq);
@@ -914,13 +969,14 @@ static DECLCALLBACK(int) vmdkFileDeflateHelper(void *pvUser, const void *pvBuf,
 }
 
 /**
- * Internal: deflate the uncompressed data and write to a file,
- * distinguishing between async and normal operation
+ * Internal: deflate the uncompressed data into the given compressed grain
+ * buffer and set up the grain marker at its start.
+ *
+ * Doesn't access any image state, so it can run on a worker thread.
  */
-DECLINLINE(int) vmdkFileDeflateSync(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
-                                    uint64_t uOffset, const void *pvBuf,
-                                    size_t cbToWrite, uint64_t uLBA,
-                                    uint32_t *pcbMarkerData)
+static int vmdkDeflateGrain(PVMDKIMAGE pImage, void *pvCompGrain, size_t cbCompGrain,
+                            const void *pvBuf, size_t cbToWrite, uint64_t uLBA,
+                            uint32_t *pcbMarkerData)
 {
     int rc;
     PRTZIPCOMP pZip = NULL;
@@ -928,8 +984,8 @@ DECLINLINE(int) vmdkFileDeflateSync(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
 
     DeflateState.pImage = pImage;
     DeflateState.iOffset = -1;
-    DeflateState.cbCompGrain = pExtent->cbCompGrain;
-    DeflateState.pvCompGrain = pExtent->pvCompGrain;
+    DeflateState.cbCompGrain = cbCompGrain;
+    DeflateState.pvCompGrain = pvCompGrain;
 
     rc = RTZipCompCreate(&pZip, &DeflateState, vmdkFileDeflateHelper,
                          RTZIPTYPE_ZLIB, RTZIPLEVEL_DEFAULT);
@@ -949,23 +1005,40 @@ DECLINLINE(int) vmdkFileDeflateSync(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
         if (uSize % 512)
         {
             uint32_t uSizeAlign = RT_ALIGN(uSize, 512);
-            memset((uint8_t *)pExtent->pvCompGrain + uSize, '\0',
+            memset((uint8_t *)pvCompGrain + uSize, '\0',
                    uSizeAlign - uSize);
             uSize = uSizeAlign;
         }
 
-        if (pcbMarkerData)
-            *pcbMarkerData = uSize;
+        *pcbMarkerData = uSize;
 
         /* Compressed grain marker. Data follows immediately. */
-        VMDKMARKER *pMarker = (VMDKMARKER *)pExtent->pvCompGrain;
+        VMDKMARKER *pMarker = (VMDKMARKER *)pvCompGrain;
         pMarker->uSector = RT_H2LE_U64(uLBA);
         pMarker->cbSize = RT_H2LE_U32(  DeflateState.iOffset
                                       - RT_UOFFSETOF(VMDKMARKER, uType));
+    }
+    return rc;
+}
+
+/**
+ * Internal: deflate the uncompressed data and write to a file,
+ * distinguishing between async and normal operation
+ */
+DECLINLINE(int) vmdkFileDeflateSync(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
+                                    uint64_t uOffset, const void *pvBuf,
+                                    size_t cbToWrite, uint64_t uLBA,
+                                    uint32_t *pcbMarkerData)
+{
+    uint32_t uSize = 0;
+    int rc = vmdkDeflateGrain(pImage, pExtent->pvCompGrain, pExtent->cbCompGrain,
+                              pvBuf, cbToWrite, uLBA, &uSize);
+    if (RT_SUCCESS(rc))
+    {
+        if (pcbMarkerData)
+            *pcbMarkerData = uSize;
         rc = vdIfIoIntFileWriteSync(pImage->pIfIo, pExtent->pFile->pStorage,
-                                    uOffset, pMarker, uSize);
-        if (RT_FAILURE(rc))
-            return rc;
+                                    uOffset, pExtent->pvCompGrain, uSize);
     }
     return rc;
 }
@@ -1177,6 +1250,32 @@ DECLINLINE(void) vmdkGrainDirectoryConvToHost(uint32_t *pGD, uint32_t cGDEntries
         *pGDTmp = RT_LE2H_U32(*pGDTmp);
 }
 
+/**
+ * Writes a complete grain directory to disk with a single write.
+ *
+ * @returns VBox status code.
+ * @param   pImage          Image instance data.
+ * @param   pExtent         The VMDK extent.
+ * @param   pGD             The grain directory in host endianess.
+ * @param   uSectorGD       Where the grain directory is stored in the image.
+ */
+static int vmdkGrainDirectoryWrite(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
+                                   const uint32_t *pGD, uint64_t uSectorGD)
+{
+    size_t cbGD = pExtent->cGDEntries * sizeof(uint32_t);
+    uint32_t *pGDLE = (uint32_t *)RTMemTmpAlloc(cbGD);
+    if (RT_UNLIKELY(!pGDLE))
+        return VERR_NO_MEMORY;
+
+    for (uint32_t i = 0; i < pExtent->cGDEntries; i++)
+        pGDLE[i] = RT_H2LE_U32(pGD[i]);
+
+    int rc = vdIfIoIntFileWriteSync(pImage->pIfIo, pExtent->pFile->pStorage,
+                                    VMDK_SECTOR2BYTE(uSectorGD), pGDLE, cbGD);
+    RTMemTmpFree(pGDLE);
+    return rc;
+}
+
 /**
  * Read the grain directory and allocated grain tables verifying them against
  * their back up copies if available.
@@ -1452,27 +1551,21 @@ static int vmdkCreateGrainDirectory(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
             if (   RT_SUCCESS(rc)
                 && fPreAlloc)
             {
-                uint32_t uGTSectorLE;
                 uint64_t uOffsetSectors;
 
+                /* Fill in the directories and write each of them to disk in one go. */
                 if (pExtent->pRGD)
                 {
                     uOffsetSectors = pExtent->uSectorRGD + VMDK_BYTE2SECTOR(cbGDRounded);
                     for (i = 0; i < pExtent->cGDEntries; i++)
                     {
                         pExtent->pRGD[i] = uOffsetSectors;
-                        uGTSectorLE = RT_H2LE_U64(uOffsetSectors);
-                        /* Write the redundant grain directory entry to disk. */
-                        rc = vdIfIoIntFileWriteSync(pImage->pIfIo, pExtent->pFile->pStorage,
-                                                    VMDK_SECTOR2BYTE(pExtent->uSectorRGD) + i * sizeof(uGTSectorLE),
-                                                    &uGTSectorLE, sizeof(uGTSectorLE));
-                        if (RT_FAILURE(rc))
-                        {
-                            rc = vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("VMDK: cannot write new redundant grain directory entry in '%s'"), pExtent->pszFullname);
-                            break;
-                        }
                         uOffsetSectors += VMDK_BYTE2SECTOR(pExtent->cGTEntries * sizeof(uint32_t));
                     }
+
+                    rc = vmdkGrainDirectoryWrite(pImage, pExtent, pExtent->pRGD, pExtent->uSectorRGD);
+                    if (RT_FAILURE(rc))
+                        rc = vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("VMDK: cannot write new redundant grain directory in '%s'"), pExtent->pszFullname);
                 }
 
                 if (RT_SUCCESS(rc))
@@ -1481,18 +1574,12 @@ static int vmdkCreateGrainDirectory(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
                     for (i = 0; i < pExtent->cGDEntries; i++)
                     {
                         pExtent->pGD[i] = uOffsetSectors;
-                        uGTSectorLE = RT_H2LE_U64(uOffsetSectors);
-                        /* Write the grain directory entry to disk. */
-                        rc = vdIfIoIntFileWriteSync(pImage->pIfIo, pExtent->pFile->pStorage,
-                                                    VMDK_SECTOR2BYTE(pExtent->uSectorGD) + i * sizeof(uGTSectorLE),
-                                                    &uGTSectorLE, sizeof(uGTSectorLE));
-                        if (RT_FAILURE(rc))
-                        {
-                            rc = vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("VMDK: cannot write new grain directory entry in '%s'"), pExtent->pszFullname);
-                            break;
-                        }
                         uOffsetSectors += VMDK_BYTE2SECTOR(pExtent->cGTEntries * sizeof(uint32_t));
                     }
+
+                    rc = vmdkGrainDirectoryWrite(pImage, pExtent, pExtent->pGD, pExtent->uSectorGD);
+                    if (RT_FAILURE(rc))
+                        rc = vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("VMDK: cannot write new grain directory in '%s'"), pExtent->pszFullname);
                 }
             }
         }
@@ -3024,6 +3111,21 @@ static int vmdkWriteMetaSparseExtent(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
  */
 static void vmdkFreeStreamBuffers(PVMDKEXTENT pExtent)
 {
+    PVMDKDEFLATEBATCH pBatch = pExtent->pDeflateBatch;
+    if (pBatch)
+    {
+        /* Anything still queued is dropped, the close code flushes the queue
+         * unless the image is going to be deleted. */
+        RTReqPoolRelease(pBatch->hReqPool);
+        for (uint32_t i = 0; i < pBatch->cGrainsMax; i++)
+        {
+            RTMemFree(pBatch->paGrains[i].pvGrain);
+            RTMemFree(pBatch->paGrains[i].pvCompGrain);
+        }
+        RTMemFree(pBatch->paGrains);
+        RTMemFree(pBatch);
+        pExtent->pDeflateBatch = NULL;
+    }
     if (pExtent->pvCompGrain)
     {
         RTMemFree(pExtent->pvCompGrain);
@@ -6130,6 +6232,8 @@ static int vmdkFreeImage(PVMDKIMAGE pImage, bool fDelete, bool fFlush)
             {
                 PVMDKEXTENT pExtent = &pImage->pExtents[0];
                 uint32_t uLastGDEntry = pExtent->uLastGrainAccess / pExtent->cGTEntries;
+                rc = vmdkStreamDeflateBatchFlush(pImage, pExtent);
+                AssertRC(rc);
                 rc = vmdkStreamFlushGT(pImage, pExtent, uLastGDEntry);
                 AssertRC(rc);
                 vmdkStreamClearGT(pImage, pExtent);
@@ -6418,6 +6522,147 @@ static int vmdkGetSector(PVMDKIMAGE pImage, PVDIOCTX pIoCtx,
     return VINF_SUCCESS;
 }
 
+/**
+ * Internal. Sets up the queue for compressing grains of a streamOptimized
+ * extent on worker threads.
+ *
+ * @returns VBox status code, failure means grains are compressed serially.
+ * @param   pExtent         The extent to set up the queue for.
+ */
+static int vmdkStreamDeflateBatchCreate(PVMDKEXTENT pExtent)
+{
+    uint32_t cThreads = RT_MIN(RTMpGetOnlineCount(), VMDK_DEFLATE_THREADS_MAX);
+    if (cThreads <= 1)
+        return VERR_NOT_SUPPORTED;
+
+    PVMDKDEFLATEBATCH pBatch = (PVMDKDEFLATEBATCH)RTMemAllocZ(sizeof(VMDKDEFLATEBATCH));
+    if (!pBatch)
+        return VERR_NO_MEMORY;
+
+    pBatch->cGrainsMax = cThreads * VMDK_DEFLATE_GRAINS_PER_THREAD;
+    pBatch->paGrains   = (PVMDKDEFLATEGRAIN)RTMemAllocZ(pBatch->cGrainsMax * sizeof(VMDKDEFLATEGRAIN));
+    int rc = pBatch->paGrains ? VINF_SUCCESS : VERR_NO_MEMORY;
+    for (uint32_t i = 0; i < pBatch->cGrainsMax && RT_SUCCESS(rc); i++)
+    {
+        pBatch->paGrains[i].hReq        = NIL_RTREQ;
+        pBatch->paGrains[i].pvGrain     = RTMemAlloc(VMDK_SECTOR2BYTE(pExtent->cSectorsPerGrain));
+        pBatch->paGrains[i].pvCompGrain = RTMemAlloc(pExtent->cbCompGrain);
+        if (   !pBatch->paGrains[i].pvGrain
+            || !pBatch->paGrains[i].pvCompGrain)
+            rc = VERR_NO_MEMORY;
+    }
+    if (RT_SUCCESS(rc))
+        rc = RTReqPoolCreate(cThreads, RT_MS_10SEC /*cMsMinIdle*/, UINT32_MAX /*cThreadsPushBackThreshold*/,
+                             0 /*cMsMaxPushBack*/, "VmdkDefl", &pBatch->hReqPool);
+    if (RT_SUCCESS(rc))
+    {
+        pExtent->pDeflateBatch = pBatch;
+        return VINF_SUCCESS;
+    }
+
+    if (pBatch->paGrains)
+    {
+        for (uint32_t i = 0; i < pBatch->cGrainsMax; i++)
+        {
+            RTMemFree(pBatch->paGrains[i].pvGrain);
+            RTMemFree(pBatch->paGrains[i].pvCompGrain);
+        }
+        RTMemFree(pBatch->paGrains);
+    }
+    RTMemFree(pBatch);
+    return rc;
+}
+
+/**
+ * Internal. Worker thread callback compressing a single queued grain.
+ */
+static DECLCALLBACK(int) vmdkStreamDeflateWorker(PVMDKIMAGE pImage, PVMDKEXTENT pExtent, PVMDKDEFLATEGRAIN pGrain)
+{
+    return vmdkDeflateGrain(pImage, pGrain->pvCompGrain, pExtent->cbCompGrain,
+                            pGrain->pvGrain, VMDK_SECTOR2BYTE(pExtent->cSectorsPerGrain),
+                            pGrain->uLBA, &pGrain->cbMarkerData);
+}
+
+/**
+ * Internal. Compresses all queued grains of a streamOptimized extent in
+ * parallel, then appends them to the file in the order they were queued and
+ * updates the grain table buffer.
+ *
+ * Must be called before anything else gets appended to the extent or the
+ * grain table buffer is flushed.
+ *
+ * @returns VBox status code.
+ * @param   pImage          The image instance data.
+ * @param   pExtent         The extent to flush the queue for.
+ */
+static int vmdkStreamDeflateBatchFlush(PVMDKIMAGE pImage, PVMDKEXTENT pExtent)
+{
+    PVMDKDEFLATEBATCH pBatch = pExtent->pDeflateBatch;
+    if (!pBatch || !pBatch->cGrains)
+        return VINF_SUCCESS;
+
+    /* Hand all but the last grain to the workers, this thread does the last one itself. */
+    uint32_t const cGrains = pBatch->cGrains;
+    for (uint32_t i = 0; i < cGrains - 1; i++)
+    {
+        PVMDKDEFLATEGRAIN pGrain = &pBatch->paGrains[i];
+        int rc2 = RTReqPoolCallEx(pBatch->hReqPool, 0 /*cMillies*/, &pGrain->hReq,
+                                  RTREQFLAGS_IPRT_STATUS | RTREQFLAGS_NO_WAIT,
+                                  (PFNRT)vmdkStreamDeflateWorker, 3, pImage, pExtent, pGrain);
+        if (RT_FAILURE(rc2))
+            pGrain->hReq = NIL_RTREQ; /* Compressed below on this thread. */
+    }
+
+    int rc = VINF_SUCCESS;
+    for (uint32_t i = cGrains; i-- > 0;)
+    {
+        PVMDKDEFLATEGRAIN pGrain = &pBatch->paGrains[i];
+        int rc2;
+        if (pGrain->hReq != NIL_RTREQ)
+        {
+            rc2 = RTReqWait(pGrain->hReq, RT_INDEFINITE_WAIT);
+            if (RT_SUCCESS(rc2))
+                rc2 = RTReqGetStatus(pGrain->hReq);
+            RTReqRelease(pGrain->hReq);
+            pGrain->hReq = NIL_RTREQ;
+        }
+        else
+            rc2 = vmdkStreamDeflateWorker(pImage, pExtent, pGrain);
+        if (RT_FAILURE(rc2) && RT_SUCCESS(rc))
+            rc = rc2;
+    }
+
+    /* Append the compressed grains in order. */
+    for (uint32_t i = 0; i < cGrains && RT_SUCCESS(rc); i++)
+    {
+        PVMDKDEFLATEGRAIN pGrain = &pBatch->paGrains[i];
+        uint32_t uCacheLine  = pGrain->uGrain % pExtent->cGTEntries / VMDK_GT_CACHELINE_SIZE;
+        uint32_t uCacheEntry = pGrain->uGrain % VMDK_GT_CACHELINE_SIZE;
+
+        uint64_t uFileOffset = pExtent->uAppendPosition;
+        if (!uFileOffset)
+        {
+            rc = VERR_INTERNAL_ERROR;
+            break;
+        }
+        /* Align to sector, as the previous write could have been any size. */
+        uFileOffset = RT_ALIGN_64(uFileOffset, 512);
+
+        rc = vdIfIoIntFileWriteSync(pImage->pIfIo, pExtent->pFile->pStorage,
+                                    uFileOffset, pGrain->pvCompGrain, pGrain->cbMarkerData);
+        if (RT_SUCCESS(rc))
+        {
+            pImage->pGTCache->aGTCache[uCacheLine].aGTData[uCacheEntry] = VMDK_BYTE2SECTOR(uFileOffset);
+            pExtent->uAppendPosition = uFileOffset + pGrain->cbMarkerData;
+        }
+    }
+
+    pBatch->cGrains = 0;
+    if (RT_FAILURE(rc))
+        return vdIfError(pImage->pIfError, rc, RT_SRC_POS, N_("VMDK: cannot write compressed data block in '%s'"), pExtent->pszFullname);
+    return rc;
+}
+
 /**
  * Internal. Writes the grain and also if necessary the grain tables.
  * Uses the grain table cache as a true grain table.
@@ -6466,6 +6711,9 @@ static int vmdkStreamAllocGrain(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
 
     if (uGDEntry != uLastGDEntry)
     {
+        rc = vmdkStreamDeflateBatchFlush(pImage, pExtent);
+        if (RT_FAILURE(rc))
+            return rc;
         rc = vmdkStreamFlushGT(pImage, pExtent, uLastGDEntry);
         if (RT_FAILURE(rc))
             return rc;
@@ -6493,6 +6741,39 @@ static int vmdkStreamAllocGrain(PVMDKIMAGE pImage, PVMDKEXTENT pExtent,
         || pImage->pGTCache->aGTCache[uCacheLine].aGTData[uCacheEntry])
         return VERR_INTERNAL_ERROR;
 
+    if (   !pExtent->pDeflateBatch
+        && !pExtent->fDeflateSerial)
+    {
+        rc = vmdkStreamDeflateBatchCreate(pExtent);
+        if (RT_FAILURE(rc))
+            pExtent->fDeflateSerial = true;
+    }
+
+    PVMDKDEFLATEBATCH pBatch = pExtent->pDeflateBatch;
+    if (pBatch)
+    {
+        /* The grain table entry of a still queued grain is not set yet. */
+        if (   pBatch->cGrains
+            && pBatch->paGrains[pBatch->cGrains - 1].uGrain == uGrain)
+            return VERR_INTERNAL_ERROR;
+
+        /* Queue a copy of the grain, the file offset is known only once the preceding grains are compressed. */
+        PVMDKDEFLATEGRAIN pGrain = &pBatch->paGrains[pBatch->cGrains];
+        vdIfIoIntIoCtxCopyFrom(pImage->pIfIo, pIoCtx, pGrain->pvGrain, cbWrite);
+        if (cbWrite != VMDK_SECTOR2BYTE(pExtent->cSectorsPerGrain))
+            memset((char *)pGrain->pvGrain + cbWrite, '\0',
+                   VMDK_SECTOR2BYTE(pExtent->cSectorsPerGrain) - cbWrite);
+        pGrain->uGrain = uGrain;
+        pGrain->uLBA   = uSector;
+        pExtent->uLastGrainAccess = uGrain;
+
+        if (++pBatch->cGrains == pBatch->cGrainsMax)
+            rc = vmdkStreamDeflateBatchFlush(pImage, pExtent);
+        else
+            rc = VINF_SUCCESS;
+        return rc;
+    }
+
     /* Update grain table entry. */
     pImage->pGTCache->aGTCache[uCacheLine].aGTData[uCacheEntry] = VMDK_BYTE2SECTOR(uFileOffset);
 
@@ -7655,6 +7936,7 @@ static DECLCALLBACK(int) vmdkRead(void *pBackendData, uint64_t uOffset, size_t c
                 if (RT_FAILURE(rc))
                     break;
                 /* Clip read range to at most the rest of the grain. */
+                size_t cbToReadMax = cbToRead;
                 cbToRead = RT_MIN(cbToRead, VMDK_SECTOR2BYTE(pExtent->cSectorsPerGrain - uSectorExtentRel % pExtent->cSectorsPerGrain));
                 Assert(!(cbToRead % 512));
                 if (uSectorExtentAbs == 0)
@@ -7662,7 +7944,30 @@ static DECLCALLBACK(int) vmdkRead(void *pBackendData, uint64_t uOffset, size_t c
                     if (   !(pImage->uImageFlags & VD_VMDK_IMAGE_FLAGS_STREAM_OPTIMIZED)
                         || !(pImage->uOpenFlags & VD_OPEN_FLAGS_READONLY)
                         || !(pImage->uOpenFlags & VD_OPEN_FLAGS_SEQUENTIAL))
+                    {
+                        /*
+                         * Report the whole run of grain directory entries without a grain
+                         * table as free, so copying a sparse image skips those in bulk.
+                         */
+                        uint64_t uGDIndex = uSectorExtentRel / pExtent->cSectorsPerGDE;
+                        if (   !(pImage->uImageFlags & VD_VMDK_IMAGE_FLAGS_STREAM_OPTIMIZED)
+                            && !pExtent->pGD[uGDIndex])
+                        {
+                            uint64_t uSectorEnd = uSectorExtentRel + VMDK_BYTE2SECTOR(cbToReadMax);
+                            uint64_t uSectorFreeEnd = (uGDIndex + 1) * pExtent->cSectorsPerGDE;
+
+                            while (   uSectorFreeEnd < uSectorEnd
+                                   && uGDIndex + 1 < pExtent->cGDEntries
+                                   && !pExtent->pGD[uGDIndex + 1])
+                            {
+                                uGDIndex++;
+                                uSectorFreeEnd += pExtent->cSectorsPerGDE;
+                            }
+
+                            cbToRead = VMDK_SECTOR2BYTE(RT_MIN(uSectorFreeEnd, uSectorEnd) - uSectorExtentRel);
+                        }
                         rc = VERR_VD_BLOCK_FREE;
+                    }
                     else
                         rc = vmdkStreamReadSequential(pImage, pExtent,
                                                       uSectorExtentRel,
@@ -1323,6 +1323,34 @@ VMMR3DECL(int) CFGMR3ConstructDefaultTree(PVM pVM)
 
 
 
+/**
+ * Compares two names.
+ *
+ * @returns Similar to memcpy.
+ * @param   pszName1            The first name.
+ * @param   cchName1            The length of the first name.
+ * @param   pszName2            The second name.
+ * @param   cchName2            The length of the second name.
+ */
+DECLINLINE(int) cfgmR3CompareNames(const char *pszName1, size_t cchName1, const char *pszName2, size_t cchName2)
+{
+    int iDiff;
+    if (cchName1 <= cchName2)
+    {
+        iDiff = memcmp(pszName1, pszName2, cchName1);
+        if (!iDiff && cchName1 < cchName2)
+            iDiff = -1;
+    }
+    else
+    {
+        iDiff = memcmp(pszName1, pszName2, cchName2);
+        if (!iDiff)
+            iDiff = 1;
+    }
+    return iDiff;
+}
+
+
 /**
  * Resolves a path reference to a child node.
  *
@@ -1358,19 +1386,20 @@ static int cfgmR3ResolveNode(PCFGMNODE pNode, const char *pszPath, PCFGMNODE *pp
             pszNext = strchr(pszPath,  '\0');
         RTUINT cchName = pszNext - pszPath;
 
-        /* search child list. */
+        /* search child list, it is sorted (see cfgmR3CompareNames) so we can stop once we're past the name. */
         pChild = pNode->pFirstChild;
         for ( ; pChild; pChild = pChild->pNext)
-            if (pChild->cchName == cchName)
+        {
+            int iDiff = (int)(uint8_t)*pszPath - (int)(uint8_t)pChild->szName[0];
+            if (!iDiff)
+                iDiff = cfgmR3CompareNames(pszPath, cchName, pChild->szName, pChild->cchName);
+            if (iDiff <= 0)
             {
-                int iDiff = memcmp(pszPath, pChild->szName, cchName);
-                if (iDiff <= 0)
-                {
-                    if (iDiff != 0)
-                        pChild = NULL;
-                    break;
-                }
+                if (iDiff != 0)
+                    pChild = NULL;
+                break;
             }
+        }
         if (!pChild)
             return VERR_CFGM_CHILD_NOT_FOUND;
 
@@ -1397,20 +1426,20 @@ static int cfgmR3ResolveLeaf(PCFGMNODE pNode, const char *pszName, PCFGMLEAF *pp
     if (!pNode)
         return VERR_CFGM_NO_PARENT;
 
+    /* The leaf list is sorted (see cfgmR3CompareNames), so we can stop once we're past the name. */
     size_t      cchName = strlen(pszName);
     PCFGMLEAF   pLeaf   = pNode->pFirstLeaf;
     while (pLeaf)
     {
-        if (cchName == pLeaf->cchName)
+        int iDiff = (int)(uint8_t)*pszName - (int)(uint8_t)pLeaf->szName[0];
+        if (!iDiff)
+            iDiff = cfgmR3CompareNames(pszName, cchName, pLeaf->szName, pLeaf->cchName);
+        if (iDiff <= 0)
         {
-            int iDiff = memcmp(pszName, pLeaf->szName, cchName);
-            if (iDiff <= 0)
-            {
-                if (iDiff != 0)
-                    break;
-                *ppLeaf = pLeaf;
-                return VINF_SUCCESS;
-            }
+            if (iDiff != 0)
+                break;
+            *ppLeaf = pLeaf;
+            return VINF_SUCCESS;
         }
 
         /* next */
@@ -1749,34 +1778,6 @@ VMMR3DECL(int) CFGMR3CopyTree(PCFGMNODE pDstTree, PCFGMNODE pSrcTree, uint32_t f
 
 
 
-/**
- * Compares two names.
- *
- * @returns Similar to memcpy.
- * @param   pszName1            The first name.
- * @param   cchName1            The length of the first name.
- * @param   pszName2            The second name.
- * @param   cchName2            The length of the second name.
- */
-DECLINLINE(int) cfgmR3CompareNames(const char *pszName1, size_t cchName1, const char *pszName2, size_t cchName2)
-{
-    int iDiff;
-    if (cchName1 <= cchName2)
-    {
-        iDiff = memcmp(pszName1, pszName2, cchName1);
-        if (!iDiff && cchName1 < cchName2)
-            iDiff = -1;
-    }
-    else
-    {
-        iDiff = memcmp(pszName1, pszName2, cchName2);
-        if (!iDiff)
-            iDiff = 1;
-    }
-    return iDiff;
-}
-
-
 /**
  * Insert a node.
  *
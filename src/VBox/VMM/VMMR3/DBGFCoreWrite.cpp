@@ -84,6 +84,8 @@
 *   Defined Constants And Macros                                                                                                 *
 *********************************************************************************************************************************/
 #define DBGFLOG_NAME           "DBGFCoreWrite"
+/** The size of the buffer guest memory is collected in before writing it out. */
+#define DBGFCORE_MEM_BUF_SIZE  _1M
 
 
 /*********************************************************************************************************************************
@@ -553,6 +555,14 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
      * Write memory ranges.
      */
     Assert(RTFileTell(hFile) == offMemory);
+    uint8_t *pbBuf = (uint8_t *)RTMemAlloc(DBGFCORE_MEM_BUF_SIZE);
+    if (!pbBuf)
+    {
+        LogRel((DBGFLOG_NAME ": Failed to alloc %u bytes for the memory buffer\n", DBGFCORE_MEM_BUF_SIZE));
+        return VERR_NO_MEMORY;
+    }
+    size_t offBuf = 0;
+
     for (uint16_t iRange = 0; iRange < cMemRanges; iRange++)
     {
         RTGCPHYS GCPhysStart;
@@ -562,6 +572,7 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
         if (RT_FAILURE(rc))
         {
             LogRel((DBGFLOG_NAME ": PGMR3PhysGetRange(2) failed for iRange(%u) rc=%Rrc\n", iRange, rc));
+            RTMemFree(pbBuf);
             return rc;
         }
 
@@ -573,29 +584,48 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
          *
          * The read function may fail on MMIO ranges, we write these as zero
          * pages for now (would be nice to have the VGA bits there though).
+         *
+         * The pages are collected in a larger buffer first, as doing one write
+         * per guest page makes dumping big guests take very long.
          */
         uint64_t cbMemRange  = GCPhysEnd - GCPhysStart + 1;
         uint64_t cPages      = cbMemRange >> GUEST_PAGE_SHIFT;
         for (uint64_t iPage = 0; iPage < cPages; iPage++)
         {
-            uint8_t abPage[GUEST_PAGE_SIZE];
-            rc = PGMPhysSimpleReadGCPhys(pVM, abPage, GCPhysStart + (iPage << GUEST_PAGE_SHIFT),  sizeof(abPage));
+            uint8_t *pbPage = &pbBuf[offBuf];
+            rc = PGMPhysSimpleReadGCPhys(pVM, pbPage, GCPhysStart + (iPage << GUEST_PAGE_SHIFT), GUEST_PAGE_SIZE);
             if (RT_FAILURE(rc))
             {
                 if (rc != VERR_PGM_PHYS_PAGE_RESERVED)
                     LogRel((DBGFLOG_NAME ": PGMPhysRead failed for iRange=%u iPage=%u. rc=%Rrc. Ignoring...\n", iRange, iPage, rc));
-                RT_ZERO(abPage);
+                RT_BZERO(pbPage, GUEST_PAGE_SIZE);
             }
 
-            rc = RTFileWrite(hFile, abPage, sizeof(abPage), NULL /* all */);
-            if (RT_FAILURE(rc))
+            offBuf += GUEST_PAGE_SIZE;
+            if (offBuf == DBGFCORE_MEM_BUF_SIZE)
             {
-                LogRel((DBGFLOG_NAME ": RTFileWrite failed. iRange=%u iPage=%u rc=%Rrc\n", iRange, iPage, rc));
-                return rc;
+                rc = RTFileWrite(hFile, pbBuf, offBuf, NULL /* all */);
+                if (RT_FAILURE(rc))
+                {
+                    LogRel((DBGFLOG_NAME ": RTFileWrite failed. iRange=%u iPage=%u rc=%Rrc\n", iRange, iPage, rc));
+                    RTMemFree(pbBuf);
+                    return rc;
+                }
+                offBuf = 0;
             }
         }
     }
 
+    /* Write what's left in the buffer. */
+    rc = VINF_SUCCESS;
+    if (offBuf)
+    {
+        rc = RTFileWrite(hFile, pbBuf, offBuf, NULL /* all */);
+        if (RT_FAILURE(rc))
+            LogRel((DBGFLOG_NAME ": RTFileWrite failed for the last %zu bytes. rc=%Rrc\n", offBuf, rc));
+    }
+
+    RTMemFree(pbBuf);
     return rc;
 }
 
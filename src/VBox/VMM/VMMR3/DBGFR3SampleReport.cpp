@@ -37,6 +37,7 @@
 *********************************************************************************************************************************/
 #define LOG_GROUP LOG_GROUP_DBGF
 #include <VBox/vmm/dbgf.h>
+#include <VBox/vmm/cpum.h>
 #include "DBGFInternal.h"
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/uvm.h>
@@ -403,6 +404,144 @@ static void dbgfR3SampleReportDumpFrame(PCDBGFINFOHLP pHlp, PUVM pUVM, PCDBGFSAM
 }
 
 
+/**
+ * Formats the symbol of a frame for the folded stack output.
+ *
+ * Offsets are left out so all samples hitting the same function get merged.
+ *
+ * @param   pUVM                    The usermode VM handle.
+ * @param   pFrame                  The frame to format.
+ * @param   pszBuf                  Where to store the name.
+ * @param   cbBuf                   Size of the buffer.
+ */
+static void dbgfR3SampleReportFormatFoldedFrame(PUVM pUVM, PCDBGFSAMPLEFRAME pFrame, char *pszBuf, size_t cbBuf)
+{
+    if (DBGFR3AddrIsValid(pUVM, &pFrame->AddrFrame))
+    {
+        RTGCINTPTR  offDisp;
+        RTDBGMOD    hMod;
+        RTDBGSYMBOL SymPC;
+        int rc = DBGFR3AsSymbolByAddr(pUVM, DBGF_AS_GLOBAL, &pFrame->AddrFrame,
+                                      RTDBGSYMADDR_FLAGS_LESS_OR_EQUAL | RTDBGSYMADDR_FLAGS_SKIP_ABS_IN_DEFERRED,
+                                      &offDisp, &SymPC, &hMod);
+        if (RT_SUCCESS(rc))
+        {
+            if (hMod != NIL_RTDBGMOD)
+            {
+                RTStrPrintf(pszBuf, cbBuf, "%s!%s", RTDbgModName(hMod), SymPC.szName);
+                RTDbgModRelease(hMod);
+            }
+            else
+                RTStrCopy(pszBuf, cbBuf, SymPC.szName);
+            return;
+        }
+    }
+    RTStrPrintf(pszBuf, cbBuf, "%RGv", pFrame->AddrFrame.FlatPtr);
+}
+
+
+/**
+ * Dumps the given frame and its descendants in the folded stack format.
+ *
+ * A line is emitted for every frame which was sampled more often than all its
+ * descendants together, i.e. which has samples of its own.
+ *
+ * @param   pHlp                    The debug info helper used for printing.
+ * @param   pUVM                    The usermode VM handle.
+ * @param   pFrame                  The frame to dump.
+ * @param   papPath                 The path of frames leading up to this one,
+ *                                  DBGF_SAMPLE_REPORT_FRAME_DEPTH_MAX + 1 entries.
+ * @param   cDepth                  Number of frames in the path so far (0 for the root).
+ * @param   fReverse                Whether the path is stored innermost frame first.
+ * @param   idCpu                   The VCPU the samples belong to.
+ */
+static void dbgfR3SampleReportDumpFolded(PCDBGFINFOHLP pHlp, PUVM pUVM, PCDBGFSAMPLEFRAME pFrame,
+                                         PCDBGFSAMPLEFRAME *papPath, uint32_t cDepth, bool fReverse, VMCPUID idCpu)
+{
+    if (cDepth)
+        papPath[cDepth - 1] = pFrame;
+
+    uint64_t cSamplesChildren = 0;
+    for (uint32_t i = 0; i < pFrame->cFramesValid; i++)
+        cSamplesChildren += pFrame->paFrames[i].cSamples;
+
+    if (cDepth && pFrame->cSamples > cSamplesChildren)
+    {
+        char szSym[256];
+        pHlp->pfnPrintf(pHlp, "vCPU%u", idCpu);
+        for (uint32_t i = 0; i < cDepth; i++)
+        {
+            dbgfR3SampleReportFormatFoldedFrame(pUVM, papPath[fReverse ? cDepth - 1 - i : i], szSym, sizeof(szSym));
+            pHlp->pfnPrintf(pHlp, ";%s", szSym);
+        }
+        pHlp->pfnPrintf(pHlp, " %RU64\n", pFrame->cSamples - cSamplesChildren);
+    }
+
+    if (cDepth <= DBGF_SAMPLE_REPORT_FRAME_DEPTH_MAX)
+        for (uint32_t i = 0; i < pFrame->cFramesValid; i++)
+            dbgfR3SampleReportDumpFolded(pHlp, pUVM, &pFrame->paFrames[i], papPath, cDepth + 1, fReverse, idCpu);
+}
+
+
+/**
+ * Dumps the sampled call trees of all VCPUs followed by the usual set of info
+ * items, the default report format.
+ *
+ * @param   pHlp                    The debug info helper used for printing.
+ * @param   pVM                     The cross context VM structure.
+ * @param   pThis                   The sample report instance data.
+ */
+static void dbgfR3SampleReportDumpFull(PCDBGFINFOHLP pHlp, PVM pVM, PCDBGFSAMPLEREPORTINT pThis)
+{
+    /* Some early dump code. */
+    for (uint32_t i = 0; i < pThis->pUVM->cCpus; i++)
+    {
+        PCDBGFSAMPLEREPORTVCPU pSampleVCpu = &pThis->aCpus[i];
+
+        pHlp->pfnPrintf(pHlp, "Sample report for vCPU %u:\n", i);
+        dbgfR3SampleReportDumpFrame(pHlp, pThis->pUVM, &pSampleVCpu->FrameRoot, 0);
+    }
+
+    /* Shameless copy from VMMGuruMeditation.cpp */
+    static struct
+    {
+        const char *pszInfo;
+        const char *pszArgs;
+    } const     aInfo[] =
+    {
+        { "mappings",        NULL },
+        { "mode",            "all" },
+        { "handlers",        "phys virt hyper stats" },
+        { "timers",          NULL },
+        { "activetimers",    NULL },
+    };
+    for (unsigned i = 0; i < RT_ELEMENTS(aInfo); i++)
+    {
+        pHlp->pfnPrintf(pHlp,
+                        "!!\n"
+                        "!! {%s, %s}\n"
+                        "!!\n",
+                        aInfo[i].pszInfo, aInfo[i].pszArgs);
+        DBGFR3Info(pVM->pUVM, aInfo[i].pszInfo, aInfo[i].pszArgs, pHlp);
+    }
+
+    /* All other info items */
+    DBGFR3InfoMulti(pVM,
+                    "*",
+                    "mappings|hma|cpum|cpumguest|cpumguesthwvirt|cpumguestinstr|cpumhyper|cpumhost|cpumvmxfeat|mode|cpuid"
+                    "|pgmpd|pgmcr3|timers|activetimers|handlers|help|cfgm",
+                    "!!\n"
+                    "!! {%s}\n"
+                    "!!\n",
+                    pHlp);
+
+
+    /* done */
+    pHlp->pfnPrintf(pHlp,
+                    "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
+}
+
+
 /**
  * Worker for dbgfR3SampleReportTakeSample(), doing the work in an EMT rendezvous point on
  * each VCPU.
@@ -414,9 +553,25 @@ static DECLCALLBACK(void) dbgfR3SampleReportSample(PDBGFSAMPLEREPORTINT pThis)
     PVM pVM = pThis->pUVM->pVM;
     PVMCPU pVCpu = VMMGetCpu(pVM);
 
-    PCDBGFSTACKFRAME pFrameFirst;
-    int rc = DBGFR3StackWalkBegin(pThis->pUVM, pVCpu->idCpu, DBGFCODETYPE_GUEST, &pFrameFirst);
-    if (RT_SUCCESS(rc))
+    bool const fPcOnly = RT_BOOL(pThis->fFlags & DBGF_SAMPLE_REPORT_F_PC_ONLY);
+    PCDBGFSTACKFRAME pFrameFirst = NULL;
+    int rc = !fPcOnly ? DBGFR3StackWalkBegin(pThis->pUVM, pVCpu->idCpu, DBGFCODETYPE_GUEST, &pFrameFirst) : VINF_SUCCESS;
+    if (fPcOnly)
+    {
+        /* Cheap variant, just account the current PC. */
+        DBGFADDRESS AddrPC;
+        DBGFR3AddrFromFlat(pThis->pUVM, &AddrPC, CPUMGetGuestFlatPC(pVCpu));
+
+        PDBGFSAMPLEFRAME pFrame = &pThis->aCpus[pVCpu->idCpu].FrameRoot;
+        pFrame->cSamples++;
+
+        PDBGFSAMPLEFRAME pFrameNext = dbgfR3SampleReportFrameFindByAddr(pFrame, &AddrPC);
+        if (!pFrameNext)
+            dbgfR3SampleReportAddFrameByAddr(pThis->pUVM, pFrame, &AddrPC);
+        else
+            pFrameNext->cSamples++;
+    }
+    else if (RT_SUCCESS(rc))
     {
         DBGFADDRESS aFrameAddresses[DBGF_SAMPLE_REPORT_FRAME_DEPTH_MAX];
         uint32_t idxFrame = 0;
@@ -477,52 +632,15 @@ static DECLCALLBACK(void) dbgfR3SampleReportSample(PDBGFSAMPLEREPORTINT pThis)
 
         dbgfR3SampleReportInfoHlpInit(&Hlp);
 
-        /* Some early dump code. */
-        for (uint32_t i = 0; i < pThis->pUVM->cCpus; i++)
+        if (pThis->fFlags & DBGF_SAMPLE_REPORT_F_FOLDED)
         {
-            PCDBGFSAMPLEREPORTVCPU pSampleVCpu = &pThis->aCpus[i];
-
-            pHlp->pfnPrintf(pHlp, "Sample report for vCPU %u:\n", i);
-            dbgfR3SampleReportDumpFrame(pHlp, pThis->pUVM, &pSampleVCpu->FrameRoot, 0);
+            PCDBGFSAMPLEFRAME apPath[DBGF_SAMPLE_REPORT_FRAME_DEPTH_MAX + 1];
+            for (VMCPUID i = 0; i < pThis->pUVM->cCpus; i++)
+                dbgfR3SampleReportDumpFolded(pHlp, pThis->pUVM, &pThis->aCpus[i].FrameRoot, &apPath[0], 0,
+                                             RT_BOOL(pThis->fFlags & DBGF_SAMPLE_REPORT_F_STACK_REVERSE), i);
         }
-
-        /* Shameless copy from VMMGuruMeditation.cpp */
-        static struct
-        {
-            const char *pszInfo;
-            const char *pszArgs;
-        } const     aInfo[] =
-        {
-            { "mappings",        NULL },
-            { "mode",            "all" },
-            { "handlers",        "phys virt hyper stats" },
-            { "timers",          NULL },
-            { "activetimers",    NULL },
-        };
-        for (unsigned i = 0; i < RT_ELEMENTS(aInfo); i++)
-        {
-            pHlp->pfnPrintf(pHlp,
-                            "!!\n"
-                            "!! {%s, %s}\n"
-                            "!!\n",
-                            aInfo[i].pszInfo, aInfo[i].pszArgs);
-            DBGFR3Info(pVM->pUVM, aInfo[i].pszInfo, aInfo[i].pszArgs, pHlp);
-        }
-
-        /* All other info items */
-        DBGFR3InfoMulti(pVM,
-                        "*",
-                        "mappings|hma|cpum|cpumguest|cpumguesthwvirt|cpumguestinstr|cpumhyper|cpumhost|cpumvmxfeat|mode|cpuid"
-                        "|pgmpd|pgmcr3|timers|activetimers|handlers|help|cfgm",
-                        "!!\n"
-                        "!! {%s}\n"
-                        "!!\n",
-                        pHlp);
-
-
-        /* done */
-        pHlp->pfnPrintf(pHlp,
-                        "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
+        else
+            dbgfR3SampleReportDumpFull(pHlp, pVM, pThis);
 
         if (pThis->pszReport)
             RTMemFree(pThis->pszReport);
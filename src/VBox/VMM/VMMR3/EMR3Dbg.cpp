@@ -39,6 +39,7 @@
 #include <VBox/vmm/vm.h>
 #include <iprt/string.h>
 #include <iprt/ctype.h>
+#include <iprt/sort.h>
 
 
 /**
@@ -242,6 +243,102 @@ static const char *emR3HistoryGetExitName(uint32_t uFlagsAndType, char *pszFallb
 }
 
 
+/**
+ * Per exit type summary entry for emR3InfoExitSummary.
+ */
+typedef struct EMEXITSUMMARYENTRY
+{
+    /** The exit kind and type (EMEXIT_F_KIND_MASK | EMEXIT_F_TYPE_MASK). */
+    uint32_t    uFlagsAndType;
+    /** Number of exits of this type. */
+    uint32_t    cExits;
+    /** Sum of the TSC deltas to the previous exit. */
+    uint64_t    cTicksSinceLast;
+} EMEXITSUMMARYENTRY;
+
+
+/**
+ * @callback_method_impl{FNRTSORTCMP, Sorts by descending exit count.}
+ */
+static DECLCALLBACK(int) emR3InfoExitSummaryCmp(void const *pvElement1, void const *pvElement2, void *pvUser)
+{
+    RT_NOREF(pvUser);
+    EMEXITSUMMARYENTRY const *pEntry1 = (EMEXITSUMMARYENTRY const *)pvElement1;
+    EMEXITSUMMARYENTRY const *pEntry2 = (EMEXITSUMMARYENTRY const *)pvElement2;
+    if (pEntry1->cExits != pEntry2->cExits)
+        return pEntry1->cExits < pEntry2->cExits ? 1 : -1;
+    return 0;
+}
+
+
+/**
+ * Displays a per exit type summary of the most recent VM-exit history
+ * entries.
+ *
+ * This works the same for HM, NEM and IEM since they all feed the exit
+ * history, so it gives a comparable picture of why a VCPU keeps exiting.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure.
+ * @param   pHlp        The info helper functions.
+ * @param   cLeft       Max number of history entries to consider.
+ */
+static void emR3InfoExitSummary(PVMCPU pVCpu, PCDBGFINFOHLP pHlp, uint32_t cLeft)
+{
+    uint64_t const idxNext = pVCpu->em.s.iNextExit;
+    uint32_t const cEntries = (uint32_t)RT_MIN(RT_MIN(idxNext, (uint64_t)cLeft), RT_ELEMENTS(pVCpu->em.s.aExitHistory));
+    if (!cEntries)
+    {
+        pHlp->pfnPrintf(pHlp, "CPU[%u]: VM-exit history: empty\n", pVCpu->idCpu);
+        return;
+    }
+
+    /*
+     * Aggregate, oldest entry first so the deltas are positive.
+     */
+    EMEXITSUMMARYENTRY aSummary[RT_ELEMENTS(pVCpu->em.s.aExitHistory)];
+    uint32_t           cTypes         = 0;
+    uint64_t           uPrevTimestamp = 0;
+    for (uint64_t idx = idxNext - cEntries; idx < idxNext; idx++)
+    {
+        PCEMEXITENTRY const pEntry = &pVCpu->em.s.aExitHistory[(uintptr_t)idx & 0xff];
+        uint32_t const      uKey   = pEntry->uFlagsAndType & (EMEXIT_F_KIND_MASK | EMEXIT_F_TYPE_MASK);
+
+        uint32_t i = 0;
+        while (i < cTypes && aSummary[i].uFlagsAndType != uKey)
+            i++;
+        if (i == cTypes)
+        {
+            aSummary[i].uFlagsAndType   = uKey;
+            aSummary[i].cExits          = 0;
+            aSummary[i].cTicksSinceLast = 0;
+            cTypes++;
+        }
+        aSummary[i].cExits++;
+        if (uPrevTimestamp && pEntry->uTimestamp > uPrevTimestamp)
+            aSummary[i].cTicksSinceLast += pEntry->uTimestamp - uPrevTimestamp;
+        uPrevTimestamp = pEntry->uTimestamp;
+    }
+
+    RTSortShell(aSummary, cTypes, sizeof(aSummary[0]), emR3InfoExitSummaryCmp, NULL);
+
+    /*
+     * Print it.
+     */
+    pHlp->pfnPrintf(pHlp,
+                    "CPU[%u]: VM-exit summary of the last %u exits:\n"
+                    "     Count    Pct  Avg ticks since prev    Exit    Name\n"
+                    , pVCpu->idCpu, cEntries);
+    for (uint32_t i = 0; i < cTypes; i++)
+    {
+        char        szExitName[16];
+        const char *pszExitName = emR3HistoryGetExitName(aSummary[i].uFlagsAndType, szExitName, sizeof(szExitName));
+        pHlp->pfnPrintf(pHlp, " %9u %5u%% %21RU64 %#07x %s\n",
+                        aSummary[i].cExits, aSummary[i].cExits * 100 / cEntries,
+                        aSummary[i].cTicksSinceLast / aSummary[i].cExits, aSummary[i].uFlagsAndType, pszExitName);
+    }
+}
+
+
 /**
  * Displays the VM-exit history.
  *
@@ -260,6 +357,7 @@ static DECLCALLBACK(void) emR3InfoExitHistory(PVM pVM, PCDBGFINFOHLP pHlp, const
     if (!pVCpu)
         pVCpu = pVM->apCpusR3[0];
     bool     fReverse = true;
+    bool     fSummary = false;
     uint32_t cLeft    = RT_ELEMENTS(pVCpu->em.s.aExitHistory);
 
     while (pszArgs && *pszArgs)
@@ -290,6 +388,11 @@ static DECLCALLBACK(void) emR3InfoExitHistory(PVM pVM, PCDBGFINFOHLP pHlp, const
             pszArgs += 3;
             fReverse = false;
         }
+        else if (RTStrCmp(pszArgs, "summary") == 0)
+        {
+            pszArgs += 7;
+            fSummary = true;
+        }
         else
         {
             const char *pszStart = pszArgs;
@@ -302,6 +405,12 @@ static DECLCALLBACK(void) emR3InfoExitHistory(PVM pVM, PCDBGFINFOHLP pHlp, const
     /*
      * Do the job.
      */
+    if (fSummary)
+    {
+        emR3InfoExitSummary(pVCpu, pHlp, cLeft);
+        return;
+    }
+
     uint64_t idx = pVCpu->em.s.iNextExit;
     if (idx == 0)
         pHlp->pfnPrintf(pHlp, "CPU[%u]: VM-exit history: empty\n", pVCpu->idCpu);
@@ -379,7 +488,7 @@ int emR3InitDbg(PVM pVM)
     /*
      * Register info dumpers.
      */
-    const char *pszExitsDesc = "Dumps the VM-exit history. Arguments: Number of entries; 'asc', 'ascending' or 'reverse'.";
+    const char *pszExitsDesc = "Dumps the VM-exit history. Arguments: Number of entries; 'asc', 'ascending', 'reverse' or 'summary'.";
     int rc = DBGFR3InfoRegisterInternalEx(pVM, "exits", pszExitsDesc, emR3InfoExitHistory, DBGFINFO_FLAGS_ALL_EMTS);
     AssertLogRelRCReturn(rc, rc);
     rc = DBGFR3InfoRegisterInternalEx(pVM, "exithistory", pszExitsDesc, emR3InfoExitHistory, DBGFINFO_FLAGS_ALL_EMTS);
@@ -77,6 +77,13 @@
     { (a_uFirst), (a_uLast), kCpumMsrRdFn_Gim, kCpumMsrWrFn_Gim, 0, 0, 0, 0, 0, a_szName }
 #endif
 
+#ifndef MSR_GIM_HV_STIMER_IS_DIRECT_MODE
+/** Whether the synthetic timer uses direct mode (config bit 12). */
+# define MSR_GIM_HV_STIMER_IS_DIRECT_MODE(a)            RT_BOOL((a) & RT_BIT_64(12))
+/** Gets the APIC vector of a direct mode synthetic timer (config bits 11:4). */
+# define MSR_GIM_HV_STIMER_GET_APIC_VECTOR(a)           ((uint8_t)(((a) >> 4) & 0xff))
+#endif
+
 
 /*********************************************************************************************************************************
 *   Global Variables                                                                                                             *
@@ -1113,7 +1120,13 @@ static DECLCALLBACK(void) gimR3HvTimerCallback(PVM pVM, TMTIMERHANDLE hTimer, vo
 
     uint64_t const uStimerConfig = pHvStimer->uStimerConfigMsr;
     uint16_t const idxSint       = MSR_GIM_HV_STIMER_GET_SINTX(uStimerConfig);
-    if (RT_LIKELY(idxSint < RT_ELEMENTS(pHvCpu->auSintMsrs)))
+    if (MSR_GIM_HV_STIMER_IS_DIRECT_MODE(uStimerConfig))
+    {
+        /* Direct mode: raise the configured vector, no SINT involved. */
+        uint8_t const uVector = MSR_GIM_HV_STIMER_GET_APIC_VECTOR(uStimerConfig);
+        APICHvSendInterrupt(pVCpu, uVector, false /* fAutoEoi */, XAPICTRIGGERMODE_EDGE);
+    }
+    else if (RT_LIKELY(idxSint < RT_ELEMENTS(pHvCpu->auSintMsrs)))
     {
         uint64_t const uSint = pHvCpu->auSintMsrs[idxSint];
         if (!MSR_GIM_HV_SINT_IS_MASKED(uSint))
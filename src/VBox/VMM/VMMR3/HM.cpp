@@ -671,6 +671,8 @@ VMMR3_INT_DECL(int) HMR3Init(PVM pVM)
                     VM_SET_MAIN_EXECUTION_ENGINE(pVM, VM_EXEC_ENGINE_IEM);
 #ifdef VBOX_WITH_PGM_NEM_MODE
                     PGMR3EnableNemMode(pVM);
+                    /* Guest RAM is allocated in ring-3 here too, so the large page policy applies. */
+                    PGMSetLargePageUsage(pVM, pVM->hm.s.fLargePages);
 #endif
                 }
                 else
@@ -703,6 +705,8 @@ VMMR3_INT_DECL(int) HMR3Init(PVM pVM)
             VM_SET_MAIN_EXECUTION_ENGINE(pVM, VM_EXEC_ENGINE_IEM);
 #ifdef VBOX_WITH_PGM_NEM_MODE
             PGMR3EnableNemMode(pVM);
+            /* Guest RAM is allocated in ring-3 here too, so the large page policy applies. */
+            PGMSetLargePageUsage(pVM, pVM->hm.s.fLargePages);
 #endif
         }
 
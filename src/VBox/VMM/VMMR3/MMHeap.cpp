@@ -377,20 +377,37 @@ DECLINLINE(void) mmR3HeapUnlink(PMMHEAP pHeap, PMMHEAPHDR pHdr)
  */
 void *mmR3HeapAlloc(PMMHEAP pHeap, MMTAG enmTag, size_t cbSize, bool fZero)
 {
-#ifdef MMR3HEAP_WITH_STATISTICS
+#ifndef MMR3HEAP_WITH_STATISTICS
+    RT_NOREF_PV(enmTag);
+#endif
+
+    /*
+     * Allocate heap block before taking the lock, so that we only need to
+     * enter it once for the statistics lookup, the linking and the statistics
+     * update.
+     */
+    PMMHEAPHDR pHdr = NULL;
+    if (cbSize != 0)
+    {
+        cbSize = RT_ALIGN_Z(cbSize, MMR3HEAP_SIZE_ALIGNMENT) + sizeof(MMHEAPHDR);
+        pHdr = (PMMHEAPHDR)(fZero ? RTMemAllocZ(cbSize) : RTMemAlloc(cbSize));
+        AssertMsg(pHdr, ("Failed to allocate heap block %d, enmTag=%x(%.4s).\n", cbSize, enmTag, &enmTag));
+    }
+    else
+        AssertFailed();
+    Assert(!((uintptr_t)pHdr & (RTMEM_ALIGNMENT - 1)));
+
     RTCritSectEnter(&pHeap->Lock);
 
+#ifdef MMR3HEAP_WITH_STATISTICS
     /*
      * Find/alloc statistics nodes.
      */
     pHeap->Stat.cAllocations++;
-    PMMHEAPSTAT pStat = (PMMHEAPSTAT)RTAvlULGet(&pHeap->pStatTree, (AVLULKEY)enmTag);
+    bool        fNewStat = false;
+    PMMHEAPSTAT pStat    = (PMMHEAPSTAT)RTAvlULGet(&pHeap->pStatTree, (AVLULKEY)enmTag);
     if (pStat)
-    {
         pStat->cAllocations++;
-
-        RTCritSectLeave(&pHeap->Lock);
-    }
     else
     {
         pStat = (PMMHEAPSTAT)RTMemAllocZ(sizeof(MMHEAPSTAT));
@@ -399,6 +416,7 @@ void *mmR3HeapAlloc(PMMHEAP pHeap, MMTAG enmTag, size_t cbSize, bool fZero)
             pHeap->Stat.cFailures++;
             AssertMsgFailed(("Failed to allocate heap stat record.\n"));
             RTCritSectLeave(&pHeap->Lock);
+            RTMemFree(pHdr);
             return NULL;
         }
         pStat->Core.Key = (AVLULKEY)enmTag;
@@ -406,85 +424,61 @@ void *mmR3HeapAlloc(PMMHEAP pHeap, MMTAG enmTag, size_t cbSize, bool fZero)
         RTAvlULInsert(&pHeap->pStatTree, &pStat->Core);
 
         pStat->cAllocations++;
-        RTCritSectLeave(&pHeap->Lock);
-
-        /* register the statistics */
-        PUVM pUVM = pHeap->pUVM;
-        const char *pszTag = mmGetTagName(enmTag);
-        STAMR3RegisterFU(pUVM, &pStat->cbCurAllocated, STAMTYPE_U32, STAMVISIBILITY_ALWAYS,  STAMUNIT_BYTES, "Number of bytes currently allocated.",    "/MM/R3Heap/%s", pszTag);
-        STAMR3RegisterFU(pUVM, &pStat->cAllocations,   STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_CALLS, "Number or MMR3HeapAlloc() calls.",        "/MM/R3Heap/%s/cAllocations", pszTag);
-        STAMR3RegisterFU(pUVM, &pStat->cReallocations, STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_CALLS, "Number of MMR3HeapRealloc() calls.",      "/MM/R3Heap/%s/cReallocations", pszTag);
-        STAMR3RegisterFU(pUVM, &pStat->cFrees,         STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_CALLS, "Number of MMR3HeapFree() calls.",         "/MM/R3Heap/%s/cFrees", pszTag);
-        STAMR3RegisterFU(pUVM, &pStat->cFailures,      STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_COUNT, "Number of failures.",                     "/MM/R3Heap/%s/cFailures", pszTag);
-        STAMR3RegisterFU(pUVM, &pStat->cbAllocated,    STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_BYTES, "Total number of bytes allocated.",        "/MM/R3Heap/%s/cbAllocated", pszTag);
-        STAMR3RegisterFU(pUVM, &pStat->cbFreed,        STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_BYTES, "Total number of bytes freed.",            "/MM/R3Heap/%s/cbFreed", pszTag);
+        fNewStat = true;
     }
-#else
-    RT_NOREF_PV(enmTag);
 #endif
 
-    /*
-     * Validate input.
-     */
-    if (cbSize == 0)
+    if (pHdr)
     {
+        /*
+         * Init and link in the header.
+         */
 #ifdef MMR3HEAP_WITH_STATISTICS
-        RTCritSectEnter(&pHeap->Lock);
-        pStat->cFailures++;
-        pHeap->Stat.cFailures++;
-        RTCritSectLeave(&pHeap->Lock);
+        pHdr->pStat  = pStat;
+#else
+        pHdr->pStat  = &pHeap->Stat;
 #endif
-        AssertFailed();
-        return NULL;
-    }
+        pHdr->cbSize = cbSize;
 
-    /*
-     * Allocate heap block.
-     */
-    cbSize = RT_ALIGN_Z(cbSize, MMR3HEAP_SIZE_ALIGNMENT) + sizeof(MMHEAPHDR);
-    PMMHEAPHDR const pHdr = (PMMHEAPHDR)(fZero ? RTMemAllocZ(cbSize) : RTMemAlloc(cbSize));
-    if (pHdr)
-    { /* likely */ }
+        mmR3HeapLink(pHeap, pHdr);
+
+        /*
+         * Update statistics
+         */
+#ifdef MMR3HEAP_WITH_STATISTICS
+        pStat->cbAllocated          += cbSize;
+        pStat->cbCurAllocated       += cbSize;
+        pHeap->Stat.cbAllocated     += cbSize;
+        pHeap->Stat.cbCurAllocated  += cbSize;
+#endif
+    }
+#ifdef MMR3HEAP_WITH_STATISTICS
     else
     {
-        AssertMsgFailed(("Failed to allocate heap block %d, enmTag=%x(%.4s).\n", cbSize, enmTag, &enmTag));
-#ifdef MMR3HEAP_WITH_STATISTICS
-        RTCritSectEnter(&pHeap->Lock);
         pStat->cFailures++;
         pHeap->Stat.cFailures++;
-        RTCritSectLeave(&pHeap->Lock);
-#endif
-        return NULL;
     }
-    Assert(!((uintptr_t)pHdr & (RTMEM_ALIGNMENT - 1)));
-
-    /*
-     * Init and link in the header.
-     */
-#ifdef MMR3HEAP_WITH_STATISTICS
-    pHdr->pStat  = pStat;
-#else
-    pHdr->pStat  = &pHeap->Stat;
 #endif
-    pHdr->cbSize = cbSize;
 
-    RTCritSectEnter(&pHeap->Lock);
-
-    mmR3HeapLink(pHeap, pHdr);
+    RTCritSectLeave(&pHeap->Lock);
 
-    /*
-     * Update statistics
-     */
 #ifdef MMR3HEAP_WITH_STATISTICS
-    pStat->cbAllocated          += cbSize;
-    pStat->cbCurAllocated       += cbSize;
-    pHeap->Stat.cbAllocated     += cbSize;
-    pHeap->Stat.cbCurAllocated  += cbSize;
+    if (fNewStat)
+    {
+        /* register the statistics */
+        PUVM pUVM = pHeap->pUVM;
+        const char *pszTag = mmGetTagName(enmTag);
+        STAMR3RegisterFU(pUVM, &pStat->cbCurAllocated, STAMTYPE_U32, STAMVISIBILITY_ALWAYS,  STAMUNIT_BYTES, "Number of bytes currently allocated.",    "/MM/R3Heap/%s", pszTag);
+        STAMR3RegisterFU(pUVM, &pStat->cAllocations,   STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_CALLS, "Number or MMR3HeapAlloc() calls.",        "/MM/R3Heap/%s/cAllocations", pszTag);
+        STAMR3RegisterFU(pUVM, &pStat->cReallocations, STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_CALLS, "Number of MMR3HeapRealloc() calls.",      "/MM/R3Heap/%s/cReallocations", pszTag);
+        STAMR3RegisterFU(pUVM, &pStat->cFrees,         STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_CALLS, "Number of MMR3HeapFree() calls.",         "/MM/R3Heap/%s/cFrees", pszTag);
+        STAMR3RegisterFU(pUVM, &pStat->cFailures,      STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_COUNT, "Number of failures.",                     "/MM/R3Heap/%s/cFailures", pszTag);
+        STAMR3RegisterFU(pUVM, &pStat->cbAllocated,    STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_BYTES, "Total number of bytes allocated.",        "/MM/R3Heap/%s/cbAllocated", pszTag);
+        STAMR3RegisterFU(pUVM, &pStat->cbFreed,        STAMTYPE_U64, STAMVISIBILITY_ALWAYS,  STAMUNIT_BYTES, "Total number of bytes freed.",            "/MM/R3Heap/%s/cbFreed", pszTag);
+    }
 #endif
 
-    RTCritSectLeave(&pHeap->Lock);
-
-    return pHdr + 1;
+    return pHdr ? pHdr + 1 : NULL;
 }
 
 
@@ -34,6 +34,7 @@
 #include <VBox/vmm/nem.h>
 #include <VBox/vmm/iem.h>
 #include <VBox/vmm/em.h>
+#include <VBox/vmm/mm.h>
 #include <VBox/vmm/apic.h>
 #include <VBox/vmm/pdm.h>
 #include <VBox/vmm/trpm.h>
@@ -1734,7 +1735,10 @@ VBOXSTRICTRC nemR3NativeRunGC(PVM pVM, PVMCPU pVCpu)
                     /*
                      * Deal with the exit.
                      */
+                    uint32_t const uExitReason = pRun->exit_reason;
+                    uint64_t const uTscStart   = ASMReadTSC();
                     rcStrict = nemHCLnxHandleExit(pVM, pVCpu, pRun, &fStatefulExit);
+                    nemR3LnxExitStatsUpdate(pVCpu, uExitReason, uTscStart);
                     if (rcStrict == VINF_SUCCESS)
                     { /* hopefully likely */ }
                     else
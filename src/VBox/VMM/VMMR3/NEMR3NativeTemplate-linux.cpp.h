@@ -33,6 +33,126 @@
 #endif
 
 
+/** Number of KVM exit reasons we keep handling time statistics for. */
+#define NEM_LNX_EXIT_REASON_STATS       48
+/** Number of power of two buckets in the exit handling time histogram. */
+#define NEM_LNX_EXIT_LATENCY_BUCKETS    24
+
+/**
+ * Per VCPU exit handling time statistics.
+ *
+ * These measure how long ring-3 takes to deal with a KVM exit, i.e. the time
+ * between KVM_RUN returning and us being ready to re-enter it.
+ */
+typedef struct NEMLNXEXITSTATS
+{
+    /** Handling time profile per KVM_EXIT_XXX reason (in TSC ticks). */
+    STAMPROFILE         aReasons[NEM_LNX_EXIT_REASON_STATS];
+    /** Histogram of the handling time, bucket N counts exits taking less than
+     *  2^(N+1) ticks (the last one catches the rest). */
+    STAMCOUNTER         aHistogram[NEM_LNX_EXIT_LATENCY_BUCKETS];
+} NEMLNXEXITSTATS;
+/** Pointer to the per VCPU exit statistics. */
+typedef NEMLNXEXITSTATS *PNEMLNXEXITSTATS;
+
+/** Per VCPU exit handling time statistics, NULL if not allocated. */
+static PNEMLNXEXITSTATS g_paNemLnxExitStats = NULL;
+
+
+/**
+ * Gets the short name of a KVM exit reason for the statistics.
+ *
+ * @returns Name, NULL if not known.
+ * @param   uExitReason     The KVM_EXIT_XXX value.
+ */
+static const char *nemR3LnxExitReasonName(uint32_t uExitReason)
+{
+    switch (uExitReason)
+    {
+        case KVM_EXIT_UNKNOWN:          return "Unknown";
+        case KVM_EXIT_EXCEPTION:        return "Exception";
+        case KVM_EXIT_IO:               return "Io";
+        case KVM_EXIT_HYPERCALL:        return "Hypercall";
+        case KVM_EXIT_DEBUG:            return "Debug";
+        case KVM_EXIT_HLT:              return "Hlt";
+        case KVM_EXIT_MMIO:             return "Mmio";
+        case KVM_EXIT_IRQ_WINDOW_OPEN:  return "IrqWindowOpen";
+        case KVM_EXIT_SHUTDOWN:         return "Shutdown";
+        case KVM_EXIT_FAIL_ENTRY:       return "FailEntry";
+        case KVM_EXIT_INTR:             return "Intr";
+        case KVM_EXIT_SET_TPR:          return "SetTpr";
+        case KVM_EXIT_TPR_ACCESS:       return "TprAccess";
+        case KVM_EXIT_INTERNAL_ERROR:   return "InternalError";
+        case KVM_EXIT_SYSTEM_EVENT:     return "SystemEvent";
+#ifdef KVM_EXIT_X86_RDMSR
+        case KVM_EXIT_X86_RDMSR:        return "RdMsr";
+        case KVM_EXIT_X86_WRMSR:        return "WrMsr";
+#endif
+#ifdef KVM_EXIT_X86_BUS_LOCK
+        case KVM_EXIT_X86_BUS_LOCK:     return "BusLock";
+#endif
+        default:                        return NULL;
+    }
+}
+
+
+/**
+ * Allocates and registers the exit handling time statistics.
+ *
+ * Failure is not fatal, we just go without them.
+ *
+ * @param   pVM                 The cross context VM structure.
+ */
+static void nemR3LnxExitStatsInit(PVM pVM)
+{
+    PNEMLNXEXITSTATS paStats = (PNEMLNXEXITSTATS)MMR3HeapAllocZ(pVM, MM_TAG_EM, sizeof(paStats[0]) * pVM->cCpus);
+    if (!paStats)
+        return;
+
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        PNEMLNXEXITSTATS pStats = &paStats[idCpu];
+        for (uint32_t i = 0; i < RT_ELEMENTS(pStats->aReasons); i++)
+        {
+            const char *pszName = nemR3LnxExitReasonName(i);
+            if (pszName)
+                STAMR3RegisterF(pVM, &pStats->aReasons[i], STAMTYPE_PROFILE, STAMVISIBILITY_USED, STAMUNIT_TICKS_PER_OCCURENCE,
+                                "Ring-3 handling time of the exit reason", "/NEM/CPU%u/ExitLatency/%s", idCpu, pszName);
+            else
+                STAMR3RegisterF(pVM, &pStats->aReasons[i], STAMTYPE_PROFILE, STAMVISIBILITY_USED, STAMUNIT_TICKS_PER_OCCURENCE,
+                                "Ring-3 handling time of the exit reason", "/NEM/CPU%u/ExitLatency/Reason%02u", idCpu, i);
+        }
+        for (uint32_t i = 0; i < RT_ELEMENTS(pStats->aHistogram); i++)
+            STAMR3RegisterF(pVM, &pStats->aHistogram[i], STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                            "Exits handled in less than 2^(N+1) ticks", "/NEM/CPU%u/ExitLatency/Histogram/%02u", idCpu, i);
+    }
+
+    ASMAtomicWritePtr(&g_paNemLnxExitStats, paStats);
+}
+
+
+/**
+ * Accounts the handling time of an exit.
+ *
+ * @param   pVCpu               The cross context per CPU structure.
+ * @param   uExitReason         The KVM_EXIT_XXX value of the exit.
+ * @param   uTscStart           The TSC when we started handling it.
+ */
+DECLINLINE(void) nemR3LnxExitStatsUpdate(PVMCPUCC pVCpu, uint32_t uExitReason, uint64_t uTscStart)
+{
+    PNEMLNXEXITSTATS const paStats = g_paNemLnxExitStats;
+    if (paStats)
+    {
+        uint64_t const         cTicks  = ASMReadTSC() - uTscStart;
+        PNEMLNXEXITSTATS const pStats  = &paStats[pVCpu->idCpu];
+        if (uExitReason < RT_ELEMENTS(pStats->aReasons))
+            STAM_REL_PROFILE_ADD_PERIOD(&pStats->aReasons[uExitReason], cTicks);
+        unsigned const         iBucket = cTicks > 1 ? RT_MIN(ASMBitLastSetU64(cTicks) - 1U, NEM_LNX_EXIT_LATENCY_BUCKETS - 1U) : 0;
+        STAM_REL_COUNTER_INC(&pStats->aHistogram[iBucket]);
+    }
+}
+
+
 
 /**
  * Worker for nemR3NativeInit that gets the hypervisor capabilities.
@@ -537,6 +657,7 @@ int nemR3NativeInit(PVM pVM, bool fFallback, bool fForced)
                         STAMR3RegisterF(pVM, &pNemCpu->StatExitInternalErrorEmulation, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "KVM_EXIT_INTERNAL_ERROR/EMULATION", "/NEM/CPU%u/Exit/InternalErrorEmulation", idCpu);
                         STAMR3RegisterF(pVM, &pNemCpu->StatExitInternalErrorFatal,     STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "KVM_EXIT_INTERNAL_ERROR/*", "/NEM/CPU%u/Exit/InternalErrorFatal", idCpu);
                     }
+                    nemR3LnxExitStatsInit(pVM);
 
                     /*
                      * Success.
@@ -598,6 +719,9 @@ int nemR3NativeInitAfterCPUM(PVM pVM)
 
 int nemR3NativeTerm(PVM pVM)
 {
+    /* The MM heap goes away with the VM, just forget about the statistics. */
+    ASMAtomicWriteNullPtr(&g_paNemLnxExitStats);
+
     /*
      * Per-cpu data
      */
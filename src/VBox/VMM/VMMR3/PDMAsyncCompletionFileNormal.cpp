@@ -223,8 +223,10 @@ static bool pdmacFileAioMgrNormalRemoveEndpoint(PPDMASYNCCOMPLETIONENDPOINTFILE
         Assert(!pEndpointRemove->pFlushReq);
 
         /* Reopen the file so that the new endpoint can re-associate with the file */
+        int rc = RTFileAioCtxDisassociateFromFile(pAioMgr->hAioCtx, pEndpointRemove->hFile);
+        AssertRC(rc);
         RTFileClose(pEndpointRemove->hFile);
-        int rc = RTFileOpen(&pEndpointRemove->hFile, pEndpointRemove->Core.pszUri, pEndpointRemove->fFlags);
+        rc = RTFileOpen(&pEndpointRemove->hFile, pEndpointRemove->Core.pszUri, pEndpointRemove->fFlags);
         AssertRC(rc);
         return false;
     }
@@ -1307,6 +1309,8 @@ static int pdmacFileAioMgrNormalCheckEndpoints(PPDMACEPFILEMGR pAioMgr)
                  && pEndpoint->enmState != PDMASYNCCOMPLETIONENDPOINTFILESTATE_ACTIVE)
         {
             /* Reopen the file so that the new endpoint can re-associate with the file */
+            rc = RTFileAioCtxDisassociateFromFile(pAioMgr->hAioCtx, pEndpoint->hFile);
+            AssertRC(rc);
             RTFileClose(pEndpoint->hFile);
             rc = RTFileOpen(&pEndpoint->hFile, pEndpoint->Core.pszUri, pEndpoint->fFlags);
             AssertRC(rc);
@@ -27,6 +27,15 @@
 
 /** @page pg_pdm_block_cache     PDM Block Cache - The I/O cache
  * This component implements an I/O cache based on the 2Q cache algorithm.
+ *
+ * The split between the recently used (A1in) and the frequently used (Am)
+ * lists is not fixed.  Entries evicted from either list are kept on a ghost
+ * list (A1out resp. Amout) without data and the A1in target size is adapted
+ * in an ARC like fashion whenever a ghost entry is accessed again: a hit in
+ * A1out means A1in was too small, a hit in Amout means Am was too small.
+ * Data which is accessed only once (guest backup scans, sequential copies)
+ * never leaves A1in and will therefore not push the frequently used working
+ * set out of the cache.
  */
 
 
@@ -81,6 +90,11 @@
 
 #define PDM_BLK_CACHE_SAVED_STATE_VERSION 1
 
+/** The lower bound of the adaptive A1in target size in percent of the cache size. */
+#define PDM_BLK_CACHE_RECENTLY_USED_IN_MIN_PCT   5
+/** The upper bound of the adaptive A1in target size in percent of the cache size. */
+#define PDM_BLK_CACHE_RECENTLY_USED_IN_MAX_PCT   75
+
 /* Enable to enable some tracing in the block cache code for investigating issues. */
 /*#define VBOX_BLKCACHE_TRACING 1*/
 
@@ -147,6 +161,13 @@ static void pdmBlkCacheValidate(PPDMBLKCACHEGLOBAL pCache)
 
     AssertMsg(pCache->LruRecentlyUsedOut.cbCached <= pCache->cbRecentlyUsedOutMax,
               ("Paged out list exceeds maximum\n"));
+
+    AssertMsg(pCache->LruFrequentlyUsedOut.cbCached <= pCache->cbFrequentlyUsedOutMax,
+              ("Frequently used paged out list exceeds maximum\n"));
+
+    AssertMsg(   pCache->cbRecentlyUsedInMax >= pCache->cbRecentlyUsedInMin
+              && pCache->cbRecentlyUsedInMax <= pCache->cbRecentlyUsedInLimit,
+              ("Adaptive A1in target size out of bounds\n"));
 }
 #endif
 
@@ -188,6 +209,80 @@ DECLINLINE(void) pdmBlkCacheListSub(PPDMBLKLRULIST pList, uint32_t cbAmount)
     pList->cbCached -= cbAmount;
 }
 
+/**
+ * Returns whether the given list is one of the ghost lists which hold
+ * no data.
+ *
+ * @returns true if the list is a ghost list, false otherwise.
+ * @param   pCache    Pointer to the global cache data.
+ * @param   pList     The list to check.
+ */
+DECLINLINE(bool) pdmBlkCacheListIsGhost(PPDMBLKCACHEGLOBAL pCache, PPDMBLKLRULIST pList)
+{
+    return    pList == &pCache->LruRecentlyUsedOut
+           || pList == &pCache->LruFrequentlyUsedOut;
+}
+
+/**
+ * Returns the maximum amount of data the given ghost list may track.
+ *
+ * @returns Maximum amount of bytes.
+ * @param   pCache    Pointer to the global cache data.
+ * @param   pList     The ghost list.
+ */
+DECLINLINE(uint32_t) pdmBlkCacheGhostListMax(PPDMBLKCACHEGLOBAL pCache, PPDMBLKLRULIST pList)
+{
+    Assert(pdmBlkCacheListIsGhost(pCache, pList));
+    return pList == &pCache->LruRecentlyUsedOut
+         ? pCache->cbRecentlyUsedOutMax
+         : pCache->cbFrequentlyUsedOutMax;
+}
+
+/**
+ * Adapts the A1in target size after a ghost list entry was accessed again.
+ *
+ * A hit in the A1out ghost list means that the entry was evicted from A1in
+ * too early so the A1in target is grown.  A hit in the Amout ghost list means
+ * the frequently used list was too small so the A1in target is shrunk.  The
+ * step size depends on the ratio of the ghost list sizes like in ARC.
+ *
+ * @param   pCache    Pointer to the global cache data.
+ * @param   pEntry    The ghost entry which was hit, still linked to its list.
+ */
+static void pdmBlkCacheAdaptOnGhostHit(PPDMBLKCACHEGLOBAL pCache, PPDMBLKCACHEENTRY pEntry)
+{
+    PDMACFILECACHE_IS_CRITSECT_OWNER(pCache);
+
+    uint32_t const cbRecentOut   = RT_MAX(pCache->LruRecentlyUsedOut.cbCached, 1);
+    uint32_t const cbFrequentOut = RT_MAX(pCache->LruFrequentlyUsedOut.cbCached, 1);
+
+    if (pEntry->pList == &pCache->LruRecentlyUsedOut)
+    {
+        uint32_t cbStep = pEntry->cbData;
+        if (cbFrequentOut > cbRecentOut)
+            cbStep = (uint32_t)RT_MIN((uint64_t)cbStep * (cbFrequentOut / cbRecentOut), pCache->cbMax);
+
+        pCache->cbRecentlyUsedInMax = RT_MIN(pCache->cbRecentlyUsedInMax + cbStep, pCache->cbRecentlyUsedInLimit);
+        STAM_COUNTER_INC(&pCache->StatGhostHitsRecentlyUsed);
+    }
+    else
+    {
+        Assert(pEntry->pList == &pCache->LruFrequentlyUsedOut);
+
+        uint32_t cbStep = pEntry->cbData;
+        if (cbRecentOut > cbFrequentOut)
+            cbStep = (uint32_t)RT_MIN((uint64_t)cbStep * (cbRecentOut / cbFrequentOut), pCache->cbMax);
+
+        if (pCache->cbRecentlyUsedInMax > pCache->cbRecentlyUsedInMin + cbStep)
+            pCache->cbRecentlyUsedInMax -= cbStep;
+        else
+            pCache->cbRecentlyUsedInMax = pCache->cbRecentlyUsedInMin;
+        STAM_COUNTER_INC(&pCache->StatGhostHitsFrequentlyUsed);
+    }
+
+    LogFlowFunc(("A1in target adapted to %u bytes\n", pCache->cbRecentlyUsedInMax));
+}
+
 #ifdef PDMACFILECACHE_WITH_LRULIST_CHECKS
 /**
  * Checks consistency of a LRU list.
@@ -364,8 +459,10 @@ static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData
 
     AssertMsg(cbData > 0, ("Evicting 0 bytes not possible\n"));
     AssertMsg(   !pGhostListDst
-              || (pGhostListDst == &pCache->LruRecentlyUsedOut),
-              ("Destination list must be NULL or the recently used but paged out list\n"));
+              || pdmBlkCacheListIsGhost(pCache, pGhostListDst),
+              ("Destination list must be NULL or one of the paged out lists\n"));
+
+    uint32_t const cbGhostMax = pGhostListDst ? pdmBlkCacheGhostListMax(pCache, pGhostListDst) : 0;
 
     if (fReuseBuffer)
     {
@@ -406,6 +503,7 @@ static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData
 
                 pCurr->pbData = NULL;
                 cbEvicted += pCurr->cbData;
+                STAM_COUNTER_INC(&pCache->StatEvicted);
 
                 pdmBlkCacheEntryRemoveFromList(pCurr);
                 pdmBlkCacheSub(pCache, pCurr->cbData);
@@ -417,7 +515,7 @@ static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData
                     PPDMBLKCACHEENTRY pGhostEntFree = pGhostListDst->pTail;
 
                     /* We have to remove the last entries from the paged out list. */
-                    while (   pGhostListDst->cbCached + pCurr->cbData > pCache->cbRecentlyUsedOutMax
+                    while (   pGhostListDst->cbCached + pCurr->cbData > cbGhostMax
                            && pGhostEntFree)
                     {
                         PPDMBLKCACHEENTRY pFree = pGhostEntFree;
@@ -441,7 +539,7 @@ static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData
                         RTSemRWReleaseWrite(pBlkCacheFree->SemRWEntries);
                     }
 
-                    if (pGhostListDst->cbCached + pCurr->cbData > pCache->cbRecentlyUsedOutMax)
+                    if (pGhostListDst->cbCached + pCurr->cbData > cbGhostMax)
                     {
                         /* Couldn't remove enough entries. Delete */
                         STAM_PROFILE_ADV_START(&pCache->StatTreeRemove, Cache);
@@ -505,17 +603,25 @@ static bool pdmBlkCacheReclaim(PPDMBLKCACHEGLOBAL pCache, size_t cbData, bool fR
              */
             if (!cbRemoved)
                 cbRemoved += pdmBlkCacheEvictPagesFrom(pCache, cbData, &pCache->LruFrequentlyUsed,
-                                                          NULL, fReuseBuffer, ppbBuffer);
+                                                          &pCache->LruFrequentlyUsedOut, fReuseBuffer, ppbBuffer);
             else
                 cbRemoved += pdmBlkCacheEvictPagesFrom(pCache, cbData - cbRemoved, &pCache->LruFrequentlyUsed,
-                                                          NULL, false, NULL);
+                                                          &pCache->LruFrequentlyUsedOut, false, NULL);
         }
     }
     else
     {
         /* We have to remove entries from frequently access list. */
         cbRemoved = pdmBlkCacheEvictPagesFrom(pCache, cbData, &pCache->LruFrequentlyUsed,
-                                                 NULL, fReuseBuffer, ppbBuffer);
+                                                 &pCache->LruFrequentlyUsedOut, fReuseBuffer, ppbBuffer);
+
+        /*
+         * The frequently used list might consist only of entries which are in use,
+         * fall back to the recently used list in that case.
+         */
+        if (cbRemoved < cbData)
+            cbRemoved += pdmBlkCacheEvictPagesFrom(pCache, cbData - cbRemoved, &pCache->LruRecentlyUsedIn,
+                                                   &pCache->LruRecentlyUsedOut, false, NULL);
     }
 
     LogFlowFunc((": removed %u bytes, requested %u\n", cbRemoved, cbData));
@@ -1069,16 +1175,26 @@ int pdmR3BlkCacheInit(PVM pVM)
     pBlkCacheGlobal->LruFrequentlyUsed.pTail    = NULL;
     pBlkCacheGlobal->LruFrequentlyUsed.cbCached = 0;
 
+    pBlkCacheGlobal->LruFrequentlyUsedOut.pHead    = NULL;
+    pBlkCacheGlobal->LruFrequentlyUsedOut.pTail    = NULL;
+    pBlkCacheGlobal->LruFrequentlyUsedOut.cbCached = 0;
+
     do
     {
         rc = CFGMR3QueryU32Def(pCfgBlkCache, "CacheSize", &pBlkCacheGlobal->cbMax, 5 * _1M);
         AssertLogRelRCBreak(rc);
         LogFlowFunc(("Maximum number of bytes cached %u\n", pBlkCacheGlobal->cbMax));
 
-        pBlkCacheGlobal->cbRecentlyUsedInMax  = (pBlkCacheGlobal->cbMax / 100) * 25; /* 25% of the buffer size */
-        pBlkCacheGlobal->cbRecentlyUsedOutMax = (pBlkCacheGlobal->cbMax / 100) * 50; /* 50% of the buffer size */
-        LogFlowFunc(("cbRecentlyUsedInMax=%u cbRecentlyUsedOutMax=%u\n",
-                     pBlkCacheGlobal->cbRecentlyUsedInMax, pBlkCacheGlobal->cbRecentlyUsedOutMax));
+        pBlkCacheGlobal->cbRecentlyUsedInMax    = (pBlkCacheGlobal->cbMax / 100) * 25; /* 25% of the buffer size */
+        pBlkCacheGlobal->cbRecentlyUsedOutMax   = (pBlkCacheGlobal->cbMax / 100) * 50; /* 50% of the buffer size */
+        pBlkCacheGlobal->cbFrequentlyUsedOutMax = (pBlkCacheGlobal->cbMax / 100) * 50; /* 50% of the buffer size */
+
+        /* Bounds for the adaptive A1in target size. */
+        pBlkCacheGlobal->cbRecentlyUsedInMin   = (pBlkCacheGlobal->cbMax / 100) * PDM_BLK_CACHE_RECENTLY_USED_IN_MIN_PCT;
+        pBlkCacheGlobal->cbRecentlyUsedInLimit = (pBlkCacheGlobal->cbMax / 100) * PDM_BLK_CACHE_RECENTLY_USED_IN_MAX_PCT;
+        LogFlowFunc(("cbRecentlyUsedInMax=%u cbRecentlyUsedOutMax=%u cbFrequentlyUsedOutMax=%u\n",
+                     pBlkCacheGlobal->cbRecentlyUsedInMax, pBlkCacheGlobal->cbRecentlyUsedOutMax,
+                     pBlkCacheGlobal->cbFrequentlyUsedOutMax));
 
         /** @todo r=aeichner: Experiment to find optimal default values */
         rc = CFGMR3QueryU32Def(pCfgBlkCache, "CacheCommitIntervalMs", &pBlkCacheGlobal->u32CommitTimeoutMs, 10000 /* 10sec */);
@@ -1114,6 +1230,16 @@ int pdmR3BlkCacheInit(PVM pVM)
                        "/PDM/BlkCache/cbCachedFru",
                        STAMUNIT_BYTES,
                        "Number of bytes cached in FRU ghost list");
+        STAMR3Register(pVM, &pBlkCacheGlobal->LruFrequentlyUsedOut.cbCached,
+                       STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                       "/PDM/BlkCache/cbCachedFruOut",
+                       STAMUNIT_BYTES,
+                       "Number of bytes tracked in the FRU ghost list");
+        STAMR3Register(pVM, &pBlkCacheGlobal->cbRecentlyUsedInMax,
+                       STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                       "/PDM/BlkCache/cbMruInTarget",
+                       STAMUNIT_BYTES,
+                       "Current adaptive target size of the MRU list");
 
 #ifdef VBOX_WITH_STATISTICS
         STAMR3Register(pVM, &pBlkCacheGlobal->cHits,
@@ -1152,6 +1278,18 @@ int pdmR3BlkCacheInit(PVM pVM)
                        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
                        "/PDM/BlkCache/CacheBuffersReused",
                        STAMUNIT_COUNT, "Number of times a buffer could be reused");
+        STAMR3Register(pVM, &pBlkCacheGlobal->StatEvicted,
+                       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                       "/PDM/BlkCache/CacheEvicted",
+                       STAMUNIT_COUNT, "Number of entries evicted from the cache");
+        STAMR3Register(pVM, &pBlkCacheGlobal->StatGhostHitsRecentlyUsed,
+                       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                       "/PDM/BlkCache/CacheGhostHitsMru",
+                       STAMUNIT_COUNT, "Number of accesses to entries on the MRU ghost list");
+        STAMR3Register(pVM, &pBlkCacheGlobal->StatGhostHitsFrequentlyUsed,
+                       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                       "/PDM/BlkCache/CacheGhostHitsFru",
+                       STAMUNIT_COUNT, "Number of accesses to entries on the FRU ghost list");
 #endif
 
         /* Initialize the critical section */
@@ -1204,6 +1342,7 @@ void pdmR3BlkCacheTerm(PVM pVM)
         pdmBlkCacheDestroyList(&pBlkCacheGlobal->LruRecentlyUsedIn);
         pdmBlkCacheDestroyList(&pBlkCacheGlobal->LruRecentlyUsedOut);
         pdmBlkCacheDestroyList(&pBlkCacheGlobal->LruFrequentlyUsed);
+        pdmBlkCacheDestroyList(&pBlkCacheGlobal->LruFrequentlyUsedOut);
 
         pdmBlkCacheLockLeave(pBlkCacheGlobal);
 
@@ -2054,6 +2193,7 @@ VMMR3DECL(int) PDMR3BlkCacheRead(PPDMBLKCACHE pBlkCache, uint64_t off,
                 LogFlow(("Fetching data for ghost entry %#p from file\n", pEntry));
 
                 pdmBlkCacheLockEnter(pCache);
+                pdmBlkCacheAdaptOnGhostHit(pCache, pEntry);
                 pdmBlkCacheEntryRemoveFromList(pEntry); /* Remove it before we remove data, otherwise it may get freed when evicting data. */
                 bool fEnough = pdmBlkCacheReclaim(pCache, pEntry->cbData, true, &pbBuffer);
 
@@ -2283,6 +2423,7 @@ VMMR3DECL(int) PDMR3BlkCacheWrite(PPDMBLKCACHE pBlkCache, uint64_t off, PCRTSGBU
                 uint8_t *pbBuffer = NULL;
 
                 pdmBlkCacheLockEnter(pCache);
+                pdmBlkCacheAdaptOnGhostHit(pCache, pEntry);
                 pdmBlkCacheEntryRemoveFromList(pEntry); /* Remove it before we remove data, otherwise it may get freed when evicting data. */
                 bool fEnough = pdmBlkCacheReclaim(pCache, pEntry->cbData, true, &pbBuffer);
 
@@ -101,8 +101,8 @@ int pdmR3CritSectBothInitStatsAndInfo(PVM pVM)
     /*
      * Info items.
      */
-    DBGFR3InfoRegisterInternalArgv(pVM, "critsect", "Show critical section: critsect [-v] [pattern[...]]", pdmR3CritSectInfo, 0);
-    DBGFR3InfoRegisterInternalArgv(pVM, "critsectrw", "Show read/write critical section: critsectrw [-v] [pattern[...]]",
+    DBGFR3InfoRegisterInternalArgv(pVM, "critsect", "Show critical section: critsect [-v] [-c] [pattern[...]]", pdmR3CritSectInfo, 0);
+    DBGFR3InfoRegisterInternalArgv(pVM, "critsectrw", "Show read/write critical section: critsectrw [-v] [-c] [pattern[...]]",
                                    pdmR3CritSectRwInfo, 0);
 
     return VINF_SUCCESS;
@@ -1096,10 +1096,21 @@ VMMR3DECL(PPDMCRITSECT)             PDMR3CritSectGetNop(PVM pVM)
 }
 
 
+/**
+ * Average ticks per period of a profile sample, for the contention summaries.
+ */
+DECLINLINE(uint64_t) pdmR3CritSectInfoAvgTicks(PCSTAMPROFILE pProfile)
+{
+    uint64_t const cPeriods = pProfile->cPeriods;
+    return cPeriods ? pProfile->cTicks / cPeriods : 0;
+}
+
+
 /**
  * Display matching critical sections.
  */
-static void pdmR3CritSectInfoWorker(PUVM pUVM, const char *pszPatterns, PCDBGFINFOHLP pHlp, unsigned cVerbosity)
+static void pdmR3CritSectInfoWorker(PUVM pUVM, const char *pszPatterns, PCDBGFINFOHLP pHlp, unsigned cVerbosity,
+                                    bool fContendedOnly)
 {
     size_t const cchPatterns = pszPatterns ? strlen(pszPatterns) : 0;
     RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
@@ -1108,6 +1119,11 @@ static void pdmR3CritSectInfoWorker(PUVM pUVM, const char *pszPatterns, PCDBGFIN
         if (   !pszPatterns
             || RTStrSimplePatternMultiMatch(pszPatterns, cchPatterns, pCritSect->pszName, RTSTR_MAX, NULL))
         {
+            uint64_t const cContentionR3 = pCritSect->StatContentionR3.c;
+            uint64_t const cContentionRZ = pCritSect->StatContentionRZLock.c + pCritSect->StatContentionRZLockBusy.c;
+            if (fContendedOnly && !cContentionR3 && !cContentionRZ)
+                continue;
+
             uint32_t fFlags = pCritSect->Core.fFlags;
             pHlp->pfnPrintf(pHlp, "%p: '%s'%s%s%s%s%s\n", pCritSect, pCritSect->pszName,
                             pCritSect->fAutomaticDefaultCritsect ? " default" : "",
@@ -1173,6 +1189,30 @@ static void pdmR3CritSectInfoWorker(PUVM pUVM, const char *pszPatterns, PCDBGFIN
                 pHlp->pfnPrintf(pHlp, "  cLockers=%d cNestings=%d hOwner=%p %s%s\n", cLockers, cNestings, hOwner,
                                 pszOwner ? pszOwner : "???", fFlags & PDMCRITSECT_FLAGS_PENDING_UNLOCK ? " pending-unlock" : "");
             }
+
+            /*
+             * Contention profile, so it's easy to spot the locks the VCPUs serialize on.
+             * The wait times are in TSC ticks like the statistics they come from.
+             */
+            if (cContentionR3 || cContentionRZ || cVerbosity > 1)
+            {
+                pHlp->pfnPrintf(pHlp, "  contention: R3=%RU64 (wait avg=%RU64 max=%RU64 total=%RU64) RZ=%RU64 (busy=%RU64 unlock=%RU64 wait avg=%RU64 max=%RU64)\n",
+                                cContentionR3,
+                                pdmR3CritSectInfoAvgTicks(&pCritSect->StatContentionR3Wait),
+                                pCritSect->StatContentionR3Wait.cTicksMax,
+                                pCritSect->StatContentionR3Wait.cTicks,
+                                pCritSect->StatContentionRZLock.c,
+                                pCritSect->StatContentionRZLockBusy.c,
+                                pCritSect->StatContentionRZUnlock.c,
+                                pdmR3CritSectInfoAvgTicks(&pCritSect->StatContentionRZWait),
+                                pCritSect->StatContentionRZWait.cTicksMax);
+#ifdef VBOX_WITH_STATISTICS
+                pHlp->pfnPrintf(pHlp, "  held: %RU64 times (avg=%RU64 max=%RU64 ticks)\n",
+                                pCritSect->StatLocked.Core.cPeriods,
+                                pdmR3CritSectInfoAvgTicks(&pCritSect->StatLocked.Core),
+                                pCritSect->StatLocked.Core.cTicksMax);
+#endif
+            }
         }
     RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
 }
@@ -1181,7 +1221,8 @@ static void pdmR3CritSectInfoWorker(PUVM pUVM, const char *pszPatterns, PCDBGFIN
 /**
  * Display matching read/write critical sections.
  */
-static void pdmR3CritSectInfoRwWorker(PUVM pUVM, const char *pszPatterns, PCDBGFINFOHLP pHlp, unsigned cVerbosity)
+static void pdmR3CritSectInfoRwWorker(PUVM pUVM, const char *pszPatterns, PCDBGFINFOHLP pHlp, unsigned cVerbosity,
+                                      bool fContendedOnly)
 {
     size_t const cchPatterns = pszPatterns ? strlen(pszPatterns) : 0;
     RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
@@ -1190,6 +1231,11 @@ static void pdmR3CritSectInfoRwWorker(PUVM pUVM, const char *pszPatterns, PCDBGF
         if (   !pszPatterns
             || RTStrSimplePatternMultiMatch(pszPatterns, cchPatterns, pCritSect->pszName, RTSTR_MAX, NULL))
         {
+            uint64_t const cContention = pCritSect->StatContentionR3EnterExcl.c   + pCritSect->StatContentionR3EnterShared.c
+                                       + pCritSect->StatContentionRZEnterExcl.c   + pCritSect->StatContentionRZEnterShared.c;
+            if (fContendedOnly && !cContention)
+                continue;
+
             uint16_t const fFlags = pCritSect->Core.fFlags;
             pHlp->pfnPrintf(pHlp, "%p: '%s'%s%s%s\n", pCritSect, pCritSect->pszName,
                             fFlags & RTCRITSECT_FLAGS_NO_NESTING ? " no-testing" : "",
@@ -1261,6 +1307,24 @@ static void pdmR3CritSectInfoRwWorker(PUVM pUVM, const char *pszPatterns, PCDBGF
                     pHlp->pfnPrintf(pHlp, "  cNestings=%u cReadNestings=%u hWriter=%p %s\n",
                                     cWriteRecursions, cWriterReads, hOwner, pszOwner ? pszOwner : "???");
             }
+
+            /*
+             * Contention profile.
+             */
+            if (cContention || cVerbosity > 1)
+            {
+                pHlp->pfnPrintf(pHlp, "  contention: R3 excl=%RU64/%RU64 shared=%RU64/%RU64 RZ excl=%RU64/%RU64 shared=%RU64/%RU64 (contended/entered)\n",
+                                pCritSect->StatContentionR3EnterExcl.c,   pCritSect->StatR3EnterExcl.c,
+                                pCritSect->StatContentionR3EnterShared.c, pCritSect->StatR3EnterShared.c,
+                                pCritSect->StatContentionRZEnterExcl.c,   pCritSect->StatRZEnterExcl.c,
+                                pCritSect->StatContentionRZEnterShared.c, pCritSect->StatRZEnterShared.c);
+#ifdef VBOX_WITH_STATISTICS
+                pHlp->pfnPrintf(pHlp, "  write held: %RU64 times (avg=%RU64 max=%RU64 ticks)\n",
+                                pCritSect->StatWriteLocked.Core.cPeriods,
+                                pdmR3CritSectInfoAvgTicks(&pCritSect->StatWriteLocked.Core),
+                                pCritSect->StatWriteLocked.Core.cTicksMax);
+#endif
+            }
         }
     RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
 }
@@ -1278,14 +1342,16 @@ static void pdmR3CritSectInfoCommon(PVM pVM, PCDBGFINFOHLP pHlp, int cArgs, char
      */
     static const RTGETOPTDEF s_aOptions[] =
     {
-        {   "--verbose", 'v', RTGETOPT_REQ_NOTHING },
+        {   "--verbose",   'v', RTGETOPT_REQ_NOTHING },
+        {   "--contended", 'c', RTGETOPT_REQ_NOTHING },
     };
     RTGETOPTSTATE State;
     int rc = RTGetOptInit(&State, cArgs, papszArgs, s_aOptions, RT_ELEMENTS(s_aOptions), 0, RTGETOPTINIT_FLAGS_NO_STD_OPTS);
     AssertRC(rc);
 
-    unsigned cVerbosity = 1;
-    unsigned cProcessed = 0;
+    unsigned cVerbosity     = 1;
+    unsigned cProcessed     = 0;
+    bool     fContendedOnly = false;
 
     RTGETOPTUNION ValueUnion;
     while ((rc = RTGetOpt(&State, &ValueUnion)) != 0)
@@ -1296,11 +1362,15 @@ static void pdmR3CritSectInfoCommon(PVM pVM, PCDBGFINFOHLP pHlp, int cArgs, char
                 cVerbosity++;
                 break;
 
+            case 'c':
+                fContendedOnly = true;
+                break;
+
             case VINF_GETOPT_NOT_OPTION:
                 if (!fReadWrite)
-                    pdmR3CritSectInfoWorker(pUVM, ValueUnion.psz, pHlp, cVerbosity);
+                    pdmR3CritSectInfoWorker(pUVM, ValueUnion.psz, pHlp, cVerbosity, fContendedOnly);
                 else
-                    pdmR3CritSectInfoRwWorker(pUVM, ValueUnion.psz, pHlp, cVerbosity);
+                    pdmR3CritSectInfoRwWorker(pUVM, ValueUnion.psz, pHlp, cVerbosity, fContendedOnly);
                 cProcessed++;
                 break;
 
@@ -1316,9 +1386,9 @@ static void pdmR3CritSectInfoCommon(PVM pVM, PCDBGFINFOHLP pHlp, int cArgs, char
     if (!cProcessed)
     {
         if (!fReadWrite)
-            pdmR3CritSectInfoWorker(pUVM, NULL, pHlp, cVerbosity);
+            pdmR3CritSectInfoWorker(pUVM, NULL, pHlp, cVerbosity, fContendedOnly);
         else
-            pdmR3CritSectInfoRwWorker(pUVM, NULL, pHlp, cVerbosity);
+            pdmR3CritSectInfoRwWorker(pUVM, NULL, pHlp, cVerbosity, fContendedOnly);
     }
 }
 
@@ -60,6 +60,15 @@
 #include <iprt/semaphore.h>
 #include <iprt/string.h>
 #include <iprt/thread.h>
+#include <iprt/time.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Device constructors taking longer than this (in nanoseconds) get their
+ * construction time logged in the release log. */
+#define PDM_DEV_SLOW_CONSTRUCT_NS       RT_NS_100MS
 
 
 /*********************************************************************************************************************************
@@ -268,7 +277,15 @@ int pdmR3DevInit(PVM pVM)
      *
      * Instantiate the devices.
      *
+     * Note! This is done strictly in sequence on EMT(0): the constructors use
+     *       device helpers that assert being on the EMT, register resources in
+     *       lists whose order matters (PCI slots, I/O ports, timers) and
+     *       attach drivers which expect the same.  To help figure out where
+     *       start-up time goes, slow constructors are reported in the release
+     *       log together with the total time spent.
+     *
      */
+    uint64_t const nsStartAll = RTTimeNanoTS();
     for (i = 0; i < cDevs; i++)
     {
         PDMDEVREGR3 const * const pReg = paDevs[i].pDev->pReg;
@@ -554,7 +571,12 @@ int pdmR3DevInit(PVM pVM)
         RTCritSectRwLeaveExcl(&pVM->pdm.s.CoreListCritSectRw);
 
         Log(("PDM: Constructing device '%s' instance %d...\n", pDevIns->pReg->szName, pDevIns->iInstance));
+        uint64_t const nsStart = RTTimeNanoTS();
         rc = pDevIns->pReg->pfnConstruct(pDevIns, pDevIns->iInstance, pDevIns->pCfg);
+        uint64_t const cNsConstruct = RTTimeNanoTS() - nsStart;
+        if (cNsConstruct >= PDM_DEV_SLOW_CONSTRUCT_NS)
+            LogRel(("PDM: Constructing '%s'/%d took %RU64 ms\n",
+                    pDevIns->pReg->szName, pDevIns->iInstance, cNsConstruct / RT_NS_1MS));
         if (RT_FAILURE(rc))
         {
             LogRel(("PDM: Failed to construct '%s'/%d! %Rra\n", pDevIns->pReg->szName, pDevIns->iInstance, rc));
@@ -594,6 +616,7 @@ int pdmR3DevInit(PVM pVM)
         }
 
     } /* for device instances */
+    LogRel(("PDM: Constructed %u device instances in %RU64 ms\n", cDevs, (RTTimeNanoTS() - nsStartAll) / RT_NS_1MS));
 
 #ifdef VBOX_WITH_USB
     /* ditto for USB Devices. */
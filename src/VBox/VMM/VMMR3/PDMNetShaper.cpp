@@ -213,6 +213,8 @@ VMMR3_INT_DECL(int) PDMR3NsDetach(PVM pVM, PPDMDRVINS pDrvIns, PPDMNSFILTER pFil
  * This is used both by pdmR3NsUnchokeThread and PDMR3NsBwGroupSetLimit,
  * the latter only when setting cbPerSecMax to zero.
  *
+ * The filters are serviced in round-robin order across calls.
+ *
  * @param   pGroup      The group which filters should be unchoked.
  * @note    Caller owns the PDM::NsLock critsect.
  */
@@ -235,6 +237,19 @@ static void pdmR3NsUnchokeGroupFilters(PPDMNSBWGROUP pGroup)
                 Log3(("pdmR3NsUnchokeGroupFilters: Unchoked %p in %s (no callback)\n", pFilter, pGroup->szName));
         }
     }
+
+    /*
+     * Rotate the list so that a different filter gets the first go at the
+     * bucket next time around.  Otherwise the filter at the head of the list,
+     * whose pfnXmitPending callback runs first, tends to drain all the tokens
+     * and starve the other filters in the group.
+     */
+    PPDMNSFILTER const pFirst = RTListGetFirst(&pGroup->FilterList, PDMNSFILTER, ListEntry);
+    if (pFirst && !RTListNodeIsLast(&pGroup->FilterList, &pFirst->ListEntry))
+    {
+        RTListNodeRemove(&pFirst->ListEntry);
+        RTListAppend(&pGroup->FilterList, &pFirst->ListEntry);
+    }
 }
 
 
@@ -797,6 +797,11 @@ VMMR3DECL(void) PDMR3QueueFlushAll(PVM pVM)
      * only used to get someones attention. Queue inserts occurring during the
      * flush are caught using the pending bit.
      *
+     * Timer polled queues are drained here as well when they have something
+     * pending, so their items needn't wait for the next timer tick whenever
+     * the FF gets raised by some other queue.  The timer handler takes the
+     * same active bit, so a queue is never flushed by two threads at once.
+     *
      * Note! We must check the force action and pending flags after clearing
      *       the active bit!
      */
@@ -812,7 +817,6 @@ VMMR3DECL(void) PDMR3QueueFlushAll(PVM pVM)
             PPDMQUEUE pQueue = pVM->pdm.s.apRing0Queues[i];
             if (   pQueue
                 && pQueue->iPending != UINT32_MAX
-                && pQueue->hTimer == NIL_TMTIMERHANDLE
                 && pQueue->rcOkay == VINF_SUCCESS)
                 pdmR3QueueFlush(pVM, pQueue);
         }
@@ -825,7 +829,6 @@ VMMR3DECL(void) PDMR3QueueFlushAll(PVM pVM)
             PPDMQUEUE pQueue = pVM->pdm.s.papRing3Queues[i];
             if (   pQueue
                 && pQueue->iPending != UINT32_MAX
-                && pQueue->hTimer == NIL_TMTIMERHANDLE
                 && pQueue->rcOkay == VINF_SUCCESS)
                 pdmR3QueueFlush(pVM, pQueue);
         }
@@ -851,7 +854,43 @@ static DECLCALLBACK(void) pdmR3QueueTimer(PVM pVM, TMTIMERHANDLE hTimer, void *p
     Assert(hTimer == pQueue->hTimer);
 
     if (pQueue->iPending != UINT32_MAX)
-        pdmR3QueueFlush(pVM, pQueue);
+    {
+        /* Serialize with PDMR3QueueFlushAll.  If it's busy, make sure it takes
+           another round and picks up our items. */
+        if (!ASMAtomicBitTestAndSet(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_ACTIVE_BIT))
+        {
+            pdmR3QueueFlush(pVM, pQueue);
+            ASMAtomicBitClear(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_ACTIVE_BIT);
+
+            /* PDMR3QueueFlushAll gives up (after clearing the FF) while we're
+               holding the active bit, so get its attention again if anything
+               was inserted into the other queues meanwhile. */
+            bool fPending = ASMBitTest(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_PENDING_BIT);
+            for (size_t i = 0; i < pVM->pdm.s.cRing0Queues && !fPending; i++)
+            {
+                PPDMQUEUE pQueueOther = pVM->pdm.s.apRing0Queues[i];
+                fPending = pQueueOther
+                        && pQueueOther != pQueue
+                        && pQueueOther->iPending != UINT32_MAX
+                        && pQueueOther->rcOkay == VINF_SUCCESS;
+            }
+            for (size_t i = 0; i < pVM->pdm.s.cRing3Queues && !fPending; i++)
+            {
+                PPDMQUEUE pQueueOther = pVM->pdm.s.papRing3Queues[i];
+                fPending = pQueueOther
+                        && pQueueOther != pQueue
+                        && pQueueOther->iPending != UINT32_MAX
+                        && pQueueOther->rcOkay == VINF_SUCCESS;
+            }
+            if (fPending && !VM_FF_IS_SET(pVM, VM_FF_PDM_QUEUES))
+            {
+                VM_FF_SET(pVM, VM_FF_PDM_QUEUES);
+                VMR3NotifyGlobalFFU(pVM->pUVM, VMNOTIFYFF_FLAGS_DONE_REM);
+            }
+        }
+        else
+            ASMAtomicBitSet(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_PENDING_BIT);
+    }
 
     int rc = TMTimerSetMillies(pVM, hTimer, pQueue->cMilliesInterval);
     AssertRC(rc);
@@ -1814,6 +1814,9 @@ VMMR3_INT_DECL(int) PGMR3InitCompleted(PVM pVM, VMINITCOMPLETED enmWhat)
 #endif
             break;
 
+        case VMINITCOMPLETED_RING3:
+            return PGMR3ZeroPageScanInit(pVM);
+
         default:
             /* shut up gcc */
             break;
@@ -5574,6 +5574,167 @@ VMMR3DECL(int) PGMR3PhysChangeMemBalloon(PVM pVM, bool fInflate, unsigned cPages
 }
 
 
+#if HC_ARCH_BITS == 64 && (defined(RT_OS_WINDOWS) || defined(RT_OS_SOLARIS) || defined(RT_OS_LINUX) || defined(RT_OS_FREEBSD))
+
+/**
+ * Rendezvous callback used by PGMR3PhysReportFreeRanges that hands the backing
+ * of guest reported free pages back to GMM.
+ *
+ * Unlike ballooning the pages stay accessible to the guest, they are merely
+ * replaced by the ZERO page and the next write faults in a fresh one.  So no
+ * balloon accounting is done and the whole pool needn't be flushed, we just
+ * take out the shadow references to each page we free.
+ *
+ * @returns VBox strict status code.
+ * @param   pVM         The cross context VM structure.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT. Unused.
+ * @param   pvUser      The free ranges (PCPGMPHYSRANGES).
+ */
+static DECLCALLBACK(VBOXSTRICTRC) pgmR3PhysReportFreeRangesRendezvous(PVM pVM, PVMCPU pVCpu, void *pvUser)
+{
+    PCPGMPHYSRANGES const pRanges = (PCPGMPHYSRANGES)pvUser;
+    RT_NOREF(pVCpu);
+
+    PGM_LOCK_VOID(pVM);
+
+    /* Don't mess with the page states while they're being saved, the hint is only advisory anyway. */
+    if (pVM->pgm.s.LiveSave.fActive)
+    {
+        PGM_UNLOCK(pVM);
+        return VINF_SUCCESS;
+    }
+
+    uint32_t            cPendingPages = 0;
+    PGMMFREEPAGESREQ    pReq;
+    int rc = GMMR3FreePagesPrepare(pVM, &pReq, PGMPHYS_FREE_PAGE_BATCH_SIZE, GMMACCOUNT_BASE);
+    if (RT_FAILURE(rc))
+    {
+        PGM_UNLOCK(pVM);
+        AssertLogRelRCReturn(rc, rc);
+    }
+
+    bool     fFlushTLBs = false;
+    uint64_t cFreed     = 0;
+    for (uint64_t iRange = 0; iRange < pRanges->cRanges && RT_SUCCESS(rc); iRange++)
+    {
+        RTGCPHYS GCPhys = pRanges->aRanges[iRange].GCPhysStart;
+        for (uint64_t cLeft = pRanges->aRanges[iRange].cPages; cLeft > 0; cLeft--, GCPhys += GUEST_PAGE_SIZE)
+        {
+            PPGMPAGE pPage = pgmPhysGetPage(pVM, GCPhys);
+            if (   !pPage
+                || PGM_PAGE_GET_TYPE(pPage)  != PGMPAGETYPE_RAM
+                || PGM_PAGE_GET_STATE(pPage) != PGM_PAGE_STATE_ALLOCATED
+                || PGM_PAGE_HAS_ANY_HANDLERS(pPage)
+                || PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE
+                || PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE_DISABLED)
+                continue;
+
+            /* Devices may have the page mapped for DMA (PDMDevHlpPCIPhysGCPhys2CCPtr and friends),
+               freeing it underneath them would let them scribble on memory we no longer own. */
+            if (   PGM_PAGE_GET_WRITE_LOCKS(pPage) != 0
+                || PGM_PAGE_GET_READ_LOCKS(pPage) != 0)
+                continue;
+
+            /* Flush the shadow references to the page (and any shadow PT it backs) before letting go of it. */
+            pgmPoolFlushPageByGCPhys(pVM, GCPhys);
+            int rc2 = pgmPoolTrackUpdateGCPhys(pVM, GCPhys, pPage, true /*fFlushPTEs*/, &fFlushTLBs);
+            if (rc2 != VINF_SUCCESS)
+                continue;
+
+            rc = pgmPhysFreePage(pVM, pReq, &cPendingPages, pPage, GCPhys, PGMPAGETYPE_RAM);
+            if (RT_FAILURE(rc))
+                break;
+            cFreed++;
+        }
+    }
+
+    if (RT_SUCCESS(rc) && cPendingPages)
+        rc = GMMR3FreePagesPerform(pVM, pReq, cPendingPages);
+    GMMR3FreePagesCleanup(pReq);
+
+    PGM_UNLOCK(pVM);
+    Log(("pgmR3PhysReportFreeRangesRendezvous: %RU64 ranges, freed %RU64 pages, rc=%Rrc\n", pRanges->cRanges, cFreed, rc));
+
+    if (fFlushTLBs || cFreed)
+    {
+        PGM_INVL_ALL_VCPU_TLBS(pVM);
+        for (VMCPUID i = 0; i < pVM->cCpus; i++)
+            CPUMSetChangedFlags(pVM->apCpusR3[i], CPUM_CHANGED_GLOBAL_TLB_FLUSH);
+    }
+
+    AssertLogRelRC(rc);
+    return rc;
+}
+
+#endif /* 64-bit host && (Windows || Solaris || Linux || FreeBSD) */
+
+/**
+ * Releases the host backing of guest RAM the guest has reported as free (free
+ * page reporting / hinting).
+ *
+ * All ranges of one report are processed in a single EMT rendezvous, so the
+ * cost of stopping the VCPUs is paid once per batch rather than once per page
+ * as with the classic page-by-page balloon.  The pages are not ballooned, the
+ * guest may touch them again at any time and will get a fresh zeroed page.
+ * Pages that aren't plain allocated RAM, or that are currently mapped by
+ * someone (page mapping locks), are quietly skipped.
+ *
+ * The pages have been freed when this function returns, so the caller must not
+ * complete the report to the guest (letting it reuse the pages) before that.
+ * Since this involves an EMT rendezvous the caller must not own any lock other
+ * EMTs may be blocking on (IOM, device critical sections).  Devices should thus
+ * call it from a worker thread, VMMR3EmtRendezvous takes care of getting the
+ * job onto an EMT and waits for it.
+ *
+ * @returns VBox status code.
+ * @retval  VINF_SUCCESS also when the report is ignored (NEM mode, pre-allocated
+ *          RAM or a live save in progress).
+ * @retval  VERR_INVALID_PARAMETER if the ranges are misaligned, wrap around or
+ *          cover more pages than the VM has RAM.
+ * @param   pVM         The cross context VM structure.
+ * @param   pRanges     The free ranges.  Each range must be page aligned.  The
+ *                      caller may reuse the buffer on return.
+ */
+VMMR3DECL(int) PGMR3PhysReportFreeRanges(PVM pVM, PCPGMPHYSRANGES pRanges)
+{
+    AssertPtrReturn(pRanges, VERR_INVALID_POINTER);
+
+    /* The ranges come straight from the guest, so no assertions here.  Bound the
+       total page count by the RAM size so a bogus report can't keep the VCPUs
+       parked in the rendezvous walking non-existing pages. */
+    if (pRanges->cRanges == 0 || pRanges->cRanges > _64K)
+        return VERR_INVALID_PARAMETER;
+    uint64_t const cRamPages   = MMR3PhysGetRamSize(pVM) >> GUEST_PAGE_SHIFT;
+    uint64_t       cTotalPages = 0;
+    for (uint64_t i = 0; i < pRanges->cRanges; i++)
+    {
+        RTGCPHYS const GCPhysStart = pRanges->aRanges[i].GCPhysStart;
+        uint64_t const cPages      = pRanges->aRanges[i].cPages;
+        if (   (GCPhysStart & GUEST_PAGE_OFFSET_MASK)
+            || cPages > cRamPages - cTotalPages
+            || GCPhysStart + (cPages << GUEST_PAGE_SHIFT) < GCPhysStart)
+            return VERR_INVALID_PARAMETER;
+        cTotalPages += cPages;
+    }
+
+#if HC_ARCH_BITS == 64 && (defined(RT_OS_WINDOWS) || defined(RT_OS_SOLARIS) || defined(RT_OS_LINUX) || defined(RT_OS_FREEBSD))
+    /* Nothing to gain when the memory can't be handed back. */
+    if (PGM_IS_IN_NEM_MODE(pVM) || pVM->pgm.s.fRamPreAlloc)
+        return VINF_SUCCESS;
+
+    /* Synchronous on purpose: the guest may reuse the pages as soon as the report
+       is completed, so they must be gone by then or we'd throw away its writes. */
+    int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3PhysReportFreeRangesRendezvous, (void *)pRanges);
+    AssertRC(rc);
+    return rc;
+
+#else
+    RT_NOREF(pVM);
+    return VERR_NOT_IMPLEMENTED;
+#endif
+}
+
+
 
 /*********************************************************************************************************************************
 *   Write Monitoring                                                                                                             *
@@ -56,7 +56,9 @@
 *   Defined Constants And Macros                                                                                                 *
 *********************************************************************************************************************************/
 /** Saved state data unit version.  */
-#define PGM_SAVED_STATE_VERSION                 14
+#define PGM_SAVED_STATE_VERSION                 15
+/** Saved state data unit version before duplicate RAM page records. */
+#define PGM_SAVED_STATE_VERSION_PRE_DUP         14
 /** Saved state data unit version before the PAE PDPE registers. */
 #define PGM_SAVED_STATE_VERSION_PRE_PAE         13
 /** Saved state data unit version after this includes ballooned page flags in
@@ -97,8 +99,11 @@
 #define PGM_STATE_REC_ROM_PROT          UINT8_C(0x07)
 /** Ballooned page. No data. */
 #define PGM_STATE_REC_RAM_BALLOONED     UINT8_C(0x08)
+/** Duplicate RAM page. Followed by the RTGCPHYS of an identical page saved
+ * earlier in the same pass. */
+#define PGM_STATE_REC_RAM_DUP           UINT8_C(0x09)
 /** The last record type. */
-#define PGM_STATE_REC_LAST              PGM_STATE_REC_RAM_BALLOONED
+#define PGM_STATE_REC_LAST              PGM_STATE_REC_RAM_DUP
 /** End marker. */
 #define PGM_STATE_REC_END               UINT8_C(0xff)
 /** Flag indicating that the data is preceded by the page address.
@@ -113,6 +118,10 @@
 /** The CRC-32 for a zero half page. */
 #define PGM_STATE_CRC32_ZERO_HALF_PAGE  UINT32_C(0xf1e8ba9e)
 
+/** Number of entries in the duplicate page cache used by the final pass
+ * (direct mapped, must be a power of two). */
+#define PGM_STATE_DUP_CACHE_ENTRIES     _256K
+
 
 
 /** @name Old Page types used in older saved states.
@@ -159,6 +168,23 @@ typedef struct
 } PGMOLD;
 
 
+/**
+ * Duplicate page cache entry.
+ *
+ * Maps the content hash of a RAM page saved during the final pass to its
+ * address, so identical pages later in the pass can be saved by reference.
+ */
+typedef struct PGMSTATEDUPENTRY
+{
+    /** The content hash. */
+    uint64_t                        uHash;
+    /** The address of the page, NIL_RTGCPHYS if the entry is unused. */
+    RTGCPHYS                        GCPhys;
+} PGMSTATEDUPENTRY;
+/** Pointer to a duplicate page cache entry. */
+typedef PGMSTATEDUPENTRY *PPGMSTATEDUPENTRY;
+
+
 /*********************************************************************************************************************************
 *   Global Variables                                                                                                             *
 *********************************************************************************************************************************/
@@ -1398,14 +1424,17 @@ static void pgmR3StateVerifyCrc32ForRamPage(PVM pVM, PPGMRAMRANGE pCur, PPGMLIVE
 /**
  * Scan for RAM page modifications and reprotect them.
  *
+ * @returns Number of pages that had write monitoring (re-)enabled, i.e. the
+ *          pages which may still have writable shadow page table entries.
  * @param   pVM                 The cross context VM structure.
  * @param   fFinalPass          Whether this is the final pass or not.
  */
-static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
+static uint32_t pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
 {
     /*
      * The RAM.
      */
+    uint32_t cNewlyMonitored = 0;
     RTGCPHYS GCPhysCur = 0;
     uint32_t idxLookup;
     uint32_t cLookupEntries;
@@ -1485,6 +1514,7 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
 
                                 pgmPhysPageWriteMonitor(pVM, &pCur->aPages[iPage],
                                                         pCur->GCPhys + ((RTGCPHYS)iPage << GUEST_PAGE_SHIFT));
+                                cNewlyMonitored++;
                                 paLSPages[iPage].fWriteMonitored        = 1;
                                 paLSPages[iPage].fWriteMonitoredJustNow = 1;
                                 paLSPages[iPage].fDirty                 = 1;
@@ -1612,6 +1642,77 @@ static void pgmR3ScanRamPages(PVM pVM, bool fFinalPass)
            skip the final range if one was umapped while we yielded the lock. */
     } while (idxLookup < cLookupEntries);
     PGM_UNLOCK(pVM);
+    return cNewlyMonitored;
+}
+
+
+/**
+ * Calculates the duplicate page cache hash of a page.
+ *
+ * This only needs to spread identical pages over the cache, equality is always
+ * verified by comparing the bits.
+ *
+ * @returns 64-bit hash.
+ * @param   pbPage              The page bits.
+ */
+static uint64_t pgmR3StateDupHash(uint8_t const *pbPage)
+{
+    uint64_t const *pu64 = (uint64_t const *)pbPage;
+    uint64_t        uHash = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < GUEST_PAGE_SIZE / sizeof(uint64_t); i += 4)
+    {
+        uHash ^= pu64[i] + (pu64[i + 1] << 1) + (pu64[i + 2] << 2) + (pu64[i + 3] << 3);
+        uHash *= UINT64_C(0x100000001b3);
+        uHash ^= uHash >> 29;
+    }
+    return uHash;
+}
+
+
+/**
+ * Looks up a copy of a page saved earlier in the final pass, entering the page
+ * into the cache if it isn't a duplicate.
+ *
+ * @returns The address of the identical page, NIL_RTGCPHYS if none.
+ * @param   pVM                 The cross context VM structure.
+ * @param   paDupCache          The duplicate page cache.
+ * @param   pbPage              The page bits.
+ * @param   GCPhys              The address of the page.
+ *
+ * @remarks Caller owns the PGM lock.  Only valid while the VM is stopped, as
+ *          the guest memory of the pages in the cache must match what's in the
+ *          saved state.
+ */
+static RTGCPHYS pgmR3StateDupLookup(PVM pVM, PPGMSTATEDUPENTRY paDupCache, uint8_t const *pbPage, RTGCPHYS GCPhys)
+{
+    if (ASMMemIsZero(pbPage, GUEST_PAGE_SIZE))
+        return NIL_RTGCPHYS;
+
+    uint64_t const    uHash  = pgmR3StateDupHash(pbPage);
+    PPGMSTATEDUPENTRY pEntry = &paDupCache[uHash & (PGM_STATE_DUP_CACHE_ENTRIES - 1)];
+    if (   pEntry->uHash  == uHash
+        && pEntry->GCPhys != NIL_RTGCPHYS
+        && pEntry->GCPhys != GCPhys)
+    {
+        PPGMPAGE pPageSrc = pgmPhysGetPage(pVM, pEntry->GCPhys);
+        if (pPageSrc)
+        {
+            PGMPAGEMAPLOCK  PgMpLck;
+            void const     *pvSrcPage;
+            int rc = pgmPhysGCPhys2CCPtrInternalReadOnly(pVM, pPageSrc, pEntry->GCPhys, &pvSrcPage, &PgMpLck);
+            if (RT_SUCCESS(rc))
+            {
+                bool const fSame = memcmp(pvSrcPage, pbPage, GUEST_PAGE_SIZE) == 0;
+                pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLck);
+                if (fSame)
+                    return pEntry->GCPhys;
+            }
+        }
+    }
+
+    pEntry->uHash  = uHash;
+    pEntry->GCPhys = GCPhys;
+    return NIL_RTGCPHYS;
 }
 
 
@@ -1628,6 +1729,24 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
 {
     NOREF(fLiveSave);
 
+    /*
+     * In the final pass nothing changes behind our back, so identical pages
+     * can be saved by reference.  This is an optimization, so just go without
+     * it if we can't get the memory.
+     */
+    PPGMSTATEDUPENTRY paDupCache = NULL;
+    uint32_t          cDupPages  = 0;
+    if (uPass == SSM_PASS_FINAL)
+    {
+        paDupCache = (PPGMSTATEDUPENTRY)RTMemAlloc(sizeof(paDupCache[0]) * PGM_STATE_DUP_CACHE_ENTRIES);
+        if (paDupCache)
+            for (uint32_t i = 0; i < PGM_STATE_DUP_CACHE_ENTRIES; i++)
+            {
+                paDupCache[i].uHash  = 0;
+                paDupCache[i].GCPhys = NIL_RTGCPHYS;
+            }
+    }
+
     /*
      * The RAM.
      */
@@ -1728,6 +1847,7 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
                         uint8_t         abPage[GUEST_PAGE_SIZE];
                         PGMPAGEMAPLOCK  PgMpLck;
                         void const     *pvPage;
+                        RTGCPHYS        GCPhysDup = NIL_RTGCPHYS;
                         rc = pgmPhysGCPhys2CCPtrInternalReadOnly(pVM, pCurPage, GCPhys, &pvPage, &PgMpLck);
                         if (RT_SUCCESS(rc))
                         {
@@ -1737,12 +1857,30 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
                                 pgmR3StateVerifyCrc32ForPage(abPage, pCur, paLSPages, iPage, "save#3");
 #endif
                             pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLck);
+                            if (paDupCache)
+                                GCPhysDup = pgmR3StateDupLookup(pVM, paDupCache, abPage, GCPhys);
                         }
                         PGM_UNLOCK(pVM);
-                        AssertLogRelMsgRCReturn(rc, ("rc=%Rrc GCPhys=%RGp\n", rc, GCPhys), rc);
+                        if (RT_FAILURE(rc))
+                        {
+                            RTMemFree(paDupCache);
+                            AssertLogRelMsgFailedReturn(("rc=%Rrc GCPhys=%RGp\n", rc, GCPhys), rc);
+                        }
 
                         /* Try save some memory when restoring. */
-                        if (!ASMMemIsZero(pvPage, GUEST_PAGE_SIZE))
+                        if (GCPhysDup != NIL_RTGCPHYS)
+                        {
+                            if (GCPhys == GCPhysLast + GUEST_PAGE_SIZE)
+                                SSMR3PutU8(pSSM, PGM_STATE_REC_RAM_DUP);
+                            else
+                            {
+                                SSMR3PutU8(pSSM, PGM_STATE_REC_RAM_DUP | PGM_STATE_REC_FLAG_ADDR);
+                                SSMR3PutGCPhys(pSSM, GCPhys);
+                            }
+                            rc = SSMR3PutGCPhys(pSSM, GCPhysDup);
+                            cDupPages++;
+                        }
+                        else if (!ASMMemIsZero(abPage, GUEST_PAGE_SIZE))
                         {
                             if (GCPhys == GCPhysLast + GUEST_PAGE_SIZE)
                                 SSMR3PutU8(pSSM, PGM_STATE_REC_RAM_RAW);
@@ -1785,7 +1923,10 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
                         }
                     }
                     if (RT_FAILURE(rc))
+                    {
+                        RTMemFree(paDupCache);
                         return rc;
+                    }
 
                     PGM_LOCK_VOID(pVM);
                     if (!fSkipped)
@@ -1820,6 +1961,12 @@ static int pgmR3SaveRamPages(PVM pVM, PSSMHANDLE pSSM, bool fLiveSave, uint32_t
 
     PGM_UNLOCK(pVM);
 
+    if (paDupCache)
+    {
+        RTMemFree(paDupCache);
+        if (cDupPages)
+            LogRel(("PGM: Saved %u duplicate RAM pages by reference\n", cDupPages));
+    }
     return VINF_SUCCESS;
 }
 
@@ -1935,8 +2082,18 @@ static DECLCALLBACK(int) pgmR3LiveExec(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
      */
     pgmR3ScanRomPages(pVM);
     pgmR3ScanMmio2Pages(pVM, uPass);
-    pgmR3ScanRamPages(pVM, false /*fFinalPass*/);
-    pgmR3PoolClearAll(pVM, true /*fFlushRemTlb*/); /** @todo this could perhaps be optimized a bit. */
+    uint32_t const cNewlyMonitored = pgmR3ScanRamPages(pVM, false /*fFinalPass*/);
+
+    /*
+     * Writable shadow mappings of the pages just put under write monitoring
+     * must go away, or we won't see them getting dirty again.  When the guest
+     * didn't write to any monitored page since the last pass, there's nothing
+     * writable to zap and the expensive pool flush can be skipped.
+     */
+    if (cNewlyMonitored)
+        pgmR3PoolClearAll(pVM, true /*fFlushRemTlb*/); /** @todo this could perhaps be optimized a bit. */
+    else
+        Log(("pgmR3LiveExec: pass=%u: no newly monitored pages, skipping pool flush\n", uPass));
 
     /*
      * Save the pages.
@@ -2742,6 +2899,7 @@ static int pgmR3LoadMemory(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t
             case PGM_STATE_REC_RAM_ZERO:
             case PGM_STATE_REC_RAM_RAW:
             case PGM_STATE_REC_RAM_BALLOONED:
+            case PGM_STATE_REC_RAM_DUP:
             {
                 /*
                  * Get the address and resolve it into a page descriptor.
@@ -2860,6 +3018,39 @@ static int pgmR3LoadMemory(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t
                         break;
                     }
 
+                    case PGM_STATE_REC_RAM_DUP:
+                    {
+                        /* Copy the bits from the identical page loaded earlier. */
+                        RTGCPHYS GCPhysSrc;
+                        rc = SSMR3GetGCPhys(pSSM, &GCPhysSrc);
+                        if (RT_FAILURE(rc))
+                            return rc;
+                        AssertLogRelMsgReturn(   uVersion > PGM_SAVED_STATE_VERSION_PRE_DUP
+                                              && !(GCPhysSrc & GUEST_PAGE_OFFSET_MASK)
+                                              && GCPhysSrc != GCPhys,
+                                              ("GCPhys=%RGp GCPhysSrc=%RGp uVersion=%u\n", GCPhys, GCPhysSrc, uVersion),
+                                              VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+                        PPGMPAGE pPageSrc = pgmPhysGetPage(pVM, GCPhysSrc);
+                        AssertLogRelMsgReturn(pPageSrc, ("GCPhysSrc=%RGp\n", GCPhysSrc), VERR_PGM_INVALID_GC_PHYSICAL_ADDRESS);
+
+                        PGMPAGEMAPLOCK PgMpLckSrc;
+                        void const    *pvSrcPage;
+                        rc = pgmPhysGCPhys2CCPtrInternalReadOnly(pVM, pPageSrc, GCPhysSrc, &pvSrcPage, &PgMpLckSrc);
+                        AssertLogRelMsgRCReturn(rc, ("GCPhysSrc=%RGp %R[pgmpage] rc=%Rrc\n", GCPhysSrc, pPageSrc, rc), rc);
+
+                        PGMPAGEMAPLOCK PgMpLck;
+                        void          *pvDstPage;
+                        rc = pgmPhysGCPhys2CCPtrInternal(pVM, pPage, GCPhys, &pvDstPage, &PgMpLck);
+                        if (RT_SUCCESS(rc))
+                        {
+                            memcpy(pvDstPage, pvSrcPage, GUEST_PAGE_SIZE);
+                            pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLck);
+                        }
+                        pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLckSrc);
+                        AssertLogRelMsgRCReturn(rc, ("GCPhys=%RGp %R[pgmpage] rc=%Rrc\n", GCPhys, pPage, rc), rc);
+                        break;
+                    }
+
                     default:
                         AssertMsgFailedReturn(("%#x\n", u8), VERR_PGM_SAVED_REC_TYPE);
                 }
@@ -3244,11 +3435,13 @@ static DECLCALLBACK(int) pgmR3Load(PVM pVM, PSSMHANDLE pSSM, uint32_t uVersion,
      */
     if (   (   uPass != SSM_PASS_FINAL
             && uVersion != PGM_SAVED_STATE_VERSION
+            && uVersion != PGM_SAVED_STATE_VERSION_PRE_DUP
             && uVersion != PGM_SAVED_STATE_VERSION_PRE_PAE
             && uVersion != PGM_SAVED_STATE_VERSION_BALLOON_BROKEN
             && uVersion != PGM_SAVED_STATE_VERSION_PRE_BALLOON
             && uVersion != PGM_SAVED_STATE_VERSION_NO_RAM_CFG)
         || (   uVersion != PGM_SAVED_STATE_VERSION
+            && uVersion != PGM_SAVED_STATE_VERSION_PRE_DUP
             && uVersion != PGM_SAVED_STATE_VERSION_PRE_PAE
             && uVersion != PGM_SAVED_STATE_VERSION_BALLOON_BROKEN
             && uVersion != PGM_SAVED_STATE_VERSION_PRE_BALLOON
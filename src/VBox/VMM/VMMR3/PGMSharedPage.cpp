@@ -32,7 +32,10 @@
 #define LOG_GROUP LOG_GROUP_PGM_SHARED
 #define VBOX_WITHOUT_PAGING_BIT_FIELDS /* 64-bit bitfields are just asking for trouble. See @bugref{9841} and others. */
 #include <VBox/vmm/pgm.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/mm.h>
 #include <VBox/vmm/stam.h>
+#include <VBox/vmm/tm.h>
 #include <VBox/vmm/uvm.h>
 #include "PGMInternal.h"
 #include <VBox/vmm/vmcc.h>
@@ -49,6 +52,39 @@
 #include "PGMInline.h"
 
 
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * State of the background zero page reclaimer.
+ *
+ * This is allocated from the MM heap and, like the timer, goes away with the VM.
+ */
+typedef struct PGMZEROSCAN
+{
+    /** The scan timer (real time). */
+    TMTIMERHANDLE               hTimer;
+    /** The interval between scan steps in milliseconds. */
+    uint32_t                    cMsInterval;
+    /** Max number of pages to inspect per scan step. */
+    uint32_t                    cPagesPerStep;
+    /** The RAM range we're currently scanning. */
+    uint32_t                    idRamRange;
+    /** The page index within that range to continue at. */
+    uint32_t                    iPage;
+    /** Pages inspected. */
+    STAMCOUNTER                 StatPagesScanned;
+    /** Pages replaced by the zero page. */
+    STAMCOUNTER                 StatPagesReclaimed;
+    /** Completed passes over guest RAM. */
+    STAMCOUNTER                 StatPasses;
+    /** Time spent in scan steps. */
+    STAMPROFILE                 StatStep;
+} PGMZEROSCAN;
+/** Pointer to the zero page reclaimer state. */
+typedef PGMZEROSCAN *PPGMZEROSCAN;
+
+
 #ifdef VBOX_WITH_PAGE_SHARING
 
 
@@ -457,3 +493,244 @@ DECLCALLBACK(int) pgmR3CmdShowSharedModules(PCDBGCCMD pCmd, PDBGCCMDHLP pCmdHlp,
 
 # endif /* VBOX_STRICT*/
 #endif /* VBOX_WITH_PAGE_SHARING */
+
+
+/*********************************************************************************************************************************
+*   Zero Page Reclaiming                                                                                                         *
+*********************************************************************************************************************************/
+
+/**
+ * Rendezvous callback that does one step of the zero page reclaim scan.
+ *
+ * Guest RAM pages which are allocated but contain nothing but zeros are handed
+ * back to GMM and replaced by the shared zero page, just like ballooning does.
+ * The next write faults in a fresh page as usual.
+ *
+ * @returns VBox strict status code.
+ * @param   pVM         The cross context VM structure.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ * @param   pvUser      The reclaimer state.
+ */
+static DECLCALLBACK(VBOXSTRICTRC) pgmR3ZeroScanRendezvous(PVM pVM, PVMCPU pVCpu, void *pvUser)
+{
+    PPGMZEROSCAN const pScan = (PPGMZEROSCAN)pvUser;
+    RT_NOREF(pVCpu);
+
+    PGM_LOCK_VOID(pVM);
+
+    /* Don't mess with the page states while they're being saved. */
+    if (pVM->pgm.s.LiveSave.fActive)
+    {
+        PGM_UNLOCK(pVM);
+        return VINF_SUCCESS;
+    }
+
+    STAM_PROFILE_START(&pScan->StatStep, a);
+    uint32_t            cPendingPages = 0;
+    PGMMFREEPAGESREQ    pReq;
+    int rc = GMMR3FreePagesPrepare(pVM, &pReq, PGMPHYS_FREE_PAGE_BATCH_SIZE, GMMACCOUNT_BASE);
+    if (RT_FAILURE(rc))
+    {
+        PGM_UNLOCK(pVM);
+        AssertLogRelRCReturn(rc, rc);
+    }
+
+    bool           fFlushTLBs    = false;
+    uint32_t       cReclaimed    = 0;
+    uint32_t       cLeft         = pScan->cPagesPerStep;
+    uint32_t const idRamRangeMax = RT_MIN(pVM->pgm.s.idRamRangeMax, RT_ELEMENTS(pVM->pgm.s.apRamRanges) - 1U);
+    while (cLeft > 0 && RT_SUCCESS(rc))
+    {
+        if (pScan->idRamRange > idRamRangeMax)
+        {
+            pScan->idRamRange = 0;
+            pScan->iPage      = 0;
+            STAM_REL_COUNTER_INC(&pScan->StatPasses);
+        }
+
+        PPGMRAMRANGE const pRam   = pVM->pgm.s.apRamRanges[pScan->idRamRange];
+        uint32_t const     cPages = pRam ? (uint32_t)(pRam->cb >> GUEST_PAGE_SHIFT) : 0;
+        if (pScan->iPage >= cPages)
+        {
+            pScan->idRamRange++;
+            pScan->iPage = 0;
+            if (!pRam)
+                cLeft--; /* Make sure we terminate even if there are no ranges. */
+            continue;
+        }
+
+        PPGMPAGE const pPage  = &pRam->aPages[pScan->iPage];
+        RTGCPHYS const GCPhys = pRam->GCPhys + ((RTGCPHYS)pScan->iPage << GUEST_PAGE_SHIFT);
+        pScan->iPage++;
+        cLeft--;
+        STAM_REL_COUNTER_INC(&pScan->StatPagesScanned);
+
+        if (   PGM_PAGE_GET_TYPE(pPage)  != PGMPAGETYPE_RAM
+            || PGM_PAGE_GET_STATE(pPage) != PGM_PAGE_STATE_ALLOCATED
+            || PGM_PAGE_HAS_ANY_HANDLERS(pPage)
+            || PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE
+            || PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE_DISABLED)
+            continue;
+
+        /* Skip pages somebody has mapped, devices may be doing DMA into them
+           (PDMDevHlpPCIPhysGCPhys2CCPtr and friends). */
+        if (   PGM_PAGE_GET_WRITE_LOCKS(pPage) != 0
+            || PGM_PAGE_GET_READ_LOCKS(pPage) != 0)
+            continue;
+
+        PGMPAGEMAPLOCK PgMpLck;
+        void const    *pvPage;
+        if (RT_FAILURE(pgmPhysGCPhys2CCPtrInternalReadOnly(pVM, pPage, GCPhys, &pvPage, &PgMpLck)))
+            continue;
+        bool const fZero = ASMMemIsZero(pvPage, GUEST_PAGE_SIZE);
+        pgmPhysReleaseInternalPageMappingLock(pVM, &PgMpLck);
+        if (!fZero)
+            continue;
+
+        /* Flush the shadow references to the page (and any shadow PT it backs) before letting go of it. */
+        pgmPoolFlushPageByGCPhys(pVM, GCPhys);
+        int rc2 = pgmPoolTrackUpdateGCPhys(pVM, GCPhys, pPage, true /*fFlushPTEs*/, &fFlushTLBs);
+        if (rc2 != VINF_SUCCESS)
+            continue;
+
+        rc = pgmPhysFreePage(pVM, pReq, &cPendingPages, pPage, GCPhys, PGMPAGETYPE_RAM);
+        if (RT_SUCCESS(rc))
+            cReclaimed++;
+    }
+
+    if (RT_SUCCESS(rc) && cPendingPages)
+        rc = GMMR3FreePagesPerform(pVM, pReq, cPendingPages);
+    GMMR3FreePagesCleanup(pReq);
+
+    STAM_REL_COUNTER_ADD(&pScan->StatPagesReclaimed, cReclaimed);
+    STAM_PROFILE_STOP(&pScan->StatStep, a);
+    PGM_UNLOCK(pVM);
+
+    if (fFlushTLBs || cReclaimed)
+    {
+        PGM_INVL_ALL_VCPU_TLBS(pVM);
+        for (VMCPUID i = 0; i < pVM->cCpus; i++)
+            CPUMSetChangedFlags(pVM->apCpusR3[i], CPUM_CHANGED_GLOBAL_TLB_FLUSH);
+    }
+
+    AssertLogRelRC(rc);
+    return rc;
+}
+
+
+/**
+ * EMT request worker doing a zero page reclaim scan step and re-arming the
+ * timer.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pScan       The reclaimer state.
+ */
+static DECLCALLBACK(void) pgmR3ZeroScanStep(PVM pVM, PPGMZEROSCAN pScan)
+{
+    /* The request may have been queued before the VM was suspended or powered
+       off, the state callback re-arms the timer when it's running again. */
+    if (!VMSTATE_IS_RUNNING(VMR3GetState(pVM)))
+        return;
+
+    int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, pgmR3ZeroScanRendezvous, pScan);
+    if (RT_FAILURE(rc))
+        LogRel(("PGM: Zero page reclaim scan failed (%Rrc), stopping it.\n", rc));
+    else if (VMSTATE_IS_RUNNING(VMR3GetState(pVM)))
+        TMTimerSetMillies(pVM, pScan->hTimer, pScan->cMsInterval);
+}
+
+
+/**
+ * @callback_method_impl{FNTMTIMERINT,
+ *      Kicks off a zero page reclaim step on an EMT.}
+ *
+ * We cannot do the rendezvous from the timer callback itself, so we queue a
+ * request like the balloon code does.
+ */
+static DECLCALLBACK(void) pgmR3ZeroScanTimer(PVM pVM, TMTIMERHANDLE hTimer, void *pvUser)
+{
+    RT_NOREF(hTimer);
+    int rc = VMR3ReqCallNoWait(pVM, VMCPUID_ANY_QUEUE, (PFNRT)pgmR3ZeroScanStep, 2, pVM, (PPGMZEROSCAN)pvUser);
+    AssertLogRelRC(rc);
+}
+
+
+/**
+ * @callback_method_impl{FNVMATSTATE,
+ *      Stops the zero page reclaim timer while the VM isn't running.}
+ *
+ * The timer runs on the real clock which keeps ticking while the VM is
+ * suspended, so without this we'd keep scanning (and freeing) a paused VM.
+ */
+static DECLCALLBACK(void) pgmR3ZeroScanAtState(PUVM pUVM, PCVMMR3VTABLE pVMM, VMSTATE enmState, VMSTATE enmOldState, void *pvUser)
+{
+    PPGMZEROSCAN const pScan = (PPGMZEROSCAN)pvUser;
+    PVM const          pVM   = pUVM->pVM;
+    if (VMSTATE_IS_RUNNING(enmState) && !VMSTATE_IS_RUNNING(enmOldState))
+        TMTimerSetMillies(pVM, pScan->hTimer, pScan->cMsInterval);
+    else if (!VMSTATE_IS_RUNNING(enmState) && VMSTATE_IS_RUNNING(enmOldState))
+        TMTimerStop(pVM, pScan->hTimer);
+    RT_NOREF(pVMM);
+}
+
+
+/**
+ * Sets up the background zero page reclaimer if configured.
+ *
+ * This is a within-VM subset of content based page sharing that doesn't need
+ * the guest additions: allocated pages that are all zeros are the most common
+ * duplicates by far.
+ *
+ * @returns VBox status code.
+ * @param   pVM         The cross context VM structure.
+ */
+VMMR3_INT_DECL(int) PGMR3ZeroPageScanInit(PVM pVM)
+{
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetRoot(pVM), "/PGM/ZeroPageScan");
+
+    /** @cfgm{/PGM/ZeroPageScan/PagesPerStep, uint32_t, pages, 0, 262144, 0}
+     * The number of guest RAM pages the zero page reclaimer inspects per step,
+     * zero disables it.  Together with Interval this is the CPU budget. */
+    uint32_t cPagesPerStep;
+    int rc = CFGMR3QueryU32Def(pCfg, "PagesPerStep", &cPagesPerStep, 0);
+    AssertLogRelRCReturn(rc, rc);
+    AssertLogRelMsgReturn(cPagesPerStep <= _256K, ("PagesPerStep=%u\n", cPagesPerStep), VERR_OUT_OF_RANGE);
+
+    /** @cfgm{/PGM/ZeroPageScan/Interval, uint32_t, ms, 10, 60000, 1000}
+     * The interval between zero page reclaimer steps. */
+    uint32_t cMsInterval;
+    rc = CFGMR3QueryU32Def(pCfg, "Interval", &cMsInterval, 1000);
+    AssertLogRelRCReturn(rc, rc);
+    AssertLogRelMsgReturn(cMsInterval >= 10 && cMsInterval <= 60000, ("Interval=%u\n", cMsInterval), VERR_OUT_OF_RANGE);
+
+    if (!cPagesPerStep)
+        return VINF_SUCCESS;
+    if (PGM_IS_IN_NEM_MODE(pVM) || pVM->pgm.s.fRamPreAlloc)
+    {
+        LogRel(("PGM: Zero page reclaim scan not supported with %s, ignoring.\n",
+                PGM_IS_IN_NEM_MODE(pVM) ? "NEM mode" : "pre-allocated RAM"));
+        return VINF_SUCCESS;
+    }
+
+    PPGMZEROSCAN pScan = (PPGMZEROSCAN)MMR3HeapAllocZ(pVM, MM_TAG_PGM, sizeof(*pScan));
+    AssertReturn(pScan, VERR_NO_MEMORY);
+    pScan->cMsInterval   = cMsInterval;
+    pScan->cPagesPerStep = cPagesPerStep;
+
+    rc = TMR3TimerCreate(pVM, TMCLOCK_REAL, pgmR3ZeroScanTimer, pScan, TMTIMER_FLAGS_NO_RING0, "PGM zero page scan",
+                         &pScan->hTimer);
+    AssertLogRelRCReturn(rc, rc);
+
+    STAM_REL_REG(pVM, &pScan->StatPagesScanned,   STAMTYPE_COUNTER, "/PGM/ZeroPageScan/Scanned",   STAMUNIT_PAGES,     "Pages inspected by the zero page reclaimer.");
+    STAM_REL_REG(pVM, &pScan->StatPagesReclaimed, STAMTYPE_COUNTER, "/PGM/ZeroPageScan/Reclaimed", STAMUNIT_PAGES,     "Allocated zero pages replaced by the shared zero page.");
+    STAM_REL_REG(pVM, &pScan->StatPasses,         STAMTYPE_COUNTER, "/PGM/ZeroPageScan/Passes",    STAMUNIT_OCCURENCES, "Completed passes over guest RAM.");
+    STAM_REG(pVM,     &pScan->StatStep,           STAMTYPE_PROFILE, "/PGM/ZeroPageScan/Step",      STAMUNIT_TICKS_PER_CALL, "Profiling a zero page reclaimer step.");
+
+    /* The timer is armed when the VM starts running and stopped when it's suspended. */
+    rc = VMR3AtStateRegister(pVM->pUVM, pgmR3ZeroScanAtState, pScan);
+    AssertLogRelRCReturn(rc, rc);
+
+    LogRel(("PGM: Zero page reclaim scan enabled: %u pages every %u ms\n", cPagesPerStep, cMsInterval));
+    return VINF_SUCCESS;
+}
+
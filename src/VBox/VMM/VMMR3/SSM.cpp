@@ -155,6 +155,7 @@
 *********************************************************************************************************************************/
 #define LOG_GROUP LOG_GROUP_SSM
 #include <VBox/vmm/ssm.h>
+#include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/pdmapi.h>
 #include <VBox/vmm/pdmcritsect.h>
@@ -172,7 +173,9 @@
 #include <iprt/crc.h>
 #include <iprt/file.h>
 #include <iprt/mem.h>
+#include <iprt/mp.h>
 #include <iprt/param.h>
+#include <iprt/req.h>
 #include <iprt/thread.h>
 #include <iprt/semaphore.h>
 #include <iprt/string.h>
@@ -296,6 +299,22 @@
 #define SSM_ZIP_BLOCK_SIZE                      _4K
 AssertCompile(SSM_ZIP_BLOCK_SIZE / _1K * _1K == SSM_ZIP_BLOCK_SIZE);
 
+/** The maximum size of a record holding one compression block, including the
+ * record header (type + 3 byte size) and the LZF block size byte. */
+#define SSM_ZIP_BLOCK_REC_MAX                   (1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE)
+/** The maximum number of worker threads compressing blocks in parallel. */
+#define SSM_ZIP_BATCH_THREADS_MAX               8
+/** Number of blocks queued per worker thread before the batch is compressed. */
+#define SSM_ZIP_BATCH_BLOCKS_PER_THREAD         32
+
+/** The first live pass at which auto-converge may start throttling the guest. */
+#define SSM_AUTO_CONVERGE_FIRST_PASS            32
+/** Number of passes between each auto-converge throttling step. */
+#define SSM_AUTO_CONVERGE_INTERVAL              8
+/** How many percentage points each auto-converge step cuts off the CPU
+ *  execution cap. */
+#define SSM_AUTO_CONVERGE_STEP                  20
+
 
 /**
  * Asserts that the handle is writable and returns with VERR_SSM_INVALID_STATE
@@ -393,6 +412,11 @@ typedef struct SSMSTRMBUF
     uint32_t                cb;
     /** End of stream indicator (for read streams only). */
     bool                    fEndOfStream;
+    /** Whether u32StreamCRC is valid (for read streams only). */
+    bool                    fStreamCRC;
+    /** The stream CRC up to the end of this buffer, calculated by the
+     * producer (for read streams only). */
+    uint32_t                u32StreamCRC;
     /** The nano timestamp set by ssmR3StrmGetFreeBuf. */
     uint64_t                NanoTS;
     /** Pointer to the next buffer in the chain. */
@@ -455,11 +479,58 @@ typedef struct SSMSTRM
      * This may lag behind off as it's desirable to checksum as large blocks as
      * possible.  */
     uint32_t                offStreamCRC;
+    /** The stream CRC up to offReadAheadCRC, maintained by the producer of a
+     * read stream so the consumer doesn't have to checksum whole buffers. */
+    uint32_t                u32ReadAheadCRC;
+    /** The stream offset u32ReadAheadCRC is valid for, UINT64_MAX if unknown. */
+    uint64_t                offReadAheadCRC;
 } SSMSTRM;
 /** Pointer to a SSM stream. */
 typedef SSMSTRM *PSSMSTRM;
 
 
+/**
+ * A record queued in a compression batch.
+ */
+typedef struct SSMZIPENTRY
+{
+    /** Set if abIn needs compressing, clear if abRec holds a ready record. */
+    bool                    fCompress;
+    /** The size of the record in abRec (valid after compression). */
+    uint32_t                cbRec;
+    /** The uncompressed block. */
+    uint8_t                 abIn[SSM_ZIP_BLOCK_SIZE];
+    /** The record as it goes into the stream. */
+    uint8_t                 abRec[SSM_ZIP_BLOCK_REC_MAX];
+} SSMZIPENTRY;
+/** Pointer to a queued compression batch record. */
+typedef SSMZIPENTRY *PSSMZIPENTRY;
+
+/**
+ * Batch of records for compressing blocks on several threads.
+ *
+ * Big writes queue their blocks here instead of compressing them inline.  When
+ * the batch is full, or something needs the stream to be up to date, the blocks
+ * get compressed in parallel and all queued records are written to the stream
+ * in the order they were queued.
+ */
+typedef struct SSMZIPBATCH
+{
+    /** The pool of compression threads. */
+    RTREQPOOL               hReqPool;
+    /** Number of slices a batch is split into (worker threads + the caller). */
+    uint32_t                cSlices;
+    /** Number of queued records. */
+    uint32_t                cEntries;
+    /** Number of entries in aEntries. */
+    uint32_t                cEntriesMax;
+    /** The queued records (variable size). */
+    SSMZIPENTRY             aEntries[RT_FLEXIBLE_ARRAY];
+} SSMZIPBATCH;
+/** Pointer to a compression batch. */
+typedef SSMZIPBATCH *PSSMZIPBATCH;
+
+
 /**
  * Handle structure.
  */
@@ -532,6 +603,10 @@ typedef struct SSMHANDLE
             uint32_t        cDirEntriesAlloced;
             /** SSMSTATE_OPEN_WRITE: The directory. */
             struct SSMFILEDIR *pDir;
+            /** Parallel compression batch, NULL if compressing inline. */
+            PSSMZIPBATCH    pZipBatch;
+            /** Set once creating pZipBatch was attempted. */
+            bool            fZipBatchTried;
         } Write;
 
         /** Read data. */
@@ -911,6 +986,7 @@ static int                  ssmR3StrmReadMore(PSSMSTRM pStrm);
 
 #ifndef SSM_STANDALONE
 static int                  ssmR3DataFlushBuffer(PSSMHANDLE pSSM);
+static int                  ssmR3DataZipBatchFlush(PSSMHANDLE pSSM);
 #endif
 static int                  ssmR3DataReadRecHdrV2(PSSMHANDLE pSSM);
 
@@ -1868,6 +1944,8 @@ static int ssmR3StrmInitInternal(PSSMSTRM pStrm, bool fChecksummed, uint32_t cBu
     pStrm->fChecksummed = fChecksummed;
     pStrm->u32StreamCRC = fChecksummed ? RTCrc32Start() : 0;
     pStrm->offStreamCRC = 0;
+    pStrm->u32ReadAheadCRC = pStrm->u32StreamCRC;
+    pStrm->offReadAheadCRC = 0;
 
     /*
      * Allocate the buffers.  Page align them in case that makes the kernel
@@ -2327,8 +2405,11 @@ static void ssmR3StrmFlushCurBuf(PSSMSTRM pStrm)
         else
         {
             uint32_t cb = pBuf->cb;
-            if (    pStrm->fChecksummed
-                &&  pStrm->offStreamCRC < cb)
+            if (!pStrm->fChecksummed)
+            { /* likely */ }
+            else if (pBuf->fStreamCRC)
+                pStrm->u32StreamCRC = pBuf->u32StreamCRC;
+            else if (pStrm->offStreamCRC < cb)
                 pStrm->u32StreamCRC = RTCrc32Process(pStrm->u32StreamCRC,
                                                      &pBuf->abData[pStrm->offStreamCRC],
                                                      cb - pStrm->offStreamCRC);
@@ -2668,6 +2749,21 @@ static int ssmR3StrmReadMore(PSSMSTRM pStrm)
     {
         pBuf->cb           = (uint32_t)cbRead;
         pBuf->fEndOfStream = false;
+
+        /* Checksum it here as this is usually the I/O thread, sparing the EMT. */
+        if (    pStrm->fChecksummed
+            &&  pStrm->offReadAheadCRC == pBuf->offStream)
+        {
+            pStrm->u32ReadAheadCRC  = RTCrc32Process(pStrm->u32ReadAheadCRC, &pBuf->abData[0], cbRead);
+            pStrm->offReadAheadCRC += cbRead;
+            pBuf->u32StreamCRC      = pStrm->u32ReadAheadCRC;
+            pBuf->fStreamCRC        = true;
+        }
+        else
+        {
+            pStrm->offReadAheadCRC  = UINT64_MAX;
+            pBuf->fStreamCRC        = false;
+        }
         Log6(("ssmR3StrmReadMore: %#010llx %#x\n", pBuf->offStream, pBuf->cb));
         ssmR3StrmPutBuf(pStrm, pBuf);
     }
@@ -2677,6 +2773,7 @@ static int ssmR3StrmReadMore(PSSMSTRM pStrm)
     {
         pBuf->cb           = 0;
         pBuf->fEndOfStream = true;
+        pBuf->fStreamCRC   = false;
         Log6(("ssmR3StrmReadMore: %#010llx 0 EOF!\n", pBuf->offStream));
         ssmR3StrmPutBuf(pStrm, pBuf);
         rc = VINF_EOF;
@@ -2936,6 +3033,8 @@ static int ssmR3StrmSeek(PSSMSTRM pStrm, int64_t off, uint32_t uMethod, uint32_t
         pStrm->offStreamCRC = 0;
         if (pStrm->fChecksummed)
             pStrm->u32StreamCRC = u32CurCRC;
+        pStrm->u32ReadAheadCRC = u32CurCRC;
+        pStrm->offReadAheadCRC = offStream;
         if (pStrm->pCur)
         {
             ssmR3StrmPutFreeBuf(pStrm, pStrm->pCur);
@@ -3349,6 +3448,16 @@ static int ssmR3DataWriteRaw(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
     if (RT_FAILURE(pSSM->rc))
         return pSSM->rc;
 
+    /*
+     * Queued records go first.
+     */
+    if (pSSM->u.Write.pZipBatch && pSSM->u.Write.pZipBatch->cEntries)
+    {
+        int rc = ssmR3DataZipBatchFlush(pSSM);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
     /*
      * Write the data item in 1MB chunks for progress indicator reasons.
      */
@@ -3368,64 +3477,82 @@ static int ssmR3DataWriteRaw(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
 
 
 /**
- * Writes a record header for the specified amount of data.
+ * Encodes a record header for the specified amount of data.
  *
- * @returns VBox status code. Sets pSSM->rc on failure.
- * @param   pSSM            The saved state handle
+ * @returns The size of the header, 0 if @a cb is too big.
+ * @param   pabHdr          Where to store the header, at least 8 bytes.
  * @param   cb              The amount of data.
  * @param   u8TypeAndFlags  The record type and flags.
  */
-static int ssmR3DataWriteRecHdr(PSSMHANDLE pSSM, size_t cb, uint8_t u8TypeAndFlags)
+static size_t ssmR3DataEncodeRecHdr(uint8_t *pabHdr, size_t cb, uint8_t u8TypeAndFlags)
 {
-    size_t  cbHdr;
-    uint8_t abHdr[8];
-    abHdr[0] = u8TypeAndFlags;
+    size_t cbHdr;
+    pabHdr[0] = u8TypeAndFlags;
     if (cb < 0x80)
     {
         cbHdr = 2;
-        abHdr[1] = (uint8_t)cb;
+        pabHdr[1] = (uint8_t)cb;
     }
     else if (cb < 0x00000800)
     {
         cbHdr = 3;
-        abHdr[1] = (uint8_t)(0xc0 | (cb >> 6));
-        abHdr[2] = (uint8_t)(0x80 | (cb & 0x3f));
+        pabHdr[1] = (uint8_t)(0xc0 | (cb >> 6));
+        pabHdr[2] = (uint8_t)(0x80 | (cb & 0x3f));
     }
     else if (cb < 0x00010000)
     {
         cbHdr = 4;
-        abHdr[1] = (uint8_t)(0xe0 | (cb >> 12));
-        abHdr[2] = (uint8_t)(0x80 | ((cb >> 6) & 0x3f));
-        abHdr[3] = (uint8_t)(0x80 | (cb & 0x3f));
+        pabHdr[1] = (uint8_t)(0xe0 | (cb >> 12));
+        pabHdr[2] = (uint8_t)(0x80 | ((cb >> 6) & 0x3f));
+        pabHdr[3] = (uint8_t)(0x80 | (cb & 0x3f));
     }
     else if (cb < 0x00200000)
     {
         cbHdr = 5;
-        abHdr[1] = (uint8_t)(0xf0 |  (cb >> 18));
-        abHdr[2] = (uint8_t)(0x80 | ((cb >> 12) & 0x3f));
-        abHdr[3] = (uint8_t)(0x80 | ((cb >>  6) & 0x3f));
-        abHdr[4] = (uint8_t)(0x80 |  (cb        & 0x3f));
+        pabHdr[1] = (uint8_t)(0xf0 |  (cb >> 18));
+        pabHdr[2] = (uint8_t)(0x80 | ((cb >> 12) & 0x3f));
+        pabHdr[3] = (uint8_t)(0x80 | ((cb >>  6) & 0x3f));
+        pabHdr[4] = (uint8_t)(0x80 |  (cb        & 0x3f));
     }
     else if (cb < 0x04000000)
     {
         cbHdr = 6;
-        abHdr[1] = (uint8_t)(0xf8 |  (cb >> 24));
-        abHdr[2] = (uint8_t)(0x80 | ((cb >> 18) & 0x3f));
-        abHdr[3] = (uint8_t)(0x80 | ((cb >> 12) & 0x3f));
-        abHdr[4] = (uint8_t)(0x80 | ((cb >>  6) & 0x3f));
-        abHdr[5] = (uint8_t)(0x80 |  (cb        & 0x3f));
+        pabHdr[1] = (uint8_t)(0xf8 |  (cb >> 24));
+        pabHdr[2] = (uint8_t)(0x80 | ((cb >> 18) & 0x3f));
+        pabHdr[3] = (uint8_t)(0x80 | ((cb >> 12) & 0x3f));
+        pabHdr[4] = (uint8_t)(0x80 | ((cb >>  6) & 0x3f));
+        pabHdr[5] = (uint8_t)(0x80 |  (cb        & 0x3f));
     }
     else if (cb <= 0x7fffffff)
     {
         cbHdr = 7;
-        abHdr[1] = (uint8_t)(0xfc |  (cb >> 30));
-        abHdr[2] = (uint8_t)(0x80 | ((cb >> 24) & 0x3f));
-        abHdr[3] = (uint8_t)(0x80 | ((cb >> 18) & 0x3f));
-        abHdr[4] = (uint8_t)(0x80 | ((cb >> 12) & 0x3f));
-        abHdr[5] = (uint8_t)(0x80 | ((cb >>  6) & 0x3f));
-        abHdr[6] = (uint8_t)(0x80 | (cb & 0x3f));
+        pabHdr[1] = (uint8_t)(0xfc |  (cb >> 30));
+        pabHdr[2] = (uint8_t)(0x80 | ((cb >> 24) & 0x3f));
+        pabHdr[3] = (uint8_t)(0x80 | ((cb >> 18) & 0x3f));
+        pabHdr[4] = (uint8_t)(0x80 | ((cb >> 12) & 0x3f));
+        pabHdr[5] = (uint8_t)(0x80 | ((cb >>  6) & 0x3f));
+        pabHdr[6] = (uint8_t)(0x80 | (cb & 0x3f));
     }
     else
+        cbHdr = 0;
+
+    return cbHdr;
+}
+
+
+/**
+ * Writes a record header for the specified amount of data.
+ *
+ * @returns VBox status code. Sets pSSM->rc on failure.
+ * @param   pSSM            The saved state handle
+ * @param   cb              The amount of data.
+ * @param   u8TypeAndFlags  The record type and flags.
+ */
+static int ssmR3DataWriteRecHdr(PSSMHANDLE pSSM, size_t cb, uint8_t u8TypeAndFlags)
+{
+    uint8_t abHdr[8];
+    size_t  cbHdr = ssmR3DataEncodeRecHdr(&abHdr[0], cb, u8TypeAndFlags);
+    if (!cbHdr)
         AssertLogRelMsgFailedReturn(("cb=%#x\n", cb), pSSM->rc = VERR_SSM_MEM_TOO_BIG);
 
     Log3(("ssmR3DataWriteRecHdr: %08llx|%08llx/%08x: Type=%02x fImportant=%RTbool cbHdr=%u\n",
@@ -3436,12 +3563,225 @@ static int ssmR3DataWriteRecHdr(PSSMHANDLE pSSM, size_t cb, uint8_t u8TypeAndFla
 
 
 /**
- * Worker that flushes the buffered data.
+ * Compresses one block into a record.
+ *
+ * Falls back on a raw record if the block doesn't compress.
+ *
+ * @returns The size of the record.
+ * @param   pvBlock         The block, SSM_ZIP_BLOCK_SIZE bytes.
+ * @param   pbRec           Where to store the record, SSM_ZIP_BLOCK_REC_MAX bytes.
+ */
+static size_t ssmR3DataCompressBlock(const void *pvBlock, uint8_t *pbRec)
+{
+    AssertCompile(SSM_ZIP_BLOCK_REC_MAX < 0x00010000);
+    size_t cbRec = SSM_ZIP_BLOCK_SIZE - (SSM_ZIP_BLOCK_SIZE / 16);
+    int rc = RTZipBlockCompress(RTZIPTYPE_LZF, RTZIPLEVEL_FAST, 0 /*fFlags*/,
+                                pvBlock, SSM_ZIP_BLOCK_SIZE,
+                                pbRec + 1 + 3 + 1, cbRec, &cbRec);
+    if (RT_SUCCESS(rc))
+    {
+        pbRec[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_LZF;
+        pbRec[4] = SSM_ZIP_BLOCK_SIZE / _1K;
+        cbRec += 1;
+    }
+    else
+    {
+        pbRec[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW;
+        memcpy(&pbRec[4], pvBlock, SSM_ZIP_BLOCK_SIZE);
+        cbRec = SSM_ZIP_BLOCK_SIZE;
+    }
+    pbRec[1] = (uint8_t)(0xe0 | ( cbRec >> 12));
+    pbRec[2] = (uint8_t)(0x80 | ((cbRec >>  6) & 0x3f));
+    pbRec[3] = (uint8_t)(0x80 | ( cbRec        & 0x3f));
+    return cbRec + 1 + 3;
+}
+
+
+/**
+ * Creates the parallel compression batch if there are CPUs to spare.
+ *
+ * @returns Pointer to the batch, NULL if compressing inline.
+ * @param   pSSM            The saved state handle.
+ */
+static PSSMZIPBATCH ssmR3DataZipBatchGet(PSSMHANDLE pSSM)
+{
+    if (pSSM->u.Write.pZipBatch || pSSM->u.Write.fZipBatchTried)
+        return pSSM->u.Write.pZipBatch;
+    pSSM->u.Write.fZipBatchTried = true;
+
+    uint32_t const cCpus = RTMpGetOnlineCount();
+    if (cCpus <= 1)
+        return NULL;
+    uint32_t const cThreads    = RT_MIN(cCpus - 1, SSM_ZIP_BATCH_THREADS_MAX);
+    uint32_t const cEntriesMax = (cThreads + 1) * SSM_ZIP_BATCH_BLOCKS_PER_THREAD;
+
+    PSSMZIPBATCH pBatch = (PSSMZIPBATCH)RTMemAlloc(RT_UOFFSETOF_DYN(SSMZIPBATCH, aEntries[cEntriesMax]));
+    if (!pBatch)
+        return NULL;
+    pBatch->cSlices     = cThreads + 1;
+    pBatch->cEntries    = 0;
+    pBatch->cEntriesMax = cEntriesMax;
+    int rc = RTReqPoolCreate(cThreads, RT_MS_10SEC /*cMsMinIdle*/, UINT32_MAX /*cThreadsPushBackThreshold*/,
+                             0 /*cMsMaxPushBack*/, "SSMZip", &pBatch->hReqPool);
+    if (RT_FAILURE(rc))
+    {
+        LogRel(("SSM: Failed to create compression threads, compressing inline: %Rrc\n", rc));
+        RTMemFree(pBatch);
+        return NULL;
+    }
+
+    LogRel(("SSM: Compressing on %u threads\n", pBatch->cSlices));
+    pSSM->u.Write.pZipBatch = pBatch;
+    return pBatch;
+}
+
+
+/**
+ * Destroys the parallel compression batch, dropping anything still queued.
+ *
+ * @param   pSSM            The saved state handle.
+ */
+static void ssmR3DataZipBatchDestroy(PSSMHANDLE pSSM)
+{
+    PSSMZIPBATCH pBatch = pSSM->u.Write.pZipBatch;
+    if (pBatch)
+    {
+        pSSM->u.Write.pZipBatch = NULL;
+        RTReqPoolRelease(pBatch->hReqPool);
+        RTMemFree(pBatch);
+    }
+}
+
+
+/**
+ * Compression thread worker, compresses a slice of the queued blocks.
+ *
+ * @returns VINF_SUCCESS.
+ * @param   paEntries       The first entry of the slice.
+ * @param   cEntries        Number of entries in the slice.
+ */
+static DECLCALLBACK(int) ssmR3DataZipBatchWorker(PSSMZIPENTRY paEntries, uint32_t cEntries)
+{
+    for (uint32_t i = 0; i < cEntries; i++)
+        if (paEntries[i].fCompress)
+            paEntries[i].cbRec = (uint32_t)ssmR3DataCompressBlock(&paEntries[i].abIn[0], &paEntries[i].abRec[0]);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Compresses the queued blocks in parallel and writes all queued records to
+ * the stream in the order they were queued.
+ *
+ * @returns VBox status code.
+ * @param   pSSM            The saved state handle.
+ */
+static int ssmR3DataZipBatchFlush(PSSMHANDLE pSSM)
+{
+    PSSMZIPBATCH pBatch = pSSM->u.Write.pZipBatch;
+    if (!pBatch || !pBatch->cEntries)
+        return VINF_SUCCESS;
+    uint32_t const cEntries = pBatch->cEntries;
+    pBatch->cEntries = 0;
+
+    /*
+     * Hand all slices but the first to the pool, doing the first one ourselves.
+     */
+    uint32_t const cPerSlice = (cEntries + pBatch->cSlices - 1) / pBatch->cSlices;
+    RTREQ         *ahReqs[SSM_ZIP_BATCH_THREADS_MAX];
+    uint32_t       cReqs = 0;
+    for (uint32_t iFirst = cPerSlice; iFirst < cEntries; iFirst += cPerSlice)
+    {
+        uint32_t const cThis = RT_MIN(cPerSlice, cEntries - iFirst);
+        Assert(cReqs < RT_ELEMENTS(ahReqs));
+        int rc = RTReqPoolCallEx(pBatch->hReqPool, 0 /*cMillies*/, &ahReqs[cReqs],
+                                 RTREQFLAGS_IPRT_STATUS | RTREQFLAGS_NO_WAIT,
+                                 (PFNRT)ssmR3DataZipBatchWorker, 2, &pBatch->aEntries[iFirst], cThis);
+        if (RT_SUCCESS(rc))
+            cReqs++;
+        else
+            ssmR3DataZipBatchWorker(&pBatch->aEntries[iFirst], cThis);
+    }
+    ssmR3DataZipBatchWorker(&pBatch->aEntries[0], RT_MIN(cPerSlice, cEntries));
+
+    for (uint32_t i = 0; i < cReqs; i++)
+    {
+        int rc = RTReqWait(ahReqs[i], RT_INDEFINITE_WAIT);
+        AssertRC(rc);
+        RTReqRelease(ahReqs[i]);
+    }
+
+    /*
+     * Write out the records.
+     */
+    for (uint32_t i = 0; i < cEntries; i++)
+    {
+        int rc = ssmR3StrmWrite(&pSSM->Strm, &pBatch->aEntries[i].abRec[0], pBatch->aEntries[i].cbRec);
+        if (RT_FAILURE(rc))
+            return rc;
+        pSSM->offUnit += pBatch->aEntries[i].cbRec;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Queues a block for compression in the batch.
+ *
+ * @returns VBox status code.
+ * @param   pSSM            The saved state handle.
+ * @param   pBatch          The compression batch.
+ * @param   pvBlock         The block, SSM_ZIP_BLOCK_SIZE bytes.  Copied.
+ */
+static int ssmR3DataZipBatchAddBlock(PSSMHANDLE pSSM, PSSMZIPBATCH pBatch, const void *pvBlock)
+{
+    PSSMZIPENTRY pEntry = &pBatch->aEntries[pBatch->cEntries++];
+    pEntry->fCompress = true;
+    pEntry->cbRec     = 0;
+    memcpy(&pEntry->abIn[0], pvBlock, SSM_ZIP_BLOCK_SIZE);
+
+    if (pBatch->cEntries >= pBatch->cEntriesMax)
+        return ssmR3DataZipBatchFlush(pSSM);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Queues a ready record in the batch, keeping it in order with the blocks.
+ *
+ * @returns VBox status code.
+ * @param   pSSM            The saved state handle.
+ * @param   pBatch          The compression batch.
+ * @param   u8TypeAndFlags  The record type and flags.
+ * @param   pvData          The record data.
+ * @param   cbData          The size of the record data, less than
+ *                          SSM_ZIP_BLOCK_REC_MAX minus the header.
+ */
+static int ssmR3DataZipBatchAddRec(PSSMHANDLE pSSM, PSSMZIPBATCH pBatch, uint8_t u8TypeAndFlags,
+                                   const void *pvData, size_t cbData)
+{
+    PSSMZIPENTRY pEntry = &pBatch->aEntries[pBatch->cEntries];
+    size_t const cbHdr  = ssmR3DataEncodeRecHdr(&pEntry->abRec[0], cbData, u8TypeAndFlags);
+    AssertReturn(cbHdr && cbHdr + cbData <= sizeof(pEntry->abRec), pSSM->rc = VERR_SSM_IPE_2);
+    memcpy(&pEntry->abRec[cbHdr], pvData, cbData);
+    pEntry->fCompress = false;
+    pEntry->cbRec     = (uint32_t)(cbHdr + cbData);
+    pBatch->cEntries++;
+
+    if (pBatch->cEntries >= pBatch->cEntriesMax)
+        return ssmR3DataZipBatchFlush(pSSM);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Worker that writes the buffered data as a record, or queues it in the
+ * compression batch if that has records pending.
  *
  * @returns VBox status code. Will set pSSM->rc on error.
  * @param   pSSM            The saved state handle.
  */
-static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
+static int ssmR3DataQueueBuffer(PSSMHANDLE pSSM)
 {
     /*
      * Check how much there current is in the buffer.
@@ -3451,19 +3791,42 @@ static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
         return pSSM->rc;
     pSSM->u.Write.offDataBuffer = 0;
 
-    /*
-     * Write a record header and then the data.
-     * (No need for fancy optimizations here any longer since the stream is
-     * fully buffered.)
-     */
-    int rc = ssmR3DataWriteRecHdr(pSSM, cb, SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW);
-    if (RT_SUCCESS(rc))
-        rc = ssmR3DataWriteRaw(pSSM, pSSM->u.Write.abDataBuffer, cb);
+    int rc;
+    PSSMZIPBATCH pBatch = pSSM->u.Write.pZipBatch;
+    if (pBatch && pBatch->cEntries)
+        rc = ssmR3DataZipBatchAddRec(pSSM, pBatch, SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW,
+                                     pSSM->u.Write.abDataBuffer, cb);
+    else
+    {
+        /*
+         * Write a record header and then the data.
+         * (No need for fancy optimizations here any longer since the stream is
+         * fully buffered.)
+         */
+        rc = ssmR3DataWriteRecHdr(pSSM, cb, SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW);
+        if (RT_SUCCESS(rc))
+            rc = ssmR3DataWriteRaw(pSSM, pSSM->u.Write.abDataBuffer, cb);
+    }
     ssmR3ProgressByByte(pSSM, cb);
     return rc;
 }
 
 
+/**
+ * Worker that flushes the buffered data and anything queued for compression.
+ *
+ * @returns VBox status code. Will set pSSM->rc on error.
+ * @param   pSSM            The saved state handle.
+ */
+static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
+{
+    int rc = ssmR3DataQueueBuffer(pSSM);
+    if (RT_SUCCESS(rc))
+        rc = ssmR3DataZipBatchFlush(pSSM);
+    return rc;
+}
+
+
 /**
  * ssmR3DataWrite worker that writes big stuff.
  *
@@ -3474,7 +3837,7 @@ static int ssmR3DataFlushBuffer(PSSMHANDLE pSSM)
  */
 static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
 {
-    int rc = ssmR3DataFlushBuffer(pSSM);
+    int rc = ssmR3DataQueueBuffer(pSSM);
     if (RT_SUCCESS(rc))
     {
         pSSM->offUnitUser += cbBuf;
@@ -3482,6 +3845,7 @@ static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
         /*
          * Split it up into compression blocks.
          */
+        PSSMZIPBATCH pBatch = cbBuf >= SSM_ZIP_BLOCK_SIZE ? ssmR3DataZipBatchGet(pSSM) : pSSM->u.Write.pZipBatch;
         for (;;)
         {
             if (    cbBuf >= SSM_ZIP_BLOCK_SIZE
@@ -3490,38 +3854,27 @@ static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
                )
             {
                 /*
-                 * Compress it.
+                 * Compress it, either on the worker threads or right here.
                  */
-                AssertCompile(1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE < 0x00010000);
-                uint8_t *pb;
-                rc = ssmR3StrmReserveWriteBufferSpace(&pSSM->Strm, 1 + 3 + 1 + SSM_ZIP_BLOCK_SIZE, &pb);
-                if (RT_FAILURE(rc))
-                    break;
-                size_t cbRec = SSM_ZIP_BLOCK_SIZE - (SSM_ZIP_BLOCK_SIZE / 16);
-                rc = RTZipBlockCompress(RTZIPTYPE_LZF, RTZIPLEVEL_FAST, 0 /*fFlags*/,
-                                        pvBuf, SSM_ZIP_BLOCK_SIZE,
-                                        pb + 1 + 3 + 1, cbRec, &cbRec);
-                if (RT_SUCCESS(rc))
+                if (pBatch)
                 {
-                    pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_LZF;
-                    pb[4] = SSM_ZIP_BLOCK_SIZE / _1K;
-                    cbRec += 1;
+                    rc = ssmR3DataZipBatchAddBlock(pSSM, pBatch, pvBuf);
+                    if (RT_FAILURE(rc))
+                        break;
                 }
                 else
                 {
-                    pb[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW;
-                    memcpy(&pb[4], pvBuf, SSM_ZIP_BLOCK_SIZE);
-                    cbRec = SSM_ZIP_BLOCK_SIZE;
-                }
-                pb[1] = (uint8_t)(0xe0 | ( cbRec >> 12));
-                pb[2] = (uint8_t)(0x80 | ((cbRec >>  6) & 0x3f));
-                pb[3] = (uint8_t)(0x80 | ( cbRec        & 0x3f));
-                cbRec += 1 + 3;
-                rc = ssmR3StrmCommitWriteBufferSpace(&pSSM->Strm, cbRec);
-                if (RT_FAILURE(rc))
-                    break;
+                    uint8_t *pb;
+                    rc = ssmR3StrmReserveWriteBufferSpace(&pSSM->Strm, SSM_ZIP_BLOCK_REC_MAX, &pb);
+                    if (RT_FAILURE(rc))
+                        break;
+                    size_t const cbRec = ssmR3DataCompressBlock(pvBuf, pb);
+                    rc = ssmR3StrmCommitWriteBufferSpace(&pSSM->Strm, cbRec);
+                    if (RT_FAILURE(rc))
+                        break;
 
-                pSSM->offUnit += cbRec;
+                    pSSM->offUnit += cbRec;
+                }
                 ssmR3ProgressByByte(pSSM, SSM_ZIP_BLOCK_SIZE);
 
                 /* advance */
@@ -3535,12 +3888,21 @@ static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
                 /*
                  * Zero block.
                  */
-                uint8_t abRec[3];
-                abRec[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_ZERO;
-                abRec[1] = 1;
-                abRec[2] = SSM_ZIP_BLOCK_SIZE / _1K;
-                Log3(("ssmR3DataWriteBig: %08llx|%08llx/%08x: ZERO\n", ssmR3StrmTell(&pSSM->Strm) + 2, pSSM->offUnit + 2, 1));
-                rc = ssmR3DataWriteRaw(pSSM, &abRec[0], sizeof(abRec));
+                if (pBatch && pBatch->cEntries)
+                {
+                    uint8_t const bSize = SSM_ZIP_BLOCK_SIZE / _1K;
+                    rc = ssmR3DataZipBatchAddRec(pSSM, pBatch, SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_ZERO,
+                                                 &bSize, sizeof(bSize));
+                }
+                else
+                {
+                    uint8_t abRec[3];
+                    abRec[0] = SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW_ZERO;
+                    abRec[1] = 1;
+                    abRec[2] = SSM_ZIP_BLOCK_SIZE / _1K;
+                    Log3(("ssmR3DataWriteBig: %08llx|%08llx/%08x: ZERO\n", ssmR3StrmTell(&pSSM->Strm) + 2, pSSM->offUnit + 2, 1));
+                    rc = ssmR3DataWriteRaw(pSSM, &abRec[0], sizeof(abRec));
+                }
                 if (RT_FAILURE(rc))
                     break;
 
@@ -3556,9 +3918,15 @@ static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
                 /*
                  * Less than one block left, store it the simple way.
                  */
-                rc = ssmR3DataWriteRecHdr(pSSM, cbBuf, SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW);
-                if (RT_SUCCESS(rc))
-                    rc = ssmR3DataWriteRaw(pSSM, pvBuf, cbBuf);
+                if (pBatch && pBatch->cEntries)
+                    rc = ssmR3DataZipBatchAddRec(pSSM, pBatch, SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW,
+                                                 pvBuf, cbBuf);
+                else
+                {
+                    rc = ssmR3DataWriteRecHdr(pSSM, cbBuf, SSM_REC_FLAGS_FIXED | SSM_REC_FLAGS_IMPORTANT | SSM_REC_TYPE_RAW);
+                    if (RT_SUCCESS(rc))
+                        rc = ssmR3DataWriteRaw(pSSM, pvBuf, cbBuf);
+                }
                 ssmR3ProgressByByte(pSSM, cbBuf);
                 break;
             }
@@ -3581,7 +3949,7 @@ static int ssmR3DataWriteBig(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
  */
 static int ssmR3DataWriteFlushAndBuffer(PSSMHANDLE pSSM, const void *pvBuf, size_t cbBuf)
 {
-    int rc = ssmR3DataFlushBuffer(pSSM);
+    int rc = ssmR3DataQueueBuffer(pSSM);
     if (RT_SUCCESS(rc))
     {
         memcpy(&pSSM->u.Write.abDataBuffer[0], pvBuf, cbBuf);
@@ -3651,8 +4019,19 @@ VMMR3DECL(int) SSMR3PutStruct(PSSMHANDLE pSSM, const void *pvStruct, PCSSMFIELD
         switch ((uintptr_t)pCur->pfnGetPutOrTransformer)
         {
             case SSMFIELDTRANS_NO_TRANSFORMATION:
-                rc = ssmR3DataWrite(pSSM, pbField, pCur->cb);
+            {
+                /* Coalesce a run of adjacent untransformed fields into a single write. */
+                uint32_t cbRun = pCur->cb;
+                while (   (uintptr_t)pCur[1].pfnGetPutOrTransformer == SSMFIELDTRANS_NO_TRANSFORMATION
+                       && pCur[1].cb  != UINT32_MAX
+                       && pCur[1].off == pCur->off + pCur->cb)
+                {
+                    pCur++;
+                    cbRun += pCur->cb;
+                }
+                rc = ssmR3DataWrite(pSSM, pbField, cbRun);
                 break;
+            }
 
             case SSMFIELDTRANS_GCPTR:
                 AssertMsgBreakStmt(pCur->cb == sizeof(RTGCPTR), ("%#x (%s)\n", pCur->cb, pCur->pszName), rc = VERR_SSM_FIELD_INVALID_SIZE);
@@ -4603,6 +4982,7 @@ static int ssmR3SaveDoClose(PVM pVM, PSSMHANDLE pSSM)
      * Make it non-cancellable, close the stream and delete the file on failure.
      */
     ssmR3SetCancellable(pVM, pSSM, false);
+    ssmR3DataZipBatchDestroy(pSSM);
     int rc = ssmR3StrmClose(&pSSM->Strm, pSSM->rc == VERR_SSM_CANCELLED);
     if (RT_SUCCESS(rc))
         rc = pSSM->rc;
@@ -5808,8 +6188,12 @@ static int ssmR3LiveDoExecRun(PVM pVM, PSSMHANDLE pSSM, uint32_t uPass)
  * @returns VBox status code (no need to check pSSM->rc).
  * @param   pVM                 The cross context VM structure.
  * @param   pSSM                The saved state handle.
+ * @param   uAutoConvergeMinCap The lowest CPU execution cap auto-converge may
+ *                              throttle the guest down to, 0 if disabled.
+ * @param   puCapThrottled      Where to return the CPU execution cap set by
+ *                              auto-converge last, 0 if it didn't change it.
  */
-static int ssmR3DoLiveExecVoteLoop(PVM pVM, PSSMHANDLE pSSM)
+static int ssmR3DoLiveExecVoteLoop(PVM pVM, PSSMHANDLE pSSM, uint32_t uAutoConvergeMinCap, uint32_t *puCapThrottled)
 {
     /*
      * Calc the max saved state size before we should give up because of insane
@@ -5867,6 +6251,32 @@ static int ssmR3DoLiveExecVoteLoop(PVM pVM, PSSMHANDLE pSSM)
         rc = ssmR3StrmCheckAndFlush(&pSSM->Strm);
         if (RT_FAILURE(rc))
             return pSSM->rc = rc;
+
+        /*
+         * Auto-converge: If the guest keeps dirtying memory faster than we can
+         * save it, cut its CPU time in steps so the passes can catch up.
+         */
+        if (   uAutoConvergeMinCap
+            && uPass >= SSM_AUTO_CONVERGE_FIRST_PASS
+            && (uPass - SSM_AUTO_CONVERGE_FIRST_PASS) % SSM_AUTO_CONVERGE_INTERVAL == 0)
+        {
+            uint32_t const uCapOld = ASMAtomicReadU32(&pVM->uCpuExecutionCap);
+            uint32_t const uCapNew = uCapOld > uAutoConvergeMinCap + SSM_AUTO_CONVERGE_STEP
+                                   ? uCapOld - SSM_AUTO_CONVERGE_STEP : uAutoConvergeMinCap;
+            if (*puCapThrottled && uCapOld != *puCapThrottled)
+            {
+                /* Somebody else changed the cap meanwhile, leave it alone from now on. */
+                LogRel(("SSM: Auto-converge: CPU execution cap changed to %u%%, stopping (pass=%u)\n", uCapOld, uPass));
+                uAutoConvergeMinCap = 0;
+                *puCapThrottled     = 0;
+            }
+            else if (   uCapNew < uCapOld
+                     && ASMAtomicCmpXchgU32(&pVM->uCpuExecutionCap, uCapNew, uCapOld))
+            {
+                LogRel(("SSM: Auto-converge: Throttling CPU execution cap from %u%% to %u%% (pass=%u)\n", uCapOld, uCapNew, uPass));
+                *puCapThrottled = uCapNew;
+            }
+        }
     }
 
     LogRel(("SSM: Giving up: Too many passes! (%u)\n", SSM_MAX_PASSES));
@@ -5970,12 +6380,28 @@ VMMR3_INT_DECL(int) SSMR3LiveDoStep1(PSSMHANDLE pSSM)
     AssertMsgReturn(pSSM->enmOp == SSMSTATE_LIVE_STEP1, ("%d\n", pSSM->enmOp), VERR_INVALID_STATE);
     AssertRCReturn(pSSM->rc, pSSM->rc);
 
+    /** @cfgm{/SSM/AutoConvergeMinCap, uint32_t, 0, 0, 100}
+     * The lowest CPU execution cap (in percent) the live save may throttle the
+     * guest down to when the pre-copy passes fail to converge.  Zero disables
+     * auto-converge.  The original cap is restored when the passes are done. */
+    uint32_t uAutoConvergeMinCap = 0;
+    int rc = CFGMR3QueryU32Def(CFGMR3GetChild(CFGMR3GetRoot(pVM), "SSM"), "AutoConvergeMinCap", &uAutoConvergeMinCap, 0);
+    AssertLogRelRCReturn(rc, rc);
+    AssertLogRelMsgReturn(uAutoConvergeMinCap <= 100, ("AutoConvergeMinCap=%u\n", uAutoConvergeMinCap), VERR_OUT_OF_RANGE);
+    uint32_t const uCapOrg = ASMAtomicReadU32(&pVM->uCpuExecutionCap);
+    uint32_t uCapThrottled = 0;
+
     /*
      * Do the prep run, then the exec+vote cycle.
      */
-    int rc = ssmR3DoLivePrepRun(pVM, pSSM);
+    rc = ssmR3DoLivePrepRun(pVM, pSSM);
     if (RT_SUCCESS(rc))
-        rc = ssmR3DoLiveExecVoteLoop(pVM, pSSM);
+        rc = ssmR3DoLiveExecVoteLoop(pVM, pSSM, uAutoConvergeMinCap, &uCapThrottled);
+
+    /* Only restore the cap if nobody else changed it while we were throttling. */
+    if (   uCapThrottled
+        && ASMAtomicCmpXchgU32(&pVM->uCpuExecutionCap, uCapOrg, uCapThrottled))
+        LogRel(("SSM: Auto-converge: Restoring CPU execution cap to %u%%\n", uCapOrg));
     return rc;
 }
 
@@ -6069,6 +6495,7 @@ VMMR3_INT_DECL(int) SSMR3LiveSave(PVM pVM, uint32_t cMsMaxDowntime,
         return VINF_SUCCESS;
     }
     /* bail out. */
+    ssmR3DataZipBatchDestroy(pSSM);
     int rc2 = ssmR3StrmClose(&pSSM->Strm, pSSM->rc == VERR_SSM_CANCELLED);
     RTMemFree(pSSM);
     rc2 = RTFileDelete(pszFilename);
@@ -6874,8 +7301,21 @@ VMMR3DECL(int) SSMR3GetStruct(PSSMHANDLE pSSM, void *pvStruct, PCSSMFIELD paFiel
             switch ((uintptr_t)pCur->pfnGetPutOrTransformer)
             {
                 case SSMFIELDTRANS_NO_TRANSFORMATION:
-                    rc = ssmR3DataRead(pSSM, pbField, pCur->cb);
+                {
+                    /* Coalesce a run of adjacent untransformed fields present in this
+                       unit version into a single read. */
+                    uint32_t cbRun = pCur->cb;
+                    while (   (uintptr_t)pCur[1].pfnGetPutOrTransformer == SSMFIELDTRANS_NO_TRANSFORMATION
+                           && pCur[1].cb  != UINT32_MAX
+                           && pCur[1].off == pCur->off + pCur->cb
+                           && pCur[1].uFirstVer <= pSSM->u.Read.uCurUnitVer)
+                    {
+                        pCur++;
+                        cbRun += pCur->cb;
+                    }
+                    rc = ssmR3DataRead(pSSM, pbField, cbRun);
                     break;
+                }
 
                 case SSMFIELDTRANS_GCPTR:
                     AssertMsgBreakStmt(pCur->cb == sizeof(RTGCPTR), ("%#x (%s)\n", pCur->cb, pCur->pszName), rc = VERR_SSM_FIELD_INVALID_SIZE);
@@ -9721,6 +10161,8 @@ VMMR3DECL(int) SSMR3Close(PSSMHANDLE pSSM)
     /*
      * Close the stream and free the handle.
      */
+    if (pSSM->enmOp == SSMSTATE_OPEN_WRITE)
+        ssmR3DataZipBatchDestroy(pSSM);
     int rc = ssmR3StrmClose(&pSSM->Strm, pSSM->rc == VERR_SSM_CANCELLED);
     if (pSSM->enmOp == SSMSTATE_OPEN_READ && pSSM->u.Read.pZipDecompV1)
     {
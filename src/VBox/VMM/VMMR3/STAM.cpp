@@ -737,6 +737,35 @@ static void stamR3SumRefresh(PSTAMSUMSAMPLE pSum)
 }
 
 
+/**
+ * Used by stamR3CountMatchesU to count the samples matching a pattern.
+ */
+static int stamR3CountEnumCallback(PSTAMDESC pDesc, void *pvArg)
+{
+    RT_NOREF(pDesc);
+    *(uint32_t *)pvArg += 1;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Counts the samples matching @a pszPat so that sum samples can be sized to
+ * fit, e.g. per-VCPU summands on VMs with many VCPUs.
+ *
+ * @returns Number of matching samples.
+ * @param   pUVM        Pointer to the user mode VM structure.
+ * @param   pszPat      The pattern to match.
+ *
+ * @remarks Caller must own the STAM lock.
+ */
+static uint32_t stamR3CountMatchesU(PUVM pUVM, const char *pszPat)
+{
+    uint32_t cMatches = 0;
+    stamR3EnumU(pUVM, pszPat, false /*fUpdateRing0*/, stamR3CountEnumCallback, &cMatches);
+    return cMatches;
+}
+
+
 /**
  * Used by STAMR3RegisterSumV to locate the samples to sum up.
  */
@@ -869,14 +898,20 @@ VMMR3DECL(int) STAMR3RegisterSumV(PUVM pUVM, STAMVISIBILITY enmVisibility, const
 
     /*
      * We have to resolve the summands before we continue with the actual registration.
+     * The summand array is sized after the number of matches, as per-VCPU summands
+     * can easily exceed any fixed guess.
      */
-    uint8_t const        cMaxSummands = 32;
+    STAM_LOCK_WR(pUVM);
+
+    uint8_t const        cMaxSummands = (uint8_t)RT_MIN(RT_MAX(stamR3CountMatchesU(pUVM, pszSummandPattern), 1), UINT8_MAX);
     PSTAMSUMSAMPLE const pSum = (PSTAMSUMSAMPLE)RTMemAllocZ(RT_UOFFSETOF_DYN(STAMSUMSAMPLE, apSummands[cMaxSummands]));
-    AssertReturn(pSum, VERR_NO_MEMORY);
+    if (!pSum)
+    {
+        STAM_UNLOCK_WR(pUVM);
+        return VERR_NO_MEMORY;
+    }
     pSum->cSummandsAlloc = cMaxSummands;
 
-    STAM_LOCK_WR(pUVM);
-
     int rc = stamR3EnumU(pUVM, pszSummandPattern, false /*fUpdateRing0*/, stamR3RegisterSumEnumCallback, pSum);
     if (RT_SUCCESS(rc))
     {
@@ -1226,18 +1261,23 @@ VMMR3DECL(int) STAMR3RegisterPctOfSumV(PUVM pUVM, STAMVISIBILITY enmVisibility,
 
     /*
      * We have to resolve the value and summands before we continue with the
-     * actual registration.  We reuse the STAMSUMSAMPLE structure here.
+     * actual registration.  We reuse the STAMSUMSAMPLE structure here and size
+     * it after the value plus the number of summand matches.
      */
-    uint8_t const        cMaxSummands = 32;
+    STAM_LOCK_WR(pUVM);
+
+    uint8_t const        cMaxSummands = (uint8_t)RT_MIN(stamR3CountMatchesU(pUVM, pszSummandPattern) + 1, UINT8_MAX);
     PSTAMSUMSAMPLE const pSum = (PSTAMSUMSAMPLE)RTMemAllocZ(RT_UOFFSETOF_DYN(STAMSUMSAMPLE, apSummands[cMaxSummands]));
-    AssertReturn(pSum, VERR_NO_MEMORY);
+    if (!pSum)
+    {
+        STAM_UNLOCK_WR(pUVM);
+        return VERR_NO_MEMORY;
+    }
     pSum->cSummandsAlloc = cMaxSummands;
     pSum->enmType        = STAMTYPE_COUNTER;
     pSum->enmUnit        = enmUnit;
     pSum->fAddValueToSum = fAddValueToSum;
 
-    STAM_LOCK_WR(pUVM);
-
     /* The first summand entry is the value. */
     int rc = stamR3EnumU(pUVM, pszValue, false /*fUpdateRing0*/, stamR3RegisterPctOfSumEnumCallbackForValue, pSum);
     if (RT_SUCCESS(rc))
@@ -177,6 +177,10 @@
 /** The current saved state version.*/
 #define TM_SAVED_STATE_VERSION  3
 
+/** Max number of busy critical sections tmR3TimerQueueRun keeps track of when
+ * deferring timers. */
+#define TM_RUN_MAX_BUSY_CRITSECTS   8
+
 
 /*********************************************************************************************************************************
 *   Internal Functions                                                                                                           *
@@ -2383,66 +2387,114 @@ static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
      *      arm the timer again.
      */
 /** @todo the above 'however' is outdated.   */
-    const uint64_t u64Now = tmClock(pVM, pQueue->enmClock);
-    while (pTimer->u64Expire <= u64Now)
+    /*
+     * A timer whose critical section is busy on another thread would hold up
+     * all the expired timers behind it.  So, the first round only try-enters,
+     * deferring such timers (and any later ones sharing the critical section,
+     * to keep their order) to a second round which waits like before.
+     */
+    const uint64_t  u64Now = tmClock(pVM, pQueue->enmClock);
+    PPDMCRITSECT    apBusy[TM_RUN_MAX_BUSY_CRITSECTS];
+    uint32_t        cBusy  = 0;
+    bool            fDefer = true;
+    for (;;)
     {
-        PTMTIMER const  pNext = tmTimerGetNext(pQueue, pTimer);
-        PPDMCRITSECT    pCritSect = pTimer->pCritSect;
-        if (pCritSect)
+        while (pTimer->u64Expire <= u64Now)
         {
-            STAM_PROFILE_START(&pTimer->StatCritSectEnter, Locking);
-            PDMCritSectEnter(pVM, pCritSect, VERR_IGNORED);
-            STAM_PROFILE_STOP(&pTimer->StatCritSectEnter, Locking);
-        }
-        Log2(("tmR3TimerQueueRun: %p:{.enmState=%s, .enmClock=%d, .enmType=%d, u64Expire=%llx (now=%llx) .szName='%s'}\n",
-              pTimer, tmTimerState(pTimer->enmState), pQueue->enmClock, pTimer->enmType, pTimer->u64Expire, u64Now, pTimer->szName));
-        bool fRc;
-        TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_GET_UNLINK, TMTIMERSTATE_ACTIVE, fRc);
-        if (fRc)
-        {
-            Assert(pTimer->idxScheduleNext == UINT32_MAX); /* this can trigger falsely */
-
-            /* unlink */
-            const PTMTIMER pPrev = tmTimerGetPrev(pQueue, pTimer);
-            if (pPrev)
-                tmTimerSetNext(pQueue, pPrev, pNext);
-            else
+            PTMTIMER const  pNext = tmTimerGetNext(pQueue, pTimer);
+            PPDMCRITSECT    pCritSect = pTimer->pCritSect;
+            if (pCritSect)
             {
-                tmTimerQueueSetHead(pQueue, pQueue, pNext);
-                pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
+                bool fEntered = false;
+                if (fDefer)
+                {
+                    bool fSkip = false;
+                    for (uint32_t i = 0; i < cBusy && !fSkip; i++)
+                        fSkip = apBusy[i] == pCritSect;
+                    if (!fSkip && cBusy < RT_ELEMENTS(apBusy))
+                    {
+                        if (RT_SUCCESS(PDMCritSectTryEnter(pVM, pCritSect)))
+                            fEntered = true;
+                        else
+                        {
+                            apBusy[cBusy++] = pCritSect;
+                            fSkip = true;
+                        }
+                    }
+                    if (fSkip)
+                    {
+                        Log2(("tmR3TimerQueueRun: %p:{.szName='%s'} deferred, critsect busy\n", pTimer, pTimer->szName));
+                        pTimer = pNext;
+                        if (!pTimer)
+                            break;
+                        continue;
+                    }
+                }
+                if (!fEntered)
+                {
+                    STAM_PROFILE_START(&pTimer->StatCritSectEnter, Locking);
+                    PDMCritSectEnter(pVM, pCritSect, VERR_IGNORED);
+                    STAM_PROFILE_STOP(&pTimer->StatCritSectEnter, Locking);
+                }
             }
-            if (pNext)
-                tmTimerSetPrev(pQueue, pNext, pPrev);
-            pTimer->idxNext = UINT32_MAX;
-            pTimer->idxPrev = UINT32_MAX;
-
-            /* fire */
-            TM_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_DELIVER);
-            STAM_PROFILE_START(&pTimer->StatTimer, PrfTimer);
-            switch (pTimer->enmType)
+            Log2(("tmR3TimerQueueRun: %p:{.enmState=%s, .enmClock=%d, .enmType=%d, u64Expire=%llx (now=%llx) .szName='%s'}\n",
+                  pTimer, tmTimerState(pTimer->enmState), pQueue->enmClock, pTimer->enmType, pTimer->u64Expire, u64Now, pTimer->szName));
+            bool fRc;
+            TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_GET_UNLINK, TMTIMERSTATE_ACTIVE, fRc);
+            if (fRc)
             {
-                case TMTIMERTYPE_DEV:       pTimer->u.Dev.pfnTimer(pTimer->u.Dev.pDevIns, pTimer->hSelf, pTimer->pvUser); break;
-                case TMTIMERTYPE_USB:       pTimer->u.Usb.pfnTimer(pTimer->u.Usb.pUsbIns, pTimer->hSelf, pTimer->pvUser); break;
-                case TMTIMERTYPE_DRV:       pTimer->u.Drv.pfnTimer(pTimer->u.Drv.pDrvIns, pTimer->hSelf, pTimer->pvUser); break;
-                case TMTIMERTYPE_INTERNAL:  pTimer->u.Internal.pfnTimer(pVM, pTimer->hSelf, pTimer->pvUser); break;
-                default:
-                    AssertMsgFailed(("Invalid timer type %d (%s)\n", pTimer->enmType, pTimer->szName));
-                    break;
+                Assert(pTimer->idxScheduleNext == UINT32_MAX); /* this can trigger falsely */
+
+                /* unlink */
+                const PTMTIMER pPrev = tmTimerGetPrev(pQueue, pTimer);
+                if (pPrev)
+                    tmTimerSetNext(pQueue, pPrev, pNext);
+                else
+                {
+                    tmTimerQueueSetHead(pQueue, pQueue, pNext);
+                    pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
+                }
+                if (pNext)
+                    tmTimerSetPrev(pQueue, pNext, pPrev);
+                pTimer->idxNext = UINT32_MAX;
+                pTimer->idxPrev = UINT32_MAX;
+
+                /* fire */
+                TM_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_DELIVER);
+                STAM_PROFILE_START(&pTimer->StatTimer, PrfTimer);
+                switch (pTimer->enmType)
+                {
+                    case TMTIMERTYPE_DEV:       pTimer->u.Dev.pfnTimer(pTimer->u.Dev.pDevIns, pTimer->hSelf, pTimer->pvUser); break;
+                    case TMTIMERTYPE_USB:       pTimer->u.Usb.pfnTimer(pTimer->u.Usb.pUsbIns, pTimer->hSelf, pTimer->pvUser); break;
+                    case TMTIMERTYPE_DRV:       pTimer->u.Drv.pfnTimer(pTimer->u.Drv.pDrvIns, pTimer->hSelf, pTimer->pvUser); break;
+                    case TMTIMERTYPE_INTERNAL:  pTimer->u.Internal.pfnTimer(pVM, pTimer->hSelf, pTimer->pvUser); break;
+                    default:
+                        AssertMsgFailed(("Invalid timer type %d (%s)\n", pTimer->enmType, pTimer->szName));
+                        break;
+                }
+                STAM_PROFILE_STOP(&pTimer->StatTimer, PrfTimer);
+
+                /* change the state if it wasn't changed already in the handler. */
+                TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_STOPPED, TMTIMERSTATE_EXPIRED_DELIVER, fRc);
+                Log2(("tmR3TimerQueueRun: new state %s\n", tmTimerState(pTimer->enmState)));
             }
-            STAM_PROFILE_STOP(&pTimer->StatTimer, PrfTimer);
+            if (pCritSect)
+                PDMCritSectLeave(pVM, pCritSect);
 
-            /* change the state if it wasn't changed already in the handler. */
-            TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_STOPPED, TMTIMERSTATE_EXPIRED_DELIVER, fRc);
-            Log2(("tmR3TimerQueueRun: new state %s\n", tmTimerState(pTimer->enmState)));
-        }
-        if (pCritSect)
-            PDMCritSectLeave(pVM, pCritSect);
+            /* Advance? */
+            pTimer = pNext;
+            if (!pTimer)
+                break;
+        } /* run loop */
 
-        /* Advance? */
-        pTimer = pNext;
+        /* Second round for the deferred timers, now waiting for the locks. */
+        if (!fDefer || !cBusy)
+            break;
+        fDefer = false;
+        pTimer = tmTimerQueueGetHead(pQueue, pQueue);
         if (!pTimer)
             break;
-    } /* run loop */
+    }
 }
 
 
@@ -92,6 +92,7 @@
 #include <iprt/asm.h>
 #include <iprt/env.h>
 #include <iprt/mem.h>
+#include <iprt/mp.h>
 #include <iprt/semaphore.h>
 #include <iprt/string.h>
 #ifdef RT_OS_DARWIN
@@ -109,6 +110,7 @@ static int                  vmR3CreateUVM(uint32_t cCpus, PCVMM2USERMETHODS pVmm
 static DECLCALLBACK(int)    vmR3CreateU(PUVM pUVM, uint32_t cCpus, PFNCFGMCONSTRUCTOR pfnCFGMConstructor, void *pvUserCFGM);
 static int                  vmR3ReadBaseConfig(PVM pVM, PUVM pUVM, uint32_t cCpus);
 static int                  vmR3InitRing3(PVM pVM, PUVM pUVM);
+static int                  vmR3InitEmtPlacement(PVM pVM);
 static int                  vmR3InitRing0(PVM pVM);
 static int                  vmR3InitDoCompleted(PVM pVM, VMINITCOMPLETED enmWhat);
 static void                 vmR3DestroyUVM(PUVM pUVM, uint32_t cMilliesEMTWait);
@@ -790,6 +792,122 @@ static int vmR3ReadBaseConfig(PVM pVM, PUVM pUVM, uint32_t cCpus)
 }
 
 
+/**
+ * EMT worker for vmR3InitEmtPlacement that sets the affinity of the calling EMT.
+ *
+ * @returns VBox status code.
+ * @param   pVM         The cross context VM structure.
+ * @param   idCpu       The ID of the calling virtual CPU.
+ * @param   pCpuSet     The host CPUs the EMT may run on.
+ */
+static DECLCALLBACK(int) vmR3SetEmtAffinity(PVM pVM, VMCPUID idCpu, PCRTCPUSET pCpuSet)
+{
+    RT_NOREF(pVM);
+    int rc = RTThreadSetAffinity(pCpuSet);
+    if (RT_FAILURE(rc))
+        LogRel(("VM: Failed to set the host CPU affinity of EMT #%u: %Rrc\n", idCpu, rc));
+    return rc;
+}
+
+
+/**
+ * Returns the set index of the n-th online host CPU.
+ *
+ * @returns The CPU set index, -1 if there are not that many online CPUs.
+ * @param   pOnlineSet  The set of online host CPUs.
+ * @param   iNth        The zero based ordinal of the wanted CPU.
+ */
+static int vmR3GetNthOnlineCpuIndex(PCRTCPUSET pOnlineSet, uint32_t iNth)
+{
+    for (int iCpu = 0; iCpu < RTCPUSET_MAX_CPUS; iCpu++)
+        if (RTCpuSetIsMemberByIndex(pOnlineSet, iCpu))
+        {
+            if (!iNth)
+                return iCpu;
+            iNth--;
+        }
+    return -1;
+}
+
+
+/**
+ * Binds the EMTs to host CPUs according to the configured placement policy.
+ *
+ * This must be called after all the EMTs have been registered.
+ *
+ * @returns VBox status code.
+ * @param   pVM         The cross context VM structure.
+ */
+static int vmR3InitEmtPlacement(PVM pVM)
+{
+    PCFGMNODE const pRoot = CFGMR3GetRoot(pVM);
+
+    /** @cfgm{/EmtPlacement, string, none}
+     * How to place the EMTs on the host CPUs:
+     *      - "none": Leave the placement to the host scheduler.
+     *      - "exclusive": Bind each EMT to a host CPU of its own.
+     *      - "shared": Bind all EMTs to the same range of host CPUs, one CPU per
+     *        EMT, leaving the scheduling within that range to the host.
+     * The host CPUs are taken in order from the set of online CPUs, starting
+     * with /EmtFirstHostCpu. */
+    char szPlacement[32];
+    int rc = CFGMR3QueryStringDef(pRoot, "EmtPlacement", szPlacement, sizeof(szPlacement), "none");
+    AssertLogRelMsgRCReturn(rc, ("Configuration error: Querying \"EmtPlacement\" failed, rc=%Rrc\n", rc), rc);
+
+    bool fExclusive;
+    if (!RTStrICmp(szPlacement, "none"))
+        return VINF_SUCCESS;
+    if (!RTStrICmp(szPlacement, "exclusive"))
+        fExclusive = true;
+    else if (!RTStrICmp(szPlacement, "shared"))
+        fExclusive = false;
+    else
+        return VMSetError(pVM, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                          N_("Configuration error: Unknown \"EmtPlacement\" value '%s'"), szPlacement);
+
+    /** @cfgm{/EmtFirstHostCpu, uint32_t, 0}
+     * The ordinal of the first online host CPU used by /EmtPlacement. */
+    uint32_t iFirstHostCpu;
+    rc = CFGMR3QueryU32Def(pRoot, "EmtFirstHostCpu", &iFirstHostCpu, 0);
+    AssertLogRelMsgRCReturn(rc, ("Configuration error: Querying \"EmtFirstHostCpu\" failed, rc=%Rrc\n", rc), rc);
+
+    RTCPUSET OnlineSet;
+    RTMpGetOnlineSet(&OnlineSet);
+    uint32_t const cOnlineCpus = (uint32_t)RTCpuSetCount(&OnlineSet);
+    if (   iFirstHostCpu >= cOnlineCpus
+        || cOnlineCpus - iFirstHostCpu < pVM->cCpus)
+        return VMSetError(pVM, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                          N_("The EMT placement needs %u host CPUs starting at #%u but only %u host CPUs are online"),
+                          pVM->cCpus, iFirstHostCpu, cOnlineCpus);
+
+    RTCPUSET SharedSet;
+    RTCpuSetEmpty(&SharedSet);
+    if (!fExclusive)
+        for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+            RTCpuSetAddByIndex(&SharedSet, vmR3GetNthOnlineCpuIndex(&OnlineSet, iFirstHostCpu + idCpu));
+
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        RTCPUSET CpuSet;
+        int const iHostCpu = vmR3GetNthOnlineCpuIndex(&OnlineSet, iFirstHostCpu + idCpu);
+        if (fExclusive)
+        {
+            RTCpuSetEmpty(&CpuSet);
+            RTCpuSetAddByIndex(&CpuSet, iHostCpu);
+        }
+        else
+            CpuSet = SharedSet;
+
+        rc = VMR3ReqCallWait(pVM, idCpu, (PFNRT)vmR3SetEmtAffinity, 3, pVM, idCpu, &CpuSet);
+        if (RT_FAILURE(rc))
+            return VMSetError(pVM, rc, RT_SRC_POS, N_("Failed to bind EMT #%u to host CPU set index %d"), idCpu, iHostCpu);
+        LogRel(("VM: EMT #%u bound to host CPU set index %d%s\n", idCpu, iHostCpu, fExclusive ? "" : " (shared)"));
+    }
+
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Initializes all R3 components of the VM
  */
@@ -807,6 +925,13 @@ static int vmR3InitRing3(PVM pVM, PUVM pUVM)
             return rc;
     }
 
+    /*
+     * Pin the EMTs to host CPUs if so configured.
+     */
+    rc = vmR3InitEmtPlacement(pVM);
+    if (RT_FAILURE(rc))
+        return rc;
+
     /*
      * Register statistics.
      */
@@ -824,6 +949,12 @@ static int vmR3InitRing3(PVM pVM, PUVM pUVM)
         AssertRC(rc);
         rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltTimers,          STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_NS_PER_CALL, "Profiling halted state timer tasks.", "/PROF/CPU%d/VM/Halt/Timers", idCpu);
         AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollTime,        STAMTYPE_PROFILE, STAMVISIBILITY_USED,   STAMUNIT_NS_PER_CALL, "Time spent halt polling.",           "/PROF/CPU%d/VM/Halt/Poll", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollSuccess,     STAMTYPE_COUNTER, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,  "Halt polls that caught the wakeup.", "/PROF/CPU%d/VM/Halt/PollSuccess", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollWasted,      STAMTYPE_COUNTER, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,  "Halt polls that ran out before blocking.", "/PROF/CPU%d/VM/Halt/PollWasted", idCpu);
+        AssertRC(rc);
     }
 
     STAM_REG(pVM, &pUVM->vm.s.StatReqAllocNew,   STAMTYPE_COUNTER,     "/VM/Req/AllocNew",       STAMUNIT_OCCURENCES,        "Number of VMR3ReqAlloc returning a new packet.");
@@ -1771,13 +1902,23 @@ VMMR3DECL(int) VMR3Save(PUVM pUVM, const char *pszFilename, PCSSMSTRMOPS pStream
                  VERR_INVALID_PARAMETER);
     AssertPtrNullReturn(pfnProgress, VERR_INVALID_POINTER);
 
+    /** @cfgm{/SSM/MaxDowntimeMs, uint32_t, 1, UINT32_MAX, 250}
+     * The downtime (in milliseconds) a live save (i.e. a live snapshot) aims
+     * for.  The pre-copy passes continue until the remaining dirty memory can
+     * be written within this time, so lowering it shortens the final pause at
+     * the cost of more passes while the VM keeps running. */
+    uint32_t cMsMaxDowntime = 250;
+    int rc = CFGMR3QueryU32Def(CFGMR3GetChild(CFGMR3GetRoot(pVM), "SSM"), "MaxDowntimeMs", &cMsMaxDowntime, 250);
+    AssertLogRelRCReturn(rc, rc);
+    AssertLogRelMsgReturn(cMsMaxDowntime > 0, ("MaxDowntimeMs=%u\n", cMsMaxDowntime), VERR_OUT_OF_RANGE);
+
     /*
      * Join paths with VMR3Teleport.
      */
     SSMAFTER enmAfter = fContinueAfterwards ? SSMAFTER_CONTINUE : SSMAFTER_DESTROY;
-    int rc = vmR3SaveTeleport(pVM, 250 /*cMsMaxDowntime*/,
-                              pszFilename, pStreamOps, pvStreamOpsUser,
-                              enmAfter, pfnProgress, pvUser, pfSuspended);
+    rc = vmR3SaveTeleport(pVM, cMsMaxDowntime,
+                          pszFilename, pStreamOps, pvStreamOpsUser,
+                          enmAfter, pfnProgress, pvUser, pfSuspended);
     LogFlow(("VMR3Save: returns %Rrc (*pfSuspended=%RTbool)\n", rc, *pfSuspended));
     return rc;
 }
@@ -51,6 +51,13 @@
 #include <iprt/time.h>
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The initial adaptive halt poll window when growing from zero (ns). */
+#define VM_HALT_POLL_START_NS       RT_NS_10US
+
+
 /*********************************************************************************************************************************
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
@@ -499,6 +506,34 @@ static int vmR3HaltMethod12ReadConfigU(PUVM pUVM)
                 pUVM->vm.s.Halt.Method12.u32StopSpinningCfg));
     }
 
+    /*
+     * Adaptive polling before blocking, disabled by default.
+     */
+    pUVM->vm.s.Halt.Method12.cNsPollMaxCfg  = 0;
+    pUVM->vm.s.Halt.Method12.uPollGrowCfg   = 2;
+    pUVM->vm.s.Halt.Method12.uPollShrinkCfg = 2;
+    if (pCfg)
+    {
+        /** @cfgm{/VMM/HaltedMethod1/PollMax, uint32_t, ns, 0, 2000000, 0}
+         * The max time to poll for wakeups before blocking when halted, zero disables
+         * it.  The per-VCPU poll window adapts to the recent wakeup history. */
+        uint32_t u32;
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollMax", &u32)))
+            pUVM->vm.s.Halt.Method12.cNsPollMaxCfg = RT_MIN(u32, 2 * RT_NS_1MS);
+        /** @cfgm{/VMM/HaltedMethod1/PollGrow, uint32_t, , 2, 16, 2}
+         * Factor to grow the poll window by when blocking was short. */
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollGrow", &u32)))
+            pUVM->vm.s.Halt.Method12.uPollGrowCfg = RT_MAX(RT_MIN(u32, 16), 2);
+        /** @cfgm{/VMM/HaltedMethod1/PollShrink, uint32_t, , 0, 16, 2}
+         * Divisor to shrink the poll window by when blocking was long, zero resets
+         * the window. */
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollShrink", &u32)))
+            pUVM->vm.s.Halt.Method12.uPollShrinkCfg = RT_MIN(u32, 16);
+        if (pUVM->vm.s.Halt.Method12.cNsPollMaxCfg)
+            LogRel(("VMEmt: HaltedMethod1 polling: max=%u ns grow=%u shrink=%u\n",
+                    pUVM->vm.s.Halt.Method12.cNsPollMaxCfg, pUVM->vm.s.Halt.Method12.uPollGrowCfg, pUVM->vm.s.Halt.Method12.uPollShrinkCfg));
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -511,10 +546,77 @@ static int vmR3HaltMethod12ReadConfigU(PUVM pUVM)
  */
 static DECLCALLBACK(int) vmR3HaltMethod1Init(PUVM pUVM)
 {
+    for (VMCPUID idCpu = 0; idCpu < pUVM->cCpus; idCpu++)
+        pUVM->aCpus[idCpu].vm.s.cNsHaltPollWindow = 0;
     return vmR3HaltMethod12ReadConfigU(pUVM);
 }
 
 
+/**
+ * Polls for a wakeup for up to the VCPU's adaptive poll window before halt
+ * method 1 blocks, and adjusts the window afterwards.
+ *
+ * @returns true if the wakeup condition was seen, false if we should block.
+ * @param   pUVCpu          Pointer to the user mode VMCPU structure.
+ * @param   fMask           The VMCPU FFs to wake up on.
+ * @param   cNsMax          Time to the next timer event.
+ */
+static bool vmR3HaltMethod1Poll(PUVMCPU pUVCpu, const uint32_t fMask, uint64_t cNsMax)
+{
+    uint64_t const cNsPoll = RT_MIN(pUVCpu->vm.s.cNsHaltPollWindow, cNsMax);
+    if (!cNsPoll)
+        return false;
+
+    PVM    const pVM   = pUVCpu->pVM;
+    PVMCPU const pVCpu = pUVCpu->pVCpu;
+    uint64_t const nsStart = RTTimeNanoTS();
+    uint64_t       cNsElapsed;
+    do
+    {
+        ASMNopPause();
+        if (    VM_FF_IS_ANY_SET(pVM, VM_FF_EXTERNAL_HALTED_MASK)
+            ||  VMCPU_FF_IS_ANY_SET(pVCpu, fMask))
+        {
+            STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPollTime, RTTimeNanoTS() - nsStart);
+            STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollSuccess);
+            return true;
+        }
+        cNsElapsed = RTTimeNanoTS() - nsStart;
+    } while (cNsElapsed < cNsPoll);
+
+    STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPollTime, cNsElapsed);
+    STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollWasted);
+    return false;
+}
+
+
+/**
+ * Adjusts the VCPU's adaptive poll window after halt method 1 has blocked.
+ *
+ * @param   pUVCpu          Pointer to the user mode VMCPU structure.
+ * @param   cNsBlocked      How long we blocked.
+ */
+static void vmR3HaltMethod1PollAdjust(PUVMCPU pUVCpu, uint64_t cNsBlocked)
+{
+    PUVM     const pUVM      = pUVCpu->pUVM;
+    uint32_t       cNsWindow = pUVCpu->vm.s.cNsHaltPollWindow;
+    if (cNsWindow + cNsBlocked < pUVM->vm.s.Halt.Method12.cNsPollMaxCfg)
+    {
+        /* A longer window would've caught this wakeup. */
+        uint32_t const cNsNew = cNsWindow ? cNsWindow * pUVM->vm.s.Halt.Method12.uPollGrowCfg : VM_HALT_POLL_START_NS;
+        cNsWindow = RT_MIN(cNsNew, pUVM->vm.s.Halt.Method12.cNsPollMaxCfg);
+    }
+    else if (cNsWindow)
+    {
+        /* The wakeup came long after the window, stop wasting time on polling. */
+        cNsWindow = pUVM->vm.s.Halt.Method12.uPollShrinkCfg ? cNsWindow / pUVM->vm.s.Halt.Method12.uPollShrinkCfg : 0;
+        if (cNsWindow < VM_HALT_POLL_START_NS)
+            cNsWindow = 0;
+    }
+    pUVCpu->vm.s.cNsHaltPollWindow = cNsWindow;
+}
+
+
 /**
  * Method 1 - Block whenever possible, and when lagging behind
  * switch to spinning for 10-30ms with occasional blocking until
@@ -628,6 +730,14 @@ static DECLCALLBACK(int) vmR3HaltMethod1Halt(PUVMCPU pUVCpu, const uint32_t fMas
             &&  u64NanoTS >= 250000) /* 0.250 ms */
 #endif
         {
+            /*
+             * Poll a little before blocking if configured to do so, as the wakeup
+             * latency easily exceeds the time to the next IPI or packet.
+             */
+            bool const fPolling = pUVM->vm.s.Halt.Method12.cNsPollMaxCfg != 0 && !fSpinning;
+            if (fPolling && vmR3HaltMethod1Poll(pUVCpu, fMask, u64NanoTS))
+                continue;
+
             const uint64_t Start = pUVCpu->vm.s.Halt.Method12.u64LastBlockTS = RTTimeNanoTS();
             VMMR3YieldStop(pVM);
 
@@ -656,6 +766,8 @@ static DECLCALLBACK(int) vmR3HaltMethod1Halt(PUVMCPU pUVCpu, const uint32_t fMas
              * Update averages every 16th time, and flush parts of the history every 64th time.
              */
             const uint64_t Elapsed = RTTimeNanoTS() - Start;
+            if (fPolling)
+                vmR3HaltMethod1PollAdjust(pUVCpu, Elapsed);
             pUVCpu->vm.s.Halt.Method12.cNSBlocked += Elapsed;
             if (Elapsed > u64NanoTS)
                 pUVCpu->vm.s.Halt.Method12.cNSBlockedTooLong += Elapsed - u64NanoTS;
@@ -1087,10 +1199,10 @@ static const struct VMHALTMETHODDESC
     DECLR3CALLBACKMEMBER(void,  pfnNotifyGlobalFF,(PUVM pUVM, uint32_t fFlags));
 } g_aHaltMethods[] =
 {
-    { VMHALTMETHOD_BOOTSTRAP, false, NULL,                NULL,   NULL,                vmR3BootstrapWait,   vmR3BootstrapNotifyCpuFF,   NULL },
-    { VMHALTMETHOD_OLD,       false, NULL,                NULL,   vmR3HaltOldDoHalt,   vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
+    { VMHALTMETHOD_BOOTSTRAP, false, NULL,                NULL,                NULL,                vmR3BootstrapWait,   vmR3BootstrapNotifyCpuFF,   NULL },
+    { VMHALTMETHOD_OLD,       false, NULL,                NULL,                vmR3HaltOldDoHalt,   vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
     { VMHALTMETHOD_1,         false, vmR3HaltMethod1Init, NULL,   vmR3HaltMethod1Halt, vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
-    { VMHALTMETHOD_GLOBAL_1,   true, vmR3HaltGlobal1Init, NULL,   vmR3HaltGlobal1Halt, vmR3HaltGlobal1Wait, vmR3HaltGlobal1NotifyCpuFF, NULL },
+    { VMHALTMETHOD_GLOBAL_1,   true, vmR3HaltGlobal1Init, NULL,                vmR3HaltGlobal1Halt, vmR3HaltGlobal1Wait, vmR3HaltGlobal1NotifyCpuFF, NULL },
 };
 
 
@@ -194,6 +194,7 @@ static FNRTTHREAD           vmmR3LogFlusher;
 static void                 vmmR3LogReturnFlush(PVM pVM, PVMCPU pVCpu, PVMMR3CPULOGGER pShared, size_t idxBuf,
                                                 PRTLOGGER pDstLogger);
 static DECLCALLBACK(void)   vmmR3InfoFF(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
+static DECLCALLBACK(void)   vmmR3InfoReqBench(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
 
 
 
@@ -321,6 +322,8 @@ VMMR3_INT_DECL(int) VMMR3Init(PVM pVM)
              * Debug info and statistics.
              */
             DBGFR3InfoRegisterInternal(pVM, "fflags", "Displays the current Forced actions Flags.", vmmR3InfoFF);
+            DBGFR3InfoRegisterInternal(pVM, "reqbench", "Measures VMR3ReqCall round trips to each EMT. Arg: iterations.",
+                                       vmmR3InfoReqBench);
             vmmR3InitRegisterStats(pVM);
             vmmInitFormatTypes();
 
@@ -2521,6 +2524,116 @@ static int vmmR3HandleRing0Assert(PVM pVM, PVMCPU pVCpu)
 }
 
 
+/**
+ * No-op request worker for vmmR3InfoReqBench.
+ */
+static DECLCALLBACK(int) vmmR3ReqBenchNop(void)
+{
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Measures normal and priority request round trips to one EMT.
+ *
+ * @returns VBox status code.
+ * @param   pVM             The cross context VM structure.
+ * @param   idCpu           The target EMT.
+ * @param   fPriority       Whether to use the priority request queue.
+ * @param   cIterations     Number of round trips.
+ * @param   pcNsMin         Where to return the fastest round trip.
+ * @param   pcNsAvg         Where to return the average round trip.
+ * @param   pcNsMax         Where to return the slowest round trip.
+ */
+static int vmmR3ReqBenchOne(PVM pVM, VMCPUID idCpu, bool fPriority, uint32_t cIterations,
+                            uint64_t *pcNsMin, uint64_t *pcNsAvg, uint64_t *pcNsMax)
+{
+    uint64_t cNsMin   = UINT64_MAX;
+    uint64_t cNsMax   = 0;
+    uint64_t cNsTotal = 0;
+    for (uint32_t i = 0; i < cIterations; i++)
+    {
+        uint64_t const nsStart = RTTimeNanoTS();
+        int rc = fPriority
+               ? VMR3ReqPriorityCallWaitU(pVM->pUVM, idCpu, (PFNRT)vmmR3ReqBenchNop, 0)
+               : VMR3ReqCallWait(pVM, idCpu, (PFNRT)vmmR3ReqBenchNop, 0);
+        uint64_t const cNsElapsed = RTTimeNanoTS() - nsStart;
+        if (RT_FAILURE(rc))
+            return rc;
+        cNsTotal += cNsElapsed;
+        if (cNsElapsed < cNsMin)
+            cNsMin = cNsElapsed;
+        if (cNsElapsed > cNsMax)
+            cNsMax = cNsElapsed;
+    }
+    *pcNsMin = cNsMin;
+    *pcNsAvg = cNsTotal / cIterations;
+    *pcNsMax = cNsMax;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Measures the VMR3ReqCall round trip latency to each EMT.
+ *
+ * This has to be invoked from a non-EMT thread, e.g. via
+ * 'VBoxManage debugvm <vm> info reqbench [iterations]' with the VM running.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pHlp        The output helpers.
+ * @param   pszArgs     Optional number of iterations per EMT (default 1000).
+ */
+static DECLCALLBACK(void) vmmR3InfoReqBench(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    if (VMMGetCpu(pVM))
+    {
+        pHlp->pfnPrintf(pHlp, "reqbench: Cannot be invoked on an EMT.\n");
+        return;
+    }
+
+    uint32_t cIterations = 1000;
+    if (pszArgs)
+    {
+        pszArgs = RTStrStripL(pszArgs);
+        if (*pszArgs)
+        {
+            int rc = RTStrToUInt32Full(pszArgs, 0, &cIterations);
+            if (   RT_FAILURE(rc)
+                || cIterations == 0
+                || cIterations > _1M)
+            {
+                pHlp->pfnPrintf(pHlp, "reqbench: Invalid iteration count '%s' (1..%u).\n", pszArgs, _1M);
+                return;
+            }
+        }
+    }
+
+    pHlp->pfnPrintf(pHlp, "VMR3ReqCall round trips, %u iterations per EMT, execution engine %s:\n", cIterations,
+                      VM_IS_HM_ENABLED(pVM)  ? "HM"
+                    : VM_IS_NEM_ENABLED(pVM) ? "NEM"
+                    :                          "IEM");
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        uint64_t cNsMin, cNsAvg, cNsMax;
+        int rc = vmmR3ReqBenchOne(pVM, idCpu, false /*fPriority*/, cIterations, &cNsMin, &cNsAvg, &cNsMax);
+        if (RT_FAILURE(rc))
+        {
+            pHlp->pfnPrintf(pHlp, "  CPU %u: request failed: %Rrc\n", idCpu, rc);
+            continue;
+        }
+        uint64_t cNsPrioMin, cNsPrioAvg, cNsPrioMax;
+        rc = vmmR3ReqBenchOne(pVM, idCpu, true /*fPriority*/, cIterations, &cNsPrioMin, &cNsPrioAvg, &cNsPrioMax);
+        if (RT_FAILURE(rc))
+        {
+            pHlp->pfnPrintf(pHlp, "  CPU %u: priority request failed: %Rrc\n", idCpu, rc);
+            continue;
+        }
+        pHlp->pfnPrintf(pHlp, "  CPU %u: normal min %RU64 avg %RU64 max %RU64 ns; priority min %RU64 avg %RU64 max %RU64 ns\n",
+                        idCpu, cNsMin, cNsAvg, cNsMax, cNsPrioMin, cNsPrioAvg, cNsPrioMax);
+    }
+}
+
+
 /**
  * Displays the Force action Flags.
  *